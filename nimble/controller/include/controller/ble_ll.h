@@ -214,6 +214,11 @@ STATS_SECT_START(ble_ll_stats)
     STATS_SECT_ENTRY(sync_scheduled)
     STATS_SECT_ENTRY(sched_state_sync_errs)
     STATS_SECT_ENTRY(sched_invalid_pdu)
+    STATS_SECT_ENTRY(rpa_cache_hits)
+    STATS_SECT_ENTRY(rpa_cache_misses)
+    STATS_SECT_ENTRY(scan_dup_hits)
+    STATS_SECT_ENTRY(scan_dup_misses)
+    STATS_SECT_ENTRY(scan_dup_evictions)
 STATS_SECT_END
 extern STATS_SECT_DECL(ble_ll_stats) ble_ll_stats;
 
@@ -26,9 +26,36 @@ extern "C" {
 
 #if MYNEWT_VAL(BLE_LL_ISO)
 
+/* ISO Data PDU LLID, Core 5.3, Vol 6, Part B, 2.6 */
+#define BLE_LL_ISOAL_LLID_UNFRAMED_END      (0)
+#define BLE_LL_ISOAL_LLID_UNFRAMED_CONT     (1)
+#define BLE_LL_ISOAL_LLID_FRAMED            (2)
+
+/* Segmentation header, Core 5.3, Vol 6, Part G, 6.1 */
+#define BLE_LL_ISOAL_SEGHDR_SC              (0x01)
+#define BLE_LL_ISOAL_SEGHDR_CMPLT           (0x02)
+#define BLE_LL_ISOAL_SEGHDR_LEN             (2)
+#define BLE_LL_ISOAL_TIME_OFFSET_LEN        (3)
+
+/* Max Burst Number */
+#define BLE_LL_ISOAL_MAX_BN                 (7)
+
+/* Position in the SDU queue at which a framed PDU starts */
+struct ble_ll_isoal_framed_pos {
+    struct os_mbuf_pkthdr *pkthdr;
+    /* Offset within SDU */
+    uint16_t offset;
+    /* Index of SDU in queue */
+    uint8_t sdu_idx;
+};
+
 struct ble_ll_isoal_mux {
     /* Max PDU length */
     uint8_t max_pdu;
+    /* Framed PDUs */
+    uint8_t framed : 1;
+    /* Number of new PDUs per ISO event */
+    uint8_t bn;
     /* Number of expected SDUs per ISO interval */
     uint8_t sdu_per_interval;
     /* Number of expected PDUs per SDU */
@@ -42,20 +69,35 @@ struct ble_ll_isoal_mux {
     uint16_t sdu_q_len;
 
     struct os_mbuf *frag;
+    /* Number of HCI ISO Data packets in frag */
+    uint8_t frag_pkts;
+
+    /* Framed: data of head SDU sent in previous events */
+    uint16_t sdu_offset;
+    /* Framed: start of each PDU in current event, followed by the position
+     * right after the last PDU
+     */
+    struct ble_ll_isoal_framed_pos pdu_pos[BLE_LL_ISOAL_MAX_BN + 1];
 
     uint32_t sdu_counter;
 
     uint32_t event_tx_timestamp;
     uint32_t last_tx_timestamp;
     uint16_t last_tx_packet_seq_num;
+    /* Time_Offset of 1st SDU started in last event (framed only) */
+    uint32_t last_tx_time_offset;
 };
 
 void
 ble_ll_isoal_mux_init(struct ble_ll_isoal_mux *mux, uint8_t max_pdu,
                       uint32_t iso_interval_us, uint32_t sdu_interval_us,
-                      uint8_t bn, uint8_t pte);
+                      uint8_t bn, uint8_t pte, uint8_t framed);
 void ble_ll_isoal_mux_free(struct ble_ll_isoal_mux *mux);
 
+void ble_ll_isoal_mux_tx_pkt_in(struct ble_ll_isoal_mux *mux,
+                                struct os_mbuf *om, uint8_t pb,
+                                uint8_t ts_valid, uint32_t timestamp);
+
 int ble_ll_isoal_mux_event_start(struct ble_ll_isoal_mux *mux,
                                  uint32_t timestamp);
 int ble_ll_isoal_mux_event_done(struct ble_ll_isoal_mux *mux);
@@ -63,6 +105,42 @@ int ble_ll_isoal_mux_event_done(struct ble_ll_isoal_mux *mux);
 int
 ble_ll_isoal_mux_unframed_get(struct ble_ll_isoal_mux *mux, uint8_t idx,
                               uint8_t *llid, void *dptr);
+int
+ble_ll_isoal_mux_framed_get(struct ble_ll_isoal_mux *mux, uint8_t idx,
+                            uint8_t *llid, void *dptr);
+
+struct ble_ll_isoal_demux;
+
+/* Called with each reassembled SDU; ownership of the mbuf is passed */
+typedef void ble_ll_isoal_demux_sdu_fn(struct ble_ll_isoal_demux *demux,
+                                       struct os_mbuf *om, uint32_t timestamp,
+                                       uint16_t seq_num, uint8_t status);
+
+struct ble_ll_isoal_demux {
+    /* Framed PDUs */
+    uint8_t framed : 1;
+    /* SDU reassembly in progress */
+    uint8_t sdu_active : 1;
+    /* SDU being reassembled */
+    struct os_mbuf *sdu;
+    uint32_t sdu_timestamp;
+    /* Status of SDU being reassembled (BLE_HCI_ISO_PKT_STATUS_*) */
+    uint8_t sdu_status;
+    uint16_t sdu_seq_num;
+
+    ble_ll_isoal_demux_sdu_fn *sdu_cb;
+    void *sdu_cb_arg;
+};
+
+void ble_ll_isoal_demux_init(struct ble_ll_isoal_demux *demux, uint8_t framed,
+                             ble_ll_isoal_demux_sdu_fn *sdu_cb, void *arg);
+void ble_ll_isoal_demux_free(struct ble_ll_isoal_demux *demux);
+/* Passes received PDU to ISOAL, data shall be NULL if PDU was not received.
+ * Timestamp is the anchor point of ISO event the PDU was received in.
+ */
+int ble_ll_isoal_demux_pdu_in(struct ble_ll_isoal_demux *demux, uint8_t llid,
+                              const uint8_t *data, uint8_t len,
+                              uint32_t timestamp);
 
 /* HCI command handlers */
 int ble_ll_isoal_hci_setup_iso_data_path(const uint8_t *cmdbuf, uint8_t cmdlen,
@@ -112,6 +112,18 @@ int ble_ll_resolv_rpa(const uint8_t *rpa, const uint8_t *irk);
 /* Try to resolve peer RPA and return index on RL if matched */
 int ble_ll_resolv_peer_rpa_any(const uint8_t *rpa);
 
+#if MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)
+struct ble_ll_resolv_rpa_cache_stats {
+    /* Number of peer RPAs found in and missing from the RPA cache */
+    uint32_t hits;
+    uint32_t misses;
+};
+
+/* Read (and optionally reset) RPA cache statistics */
+void ble_ll_resolv_rpa_cache_stats_get(
+    struct ble_ll_resolv_rpa_cache_stats *stats, int reset);
+#endif
+
 /* Initialize resolv*/
 void ble_ll_resolv_init(void);
 
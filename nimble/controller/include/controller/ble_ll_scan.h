@@ -245,6 +245,10 @@ uint8_t ble_ll_scan_get_filt_dups(void);
 uint8_t ble_ll_scan_backoff_kick(void);
 void ble_ll_scan_backoff_update(int success);
 
+int ble_ll_scan_dup_check_legacy(uint8_t addr_type, uint8_t *addr,
+                                 uint8_t pdu_type);
+int ble_ll_scan_dup_update_legacy(uint8_t addr_type, const uint8_t *addr,
+                                  uint8_t subev, uint8_t evtype);
 int ble_ll_scan_dup_check_ext(uint8_t addr_type, uint8_t *addr, bool has_aux,
                               uint16_t adi);
 int ble_ll_scan_dup_update_ext(uint8_t addr_type, uint8_t *addr, bool has_aux,
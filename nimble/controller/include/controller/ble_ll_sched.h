@@ -109,7 +109,28 @@ struct ble_ll_sched_item
     void            *cb_arg;
     sched_cb_func   sched_cb;
     TAILQ_ENTRY(ble_ll_sched_item) link;
+#if MYNEWT_VAL(BLE_LL_SCHED_INDEX)
+    struct ble_ll_sched_item *idx_parent;
+    struct ble_ll_sched_item *idx_left;
+    struct ble_ll_sched_item *idx_right;
+#endif
+};
+
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+struct ble_ll_sched_stats {
+    /* Time covered by statistics [us] */
+    uint64_t window_us;
+    /* Time reserved by executed schedule items [us] */
+    uint64_t busy_us;
+    /* Number of items inserted to and rejected by scheduler */
+    uint32_t inserted;
+    uint32_t insert_failed;
+    /* Number of overlaps with items that could not be preempted */
+    uint32_t collisions;
+    /* Number of items removed from scheduler due to preemption */
+    uint32_t preempted;
 };
+#endif
 
 /* Initialize the scheduler */
 int ble_ll_sched_init(void);
@@ -123,6 +144,11 @@ int ble_ll_sched_rmv_elem(struct ble_ll_sched_item *sch);
 
 void ble_ll_sched_rmv_elem_type(uint8_t type, sched_remove_cb_func remove_cb);
 
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+/* Read (and optionally reset) scheduler statistics */
+void ble_ll_sched_stats_get(struct ble_ll_sched_stats *stats, int reset);
+#endif
+
 /* Schedule a new master connection */
 struct ble_ll_conn_sm;
 int ble_ll_sched_conn_central_new(struct ble_ll_conn_sm *connsm,
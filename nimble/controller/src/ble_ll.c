@@ -361,6 +361,11 @@ STATS_NAME_START(ble_ll_stats)
     STATS_NAME(ble_ll_stats, sync_scheduled)
     STATS_NAME(ble_ll_stats, sched_state_sync_errs)
     STATS_NAME(ble_ll_stats, sched_invalid_pdu)
+    STATS_NAME(ble_ll_stats, rpa_cache_hits)
+    STATS_NAME(ble_ll_stats, rpa_cache_misses)
+    STATS_NAME(ble_ll_stats, scan_dup_hits)
+    STATS_NAME(ble_ll_stats, scan_dup_misses)
+    STATS_NAME(ble_ll_stats, scan_dup_evictions)
 STATS_NAME_END(ble_ll_stats)
 
 static void ble_ll_event_rx_pkt(struct ble_npl_event *ev);
@@ -1175,7 +1180,8 @@ ble_ll_rx_end(uint8_t *rxbuf, struct ble_mbuf_hdr *rxhdr)
                        rxhdr->rxinfo.flags);
 
 #if MYNEWT_VAL(BLE_LL_EXT)
-    if (BLE_MBUF_HDR_RX_STATE(rxhdr) == BLE_LL_STATE_EXTERNAL) {
+    /* External state does not fit in the RX state bits of the header */
+    if (g_ble_ll_data.ll_state == BLE_LL_STATE_EXTERNAL) {
         rc = ble_ll_ext_rx_isr_end(rxbuf, rxhdr);
         return rc;
     }
@@ -1362,9 +1368,11 @@ void
 ble_ll_task(void *arg)
 {
     struct ble_npl_event *ev;
+    int rc;
 
     /* Init ble phy */
-    ble_phy_init();
+    rc = ble_phy_init();
+    BLE_LL_ASSERT(rc == 0);
 
     /* Set output power to default */
     g_ble_ll_tx_power = ble_ll_tx_power_round(MIN(MYNEWT_VAL(BLE_LL_TX_PWR_DBM),
@@ -356,6 +356,38 @@ ble_ll_hci_vs_set_local_irk(uint16_t ocf, const uint8_t *cmdbuf, uint8_t cmdlen,
 }
 #endif
 
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+static int
+ble_ll_hci_vs_rd_sched_stats(uint16_t ocf, const uint8_t *cmdbuf,
+                             uint8_t cmdlen, uint8_t *rspbuf, uint8_t *rsplen)
+{
+    const struct ble_hci_vs_rd_sched_stats_cp *cmd = (const void *)cmdbuf;
+    struct ble_hci_vs_rd_sched_stats_rp *rsp = (void *)rspbuf;
+    struct ble_ll_sched_stats stats;
+
+    if (cmdlen != sizeof(*cmd)) {
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    if (cmd->reset > 1) {
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    ble_ll_sched_stats_get(&stats, cmd->reset);
+
+    rsp->window = htole64(stats.window_us);
+    rsp->busy = htole64(stats.busy_us);
+    rsp->inserted = htole32(stats.inserted);
+    rsp->insert_failed = htole32(stats.insert_failed);
+    rsp->collisions = htole32(stats.collisions);
+    rsp->preempted = htole32(stats.preempted);
+
+    *rsplen = sizeof(*rsp);
+
+    return BLE_ERR_SUCCESS;
+}
+#endif
+
 static struct ble_ll_hci_vs_cmd g_ble_ll_hci_vs_cmds[] = {
     BLE_LL_HCI_VS_CMD(BLE_HCI_OCF_VS_RD_STATIC_ADDR,
                       ble_ll_hci_vs_rd_static_addr),
@@ -386,6 +418,10 @@ static struct ble_ll_hci_vs_cmd g_ble_ll_hci_vs_cmds[] = {
     BLE_LL_HCI_VS_CMD(BLE_HCI_OCF_VS_SET_LOCAL_IRK,
                       ble_ll_hci_vs_set_local_irk),
 #endif
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+    BLE_LL_HCI_VS_CMD(BLE_HCI_OCF_VS_RD_SCHED_STATS,
+                      ble_ll_hci_vs_rd_sched_stats),
+#endif
 };
 
 static struct ble_ll_hci_vs_cmd *
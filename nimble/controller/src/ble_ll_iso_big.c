@@ -308,7 +308,8 @@ ble_ll_iso_big_biginfo_copy(struct ble_ll_iso_big *big, uint8_t *dptr,
     *dptr++ = (counter >> 8) & 0xff;
     *dptr++ = (counter >> 16) & 0xff;
     *dptr++ = (counter >> 24) & 0xff;
-    *dptr++ = (counter >> 32) & 0xff;
+    /* bis_payload_cnt is 39 bits, MSb is framing */
+    *dptr++ = ((counter >> 32) & 0x7f) | (big->framed << 7);
 
     if (big->encrypted) {
         memcpy(dptr, big->giv, 8);
@@ -677,7 +678,11 @@ ble_ll_iso_big_subevent_pdu_cb(uint8_t *dptr, void *arg, uint8_t *hdr_byte)
     }
 
 #if 1
-    pdu_len = ble_ll_isoal_mux_unframed_get(&bis->mux, idx, &llid, dptr);
+    if (big->framed) {
+        pdu_len = ble_ll_isoal_mux_framed_get(&bis->mux, idx, &llid, dptr);
+    } else {
+        pdu_len = ble_ll_isoal_mux_unframed_get(&bis->mux, idx, &llid, dptr);
+    }
 #else
     llid = 0;
     pdu_len = big->max_pdu;
@@ -814,8 +819,6 @@ ble_ll_iso_big_event_sched_cb(struct ble_ll_sched_item *sch)
 
     ble_ll_tx_power_set(g_ble_ll_tx_power);
 
-    BLE_LL_ASSERT(!big->framed);
-
     /* XXX calculate this in advance at the end of previous event? */
     big->tx.subevents_rem = big->num_bis * big->nse;
     STAILQ_FOREACH(bis, &big->bis_q, bis_q_next) {
@@ -996,10 +999,8 @@ ble_ll_iso_big_create(uint8_t big_handle, uint8_t adv_handle, uint8_t num_bis,
         bis->num = big->num_bis;
         bis->crc_init = (big->crc_init << 8) | (big->num_bis);
 
-        BLE_LL_ASSERT(!big->framed);
-
         ble_ll_isoal_mux_init(&bis->mux, bp->max_pdu, bp->iso_interval * 1250,
-                              bp->sdu_interval, bp->bn, pte);
+                              bp->sdu_interval, bp->bn, pte, bp->framed);
     }
 
     big_pool_free--;
@@ -1210,11 +1211,18 @@ ble_ll_iso_big_hci_evt_complete(void)
 
     evt->big_handle = big->handle;
     put_le24(evt->big_sync_delay, big->sync_delay);
-    /* Core 5.3, Vol 6, Part G, 3.2.2 */
-    put_le24(evt->transport_latency_big,
-             big->sync_delay +
-             (big->pto * (big->nse / big->bn - big->irc) + 1) * big->iso_interval * 1250 -
-             big->sdu_interval);
+    /* Core 5.3, Vol 6, Part G, 3.2.1 and 3.2.2 */
+    if (big->framed) {
+        put_le24(evt->transport_latency_big,
+                 big->sync_delay +
+                 (big->pto * (big->nse / big->bn - big->irc) + 1) * big->iso_interval * 1250 +
+                 big->sdu_interval);
+    } else {
+        put_le24(evt->transport_latency_big,
+                 big->sync_delay +
+                 (big->pto * (big->nse / big->bn - big->irc) + 1) * big->iso_interval * 1250 -
+                 big->sdu_interval);
+    }
     evt->phy = big->phy;
     evt->nse = big->nse;
     evt->bn = big->bn;
@@ -1233,6 +1241,49 @@ ble_ll_iso_big_hci_evt_complete(void)
     ble_ll_hci_event_send(hci_ev);
 }
 
+/* Picks ISO interval, BN and max PDU size for framed SDUs. SDUs need not line
+ * up with ISO events, so the ISO interval is the SDU interval rounded up to
+ * the 5 ms grid (e.g. 7.5 ms SDUs on a 10 ms interval): fewer, fuller events
+ * take less airtime than one event per SDU. If that does not fit in the
+ * transport latency, the smallest valid ISO interval is used instead.
+ */
+static int
+ble_ll_iso_big_framed_params(struct big_params *bp)
+{
+    uint32_t iso_interval_us;
+    uint32_t sdus_len;
+    uint32_t pdu_len;
+    uint8_t sdus;
+
+    iso_interval_us = (bp->sdu_interval + 4999) / 5000 * 5000;
+    if (iso_interval_us + bp->sdu_interval >
+        bp->max_transport_latency * 1000) {
+        iso_interval_us = (bp->sdu_interval + 1249) / 1250 * 1250;
+        if (iso_interval_us < 5000) {
+            iso_interval_us = 5000;
+        }
+    }
+
+    /* Every SDU starting in an event needs its first segment header; each
+     * PDU may also start with the continuation of an SDU.
+     */
+    sdus = (iso_interval_us + bp->sdu_interval - 1) / bp->sdu_interval;
+    sdus_len = sdus * (bp->max_sdu + BLE_LL_ISOAL_SEGHDR_LEN +
+                       BLE_LL_ISOAL_TIME_OFFSET_LEN);
+
+    for (bp->bn = 1; bp->bn <= 7; bp->bn++) {
+        pdu_len = (sdus_len + bp->bn - 1) / bp->bn + BLE_LL_ISOAL_SEGHDR_LEN;
+        if (pdu_len <= 0xfb) {
+            bp->iso_interval = iso_interval_us / 1250;
+            bp->nse = bp->bn;
+            bp->max_pdu = pdu_len;
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
+
 int
 ble_ll_iso_big_hci_create(const uint8_t *cmdbuf, uint8_t len)
 {
@@ -1270,12 +1321,19 @@ ble_ll_iso_big_hci_create(const uint8_t *cmdbuf, uint8_t len)
     bp.encrypted = cmd->encryption;
     memcpy(bp.broadcast_code, cmd->broadcast_code, 16);
 
-    bp.nse = 1;
-    bp.bn = 1;
     bp.irc = 1;
     bp.pto = 0;
-    bp.iso_interval = bp.sdu_interval / 1250;
-    bp.max_pdu = bp.max_sdu;
+    if (bp.framed) {
+        rc = ble_ll_iso_big_framed_params(&bp);
+        if (rc) {
+            return BLE_ERR_INV_HCI_CMD_PARMS;
+        }
+    } else {
+        bp.nse = 1;
+        bp.bn = 1;
+        bp.iso_interval = bp.sdu_interval / 1250;
+        bp.max_pdu = bp.max_sdu;
+    }
 
     rc = ble_ll_iso_big_create(cmd->big_handle, cmd->adv_handle, cmd->num_bis,
                                &bp);
@@ -1361,6 +1419,12 @@ ble_ll_iso_big_hci_create_test(const uint8_t *cmdbuf, uint8_t len)
         if (bp.bn % (iso_interval_us / bp.sdu_interval)) {
             return BLE_ERR_INV_HCI_CMD_PARMS;
         }
+    } else {
+        /* PDU shall fit at least 1st segment of SDU with some data */
+        if (bp.max_pdu <= BLE_LL_ISOAL_SEGHDR_LEN +
+                          BLE_LL_ISOAL_TIME_OFFSET_LEN) {
+            return BLE_ERR_INV_HCI_CMD_PARMS;
+        }
     }
 
     rc = ble_ll_iso_big_create(cmd->big_handle, cmd->adv_handle, cmd->num_bis,
@@ -17,10 +17,12 @@
  * under the License.
  */
 
+#include <errno.h>
 #include <stdint.h>
 #include <syscfg/syscfg.h>
 #include <nimble/hci_common.h>
 #include <controller/ble_ll.h>
+#include <controller/ble_ll_tmr.h>
 #include <controller/ble_ll_isoal.h>
 #include <controller/ble_ll_iso_big.h>
 
@@ -34,14 +36,29 @@ static struct ble_ll_iso_tx_q ll_isoal_tx_q;
 void
 ble_ll_isoal_mux_init(struct ble_ll_isoal_mux *mux, uint8_t max_pdu,
                       uint32_t iso_interval_us, uint32_t sdu_interval_us,
-                      uint8_t bn, uint8_t pte)
+                      uint8_t bn, uint8_t pte, uint8_t framed)
 {
     memset(mux, 0, sizeof(*mux));
 
+    BLE_LL_ASSERT(bn <= BLE_LL_ISOAL_MAX_BN);
+
     mux->max_pdu = max_pdu;
+    mux->framed = framed;
+    mux->bn = bn;
+
     /* Core 5.3, Vol 6, Part G, 2.1 */
-    mux->sdu_per_interval = iso_interval_us / sdu_interval_us;
-    mux->pdu_per_sdu = bn / mux->sdu_per_interval;
+    if (framed) {
+        /* SDUs are not aligned with ISO events, so up to this many SDUs may
+         * start within single ISO interval. Framed PDUs are only ever sent
+         * for current event, i.e. pre-transmissions carry no new data.
+         */
+        mux->sdu_per_interval = (iso_interval_us + sdu_interval_us - 1) /
+                                sdu_interval_us;
+        pte = 0;
+    } else {
+        mux->sdu_per_interval = iso_interval_us / sdu_interval_us;
+        mux->pdu_per_sdu = bn / mux->sdu_per_interval;
+    }
 
     mux->sdu_per_event = (1 + pte) * mux->sdu_per_interval;
 
@@ -71,11 +88,14 @@ ble_ll_isoal_mux_free(struct ble_ll_isoal_mux *mux)
     }
 
     STAILQ_INIT(&mux->sdu_q);
+
+    os_mbuf_free_chain(mux->frag);
+    mux->frag = NULL;
 }
 
-static void
+void
 ble_ll_isoal_mux_tx_pkt_in(struct ble_ll_isoal_mux *mux, struct os_mbuf *om,
-                           uint8_t pb, uint32_t timestamp)
+                           uint8_t pb, uint8_t ts_valid, uint32_t timestamp)
 {
     struct os_mbuf_pkthdr *pkthdr;
     struct ble_mbuf_hdr *blehdr;
@@ -83,23 +103,36 @@ ble_ll_isoal_mux_tx_pkt_in(struct ble_ll_isoal_mux *mux, struct os_mbuf *om,
 
     BLE_LL_ASSERT(mux);
 
+    /* SDU reference time is either provided by host or the time when 1st
+     * fragment of SDU was received by LL.
+     */
+    if ((pb == BLE_HCI_ISO_PB_FIRST) || (pb == BLE_HCI_ISO_PB_COMPLETE)) {
+        blehdr = BLE_MBUF_HDR_PTR(om);
+        blehdr->txiso.timestamp = ts_valid ? timestamp :
+                                  ble_ll_tmr_t2u(ble_ll_tmr_get());
+    }
+
     switch (pb) {
     case BLE_HCI_ISO_PB_FIRST:
         BLE_LL_ASSERT(!mux->frag);
         mux->frag = om;
+        mux->frag_pkts = 1;
         om = NULL;
         break;
     case BLE_HCI_ISO_PB_CONTINUATION:
         BLE_LL_ASSERT(mux->frag);
         os_mbuf_concat(mux->frag, om);
+        mux->frag_pkts++;
         om = NULL;
         break;
     case BLE_HCI_ISO_PB_COMPLETE:
         BLE_LL_ASSERT(!mux->frag);
+        mux->frag_pkts = 1;
         break;
     case BLE_HCI_ISO_PB_LAST:
         BLE_LL_ASSERT(mux->frag);
         os_mbuf_concat(mux->frag, om);
+        mux->frag_pkts++;
         om = mux->frag;
         mux->frag = NULL;
         break;
@@ -114,6 +147,7 @@ ble_ll_isoal_mux_tx_pkt_in(struct ble_ll_isoal_mux *mux, struct os_mbuf *om,
 
     blehdr = BLE_MBUF_HDR_PTR(om);
     blehdr->txiso.packet_seq_num = ++mux->sdu_counter;
+    blehdr->txiso.num_pkts = mux->frag_pkts;
 
     OS_ENTER_CRITICAL(sr);
     pkthdr = OS_MBUF_PKTHDR(om);
@@ -122,12 +156,128 @@ ble_ll_isoal_mux_tx_pkt_in(struct ble_ll_isoal_mux *mux, struct os_mbuf *om,
     OS_EXIT_CRITICAL(sr);
 }
 
+static uint32_t
+ble_ll_isoal_mux_time_offset(struct ble_ll_isoal_mux *mux,
+                             struct os_mbuf_pkthdr *pkthdr)
+{
+    struct ble_mbuf_hdr *blehdr;
+    int32_t time_offset;
+
+    blehdr = BLE_MBUF_HDR_PTR(OS_MBUF_PKTHDR_TO_MBUF(pkthdr));
+
+    /* Core 5.3, Vol 6, Part G, 3.1 */
+    time_offset = mux->event_tx_timestamp - blehdr->txiso.timestamp;
+    if (time_offset < 0) {
+        return 0;
+    }
+
+    return min(time_offset, 0xffffff);
+}
+
+/* Fills single framed PDU starting at given position and advances position
+ * past the data included. If dptr is NULL only the position is updated.
+ */
+static uint8_t
+ble_ll_isoal_mux_framed_fill(struct ble_ll_isoal_mux *mux,
+                             struct ble_ll_isoal_framed_pos *pos,
+                             uint8_t sdu_num, uint8_t *dptr)
+{
+    struct os_mbuf *om;
+    uint16_t sdu_len;
+    uint8_t hdr_len;
+    uint8_t seg_len;
+    uint8_t pdu_len;
+    uint8_t rem_len;
+    uint8_t cmplt;
+
+    pdu_len = 0;
+    rem_len = mux->max_pdu;
+
+    while (pos->pkthdr && (pos->sdu_idx < sdu_num)) {
+        om = OS_MBUF_PKTHDR_TO_MBUF(pos->pkthdr);
+        sdu_len = OS_MBUF_PKTLEN(om);
+
+        hdr_len = BLE_LL_ISOAL_SEGHDR_LEN;
+        if (pos->offset == 0) {
+            hdr_len += BLE_LL_ISOAL_TIME_OFFSET_LEN;
+        }
+
+        if (rem_len < hdr_len) {
+            break;
+        }
+
+        seg_len = min(rem_len - hdr_len, sdu_len - pos->offset);
+        if ((seg_len == 0) && (sdu_len > pos->offset)) {
+            break;
+        }
+
+        cmplt = pos->offset + seg_len == sdu_len;
+
+        if (dptr) {
+            dptr[0] = (pos->offset ? BLE_LL_ISOAL_SEGHDR_SC : 0) |
+                      (cmplt ? BLE_LL_ISOAL_SEGHDR_CMPLT : 0);
+            dptr[1] = hdr_len - BLE_LL_ISOAL_SEGHDR_LEN + seg_len;
+            dptr += BLE_LL_ISOAL_SEGHDR_LEN;
+
+            if (pos->offset == 0) {
+                put_le24(dptr, ble_ll_isoal_mux_time_offset(mux, pos->pkthdr));
+                dptr += BLE_LL_ISOAL_TIME_OFFSET_LEN;
+            }
+
+            os_mbuf_copydata(om, pos->offset, seg_len, dptr);
+            dptr += seg_len;
+        }
+
+        pdu_len += hdr_len + seg_len;
+        rem_len -= hdr_len + seg_len;
+
+        if (cmplt) {
+            pos->pkthdr = STAILQ_NEXT(pos->pkthdr, omp_next);
+            pos->offset = 0;
+            pos->sdu_idx++;
+        } else {
+            pos->offset += seg_len;
+        }
+    }
+
+    return pdu_len;
+}
+
+static int
+ble_ll_isoal_mux_framed_event_start(struct ble_ll_isoal_mux *mux)
+{
+    struct ble_ll_isoal_framed_pos pos;
+    uint8_t sdu_num;
+    uint8_t idx;
+
+    /* SDUs queued after this point are not included in current event */
+    sdu_num = min(mux->sdu_q_len, UINT8_MAX);
+
+    pos.pkthdr = STAILQ_FIRST(&mux->sdu_q);
+    pos.offset = mux->sdu_offset;
+    pos.sdu_idx = 0;
+
+    for (idx = 0; idx < mux->bn; idx++) {
+        mux->pdu_pos[idx] = pos;
+        ble_ll_isoal_mux_framed_fill(mux, &pos, sdu_num, NULL);
+    }
+    mux->pdu_pos[idx] = pos;
+
+    /* Include SDU which is only partially sent in this event */
+    return pos.sdu_idx + (pos.offset ? 1 : 0);
+}
+
 int
 ble_ll_isoal_mux_event_start(struct ble_ll_isoal_mux *mux, uint32_t timestamp)
 {
-    mux->sdu_in_event = min(mux->sdu_q_len, mux->sdu_per_event);
     mux->event_tx_timestamp = timestamp;
 
+    if (mux->framed) {
+        mux->sdu_in_event = ble_ll_isoal_mux_framed_event_start(mux);
+    } else {
+        mux->sdu_in_event = min(mux->sdu_q_len, mux->sdu_per_event);
+    }
+
     return mux->sdu_in_event;
 }
 
@@ -139,17 +289,36 @@ ble_ll_isoal_mux_event_done(struct ble_ll_isoal_mux *mux)
     struct os_mbuf *om;
     struct os_mbuf *om_next;
     uint8_t num_sdu;
-    int pkt_freed = 0;
+    uint16_t sdu_offset;
+    int pkt_completed = 0;
     os_sr_t sr;
 
-    num_sdu = min(mux->sdu_in_event, mux->sdu_per_interval);
+    if (mux->framed) {
+        num_sdu = mux->pdu_pos[mux->bn].sdu_idx;
+        sdu_offset = mux->pdu_pos[mux->bn].offset;
+    } else {
+        num_sdu = min(mux->sdu_in_event, mux->sdu_per_interval);
+        sdu_offset = 0;
+    }
 
     pkthdr = STAILQ_FIRST(&mux->sdu_q);
+    if (mux->framed) {
+        /* Skip head SDU if it was started in one of previous events */
+        if (mux->sdu_in_event <= (mux->sdu_offset ? 1 : 0)) {
+            pkthdr = NULL;
+        } else if (mux->sdu_offset) {
+            pkthdr = STAILQ_NEXT(pkthdr, omp_next);
+        }
+    }
     if (pkthdr) {
         om = OS_MBUF_PKTHDR_TO_MBUF(pkthdr);
         blehdr = BLE_MBUF_HDR_PTR(om);
         mux->last_tx_timestamp = mux->event_tx_timestamp;
         mux->last_tx_packet_seq_num = blehdr->txiso.packet_seq_num;
+        if (mux->framed) {
+            mux->last_tx_time_offset = ble_ll_isoal_mux_time_offset(mux,
+                                                                    pkthdr);
+        }
     }
 
 #if MYNEWT_VAL(BLE_LL_ISO_HCI_DISCARD_THRESHOLD)
@@ -160,12 +329,19 @@ ble_ll_isoal_mux_event_done(struct ble_ll_isoal_mux *mux)
      * drop any excessive SDUs and notify host as if they were sent.
      */
     uint32_t thr = MYNEWT_VAL(BLE_LL_ISO_HCI_DISCARD_THRESHOLD);
+    uint32_t excess;
     if (mux->sdu_q_len > mux->sdu_per_event + thr * mux->sdu_per_interval) {
-        num_sdu = mux->sdu_q_len - mux->sdu_per_event -
-                  thr * mux->sdu_per_interval;
+        excess = mux->sdu_q_len - mux->sdu_per_event -
+                 thr * mux->sdu_per_interval;
+        if (excess > num_sdu) {
+            /* This also drops SDU which was partially sent (framed) */
+            num_sdu = excess;
+            sdu_offset = 0;
+        }
     }
 #endif
 
+    pkthdr = STAILQ_FIRST(&mux->sdu_q);
     while (pkthdr && num_sdu--) {
         OS_ENTER_CRITICAL(sr);
         STAILQ_REMOVE_HEAD(&mux->sdu_q, omp_next);
@@ -173,20 +349,31 @@ ble_ll_isoal_mux_event_done(struct ble_ll_isoal_mux *mux)
         mux->sdu_q_len--;
         OS_EXIT_CRITICAL(sr);
 
+        /* Host is notified about each HCI ISO Data packet, not mbuf */
         om = OS_MBUF_PKTHDR_TO_MBUF(pkthdr);
+        blehdr = BLE_MBUF_HDR_PTR(om);
+        pkt_completed += blehdr->txiso.num_pkts;
+
         while (om) {
             om_next = SLIST_NEXT(om, om_next);
             os_mbuf_free(om);
-            pkt_freed++;
             om = om_next;
         }
 
         pkthdr = STAILQ_FIRST(&mux->sdu_q);
     }
 
+    mux->sdu_offset = sdu_offset;
     mux->sdu_in_event = 0;
 
-    return pkt_freed;
+    if (mux->framed) {
+        /* Nothing is sent if next event is skipped */
+        mux->pdu_pos[mux->bn].pkthdr = NULL;
+        mux->pdu_pos[mux->bn].offset = sdu_offset;
+        mux->pdu_pos[mux->bn].sdu_idx = 0;
+    }
+
+    return pkt_completed;
 }
 
 int
@@ -205,7 +392,7 @@ ble_ll_isoal_mux_unframed_get(struct ble_ll_isoal_mux *mux, uint8_t idx,
     pdu_idx = idx - sdu_idx * mux->pdu_per_sdu;
 
     if (sdu_idx >= mux->sdu_in_event) {
-        *llid = 1;
+        *llid = BLE_LL_ISOAL_LLID_UNFRAMED_CONT;
         return 0;
     }
 
@@ -215,7 +402,7 @@ ble_ll_isoal_mux_unframed_get(struct ble_ll_isoal_mux *mux, uint8_t idx,
     }
 
     if (!pkthdr) {
-        *llid = 1;
+        *llid = BLE_LL_ISOAL_LLID_UNFRAMED_CONT;
         return 0;
     }
 
@@ -224,7 +411,7 @@ ble_ll_isoal_mux_unframed_get(struct ble_ll_isoal_mux *mux, uint8_t idx,
     rem_len = OS_MBUF_PKTLEN(om) - sdu_offset;
 
     if ((int32_t)rem_len <= 0) {
-        *llid = 1;
+        *llid = BLE_LL_ISOAL_LLID_UNFRAMED_CONT;
         pdu_len = 0;
     } else {
         *llid = (pdu_idx < mux->pdu_per_sdu - 1);
@@ -236,6 +423,222 @@ ble_ll_isoal_mux_unframed_get(struct ble_ll_isoal_mux *mux, uint8_t idx,
     return pdu_len;
 }
 
+int
+ble_ll_isoal_mux_framed_get(struct ble_ll_isoal_mux *mux, uint8_t idx,
+                            uint8_t *llid, void *dptr)
+{
+    struct ble_ll_isoal_framed_pos pos;
+
+    *llid = BLE_LL_ISOAL_LLID_FRAMED;
+
+    /* Pre-transmissions and PDUs with no data are sent empty */
+    if (idx >= mux->bn) {
+        return 0;
+    }
+
+    pos = mux->pdu_pos[idx];
+
+    return ble_ll_isoal_mux_framed_fill(mux, &pos, mux->sdu_in_event, dptr);
+}
+
+void
+ble_ll_isoal_demux_init(struct ble_ll_isoal_demux *demux, uint8_t framed,
+                        ble_ll_isoal_demux_sdu_fn *sdu_cb, void *arg)
+{
+    memset(demux, 0, sizeof(*demux));
+
+    demux->framed = framed;
+    demux->sdu_cb = sdu_cb;
+    demux->sdu_cb_arg = arg;
+}
+
+void
+ble_ll_isoal_demux_free(struct ble_ll_isoal_demux *demux)
+{
+    os_mbuf_free_chain(demux->sdu);
+    demux->sdu = NULL;
+    demux->sdu_active = 0;
+}
+
+static void
+ble_ll_isoal_demux_sdu_start(struct ble_ll_isoal_demux *demux,
+                             uint32_t timestamp)
+{
+    demux->sdu_active = 1;
+    demux->sdu_timestamp = timestamp;
+}
+
+static void
+ble_ll_isoal_demux_sdu_append(struct ble_ll_isoal_demux *demux,
+                              const uint8_t *data, uint8_t len)
+{
+    int rc;
+
+    if (demux->sdu_status & BLE_HCI_ISO_PKT_STATUS_INVALID) {
+        return;
+    }
+
+    if (!demux->sdu) {
+        demux->sdu = os_msys_get_pkthdr(len, 0);
+        if (!demux->sdu) {
+            demux->sdu_status |= BLE_HCI_ISO_PKT_STATUS_INVALID;
+            return;
+        }
+    }
+
+    rc = os_mbuf_append(demux->sdu, data, len);
+    if (rc) {
+        demux->sdu_status |= BLE_HCI_ISO_PKT_STATUS_INVALID;
+    }
+}
+
+static void
+ble_ll_isoal_demux_sdu_done(struct ble_ll_isoal_demux *demux)
+{
+    struct os_mbuf *om;
+    uint8_t status;
+
+    om = demux->sdu;
+    status = demux->sdu_status;
+
+    /* Data of SDU with errors is not passed on, it's reported as lost */
+    if (status) {
+        os_mbuf_free_chain(om);
+        om = NULL;
+        status = BLE_HCI_ISO_PKT_STATUS_LOST;
+    }
+
+    demux->sdu = NULL;
+    demux->sdu_active = 0;
+    demux->sdu_status = 0;
+
+    demux->sdu_cb(demux, om, demux->sdu_timestamp, demux->sdu_seq_num++,
+                  status);
+}
+
+static int
+ble_ll_isoal_demux_unframed_in(struct ble_ll_isoal_demux *demux, uint8_t llid,
+                               const uint8_t *data, uint8_t len,
+                               uint32_t timestamp)
+{
+    if (!data) {
+        /* We do not know if lost PDU ended SDU, so SDU in progress (or the
+         * next one) is marked as invalid.
+         */
+        demux->sdu_status |= BLE_HCI_ISO_PKT_STATUS_INVALID;
+        return 0;
+    }
+
+    switch (llid) {
+    case BLE_LL_ISOAL_LLID_UNFRAMED_CONT:
+        /* Padding */
+        if (len == 0) {
+            return 0;
+        }
+        break;
+    case BLE_LL_ISOAL_LLID_UNFRAMED_END:
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    if (!demux->sdu_active) {
+        ble_ll_isoal_demux_sdu_start(demux, timestamp);
+    }
+
+    ble_ll_isoal_demux_sdu_append(demux, data, len);
+
+    if (llid == BLE_LL_ISOAL_LLID_UNFRAMED_END) {
+        ble_ll_isoal_demux_sdu_done(demux);
+    }
+
+    return 0;
+}
+
+static int
+ble_ll_isoal_demux_framed_in(struct ble_ll_isoal_demux *demux, uint8_t llid,
+                             const uint8_t *data, uint8_t len,
+                             uint32_t timestamp)
+{
+    uint32_t time_offset;
+    uint8_t seg_hdr;
+    uint8_t seg_len;
+
+    if (!data) {
+        /* Remaining segments of SDU in progress may have been lost */
+        if (demux->sdu_active) {
+            demux->sdu_status |= BLE_HCI_ISO_PKT_STATUS_INVALID;
+            ble_ll_isoal_demux_sdu_done(demux);
+        }
+        return 0;
+    }
+
+    if (llid != BLE_LL_ISOAL_LLID_FRAMED) {
+        return -EINVAL;
+    }
+
+    while (len) {
+        if (len < BLE_LL_ISOAL_SEGHDR_LEN) {
+            return -EINVAL;
+        }
+
+        seg_hdr = data[0];
+        seg_len = data[1];
+        data += BLE_LL_ISOAL_SEGHDR_LEN;
+        len -= BLE_LL_ISOAL_SEGHDR_LEN;
+
+        if (seg_len > len) {
+            return -EINVAL;
+        }
+        len -= seg_len;
+
+        if (!(seg_hdr & BLE_LL_ISOAL_SEGHDR_SC)) {
+            if (seg_len < BLE_LL_ISOAL_TIME_OFFSET_LEN) {
+                return -EINVAL;
+            }
+
+            /* New SDU while previous one was not completed */
+            if (demux->sdu_active) {
+                demux->sdu_status |= BLE_HCI_ISO_PKT_STATUS_INVALID;
+                ble_ll_isoal_demux_sdu_done(demux);
+            }
+
+            /* Core 5.3, Vol 6, Part G, 3.2 */
+            time_offset = get_le24(data);
+            data += BLE_LL_ISOAL_TIME_OFFSET_LEN;
+            seg_len -= BLE_LL_ISOAL_TIME_OFFSET_LEN;
+
+            ble_ll_isoal_demux_sdu_start(demux, timestamp - time_offset);
+        } else if (!demux->sdu_active) {
+            /* Continuation of SDU which start was lost, it will be reported
+             * as lost once completed.
+             */
+            ble_ll_isoal_demux_sdu_start(demux, timestamp);
+            demux->sdu_status |= BLE_HCI_ISO_PKT_STATUS_INVALID;
+        }
+
+        ble_ll_isoal_demux_sdu_append(demux, data, seg_len);
+        data += seg_len;
+
+        if (seg_hdr & BLE_LL_ISOAL_SEGHDR_CMPLT) {
+            ble_ll_isoal_demux_sdu_done(demux);
+        }
+    }
+
+    return 0;
+}
+
+int
+ble_ll_isoal_demux_pdu_in(struct ble_ll_isoal_demux *demux, uint8_t llid,
+                          const uint8_t *data, uint8_t len, uint32_t timestamp)
+{
+    if (demux->framed) {
+        return ble_ll_isoal_demux_framed_in(demux, llid, data, len, timestamp);
+    }
+
+    return ble_ll_isoal_demux_unframed_in(demux, llid, data, len, timestamp);
+}
+
 static void
 ble_ll_isoal_tx_pkt_in(struct ble_npl_event *ev)
 {
@@ -250,7 +653,7 @@ ble_ll_isoal_tx_pkt_in(struct ble_npl_event *ev)
     uint16_t length;
     uint16_t pb_flag;
     uint16_t ts_flag;
-    uint32_t timestamp = 0;
+    uint32_t timestamp;
     os_sr_t sr;
 
     while (STAILQ_FIRST(&ll_isoal_tx_q)) {
@@ -270,6 +673,7 @@ ble_ll_isoal_tx_pkt_in(struct ble_npl_event *ev)
         length = BLE_HCI_ISO_LENGTH(le16toh(hci_iso->length));
 
         data_hdr_len = 0;
+        timestamp = 0;
         if ((pb_flag == BLE_HCI_ISO_PB_FIRST) ||
             (pb_flag == BLE_HCI_ISO_PB_COMPLETE)) {
             if (ts_flag) {
@@ -290,7 +694,7 @@ ble_ll_isoal_tx_pkt_in(struct ble_npl_event *ev)
         switch (BLE_LL_CONN_HANDLE_TYPE(conn_handle)) {
         case BLE_LL_CONN_HANDLE_TYPE_BIS:
             mux = ble_ll_iso_big_find_mux_by_handle(conn_handle);
-            ble_ll_isoal_mux_tx_pkt_in(mux, om, pb_flag, timestamp);
+            ble_ll_isoal_mux_tx_pkt_in(mux, om, pb_flag, ts_flag, timestamp);
             break;
         default:
             os_mbuf_free_chain(om);
@@ -373,7 +777,7 @@ ble_ll_isoal_hci_read_tx_sync(const uint8_t *cmdbuf, uint8_t cmdlen,
     rsp->conn_handle = cmd->conn_handle;
     rsp->packet_seq_num = htole16(mux->last_tx_packet_seq_num);
     rsp->tx_timestamp = htole32(mux->last_tx_timestamp);
-    put_le24(rsp->time_offset, 0);
+    put_le24(rsp->time_offset, mux->last_tx_time_offset);
 
     *rsplen = sizeof(*rsp);
 
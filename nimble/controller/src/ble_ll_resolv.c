@@ -32,6 +32,9 @@
 #include "controller/ble_hw.h"
 #include "ble_ll_conn_priv.h"
 #include "ble_ll_priv.h"
+#if MYNEWT_VAL(BLE_LL_RESOLV_SW_AES)
+#include "tinycrypt/aes.h"
+#endif
 
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PRIVACY)
 struct ble_ll_resolv_data
@@ -48,6 +51,47 @@ struct ble_ll_resolv_data g_ble_ll_resolv_data;
 __attribute__((aligned(4)))
 struct ble_ll_resolv_entry g_ble_ll_resolv_list[MYNEWT_VAL(BLE_LL_RESOLV_LIST_SIZE)];
 
+#if MYNEWT_VAL(BLE_LL_RESOLV_SW_AES)
+/*
+ * Expanded AES key schedules of peer IRKs, kept in the same order as
+ * the first rl_cnt_hw entries of the resolving list.  Expanding the key
+ * is about as expensive as the encryption itself, so doing it once per
+ * entry roughly halves the cost of trying every IRK against an RPA.
+ */
+static struct tc_aes_key_sched_struct
+    g_ble_ll_resolv_peer_sched[MYNEWT_VAL(BLE_LL_RESOLV_LIST_SIZE)];
+#endif
+
+#if MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)
+/*
+ * Recently seen peer RPAs and the resolving list index they resolved to,
+ * or -1 if they resolved to none.  A device keeps its RPA until its RPA
+ * timeout, so the same addresses are heard over and over.  Indexes are
+ * only valid for the current list contents, so any change to the list
+ * empties the cache.  It is also emptied on each RPA timeout, by which
+ * time most cached addresses have been replaced.  Drivers without address
+ * resolution hardware (native) resolve received RPAs through here from
+ * interrupt context, so the cache is only touched with interrupts off.
+ * Resolving a miss is done with interrupts on, so each flush bumps 'gen'
+ * and a result is only stored if no flush happened since the lookup.
+ */
+struct ble_ll_resolv_rpa_cache_entry {
+    uint8_t rpa[BLE_DEV_ADDR_LEN];
+    int8_t rl_idx;
+};
+
+struct ble_ll_resolv_rpa_cache {
+    uint8_t cnt;
+    uint8_t next;
+    uint32_t gen;
+    struct ble_ll_resolv_rpa_cache_entry
+        entries[MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)];
+};
+
+static struct ble_ll_resolv_rpa_cache g_ble_ll_resolv_rpa_cache;
+static struct ble_ll_resolv_rpa_cache_stats g_ble_ll_resolv_rpa_cache_stats;
+#endif
+
 #if MYNEWT_VAL(BLE_LL_HCI_VS_LOCAL_IRK)
 struct local_irk_data {
     uint8_t is_set;
@@ -80,6 +124,113 @@ ble_ll_resolv_list_chg_allowed(void)
     return rc;
 }
 
+#if MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)
+static void
+ble_ll_resolv_rpa_cache_flush(void)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    g_ble_ll_resolv_rpa_cache.cnt = 0;
+    g_ble_ll_resolv_rpa_cache.next = 0;
+    g_ble_ll_resolv_rpa_cache.gen++;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Looks up an RPA in the cache.  The cache generation is stored in 'gen'
+ * and must be passed to ble_ll_resolv_rpa_cache_put() on a miss.
+ *
+ * @return int 1: found, index (or -1) stored in 'rl_idx'; 0: not cached.
+ */
+static int
+ble_ll_resolv_rpa_cache_get(const uint8_t *rpa, int *rl_idx, uint32_t *gen)
+{
+    struct ble_ll_resolv_rpa_cache_entry *entry;
+    os_sr_t sr;
+    int rc;
+    int i;
+
+    rc = 0;
+
+    OS_ENTER_CRITICAL(sr);
+    *gen = g_ble_ll_resolv_rpa_cache.gen;
+    for (i = 0; i < g_ble_ll_resolv_rpa_cache.cnt; i++) {
+        entry = &g_ble_ll_resolv_rpa_cache.entries[i];
+        if (!memcmp(entry->rpa, rpa, BLE_DEV_ADDR_LEN)) {
+            *rl_idx = entry->rl_idx;
+            rc = 1;
+            break;
+        }
+    }
+
+    if (rc) {
+        g_ble_ll_resolv_rpa_cache_stats.hits++;
+    } else {
+        g_ble_ll_resolv_rpa_cache_stats.misses++;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return rc;
+}
+
+static void
+ble_ll_resolv_rpa_cache_put(const uint8_t *rpa, int rl_idx, uint32_t gen)
+{
+    struct ble_ll_resolv_rpa_cache_entry *entry;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+
+    /* Resolved against a list that has changed since, drop it */
+    if (gen != g_ble_ll_resolv_rpa_cache.gen) {
+        OS_EXIT_CRITICAL(sr);
+        return;
+    }
+
+    /* Replace oldest entry once the cache is full */
+    entry = &g_ble_ll_resolv_rpa_cache.entries[g_ble_ll_resolv_rpa_cache.next];
+    memcpy(entry->rpa, rpa, BLE_DEV_ADDR_LEN);
+    entry->rl_idx = rl_idx;
+
+    if (g_ble_ll_resolv_rpa_cache.cnt <
+        MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)) {
+        g_ble_ll_resolv_rpa_cache.cnt++;
+    }
+
+    g_ble_ll_resolv_rpa_cache.next++;
+    if (g_ble_ll_resolv_rpa_cache.next ==
+        MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)) {
+        g_ble_ll_resolv_rpa_cache.next = 0;
+    }
+
+    OS_EXIT_CRITICAL(sr);
+}
+
+void
+ble_ll_resolv_rpa_cache_stats_get(struct ble_ll_resolv_rpa_cache_stats *stats,
+                                  int reset)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+
+    *stats = g_ble_ll_resolv_rpa_cache_stats;
+
+    if (reset) {
+        memset(&g_ble_ll_resolv_rpa_cache_stats, 0,
+               sizeof(g_ble_ll_resolv_rpa_cache_stats));
+    }
+
+    OS_EXIT_CRITICAL(sr);
+}
+#else
+static inline void
+ble_ll_resolv_rpa_cache_flush(void)
+{
+}
+#endif
+
 static void
 generate_rpa(const uint8_t *irk, uint8_t *rpa)
 {
@@ -145,6 +296,9 @@ ble_ll_resolv_rpa_timer_cb(struct ble_npl_event *ev)
     uint8_t rpa[6];
 #endif
 
+    /* Peers are expected to change their RPAs at about the same time */
+    ble_ll_resolv_rpa_cache_flush();
+
     rl = &g_ble_ll_resolv_list[0];
     for (i = 0; i < g_ble_ll_resolv_data.rl_cnt; ++i) {
         if (rl->rl_has_local) {
@@ -223,6 +377,7 @@ ble_ll_resolv_list_clr(void)
     g_ble_ll_resolv_data.rl_cnt_hw = 0;
     g_ble_ll_resolv_data.rl_cnt = 0;
     ble_hw_resolv_list_clear();
+    ble_ll_resolv_rpa_cache_flush();
 
     /* stop RPA timer when clearing RL */
     ble_npl_callout_stop(&g_ble_ll_resolv_data.rpa_timer);
@@ -336,6 +491,8 @@ ble_ll_resolv_list_add(const uint8_t *cmdbuf, uint8_t len)
         return BLE_ERR_INV_HCI_CMD_PARMS;
     }
 
+    ble_ll_resolv_rpa_cache_flush();
+
     /* we keep this sorted in a way that entries with peer_irk are first */
     if (ble_ll_resolv_irk_nonzero(cmd->peer_irk)) {
         memmove(&g_ble_ll_resolv_list[g_ble_ll_resolv_data.rl_cnt_hw + 1],
@@ -380,6 +537,11 @@ ble_ll_resolv_list_add(const uint8_t *cmdbuf, uint8_t len)
     if (rl->rl_has_peer) {
         rc = ble_hw_resolv_list_add(rl->rl_peer_irk);
         BLE_LL_ASSERT(rc == BLE_ERR_SUCCESS);
+#if MYNEWT_VAL(BLE_LL_RESOLV_SW_AES)
+        tc_aes128_set_encrypt_key(
+            &g_ble_ll_resolv_peer_sched[g_ble_ll_resolv_data.rl_cnt_hw],
+            rl->rl_peer_irk);
+#endif
         g_ble_ll_resolv_data.rl_cnt_hw++;
     }
 
@@ -421,6 +583,8 @@ ble_ll_resolv_list_rmv(const uint8_t *cmdbuf, uint8_t len)
     if (position) {
         BLE_LL_ASSERT(position <= g_ble_ll_resolv_data.rl_cnt);
 
+        ble_ll_resolv_rpa_cache_flush();
+
         memmove(&g_ble_ll_resolv_list[position - 1],
                 &g_ble_ll_resolv_list[position],
                 (g_ble_ll_resolv_data.rl_cnt - position) *
@@ -431,6 +595,12 @@ ble_ll_resolv_list_rmv(const uint8_t *cmdbuf, uint8_t len)
         if (position <= g_ble_ll_resolv_data.rl_cnt_hw) {
             ble_hw_resolv_list_rmv(position - 1);
             g_ble_ll_resolv_data.rl_cnt_hw--;
+#if MYNEWT_VAL(BLE_LL_RESOLV_SW_AES)
+            memmove(&g_ble_ll_resolv_peer_sched[position - 1],
+                    &g_ble_ll_resolv_peer_sched[position],
+                    (g_ble_ll_resolv_data.rl_cnt_hw - position + 1) *
+                    sizeof(g_ble_ll_resolv_peer_sched[0]));
+#endif
         }
 
         /* stop RPA timer if list is empty */
@@ -767,18 +937,75 @@ ble_ll_resolv_rpa(const uint8_t *rpa, const uint8_t *irk)
     return rc;
 }
 
+#if MYNEWT_VAL(BLE_LL_RESOLV_SW_AES)
+/**
+ * Resolves an RPA against every peer IRK on the resolving list in
+ * software, using the key schedules prepared when entries were added.
+ * The plaintext is built once for the whole batch.
+ *
+ * @return int Index on resolving list, or -1 if the RPA did not resolve.
+ */
+static int
+ble_ll_resolv_peer_rpa_batch(const uint8_t *rpa)
+{
+    uint8_t plain_text[16];
+    uint8_t cipher_text[16];
+    int i;
+
+    memset(plain_text, 0, 13);
+    plain_text[13] = rpa[5];
+    plain_text[14] = rpa[4];
+    plain_text[15] = rpa[3];
+
+    for (i = 0; i < g_ble_ll_resolv_data.rl_cnt_hw; i++) {
+        tc_aes_encrypt(cipher_text, plain_text,
+                       &g_ble_ll_resolv_peer_sched[i]);
+        if ((cipher_text[15] == rpa[0]) && (cipher_text[14] == rpa[1]) &&
+            (cipher_text[13] == rpa[2])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+#endif
+
 int
 ble_ll_resolv_peer_rpa_any(const uint8_t *rpa)
 {
+#if MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)
+    uint32_t gen;
+#endif
+    int rl_idx;
+#if !MYNEWT_VAL(BLE_LL_RESOLV_SW_AES)
     int i;
+#endif
 
+#if MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)
+    if (ble_ll_resolv_rpa_cache_get(rpa, &rl_idx, &gen)) {
+        STATS_INC(ble_ll_stats, rpa_cache_hits);
+        return rl_idx;
+    }
+    STATS_INC(ble_ll_stats, rpa_cache_misses);
+#endif
+
+#if MYNEWT_VAL(BLE_LL_RESOLV_SW_AES)
+    rl_idx = ble_ll_resolv_peer_rpa_batch(rpa);
+#else
+    rl_idx = -1;
     for (i = 0; i < g_ble_ll_resolv_data.rl_cnt_hw; i++) {
         if (ble_ll_resolv_rpa(rpa, g_ble_ll_resolv_list[i].rl_peer_irk)) {
-            return i;
+            rl_idx = i;
+            break;
         }
     }
+#endif
 
-    return -1;
+#if MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)
+    ble_ll_resolv_rpa_cache_put(rpa, rl_idx, gen);
+#endif
+
+    return rl_idx;
 }
 
 /**
@@ -826,6 +1053,8 @@ ble_ll_resolv_init(void)
 #if MYNEWT_VAL(BLE_LL_HCI_VS_LOCAL_IRK)
     memset(&g_local_irk, 0, sizeof(g_local_irk));
 #endif
+
+    ble_ll_resolv_rpa_cache_flush();
 }
 
 #endif  /* if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PRIVACY) */
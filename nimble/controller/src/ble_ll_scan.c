@@ -119,15 +119,38 @@ struct ble_ll_scan_dup_entry {
     uint8_t flags;      /* use BLE_LL_SCAN_DUP_F_xxx */
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
     uint16_t adi;
+#endif
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGING_MS)
+    ble_npl_time_t report_time;
 #endif
     TAILQ_ENTRY(ble_ll_scan_dup_entry) link;
+    SLIST_ENTRY(ble_ll_scan_dup_entry) hash_link;
 };
 
+/*
+ * Duplicate filter entries are kept on an LRU list (most recent first) so
+ * the least recently heard advertiser is evicted when the pool runs out,
+ * and are also hashed by type and address so lookups in the RX path do not
+ * need to walk the whole list.
+ */
+#if MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS)
+#define BLE_LL_SCAN_DUP_HASH_SIZE   MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS)
+#else
+#define BLE_LL_SCAN_DUP_HASH_SIZE   (1)
+#endif
+
+SLIST_HEAD(ble_ll_scan_dup_bucket, ble_ll_scan_dup_entry);
+
 static os_membuf_t g_scan_dup_mem[ OS_MEMPOOL_SIZE(
                                    MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS),
                                    sizeof(struct ble_ll_scan_dup_entry)) ];
 static struct os_mempool g_scan_dup_pool;
 static TAILQ_HEAD(ble_ll_scan_dup_list, ble_ll_scan_dup_entry) g_scan_dup_list;
+static struct ble_ll_scan_dup_bucket
+    g_scan_dup_hash[BLE_LL_SCAN_DUP_HASH_SIZE];
+
+static void
+ble_ll_scan_dup_clear(void);
 
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
 static int
@@ -611,7 +634,7 @@ ble_ll_hci_send_dir_adv_report(const uint8_t *addr, uint8_t addr_type,
     return ble_ll_hci_event_send(hci_ev);
 }
 
-static int
+int
 ble_ll_scan_dup_update_legacy(uint8_t addr_type, const uint8_t *addr,
                               uint8_t subev, uint8_t evtype)
 {
@@ -638,6 +661,10 @@ ble_ll_scan_dup_update_legacy(uint8_t addr_type, const uint8_t *addr,
         }
     }
 
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGING_MS)
+    e->report_time = ble_npl_time_get();
+#endif
+
     return 0;
 }
 
@@ -958,8 +985,7 @@ ble_ll_scan_sm_start(struct ble_ll_scan_sm *scansm)
     /* Forget filtered advertisers from previous scan. */
     g_ble_ll_scan_num_rsp_advs = 0;
 
-    os_mempool_clear(&g_scan_dup_pool);
-    TAILQ_INIT(&g_scan_dup_list);
+    ble_ll_scan_dup_clear();
 
     /*
      * First scan window can start when RF is enabled. Add 1 tick since we are
@@ -1760,32 +1786,110 @@ ble_ll_scan_wfr_timer_exp(void)
     ble_phy_restart_rx();
 }
 
-static inline void
-ble_ll_scan_dup_move_to_head(struct ble_ll_scan_dup_entry *e)
+static struct ble_ll_scan_dup_bucket *
+ble_ll_scan_dup_bucket(uint8_t type, const uint8_t *addr)
+{
+    static const uint8_t anon_addr[BLE_DEV_ADDR_LEN];
+    uint32_t hash;
+    int i;
+
+    /* Anonymous entries are stored with an all-zero address */
+    if (!addr) {
+        addr = anon_addr;
+    }
+
+    /* FNV-1a */
+    hash = (2166136261u ^ type) * 16777619u;
+    for (i = 0; i < BLE_DEV_ADDR_LEN; i++) {
+        hash = (hash ^ addr[i]) * 16777619u;
+    }
+
+    return &g_scan_dup_hash[hash % BLE_LL_SCAN_DUP_HASH_SIZE];
+}
+
+/**
+ * Finds the duplicate filter entry for an advertiser and makes it the most
+ * recently used one. A NULL address matches anonymous entries of the type.
+ */
+static struct ble_ll_scan_dup_entry *
+ble_ll_scan_dup_find(uint8_t type, const uint8_t *addr)
 {
+    struct ble_ll_scan_dup_bucket *bucket;
+    struct ble_ll_scan_dup_entry *e;
+
+    bucket = ble_ll_scan_dup_bucket(type, addr);
+    SLIST_FOREACH(e, bucket, hash_link) {
+        if ((e->type == type) &&
+            (!addr || !memcmp(e->addr, addr, BLE_DEV_ADDR_LEN))) {
+            break;
+        }
+    }
+
+    if (!e) {
+        STATS_INC(ble_ll_stats, scan_dup_misses);
+        return NULL;
+    }
+
+    STATS_INC(ble_ll_stats, scan_dup_hits);
+
     if (e != TAILQ_FIRST(&g_scan_dup_list)) {
         TAILQ_REMOVE(&g_scan_dup_list, e, link);
         TAILQ_INSERT_HEAD(&g_scan_dup_list, e, link);
     }
+
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGING_MS)
+    /* Report the advertiser again once the filter entry has aged */
+    if (e->flags &&
+        (ble_npl_time_get() - e->report_time >=
+         ble_npl_time_ms_to_ticks32(MYNEWT_VAL(BLE_LL_SCAN_DUP_AGING_MS)))) {
+        e->flags = 0;
+    }
+#endif
+
+    return e;
 }
 
-static inline struct ble_ll_scan_dup_entry *
-ble_ll_scan_dup_new(void)
+/**
+ * Adds a new entry as the most recently used one, evicting the least
+ * recently used entry if the pool is exhausted.
+ */
+static struct ble_ll_scan_dup_entry *
+ble_ll_scan_dup_new(uint8_t type, const uint8_t *addr)
 {
+    struct ble_ll_scan_dup_bucket *bucket;
     struct ble_ll_scan_dup_entry *e;
 
     e = os_memblock_get(&g_scan_dup_pool);
     if (!e) {
         e = TAILQ_LAST(&g_scan_dup_list, ble_ll_scan_dup_list);
         TAILQ_REMOVE(&g_scan_dup_list, e, link);
+        bucket = ble_ll_scan_dup_bucket(e->type, e->addr);
+        SLIST_REMOVE(bucket, e, ble_ll_scan_dup_entry, hash_link);
+        STATS_INC(ble_ll_stats, scan_dup_evictions);
     }
 
     memset(e, 0, sizeof(*e));
+    e->type = type;
+    if (addr) {
+        memcpy(e->addr, addr, BLE_DEV_ADDR_LEN);
+    }
+
+    TAILQ_INSERT_HEAD(&g_scan_dup_list, e, link);
+    bucket = ble_ll_scan_dup_bucket(type, addr);
+    SLIST_INSERT_HEAD(bucket, e, hash_link);
 
     return e;
 }
 
-static int
+static void
+ble_ll_scan_dup_clear(void)
+{
+    os_mempool_clear(&g_scan_dup_pool);
+    TAILQ_INIT(&g_scan_dup_list);
+    memset(g_scan_dup_hash, 0, sizeof(g_scan_dup_hash));
+}
+
+int
 ble_ll_scan_dup_check_legacy(uint8_t addr_type, uint8_t *addr, uint8_t pdu_type)
 {
     struct ble_ll_scan_dup_entry *e;
@@ -1794,12 +1898,7 @@ ble_ll_scan_dup_check_legacy(uint8_t addr_type, uint8_t *addr, uint8_t pdu_type)
 
     type = BLE_LL_SCAN_ENTRY_TYPE_LEGACY(addr_type);
 
-    TAILQ_FOREACH(e, &g_scan_dup_list, link) {
-        if ((e->type == type) && !memcmp(e->addr, addr, 6)) {
-            break;
-        }
-    }
-
+    e = ble_ll_scan_dup_find(type, addr);
     if (e) {
         if (pdu_type == BLE_ADV_PDU_TYPE_ADV_DIRECT_IND) {
             rc = e->flags & BLE_LL_SCAN_DUP_F_DIR_ADV_REPORT_SENT;
@@ -1808,17 +1907,10 @@ ble_ll_scan_dup_check_legacy(uint8_t addr_type, uint8_t *addr, uint8_t pdu_type)
         } else {
             rc = e->flags & BLE_LL_SCAN_DUP_F_ADV_REPORT_SENT;
         }
-
-        ble_ll_scan_dup_move_to_head(e);
     } else {
         rc = 0;
 
-        e = ble_ll_scan_dup_new();
-        e->flags = 0;
-        e->type = type;
-        memcpy(e->addr, addr, 6);
-
-        TAILQ_INSERT_HEAD(&g_scan_dup_list, e, link);
+        ble_ll_scan_dup_new(type, addr);
     }
 
     return rc;
@@ -1839,13 +1931,7 @@ ble_ll_scan_dup_check_ext(uint8_t addr_type, uint8_t *addr, bool has_aux,
 
     type = BLE_LL_SCAN_ENTRY_TYPE_EXT(addr_type, has_aux, is_anon, adi);
 
-    TAILQ_FOREACH(e, &g_scan_dup_list, link) {
-        if ((e->type == type) &&
-            (is_anon || !memcmp(e->addr, addr, BLE_DEV_ADDR_LEN))) {
-            break;
-        }
-    }
-
+    e = ble_ll_scan_dup_find(type, addr);
     if (e) {
         if (e->adi != adi) {
             rc = 0;
@@ -1855,20 +1941,11 @@ ble_ll_scan_dup_check_ext(uint8_t addr_type, uint8_t *addr, bool has_aux,
         } else {
             rc = e->flags & BLE_LL_SCAN_DUP_F_ADV_REPORT_SENT;
         }
-
-        ble_ll_scan_dup_move_to_head(e);
     } else {
         rc = 0;
 
-        e = ble_ll_scan_dup_new();
-        e->flags = 0;
-        e->type = type;
+        e = ble_ll_scan_dup_new(type, addr);
         e->adi = adi;
-        if (!is_anon) {
-            memcpy(e->addr, addr, 6);
-        }
-
-        TAILQ_INSERT_HEAD(&g_scan_dup_list, e, link);
     }
 
     return rc;
@@ -1896,6 +1973,9 @@ ble_ll_scan_dup_update_ext(uint8_t addr_type, uint8_t *addr, bool has_aux,
     BLE_LL_ASSERT(e && e->type == type && (is_anon || !memcmp(e->addr, addr, 6)));
 
     e->flags |= BLE_LL_SCAN_DUP_F_ADV_REPORT_SENT;
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGING_MS)
+    e->report_time = ble_npl_time_get();
+#endif
 
     return 0;
 }
@@ -2744,8 +2824,7 @@ ble_ll_scan_reset(void)
     g_ble_ll_scan_num_rsp_advs = 0;
     memset(&g_ble_ll_scan_rsp_advs[0], 0, sizeof(g_ble_ll_scan_rsp_advs));
 
-    os_mempool_clear(&g_scan_dup_pool);
-    TAILQ_INIT(&g_scan_dup_list);
+    ble_ll_scan_dup_clear();
 
     /* Call the common init function again */
     ble_ll_scan_common_init();
@@ -2772,7 +2851,7 @@ ble_ll_scan_init(void)
                           "ble_ll_scan_dup_pool");
     BLE_LL_ASSERT(err == 0);
 
-    TAILQ_INIT(&g_scan_dup_list);
+    ble_ll_scan_dup_clear();
 
     ble_ll_scan_common_init();
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
@@ -87,6 +87,193 @@ static struct ble_ll_sched_css g_ble_ll_sched_css = {
 static TAILQ_HEAD(ll_sched_qhead, ble_ll_sched_item) g_ble_ll_sched_q;
 static uint8_t g_ble_ll_sched_q_head_changed;
 
+#if MYNEWT_VAL(BLE_LL_SCHED_INDEX)
+/*
+ * Index of schedule queue. This is a treap which in-order traversal gives the
+ * same order as schedule queue. Since items on schedule queue never overlap,
+ * both start and end times are monotonic in queue order so tree can be
+ * searched by either of them. Node priority is derived from item address so
+ * no extra state is needed in schedule item.
+ */
+static struct ble_ll_sched_item *g_ble_ll_sched_idx_root;
+#endif
+
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+static struct ble_ll_sched_stats g_ble_ll_sched_stats;
+static uint32_t g_ble_ll_sched_stats_ticks;
+
+#define BLE_LL_SCHED_STATS_INC(_name)       (g_ble_ll_sched_stats._name++)
+#else
+#define BLE_LL_SCHED_STATS_INC(_name)
+#endif
+
+#if MYNEWT_VAL(BLE_LL_SCHED_INDEX)
+static inline uint32_t
+ble_ll_sched_idx_prio(struct ble_ll_sched_item *item)
+{
+    /* Fibonacci hashing spreads addresses of items allocated in arrays */
+    return (uint32_t)(uintptr_t)item * 2654435761u;
+}
+
+static void
+ble_ll_sched_idx_replace(struct ble_ll_sched_item *parent,
+                         struct ble_ll_sched_item *old,
+                         struct ble_ll_sched_item *new)
+{
+    if (!parent) {
+        g_ble_ll_sched_idx_root = new;
+    } else if (parent->idx_left == old) {
+        parent->idx_left = new;
+    } else {
+        parent->idx_right = new;
+    }
+
+    if (new) {
+        new->idx_parent = parent;
+    }
+}
+
+/* Rotates item so it takes place of its parent */
+static void
+ble_ll_sched_idx_rotate_up(struct ble_ll_sched_item *item)
+{
+    struct ble_ll_sched_item *parent;
+    struct ble_ll_sched_item *child;
+
+    parent = item->idx_parent;
+
+    ble_ll_sched_idx_replace(parent->idx_parent, parent, item);
+
+    if (parent->idx_left == item) {
+        child = item->idx_right;
+        parent->idx_left = child;
+        item->idx_right = parent;
+    } else {
+        child = item->idx_left;
+        parent->idx_right = child;
+        item->idx_left = parent;
+    }
+
+    if (child) {
+        child->idx_parent = parent;
+    }
+    parent->idx_parent = item;
+}
+
+/* Adds item to index; item shall already be linked on schedule queue */
+static void
+ble_ll_sched_idx_insert(struct ble_ll_sched_item *item)
+{
+    struct ble_ll_sched_item *prev;
+    struct ble_ll_sched_item *next;
+
+    item->idx_left = NULL;
+    item->idx_right = NULL;
+
+    /* Of two adjacent items, either next one has no left child or previous
+     * one has no right child. Link item as a leaf there to keep in-order
+     * traversal same as queue order.
+     */
+    next = TAILQ_NEXT(item, link);
+    if (next && !next->idx_left) {
+        next->idx_left = item;
+        item->idx_parent = next;
+    } else {
+        prev = TAILQ_PREV(item, ll_sched_qhead, link);
+        if (prev) {
+            BLE_LL_ASSERT(!prev->idx_right);
+            prev->idx_right = item;
+            item->idx_parent = prev;
+        } else {
+            g_ble_ll_sched_idx_root = item;
+            item->idx_parent = NULL;
+        }
+    }
+
+    while (item->idx_parent && (ble_ll_sched_idx_prio(item) >
+                                ble_ll_sched_idx_prio(item->idx_parent))) {
+        ble_ll_sched_idx_rotate_up(item);
+    }
+}
+
+static void
+ble_ll_sched_idx_remove(struct ble_ll_sched_item *item)
+{
+    struct ble_ll_sched_item *child;
+
+    while (item->idx_left && item->idx_right) {
+        if (ble_ll_sched_idx_prio(item->idx_left) >
+            ble_ll_sched_idx_prio(item->idx_right)) {
+            ble_ll_sched_idx_rotate_up(item->idx_left);
+        } else {
+            ble_ll_sched_idx_rotate_up(item->idx_right);
+        }
+    }
+
+    child = item->idx_left ? item->idx_left : item->idx_right;
+    ble_ll_sched_idx_replace(item->idx_parent, item, child);
+}
+
+/* Finds 1st item on schedule queue which ends after given time */
+static struct ble_ll_sched_item *
+ble_ll_sched_idx_find(uint32_t time)
+{
+    struct ble_ll_sched_item *node;
+    struct ble_ll_sched_item *found;
+
+    node = g_ble_ll_sched_idx_root;
+    found = NULL;
+
+    while (node) {
+        if (LL_TMR_GT(node->end_time, time)) {
+            found = node;
+            node = node->idx_left;
+        } else {
+            node = node->idx_right;
+        }
+    }
+
+    return found;
+}
+#endif
+
+static inline void
+ble_ll_sched_q_insert_head(struct ble_ll_sched_item *sch)
+{
+    TAILQ_INSERT_HEAD(&g_ble_ll_sched_q, sch, link);
+#if MYNEWT_VAL(BLE_LL_SCHED_INDEX)
+    ble_ll_sched_idx_insert(sch);
+#endif
+}
+
+static inline void
+ble_ll_sched_q_insert_before(struct ble_ll_sched_item *entry,
+                             struct ble_ll_sched_item *sch)
+{
+    TAILQ_INSERT_BEFORE(entry, sch, link);
+#if MYNEWT_VAL(BLE_LL_SCHED_INDEX)
+    ble_ll_sched_idx_insert(sch);
+#endif
+}
+
+static inline void
+ble_ll_sched_q_insert_tail(struct ble_ll_sched_item *sch)
+{
+    TAILQ_INSERT_TAIL(&g_ble_ll_sched_q, sch, link);
+#if MYNEWT_VAL(BLE_LL_SCHED_INDEX)
+    ble_ll_sched_idx_insert(sch);
+#endif
+}
+
+static inline void
+ble_ll_sched_q_remove(struct ble_ll_sched_item *sch)
+{
+    TAILQ_REMOVE(&g_ble_ll_sched_q, sch, link);
+#if MYNEWT_VAL(BLE_LL_SCHED_INDEX)
+    ble_ll_sched_idx_remove(sch);
+#endif
+}
+
 static int
 preempt_any(struct ble_ll_sched_item *sch,
             struct ble_ll_sched_item *item)
@@ -140,8 +327,9 @@ ble_ll_sched_preempt(struct ble_ll_sched_item *sch,
     do {
         next = TAILQ_NEXT(entry, link);
 
-        TAILQ_REMOVE(&g_ble_ll_sched_q, entry, link);
+        ble_ll_sched_q_remove(entry);
         entry->enqueued = 0;
+        BLE_LL_SCHED_STATS_INC(preempted);
 
         switch (entry->sched_type) {
 #if MYNEWT_VAL(BLE_LL_ROLE_CENTRAL) || MYNEWT_VAL(BLE_LL_ROLE_PERIPHERAL)
@@ -243,14 +431,21 @@ ble_ll_sched_insert(struct ble_ll_sched_item *sch, uint32_t max_delay,
 
     first = TAILQ_FIRST(&g_ble_ll_sched_q);
     if (!first) {
-        TAILQ_INSERT_HEAD(&g_ble_ll_sched_q, sch, link);
+        ble_ll_sched_q_insert_head(sch);
         sch->enqueued = 1;
         goto done;
     }
 
-    TAILQ_FOREACH(entry, &g_ble_ll_sched_q, link) {
+#if MYNEWT_VAL(BLE_LL_SCHED_INDEX)
+    /* Items which end before our item starts cannot overlap it */
+    entry = ble_ll_sched_idx_find(sch->start_time);
+#else
+    entry = first;
+#endif
+
+    for (; entry; entry = TAILQ_NEXT(entry, link)) {
         if (LL_TMR_LEQ(sch->end_time, entry->start_time)) {
-            TAILQ_INSERT_BEFORE(entry, sch, link);
+            ble_ll_sched_q_insert_before(entry, sch);
             sch->enqueued = 1;
             goto done;
         }
@@ -267,6 +462,7 @@ ble_ll_sched_insert(struct ble_ll_sched_item *sch, uint32_t max_delay,
                 }
             } else {
                 preempt_first = NULL;
+                BLE_LL_SCHED_STATS_INC(collisions);
                 /*
                  * For the 32768 Hz crystal in nrf chip, 1 tick is 30.517us.
                  * The connection state machine use anchor point to store the
@@ -293,11 +489,19 @@ ble_ll_sched_insert(struct ble_ll_sched_item *sch, uint32_t max_delay,
     }
 
     if (!entry) {
-        TAILQ_INSERT_TAIL(&g_ble_ll_sched_q, sch, link);
+        ble_ll_sched_q_insert_tail(sch);
         sch->enqueued = 1;
     }
 
 done:
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+    if (sch->enqueued) {
+        BLE_LL_SCHED_STATS_INC(inserted);
+    } else {
+        BLE_LL_SCHED_STATS_INC(insert_failed);
+    }
+#endif
+
     if (preempt_first) {
         BLE_LL_ASSERT(sch->enqueued);
         ble_ll_sched_preempt(sch, preempt_first);
@@ -891,7 +1095,7 @@ ble_ll_sched_rmv_elem(struct ble_ll_sched_item *sch)
             first_removed = 1;
         }
 
-        TAILQ_REMOVE(&g_ble_ll_sched_q, sch, link);
+        ble_ll_sched_q_remove(sch);
         sch->enqueued = 0;
 
         rc = 0;
@@ -929,7 +1133,7 @@ ble_ll_sched_rmv_elem_type(uint8_t type, sched_remove_cb_func remove_cb)
         if (entry->sched_type != type) {
             continue;
         }
-        TAILQ_REMOVE(&g_ble_ll_sched_q, entry, link);
+        ble_ll_sched_q_remove(entry);
         remove_cb(entry);
         entry->enqueued = 0;
     }
@@ -1033,6 +1237,36 @@ sched:
     return rc;
 }
 
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+static void
+ble_ll_sched_stats_window_update(void)
+{
+    uint32_t now;
+
+    now = ble_ll_tmr_get();
+    g_ble_ll_sched_stats.window_us +=
+        ble_ll_tmr_t2u(now - g_ble_ll_sched_stats_ticks);
+    g_ble_ll_sched_stats_ticks = now;
+}
+
+void
+ble_ll_sched_stats_get(struct ble_ll_sched_stats *stats, int reset)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+
+    ble_ll_sched_stats_window_update();
+    *stats = g_ble_ll_sched_stats;
+
+    if (reset) {
+        memset(&g_ble_ll_sched_stats, 0, sizeof(g_ble_ll_sched_stats));
+    }
+
+    OS_EXIT_CRITICAL(sr);
+}
+#endif
+
 /**
  * Run the BLE scheduler. Iterate through all items on the schedule queue.
  *
@@ -1064,10 +1298,16 @@ ble_ll_sched_run(void *arg)
 #endif
 
         /* Remove schedule item and execute the callback */
-        TAILQ_REMOVE(&g_ble_ll_sched_q, sch, link);
+        ble_ll_sched_q_remove(sch);
         sch->enqueued = 0;
         g_ble_ll_sched_q_head_changed = 1;
 
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+        ble_ll_sched_stats_window_update();
+        g_ble_ll_sched_stats.busy_us +=
+            ble_ll_tmr_t2u(sch->end_time - sch->start_time);
+#endif
+
         ble_ll_sched_execute_item(sch);
 
         ble_ll_sched_restart();
@@ -1186,6 +1426,11 @@ ble_ll_sched_init(void)
 
     g_ble_ll_sched_q_head_changed = 0;
 
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+    memset(&g_ble_ll_sched_stats, 0, sizeof(g_ble_ll_sched_stats));
+    g_ble_ll_sched_stats_ticks = ble_ll_tmr_get();
+#endif
+
 #if MYNEWT_VAL(BLE_LL_CONN_STRICT_SCHED)
     memset(&g_ble_ll_sched_css, 0, sizeof (g_ble_ll_sched_css));
 #if !MYNEWT_VAL(BLE_LL_CONN_STRICT_SCHED_FIXED)
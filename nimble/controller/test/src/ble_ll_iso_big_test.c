@@ -0,0 +1,181 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "nimble/ble.h"
+#include "nimble/hci_common.h"
+#include "controller/ble_ll.h"
+#include "controller/ble_ll_adv.h"
+#include "controller/ble_ll_iso_big.h"
+#include "controller/ble_ll_isoal.h"
+#include "testutil/testutil.h"
+
+#if MYNEWT_VAL(BLE_LL_ISO_BROADCASTER)
+
+#define BLE_LL_ISO_BIG_TEST_ADV_HANDLE  (0)
+#define BLE_LL_ISO_BIG_TEST_BIG_HANDLE  (0)
+/* LC3 frame of 7.5ms at 32kbps */
+#define BLE_LL_ISO_BIG_TEST_SDU_LEN     (30)
+
+static void
+ble_ll_iso_big_test_adv_setup(void)
+{
+    struct ble_hci_le_set_ext_adv_params_cp adv_cmd;
+    struct ble_hci_le_set_periodic_adv_params_cp sync_cmd;
+    struct ble_hci_le_set_ext_adv_params_rp adv_rsp;
+    uint8_t rsplen;
+    int rc;
+
+    memset(&adv_cmd, 0, sizeof(adv_cmd));
+    adv_cmd.adv_handle = BLE_LL_ISO_BIG_TEST_ADV_HANDLE;
+    /* Non-connectable and non-scannable extended advertising */
+    adv_cmd.props = htole16(0);
+    put_le24(adv_cmd.pri_itvl_min, 0x00a0);
+    put_le24(adv_cmd.pri_itvl_max, 0x00a0);
+    adv_cmd.pri_chan_map = BLE_HCI_ADV_CHANMASK_DEF;
+    adv_cmd.tx_power = 127;
+    adv_cmd.pri_phy = BLE_HCI_LE_PHY_1M;
+    adv_cmd.sec_phy = BLE_HCI_LE_PHY_1M;
+
+    rsplen = sizeof(adv_rsp);
+    rc = ble_ll_adv_ext_set_param((uint8_t *)&adv_cmd, sizeof(adv_cmd),
+                                  (uint8_t *)&adv_rsp, &rsplen);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    sync_cmd.adv_handle = BLE_LL_ISO_BIG_TEST_ADV_HANDLE;
+    sync_cmd.min_itvl = htole16(0x0050);
+    sync_cmd.max_itvl = htole16(0x0050);
+    sync_cmd.props = htole16(0);
+
+    rc = ble_ll_adv_periodic_set_param((uint8_t *)&sync_cmd, sizeof(sync_cmd));
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+/* Creates BIG with single BIS using LE Create BIG and returns its ISOAL mux */
+static struct ble_ll_isoal_mux *
+ble_ll_iso_big_test_create(uint8_t framing, uint32_t sdu_interval,
+                           uint16_t max_transport_latency)
+{
+    struct ble_hci_le_create_big_cp cmd;
+    struct ble_ll_isoal_mux *mux;
+    int rc;
+
+    ble_ll_iso_big_test_adv_setup();
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.big_handle = BLE_LL_ISO_BIG_TEST_BIG_HANDLE;
+    cmd.adv_handle = BLE_LL_ISO_BIG_TEST_ADV_HANDLE;
+    cmd.num_bis = 1;
+    put_le24(cmd.sdu_interval, sdu_interval);
+    cmd.max_sdu = htole16(BLE_LL_ISO_BIG_TEST_SDU_LEN);
+    cmd.max_transport_latency = htole16(max_transport_latency);
+    cmd.rtn = 0;
+    cmd.phy = BLE_HCI_LE_PHY_1M_PREF_MASK;
+    cmd.framing = framing;
+
+    rc = ble_ll_iso_big_hci_create((uint8_t *)&cmd, sizeof(cmd));
+    TEST_ASSERT_FATAL(rc == 0);
+
+    mux = ble_ll_iso_big_find_mux_by_handle(
+                    BLE_LL_CONN_HANDLE(BLE_LL_CONN_HANDLE_TYPE_BIS, 0));
+    TEST_ASSERT_FATAL(mux != NULL);
+
+    return mux;
+}
+
+static void
+ble_ll_iso_big_test_cleanup(void)
+{
+    ble_ll_iso_big_reset();
+    ble_ll_adv_reset();
+}
+
+TEST_CASE_SELF(ble_ll_iso_big_test_create_unframed)
+{
+    struct ble_ll_isoal_mux *mux;
+
+    sysinit();
+
+    /* 10ms SDUs over 10ms ISO interval, 1 SDU in 1 PDU */
+    mux = ble_ll_iso_big_test_create(0, 10000, 20);
+
+    TEST_ASSERT(!mux->framed);
+    TEST_ASSERT(mux->bn == 1);
+    TEST_ASSERT(mux->sdu_per_interval == 1);
+    TEST_ASSERT(mux->max_pdu == BLE_LL_ISO_BIG_TEST_SDU_LEN);
+
+    ble_ll_iso_big_test_cleanup();
+}
+
+TEST_CASE_SELF(ble_ll_iso_big_test_create_framed)
+{
+    struct ble_ll_isoal_mux *mux;
+
+    sysinit();
+
+    /* 7.5ms SDUs over 10ms ISO interval, so up to 2 SDUs start in each event
+     * and single PDU fits both with their segmentation headers.
+     */
+    mux = ble_ll_iso_big_test_create(1, 7500, 20);
+
+    TEST_ASSERT(mux->framed);
+    TEST_ASSERT(mux->bn == 1);
+    TEST_ASSERT(mux->sdu_per_interval == 2);
+    TEST_ASSERT(mux->max_pdu == 2 * (BLE_LL_ISO_BIG_TEST_SDU_LEN +
+                                     BLE_LL_ISOAL_SEGHDR_LEN +
+                                     BLE_LL_ISOAL_TIME_OFFSET_LEN) +
+                                BLE_LL_ISOAL_SEGHDR_LEN);
+
+    ble_ll_iso_big_test_cleanup();
+}
+
+TEST_CASE_SELF(ble_ll_iso_big_test_create_framed_latency)
+{
+    struct ble_ll_isoal_mux *mux;
+
+    sysinit();
+
+    /* 10ms ISO interval does not fit in 15ms transport latency, so 7.5ms
+     * ISO interval is used instead.
+     */
+    mux = ble_ll_iso_big_test_create(1, 7500, 15);
+
+    TEST_ASSERT(mux->framed);
+    TEST_ASSERT(mux->bn == 1);
+    TEST_ASSERT(mux->sdu_per_interval == 1);
+    TEST_ASSERT(mux->max_pdu == BLE_LL_ISO_BIG_TEST_SDU_LEN +
+                                BLE_LL_ISOAL_SEGHDR_LEN +
+                                BLE_LL_ISOAL_TIME_OFFSET_LEN +
+                                BLE_LL_ISOAL_SEGHDR_LEN);
+
+    ble_ll_iso_big_test_cleanup();
+}
+
+TEST_SUITE(ble_ll_iso_big_test_suite)
+{
+    ble_ll_iso_big_test_create_unframed();
+    ble_ll_iso_big_test_create_framed();
+    ble_ll_iso_big_test_create_framed_latency();
+}
+
+#endif /* BLE_LL_ISO_BROADCASTER */
@@ -0,0 +1,292 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "nimble/ble.h"
+#include "nimble/hci_common.h"
+#include "controller/ble_ll.h"
+#include "controller/ble_ll_isoal.h"
+#include "controller/ble_ll_pdu.h"
+#include "controller/ble_phy.h"
+#include "testutil/testutil.h"
+
+#if MYNEWT_VAL(BLE_LL_ISO)
+
+#define BLE_LL_ISOAL_TEST_BASE_TS   (1000000)
+/* LC3 frame of 7.5ms at 32kbps */
+#define BLE_LL_ISOAL_TEST_SDU_LEN   (30)
+#define BLE_LL_ISOAL_TEST_SDU_INTVL (7500)
+
+struct ble_ll_isoal_test_result {
+    /* SDUs passed to ISOAL and HCI ISO Data packets they were sent in */
+    uint16_t sdu_tx;
+    uint16_t pkt_tx;
+    /* HCI ISO Data packets reported as completed */
+    uint16_t pkt_completed;
+    /* PDUs with data and total airtime of all PDUs on 2M PHY */
+    uint16_t pdu_data;
+    uint32_t airtime_us;
+    /* SDUs delivered by receiver */
+    uint16_t sdu_rx_valid;
+    uint16_t sdu_rx_lost;
+};
+
+static uint32_t ble_ll_isoal_test_sdu_interval;
+static struct ble_ll_isoal_test_result *ble_ll_isoal_test_res;
+
+static void
+ble_ll_isoal_test_sdu_tx(struct ble_ll_isoal_mux *mux, uint16_t idx,
+                         uint16_t len, uint32_t timestamp)
+{
+    struct os_mbuf *om;
+    uint8_t data[BLE_LL_ISOAL_TEST_SDU_LEN];
+    uint16_t i;
+    int rc;
+
+    for (i = 0; i < len; i++) {
+        data[i] = idx + i;
+    }
+
+    /* Every other SDU is sent in 2 HCI ISO Data packets */
+    if (idx & 1) {
+        om = os_msys_get_pkthdr(len / 2, sizeof(struct ble_mbuf_hdr));
+        TEST_ASSERT_FATAL(om != NULL);
+        rc = os_mbuf_append(om, data, len / 2);
+        TEST_ASSERT_FATAL(rc == 0);
+        ble_ll_isoal_mux_tx_pkt_in(mux, om, BLE_HCI_ISO_PB_FIRST, 1,
+                                   timestamp);
+
+        om = os_msys_get_pkthdr(len - len / 2, sizeof(struct ble_mbuf_hdr));
+        TEST_ASSERT_FATAL(om != NULL);
+        rc = os_mbuf_append(om, &data[len / 2], len - len / 2);
+        TEST_ASSERT_FATAL(rc == 0);
+        ble_ll_isoal_mux_tx_pkt_in(mux, om, BLE_HCI_ISO_PB_LAST, 0, 0);
+
+        ble_ll_isoal_test_res->pkt_tx += 2;
+    } else {
+        om = os_msys_get_pkthdr(len, sizeof(struct ble_mbuf_hdr));
+        TEST_ASSERT_FATAL(om != NULL);
+        rc = os_mbuf_append(om, data, len);
+        TEST_ASSERT_FATAL(rc == 0);
+        ble_ll_isoal_mux_tx_pkt_in(mux, om, BLE_HCI_ISO_PB_COMPLETE, 1,
+                                   timestamp);
+
+        ble_ll_isoal_test_res->pkt_tx++;
+    }
+
+    ble_ll_isoal_test_res->sdu_tx++;
+}
+
+static void
+ble_ll_isoal_test_sdu_rx(struct ble_ll_isoal_demux *demux,
+                         struct os_mbuf *om, uint32_t timestamp,
+                         uint16_t seq_num, uint8_t status)
+{
+    uint8_t data[BLE_LL_ISOAL_TEST_SDU_LEN];
+    uint16_t idx;
+    uint16_t i;
+    int rc;
+
+    if (status != BLE_HCI_ISO_PKT_STATUS_VALID) {
+        TEST_ASSERT(om == NULL);
+        ble_ll_isoal_test_res->sdu_rx_lost++;
+        return;
+    }
+
+    TEST_ASSERT_FATAL(om != NULL);
+    TEST_ASSERT_FATAL(OS_MBUF_PKTLEN(om) == BLE_LL_ISOAL_TEST_SDU_LEN);
+
+    rc = os_mbuf_copydata(om, 0, sizeof(data), data);
+    TEST_ASSERT_FATAL(rc == 0);
+    os_mbuf_free_chain(om);
+
+    /* Both modes shall restore timestamp of SDU as sent by host */
+    idx = (timestamp - BLE_LL_ISOAL_TEST_BASE_TS) /
+          ble_ll_isoal_test_sdu_interval;
+    TEST_ASSERT(timestamp == BLE_LL_ISOAL_TEST_BASE_TS +
+                             idx * ble_ll_isoal_test_sdu_interval);
+
+    for (i = 0; i < sizeof(data); i++) {
+        TEST_ASSERT_FATAL(data[i] == (uint8_t)(idx + i));
+    }
+
+    ble_ll_isoal_test_res->sdu_rx_valid++;
+}
+
+static void
+ble_ll_isoal_test_run(uint8_t framed, uint32_t iso_interval_us,
+                      uint8_t bn, uint8_t max_pdu, uint16_t num_events,
+                      uint16_t lost_event,
+                      struct ble_ll_isoal_test_result *res)
+{
+    struct ble_ll_isoal_demux demux;
+    struct ble_ll_isoal_mux mux;
+    uint8_t pdu[BLE_LL_MAX_PAYLOAD_LEN];
+    uint32_t event_ts;
+    uint32_t sdu_ts;
+    uint16_t sdu_idx;
+    uint16_t event;
+    uint8_t pdu_len;
+    uint8_t llid;
+    uint8_t idx;
+    int rc;
+
+    memset(res, 0, sizeof(*res));
+    ble_ll_isoal_test_res = res;
+    ble_ll_isoal_test_sdu_interval = BLE_LL_ISOAL_TEST_SDU_INTVL;
+
+    ble_ll_isoal_mux_init(&mux, max_pdu, iso_interval_us,
+                          BLE_LL_ISOAL_TEST_SDU_INTVL, bn, 0, framed);
+    ble_ll_isoal_demux_init(&demux, framed, ble_ll_isoal_test_sdu_rx, NULL);
+
+    sdu_idx = 0;
+
+    for (event = 0; event < num_events; event++) {
+        event_ts = BLE_LL_ISOAL_TEST_BASE_TS + event * iso_interval_us;
+
+        /* Host sends SDUs as they are generated */
+        sdu_ts = BLE_LL_ISOAL_TEST_BASE_TS +
+                 sdu_idx * BLE_LL_ISOAL_TEST_SDU_INTVL;
+        while (sdu_ts <= event_ts) {
+            ble_ll_isoal_test_sdu_tx(&mux, sdu_idx, BLE_LL_ISOAL_TEST_SDU_LEN,
+                                     sdu_ts);
+            sdu_idx++;
+            sdu_ts += BLE_LL_ISOAL_TEST_SDU_INTVL;
+        }
+
+        ble_ll_isoal_mux_event_start(&mux, event_ts);
+
+        for (idx = 0; idx < bn; idx++) {
+            if (framed) {
+                pdu_len = ble_ll_isoal_mux_framed_get(&mux, idx, &llid, pdu);
+            } else {
+                pdu_len = ble_ll_isoal_mux_unframed_get(&mux, idx, &llid, pdu);
+            }
+            TEST_ASSERT_FATAL(pdu_len <= max_pdu);
+
+            if (pdu_len) {
+                res->pdu_data++;
+            }
+            res->airtime_us += ble_ll_pdu_us(pdu_len, BLE_PHY_MODE_2M);
+
+            rc = ble_ll_isoal_demux_pdu_in(&demux, llid,
+                                           event == lost_event ? NULL : pdu,
+                                           pdu_len, event_ts);
+            TEST_ASSERT_FATAL(rc == 0);
+        }
+
+        res->pkt_completed += ble_ll_isoal_mux_event_done(&mux);
+    }
+
+    ble_ll_isoal_mux_free(&mux);
+    ble_ll_isoal_demux_free(&demux);
+}
+
+TEST_CASE_SELF(ble_ll_isoal_test_unframed)
+{
+    struct ble_ll_isoal_test_result res;
+
+    sysinit();
+
+    /* 1 SDU per event in 2 PDUs */
+    ble_ll_isoal_test_run(0, BLE_LL_ISOAL_TEST_SDU_INTVL, 2,
+                          BLE_LL_ISOAL_TEST_SDU_LEN / 2 + 1, 40, UINT16_MAX,
+                          &res);
+
+    TEST_ASSERT(res.sdu_tx == 40);
+    TEST_ASSERT(res.sdu_rx_valid == 40);
+    TEST_ASSERT(res.sdu_rx_lost == 0);
+    TEST_ASSERT(res.pdu_data == 80);
+    /* Completed packets are counted per HCI packet, not per SDU */
+    TEST_ASSERT(res.pkt_tx == 60);
+    TEST_ASSERT(res.pkt_completed == res.pkt_tx);
+}
+
+TEST_CASE_SELF(ble_ll_isoal_test_framed)
+{
+    struct ble_ll_isoal_test_result res;
+
+    sysinit();
+
+    /* 7.5ms SDUs over 10ms ISO interval, PDU is too short to fit 2 SDUs so
+     * some SDUs are segmented over 2 PDUs.
+     */
+    ble_ll_isoal_test_run(1, 10000, 1, 55, 40, UINT16_MAX, &res);
+
+    TEST_ASSERT(res.sdu_tx == 53);
+    TEST_ASSERT(res.sdu_rx_valid == 52);
+    TEST_ASSERT(res.sdu_rx_lost == 0);
+    TEST_ASSERT(res.pdu_data == 40);
+    TEST_ASSERT(res.pkt_completed == res.pkt_tx - 1);
+}
+
+TEST_CASE_SELF(ble_ll_isoal_test_framed_lost)
+{
+    struct ble_ll_isoal_test_result res;
+
+    sysinit();
+
+    /* PDU in 4th event has end of one SDU and start of another one */
+    ble_ll_isoal_test_run(1, 10000, 1, 55, 40, 3, &res);
+
+    /* SDU ending in lost PDU is missing, SDU starting in lost PDU is reported
+     * as lost once its last segment is received.
+     */
+    TEST_ASSERT(res.sdu_rx_valid == 50);
+    TEST_ASSERT(res.sdu_rx_lost == 1);
+    TEST_ASSERT(res.pkt_completed == res.pkt_tx - 1);
+}
+
+TEST_CASE_SELF(ble_ll_isoal_test_framed_airtime)
+{
+    struct ble_ll_isoal_test_result unframed;
+    struct ble_ll_isoal_test_result framed;
+
+    sysinit();
+
+    /* 7.5ms SDUs sent unframed over 7.5ms ISO interval vs framed over 10ms
+     * ISO interval, both in 300ms.
+     */
+    ble_ll_isoal_test_run(0, 7500, 1, BLE_LL_ISOAL_TEST_SDU_LEN, 40,
+                          UINT16_MAX, &unframed);
+    ble_ll_isoal_test_run(1, 10000, 1, 2 * (BLE_LL_ISOAL_TEST_SDU_LEN + 5),
+                          30, UINT16_MAX, &framed);
+
+    TEST_ASSERT(unframed.sdu_rx_valid == unframed.sdu_tx);
+    TEST_ASSERT(framed.sdu_rx_valid == framed.sdu_tx);
+
+    /* Framed needs 25% less events and PDUs... */
+    TEST_ASSERT(framed.pdu_data * 4 == unframed.pdu_data * 3);
+    /* ...with segmentation overhead of less than 10% of airtime per SDU */
+    TEST_ASSERT(framed.airtime_us * unframed.sdu_tx * 10 <
+                unframed.airtime_us * framed.sdu_tx * 11);
+}
+
+TEST_SUITE(ble_ll_isoal_test_suite)
+{
+    ble_ll_isoal_test_unframed();
+    ble_ll_isoal_test_framed();
+    ble_ll_isoal_test_framed_lost();
+    ble_ll_isoal_test_framed_airtime();
+}
+
+#endif /* BLE_LL_ISO */
@@ -0,0 +1,198 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "nimble/ble.h"
+#include "nimble/hci_common.h"
+#include "controller/ble_ll_resolv.h"
+#include "testutil/testutil.h"
+
+static void
+ble_ll_resolv_test_add(int i)
+{
+    struct ble_hci_le_add_resolv_list_cp cmd;
+    int rc;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.peer_addr_type = BLE_ADDR_PUBLIC;
+    cmd.peer_id_addr[0] = i + 1;
+    memset(cmd.peer_irk, 0xa0 + i, sizeof(cmd.peer_irk));
+
+    rc = ble_ll_resolv_list_add((uint8_t *)&cmd, sizeof(cmd));
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+static void
+ble_ll_resolv_test_rpa(uint8_t *rpa, uint32_t seed)
+{
+    /* Random address with the two MSBs set to 0b01 (resolvable) */
+    rpa[0] = seed;
+    rpa[1] = seed >> 8;
+    rpa[2] = seed >> 16;
+    rpa[3] = seed;
+    rpa[4] = seed >> 8;
+    rpa[5] = 0x40 | ((seed >> 16) & 0x3f);
+}
+
+TEST_CASE_SELF(ble_ll_resolv_test_peer_rpa_any)
+{
+    struct ble_hci_le_rmv_resolve_list_cp rmv;
+    uint8_t rpa[BLE_DEV_ADDR_LEN];
+    int num_entries;
+    int rc;
+    int i;
+
+    sysinit();
+
+    for (num_entries = 1;
+         num_entries <= MYNEWT_VAL(BLE_LL_RESOLV_LIST_SIZE);
+         num_entries++) {
+        ble_ll_resolv_list_reset();
+
+        for (i = 0; i < num_entries; i++) {
+            ble_ll_resolv_test_add(i);
+        }
+
+        /* Peer RPAs generated for each entry resolve back to that entry,
+         * the first time and again when served from the cache.
+         */
+        for (i = 0; i < num_entries; i++) {
+            ble_ll_resolv_get_priv_addr(&g_ble_ll_resolv_list[i], 0, rpa);
+            TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == i);
+            TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == i);
+        }
+
+        /* Removing an entry shifts the list; stale cached indexes must not
+         * be returned.
+         */
+        if (num_entries > 1) {
+            ble_ll_resolv_get_priv_addr(&g_ble_ll_resolv_list[1], 0, rpa);
+            TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 1);
+
+            rmv.peer_addr_type = BLE_ADDR_PUBLIC;
+            memcpy(rmv.peer_id_addr, g_ble_ll_resolv_list[0].rl_identity_addr,
+                   BLE_DEV_ADDR_LEN);
+            rc = ble_ll_resolv_list_rmv((uint8_t *)&rmv, sizeof(rmv));
+            TEST_ASSERT_FATAL(rc == 0);
+
+            TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 0);
+        }
+    }
+}
+
+#if MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)
+static void
+ble_ll_resolv_test_cache_stats(uint32_t hits, uint32_t misses)
+{
+    struct ble_ll_resolv_rpa_cache_stats stats;
+
+    ble_ll_resolv_rpa_cache_stats_get(&stats, 1);
+    TEST_ASSERT(stats.hits == hits);
+    TEST_ASSERT(stats.misses == misses);
+}
+
+TEST_CASE_SELF(ble_ll_resolv_test_rpa_cache)
+{
+    struct ble_ll_resolv_rpa_cache_stats stats;
+    struct ble_hci_le_rmv_resolve_list_cp rmv;
+    uint8_t other[BLE_DEV_ADDR_LEN];
+    uint8_t rpa[BLE_DEV_ADDR_LEN];
+    int rc;
+    int i;
+
+    sysinit();
+
+    ble_ll_resolv_list_reset();
+    for (i = 0; i < 3; i++) {
+        ble_ll_resolv_test_add(i);
+    }
+    ble_ll_resolv_rpa_cache_stats_get(&stats, 1);
+
+    /* Resolved and unresolved RPAs are both served from the cache when
+     * heard again.
+     */
+    ble_ll_resolv_get_priv_addr(&g_ble_ll_resolv_list[2], 0, rpa);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 2);
+    ble_ll_resolv_test_cache_stats(0, 1);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 2);
+    ble_ll_resolv_test_cache_stats(1, 0);
+
+    ble_ll_resolv_test_rpa(other, 0x123456);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(other) == -1);
+    ble_ll_resolv_test_cache_stats(0, 1);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(other) == -1);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 2);
+    ble_ll_resolv_test_cache_stats(2, 0);
+
+    /* Once full, the oldest entries are replaced first */
+    for (i = 0; i < MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE) - 1; i++) {
+        ble_ll_resolv_test_rpa(other, 0x200000 + i);
+        TEST_ASSERT(ble_ll_resolv_peer_rpa_any(other) == -1);
+    }
+    ble_ll_resolv_test_cache_stats(0,
+                                   MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE) - 1);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 2);
+    ble_ll_resolv_test_cache_stats(0, 1);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(other) == -1);
+    ble_ll_resolv_test_cache_stats(1, 0);
+
+    /* Removing an entry empties the cache, as indexes shift */
+    ble_ll_resolv_get_priv_addr(&g_ble_ll_resolv_list[1], 0, rpa);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 1);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 1);
+    ble_ll_resolv_test_cache_stats(1, 1);
+
+    rmv.peer_addr_type = BLE_ADDR_PUBLIC;
+    memcpy(rmv.peer_id_addr, g_ble_ll_resolv_list[0].rl_identity_addr,
+           BLE_DEV_ADDR_LEN);
+    rc = ble_ll_resolv_list_rmv((uint8_t *)&rmv, sizeof(rmv));
+    TEST_ASSERT_FATAL(rc == 0);
+
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 0);
+    ble_ll_resolv_test_cache_stats(0, 1);
+
+    /* Adding an entry empties the cache, as a cached unresolved RPA may
+     * now resolve.
+     */
+    ble_ll_resolv_test_add(3);
+    ble_ll_resolv_get_priv_addr(&g_ble_ll_resolv_list[2], 0, other);
+    ble_ll_resolv_test_cache_stats(0, 0);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == 0);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(other) == 2);
+    ble_ll_resolv_test_cache_stats(0, 2);
+
+    /* Clearing the list empties the cache */
+    rc = ble_ll_resolv_list_clr();
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_ll_resolv_peer_rpa_any(rpa) == -1);
+    ble_ll_resolv_test_cache_stats(0, 1);
+}
+#endif
+
+TEST_SUITE(ble_ll_resolv_test_suite)
+{
+    ble_ll_resolv_test_peer_rpa_any();
+#if MYNEWT_VAL(BLE_LL_RESOLV_RPA_CACHE_SIZE)
+    ble_ll_resolv_test_rpa_cache();
+#endif
+}
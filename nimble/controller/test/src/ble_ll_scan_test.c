@@ -0,0 +1,236 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "nimble/ble.h"
+#include "nimble/hci_common.h"
+#include "controller/ble_ll.h"
+#include "controller/ble_ll_scan.h"
+#include "testutil/testutil.h"
+
+#define BLE_LL_SCAN_TEST_NUM_DUPS   MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS)
+
+static void
+ble_ll_scan_test_addr(uint8_t *addr, int i)
+{
+    /* Addresses differing only in the low bytes, as from one vendor */
+    memset(addr, 0, BLE_DEV_ADDR_LEN);
+    addr[0] = i;
+    addr[1] = i >> 8;
+    addr[5] = 0xc0;
+}
+
+/* Checks a legacy ADV_IND and, if it is not a duplicate, reports it */
+static int
+ble_ll_scan_test_adv_ind(int i)
+{
+    uint8_t addr[BLE_DEV_ADDR_LEN];
+    int rc;
+
+    ble_ll_scan_test_addr(addr, i);
+
+    rc = ble_ll_scan_dup_check_legacy(BLE_ADDR_RANDOM, addr,
+                                      BLE_ADV_PDU_TYPE_ADV_IND);
+    if (rc == 0) {
+        ble_ll_scan_dup_update_legacy(BLE_ADDR_RANDOM, addr,
+                                      BLE_HCI_LE_SUBEV_ADV_RPT,
+                                      BLE_HCI_ADV_RPT_EVTYPE_ADV_IND);
+    }
+
+    return rc;
+}
+
+TEST_CASE_SELF(ble_ll_scan_test_dup_legacy)
+{
+    uint8_t addr[BLE_DEV_ADDR_LEN];
+
+    sysinit();
+
+    ble_ll_scan_test_addr(addr, 1);
+
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) == 0);
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) != 0);
+
+    /* Each kind of report is filtered on its own */
+    TEST_ASSERT(ble_ll_scan_dup_check_legacy(BLE_ADDR_RANDOM, addr,
+                                             BLE_ADV_PDU_TYPE_SCAN_RSP) == 0);
+    ble_ll_scan_dup_update_legacy(BLE_ADDR_RANDOM, addr,
+                                  BLE_HCI_LE_SUBEV_ADV_RPT,
+                                  BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP);
+    TEST_ASSERT(ble_ll_scan_dup_check_legacy(BLE_ADDR_RANDOM, addr,
+                                             BLE_ADV_PDU_TYPE_SCAN_RSP) != 0);
+
+    TEST_ASSERT(ble_ll_scan_dup_check_legacy(BLE_ADDR_RANDOM, addr,
+                                             BLE_ADV_PDU_TYPE_ADV_DIRECT_IND) ==
+                0);
+    ble_ll_scan_dup_update_legacy(BLE_ADDR_RANDOM, addr,
+                                  BLE_HCI_LE_SUBEV_DIRECT_ADV_RPT, 0);
+    TEST_ASSERT(ble_ll_scan_dup_check_legacy(BLE_ADDR_RANDOM, addr,
+                                             BLE_ADV_PDU_TYPE_ADV_DIRECT_IND) !=
+                0);
+
+    /* The same address of the other type is another advertiser */
+    TEST_ASSERT(ble_ll_scan_dup_check_legacy(BLE_ADDR_PUBLIC, addr,
+                                             BLE_ADV_PDU_TYPE_ADV_IND) == 0);
+
+    /* An advertiser checked but never reported is not a duplicate */
+    TEST_ASSERT(ble_ll_scan_dup_check_legacy(BLE_ADDR_PUBLIC, addr,
+                                             BLE_ADV_PDU_TYPE_ADV_IND) == 0);
+
+    /* Nothing is remembered across a reset */
+    ble_ll_scan_reset();
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) == 0);
+}
+
+TEST_CASE_SELF(ble_ll_scan_test_dup_evict)
+{
+    int i;
+
+    sysinit();
+
+    for (i = 0; i < BLE_LL_SCAN_TEST_NUM_DUPS; i++) {
+        TEST_ASSERT(ble_ll_scan_test_adv_ind(i) == 0);
+    }
+
+    /* Hearing advertiser 0 again makes advertiser 1 the least recent */
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(0) != 0);
+
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(BLE_LL_SCAN_TEST_NUM_DUPS) == 0);
+
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(0) != 0);
+    for (i = 2; i <= BLE_LL_SCAN_TEST_NUM_DUPS; i++) {
+        TEST_ASSERT(ble_ll_scan_test_adv_ind(i) != 0);
+    }
+
+    /* Advertiser 1 was evicted and is reported again */
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) == 0);
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) != 0);
+}
+
+TEST_CASE_SELF(ble_ll_scan_test_dup_many)
+{
+    int num;
+    int i;
+
+    sysinit();
+
+    /* Many more advertisers than entries, so every bucket sees evictions */
+    num = 4 * BLE_LL_SCAN_TEST_NUM_DUPS;
+    for (i = 0; i < num; i++) {
+        TEST_ASSERT(ble_ll_scan_test_adv_ind(i) == 0);
+    }
+
+    /* The most recent ones are all still found, oldest first so that
+     * none of them is evicted by the lookups.
+     */
+    for (i = num - BLE_LL_SCAN_TEST_NUM_DUPS; i < num; i++) {
+        TEST_ASSERT(ble_ll_scan_test_adv_ind(i) != 0);
+    }
+
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(num - BLE_LL_SCAN_TEST_NUM_DUPS - 1) ==
+                0);
+}
+
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGING_MS)
+TEST_CASE_SELF(ble_ll_scan_test_dup_aging)
+{
+    ble_npl_time_t aging;
+
+    sysinit();
+
+    aging = ble_npl_time_ms_to_ticks32(MYNEWT_VAL(BLE_LL_SCAN_DUP_AGING_MS));
+
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) == 0);
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(2) == 0);
+
+    /* Still filtered before the entry has aged */
+    os_time_advance(aging / 2);
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) != 0);
+
+    /* Aged entries are reported again, and the new report is filtered */
+    os_time_advance(aging);
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) == 0);
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) != 0);
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(2) == 0);
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(2) != 0);
+}
+#endif
+
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
+/* Checks an extended advertising PDU and, if not a duplicate, reports it */
+static int
+ble_ll_scan_test_ext(uint8_t *addr, uint16_t adi)
+{
+    int rc;
+
+    rc = ble_ll_scan_dup_check_ext(BLE_ADDR_RANDOM, addr, true, adi);
+    if (rc == 0) {
+        ble_ll_scan_dup_update_ext(BLE_ADDR_RANDOM, addr, true, adi);
+    }
+
+    return rc;
+}
+
+TEST_CASE_SELF(ble_ll_scan_test_dup_ext)
+{
+    uint8_t addr[BLE_DEV_ADDR_LEN];
+
+    sysinit();
+
+    ble_ll_scan_test_addr(addr, 1);
+
+    /* ADI is the SID in the upper 4 bits and the DID in the lower 12 */
+    TEST_ASSERT(ble_ll_scan_test_ext(addr, 0x1001) == 0);
+    TEST_ASSERT(ble_ll_scan_test_ext(addr, 0x1001) != 0);
+
+    /* New data in the same set is reported again */
+    TEST_ASSERT(ble_ll_scan_test_ext(addr, 0x1002) == 0);
+    TEST_ASSERT(ble_ll_scan_test_ext(addr, 0x1002) != 0);
+
+    /* Each set of an advertiser is filtered on its own */
+    TEST_ASSERT(ble_ll_scan_test_ext(addr, 0x2002) == 0);
+    TEST_ASSERT(ble_ll_scan_test_ext(addr, 0x1002) != 0);
+    TEST_ASSERT(ble_ll_scan_test_ext(addr, 0x2002) != 0);
+
+    /* Anonymous advertising is filtered by set only */
+    TEST_ASSERT(ble_ll_scan_test_ext(NULL, 0x1002) == 0);
+    TEST_ASSERT(ble_ll_scan_test_ext(NULL, 0x1002) != 0);
+    TEST_ASSERT(ble_ll_scan_test_ext(addr, 0x1002) != 0);
+
+    /* Legacy and extended advertising of one address are not mixed up */
+    TEST_ASSERT(ble_ll_scan_test_adv_ind(1) == 0);
+    TEST_ASSERT(ble_ll_scan_test_ext(addr, 0x1002) != 0);
+}
+#endif
+
+TEST_SUITE(ble_ll_scan_test_suite)
+{
+    ble_ll_scan_test_dup_legacy();
+    ble_ll_scan_test_dup_evict();
+    ble_ll_scan_test_dup_many();
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGING_MS)
+    ble_ll_scan_test_dup_aging();
+#endif
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
+    ble_ll_scan_test_dup_ext();
+#endif
+}
@@ -0,0 +1,217 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "controller/ble_ll_sched.h"
+#include "controller/ble_ll_tmr.h"
+#include "testutil/testutil.h"
+
+#define BLE_LL_SCHED_TEST_ITEMS     (64)
+#define BLE_LL_SCHED_TEST_ITERS     (5000)
+
+static struct ble_ll_sched_item ble_ll_sched_test_items[BLE_LL_SCHED_TEST_ITEMS];
+
+static int
+ble_ll_sched_test_cb(struct ble_ll_sched_item *sch)
+{
+    return BLE_LL_SCHED_STATE_DONE;
+}
+
+static int
+ble_ll_sched_test_preempt_none(struct ble_ll_sched_item *sch,
+                               struct ble_ll_sched_item *item)
+{
+    return 0;
+}
+
+static int
+ble_ll_sched_test_insert(struct ble_ll_sched_item *sch, uint32_t start,
+                         uint32_t duration, uint32_t max_delay)
+{
+    os_sr_t sr;
+    int rc;
+
+    sch->sched_type = BLE_LL_SCHED_TYPE_ADV;
+    sch->sched_cb = ble_ll_sched_test_cb;
+    sch->cb_arg = sch;
+    sch->start_time = start;
+    sch->end_time = start + duration;
+
+    OS_ENTER_CRITICAL(sr);
+    rc = ble_ll_sched_insert(sch, max_delay, ble_ll_sched_test_preempt_none);
+    OS_EXIT_CRITICAL(sr);
+
+    ble_ll_sched_restart();
+
+    return rc;
+}
+
+static void
+ble_ll_sched_test_verify(void)
+{
+    struct ble_ll_sched_item *a;
+    struct ble_ll_sched_item *b;
+    uint32_t first_start;
+    uint32_t next_time;
+    int enqueued;
+    int i;
+    int j;
+
+    enqueued = 0;
+
+    for (i = 0; i < BLE_LL_SCHED_TEST_ITEMS; i++) {
+        a = &ble_ll_sched_test_items[i];
+        if (!a->enqueued) {
+            continue;
+        }
+
+        if (!enqueued || LL_TMR_LT(a->start_time, first_start)) {
+            first_start = a->start_time;
+        }
+        enqueued++;
+
+        for (j = i + 1; j < BLE_LL_SCHED_TEST_ITEMS; j++) {
+            b = &ble_ll_sched_test_items[j];
+            if (!b->enqueued) {
+                continue;
+            }
+
+            TEST_ASSERT_FATAL(LL_TMR_LEQ(a->end_time, b->start_time) ||
+                              LL_TMR_LEQ(b->end_time, a->start_time));
+        }
+    }
+
+    TEST_ASSERT_FATAL(ble_ll_sched_next_time(&next_time) == !!enqueued);
+    if (enqueued) {
+        TEST_ASSERT_FATAL(next_time == first_start);
+    }
+}
+
+static void
+ble_ll_sched_test_clear(void)
+{
+    int i;
+
+    for (i = 0; i < BLE_LL_SCHED_TEST_ITEMS; i++) {
+        ble_ll_sched_rmv_elem(&ble_ll_sched_test_items[i]);
+    }
+
+    ble_ll_sched_test_verify();
+}
+
+TEST_CASE_SELF(ble_ll_sched_test_insert_shift)
+{
+    struct ble_ll_sched_item *items = ble_ll_sched_test_items;
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+    struct ble_ll_sched_stats stats;
+#endif
+    uint32_t base;
+    int rc;
+
+    sysinit();
+
+    memset(items, 0, sizeof(ble_ll_sched_test_items));
+
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+    ble_ll_sched_stats_get(&stats, 1);
+#endif
+
+    /* Keep items far enough in future so none of them is executed */
+    base = ble_ll_tmr_get() + ble_ll_tmr_u2t(10000000);
+
+    rc = ble_ll_sched_test_insert(&items[0], base + 100, 100, 0);
+    TEST_ASSERT(rc == 0);
+    rc = ble_ll_sched_test_insert(&items[1], base + 300, 100, 0);
+    TEST_ASSERT(rc == 0);
+
+    /* Fits exactly between existing items */
+    rc = ble_ll_sched_test_insert(&items[2], base + 200, 100, 0);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(items[2].start_time == base + 200);
+
+    /* Overlaps and cannot be moved */
+    rc = ble_ll_sched_test_insert(&items[3], base + 150, 100, 0);
+    TEST_ASSERT(rc != 0);
+    TEST_ASSERT(!items[3].enqueued);
+
+    /* Overlaps and is moved past all overlapping items */
+    rc = ble_ll_sched_test_insert(&items[3], base + 150, 100, 1000);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(items[3].start_time == base + 401);
+    TEST_ASSERT(items[3].end_time == base + 501);
+
+    /* Inserted before all items */
+    rc = ble_ll_sched_test_insert(&items[4], base, 100, 0);
+    TEST_ASSERT(rc == 0);
+
+    ble_ll_sched_test_verify();
+
+#if MYNEWT_VAL(BLE_LL_SCHED_STATS)
+    ble_ll_sched_stats_get(&stats, 0);
+    TEST_ASSERT(stats.inserted == 5);
+    TEST_ASSERT(stats.insert_failed == 1);
+    TEST_ASSERT(stats.collisions == 4);
+    TEST_ASSERT(stats.preempted == 0);
+#endif
+
+    ble_ll_sched_test_clear();
+}
+
+TEST_CASE_SELF(ble_ll_sched_test_insert_random)
+{
+    struct ble_ll_sched_item *sch;
+    uint32_t base;
+    uint32_t rnd;
+    int i;
+
+    sysinit();
+
+    memset(ble_ll_sched_test_items, 0, sizeof(ble_ll_sched_test_items));
+
+    base = ble_ll_tmr_get() + ble_ll_tmr_u2t(10000000);
+    rnd = 0x12345678;
+
+    for (i = 0; i < BLE_LL_SCHED_TEST_ITERS; i++) {
+        rnd ^= rnd << 13;
+        rnd ^= rnd >> 17;
+        rnd ^= rnd << 5;
+
+        sch = &ble_ll_sched_test_items[rnd % BLE_LL_SCHED_TEST_ITEMS];
+        if (sch->enqueued) {
+            TEST_ASSERT_FATAL(ble_ll_sched_rmv_elem(sch) == 0);
+        } else {
+            ble_ll_sched_test_insert(sch, base + (rnd >> 8) % 10000,
+                                     1 + (rnd >> 20) % 500,
+                                     (rnd & 0x80) ? 2000 : 0);
+        }
+
+        ble_ll_sched_test_verify();
+    }
+
+    ble_ll_sched_test_clear();
+}
+
+TEST_SUITE(ble_ll_sched_test_suite)
+{
+    ble_ll_sched_test_insert_shift();
+    ble_ll_sched_test_insert_random();
+}
@@ -25,6 +25,11 @@
 TEST_SUITE_DECL(ble_ll_aa_test_suite);
 TEST_SUITE_DECL(ble_ll_crypto_test_suite);
 TEST_SUITE_DECL(ble_ll_csa2_test_suite);
+TEST_SUITE_DECL(ble_ll_iso_big_test_suite);
+TEST_SUITE_DECL(ble_ll_isoal_test_suite);
+TEST_SUITE_DECL(ble_ll_resolv_test_suite);
+TEST_SUITE_DECL(ble_ll_scan_test_suite);
+TEST_SUITE_DECL(ble_ll_sched_test_suite);
 
 int
 main(int argc, char **argv)
@@ -32,6 +37,15 @@ main(int argc, char **argv)
     ble_ll_aa_test_suite();
     ble_ll_crypto_test_suite();
     ble_ll_csa2_test_suite();
+#if MYNEWT_VAL(BLE_LL_ISO)
+    ble_ll_isoal_test_suite();
+#endif
+#if MYNEWT_VAL(BLE_LL_ISO_BROADCASTER)
+    ble_ll_iso_big_test_suite();
+#endif
+    ble_ll_resolv_test_suite();
+    ble_ll_scan_test_suite();
+    ble_ll_sched_test_suite();
 
     return tu_any_failed;
 }
@@ -27,10 +27,27 @@
 #include "nimble/ble.h"
 #include "nimble/nimble_opt.h"
 #include "controller/ble_hw.h"
+#include "controller/ble_ll_resolv.h"
+#include "tinycrypt/constants.h"
+#include "tinycrypt/aes.h"
+#include "ble_hw_priv.h"
 
 /* Total number of white list elements supported by nrf52 */
 #define BLE_HW_WHITE_LIST_SIZE      (0)
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PRIVACY)
+/*
+ * Resolving list entries.  These are always the first entries of the link
+ * layer resolving list, in the same order, so received RPAs are resolved
+ * with ble_ll_resolv_peer_rpa_any() (and its cache) instead of keeping a
+ * second copy of the IRKs here.
+ */
+#define BLE_HW_RESOLV_LIST_SIZE     (16)
+
+static uint8_t g_ble_hw_resolv_list_cnt;
+static int g_ble_hw_resolv_match = -1;
+#endif
+
 /* We use this to keep track of which entries are set to valid addresses */
 static uint8_t g_ble_hw_whitelist_mask;
 
@@ -130,11 +147,22 @@ ble_hw_whitelist_match(void)
     return 0;
 }
 
-/* Encrypt data */
+/* Encrypt data, in software as there is no AES hardware to use */
 int
 ble_hw_encrypt_block(struct ble_encryption_block *ecb)
 {
-    return -1;
+    struct tc_aes_key_sched_struct sched;
+
+    if (tc_aes128_set_encrypt_key(&sched, ecb->key) == TC_CRYPTO_FAIL) {
+        return -1;
+    }
+
+    if (tc_aes_encrypt(ecb->cipher_text, ecb->plain_text,
+                       &sched) == TC_CRYPTO_FAIL) {
+        return -1;
+    }
+
+    return 0;
 }
 
 /**
@@ -203,6 +231,7 @@ ble_hw_rng_read(void)
 void
 ble_hw_resolv_list_clear(void)
 {
+    g_ble_hw_resolv_list_cnt = 0;
 }
 
 /**
@@ -215,7 +244,12 @@ ble_hw_resolv_list_clear(void)
 int
 ble_hw_resolv_list_add(uint8_t *irk)
 {
-    return BLE_ERR_MEM_CAPACITY;
+    if (g_ble_hw_resolv_list_cnt >= BLE_HW_RESOLV_LIST_SIZE) {
+        return BLE_ERR_MEM_CAPACITY;
+    }
+
+    g_ble_hw_resolv_list_cnt++;
+    return BLE_ERR_SUCCESS;
 }
 
 /**
@@ -226,6 +260,9 @@ ble_hw_resolv_list_add(uint8_t *irk)
 void
 ble_hw_resolv_list_rmv(int index)
 {
+    if (index < g_ble_hw_resolv_list_cnt) {
+        g_ble_hw_resolv_list_cnt--;
+    }
 }
 
 /**
@@ -237,7 +274,7 @@ ble_hw_resolv_list_rmv(int index)
 uint8_t
 ble_hw_resolv_list_size(void)
 {
-    return 0;
+    return BLE_HW_RESOLV_LIST_SIZE;
 }
 
 /**
@@ -249,6 +286,28 @@ ble_hw_resolv_list_size(void)
 int
 ble_hw_resolv_list_match(void)
 {
-    return -1;
+    return g_ble_hw_resolv_match;
+}
+
+/**
+ * Called by the PHY before a received PDU is passed to the link layer.
+ */
+void
+ble_hw_resolv_proc_reset(void)
+{
+    g_ble_hw_resolv_match = -1;
+}
+
+/**
+ * Called by the PHY to resolve the RPA of a received PDU.
+ *
+ * @param addr  Pointer to received address
+ */
+void
+ble_hw_resolv_proc_start(const uint8_t *addr)
+{
+    if (g_ble_hw_resolv_list_cnt) {
+        g_ble_hw_resolv_match = ble_ll_resolv_peer_rpa_any(addr);
+    }
 }
 #endif
@@ -22,11 +22,34 @@
 #include <assert.h>
 #include "syscfg/syscfg.h"
 #include "os/os.h"
+#include "os/os_cputime.h"
 #include "ble/xcvr.h"
 #include "nimble/ble.h"
 #include "nimble/nimble_opt.h"
 #include "controller/ble_phy.h"
 #include "controller/ble_ll.h"
+#include "controller/ble_ll_pdu.h"
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION)
+#include "tinycrypt/constants.h"
+#include "tinycrypt/aes.h"
+#include "tinycrypt/ccm_mode.h"
+#endif
+#include "phy_priv.h"
+#include "ble_hw_priv.h"
+
+/*
+ * The native PHY transmits and receives over a virtual radio medium shared
+ * with other native controllers on the same host (see phy_priv.h). Radio
+ * events (sync on access address, end of reception, end of transmission) are
+ * driven by cputime timers set to the on-air times of the frames, so the
+ * link layer sees the same timing as it would with a real transceiver.
+ */
+
+/* Radio event the PHY timer is armed for */
+#define BLE_PHY_EVT_NONE            (0)
+#define BLE_PHY_EVT_RX_SYNC         (1)
+#define BLE_PHY_EVT_RX_END          (2)
+#define BLE_PHY_EVT_TX_END          (3)
 
 /* BLE PHY data structure */
 struct ble_phy_obj
@@ -41,47 +64,49 @@ struct ble_phy_obj
     uint8_t phy_encrypted;
     uint8_t phy_privacy;
     uint8_t phy_tx_pyld_len;
-    uint32_t phy_aar_scratch;
+    uint8_t phy_tx_phy_mode;
+    uint8_t phy_rx_phy_mode;
+    uint8_t phy_evt;
+    uint8_t phy_tx_start_set;
+    uint8_t txtx_time_anchor;
+    uint16_t txtx_time_us;
+    uint16_t phy_node;
     uint32_t phy_access_address;
+    uint32_t phy_rand;
+    /* Medium sequence numbers of our frame on air, the frame being received
+     * and the last frame looked at by the receiver.
+     */
+    uint32_t phy_tx_seq;
+    uint32_t phy_rx_seq;
+    uint32_t phy_scan_seq;
+    /* Medium times, in usecs */
+    uint64_t phy_tx_start_us;
+    uint64_t phy_rx_start_us;
+    uint64_t phy_wfr_end_us;
+    struct hal_timer phy_timer;
+    struct hal_timer poll_timer;
     struct ble_mbuf_hdr rxhdr;
     void *txend_arg;
-    uint8_t *rxdptr;
     ble_phy_tx_end_func txend_cb;
 };
 struct ble_phy_obj g_ble_phy_data;
 
-/* Statistics */
-struct ble_phy_statistics
-{
-    uint32_t tx_good;
-    uint32_t tx_fail;
-    uint32_t tx_late;
-    uint32_t tx_bytes;
-    uint32_t rx_starts;
-    uint32_t rx_aborts;
-    uint32_t rx_valid;
-    uint32_t rx_crc_err;
-    uint32_t phy_isrs;
-    uint32_t radio_state_errs;
-    uint32_t no_bufs;
-};
-
-struct ble_phy_statistics g_ble_phy_stats;
-
-static uint8_t g_ble_phy_tx_buf[BLE_PHY_MAX_PDU_LEN];
+static struct phy_medium_frame g_ble_phy_tx_frame;
+static struct phy_medium_frame g_ble_phy_rx_frame;
+static uint32_t g_ble_phy_rx_buf[(BLE_PHY_MAX_PDU_LEN + 3) / 4];
 
-/* XCVR object to emulate transceiver */
-struct xcvr_data
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION)
+/* Software AES-CCM state, as the CCM peripheral would hold it */
+struct ble_phy_ccm_data
 {
-    uint32_t irq_status;
+    struct tc_aes_key_sched_struct sched;
+    uint64_t pkt_counter;
+    uint8_t dir_bit;
+    uint8_t headermask;
+    uint8_t iv[8];
 };
-static struct xcvr_data g_xcvr_data;
-
-#define BLE_XCVR_IRQ_F_RX_START     (0x00000001)
-#define BLE_XCVR_IRQ_F_RX_END       (0x00000002)
-#define BLE_XCVR_IRQ_F_TX_START     (0x00000004)
-#define BLE_XCVR_IRQ_F_TX_END       (0x00000008)
-#define BLE_XCVR_IRQ_F_BYTE_CNTR    (0x00000010)
+static struct ble_phy_ccm_data g_ble_phy_ccm_data;
+#endif
 
 /* "Rail" power level if outside supported range */
 #define BLE_XCVR_TX_PWR_MAX_DBM     (30)
@@ -103,6 +128,9 @@ STATS_SECT_START(ble_phy_stats)
     STATS_SECT_ENTRY(radio_state_errs)
     STATS_SECT_ENTRY(rx_hw_err)
     STATS_SECT_ENTRY(tx_hw_err)
+    STATS_SECT_ENTRY(rx_collisions)
+    STATS_SECT_ENTRY(rx_lost)
+    STATS_SECT_ENTRY(medium_overruns)
 STATS_SECT_END
 STATS_SECT_DECL(ble_phy_stats) ble_phy_stats;
 
@@ -121,26 +149,198 @@ STATS_NAME_START(ble_phy_stats)
     STATS_NAME(ble_phy_stats, radio_state_errs)
     STATS_NAME(ble_phy_stats, rx_hw_err)
     STATS_NAME(ble_phy_stats, tx_hw_err)
+    STATS_NAME(ble_phy_stats, rx_collisions)
+    STATS_NAME(ble_phy_stats, rx_lost)
+    STATS_NAME(ble_phy_stats, medium_overruns)
 STATS_NAME_END(ble_phy_stats)
 
-/* XXX: TODO:
+static void ble_phy_rx_poll(void);
 
- * 1) Test the following to make sure it works: suppose an event is already
- * set to 1 and the interrupt is not enabled. What happens if you enable the
- * interrupt with the event bit already set to 1
- * 2) how to deal with interrupts?
+/**
+ * Reads cputime and medium time at (nearly) the same instant, to convert
+ * between the two.
  */
+static void
+ble_phy_time_ref(uint32_t *cputime, uint64_t *us)
+{
+    uint32_t before;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        before = os_cputime_get32();
+        *us = phy_medium_now_us();
+        *cputime = os_cputime_get32();
+        if (*cputime - before <= 1) {
+            break;
+        }
+    }
+}
+
+static uint64_t
+ble_phy_cputime_to_us(uint32_t cputime, uint8_t rem_usecs)
+{
+    uint32_t ref_cputime;
+    uint64_t ref_us;
+    int64_t ticks;
+
+    ble_phy_time_ref(&ref_cputime, &ref_us);
+    ticks = (int32_t)(cputime - ref_cputime);
+
+    return ref_us + ticks * 1000000 / MYNEWT_VAL(OS_CPUTIME_FREQ) + rem_usecs;
+}
+
 static uint32_t
-ble_xcvr_get_irq_status(void)
+ble_phy_us_to_cputime(uint64_t us, uint32_t *rem_usecs)
 {
-    return g_xcvr_data.irq_status;
+    uint32_t ref_cputime;
+    uint64_t ref_us;
+    int64_t usecs;
+    int64_t ticks;
+
+    ble_phy_time_ref(&ref_cputime, &ref_us);
+    usecs = (int64_t)(us - ref_us);
+
+    ticks = usecs * MYNEWT_VAL(OS_CPUTIME_FREQ) / 1000000;
+    if (ticks * 1000000 / MYNEWT_VAL(OS_CPUTIME_FREQ) > usecs) {
+        /* Round towards negative infinity */
+        ticks--;
+    }
+
+    if (rem_usecs) {
+        *rem_usecs = usecs - ticks * 1000000 / MYNEWT_VAL(OS_CPUTIME_FREQ);
+    }
+
+    return ref_cputime + (uint32_t)ticks;
 }
 
 static void
-ble_xcvr_clear_irq(uint32_t mask)
+ble_phy_timer_start_at(struct hal_timer *timer, uint64_t us)
+{
+    os_cputime_timer_stop(timer);
+    os_cputime_timer_start(timer, ble_phy_us_to_cputime(us, NULL));
+}
+
+#if MYNEWT_VAL(BLE_PHY_NATIVE_LOSS_PERMILLE)
+static uint32_t
+ble_phy_rand(void)
+{
+    uint32_t x;
+
+    /* xorshift32 */
+    x = g_ble_phy_data.phy_rand;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    g_ble_phy_data.phy_rand = x;
+
+    return x;
+}
+#endif
+
+static uint8_t
+ble_phy_mode_to_phy(uint8_t phy_mode)
+{
+    switch (phy_mode) {
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_2M_PHY)
+    case BLE_PHY_MODE_2M:
+        return BLE_PHY_2M;
+#endif
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_CODED_PHY)
+    case BLE_PHY_MODE_CODED_125KBPS:
+    case BLE_PHY_MODE_CODED_500KBPS:
+        return BLE_PHY_CODED;
+#endif
+    default:
+        return BLE_PHY_1M;
+    }
+}
+
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION)
+static void
+ble_phy_ccm_nonce(uint8_t *nonce)
+{
+    uint64_t counter;
+
+    /* 39-bit packet counter and direction bit, followed by the IV */
+    counter = g_ble_phy_ccm_data.pkt_counter;
+    put_le32(nonce, (uint32_t)counter);
+    nonce[4] = ((counter >> 32) & 0x7f) | (g_ble_phy_ccm_data.dir_bit << 7);
+    memcpy(nonce + 5, g_ble_phy_ccm_data.iv, 8);
+}
+
+/**
+ * Encrypts PDU in place and appends the MIC. Empty PDUs are not encrypted.
+ *
+ * @param pdu LL header followed by payload; room for MIC is needed
+ */
+static void
+ble_phy_encrypt(uint8_t *pdu)
+{
+    struct tc_ccm_mode_struct ccm;
+    uint8_t out[BLE_PHY_MAX_PDU_LEN];
+    uint8_t nonce[13];
+    uint8_t aad;
+    uint8_t len;
+
+    len = pdu[1];
+    if (len == 0) {
+        return;
+    }
+
+    ble_phy_ccm_nonce(nonce);
+    aad = pdu[0] & g_ble_phy_ccm_data.headermask;
+
+    if ((tc_ccm_config(&ccm, &g_ble_phy_ccm_data.sched, nonce, sizeof(nonce),
+                       BLE_LL_DATA_MIC_LEN) == TC_CRYPTO_FAIL) ||
+        (tc_ccm_generation_encryption(out, len + BLE_LL_DATA_MIC_LEN, &aad, 1,
+                                      &pdu[2], len, &ccm) == TC_CRYPTO_FAIL)) {
+        STATS_INC(ble_phy_stats, tx_hw_err);
+        return;
+    }
+
+    memcpy(&pdu[2], out, len + BLE_LL_DATA_MIC_LEN);
+    pdu[1] = len + BLE_LL_DATA_MIC_LEN;
+}
+
+/**
+ * Decrypts PDU in place and strips the MIC.
+ *
+ * @return int 0 on success; -1 on MIC failure.
+ */
+static int
+ble_phy_decrypt(uint8_t *pdu)
 {
-    g_xcvr_data.irq_status &= ~mask;
+    struct tc_ccm_mode_struct ccm;
+    uint8_t out[BLE_PHY_MAX_PDU_LEN];
+    uint8_t nonce[13];
+    uint8_t aad;
+    uint8_t len;
+
+    len = pdu[1];
+    if (len == 0) {
+        return 0;
+    }
+    if (len < BLE_LL_DATA_MIC_LEN) {
+        return -1;
+    }
+
+    ble_phy_ccm_nonce(nonce);
+    aad = pdu[0] & g_ble_phy_ccm_data.headermask;
+
+    if ((tc_ccm_config(&ccm, &g_ble_phy_ccm_data.sched, nonce, sizeof(nonce),
+                       BLE_LL_DATA_MIC_LEN) == TC_CRYPTO_FAIL) ||
+        (tc_ccm_decryption_verification(out, len - BLE_LL_DATA_MIC_LEN, &aad,
+                                        1, &pdu[2], len,
+                                        &ccm) == TC_CRYPTO_FAIL)) {
+        return -1;
+    }
+
+    memcpy(&pdu[2], out, len - BLE_LL_DATA_MIC_LEN);
+    pdu[1] = len - BLE_LL_DATA_MIC_LEN;
+
+    return 0;
 }
+#endif
 
 /**
  * Copies the data from the phy receive buffer into a mbuf chain.
@@ -220,84 +420,388 @@ ble_phy_rxpdu_copy(uint8_t *dptr, struct os_mbuf *rxpdu)
     memcpy(ble_hdr, &g_ble_phy_data.rxhdr, sizeof(struct ble_mbuf_hdr));
 }
 
-void
-ble_phy_isr(void)
+/**
+ * Checks if a frame on the medium can be received with current radio
+ * settings, i.e. it is on our channel and access address and its access
+ * address is on air within the receive window.
+ */
+static int
+ble_phy_rx_match(const struct phy_medium_frame *hdr)
 {
+    uint64_t aa_us;
+
+    if ((hdr->node == g_ble_phy_data.phy_node) ||
+        (hdr->flags & PHY_MEDIUM_F_ABORTED) ||
+        (hdr->chan != g_ble_phy_data.phy_chan) ||
+        (hdr->access_addr != g_ble_phy_data.phy_access_address) ||
+        (ble_phy_mode_to_phy(hdr->phy_mode) !=
+         ble_phy_mode_to_phy(g_ble_phy_data.phy_rx_phy_mode))) {
+        return 0;
+    }
+
+    aa_us = hdr->start_us + ble_ll_pdu_syncword_us(hdr->phy_mode);
+    if (aa_us < g_ble_phy_data.phy_rx_start_us) {
+        return 0;
+    }
+
+    if (g_ble_phy_data.phy_wfr_end_us &&
+        (aa_us > g_ble_phy_data.phy_wfr_end_us)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Enables the receiver. Frames whose access address is on air at or after
+ * start_us (and no later than wfr_end_us, unless 0) are received.
+ */
+static int
+ble_phy_rx(uint64_t start_us, uint64_t wfr_end_us)
+{
+    struct phy_medium_frame hdr;
+    uint32_t head;
+    uint32_t seq;
+
+    /* Check radio state */
+    if (ble_phy_state_get() != BLE_PHY_STATE_IDLE) {
+        ble_phy_disable();
+        STATS_INC(ble_phy_stats, radio_state_errs);
+        return BLE_PHY_ERR_RADIO_STATE;
+    }
+
+    g_ble_phy_data.phy_state = BLE_PHY_STATE_RX;
+    g_ble_phy_data.phy_rx_started = 0;
+    g_ble_phy_data.phy_rx_seq = 0;
+    g_ble_phy_data.phy_rx_start_us = start_us;
+    g_ble_phy_data.phy_wfr_end_us = wfr_end_us;
+
+    /*
+     * Frames are published ahead of their on-air time, so look back for any
+     * that may still be on air when the receive window opens.
+     */
+    head = phy_medium_head();
+    for (seq = head; head - seq < PHY_MEDIUM_FRAMES - 1; seq--) {
+        if ((phy_medium_peek(seq, &hdr) == PHY_MEDIUM_OK) &&
+            (hdr.end_us + PHY_MEDIUM_MAX_LEAD_US < start_us)) {
+            break;
+        }
+    }
+    g_ble_phy_data.phy_scan_seq = seq;
+
+    ble_phy_rx_poll();
+
+    return 0;
+}
+
+static void
+ble_phy_wfr_exp(void)
+{
+    STATS_INC(ble_phy_stats, phy_isrs);
+    ble_ll_wfr_timer_exp(NULL);
+}
+
+/**
+ * Looks for new frames on the medium that we can receive and arms the PHY
+ * timer for the earliest one. Runs periodically while the receiver is enabled
+ * and has not synchronized yet.
+ */
+static void
+ble_phy_rx_poll(void)
+{
+    struct phy_medium_frame hdr;
+    uint32_t head;
+    uint32_t seq;
+    uint64_t now;
     int rc;
-    uint8_t transition;
-    uint32_t irq_en;
-    struct ble_mbuf_hdr *ble_hdr;
 
-    /* Check for disabled event. This only happens for transmits now */
-    irq_en = ble_xcvr_get_irq_status();
-    if (irq_en & BLE_XCVR_IRQ_F_TX_END) {
+    if ((g_ble_phy_data.phy_state != BLE_PHY_STATE_RX) ||
+        g_ble_phy_data.phy_rx_started) {
+        return;
+    }
 
-        /* Better be in TX state! */
-        assert(g_ble_phy_data.phy_state == BLE_PHY_STATE_TX);
-        ble_xcvr_clear_irq(BLE_XCVR_IRQ_F_TX_END);
+    head = phy_medium_head();
+    for (seq = g_ble_phy_data.phy_scan_seq + 1;
+         (int32_t)(head - seq) >= 0; seq++) {
+        rc = phy_medium_peek(seq, &hdr);
+        if (rc == PHY_MEDIUM_EAGAIN) {
+            /* Not published yet, try again on next poll */
+            break;
+        }
 
-        transition = g_ble_phy_data.phy_transition;
-        if (transition == BLE_PHY_TRANSITION_TX_RX) {
-            /* Disable the phy */
-            /* XXX: count no bufs? */
-            ble_phy_disable();
-        } else {
-            /* Better not be going from rx to tx! */
-            assert(transition == BLE_PHY_TRANSITION_NONE);
+        g_ble_phy_data.phy_scan_seq = seq;
+
+        if (rc == PHY_MEDIUM_ESTALE) {
+            STATS_INC(ble_phy_stats, medium_overruns);
+            continue;
+        }
+
+        if (!ble_phy_rx_match(&hdr)) {
+            continue;
         }
+
+        /* Sync on the frame with the earliest access address */
+        if (!g_ble_phy_data.phy_rx_seq ||
+            (hdr.start_us < g_ble_phy_rx_frame.start_us)) {
+            g_ble_phy_rx_frame = hdr;
+            g_ble_phy_data.phy_rx_seq = seq;
+            g_ble_phy_data.phy_evt = BLE_PHY_EVT_RX_SYNC;
+            ble_phy_timer_start_at(&g_ble_phy_data.phy_timer, hdr.start_us +
+                                   ble_ll_pdu_syncword_us(hdr.phy_mode));
+        }
+    }
+
+    now = phy_medium_now_us();
+    if (!g_ble_phy_data.phy_rx_seq && g_ble_phy_data.phy_wfr_end_us &&
+        (now > g_ble_phy_data.phy_wfr_end_us +
+               MYNEWT_VAL(BLE_PHY_NATIVE_WFR_SLACK_US))) {
+        ble_phy_wfr_exp();
+        return;
     }
 
-    /* We get this if we have started to receive a frame */
-    if (irq_en & BLE_XCVR_IRQ_F_RX_START) {
+    os_cputime_timer_relative(&g_ble_phy_data.poll_timer,
+                              MYNEWT_VAL(BLE_PHY_NATIVE_POLL_US));
+}
 
-        ble_xcvr_clear_irq(BLE_XCVR_IRQ_F_RX_START);
+static void
+ble_phy_poll_timer_cb(void *arg)
+{
+    ble_phy_rx_poll();
+}
 
-        /* Call Link Layer receive start function */
-        rc = ble_ll_rx_start(g_ble_phy_data.rxdptr, g_ble_phy_data.phy_chan,
-                             &g_ble_phy_data.rxhdr);
-        if (rc >= 0) {
-            /* XXX: set rx end enable isr */
-        } else {
-            /* Disable PHY */
-            ble_phy_disable();
-            irq_en = 0;
-            ++g_ble_phy_stats.rx_aborts;
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PRIVACY)
+/**
+ * Resolves the address of a received advertising channel PDU, if it is an
+ * RPA.  This is what the radio of other targets does while the address is
+ * received.  The address is AdvA, or ScanA/InitA for requests from a peer
+ * which are found at the same offset; in extended PDUs it is the AdvA of
+ * the extended header, if present.
+ */
+static void
+ble_phy_rx_resolv(const uint8_t *dptr, uint16_t len)
+{
+    const uint8_t *addr;
+
+    if (!(dptr[0] & BLE_ADV_PDU_HDR_TXADD_RAND)) {
+        return;
+    }
+
+    if ((dptr[0] & BLE_ADV_PDU_HDR_TYPE_MASK) ==
+        BLE_ADV_PDU_TYPE_ADV_EXT_IND) {
+        if (((dptr[2] & 0x3f) == 0) ||
+            !(dptr[3] & (1 << BLE_LL_EXT_ADV_ADVA_BIT))) {
+            return;
         }
+        addr = dptr + 4;
+    } else {
+        addr = dptr + BLE_LL_PDU_HDR_LEN;
+    }
 
-        /* Count rx starts */
-        ++g_ble_phy_stats.rx_starts;
+    if ((addr + BLE_DEV_ADDR_LEN > dptr + len) ||
+        ((addr[5] & 0xc0) != 0x40)) {
+        return;
     }
 
-    /* Receive packet end (we dont enable this for transmit) */
-    if (irq_en & BLE_XCVR_IRQ_F_RX_END) {
+    ble_hw_resolv_proc_start(addr);
+}
+#endif
+
+static void
+ble_phy_rx_sync(void)
+{
+    struct phy_medium_frame *frame;
+    struct ble_mbuf_hdr *ble_hdr;
+    uint32_t rem_usecs;
+    uint8_t *dptr;
+    int rc;
+
+    frame = &g_ble_phy_rx_frame;
+    rc = phy_medium_read(g_ble_phy_data.phy_rx_seq, frame);
+    if ((rc != PHY_MEDIUM_OK) || (frame->flags & PHY_MEDIUM_F_ABORTED)) {
+        /* Transmitter went away; keep listening */
+        g_ble_phy_data.phy_rx_seq = 0;
+        g_ble_phy_data.phy_evt = BLE_PHY_EVT_NONE;
+        ble_phy_rx_poll();
+        return;
+    }
+
+    os_cputime_timer_stop(&g_ble_phy_data.poll_timer);
 
-        ble_xcvr_clear_irq(BLE_XCVR_IRQ_F_RX_END);
+    dptr = (uint8_t *)&g_ble_phy_rx_buf[0];
+    memcpy(dptr, frame->data, frame->len);
 
-        /* Construct BLE header before handing up */
-        ble_hdr = &g_ble_phy_data.rxhdr;
-        ble_hdr->rxinfo.flags = 0;
-        /* XXX: dummy rssi */
-        ble_hdr->rxinfo.rssi = -77 + g_ble_phy_data.rx_pwr_compensation;
-        ble_hdr->rxinfo.channel = g_ble_phy_data.phy_chan;
-        ble_hdr->rxinfo.phy = BLE_PHY_1M;
+    /* Initialize the ble mbuf header */
+    ble_hdr = &g_ble_phy_data.rxhdr;
+    ble_hdr->rxinfo.flags = ble_ll_state_get();
+    ble_hdr->rxinfo.channel = g_ble_phy_data.phy_chan;
+    ble_hdr->rxinfo.handle = 0;
+    ble_hdr->rxinfo.phy = ble_phy_mode_to_phy(frame->phy_mode);
+    ble_hdr->rxinfo.phy_mode = frame->phy_mode;
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
-        ble_hdr->rxinfo.user_data = NULL;
+    ble_hdr->rxinfo.user_data = NULL;
+#endif
+
+    /* Packet start time, as seen by our cputime */
+    ble_hdr->beg_cputime = ble_phy_us_to_cputime(frame->start_us, &rem_usecs);
+    ble_hdr->rem_usecs = rem_usecs;
+
+    STATS_INC(ble_phy_stats, phy_isrs);
+
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PRIVACY)
+    ble_hw_resolv_proc_reset();
+    if (g_ble_phy_data.phy_privacy &&
+        (g_ble_phy_data.phy_access_address == BLE_ACCESS_ADDR_ADV)) {
+        ble_phy_rx_resolv(dptr, frame->len);
+    }
 #endif
 
-        /* Count PHY valid packets */
-        ++g_ble_phy_stats.rx_valid;
+    /* Call Link Layer receive start function */
+    rc = ble_ll_rx_start(dptr, g_ble_phy_data.phy_chan,
+                         &g_ble_phy_data.rxhdr);
+    if (rc >= 0) {
+        /* Set rx started flag and wait for end of frame */
+        g_ble_phy_data.phy_rx_started = 1;
+        g_ble_phy_data.phy_evt = BLE_PHY_EVT_RX_END;
+        ble_phy_timer_start_at(&g_ble_phy_data.phy_timer, frame->end_us);
+    } else {
+        /* Disable PHY */
+        ble_phy_disable();
+        STATS_INC(ble_phy_stats, rx_aborts);
+    }
+
+    /* Count rx starts */
+    STATS_INC(ble_phy_stats, rx_starts);
+}
+
+static void
+ble_phy_rx_end(void)
+{
+    struct phy_medium_frame hdr;
+    struct phy_medium_frame *frame;
+    struct ble_mbuf_hdr *ble_hdr;
+    uint8_t *dptr;
+    int crcok;
+    int rc;
+
+    frame = &g_ble_phy_rx_frame;
+    dptr = (uint8_t *)&g_ble_phy_rx_buf[0];
+    ble_hdr = &g_ble_phy_data.rxhdr;
+
+    STATS_INC(ble_phy_stats, phy_isrs);
+
+    /* Transmitter may have been disabled while frame was on air */
+    crcok = (phy_medium_peek(frame->seq, &hdr) != PHY_MEDIUM_OK) ||
+            !(hdr.flags & PHY_MEDIUM_F_ABORTED);
+
+#if MYNEWT_VAL(BLE_PHY_NATIVE_COLLISIONS)
+    if (crcok && phy_medium_collides(frame)) {
+        STATS_INC(ble_phy_stats, rx_collisions);
+        crcok = 0;
+    }
+#endif
+
+#if MYNEWT_VAL(BLE_PHY_NATIVE_LOSS_PERMILLE)
+    if (crcok &&
+        (ble_phy_rand() % 1000 < MYNEWT_VAL(BLE_PHY_NATIVE_LOSS_PERMILLE))) {
+        STATS_INC(ble_phy_stats, rx_lost);
+        crcok = 0;
+    }
+#endif
+
+    ble_hdr->rxinfo.rssi = frame->txpwr_dbm -
+                           MYNEWT_VAL(BLE_PHY_NATIVE_PATH_LOSS_DB) +
+                           g_ble_phy_data.rx_pwr_compensation;
+
+    /* Count PHY crc errors and valid packets */
+    if (!crcok) {
+        STATS_INC(ble_phy_stats, rx_crc_err);
+    } else {
+        STATS_INC(ble_phy_stats, rx_valid);
         ble_hdr->rxinfo.flags |= BLE_MBUF_HDR_F_CRC_OK;
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION)
+        if (g_ble_phy_data.phy_encrypted && (ble_phy_decrypt(dptr) != 0)) {
+            ble_hdr->rxinfo.flags |= BLE_MBUF_HDR_F_MIC_FAILURE;
+        }
+#endif
+    }
+
+    g_ble_phy_data.phy_state = BLE_PHY_STATE_IDLE;
+    g_ble_phy_data.phy_rx_started = 0;
+    g_ble_phy_data.phy_rx_seq = 0;
+    g_ble_phy_data.phy_evt = BLE_PHY_EVT_NONE;
+
+    /* Response, if any, goes out exactly T_IFS after end of this frame */
+    g_ble_phy_data.phy_tx_start_us = frame->end_us + BLE_LL_IFS;
+    g_ble_phy_data.phy_tx_start_set = 1;
+
+    rc = ble_ll_rx_end(dptr, ble_hdr);
+    if (rc < 0) {
+        ble_phy_disable();
+    }
+}
+
+static void
+ble_phy_tx_end(void)
+{
+    struct phy_medium_frame *frame;
+    uint8_t transition;
+    uint64_t wfr_end_us;
+    uint64_t rx_start_us;
+
+    /* Better be in TX state! */
+    assert(g_ble_phy_data.phy_state == BLE_PHY_STATE_TX);
+
+    STATS_INC(ble_phy_stats, phy_isrs);
 
-        /* Call Link Layer receive payload function */
-        rc = ble_ll_rx_end(g_ble_phy_data.rxdptr, ble_hdr);
-        if (rc < 0) {
-            /* Disable the PHY. */
-            ble_phy_disable();
+    frame = &g_ble_phy_tx_frame;
+    transition = g_ble_phy_data.phy_transition;
+
+    g_ble_phy_data.phy_state = BLE_PHY_STATE_IDLE;
+    g_ble_phy_data.phy_evt = BLE_PHY_EVT_NONE;
+    g_ble_phy_data.phy_tx_seq = 0;
+    g_ble_phy_data.phy_tx_start_set = 0;
+
+    if (transition == BLE_PHY_TRANSITION_TX_TX) {
+        if (g_ble_phy_data.txtx_time_anchor) {
+            g_ble_phy_data.phy_tx_start_us = frame->end_us;
+        } else {
+            g_ble_phy_data.phy_tx_start_us = frame->start_us;
         }
+        g_ble_phy_data.phy_tx_start_us += g_ble_phy_data.txtx_time_us;
+        g_ble_phy_data.phy_tx_start_set = 1;
+    }
+
+    if (g_ble_phy_data.txend_cb) {
+        g_ble_phy_data.txend_cb(g_ble_phy_data.txend_arg);
+    }
+
+    if (transition == BLE_PHY_TRANSITION_TX_RX) {
+        /* Response shall start T_IFS after TX end; allow for clock accuracy */
+        rx_start_us = frame->end_us + BLE_LL_IFS - 2;
+        wfr_end_us = frame->end_us + BLE_LL_IFS + 2 +
+                     ble_ll_pdu_syncword_us(g_ble_phy_data.phy_rx_phy_mode);
+        ble_phy_rx(rx_start_us, wfr_end_us);
+    } else {
+        assert(transition != BLE_PHY_TRANSITION_RX_TX);
     }
+}
 
-    /* Count # of interrupts */
-    ++g_ble_phy_stats.phy_isrs;
+static void
+ble_phy_timer_cb(void *arg)
+{
+    switch (g_ble_phy_data.phy_evt) {
+    case BLE_PHY_EVT_RX_SYNC:
+        ble_phy_rx_sync();
+        break;
+    case BLE_PHY_EVT_RX_END:
+        ble_phy_rx_end();
+        break;
+    case BLE_PHY_EVT_TX_END:
+        ble_phy_tx_end();
+        break;
+    default:
+        break;
+    }
 }
 
 /**
@@ -310,28 +814,43 @@ ble_phy_isr(void)
 int
 ble_phy_init(void)
 {
+    int rc;
+
     /* Set phy channel to an invalid channel so first set channel works */
     g_ble_phy_data.phy_state = BLE_PHY_STATE_IDLE;
     g_ble_phy_data.phy_chan = BLE_PHY_NUM_CHANS;
+    g_ble_phy_data.phy_tx_phy_mode = BLE_PHY_MODE_1M;
+    g_ble_phy_data.phy_rx_phy_mode = BLE_PHY_MODE_1M;
+    g_ble_phy_data.phy_evt = BLE_PHY_EVT_NONE;
 
     g_ble_phy_data.rx_pwr_compensation = 0;
 
-    /* XXX: emulate ISR? */
+    os_cputime_timer_init(&g_ble_phy_data.phy_timer, ble_phy_timer_cb, NULL);
+    os_cputime_timer_init(&g_ble_phy_data.poll_timer, ble_phy_poll_timer_cb,
+                          NULL);
 
-    return 0;
-}
+    /* Join on first init, or again if the medium was left since */
+    if (!phy_medium_joined()) {
+        rc = phy_medium_join(MYNEWT_VAL(BLE_PHY_NATIVE_MEDIUM),
+                             &g_ble_phy_data.phy_node);
+        if (rc != 0) {
+            return BLE_PHY_ERR_INIT;
+        }
 
-int
-ble_phy_rx(void)
-{
-    /* Check radio state */
-    if (ble_phy_state_get() != BLE_PHY_STATE_IDLE) {
-        ble_phy_disable();
-        ++g_ble_phy_stats.radio_state_errs;
-        return BLE_PHY_ERR_RADIO_STATE;
+        g_ble_phy_data.phy_rand = 0x9e3779b9 * g_ble_phy_data.phy_node;
     }
 
-    g_ble_phy_data.phy_state = BLE_PHY_STATE_RX;
+    /* Register phy statistics */
+    if (!g_ble_phy_data.phy_stats_initialized) {
+        rc = stats_init_and_reg(STATS_HDR(ble_phy_stats),
+                                STATS_SIZE_INIT_PARMS(ble_phy_stats,
+                                                      STATS_SIZE_32),
+                                STATS_NAME_INIT_PARMS(ble_phy_stats),
+                                "ble_phy");
+        assert(rc == 0);
+
+        g_ble_phy_data.phy_stats_initialized = 1;
+    }
 
     return 0;
 }
@@ -339,32 +858,42 @@ ble_phy_rx(void)
 void
 ble_phy_restart_rx(void)
 {
+    ble_phy_disable();
+    ble_phy_rx(phy_medium_now_us(), 0);
 }
 
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION)
 void
 ble_phy_encrypt_enable(const uint8_t *key)
 {
+    tc_aes128_set_encrypt_key(&g_ble_phy_ccm_data.sched, key);
+    g_ble_phy_ccm_data.headermask = BLE_LL_PDU_HEADERMASK_DATA;
+    g_ble_phy_data.phy_encrypted = 1;
 }
 
 void
 ble_phy_encrypt_header_mask_set(uint8_t mask)
 {
+    g_ble_phy_ccm_data.headermask = mask;
 }
 
 void
 ble_phy_encrypt_iv_set(const uint8_t *iv)
 {
+    memcpy(g_ble_phy_ccm_data.iv, iv, 8);
 }
 
 void
 ble_phy_encrypt_counter_set(uint64_t counter, uint8_t dir_bit)
 {
+    g_ble_phy_ccm_data.pkt_counter = counter;
+    g_ble_phy_ccm_data.dir_bit = dir_bit;
 }
 
 void
 ble_phy_encrypt_disable(void)
 {
+    g_ble_phy_data.phy_encrypted = 0;
 }
 #endif
 
@@ -393,6 +922,16 @@ ble_phy_set_txend_cb(ble_phy_tx_end_func txend_cb, void *arg)
 int
 ble_phy_tx_set_start_time(uint32_t cputime, uint8_t rem_usecs)
 {
+    if (CPUTIME_LT(cputime, os_cputime_get32())) {
+        ble_phy_disable();
+        STATS_INC(ble_phy_stats, tx_late);
+        return BLE_PHY_ERR_TX_LATE;
+    }
+
+    g_ble_phy_data.phy_tx_start_us = ble_phy_cputime_to_us(cputime,
+                                                           rem_usecs);
+    g_ble_phy_data.phy_tx_start_set = 1;
+
     return 0;
 }
 
@@ -400,7 +939,8 @@ ble_phy_tx_set_start_time(uint32_t cputime, uint8_t rem_usecs)
  * Called to set the start time of a reception
  *
  * This function acts a bit differently than transmit. If we are late getting
- * here we will still attempt to receive.
+ * here we will still attempt to receive: frames carry their on-air time, so
+ * the receive window simply opens at the requested time.
  *
  * NOTE: care must be taken when calling this function. The channel should
  * already be set.
@@ -413,40 +953,70 @@ ble_phy_tx_set_start_time(uint32_t cputime, uint8_t rem_usecs)
 int
 ble_phy_rx_set_start_time(uint32_t cputime, uint8_t rem_usecs)
 {
-    return 0;
+    return ble_phy_rx(ble_phy_cputime_to_us(cputime, rem_usecs), 0);
 }
 
-
 int
 ble_phy_tx(ble_phy_tx_pducb_t pducb, void *pducb_arg, uint8_t end_trans)
 {
+    struct phy_medium_frame *frame;
+    uint8_t payload_len;
     uint8_t hdr_byte;
-    int rc;
+    uint64_t now;
 
     if (ble_phy_state_get() != BLE_PHY_STATE_IDLE) {
         ble_phy_disable();
-        ++g_ble_phy_stats.radio_state_errs;
+        STATS_INC(ble_phy_stats, radio_state_errs);
         return BLE_PHY_ERR_RADIO_STATE;
     }
 
-    /* Select tx address */
-    if (g_ble_phy_data.phy_chan < BLE_PHY_NUM_DATA_CHANS) {
-        /* XXX: fix this */
-        assert(0);
-    } else {
+    frame = &g_ble_phy_tx_frame;
+
+    /* Set PDU payload */
+    payload_len = pducb(&frame->data[2], pducb_arg, &hdr_byte);
+    frame->data[0] = hdr_byte;
+    frame->data[1] = payload_len;
+
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION)
+    if (g_ble_phy_data.phy_encrypted) {
+        ble_phy_encrypt(frame->data);
     }
+#endif
+
+    now = phy_medium_now_us();
+    if (!g_ble_phy_data.phy_tx_start_set) {
+        g_ble_phy_data.phy_tx_start_us = now;
+    }
+
+    frame->node = g_ble_phy_data.phy_node;
+    frame->chan = g_ble_phy_data.phy_chan;
+    frame->phy_mode = g_ble_phy_data.phy_tx_phy_mode;
+    frame->access_addr = g_ble_phy_data.phy_access_address;
+    frame->txpwr_dbm = g_ble_phy_data.phy_txpwr_dbm;
+    frame->flags = 0;
+    frame->len = frame->data[1] + BLE_LL_PDU_HDR_LEN;
+    frame->start_us = g_ble_phy_data.phy_tx_start_us;
+    frame->end_us = frame->start_us +
+                    ble_ll_pdu_us(frame->data[1], frame->phy_mode);
+
+    /* Put the frame on air and wait for it to end */
+    g_ble_phy_data.phy_tx_seq = phy_medium_publish(frame);
+    g_ble_phy_data.phy_tx_start_set = 0;
+    g_ble_phy_data.phy_evt = BLE_PHY_EVT_TX_END;
+    ble_phy_timer_start_at(&g_ble_phy_data.phy_timer, frame->end_us);
 
     /* Set the PHY transition */
     g_ble_phy_data.phy_transition = end_trans;
 
+    /* Set transmitted payload length */
+    g_ble_phy_data.phy_tx_pyld_len = payload_len;
+
     /* Set phy state to transmitting and count packet statistics */
     g_ble_phy_data.phy_state = BLE_PHY_STATE_TX;
-    ++g_ble_phy_stats.tx_good;
-    g_ble_phy_stats.tx_bytes += pducb(g_ble_phy_tx_buf, pducb_arg, &hdr_byte) +
-                                BLE_LL_PDU_HDR_LEN;
-    rc = BLE_ERR_SUCCESS;
+    STATS_INC(ble_phy_stats, tx_good);
+    STATS_INCN(ble_phy_stats, tx_bytes, payload_len + BLE_LL_PDU_HDR_LEN);
 
-    return rc;
+    return BLE_ERR_SUCCESS;
 }
 
 /**
@@ -572,9 +1142,32 @@ ble_phy_chan_get(void)
 void
 ble_phy_disable(void)
 {
+    os_cputime_timer_stop(&g_ble_phy_data.phy_timer);
+    os_cputime_timer_stop(&g_ble_phy_data.poll_timer);
+
+    /* Frame we have not finished transmitting is cut off */
+    if (g_ble_phy_data.phy_tx_seq) {
+        phy_medium_abort(g_ble_phy_data.phy_tx_seq);
+        g_ble_phy_data.phy_tx_seq = 0;
+    }
+
     g_ble_phy_data.phy_state = BLE_PHY_STATE_IDLE;
+    g_ble_phy_data.phy_evt = BLE_PHY_EVT_NONE;
+    g_ble_phy_data.phy_rx_started = 0;
+    g_ble_phy_data.phy_rx_seq = 0;
+    g_ble_phy_data.phy_wfr_end_us = 0;
+    g_ble_phy_data.phy_tx_start_set = 0;
 }
 
+#if (MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_2M_PHY) || MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_CODED_PHY))
+void
+ble_phy_mode_set(uint8_t tx_phy_mode, uint8_t rx_phy_mode)
+{
+    g_ble_phy_data.phy_tx_phy_mode = tx_phy_mode;
+    g_ble_phy_data.phy_rx_phy_mode = rx_phy_mode;
+}
+#endif
+
 /* Gets the current access address */
 uint32_t ble_phy_access_addr_get(void)
 {
@@ -645,6 +1238,27 @@ ble_phy_xcvr_state_get(void)
 void
 ble_phy_wfr_enable(int txrx, uint8_t tx_phy_mode, uint32_t wfr_usecs)
 {
+    /* TX->RX wait for response is set up on TX end */
+    if ((txrx == BLE_PHY_WFR_ENABLE_TXRX) ||
+        (g_ble_phy_data.phy_state != BLE_PHY_STATE_RX)) {
+        return;
+    }
+
+    /* Access address shall be received no later than wfr_usecs after RX
+     * was enabled.
+     */
+    g_ble_phy_data.phy_wfr_end_us = g_ble_phy_data.phy_rx_start_us +
+        wfr_usecs + ble_ll_pdu_syncword_us(g_ble_phy_data.phy_rx_phy_mode);
+
+    /* Frame picked up before the wait for response was set may be past it */
+    if (g_ble_phy_data.phy_rx_seq &&
+        !ble_phy_rx_match(&g_ble_phy_rx_frame)) {
+        os_cputime_timer_stop(&g_ble_phy_data.phy_timer);
+        g_ble_phy_data.phy_rx_seq = 0;
+        g_ble_phy_data.phy_evt = BLE_PHY_EVT_NONE;
+    }
+
+    ble_phy_rx_poll();
 }
 
 void
@@ -660,4 +1274,6 @@ ble_phy_rfclk_disable(void)
 void
 ble_phy_tifs_txtx_set(uint16_t usecs, uint8_t anchor)
 {
+    g_ble_phy_data.txtx_time_us = usecs;
+    g_ble_phy_data.txtx_time_anchor = anchor;
 }
@@ -0,0 +1,371 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "phy_priv.h"
+
+#define PHY_MEDIUM_MAGIC            (0x4e4d4501)    /* "NME", version 1 */
+
+#define PHY_MEDIUM_HDR_LEN          offsetof(struct phy_medium_frame, data)
+
+/*
+ * Frames are written lock-free, seqlock style: the writer clears the frame
+ * sequence number, fills the frame and then stores the new sequence number.
+ * A reader copies the frame and accepts the copy only if the sequence number
+ * it expects was there both before and after copying.
+ */
+struct phy_medium {
+    uint32_t magic;
+    uint32_t head;
+    /* Node identifiers handed out so far */
+    uint32_t nodes;
+    /* Nodes currently attached */
+    uint32_t users;
+    struct phy_medium_frame frames[PHY_MEDIUM_FRAMES];
+};
+
+static struct phy_medium *g_phy_medium;
+static char g_phy_medium_name[PHY_MEDIUM_NAME_MAX];
+
+static struct phy_medium_frame *
+phy_medium_slot(uint32_t seq)
+{
+    return &g_phy_medium->frames[seq & (PHY_MEDIUM_FRAMES - 1)];
+}
+
+/**
+ * Builds the name of the shared memory object for this run. The process
+ * group ID is appended to the base name, so controllers started together
+ * share a medium while separate runs do not. PHY_MEDIUM_ENV overrides the
+ * whole name, e.g. for controllers started from different shells.
+ */
+static int
+phy_medium_make_name(const char *base, char *name, size_t len)
+{
+    const char *env;
+    int rc;
+
+    env = getenv(PHY_MEDIUM_ENV);
+    if ((env != NULL) && (env[0] != '\0')) {
+        rc = snprintf(name, len, "%s", env);
+    } else {
+        rc = snprintf(name, len, "%s.%ld", base, (long)getpgrp());
+    }
+
+    if ((rc < 0) || ((size_t)rc >= len) || (name[0] != '/')) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Attaches to (creating it, if needed) the shared memory object holding the
+ * medium and assigns this node an identifier unique on the medium. The node
+ * leaves the medium when the process exits.
+ *
+ * @param base      Base name of the POSIX shared memory object.
+ * @param out_node  On success, the node identifier is written here.
+ *
+ * @return int 0 on success; -1 on failure.
+ */
+int
+phy_medium_join(const char *base, uint16_t *out_node)
+{
+    static uint8_t exit_registered;
+    struct phy_medium *medium;
+    struct stat st;
+    uint32_t magic;
+    int fd;
+
+    if (g_phy_medium != NULL) {
+        return -1;
+    }
+
+    if (phy_medium_make_name(base, g_phy_medium_name,
+                             sizeof(g_phy_medium_name)) != 0) {
+        return -1;
+    }
+
+    fd = shm_open(g_phy_medium_name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* Only grow the object; a fresh object is zero-filled which is a valid
+     * empty medium.
+     */
+    if ((fstat(fd, &st) != 0) ||
+        ((st.st_size < (off_t)sizeof(*medium)) &&
+         (ftruncate(fd, sizeof(*medium)) != 0))) {
+        close(fd);
+        return -1;
+    }
+
+    medium = mmap(NULL, sizeof(*medium), PROT_READ | PROT_WRITE, MAP_SHARED,
+                  fd, 0);
+    close(fd);
+    if (medium == MAP_FAILED) {
+        return -1;
+    }
+
+    magic = 0;
+    if (!__atomic_compare_exchange_n(&medium->magic, &magic,
+                                     PHY_MEDIUM_MAGIC, 0, __ATOMIC_SEQ_CST,
+                                     __ATOMIC_SEQ_CST) &&
+        (magic != PHY_MEDIUM_MAGIC)) {
+        /* Created by an incompatible version */
+        munmap(medium, sizeof(*medium));
+        return -1;
+    }
+
+    if (!exit_registered) {
+        if (atexit(phy_medium_leave) != 0) {
+            munmap(medium, sizeof(*medium));
+            return -1;
+        }
+        exit_registered = 1;
+    }
+
+    g_phy_medium = medium;
+    __atomic_add_fetch(&medium->users, 1, __ATOMIC_SEQ_CST);
+    *out_node = __atomic_add_fetch(&medium->nodes, 1, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+/**
+ * Detaches from the medium. The last node to leave removes the shared memory
+ * object, so nothing is left behind once a run is over. A node joining at the
+ * same time may end up alone on the removed object.
+ */
+void
+phy_medium_leave(void)
+{
+    struct phy_medium *medium;
+    uint32_t users;
+
+    medium = g_phy_medium;
+    if (medium == NULL) {
+        return;
+    }
+
+    g_phy_medium = NULL;
+
+    users = __atomic_sub_fetch(&medium->users, 1, __ATOMIC_SEQ_CST);
+    munmap(medium, sizeof(*medium));
+
+    if (users == 0) {
+        shm_unlink(g_phy_medium_name);
+    }
+}
+
+/**
+ * Checks if this process is currently attached to a medium.
+ */
+int
+phy_medium_joined(void)
+{
+    return g_phy_medium != NULL;
+}
+
+/**
+ * Returns the name of the shared memory object of the medium last joined.
+ */
+const char *
+phy_medium_name(void)
+{
+    return g_phy_medium_name;
+}
+
+/**
+ * Returns the current medium time, in microseconds.
+ */
+uint64_t
+phy_medium_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Returns the sequence number of the most recently published frame.
+ */
+uint32_t
+phy_medium_head(void)
+{
+    return __atomic_load_n(&g_phy_medium->head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Publishes a frame on the medium.
+ *
+ * @param frame The frame to publish; its sequence number is filled in.
+ *
+ * @return uint32_t Sequence number assigned to the frame.
+ */
+uint32_t
+phy_medium_publish(struct phy_medium_frame *frame)
+{
+    struct phy_medium_frame *slot;
+    uint32_t seq;
+
+    do {
+        seq = __atomic_add_fetch(&g_phy_medium->head, 1, __ATOMIC_SEQ_CST);
+    } while (seq == 0);
+
+    frame->seq = seq;
+    slot = phy_medium_slot(seq);
+
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy((uint8_t *)slot + sizeof(slot->seq),
+           (uint8_t *)frame + sizeof(frame->seq),
+           PHY_MEDIUM_HDR_LEN - sizeof(frame->seq) + frame->len);
+
+    __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+
+    return seq;
+}
+
+/**
+ * Marks a published frame as aborted, e.g. if the transmitter got disabled
+ * before or during the transmission. Receivers treat it as not sent.
+ */
+void
+phy_medium_abort(uint32_t seq)
+{
+    struct phy_medium_frame *slot;
+
+    slot = phy_medium_slot(seq);
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == seq) {
+        __atomic_or_fetch(&slot->flags, PHY_MEDIUM_F_ABORTED,
+                          __ATOMIC_RELEASE);
+    }
+}
+
+static int
+phy_medium_copy(uint32_t seq, struct phy_medium_frame *frame, int with_data)
+{
+    struct phy_medium_frame *slot;
+    uint32_t seq1;
+    uint32_t seq2;
+    size_t len;
+
+    slot = phy_medium_slot(seq);
+
+    seq1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq1 != seq) {
+        return (seq1 == 0) || ((int32_t)(seq1 - seq) < 0) ?
+               PHY_MEDIUM_EAGAIN : PHY_MEDIUM_ESTALE;
+    }
+
+    memcpy(frame, slot, PHY_MEDIUM_HDR_LEN);
+    if (with_data) {
+        len = frame->len;
+        if (len > sizeof(frame->data)) {
+            return PHY_MEDIUM_ESTALE;
+        }
+        memcpy(frame->data, slot->data, len);
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    seq2 = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    if (seq2 != seq) {
+        return PHY_MEDIUM_ESTALE;
+    }
+
+    frame->seq = seq;
+
+    return PHY_MEDIUM_OK;
+}
+
+/**
+ * Reads the header (all but the data) of a published frame.
+ *
+ * @return int PHY_MEDIUM_OK on success, PHY_MEDIUM_EAGAIN if the frame is not
+ *             published yet, PHY_MEDIUM_ESTALE if it was overwritten.
+ */
+int
+phy_medium_peek(uint32_t seq, struct phy_medium_frame *hdr)
+{
+    return phy_medium_copy(seq, hdr, 0);
+}
+
+/**
+ * Reads a published frame, including its data.
+ *
+ * @return int PHY_MEDIUM_OK on success, PHY_MEDIUM_EAGAIN if the frame is not
+ *             published yet, PHY_MEDIUM_ESTALE if it was overwritten.
+ */
+int
+phy_medium_read(uint32_t seq, struct phy_medium_frame *frame)
+{
+    return phy_medium_copy(seq, frame, 1);
+}
+
+/**
+ * Checks if any other frame on the same channel overlaps the given frame in
+ * time. Overlapping frames corrupt each other; there is no capture effect.
+ *
+ * @return int 1 if a collision occurred; 0 otherwise.
+ */
+int
+phy_medium_collides(const struct phy_medium_frame *frame)
+{
+    struct phy_medium_frame hdr;
+    uint32_t head;
+    uint32_t seq;
+    int i;
+
+    head = phy_medium_head();
+
+    for (i = 0; i < PHY_MEDIUM_FRAMES; i++) {
+        seq = head - i;
+        if ((seq == 0) || (seq == frame->seq)) {
+            continue;
+        }
+
+        if (phy_medium_peek(seq, &hdr) != PHY_MEDIUM_OK) {
+            continue;
+        }
+
+        if ((hdr.chan == frame->chan) &&
+            !(hdr.flags & PHY_MEDIUM_F_ABORTED) &&
+            (hdr.start_us < frame->end_us) &&
+            (hdr.end_us > frame->start_us)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
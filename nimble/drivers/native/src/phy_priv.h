@@ -0,0 +1,86 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_PHY_PRIV_
+#define H_PHY_PRIV_
+
+#include <stdint.h>
+#include "controller/ble_phy.h"
+
+/*
+ * Virtual radio medium shared by all native controllers that join the same
+ * POSIX shared memory object. Each transmitted PDU is published as a frame
+ * stamped with its on-air start and end time; receivers pick frames up from
+ * the medium and deliver them to the link layer at the stamped times.
+ *
+ * All times are in microseconds of CLOCK_MONOTONIC, which is common to all
+ * processes on the host.
+ */
+
+/* Number of frames kept in the medium; must be a power of 2 */
+#define PHY_MEDIUM_FRAMES           (256)
+
+/*
+ * Upper bound on how long before its on-air start time a frame is published.
+ * Used to limit how far back a receiver looks when its radio is enabled.
+ */
+#define PHY_MEDIUM_MAX_LEAD_US      (10000)
+
+#define PHY_MEDIUM_F_ABORTED        (0x01)
+
+/* Maximum length of the name of the medium, including terminating NUL */
+#define PHY_MEDIUM_NAME_MAX         (64)
+
+/* Environment variable overriding the name of the medium */
+#define PHY_MEDIUM_ENV              "NIMBLE_PHY_MEDIUM"
+
+/* phy_medium_peek() and phy_medium_read() return codes */
+#define PHY_MEDIUM_OK               (0)
+#define PHY_MEDIUM_EAGAIN           (1)     /* frame still being written */
+#define PHY_MEDIUM_ESTALE           (2)     /* frame already overwritten */
+
+struct phy_medium_frame {
+    /* Sequence number; 0 while the frame is being written */
+    uint32_t seq;
+    uint16_t node;
+    uint8_t chan;
+    uint8_t phy_mode;
+    uint32_t access_addr;
+    int8_t txpwr_dbm;
+    uint8_t flags;
+    uint16_t len;
+    uint64_t start_us;
+    uint64_t end_us;
+    /* LL header (2 bytes) and payload, including MIC if encrypted */
+    uint8_t data[BLE_PHY_MAX_PDU_LEN];
+};
+
+int phy_medium_join(const char *base, uint16_t *out_node);
+void phy_medium_leave(void);
+int phy_medium_joined(void);
+const char *phy_medium_name(void);
+uint64_t phy_medium_now_us(void);
+uint32_t phy_medium_head(void);
+uint32_t phy_medium_publish(struct phy_medium_frame *frame);
+void phy_medium_abort(uint32_t seq);
+int phy_medium_peek(uint32_t seq, struct phy_medium_frame *hdr);
+int phy_medium_read(uint32_t seq, struct phy_medium_frame *frame);
+int phy_medium_collides(const struct phy_medium_frame *frame);
+
+#endif /* H_PHY_PRIV_ */
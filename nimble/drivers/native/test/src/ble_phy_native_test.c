@@ -0,0 +1,245 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <syscfg/syscfg.h>
+#include <testutil/testutil.h>
+#include "phy_priv.h"
+
+#if MYNEWT_VAL(SELFTEST)
+
+#define BLE_PHY_NATIVE_TEST_BASE        "/nimble-phy-test"
+#define BLE_PHY_NATIVE_TEST_CHAN        (37)
+#define BLE_PHY_NATIVE_TEST_AA          (0x8e89bed6)
+
+#define BLE_PHY_NATIVE_TEST_PING        (0x01)
+#define BLE_PHY_NATIVE_TEST_PONG        (0x02)
+
+/* Polling interval and number of polls before giving up on the peer */
+#define BLE_PHY_NATIVE_TEST_POLL_US     (1000)
+#define BLE_PHY_NATIVE_TEST_POLLS       (5000)
+
+static int
+ble_phy_native_test_exists(const char *name)
+{
+    int fd;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return errno != ENOENT;
+    }
+
+    close(fd);
+    return 1;
+}
+
+static void
+ble_phy_native_test_send(uint16_t node, uint8_t type, uint16_t to)
+{
+    struct phy_medium_frame frame;
+    uint64_t now;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.node = node;
+    frame.chan = BLE_PHY_NATIVE_TEST_CHAN;
+    frame.phy_mode = BLE_PHY_MODE_1M;
+    frame.access_addr = BLE_PHY_NATIVE_TEST_AA;
+    frame.len = 3;
+    frame.data[0] = type;
+    frame.data[1] = to;
+    frame.data[2] = to >> 8;
+
+    now = phy_medium_now_us();
+    frame.start_us = now;
+    frame.end_us = now + 80;
+
+    phy_medium_publish(&frame);
+}
+
+/**
+ * Waits for a frame of the given type sent by another node to this one.
+ *
+ * @return int 0 on success; -1 if no such frame arrived in time.
+ */
+static int
+ble_phy_native_test_recv(uint16_t node, uint8_t type, uint16_t to,
+                         struct phy_medium_frame *frame)
+{
+    uint32_t next;
+    uint32_t head;
+    int polls;
+    int rc;
+
+    next = 1;
+
+    for (polls = 0; polls < BLE_PHY_NATIVE_TEST_POLLS; polls++) {
+        head = phy_medium_head();
+
+        while ((int32_t)(head - next) >= 0) {
+            rc = phy_medium_read(next, frame);
+            if (rc == PHY_MEDIUM_EAGAIN) {
+                break;
+            }
+            next++;
+
+            if ((rc == PHY_MEDIUM_OK) && (frame->node != node) &&
+                (frame->len == 3) && (frame->data[0] == type) &&
+                (frame->data[1] == (uint8_t)to) &&
+                (frame->data[2] == (uint8_t)(to >> 8))) {
+                return 0;
+            }
+        }
+
+        usleep(BLE_PHY_NATIVE_TEST_POLL_US);
+    }
+
+    return -1;
+}
+
+/**
+ * Second node: pings the first one and waits for its answer. Runs in a
+ * separate process, which joins the medium on its own.
+ */
+static int
+ble_phy_native_test_peer(void)
+{
+    struct phy_medium_frame frame;
+    uint16_t node;
+    int rc;
+
+    if (phy_medium_join(BLE_PHY_NATIVE_TEST_BASE, &node) != 0) {
+        return 1;
+    }
+
+    ble_phy_native_test_send(node, BLE_PHY_NATIVE_TEST_PING, 0);
+    rc = ble_phy_native_test_recv(node, BLE_PHY_NATIVE_TEST_PONG, node,
+                                  &frame);
+
+    phy_medium_leave();
+
+    return rc == 0 ? 0 : 2;
+}
+
+TEST_CASE_SELF(ble_phy_native_test_two_nodes)
+{
+    struct phy_medium_frame frame;
+    char name[PHY_MEDIUM_NAME_MAX];
+    uint16_t node;
+    pid_t pid;
+    int status;
+    int rc;
+
+    /* A medium for this test only, named through the environment so that
+     * the second node finds it.
+     */
+    snprintf(name, sizeof(name), "%s.%ld", BLE_PHY_NATIVE_TEST_BASE,
+             (long)getpid());
+    shm_unlink(name);
+    rc = setenv(PHY_MEDIUM_ENV, name, 1);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    pid = fork();
+    TEST_ASSERT_FATAL(pid >= 0);
+    if (pid == 0) {
+        _exit(ble_phy_native_test_peer());
+    }
+
+    rc = phy_medium_join(BLE_PHY_NATIVE_TEST_BASE, &node);
+    TEST_ASSERT(rc == 0);
+
+    if (rc == 0) {
+        TEST_ASSERT(strcmp(phy_medium_name(), name) == 0);
+
+        /* Both nodes hear each other and have distinct identifiers. */
+        rc = ble_phy_native_test_recv(node, BLE_PHY_NATIVE_TEST_PING, 0,
+                                      &frame);
+        TEST_ASSERT(rc == 0);
+        if (rc == 0) {
+            TEST_ASSERT(frame.node != node);
+            TEST_ASSERT(frame.chan == BLE_PHY_NATIVE_TEST_CHAN);
+            TEST_ASSERT(frame.access_addr == BLE_PHY_NATIVE_TEST_AA);
+            TEST_ASSERT(frame.end_us > frame.start_us);
+            ble_phy_native_test_send(node, BLE_PHY_NATIVE_TEST_PONG,
+                                     frame.node);
+        }
+    }
+
+    TEST_ASSERT_FATAL(waitpid(pid, &status, 0) == pid);
+    TEST_ASSERT(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+
+    /* The medium lives until its last node leaves. */
+    TEST_ASSERT(ble_phy_native_test_exists(name) == (rc == 0));
+    phy_medium_leave();
+    TEST_ASSERT(!ble_phy_native_test_exists(name));
+
+    unsetenv(PHY_MEDIUM_ENV);
+}
+
+TEST_CASE_SELF(ble_phy_native_test_name)
+{
+    char name[PHY_MEDIUM_NAME_MAX];
+    uint16_t node;
+    int rc;
+
+    /* Without an override, processes of one process group share a medium. */
+    unsetenv(PHY_MEDIUM_ENV);
+    snprintf(name, sizeof(name), "%s.%ld", BLE_PHY_NATIVE_TEST_BASE,
+             (long)getpgrp());
+
+    rc = phy_medium_join(BLE_PHY_NATIVE_TEST_BASE, &node);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(strcmp(phy_medium_name(), name) == 0);
+    TEST_ASSERT(ble_phy_native_test_exists(name));
+
+    /* Only one medium at a time. */
+    rc = phy_medium_join(BLE_PHY_NATIVE_TEST_BASE, &node);
+    TEST_ASSERT(rc != 0);
+
+    phy_medium_leave();
+    TEST_ASSERT(!ble_phy_native_test_exists(name));
+
+    /* Leaving twice is harmless. */
+    phy_medium_leave();
+}
+
+TEST_SUITE_DECL(ble_phy_test_suite);
+
+TEST_SUITE(ble_phy_native_test_suite)
+{
+    ble_phy_native_test_two_nodes();
+    ble_phy_native_test_name();
+}
+
+int
+main(int argc, char **argv)
+{
+    ble_phy_native_test_suite();
+    ble_phy_test_suite();
+
+    return tu_any_failed;
+}
+
+#endif
@@ -0,0 +1,693 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <syscfg/syscfg.h>
+#include <testutil/testutil.h>
+#include "os/os.h"
+#include "os/os_cputime.h"
+#include "nimble/ble.h"
+#include "controller/ble_phy.h"
+#include "controller/ble_ll.h"
+#include "controller/ble_ll_ext.h"
+#include "controller/ble_ll_pdu.h"
+#include "phy_priv.h"
+
+#if MYNEWT_VAL(SELFTEST)
+
+/*
+ * The PHY under test runs on a medium of its own; frames from a "peer" are
+ * published on it directly by the test. The link layer is kept in external
+ * state so that the PHY reports to the ble_ll_ext hooks below.
+ */
+
+#define BLE_PHY_TEST_BASE       "/nimble-phy-test"
+#define BLE_PHY_TEST_PEER       (0xffff)
+#define BLE_PHY_TEST_CHAN       (10)
+#define BLE_PHY_TEST_AA         (0x71764129)
+
+/* Lead time given to the PHY before the first frame of a test goes on air */
+#define BLE_PHY_TEST_LEAD_US    (5000)
+
+/* Every received frame has its CRC checked, unless the loss model drops all */
+#define BLE_PHY_TEST_CRC_OK     (MYNEWT_VAL(BLE_PHY_NATIVE_LOSS_PERMILLE) == 0)
+
+static struct ble_phy_test_rx {
+    int starts;
+    int ends;
+    int wfr_exps;
+    int tx_ends;
+    int respond;
+    uint16_t flags;
+    uint32_t beg_cputime;
+    uint8_t rem_usecs;
+    uint64_t start_us;
+    uint64_t end_us;
+    uint64_t wfr_us;
+    uint8_t pdu[BLE_PHY_MAX_PDU_LEN];
+} ble_phy_test_rx;
+
+static struct os_sem ble_phy_test_sem;
+
+/* Response sent from the end of reception when ble_phy_test_rx.respond */
+static const uint8_t ble_phy_test_rsp[] = { 0x01, 0x01, 0xaa };
+
+static uint8_t
+ble_phy_test_pducb(uint8_t *dptr, void *pducb_arg, uint8_t *hdr_byte)
+{
+    const uint8_t *pdu;
+
+    pdu = pducb_arg;
+    *hdr_byte = pdu[0];
+    memcpy(dptr, &pdu[2], pdu[1]);
+
+    return pdu[1];
+}
+
+static void
+ble_phy_test_txend_cb(void *arg)
+{
+    ble_phy_test_rx.tx_ends++;
+    os_sem_release(&ble_phy_test_sem);
+}
+
+void
+ble_ll_ext_init(void)
+{
+}
+
+void
+ble_ll_ext_reset(void)
+{
+}
+
+int
+ble_ll_ext_rx_isr_start(uint8_t pdu_type, struct ble_mbuf_hdr *rxhdr)
+{
+    ble_phy_test_rx.starts++;
+    ble_phy_test_rx.start_us = phy_medium_now_us();
+    ble_phy_test_rx.beg_cputime = rxhdr->beg_cputime;
+    ble_phy_test_rx.rem_usecs = rxhdr->rem_usecs;
+
+    return 0;
+}
+
+int
+ble_ll_ext_rx_isr_end(uint8_t *rxbuf, struct ble_mbuf_hdr *rxhdr)
+{
+    int rc;
+
+    ble_phy_test_rx.ends++;
+    ble_phy_test_rx.end_us = phy_medium_now_us();
+    ble_phy_test_rx.flags = rxhdr->rxinfo.flags;
+    memcpy(ble_phy_test_rx.pdu, rxbuf, rxbuf[1] + BLE_LL_PDU_HDR_LEN);
+
+    /* Leave the PHY as the test expects it before waking the test up */
+    if (ble_phy_test_rx.respond) {
+        ble_phy_tx(ble_phy_test_pducb, (void *)ble_phy_test_rsp,
+                   BLE_PHY_TRANSITION_NONE);
+        rc = 0;
+    } else {
+        ble_phy_disable();
+        rc = 1;
+    }
+
+    os_sem_release(&ble_phy_test_sem);
+
+    return rc;
+}
+
+void
+ble_ll_ext_rx_pkt_in(struct os_mbuf *rxpdu, struct ble_mbuf_hdr *rxhdr)
+{
+    os_mbuf_free_chain(rxpdu);
+}
+
+void
+ble_ll_ext_halt(void)
+{
+}
+
+void
+ble_ll_ext_wfr_timer_exp(void)
+{
+    ble_phy_test_rx.wfr_exps++;
+    ble_phy_test_rx.wfr_us = phy_medium_now_us();
+    ble_phy_disable();
+
+    os_sem_release(&ble_phy_test_sem);
+}
+
+void
+ble_ll_ext_sched_removed(struct ble_ll_sched_item *sch)
+{
+}
+
+/**
+ * Puts the PHY on a fresh medium, with receive hooks reset.
+ */
+static void
+ble_phy_test_init(void)
+{
+    char name[PHY_MEDIUM_NAME_MAX];
+    int rc;
+
+    phy_medium_leave();
+
+    snprintf(name, sizeof(name), "%s.%ld", BLE_PHY_TEST_BASE,
+             (long)getpid());
+    shm_unlink(name);
+    rc = setenv(PHY_MEDIUM_ENV, name, 1);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_phy_init();
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = os_sem_init(&ble_phy_test_sem, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    memset(&ble_phy_test_rx, 0, sizeof(ble_phy_test_rx));
+    ble_phy_set_txend_cb(ble_phy_test_txend_cb, NULL);
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION)
+    ble_phy_encrypt_disable();
+#endif
+    rc = ble_phy_setchan(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_ll_state_set(BLE_LL_STATE_EXTERNAL);
+}
+
+static void
+ble_phy_test_done(void)
+{
+    ble_phy_disable();
+    ble_ll_state_set(BLE_LL_STATE_STANDBY);
+    phy_medium_leave();
+    unsetenv(PHY_MEDIUM_ENV);
+}
+
+/**
+ * Waits for the next hook to report.
+ *
+ * @return int 0 if a hook reported; OS_TIMEOUT if none did within timeout.
+ */
+static int
+ble_phy_test_wait(os_time_t timeout)
+{
+    return os_sem_pend(&ble_phy_test_sem, timeout);
+}
+
+/**
+ * Publishes a frame from the peer.
+ *
+ * @param pdu LL header, length and payload of the frame.
+ *
+ * @return uint32_t Medium sequence number of the frame.
+ */
+static uint32_t
+ble_phy_test_inject(uint8_t chan, uint32_t access_addr, uint8_t phy_mode,
+                    uint64_t start_us, const uint8_t *pdu,
+                    struct phy_medium_frame *out_frame)
+{
+    struct phy_medium_frame frame;
+    uint32_t seq;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.node = BLE_PHY_TEST_PEER;
+    frame.chan = chan;
+    frame.phy_mode = phy_mode;
+    frame.access_addr = access_addr;
+    frame.len = pdu[1] + BLE_LL_PDU_HDR_LEN;
+    memcpy(frame.data, pdu, frame.len);
+    frame.start_us = start_us;
+    frame.end_us = start_us + ble_ll_pdu_us(pdu[1], phy_mode);
+
+    seq = phy_medium_publish(&frame);
+    if (out_frame != NULL) {
+        *out_frame = frame;
+    }
+
+    return seq;
+}
+
+/**
+ * Converts medium time to cputime, relative to a reference taken by the
+ * caller.
+ */
+static uint32_t
+ble_phy_test_cputime(uint32_t ref_cputime, uint64_t ref_us, uint64_t us)
+{
+    return ref_cputime + os_cputime_usecs_to_ticks(us - ref_us);
+}
+
+/**
+ * Enables the receiver at the given medium time.
+ */
+static void
+ble_phy_test_rx_at(uint64_t us)
+{
+    uint32_t cputime;
+    uint64_t now;
+    int rc;
+
+    now = phy_medium_now_us();
+    cputime = os_cputime_get32();
+    TEST_ASSERT_FATAL(us > now);
+
+    rc = ble_phy_rx_set_start_time(ble_phy_test_cputime(cputime, now, us), 0);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+/**
+ * Transmits a PDU at the given medium time and returns the frame as put on
+ * the medium.
+ */
+static void
+ble_phy_test_tx_at(uint64_t us, const uint8_t *pdu, uint8_t end_trans,
+                   struct phy_medium_frame *frame)
+{
+    uint32_t cputime;
+    uint64_t now;
+    int rc;
+
+    now = phy_medium_now_us();
+    cputime = os_cputime_get32();
+    TEST_ASSERT_FATAL(us > now);
+
+    rc = ble_phy_tx_set_start_time(ble_phy_test_cputime(cputime, now, us), 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_phy_tx(ble_phy_test_pducb, (void *)pdu, end_trans);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = phy_medium_read(phy_medium_head(), frame);
+    TEST_ASSERT_FATAL(rc == PHY_MEDIUM_OK);
+    TEST_ASSERT_FATAL(frame->node != BLE_PHY_TEST_PEER);
+}
+
+TEST_CASE_TASK(ble_phy_test_filter)
+{
+    static const uint8_t pdu_chan[] = { 0x02, 0x01, 0x01 };
+    static const uint8_t pdu_aa[] = { 0x02, 0x01, 0x02 };
+    static const uint8_t pdu_phy[] = { 0x02, 0x01, 0x03 };
+    static const uint8_t pdu_aborted[] = { 0x02, 0x01, 0x04 };
+    static const uint8_t pdu_ok[] = { 0x02, 0x01, 0x05 };
+    uint64_t start_us;
+    uint32_t seq;
+    int rc;
+
+    ble_phy_test_init();
+
+    start_us = phy_medium_now_us() + BLE_PHY_TEST_LEAD_US;
+
+    /* Frames the receiver shall not pick up, in on-air order ahead of the
+     * one it shall.
+     */
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN + 1, BLE_PHY_TEST_AA,
+                        BLE_PHY_MODE_1M, start_us + 1000, pdu_chan, NULL);
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA + 1,
+                        BLE_PHY_MODE_1M, start_us + 2000, pdu_aa, NULL);
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_2M_PHY)
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA,
+                        BLE_PHY_MODE_2M, start_us + 3000, pdu_phy, NULL);
+#else
+    (void)pdu_phy;
+#endif
+    seq = ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA,
+                              BLE_PHY_MODE_1M, start_us + 4000, pdu_aborted,
+                              NULL);
+    phy_medium_abort(seq);
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        start_us + 5000, pdu_ok, NULL);
+
+    ble_phy_test_rx_at(start_us);
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.starts == 1);
+    TEST_ASSERT(ble_phy_test_rx.ends == 1);
+    TEST_ASSERT(memcmp(ble_phy_test_rx.pdu, pdu_ok, sizeof(pdu_ok)) == 0);
+    TEST_ASSERT(!!(ble_phy_test_rx.flags & BLE_MBUF_HDR_F_CRC_OK) ==
+                BLE_PHY_TEST_CRC_OK);
+
+    ble_phy_test_done();
+}
+
+TEST_CASE_TASK(ble_phy_test_rx_window)
+{
+    static const uint8_t pdu_early[] = { 0x02, 0x01, 0x01 };
+    static const uint8_t pdu_ok[] = { 0x02, 0x01, 0x02 };
+    static const uint8_t pdu_late[] = { 0x02, 0x01, 0x03 };
+    struct phy_medium_frame frame;
+    struct phy_medium_frame rsp;
+    uint64_t start_us;
+    uint64_t ref_us;
+    uint32_t ref_cputime;
+    uint32_t beg_cputime;
+    int rc;
+
+    ble_phy_test_init();
+
+    ref_us = phy_medium_now_us();
+    ref_cputime = os_cputime_get32();
+    start_us = ref_us + BLE_PHY_TEST_LEAD_US;
+
+    /* Access address on air before the window opens is missed */
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        start_us - 1000, pdu_early, NULL);
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        start_us + 1000, pdu_ok, &frame);
+
+    ble_phy_test_rx.respond = 1;
+    ble_phy_test_rx_at(start_us);
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT_FATAL(ble_phy_test_rx.ends == 1);
+    TEST_ASSERT(memcmp(ble_phy_test_rx.pdu, pdu_ok, sizeof(pdu_ok)) == 0);
+
+    /* Events come no earlier than the on-air times of the frame, which is
+     * what the link layer sees as its start time.
+     */
+    TEST_ASSERT(ble_phy_test_rx.start_us >= frame.start_us +
+                ble_ll_pdu_syncword_us(BLE_PHY_MODE_1M));
+    TEST_ASSERT(ble_phy_test_rx.end_us >= frame.end_us);
+    beg_cputime = ble_phy_test_cputime(ref_cputime, ref_us, frame.start_us);
+    TEST_ASSERT(abs((int32_t)(ble_phy_test_rx.beg_cputime - beg_cputime)) <=
+                os_cputime_usecs_to_ticks(20) + 2);
+
+    /* The response goes out T_IFS after the end of the frame */
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.tx_ends == 1);
+    rc = phy_medium_read(phy_medium_head(), &rsp);
+    TEST_ASSERT_FATAL(rc == PHY_MEDIUM_OK);
+    TEST_ASSERT(rsp.node != BLE_PHY_TEST_PEER);
+    TEST_ASSERT(rsp.start_us == frame.end_us + BLE_LL_IFS);
+    TEST_ASSERT(memcmp(rsp.data, ble_phy_test_rsp,
+                       sizeof(ble_phy_test_rsp)) == 0);
+
+    /* Nothing whose access address comes after the wait for response */
+    ble_phy_test_rx.respond = 0;
+    start_us = phy_medium_now_us() + BLE_PHY_TEST_LEAD_US;
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        start_us + 3000, pdu_late, NULL);
+
+    ble_phy_test_rx_at(start_us);
+    ble_phy_wfr_enable(BLE_PHY_WFR_ENABLE_RX, BLE_PHY_MODE_1M, 1000);
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.wfr_exps == 1);
+    TEST_ASSERT(ble_phy_test_rx.starts == 1);
+    TEST_ASSERT(ble_phy_test_rx.wfr_us >= start_us + 1000);
+
+    ble_phy_test_done();
+}
+
+TEST_CASE_TASK(ble_phy_test_tx_rx)
+{
+    static const uint8_t pdu_tx[] = { 0x01, 0x00 };
+    static const uint8_t pdu_rsp[] = { 0x01, 0x01, 0x01 };
+    struct phy_medium_frame frame;
+    int rc;
+
+    ble_phy_test_init();
+
+    /* Response T_IFS after our frame is received */
+    ble_phy_test_tx_at(phy_medium_now_us() + BLE_PHY_TEST_LEAD_US, pdu_tx,
+                       BLE_PHY_TRANSITION_TX_RX, &frame);
+    TEST_ASSERT(frame.len == sizeof(pdu_tx));
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        frame.end_us + BLE_LL_IFS, pdu_rsp, NULL);
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.tx_ends == 1);
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.ends == 1);
+    TEST_ASSERT(ble_phy_test_rx.wfr_exps == 0);
+    TEST_ASSERT(memcmp(ble_phy_test_rx.pdu, pdu_rsp, sizeof(pdu_rsp)) == 0);
+
+    /* Responses that miss T_IFS by more than the allowed jitter */
+    ble_phy_test_tx_at(phy_medium_now_us() + BLE_PHY_TEST_LEAD_US, pdu_tx,
+                       BLE_PHY_TRANSITION_TX_RX, &frame);
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        frame.end_us + BLE_LL_IFS + 10, pdu_rsp, NULL);
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.tx_ends == 2);
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.wfr_exps == 1);
+    TEST_ASSERT(ble_phy_test_rx.ends == 1);
+
+    ble_phy_test_tx_at(phy_medium_now_us() + BLE_PHY_TEST_LEAD_US, pdu_tx,
+                       BLE_PHY_TRANSITION_TX_RX, &frame);
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        frame.end_us + BLE_LL_IFS - 50, pdu_rsp, NULL);
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.tx_ends == 3);
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.wfr_exps == 2);
+    TEST_ASSERT(ble_phy_test_rx.ends == 1);
+
+    ble_phy_test_done();
+}
+
+#if MYNEWT_VAL(BLE_PHY_NATIVE_COLLISIONS)
+TEST_CASE_TASK(ble_phy_test_collision)
+{
+    static const uint8_t pdu[] = { 0x02, 0x04, 0x01, 0x02, 0x03, 0x04 };
+    struct phy_medium_frame frame;
+    uint64_t start_us;
+    int rc;
+
+    ble_phy_test_init();
+
+    /* Overlapping frame on the same channel corrupts ours, whatever its
+     * access address.
+     */
+    start_us = phy_medium_now_us() + BLE_PHY_TEST_LEAD_US;
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        start_us, pdu, &frame);
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA + 1,
+                        BLE_PHY_MODE_1M, frame.end_us - 8, pdu, NULL);
+
+    ble_phy_test_rx_at(start_us - 1000);
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.ends == 1);
+    TEST_ASSERT(!(ble_phy_test_rx.flags & BLE_MBUF_HDR_F_CRC_OK));
+
+    /* Frames on other channels and frames that were cut off do not */
+    start_us = phy_medium_now_us() + BLE_PHY_TEST_LEAD_US;
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        start_us, pdu, &frame);
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN + 1, BLE_PHY_TEST_AA,
+                        BLE_PHY_MODE_1M, start_us, pdu, NULL);
+    phy_medium_abort(ble_phy_test_inject(BLE_PHY_TEST_CHAN,
+                                         BLE_PHY_TEST_AA + 1,
+                                         BLE_PHY_MODE_1M, start_us + 8, pdu,
+                                         NULL));
+
+    ble_phy_test_rx_at(start_us - 1000);
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.ends == 2);
+    TEST_ASSERT(!!(ble_phy_test_rx.flags & BLE_MBUF_HDR_F_CRC_OK) ==
+                BLE_PHY_TEST_CRC_OK);
+
+    ble_phy_test_done();
+}
+#endif
+
+TEST_CASE_TASK(ble_phy_test_loss)
+{
+    static const uint8_t pdu[] = { 0x02, 0x01, 0x01 };
+    uint64_t start_us;
+    int received;
+    int good;
+    int rc;
+    int i;
+
+    ble_phy_test_init();
+
+    good = 0;
+    received = 0;
+    for (i = 0; i < 32; i++) {
+        start_us = phy_medium_now_us() + BLE_PHY_TEST_LEAD_US;
+        ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA,
+                            BLE_PHY_MODE_1M, start_us, pdu, NULL);
+
+        ble_phy_test_rx_at(start_us - 1000);
+        rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+        TEST_ASSERT_FATAL(rc == 0);
+
+        /* A lost frame is still received, with a CRC error */
+        received++;
+        if (ble_phy_test_rx.flags & BLE_MBUF_HDR_F_CRC_OK) {
+            good++;
+        }
+    }
+
+    TEST_ASSERT(ble_phy_test_rx.ends == received);
+#if MYNEWT_VAL(BLE_PHY_NATIVE_LOSS_PERMILLE) == 0
+    TEST_ASSERT(good == received);
+#elif MYNEWT_VAL(BLE_PHY_NATIVE_LOSS_PERMILLE) == 1000
+    TEST_ASSERT(good == 0);
+#else
+    TEST_ASSERT((good > 0) && (good < received));
+#endif
+
+    ble_phy_test_done();
+}
+
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION)
+/*
+ * Sample data from Core Specification Vol 6, Part C, 1 "Encryption sample
+ * data": session key derived from LTK 0x4C68384139F574D836BCF34E9DFB01BF and
+ * SKD 0x0213243546576879ACBDCEDFE0F10213, IV 0xDEAFBABEBADCAB24, and the
+ * LL_START_ENC_RSP PDUs sent in either direction with packet counter 0.
+ */
+static const uint8_t ble_phy_test_sk[16] = {
+    0x99, 0xad, 0x1b, 0x52, 0x26, 0xa3, 0x7e, 0x3e,
+    0x05, 0x8e, 0x3b, 0x8e, 0x27, 0xc2, 0xc6, 0x66
+};
+static const uint8_t ble_phy_test_iv[8] = {
+    0x24, 0xab, 0xdc, 0xba, 0xbe, 0xba, 0xaf, 0xde
+};
+
+static void
+ble_phy_test_encrypt_init(uint8_t dir_bit)
+{
+    ble_phy_encrypt_enable(ble_phy_test_sk);
+    ble_phy_encrypt_iv_set(ble_phy_test_iv);
+    ble_phy_encrypt_counter_set(0, dir_bit);
+}
+
+TEST_CASE_TASK(ble_phy_test_encrypt)
+{
+    /* Central to peripheral */
+    static const uint8_t pdu[] = { 0x0f, 0x01, 0x06 };
+    static const uint8_t enc_pdu[] = {
+        0x0f, 0x05, 0x9f, 0xcd, 0xa7, 0xf4, 0x48
+    };
+    static const uint8_t empty_pdu[] = { 0x01, 0x00 };
+    struct phy_medium_frame frame;
+    int rc;
+
+    ble_phy_test_init();
+    ble_phy_test_encrypt_init(1);
+
+    ble_phy_test_tx_at(phy_medium_now_us() + BLE_PHY_TEST_LEAD_US, pdu,
+                       BLE_PHY_TRANSITION_NONE, &frame);
+    TEST_ASSERT(frame.len == sizeof(enc_pdu));
+    TEST_ASSERT(memcmp(frame.data, enc_pdu, sizeof(enc_pdu)) == 0);
+    TEST_ASSERT(frame.end_us - frame.start_us ==
+                ble_ll_pdu_us(enc_pdu[1], BLE_PHY_MODE_1M));
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* Empty PDUs go out without a MIC */
+    ble_phy_test_tx_at(phy_medium_now_us() + BLE_PHY_TEST_LEAD_US, empty_pdu,
+                       BLE_PHY_TRANSITION_NONE, &frame);
+    TEST_ASSERT(frame.len == sizeof(empty_pdu));
+    TEST_ASSERT(memcmp(frame.data, empty_pdu, sizeof(empty_pdu)) == 0);
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_phy_test_rx.tx_ends == 2);
+
+    ble_phy_test_done();
+}
+
+TEST_CASE_TASK(ble_phy_test_decrypt)
+{
+    /* Peripheral to central */
+    static const uint8_t enc_pdu[] = {
+        0x07, 0x05, 0xa3, 0x4c, 0x13, 0xa4, 0x15
+    };
+    static const uint8_t pdu[] = { 0x07, 0x01, 0x06 };
+    uint8_t bad_pdu[sizeof(enc_pdu)];
+    uint64_t start_us;
+    int rc;
+
+    ble_phy_test_init();
+    ble_phy_test_encrypt_init(0);
+
+    start_us = phy_medium_now_us() + BLE_PHY_TEST_LEAD_US;
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        start_us, enc_pdu, NULL);
+    ble_phy_test_rx_at(start_us - 1000);
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(!(ble_phy_test_rx.flags & BLE_MBUF_HDR_F_MIC_FAILURE));
+    if (BLE_PHY_TEST_CRC_OK) {
+        TEST_ASSERT(memcmp(ble_phy_test_rx.pdu, pdu, sizeof(pdu)) == 0);
+    } else {
+        /* Nothing is decrypted from a frame with a CRC error */
+        TEST_ASSERT(memcmp(ble_phy_test_rx.pdu, enc_pdu,
+                           sizeof(enc_pdu)) == 0);
+    }
+
+    /* Corrupted MIC */
+    memcpy(bad_pdu, enc_pdu, sizeof(bad_pdu));
+    bad_pdu[sizeof(bad_pdu) - 1] ^= 0x01;
+
+    start_us = phy_medium_now_us() + BLE_PHY_TEST_LEAD_US;
+    ble_phy_test_inject(BLE_PHY_TEST_CHAN, BLE_PHY_TEST_AA, BLE_PHY_MODE_1M,
+                        start_us, bad_pdu, NULL);
+    ble_phy_test_rx_at(start_us - 1000);
+
+    rc = ble_phy_test_wait(OS_TICKS_PER_SEC);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(!!(ble_phy_test_rx.flags & BLE_MBUF_HDR_F_MIC_FAILURE) ==
+                BLE_PHY_TEST_CRC_OK);
+
+    ble_phy_test_done();
+}
+#endif
+
+TEST_SUITE(ble_phy_test_suite)
+{
+    ble_phy_test_filter();
+    ble_phy_test_rx_window();
+    ble_phy_test_tx_rx();
+#if MYNEWT_VAL(BLE_PHY_NATIVE_COLLISIONS)
+    ble_phy_test_collision();
+#endif
+    ble_phy_test_loss();
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION)
+    ble_phy_test_encrypt();
+    ble_phy_test_decrypt();
+#endif
+}
+
+#endif
@@ -261,6 +261,12 @@ struct hci_conn_update;
 /** GAP event: BIG (Broadcast Isochronous Group) information report */
 #define BLE_GAP_EVENT_BIGINFO_REPORT        30
 
+/** GAP event: Advertising report matched by an advertisement monitor filter */
+#define BLE_GAP_EVENT_ADV_MON               31
+
+/** GAP event: Batch of advertising reports */
+#define BLE_GAP_EVENT_DISC_BATCH            32
+
 /** @} */
 
 /**
@@ -548,6 +554,57 @@ struct ble_gap_ext_disc_desc {
 };
 #endif
 
+/** @brief Advertising report matched by an advertisement monitor filter */
+struct ble_gap_adv_mon_desc {
+    /** Identifier of the matching filter, as returned by
+     *  ble_gap_adv_mon_add().
+     */
+    uint8_t filter_id;
+
+    /** Report properties bitmask, as in struct ble_gap_ext_disc_desc.  Only
+     *  BLE_HCI_ADV_LEGACY_MASK is set for reports received in legacy
+     *  advertising report events.
+     */
+    uint8_t props;
+
+    /** Legacy advertising PDU type.  Valid if BLE_HCI_ADV_LEGACY_MASK props
+     *  is set.
+     */
+    uint8_t legacy_event_type;
+
+    /** Whether the advertising data is incomplete, either because the
+     *  controller truncated it or because it did not fit in
+     *  BLE_EXT_ADV_MAX_SIZE bytes.
+     */
+    uint8_t truncated;
+
+    /** Advertiser address */
+    ble_addr_t addr;
+
+    /** Received signal strength indication in dBm (127 if unavailable) */
+    int8_t rssi;
+
+    /** Advertiser transmit power in dBm (127 if unavailable) */
+    int8_t tx_power;
+
+    /** Advertising Set ID (0xff if not present) */
+    uint8_t sid;
+
+    /** Primary advertising PHY */
+    uint8_t prim_phy;
+
+    /** Secondary advertising PHY (0 if not present) */
+    uint8_t sec_phy;
+
+    /** Advertising data length; all fragments of an extended advertising
+     *  report are reassembled.
+     */
+    uint16_t length_data;
+
+    /** Advertising data */
+    const uint8_t *data;
+};
+
 /** @brief Advertising report */
 struct ble_gap_disc_desc {
     /** Advertising PDU type. Can be one of following constants:
@@ -577,6 +634,38 @@ struct ble_gap_disc_desc {
     ble_addr_t direct_addr;
 };
 
+/** @brief Advertising report delivered as part of a batch */
+struct ble_gap_disc_batch_report {
+    /** The report.  If reports were merged, the data and RSSI are those of
+     *  the most recent one.
+     */
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    struct ble_gap_ext_disc_desc desc;
+#else
+    struct ble_gap_disc_desc desc;
+#endif
+
+    /** Number of reports merged into this one; 1 unless deduplicating */
+    uint16_t count;
+
+    /** Lowest RSSI of the merged reports in dBm (127 if unavailable) */
+    int8_t rssi_min;
+
+    /** Highest RSSI of the merged reports in dBm (127 if unavailable) */
+    int8_t rssi_max;
+};
+
+/** @brief Batch of advertising reports */
+struct ble_gap_disc_batch_desc {
+    /** Number of reports in the batch */
+    uint16_t num_reports;
+
+    /** The reports, in the order they were first received.  Only valid
+     *  until the callback returns.
+     */
+    const struct ble_gap_disc_batch_report *reports;
+};
+
 /**
  * Represents a repeat pairing operation between two devices.
  *
@@ -1197,6 +1286,25 @@ struct ble_gap_event {
         } biginfo_report;
 #endif
 
+#if MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS)
+        /**
+         * Represents an advertising report, with its data reassembled, which
+         * matched an advertisement monitor filter.  Valid for the following
+         * event types:
+         *     o BLE_GAP_EVENT_ADV_MON
+         */
+        struct ble_gap_adv_mon_desc adv_mon;
+#endif
+
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS)
+        /**
+         * Represents a batch of advertising reports received during a
+         * discovery procedure.  Valid for the following event types:
+         *     o BLE_GAP_EVENT_DISC_BATCH
+         */
+        struct ble_gap_disc_batch_desc disc_batch;
+#endif
+
 #if MYNEWT_VAL(BLE_POWER_CONTROL)
         /**
          * Represents a change in either local transmit power or remote transmit
@@ -2093,6 +2201,210 @@ int ble_gap_disc_cancel(void);
  */
 int ble_gap_disc_active(void);
 
+/** @brief Batched discovery parameters */
+struct ble_gap_disc_batch_params {
+    /** Deliver the batch once this many reports are buffered.  0, or values
+     *  above BLE_GAP_DISC_BATCH_REPORTS, use BLE_GAP_DISC_BATCH_REPORTS.
+     */
+    uint16_t max_reports;
+
+    /** Deliver buffered reports at least this often, in milliseconds.  0
+     *  delivers only when the batch is full or the procedure completes.
+     */
+    uint16_t flush_itvl_ms;
+
+    /** Merge repeated reports of the same type from the same advertiser
+     *  (and SID) into a single report, aggregating their RSSI.
+     */
+    uint8_t dedup:1;
+};
+
+/**
+ * Configures batched delivery of advertising reports.
+ *
+ * With batching enabled, advertising reports received during a discovery
+ * procedure are buffered in the host and delivered to the discovery callback
+ * and the GAP event listeners as a single BLE_GAP_EVENT_DISC_BATCH event per
+ * batch instead of one BLE_GAP_EVENT_DISC or BLE_GAP_EVENT_EXT_DISC event
+ * per report.  Buffered reports are delivered when the batch is full, when
+ * the flush interval elapses, when ble_gap_disc_batch_flush() is called and
+ * before BLE_GAP_EVENT_DISC_COMPLETE is reported.  Reports still buffered
+ * when the procedure is cancelled are discarded.
+ *
+ * Fragments of extended advertising reports are delivered as received and
+ * never merged.  Advertisement monitor filters, if registered, take
+ * precedence over batching.
+ *
+ * @param params                The batching parameters; NULL disables
+ *                                  batching.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EBUSY if a discovery procedure is in
+ *                                  progress;
+ *                              BLE_HS_ENOTSUP if batching is disabled.
+ */
+int ble_gap_disc_batch_set(const struct ble_gap_disc_batch_params *params);
+
+/**
+ * Delivers the advertising reports buffered so far, if any.  Must be called
+ * from the host task, e.g. from a GAP event callback.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTSUP if batching is disabled.
+ */
+int ble_gap_disc_batch_flush(void);
+
+/**
+ * @defgroup ble_gap_adv_mon_criteria Advertisement Monitor Filter Criteria
+ * @{
+ */
+
+/** Advertiser address equals ble_gap_adv_mon_filter::addr */
+#define BLE_GAP_ADV_MON_F_ADDR              0x01
+
+/** RSSI is at least ble_gap_adv_mon_filter::rssi_min */
+#define BLE_GAP_ADV_MON_F_RSSI              0x02
+
+/** Data contains an AD structure of type ble_gap_adv_mon_filter::ad_type */
+#define BLE_GAP_ADV_MON_F_AD_TYPE           0x04
+
+/**
+ * Data lists ble_gap_adv_mon_filter::uuid as a service UUID or carries
+ * service data for it
+ */
+#define BLE_GAP_ADV_MON_F_UUID              0x08
+
+/**
+ * Manufacturer specific data starts with ble_gap_adv_mon_filter::company_id
+ * followed by ble_gap_adv_mon_filter::mfg_prefix
+ */
+#define BLE_GAP_ADV_MON_F_MFG               0x10
+
+/** @} */
+
+/** Maximum length of the manufacturer specific data prefix of a filter. */
+#define BLE_GAP_ADV_MON_MFG_PREFIX_MAX      16
+
+/** @brief Advertisement monitor filter */
+struct ble_gap_adv_mon_filter {
+    /** Criteria to apply, BLE_GAP_ADV_MON_F_* bitmask.  A report matches
+     *  if it satisfies all of them; a filter with no criteria matches every
+     *  report.
+     */
+    uint8_t criteria;
+
+    /** Advertiser address */
+    ble_addr_t addr;
+
+    /** Minimum RSSI in dBm */
+    int8_t rssi_min;
+
+    /** AD type */
+    uint8_t ad_type;
+
+    /** Service UUID */
+    ble_uuid_any_t uuid;
+
+    /** Company identifier */
+    uint16_t company_id;
+
+    /** Length of the manufacturer specific data prefix, following the
+     *  company identifier; may be 0.
+     */
+    uint8_t mfg_prefix_len;
+
+    /** Manufacturer specific data prefix */
+    uint8_t mfg_prefix[BLE_GAP_ADV_MON_MFG_PREFIX_MAX];
+};
+
+/** Advertisement monitor statistics. */
+struct ble_gap_adv_mon_stats {
+    /** Reports and report fragments received while filters were active. */
+    uint32_t rx_reports;
+
+    /** Complete reports evaluated against the filters. */
+    uint32_t evaluated;
+
+    /** Reports which matched at least one filter. */
+    uint32_t matched;
+
+    /** Reassemblies cut short because they exceeded BLE_EXT_ADV_MAX_SIZE. */
+    uint32_t truncated;
+
+    /**
+     * Partial reassemblies dropped to make room for another advertiser.  The
+     * remaining fragments of such a report are dropped as well.
+     */
+    uint32_t evicted;
+};
+
+/**
+ * Adds an advertisement monitor filter.
+ *
+ * While at least one filter is registered, advertising reports received
+ * during a discovery procedure are no longer reported with
+ * BLE_GAP_EVENT_DISC or BLE_GAP_EVENT_EXT_DISC events.  Instead, fragments
+ * of extended advertising reports are reassembled per advertiser address and
+ * SID, each complete report is evaluated against all filters and a
+ * BLE_GAP_EVENT_ADV_MON event is reported to the callback of every filter it
+ * matches.  Reports matching no filter are dropped without being parsed any
+ * further.
+ *
+ * @param filter                The criteria the filter applies.
+ * @param cb                    The callback to report matching reports to.
+ * @param cb_arg                The optional argument to pass to the callback
+ *                                  function.
+ * @param out_filter_id         On success, the identifier of the new filter
+ *                                  is written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if the filter or callback is
+ *                                  invalid;
+ *                              BLE_HS_ENOMEM if BLE_GAP_ADV_MON_FILTERS
+ *                                  filters are registered already;
+ *                              BLE_HS_ENOTSUP if the monitor is disabled.
+ */
+int ble_gap_adv_mon_add(const struct ble_gap_adv_mon_filter *filter,
+                        ble_gap_event_fn *cb, void *cb_arg,
+                        uint8_t *out_filter_id);
+
+/**
+ * Removes an advertisement monitor filter.
+ *
+ * @param filter_id             The identifier of the filter to remove.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there is no such filter;
+ *                              BLE_HS_ENOTSUP if the monitor is disabled.
+ */
+int ble_gap_adv_mon_remove(uint8_t filter_id);
+
+/**
+ * Retrieves the number of reports an advertisement monitor filter matched
+ * since it was added.
+ *
+ * @param filter_id             The identifier of the filter to query.
+ * @param out_hits              On success, the number of hits is written
+ *                                  here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there is no such filter;
+ *                              BLE_HS_ENOTSUP if the monitor is disabled.
+ */
+int ble_gap_adv_mon_hits(uint8_t filter_id, uint32_t *out_hits);
+
+/**
+ * Retrieves advertisement monitor statistics.
+ *
+ * @param out_stats             On success, the statistics are written here.
+ * @param reset                 Whether to clear the statistics after reading
+ *                                  them.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTSUP if the monitor is disabled.
+ */
+int ble_gap_adv_mon_stats(struct ble_gap_adv_mon_stats *out_stats, int reset);
+
 /**
  * Initiates a connect procedure.
  *
@@ -2386,6 +2698,56 @@ int ble_gap_encryption_initiate(uint16_t conn_handle, uint8_t key_size,
  */
 int ble_gap_conn_rssi(uint16_t conn_handle, int8_t *out_rssi);
 
+/** Host transmit queue statistics of a connection. */
+struct ble_gap_conn_tx_stats {
+    /** Number of packets waiting in the host for controller buffers. */
+    uint16_t queued_pkts;
+
+    /** Highest value queued_pkts has reached. */
+    uint16_t queued_pkts_max;
+
+    /**
+     * Time, in milliseconds, the packet at the head of the queue has been
+     * waiting there.  0 if nothing is queued.
+     */
+    uint32_t hol_ms;
+
+    /** Longest time, in milliseconds, a packet has waited at the head. */
+    uint32_t hol_max_ms;
+};
+
+/**
+ * Sets the share of controller ACL buffers a connection receives while
+ * several connections have data queued in the host.  Each connection gets
+ * buffers in proportion to its weight; the default weight is 1.
+ *
+ * @param conn_handle           The connection to configure.
+ * @param weight                Relative weight, 1 to 255.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTCONN if there is no connection
+ *                                  with the specified handle;
+ *                              BLE_HS_EINVAL if weight is 0;
+ *                              BLE_HS_ENOTSUP if BLE_HS_TX_SCHED_DRR is
+ *                                  disabled.
+ */
+int ble_gap_set_tx_weight(uint16_t conn_handle, uint8_t weight);
+
+/**
+ * Retrieves host transmit queue statistics of a connection.
+ *
+ * @param conn_handle           The connection to query.
+ * @param out_stats             On success, the statistics are written here.
+ * @param reset                 Whether to restart the maximum values
+ *                                  after reading them.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTCONN if there is no connection
+ *                                  with the specified handle.
+ */
+int ble_gap_conn_tx_stats(uint16_t conn_handle,
+                          struct ble_gap_conn_tx_stats *out_stats, int reset);
+
 /**
  * Unpairs a device with the specified address. The keys related to that peer
  * device are removed from storage and peer address is removed from the resolve
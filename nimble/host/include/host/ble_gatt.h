@@ -1057,10 +1057,60 @@ int ble_gatts_count_cfg(const struct ble_gatt_svc_def *defs);
  * Send notification (or indication) to any connected devices that have
  * subscribed for notification (or indication) for specified characteristic.
  *
+ * The value is read through the access callback with BLE_HS_CONN_HANDLE_NONE
+ * as connection handle.  With BLE_GATTS_NOTIFY_FANOUT enabled it is read once
+ * per update instead of once per subscribed peer, so every peer gets the same
+ * value.  Values that depend on the peer have to be sent with
+ * ble_gatts_notify_custom() or ble_gatts_indicate_custom().
+ *
  * @param chr_val_handle        Characteristic value handle
  */
 void ble_gatts_chr_updated(uint16_t chr_val_handle);
 
+/** Notification fan-out counters of a single characteristic. */
+struct ble_gatts_fanout_stats {
+    /** Number of value updates fully delivered to all subscribers. */
+    uint32_t updates;
+
+    /** Number of notifications and indications sent. */
+    uint32_t sends;
+
+    /**
+     * Number of times a fan-out was paused because the controller ran out
+     * of ACL buffers.
+     */
+    uint32_t deferrals;
+
+    /**
+     * Number of sends that got their own copy of the value instead of
+     * sharing it, because it does not fit in a single ACL buffer or because
+     * BLE_GATTS_NOTIFY_FANOUT_REFS ran out.
+     */
+    uint32_t copies;
+
+    /**
+     * Time from ble_gatts_chr_updated() until the last subscriber was
+     * served, in milliseconds.
+     */
+    uint32_t latency_total_ms;
+    uint32_t latency_max_ms;
+};
+
+/**
+ * Retrieves the notification fan-out counters of a characteristic.
+ * Requires BLE_GATTS_NOTIFY_FANOUT.
+ *
+ * @param chr_val_handle        Characteristic value handle
+ * @param out_stats             On success, the counters get written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if the characteristic does not
+ *                                  support notifications or indications;
+ *                              BLE_HS_ENOTSUP if fan-out is disabled.
+ */
+int ble_gatts_fanout_stats(uint16_t chr_val_handle,
+                           struct ble_gatts_fanout_stats *out_stats);
+
 /**
  * Retrieves the attribute handle associated with a local GATT service.
  *
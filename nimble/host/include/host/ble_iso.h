@@ -53,6 +53,9 @@
 /** ISO event: ISO Data received */
 #define BLE_ISO_EVENT_ISO_RX                                4
 
+/** ISO event: ISO Data transmitted */
+#define BLE_ISO_EVENT_ISO_TX_COMPLETE                       5
+
 /** @} */
 
 /** @brief Broadcast Isochronous Group (BIG) description */
@@ -142,6 +145,18 @@ struct ble_iso_rx_data_info {
     uint16_t ts_valid : 1;
 };
 
+/** @brief ISO data info structure for @ref ble_iso_tx_mbuf */
+struct ble_iso_tx_data_info {
+    /** SDU timestamp. Used if @ref ble_iso_tx_data_info.ts_valid is set */
+    uint32_t ts;
+
+    /** Packet sequence number */
+    uint16_t seq_num;
+
+    /** Timestamp is valid */
+    uint8_t ts_valid : 1;
+};
+
 /**
  * Represents a ISO-related event.  When such an event occurs, the host
  * notifies the application by passing an instance of this structure to an
@@ -201,6 +216,25 @@ struct ble_iso_event {
             const struct ble_iso_rx_data_info *info;
             struct os_mbuf *om;
         } iso_rx;
+
+        /**
+         * Represents a transmission of ISO Data. Reported when the Controller
+         * completes (transmits or flushes) HCI ISO Data packets and frees
+         * their buffers. Valid for the following event types:
+         *     o BLE_ISO_EVENT_ISO_TX_COMPLETE
+         */
+        struct {
+            uint16_t conn_handle;
+
+            /** Number of completed HCI ISO Data packets */
+            uint16_t num_pkts;
+
+            /**
+             * Number of HCI ISO Data packets of this BIS either queued in
+             * the host or not completed by the Controller yet
+             */
+            uint16_t pending_pkts;
+        } iso_tx_complete;
     };
 };
 
@@ -483,7 +517,8 @@ struct ble_iso_data_path_remove_params {
 int ble_iso_data_path_remove(const struct ble_iso_data_path_remove_params *param);
 
 /**
- * Initiates the transmission of isochronous data.
+ * Initiates the transmission of isochronous data. The data is copied into an
+ * mbuf and sent as with @ref ble_iso_tx_mbuf.
  *
  * @param conn_handle           The connection over which to execute the procedure.
  * @param data                  A pointer to the data to be transmitted.
@@ -494,6 +529,32 @@ int ble_iso_data_path_remove(const struct ble_iso_data_path_remove_params *param
  */
 int ble_iso_tx(uint16_t conn_handle, void *data, uint16_t data_len);
 
+/**
+ * Initiates the transmission of an isochronous SDU held in an mbuf chain.
+ *
+ * The SDU is split into HCI ISO Data packets that reference the mbufs of
+ * @p om; only the bytes of an mbuf crossing a packet boundary are copied.
+ * Allocating the SDU with @ref ble_hs_mbuf_iso_pkt leaves room for the
+ * packet headers in front of the data. Packets are held in the host while
+ * the Controller has no free ISO Data buffers and sent as
+ * BLE_ISO_EVENT_ISO_TX_COMPLETE events report completed packets.
+ *
+ * @param conn_handle           The BIS over which to transmit the SDU.
+ * @param om                    The SDU to transmit. Consumed in all cases.
+ * @param info                  Timestamp and sequence number of the SDU;
+ *                                  NULL to send without a timestamp and
+ *                                  with the sequence number following the
+ *                                  previously sent SDU.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTCONN if there is no such BIS;
+ *                              BLE_HS_EINVAL if the SDU is too long;
+ *                              BLE_HS_ENOMEM on mbuf exhaustion;
+ *                              other nonzero on transport error.
+ */
+int ble_iso_tx_mbuf(uint16_t conn_handle, struct os_mbuf *om,
+                    const struct ble_iso_tx_data_info *info);
+
 /**
  * Initializes memory for ISO.
  *
@@ -496,6 +496,15 @@ struct ble_l2cap_chan_info {
 
     /** Peer CoC Maximum Transmission Unit. */
     uint16_t peer_coc_mtu;
+
+    /** Receive credit window currently granted to the peer. */
+    uint16_t rx_credit_window;
+
+    /** Time (ms) spent with data to send but no credits from the peer. */
+    uint32_t tx_stall_ms;
+
+    /** Time (ms) the peer spent without credits from us. */
+    uint32_t rx_stall_ms;
 };
 
 /**
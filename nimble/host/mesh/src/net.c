@@ -76,11 +76,20 @@ struct iv_val {
 	iv_duration:7;
 } __packed;
 
+/* The network message cache and the duplicate cache are set-associative:
+ * an entry can only be stored in one set of MSG_CACHE_WAYS slots selected by
+ * its hash, so a lookup costs the same regardless of the cache size. Each
+ * set replaces its entries in FIFO order.
+ */
+#define MSG_CACHE_WAYS MIN(4, MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE))
+#define MSG_CACHE_SETS ((MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE) + \
+			 MSG_CACHE_WAYS - 1) / MSG_CACHE_WAYS)
+
 static struct {
 	uint32_t src : 15, /* MSb of source is always 0 */
 	      seq : 17;
-} msg_cache[MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE)];
-static uint16_t msg_cache_next;
+} msg_cache[MSG_CACHE_SETS * MSG_CACHE_WAYS];
+static uint8_t msg_cache_next[MSG_CACHE_SETS];
 
 /* Singleton network context (the implementation only supports one) */
 struct bt_mesh_net bt_mesh = {
@@ -102,36 +111,50 @@ os_membuf_t loopback_mbuf_membuf[
 		OS_MEMPOOL_SIZE(LOOPBACK_MAX_PDU_LEN + BT_MESH_MBUF_HEADER_SIZE,
         MYNEWT_VAL(BLE_MESH_LOOPBACK_BUFS))];
 
-static uint32_t dup_cache[MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE)];
-static int   dup_cache_next;
+static uint32_t dup_cache[MSG_CACHE_SETS * MSG_CACHE_WAYS];
+static uint8_t dup_cache_next[MSG_CACHE_SETS];
 
 static bool check_dup(struct os_mbuf *data)
 {
 	const uint8_t *tail = net_buf_simple_tail(data);
 	uint32_t val;
+	uint16_t set;
 	int i;
 
+	/* Taken from the encrypted PDU, so already evenly distributed */
 	val = sys_get_be32(tail - 4) ^ sys_get_be32(tail - 8);
+	set = val % MSG_CACHE_SETS;
 
-	for (i = 0; i < ARRAY_SIZE(dup_cache); i++) {
-		if (dup_cache[i] == val) {
+	for (i = 0; i < MSG_CACHE_WAYS; i++) {
+		if (dup_cache[set * MSG_CACHE_WAYS + i] == val) {
 			return true;
 		}
 	}
 
-	dup_cache[dup_cache_next++] = val;
-	dup_cache_next %= ARRAY_SIZE(dup_cache);
+	dup_cache[set * MSG_CACHE_WAYS + dup_cache_next[set]++] = val;
+	dup_cache_next[set] %= MSG_CACHE_WAYS;
 
 	return false;
 }
 
-static bool msg_cache_match(struct os_mbuf *pdu)
+static uint16_t msg_cache_set(uint16_t src, uint32_t seq)
+{
+	uint32_t key = ((uint32_t)src << 17) | (seq & BIT_MASK(17));
+
+	/* Fibonacci hashing, spreads sequential sources and sequence numbers
+	 * over all sets.
+	 */
+	return ((key * 2654435761U) >> 16) % MSG_CACHE_SETS;
+}
+
+bool bt_mesh_msg_cache_match(uint16_t src, uint32_t seq)
 {
+	uint16_t set = msg_cache_set(src, seq);
 	uint16_t i;
 
-	for (i = 0; i < ARRAY_SIZE(msg_cache); i++) {
-		if (msg_cache[i].src == SRC(pdu->om_data) &&
-		    msg_cache[i].seq == (SEQ(pdu->om_data) & BIT_MASK(17))) {
+	for (i = set * MSG_CACHE_WAYS; i < (set + 1) * MSG_CACHE_WAYS; i++) {
+		if (msg_cache[i].src == src &&
+		    msg_cache[i].seq == (seq & BIT_MASK(17))) {
 			return true;
 		}
 	}
@@ -139,13 +162,35 @@ static bool msg_cache_match(struct os_mbuf *pdu)
 	return false;
 }
 
+uint16_t bt_mesh_msg_cache_add(uint16_t src, uint32_t seq)
+{
+	uint16_t set = msg_cache_set(src, seq);
+	uint16_t idx;
+
+	idx = set * MSG_CACHE_WAYS + msg_cache_next[set]++;
+	msg_cache[idx].src = src;
+	msg_cache[idx].seq = seq;
+	msg_cache_next[set] %= MSG_CACHE_WAYS;
+
+	return idx;
+}
+
+void bt_mesh_msg_cache_remove(uint16_t idx)
+{
+	msg_cache[idx].src = BT_MESH_ADDR_UNASSIGNED;
+	/* Rewind the set so that the entry is reused next */
+	msg_cache_next[idx / MSG_CACHE_WAYS] = idx % MSG_CACHE_WAYS;
+}
+
+static bool msg_cache_match(struct os_mbuf *pdu)
+{
+	return bt_mesh_msg_cache_match(SRC(pdu->om_data), SEQ(pdu->om_data));
+}
+
 static void msg_cache_add(struct bt_mesh_net_rx *rx)
 {
 	/* Add to the cache */
-	rx->msg_cache_idx = msg_cache_next++;
-	msg_cache[rx->msg_cache_idx].src = rx->ctx.addr;
-	msg_cache[rx->msg_cache_idx].seq = rx->seq;
-	msg_cache_next %= ARRAY_SIZE(msg_cache);
+	rx->msg_cache_idx = bt_mesh_msg_cache_add(rx->ctx.addr, rx->seq);
 }
 
 static void store_iv(bool only_duration)
@@ -193,7 +238,7 @@ int bt_mesh_net_create(uint16_t idx, uint8_t flags, const uint8_t key[16],
 	}
 
 	(void)memset(msg_cache, 0, sizeof(msg_cache));
-	msg_cache_next = 0U;
+	(void)memset(msg_cache_next, 0, sizeof(msg_cache_next));
 
 	bt_mesh.iv_index = iv_index;
 	atomic_set_bit_to(bt_mesh.flags, BT_MESH_IVU_IN_PROGRESS,
@@ -855,9 +900,7 @@ void bt_mesh_net_recv(struct os_mbuf *data, int8_t rssi,
 	 */
 	if (bt_mesh_trans_recv(buf, &rx) == -EAGAIN) {
 		BT_WARN("Removing rejected message from Network Message Cache");
-		msg_cache[rx.msg_cache_idx].src = BT_MESH_ADDR_UNASSIGNED;
-		/* Rewind the next index now that we're not using this entry */
-		msg_cache_next = rx.msg_cache_idx;
+		bt_mesh_msg_cache_remove(rx.msg_cache_idx);
 	}
 
 	/* Relay if this was a group/virtual address, or if the destination
@@ -309,6 +309,10 @@ void bt_mesh_net_pending_seq_store(void);
 void bt_mesh_net_clear(void);
 void bt_mesh_net_settings_commit(void);
 
+bool bt_mesh_msg_cache_match(uint16_t src, uint32_t seq);
+uint16_t bt_mesh_msg_cache_add(uint16_t src, uint32_t seq);
+void bt_mesh_msg_cache_remove(uint16_t idx);
+
 static inline void send_cb_finalize(const struct bt_mesh_send_cb *cb,
 				    void *cb_data)
 {
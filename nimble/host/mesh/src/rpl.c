@@ -24,24 +24,137 @@ struct rpl_val {
 	old_iv:1;
 };
 
-static struct bt_mesh_rpl replay_list[MYNEWT_VAL(BLE_MESH_CRPL)];
-static ATOMIC_DEFINE(store, MYNEWT_VAL(BLE_MESH_CRPL));
+/* The RPL is an open addressed hash table with linear probing, holding up
+ * to BLE_MESH_CRPL entries. Entries are removed by shifting the rest of
+ * their probe sequence back, so a lookup ends at the first free slot, and no
+ * entry is ever more than max_probe slots away from its home slot.
+ *
+ * The table has the smallest power of two of slots that is at least twice
+ * BLE_MESH_CRPL, so it is never more than half full and probe sequences
+ * stay short.
+ */
+#define RPL_POW2_1(n) ((n) | ((n) >> 1))
+#define RPL_POW2_2(n) (RPL_POW2_1(n) | (RPL_POW2_1(n) >> 2))
+#define RPL_POW2_4(n) (RPL_POW2_2(n) | (RPL_POW2_2(n) >> 4))
+#define RPL_POW2_8(n) (RPL_POW2_4(n) | (RPL_POW2_4(n) >> 8))
+#define RPL_SLOTS     (RPL_POW2_8(2 * MYNEWT_VAL(BLE_MESH_CRPL) - 1) + 1)
+#define RPL_MASK      (RPL_SLOTS - 1)
+
+static struct bt_mesh_rpl replay_list[RPL_SLOTS];
+static ATOMIC_DEFINE(store, RPL_SLOTS);
+static uint16_t rpl_cnt;
+static uint16_t max_probe;
 
 static inline int rpl_idx(const struct bt_mesh_rpl *rpl)
 {
 	return rpl - &replay_list[0];
 }
 
+static inline uint16_t rpl_home(uint16_t src)
+{
+	/* Fibonacci hashing, spreads sequential unicast addresses */
+	return ((uint32_t)(src * 2654435761U) >> 16) & RPL_MASK;
+}
+
+/* Finds the entry for the given source address, or if there is none the
+ * free slot it is to be stored in. Returns NULL only if the address has no
+ * entry and the list already holds BLE_MESH_CRPL entries.
+ */
+static struct bt_mesh_rpl *rpl_lookup(uint16_t src)
+{
+	struct bt_mesh_rpl *rpl;
+	uint16_t i;
+	uint16_t n;
+
+	i = rpl_home(src);
+
+	for (n = 0; n <= max_probe; n++) {
+		rpl = &replay_list[i];
+
+		if (rpl->src == src) {
+			return rpl;
+		}
+
+		if (!rpl->src) {
+			break;
+		}
+
+		i = (i + 1) & RPL_MASK;
+	}
+
+	if (rpl_cnt >= MYNEWT_VAL(BLE_MESH_CRPL)) {
+		return NULL;
+	}
+
+	/* Not stored; the new entry goes further away than any other */
+	while (replay_list[i].src) {
+		i = (i + 1) & RPL_MASK;
+	}
+
+	return &replay_list[i];
+}
+
+/* Stores src in a free slot returned by rpl_lookup() */
+static void rpl_insert(struct bt_mesh_rpl *rpl, uint16_t src)
+{
+	uint16_t dist;
+
+	dist = (rpl_idx(rpl) - rpl_home(src)) & RPL_MASK;
+	if (dist > max_probe) {
+		max_probe = dist;
+	}
+
+	rpl->src = src;
+	rpl_cnt++;
+}
+
+static void rpl_remove(struct bt_mesh_rpl *rpl)
+{
+	uint16_t i;
+	uint16_t j;
+	uint16_t home;
+
+	i = rpl_idx(rpl);
+	(void)memset(rpl, 0, sizeof(*rpl));
+	atomic_clear_bit(store, i);
+
+	/* Move later entries of the probe sequence into the free slot, unless
+	 * that would put them before their home slot.
+	 */
+	for (j = (i + 1) & RPL_MASK; replay_list[j].src;
+	     j = (j + 1) & RPL_MASK) {
+		home = rpl_home(replay_list[j].src);
+		if (i <= j ? (i < home && home <= j) :
+			     (i < home || home <= j)) {
+			continue;
+		}
+
+		replay_list[i] = replay_list[j];
+		(void)memset(&replay_list[j], 0, sizeof(replay_list[j]));
+		if (atomic_test_and_clear_bit(store, j)) {
+			atomic_set_bit(store, i);
+		}
+
+		i = j;
+	}
+
+	if (!--rpl_cnt) {
+		max_probe = 0;
+	}
+}
+
 static void clear_rpl(struct bt_mesh_rpl *rpl)
 {
 #if MYNEWT_VAL(BLE_MESH_SETTINGS)
 	int err;
 	char path[18];
+#endif
 
 	if (!rpl->src) {
 		return;
 	}
 
+#if MYNEWT_VAL(BLE_MESH_SETTINGS)
 	snprintk(path, sizeof(path), "bt_mesh/RPL/%x", rpl->src);
 	err = settings_save_one(path, NULL);
 	if (err) {
@@ -49,10 +162,9 @@ static void clear_rpl(struct bt_mesh_rpl *rpl)
 	} else {
 		BT_DBG("Cleared RPL");
 	}
-
-	(void)memset(rpl, 0, sizeof(*rpl));
-	atomic_clear_bit(store, rpl_idx(rpl));
 #endif
+
+	rpl_remove(rpl);
 }
 
 static void schedule_rpl_store(struct bt_mesh_rpl *entry, bool force)
@@ -87,7 +199,10 @@ void bt_mesh_rpl_update(struct bt_mesh_rpl *rpl,
 		rpl->seg = 0;
 	}
 
-	rpl->src = rx->ctx.addr;
+	if (!rpl->src) {
+		rpl_insert(rpl, rx->ctx.addr);
+	}
+
 	rpl->seq = rx->seq;
 	rpl->old_iv = rx->old_iv;
 
@@ -104,7 +219,7 @@ void bt_mesh_rpl_update(struct bt_mesh_rpl *rpl,
 bool bt_mesh_rpl_check(struct bt_mesh_net_rx *rx,
 		struct bt_mesh_rpl **match)
 {
-	int i;
+	struct bt_mesh_rpl *rpl;
 
 	/* Don't bother checking messages from ourselves */
 	if (rx->net_if == BT_MESH_NET_IF_LOCAL) {
@@ -116,43 +231,30 @@ bool bt_mesh_rpl_check(struct bt_mesh_net_rx *rx,
 		return false;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
-		struct bt_mesh_rpl *rpl = &replay_list[i];
-
-		/* Empty slot */
-		if (!rpl->src) {
-			if (match) {
-				*match = rpl;
-			} else {
-				bt_mesh_rpl_update(rpl, rx);
-			}
+	rpl = rpl_lookup(rx->ctx.addr);
+	if (!rpl) {
+		BT_ERR("RPL is full!");
+		return true;
+	}
 
-			return false;
+	/* Existing slot for given address */
+	if (rpl->src) {
+		if (rx->old_iv && !rpl->old_iv) {
+			return true;
 		}
 
-		/* Existing slot for given address */
-		if (rpl->src == rx->ctx.addr) {
-			if (rx->old_iv && !rpl->old_iv) {
-				return true;
-			}
-
-			if ((!rx->old_iv && rpl->old_iv) ||
-			    rpl->seq < rx->seq) {
-				if (match) {
-					*match = rpl;
-				} else {
-					bt_mesh_rpl_update(rpl, rx);
-				}
-
-				return false;
-			} else {
-				return true;
-			}
+		if ((rx->old_iv || !rpl->old_iv) && rpl->seq >= rx->seq) {
+			return true;
 		}
 	}
 
-	BT_ERR("RPL is full!");
-	return true;
+	if (match) {
+		*match = rpl;
+	} else {
+		bt_mesh_rpl_update(rpl, rx);
+	}
+
+	return false;
 }
 
 void bt_mesh_rpl_clear(void)
@@ -163,18 +265,18 @@ void bt_mesh_rpl_clear(void)
 		schedule_rpl_clear();
 	} else {
 		(void)memset(replay_list, 0, sizeof(replay_list));
+		rpl_cnt = 0;
+		max_probe = 0;
 	}
 }
 
 #if MYNEWT_VAL(BLE_MESH_SETTINGS)
 static struct bt_mesh_rpl *bt_mesh_rpl_find(uint16_t src)
 {
-	int i;
+	struct bt_mesh_rpl *rpl = rpl_lookup(src);
 
-	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
-		if (replay_list[i].src == src) {
-			return &replay_list[i];
-		}
+	if (rpl && rpl->src == src) {
+		return rpl;
 	}
 
 	return NULL;
@@ -182,13 +284,11 @@ static struct bt_mesh_rpl *bt_mesh_rpl_find(uint16_t src)
 
 static struct bt_mesh_rpl *bt_mesh_rpl_alloc(uint16_t src)
 {
-	int i;
+	struct bt_mesh_rpl *rpl = rpl_lookup(src);
 
-	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
-		if (!replay_list[i].src) {
-			replay_list[i].src = src;
-			return &replay_list[i];
-		}
+	if (rpl && !rpl->src) {
+		rpl_insert(rpl, src);
+		return rpl;
 	}
 
 	return NULL;
@@ -199,24 +299,31 @@ void bt_mesh_rpl_reset(void)
 {
 	int i;
 
-	/* Discard "old old" IV Index entries from RPL and flag
-	 * any other ones (which are valid) as old.
+	/* Discard "old old" IV Index entries from RPL. Removing an entry
+	 * may move another one into its slot, so the slot is checked again.
 	 */
+	for (i = 0; i < ARRAY_SIZE(replay_list); ) {
+		struct bt_mesh_rpl *rpl = &replay_list[i];
+
+		if (rpl->src && rpl->old_iv) {
+			if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
+				clear_rpl(rpl);
+			} else {
+				rpl_remove(rpl);
+			}
+		} else {
+			i++;
+		}
+	}
+
+	/* Flag any other ones (which are valid) as old */
 	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
 		struct bt_mesh_rpl *rpl = &replay_list[i];
 
 		if (rpl->src) {
-			if (rpl->old_iv) {
-				if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
-					clear_rpl(rpl);
-				} else {
-					(void)memset(rpl, 0, sizeof(*rpl));
-				}
-			} else {
-				rpl->old_iv = true;
-				if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
-					schedule_rpl_store(rpl, true);
-				}
+			rpl->old_iv = true;
+			if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
+				schedule_rpl_store(rpl, true);
 			}
 		}
 	}
@@ -242,7 +349,7 @@ static int rpl_set(int argc, char **argv, char *val)
 
 	if (!val) {
 		if (entry) {
-			memset(entry, 0, sizeof(*entry));
+			rpl_remove(entry);
 		} else {
 			BT_WARN("Unable to find RPL entry for 0x%04x", src);
 		}
@@ -327,6 +434,7 @@ static void store_pending_rpl(struct bt_mesh_rpl *rpl)
 
 void bt_mesh_rpl_pending_store(uint16_t addr)
 {
+	struct bt_mesh_rpl *rpl;
 	int i;
 
 	if (!IS_ENABLED(CONFIG_BT_SETTINGS) ||
@@ -335,24 +443,32 @@ void bt_mesh_rpl_pending_store(uint16_t addr)
 		return;
 	}
 
-	if (addr == BT_MESH_ADDR_ALL_NODES) {
-		bt_mesh_settings_store_cancel(BT_MESH_SETTINGS_RPL_PENDING);
-	}
+	if (addr != BT_MESH_ADDR_ALL_NODES) {
+		rpl = rpl_lookup(addr);
+		if (!rpl || rpl->src != addr) {
+			return;
+		}
 
-	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
-		if (addr != BT_MESH_ADDR_ALL_NODES &&
-		addr != replay_list[i].src) {
-			continue;
+		if (atomic_test_bit(bt_mesh.flags, BT_MESH_VALID)) {
+			store_pending_rpl(rpl);
+		} else {
+			clear_rpl(rpl);
 		}
 
+		return;
+	}
+
+	bt_mesh_settings_store_cancel(BT_MESH_SETTINGS_RPL_PENDING);
+
+	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
 		if (atomic_test_bit(bt_mesh.flags, BT_MESH_VALID)) {
 			store_pending_rpl(&replay_list[i]);
-		} else {
-			clear_rpl(&replay_list[i]);
+			continue;
 		}
 
-		if (addr != BT_MESH_ADDR_ALL_NODES) {
-			break;
+		/* Clearing an entry may move another one into its slot */
+		while (replay_list[i].src) {
+			clear_rpl(&replay_list[i]);
 		}
 	}
 }
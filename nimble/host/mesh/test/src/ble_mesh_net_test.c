@@ -0,0 +1,98 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdbool.h>
+#include "testutil/testutil.h"
+#include "mesh/mesh.h"
+#include "../src/net.h"
+
+/* Entries one set of the message cache holds */
+#define BLE_MESH_NET_TEST_WAYS      MIN(4, MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE))
+
+/* Replaces every entry of the message cache with ones not used by tests */
+static void
+ble_mesh_net_test_util_flush(void)
+{
+    int i;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE); i++) {
+        bt_mesh_msg_cache_add(0x7fff, 0x10000 + i);
+    }
+}
+
+TEST_CASE_SELF(ble_mesh_net_test_msg_cache)
+{
+    ble_mesh_net_test_util_flush();
+
+    TEST_ASSERT(!bt_mesh_msg_cache_match(0x0001, 1));
+    bt_mesh_msg_cache_add(0x0001, 1);
+    TEST_ASSERT(bt_mesh_msg_cache_match(0x0001, 1));
+
+    /* Both source and sequence number have to match */
+    TEST_ASSERT(!bt_mesh_msg_cache_match(0x0002, 1));
+    TEST_ASSERT(!bt_mesh_msg_cache_match(0x0001, 2));
+}
+
+TEST_CASE_SELF(ble_mesh_net_test_msg_cache_evict)
+{
+    uint16_t idx;
+    int i;
+
+    /* The cache in this test package is a single set, so every entry
+     * collides with every other one.
+     */
+    TEST_ASSERT_FATAL(MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE) ==
+                      BLE_MESH_NET_TEST_WAYS);
+
+    ble_mesh_net_test_util_flush();
+
+    for (i = 0; i < BLE_MESH_NET_TEST_WAYS; i++) {
+        bt_mesh_msg_cache_add(0x0001, i);
+    }
+    for (i = 0; i < BLE_MESH_NET_TEST_WAYS; i++) {
+        TEST_ASSERT(bt_mesh_msg_cache_match(0x0001, i));
+    }
+
+    /*** The oldest entry of the set is replaced. */
+    bt_mesh_msg_cache_add(0x0002, 0);
+    TEST_ASSERT(!bt_mesh_msg_cache_match(0x0001, 0));
+    for (i = 1; i < BLE_MESH_NET_TEST_WAYS; i++) {
+        TEST_ASSERT(bt_mesh_msg_cache_match(0x0001, i));
+    }
+    TEST_ASSERT(bt_mesh_msg_cache_match(0x0002, 0));
+
+    /*** A removed entry is the next one replaced. */
+    idx = bt_mesh_msg_cache_add(0x0002, 1);
+    TEST_ASSERT(!bt_mesh_msg_cache_match(0x0001, 1));
+    bt_mesh_msg_cache_remove(idx);
+    TEST_ASSERT(!bt_mesh_msg_cache_match(0x0002, 1));
+
+    bt_mesh_msg_cache_add(0x0002, 2);
+    for (i = 2; i < BLE_MESH_NET_TEST_WAYS; i++) {
+        TEST_ASSERT(bt_mesh_msg_cache_match(0x0001, i));
+    }
+    TEST_ASSERT(bt_mesh_msg_cache_match(0x0002, 0));
+    TEST_ASSERT(bt_mesh_msg_cache_match(0x0002, 2));
+}
+
+TEST_SUITE(ble_mesh_net_test_suite)
+{
+    ble_mesh_net_test_msg_cache();
+    ble_mesh_net_test_msg_cache_evict();
+}
@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "testutil/testutil.h"
+#include "mesh/mesh.h"
+#include "../src/net.h"
+#include "../src/rpl.h"
+
+#define BLE_MESH_RPL_TEST_SIZE      MYNEWT_VAL(BLE_MESH_CRPL)
+
+/* Returns true if the message is rejected as a replay or the list is full */
+static bool
+ble_mesh_rpl_test_util_rx(uint16_t src, uint32_t seq, bool old_iv)
+{
+    struct bt_mesh_net_rx rx;
+
+    memset(&rx, 0, sizeof(rx));
+    rx.net_if = BT_MESH_NET_IF_ADV;
+    rx.local_match = 1;
+    rx.ctx.addr = src;
+    rx.seq = seq;
+    rx.old_iv = old_iv;
+
+    return bt_mesh_rpl_check(&rx, NULL);
+}
+
+TEST_CASE_SELF(ble_mesh_rpl_test_replay)
+{
+    bt_mesh_rpl_clear();
+
+    TEST_ASSERT(!ble_mesh_rpl_test_util_rx(0x0001, 1, false));
+    TEST_ASSERT(ble_mesh_rpl_test_util_rx(0x0001, 1, false));
+    TEST_ASSERT(ble_mesh_rpl_test_util_rx(0x0001, 0, false));
+    TEST_ASSERT(!ble_mesh_rpl_test_util_rx(0x0001, 5, false));
+
+    /* Sources are tracked independently */
+    TEST_ASSERT(!ble_mesh_rpl_test_util_rx(0x0002, 1, false));
+    TEST_ASSERT(ble_mesh_rpl_test_util_rx(0x0001, 5, false));
+
+    /* Nothing on the previous IV Index after the current one */
+    TEST_ASSERT(ble_mesh_rpl_test_util_rx(0x0001, 6, true));
+}
+
+TEST_CASE_SELF(ble_mesh_rpl_test_full)
+{
+    uint16_t src;
+
+    bt_mesh_rpl_clear();
+
+    /*** Exactly BLE_MESH_CRPL sources fit, however they collide. */
+    for (src = 1; src <= BLE_MESH_RPL_TEST_SIZE; src++) {
+        TEST_ASSERT(!ble_mesh_rpl_test_util_rx(src, 1, false));
+    }
+
+    for (src = 1; src <= BLE_MESH_RPL_TEST_SIZE; src++) {
+        TEST_ASSERT(ble_mesh_rpl_test_util_rx(src, 1, false));
+        TEST_ASSERT(!ble_mesh_rpl_test_util_rx(src, 2, false));
+    }
+
+    /*** Full; source BLE_MESH_CRPL + 1 is rejected. */
+    TEST_ASSERT(src == BLE_MESH_RPL_TEST_SIZE + 1);
+    TEST_ASSERT(ble_mesh_rpl_test_util_rx(src, 1, false));
+    TEST_ASSERT(ble_mesh_rpl_test_util_rx(0x7fff, 1, false));
+
+    /*** Clearing the list makes room again. */
+    bt_mesh_rpl_clear();
+    TEST_ASSERT(!ble_mesh_rpl_test_util_rx(src, 1, false));
+    TEST_ASSERT(!ble_mesh_rpl_test_util_rx(0x0001, 1, false));
+}
+
+TEST_CASE_SELF(ble_mesh_rpl_test_removed)
+{
+    uint16_t src;
+    int i;
+
+    bt_mesh_rpl_clear();
+
+    for (src = 1; src <= BLE_MESH_RPL_TEST_SIZE; src++) {
+        TEST_ASSERT(!ble_mesh_rpl_test_util_rx(src, 1, false));
+    }
+
+    /* Odd sources are not heard from on the new IV Index, so their entries
+     * are removed by the next IV Index update.
+     */
+    bt_mesh_rpl_reset();
+    for (src = 2; src <= BLE_MESH_RPL_TEST_SIZE; src += 2) {
+        TEST_ASSERT(!ble_mesh_rpl_test_util_rx(src, 2, false));
+    }
+    bt_mesh_rpl_reset();
+
+    /*** Entries stored past a removed one are still found. */
+    for (src = 2; src <= BLE_MESH_RPL_TEST_SIZE; src += 2) {
+        TEST_ASSERT(ble_mesh_rpl_test_util_rx(src, 2, true));
+    }
+
+    /*** Removed entries make room for exactly as many new sources. */
+    for (src = BLE_MESH_RPL_TEST_SIZE + 1;
+         src <= BLE_MESH_RPL_TEST_SIZE * 3 / 2; src++) {
+        TEST_ASSERT(!ble_mesh_rpl_test_util_rx(src, 1, false));
+    }
+    TEST_ASSERT(ble_mesh_rpl_test_util_rx(src, 1, false));
+
+    for (src = 2; src <= BLE_MESH_RPL_TEST_SIZE; src += 2) {
+        TEST_ASSERT(ble_mesh_rpl_test_util_rx(src, 2, true));
+    }
+
+    /*** Repeated IV Index updates with changing sources leave the list
+     *   consistent: every current source is found, and the list holds
+     *   exactly BLE_MESH_CRPL of them.
+     */
+    for (i = 0; i < 8; i++) {
+        bt_mesh_rpl_reset();
+        bt_mesh_rpl_reset();
+
+        for (src = 1; src <= BLE_MESH_RPL_TEST_SIZE; src++) {
+            TEST_ASSERT(!ble_mesh_rpl_test_util_rx(src * 7 + i * 3, 1,
+                                                   false));
+        }
+        TEST_ASSERT(ble_mesh_rpl_test_util_rx(0x7fff, 1, false));
+
+        for (src = 1; src <= BLE_MESH_RPL_TEST_SIZE; src++) {
+            TEST_ASSERT(ble_mesh_rpl_test_util_rx(src * 7 + i * 3, 1,
+                                                  false));
+        }
+    }
+
+    bt_mesh_rpl_clear();
+}
+
+TEST_SUITE(ble_mesh_rpl_test_suite)
+{
+    ble_mesh_rpl_test_replay();
+    ble_mesh_rpl_test_full();
+    ble_mesh_rpl_test_removed();
+}
@@ -154,6 +154,13 @@ struct ble_att_svr_entry {
     uint16_t ha_handle_id;
     ble_att_svr_access_fn *ha_cb;
     void *ha_cb_arg;
+
+    /* Next attribute of the same type, in handle order. */
+    struct ble_att_svr_entry *ha_uuid_next;
+    /* Next attribute type hashed to the same bucket; only used by the first
+     * attribute of each type.
+     */
+    struct ble_att_svr_entry *ha_bucket_next;
 };
 
 SLIST_HEAD(ble_att_clt_entry_list, ble_att_clt_entry);
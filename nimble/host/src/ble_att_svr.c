@@ -55,6 +55,16 @@ static uint16_t ble_att_svr_id;
 static void *ble_att_svr_entry_mem;
 static struct os_mempool ble_att_svr_entry_pool;
 
+/* Visible attributes indexed by handle - 1; hidden handles map to NULL. */
+static struct ble_att_svr_entry **ble_att_svr_idx;
+static uint16_t ble_att_svr_idx_sz;
+
+/* First attribute of each type, hashed by type.  Attributes of one type are
+ * chained through ha_uuid_next.
+ */
+static struct ble_att_svr_entry **ble_att_svr_uuid_idx;
+static uint16_t ble_att_svr_uuid_idx_sz;
+
 static os_membuf_t ble_att_svr_prep_entry_mem[
     OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_ATT_SVR_MAX_PREP_ENTRIES),
                     sizeof (struct ble_att_prep_entry))
@@ -81,6 +91,95 @@ ble_att_svr_entry_free(struct ble_att_svr_entry *entry)
     os_memblock_put(&ble_att_svr_entry_pool, entry);
 }
 
+static uint16_t
+ble_att_svr_uuid_hash(const ble_uuid_t *uuid)
+{
+    const uint8_t *val;
+    uint32_t hash;
+    int i;
+
+    switch (uuid->type) {
+    case BLE_UUID_TYPE_16:
+        hash = BLE_UUID16(uuid)->value;
+        break;
+
+    case BLE_UUID_TYPE_32:
+        hash = BLE_UUID32(uuid)->value;
+        hash ^= hash >> 16;
+        break;
+
+    default:
+        /* FNV-1a */
+        val = BLE_UUID128(uuid)->value;
+        hash = 2166136261u;
+        for (i = 0; i < 16; i++) {
+            hash = (hash ^ val[i]) * 16777619u;
+        }
+        hash ^= hash >> 16;
+        break;
+    }
+
+    return hash & (ble_att_svr_uuid_idx_sz - 1);
+}
+
+static struct ble_att_svr_entry *
+ble_att_svr_uuid_first(const ble_uuid_t *uuid)
+{
+    struct ble_att_svr_entry *entry;
+
+    if (ble_att_svr_uuid_idx == NULL) {
+        return NULL;
+    }
+
+    for (entry = ble_att_svr_uuid_idx[ble_att_svr_uuid_hash(uuid)];
+         entry != NULL;
+         entry = entry->ha_bucket_next) {
+
+        if (ble_uuid_cmp(entry->ha_uuid, uuid) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+ble_att_svr_idx_add(struct ble_att_svr_entry *entry)
+{
+    struct ble_att_svr_entry **bucket;
+    struct ble_att_svr_entry *last;
+
+    BLE_HS_DBG_ASSERT(entry->ha_handle_id <= ble_att_svr_idx_sz);
+    ble_att_svr_idx[entry->ha_handle_id - 1] = entry;
+
+    last = ble_att_svr_uuid_first(entry->ha_uuid);
+    if (last == NULL) {
+        bucket = &ble_att_svr_uuid_idx[ble_att_svr_uuid_hash(entry->ha_uuid)];
+        entry->ha_bucket_next = *bucket;
+        *bucket = entry;
+        return;
+    }
+
+    /* Handles are allocated in increasing order, append. */
+    while (last->ha_uuid_next != NULL) {
+        last = last->ha_uuid_next;
+    }
+    last->ha_uuid_next = entry;
+}
+
+static void
+ble_att_svr_idx_clear(void)
+{
+    if (ble_att_svr_idx != NULL) {
+        memset(ble_att_svr_idx, 0,
+               ble_att_svr_idx_sz * sizeof *ble_att_svr_idx);
+    }
+    if (ble_att_svr_uuid_idx != NULL) {
+        memset(ble_att_svr_uuid_idx, 0,
+               ble_att_svr_uuid_idx_sz * sizeof *ble_att_svr_uuid_idx);
+    }
+}
+
 /**
  * Allocate the next handle id and return it.
  *
@@ -125,6 +224,7 @@ ble_att_svr_register(const ble_uuid_t *uuid, uint8_t flags,
     entry->ha_cb_arg = cb_arg;
 
     STAILQ_INSERT_TAIL(&ble_att_svr_list, entry, ha_next);
+    ble_att_svr_idx_add(entry);
 
     if (handle_id != NULL) {
         *handle_id = entry->ha_handle_id;
@@ -143,27 +243,32 @@ ble_att_svr_prev_handle(void)
  * Find a host attribute by handle id.
  *
  * @param handle_id             The handle_id to search for
- * @param ha_ptr                On input: Indicates the starting point of the
- *                                  walk; null means start at the beginning of
- *                                  the list, non-null means start at the
- *                                  following entry.
- *                              On output: Indicates the last ble_att element
- *                                  processed, or NULL if the entire list has
- *                                  been processed.
  *
- * @return                      0 on success; BLE_HS_ENOENT on not found.
+ * @return                      The attribute on success; NULL if there is no
+ *                                  visible attribute with that handle.
  */
 struct ble_att_svr_entry *
 ble_att_svr_find_by_handle(uint16_t handle_id)
 {
-    struct ble_att_svr_entry *entry;
+    if (handle_id == 0 || handle_id > ble_att_svr_id) {
+        return NULL;
+    }
 
-    for (entry = STAILQ_FIRST(&ble_att_svr_list);
-         entry != NULL;
-         entry = STAILQ_NEXT(entry, ha_next)) {
+    return ble_att_svr_idx[handle_id - 1];
+}
 
-        if (entry->ha_handle_id == handle_id) {
-            return entry;
+/**
+ * Find the first visible host attribute with a handle of at least
+ * `handle_id`.
+ */
+static struct ble_att_svr_entry *
+ble_att_svr_find_from(uint16_t handle_id)
+{
+    uint32_t i;
+
+    for (i = handle_id ? handle_id : 1; i <= ble_att_svr_id; i++) {
+        if (ble_att_svr_idx[i - 1] != NULL) {
+            return ble_att_svr_idx[i - 1];
         }
     }
 
@@ -191,17 +296,37 @@ ble_att_svr_find_by_uuid(struct ble_att_svr_entry *prev, const ble_uuid_t *uuid,
 {
     struct ble_att_svr_entry *entry;
 
-    if (prev == NULL) {
-        entry = STAILQ_FIRST(&ble_att_svr_list);
+    if (uuid == NULL) {
+        if (prev == NULL) {
+            entry = ble_att_svr_find_from(1);
+        } else {
+            entry = STAILQ_NEXT(prev, ha_next);
+        }
+
+        if (entry != NULL && entry->ha_handle_id <= end_handle) {
+            return entry;
+        }
+
+        return NULL;
+    }
+
+    /* Only walk attributes of the requested type. */
+    if (prev != NULL && ble_uuid_cmp(prev->ha_uuid, uuid) == 0) {
+        entry = prev->ha_uuid_next;
     } else {
-        entry = STAILQ_NEXT(prev, ha_next);
+        entry = ble_att_svr_uuid_first(uuid);
+        while (prev != NULL && entry != NULL &&
+               entry->ha_handle_id <= prev->ha_handle_id) {
+            entry = entry->ha_uuid_next;
+        }
     }
 
     for (;
          entry != NULL && entry->ha_handle_id <= end_handle;
-         entry = STAILQ_NEXT(entry, ha_next)) {
+         entry = entry->ha_uuid_next) {
 
-        if (uuid == NULL || ble_uuid_cmp(entry->ha_uuid, uuid) == 0) {
+        /* Skip hidden attributes. */
+        if (ble_att_svr_idx[entry->ha_handle_id - 1] == entry) {
             return entry;
         }
     }
@@ -798,7 +923,9 @@ ble_att_svr_fill_info(uint16_t start_handle, uint16_t end_handle,
     num_entries = 0;
     rc = 0;
 
-    STAILQ_FOREACH(ha, &ble_att_svr_list, ha_next) {
+    for (ha = ble_att_svr_find_from(start_handle);
+         ha != NULL;
+         ha = STAILQ_NEXT(ha, ha_next)) {
         if (ha->ha_handle_id > end_handle) {
             rc = 0;
             goto done;
@@ -1083,10 +1210,9 @@ ble_att_svr_fill_type_value(uint16_t conn_handle,
      * matching group.  For each attribute entry, determine if data needs to be
      * written to the response.
      */
-    STAILQ_FOREACH(ha, &ble_att_svr_list, ha_next) {
-        if (ha->ha_handle_id < start_handle) {
-            continue;
-        }
+    for (ha = ble_att_svr_find_from(start_handle);
+         ha != NULL;
+         ha = STAILQ_NEXT(ha, ha_next)) {
 
         /* Continue to look for end of group in case group is in progress. */
         if (!first && ha->ha_handle_id > end_handle) {
@@ -1844,10 +1970,9 @@ ble_att_svr_build_read_group_type_rsp(uint16_t conn_handle, uint16_t cid,
     }
 
     rsp->bagp_length = 0;
-    STAILQ_FOREACH(entry, &ble_att_svr_list, ha_next) {
-        if (entry->ha_handle_id < start_handle) {
-            continue;
-        }
+    for (entry = ble_att_svr_find_from(start_handle);
+         entry != NULL;
+         entry = STAILQ_NEXT(entry, ha_next)) {
         if (entry->ha_handle_id > end_handle) {
             /* The full input range has been searched. */
             rc = 0;
@@ -2771,7 +2896,8 @@ done:
 static void
 ble_att_svr_move_entries(struct ble_att_svr_entry_list *src,
                          struct ble_att_svr_entry_list *dst,
-                         uint16_t start_handle, uint16_t end_handle)
+                         uint16_t start_handle, uint16_t end_handle,
+                         int visible)
 {
 
     struct ble_att_svr_entry *entry;
@@ -2819,6 +2945,8 @@ ble_att_svr_move_entries(struct ble_att_svr_entry_list *src,
             insert = entry;
         }
 
+        ble_att_svr_idx[entry->ha_handle_id - 1] = visible ? entry : NULL;
+
         /* Calculate next candidate to remove */
         if (remove == NULL) {
             entry = STAILQ_FIRST(src);
@@ -2832,14 +2960,14 @@ void
 ble_att_svr_hide_range(uint16_t start_handle, uint16_t end_handle)
 {
     ble_att_svr_move_entries(&ble_att_svr_list, &ble_att_svr_hidden_list,
-                             start_handle, end_handle);
+                             start_handle, end_handle, 0);
 }
 
 void
 ble_att_svr_restore_range(uint16_t start_handle, uint16_t end_handle)
 {
     ble_att_svr_move_entries(&ble_att_svr_hidden_list, &ble_att_svr_list,
-                             start_handle, end_handle);
+                             start_handle, end_handle, 1);
 }
 
 void
@@ -2858,7 +2986,8 @@ ble_att_svr_reset(void)
     }
 
     ble_att_svr_id = 0;
-    
+    ble_att_svr_idx_clear();
+
     /* Note: prep entries do not get freed here because it is assumed there are
      * no established connections.
      */
@@ -2869,6 +2998,14 @@ ble_att_svr_free_start_mem(void)
 {
     free(ble_att_svr_entry_mem);
     ble_att_svr_entry_mem = NULL;
+
+    free(ble_att_svr_idx);
+    ble_att_svr_idx = NULL;
+    ble_att_svr_idx_sz = 0;
+
+    free(ble_att_svr_uuid_idx);
+    ble_att_svr_uuid_idx = NULL;
+    ble_att_svr_uuid_idx_sz = 0;
 }
 
 int
@@ -2894,6 +3031,29 @@ ble_att_svr_start(void)
             rc = BLE_HS_EOS;
             goto err;
         }
+
+        ble_att_svr_idx = malloc(ble_hs_max_attrs * sizeof *ble_att_svr_idx);
+        if (ble_att_svr_idx == NULL) {
+            rc = BLE_HS_ENOMEM;
+            goto err;
+        }
+        ble_att_svr_idx_sz = ble_hs_max_attrs;
+
+        /* Roughly four attributes per type (declaration, value, descriptors)
+         * in a typical GATT database.
+         */
+        ble_att_svr_uuid_idx_sz = 8;
+        while (ble_att_svr_uuid_idx_sz < ble_hs_max_attrs / 4) {
+            ble_att_svr_uuid_idx_sz <<= 1;
+        }
+        ble_att_svr_uuid_idx = malloc(ble_att_svr_uuid_idx_sz *
+                                      sizeof *ble_att_svr_uuid_idx);
+        if (ble_att_svr_uuid_idx == NULL) {
+            rc = BLE_HS_ENOMEM;
+            goto err;
+        }
+
+        ble_att_svr_idx_clear();
     }
 
     return 0;
@@ -995,12 +995,39 @@ ble_gap_disc_report(void *desc)
     ble_gap_event_listener_call(&event);
 }
 
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS)
+void
+ble_gap_disc_batch_report(const struct ble_gap_disc_batch_report *reports,
+                          uint16_t num_reports)
+{
+    struct ble_gap_master_state state;
+    struct ble_gap_event event;
+
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_DISC_BATCH;
+    event.disc_batch.num_reports = num_reports;
+    event.disc_batch.reports = reports;
+
+    ble_gap_master_extract_state(&state, 0);
+    if (ble_gap_has_client(&state)) {
+        state.cb(&event, state.cb_arg);
+    }
+
+    ble_gap_event_listener_call(&event);
+}
+#endif
+
 static void
 ble_gap_disc_complete(void)
 {
     struct ble_gap_master_state state;
     struct ble_gap_event event;
 
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS)
+    /* Reports buffered so far precede the completion */
+    ble_gap_disc_batch_flush();
+#endif
+
     memset(&event, 0, sizeof event);
     event.type = BLE_GAP_EVENT_DISC_COMPLETE;
     event.disc_complete.reason = 0;
@@ -1538,6 +1565,18 @@ ble_gap_rx_adv_report(struct ble_gap_disc_desc *desc)
         return;
     }
 
+#if MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS)
+    if (ble_gap_adv_mon_rx_adv_report(desc) == 0) {
+        return;
+    }
+#endif
+
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS) && !MYNEWT_VAL(BLE_EXT_ADV)
+    if (ble_gap_disc_batch_rx_adv_report(desc) == 0) {
+        return;
+    }
+#endif
+
     ble_gap_disc_report(desc);
 #endif
 }
@@ -1557,6 +1596,18 @@ ble_gap_rx_ext_adv_report(struct ble_gap_ext_disc_desc *desc)
         return;
     }
 
+#if MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS)
+    if (ble_gap_adv_mon_rx_ext_adv_report(desc) == 0) {
+        return;
+    }
+#endif
+
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS)
+    if (ble_gap_disc_batch_rx_ext_adv_report(desc) == 0) {
+        return;
+    }
+#endif
+
     ble_gap_disc_report(desc);
 }
 #endif
@@ -2319,6 +2370,10 @@ ble_gap_timer(void)
     min_ticks = min(min_ticks, ble_gap_slave_timer());
 #endif
 
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS) && NIMBLE_BLE_SCAN
+    min_ticks = min(min_ticks, ble_gap_disc_batch_timer());
+#endif
+
     return min_ticks;
 }
 
@@ -4814,6 +4869,16 @@ ble_gap_ext_disc(uint8_t own_addr_type, uint16_t duration, uint16_t period,
     ble_gap_master.cb = cb;
     ble_gap_master.cb_arg = cb_arg;
 
+#if MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS)
+    /* Chains left incomplete by a previous procedure never complete */
+    ble_gap_adv_mon_flush();
+#endif
+
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS)
+    /* Drop whatever a cancelled procedure left buffered */
+    ble_gap_disc_batch_reset();
+#endif
+
     rc = ble_gap_ext_disc_tx_params(own_addr_type, filter_policy,
                                     uncoded_params ? &ucp : NULL,
                                     coded_params ? &cp : NULL);
@@ -4965,6 +5030,11 @@ ble_gap_disc(uint8_t own_addr_type, int32_t duration_ms,
     ble_gap_master.cb = cb;
     ble_gap_master.cb_arg = cb_arg;
 
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS)
+    /* Drop whatever a cancelled procedure left buffered */
+    ble_gap_disc_batch_reset();
+#endif
+
     BLE_HS_LOG(INFO, "GAP procedure initiated: discovery; ");
     ble_gap_log_disc(own_addr_type, duration_ms, &params);
     BLE_HS_LOG(INFO, "\n");
@@ -6411,6 +6481,74 @@ ble_gap_conn_rssi(uint16_t conn_handle, int8_t *out_rssi)
     return rc;
 }
 
+/*****************************************************************************
+ * $tx queue                                                                 *
+ *****************************************************************************/
+
+int
+ble_gap_set_tx_weight(uint16_t conn_handle, uint8_t weight)
+{
+#if MYNEWT_VAL(BLE_HS_TX_SCHED_DRR)
+    struct ble_hs_conn *conn;
+
+    if (weight == 0) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL) {
+        conn->bhc_tx_weight = weight;
+    }
+    ble_hs_unlock();
+
+    if (conn == NULL) {
+        return BLE_HS_ENOTCONN;
+    }
+
+    return 0;
+#else
+    return BLE_HS_ENOTSUP;
+#endif
+}
+
+int
+ble_gap_conn_tx_stats(uint16_t conn_handle,
+                      struct ble_gap_conn_tx_stats *out_stats, int reset)
+{
+    struct ble_hs_conn *conn;
+    ble_npl_time_t hol;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL) {
+        hol = 0;
+        if (!STAILQ_EMPTY(&conn->bhc_tx_q)) {
+            hol = ble_npl_time_get() - conn->bhc_tx_hol_start;
+        }
+
+        out_stats->queued_pkts = conn->bhc_tx_q_pkts;
+        out_stats->queued_pkts_max = conn->bhc_tx_q_pkts_max;
+        out_stats->hol_ms = ble_npl_time_ticks_to_ms32(hol);
+        out_stats->hol_max_ms =
+            ble_npl_time_ticks_to_ms32(conn->bhc_tx_hol_max);
+
+        if (reset) {
+            conn->bhc_tx_q_pkts_max = conn->bhc_tx_q_pkts;
+            conn->bhc_tx_hol_max = 0;
+        }
+    }
+
+    ble_hs_unlock();
+
+    if (conn == NULL) {
+        return BLE_HS_ENOTCONN;
+    }
+
+    return 0;
+}
+
 /*****************************************************************************
  * $notify                                                                   *
  *****************************************************************************/
@@ -6751,6 +6889,14 @@ ble_gap_init(void)
     memset(&ble_gap_sync, 0, sizeof(ble_gap_sync));
 #endif
 
+#if MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS) && NIMBLE_BLE_SCAN
+    ble_gap_adv_mon_init();
+#endif
+
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS) && NIMBLE_BLE_SCAN
+    ble_gap_disc_batch_init();
+#endif
+
     rc = ble_npl_mutex_init(&preempt_done_mutex);
 
     if (rc) {
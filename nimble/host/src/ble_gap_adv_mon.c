@@ -0,0 +1,785 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "syscfg/syscfg.h"
+#include "host/ble_hs_adv.h"
+#include "ble_hs_priv.h"
+
+#if MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS) && NIMBLE_BLE_SCAN
+
+#define BLE_GAP_ADV_MON_MAX             MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS)
+
+/* Criteria checked while walking the AD structures of a report */
+#define BLE_GAP_ADV_MON_F_FIELDS        (BLE_GAP_ADV_MON_F_AD_TYPE | \
+                                         BLE_GAP_ADV_MON_F_UUID |    \
+                                         BLE_GAP_ADV_MON_F_MFG)
+
+#define BLE_GAP_ADV_MON_F_ALL           (BLE_GAP_ADV_MON_F_ADDR |    \
+                                         BLE_GAP_ADV_MON_F_RSSI |    \
+                                         BLE_GAP_ADV_MON_F_FIELDS)
+
+/*
+ * A filter compiled into the form it is evaluated in: UUIDs and the
+ * manufacturer data prefix as the bytes expected on air, and the AD types
+ * they may appear in.
+ */
+struct ble_gap_adv_mon_entry {
+    ble_gap_event_fn *cb;
+    void *cb_arg;
+    uint32_t hits;
+
+    uint8_t criteria;
+    int8_t rssi_min;
+    ble_addr_t addr;
+    uint8_t ad_type;
+
+    /* Incomplete service UUID list type; the complete list type follows */
+    uint8_t uuid_list_type;
+    uint8_t uuid_svc_data_type;
+    uint8_t uuid_len;
+    uint8_t uuid[16];
+
+    /* Company identifier (little-endian) followed by the prefix */
+    uint8_t mfg_len;
+    uint8_t mfg[2 + BLE_GAP_ADV_MON_MFG_PREFIX_MAX];
+};
+
+static struct ble_gap_adv_mon_entry ble_gap_adv_mon_entries[BLE_GAP_ADV_MON_MAX];
+
+/* Filters in use, and those of them with no address criterion */
+static uint32_t ble_gap_adv_mon_used;
+static uint32_t ble_gap_adv_mon_any_addr;
+
+/* AD types inspected by at least one filter; other fields are skipped */
+static uint32_t ble_gap_adv_mon_ad_types[256 / 32];
+
+/* Only updated by the host task, so not protected by the host lock */
+static struct ble_gap_adv_mon_stats ble_gap_adv_mon_stats_cur;
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+/*
+ * Extended advertising data in the making, keyed by advertiser address and
+ * SID.  Slots are only filled and read by the host task; flushing merely
+ * marks them free.
+ */
+struct ble_gap_adv_mon_reasm {
+    struct ble_gap_adv_mon_desc desc;
+    uint32_t age;
+    uint8_t used;
+    uint8_t buf[MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE)];
+};
+
+static struct ble_gap_adv_mon_reasm
+    ble_gap_adv_mon_reasm[MYNEWT_VAL(BLE_GAP_ADV_MON_REASM_SLOTS)];
+static uint32_t ble_gap_adv_mon_reasm_age;
+
+/*
+ * Advertisers whose reassembly was evicted.  Their remaining fragments are
+ * dropped up to and including the last one, so that the tail of the data is
+ * not taken for a report of its own.
+ */
+struct ble_gap_adv_mon_discard {
+    ble_addr_t addr;
+    uint8_t sid;
+    uint8_t used;
+};
+
+static struct ble_gap_adv_mon_discard
+    ble_gap_adv_mon_discard[MYNEWT_VAL(BLE_GAP_ADV_MON_REASM_SLOTS)];
+static uint8_t ble_gap_adv_mon_discard_next;
+#endif
+
+static void
+ble_gap_adv_mon_ad_type_set(uint8_t ad_type)
+{
+    ble_gap_adv_mon_ad_types[ad_type / 32] |= 1UL << (ad_type % 32);
+}
+
+static int
+ble_gap_adv_mon_ad_type_isset(uint8_t ad_type)
+{
+    return ble_gap_adv_mon_ad_types[ad_type / 32] & (1UL << (ad_type % 32));
+}
+
+/**
+ * Recomputes the summary of the filter table used to reject reports early.
+ *
+ * Lock restrictions:
+ *     o Caller locks host.
+ */
+static void
+ble_gap_adv_mon_recompile(void)
+{
+    const struct ble_gap_adv_mon_entry *entry;
+    int i;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    ble_gap_adv_mon_any_addr = 0;
+    memset(ble_gap_adv_mon_ad_types, 0, sizeof(ble_gap_adv_mon_ad_types));
+
+    for (i = 0; i < BLE_GAP_ADV_MON_MAX; i++) {
+        if (!(ble_gap_adv_mon_used & (1UL << i))) {
+            continue;
+        }
+
+        entry = &ble_gap_adv_mon_entries[i];
+        if (!(entry->criteria & BLE_GAP_ADV_MON_F_ADDR)) {
+            ble_gap_adv_mon_any_addr |= 1UL << i;
+        }
+        if (entry->criteria & BLE_GAP_ADV_MON_F_AD_TYPE) {
+            ble_gap_adv_mon_ad_type_set(entry->ad_type);
+        }
+        if (entry->criteria & BLE_GAP_ADV_MON_F_UUID) {
+            ble_gap_adv_mon_ad_type_set(entry->uuid_list_type);
+            ble_gap_adv_mon_ad_type_set(entry->uuid_list_type + 1);
+            ble_gap_adv_mon_ad_type_set(entry->uuid_svc_data_type);
+        }
+        if (entry->criteria & BLE_GAP_ADV_MON_F_MFG) {
+            ble_gap_adv_mon_ad_type_set(BLE_HS_ADV_TYPE_MFG_DATA);
+        }
+    }
+}
+
+static int
+ble_gap_adv_mon_compile(struct ble_gap_adv_mon_entry *entry,
+                        const struct ble_gap_adv_mon_filter *filter)
+{
+    memset(entry, 0, sizeof(*entry));
+
+    if (filter->criteria & ~BLE_GAP_ADV_MON_F_ALL) {
+        return BLE_HS_EINVAL;
+    }
+
+    entry->criteria = filter->criteria;
+    entry->rssi_min = filter->rssi_min;
+    entry->addr = filter->addr;
+    entry->ad_type = filter->ad_type;
+
+    if (filter->criteria & BLE_GAP_ADV_MON_F_UUID) {
+        switch (filter->uuid.u.type) {
+        case BLE_UUID_TYPE_16:
+            entry->uuid_list_type = BLE_HS_ADV_TYPE_INCOMP_UUIDS16;
+            entry->uuid_svc_data_type = BLE_HS_ADV_TYPE_SVC_DATA_UUID16;
+            entry->uuid_len = 2;
+            put_le16(entry->uuid, filter->uuid.u16.value);
+            break;
+        case BLE_UUID_TYPE_32:
+            entry->uuid_list_type = BLE_HS_ADV_TYPE_INCOMP_UUIDS32;
+            entry->uuid_svc_data_type = BLE_HS_ADV_TYPE_SVC_DATA_UUID32;
+            entry->uuid_len = 4;
+            put_le32(entry->uuid, filter->uuid.u32.value);
+            break;
+        case BLE_UUID_TYPE_128:
+            entry->uuid_list_type = BLE_HS_ADV_TYPE_INCOMP_UUIDS128;
+            entry->uuid_svc_data_type = BLE_HS_ADV_TYPE_SVC_DATA_UUID128;
+            entry->uuid_len = 16;
+            memcpy(entry->uuid, filter->uuid.u128.value, 16);
+            break;
+        default:
+            return BLE_HS_EINVAL;
+        }
+    }
+
+    if (filter->criteria & BLE_GAP_ADV_MON_F_MFG) {
+        if (filter->mfg_prefix_len > BLE_GAP_ADV_MON_MFG_PREFIX_MAX) {
+            return BLE_HS_EINVAL;
+        }
+
+        put_le16(entry->mfg, filter->company_id);
+        memcpy(entry->mfg + 2, filter->mfg_prefix, filter->mfg_prefix_len);
+        entry->mfg_len = 2 + filter->mfg_prefix_len;
+    }
+
+    return 0;
+}
+
+int
+ble_gap_adv_mon_add(const struct ble_gap_adv_mon_filter *filter,
+                    ble_gap_event_fn *cb, void *cb_arg,
+                    uint8_t *out_filter_id)
+{
+    struct ble_gap_adv_mon_entry entry;
+    int rc;
+    int i;
+
+    if (filter == NULL || cb == NULL) {
+        return BLE_HS_EINVAL;
+    }
+
+    rc = ble_gap_adv_mon_compile(&entry, filter);
+    if (rc != 0) {
+        return rc;
+    }
+
+    entry.cb = cb;
+    entry.cb_arg = cb_arg;
+
+    ble_hs_lock();
+
+    rc = BLE_HS_ENOMEM;
+    for (i = 0; i < BLE_GAP_ADV_MON_MAX; i++) {
+        if (!(ble_gap_adv_mon_used & (1UL << i))) {
+            ble_gap_adv_mon_entries[i] = entry;
+            ble_gap_adv_mon_used |= 1UL << i;
+            ble_gap_adv_mon_recompile();
+
+            if (out_filter_id != NULL) {
+                *out_filter_id = i;
+            }
+            rc = 0;
+            break;
+        }
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+int
+ble_gap_adv_mon_remove(uint8_t filter_id)
+{
+    int rc;
+
+    ble_hs_lock();
+
+    if (filter_id < BLE_GAP_ADV_MON_MAX &&
+        (ble_gap_adv_mon_used & (1UL << filter_id))) {
+        ble_gap_adv_mon_used &= ~(1UL << filter_id);
+        ble_gap_adv_mon_recompile();
+        rc = 0;
+    } else {
+        rc = BLE_HS_ENOENT;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+int
+ble_gap_adv_mon_hits(uint8_t filter_id, uint32_t *out_hits)
+{
+    int rc;
+
+    ble_hs_lock();
+
+    if (filter_id < BLE_GAP_ADV_MON_MAX &&
+        (ble_gap_adv_mon_used & (1UL << filter_id))) {
+        *out_hits = ble_gap_adv_mon_entries[filter_id].hits;
+        rc = 0;
+    } else {
+        rc = BLE_HS_ENOENT;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+int
+ble_gap_adv_mon_stats(struct ble_gap_adv_mon_stats *out_stats, int reset)
+{
+    ble_hs_lock();
+
+    *out_stats = ble_gap_adv_mon_stats_cur;
+    if (reset) {
+        memset(&ble_gap_adv_mon_stats_cur, 0,
+               sizeof(ble_gap_adv_mon_stats_cur));
+    }
+
+    ble_hs_unlock();
+
+    return 0;
+}
+
+/**
+ * Returns the filters a report from the specified address may match,
+ * judging by the address alone.
+ *
+ * Lock restrictions:
+ *     o Caller locks host.
+ */
+static uint32_t
+ble_gap_adv_mon_addr_candidates(const ble_addr_t *addr)
+{
+    uint32_t cand;
+    int i;
+
+    cand = ble_gap_adv_mon_any_addr;
+
+    for (i = 0; i < BLE_GAP_ADV_MON_MAX; i++) {
+        if ((ble_gap_adv_mon_used & ~cand & (1UL << i)) &&
+            ble_addr_cmp(&ble_gap_adv_mon_entries[i].addr, addr) == 0) {
+            cand |= 1UL << i;
+        }
+    }
+
+    return cand;
+}
+
+static int
+ble_gap_adv_mon_field_uuid(const struct ble_gap_adv_mon_entry *entry,
+                           uint8_t type, const uint8_t *val, uint8_t len)
+{
+    int off;
+
+    if (type == entry->uuid_svc_data_type) {
+        return len >= entry->uuid_len &&
+               memcmp(val, entry->uuid, entry->uuid_len) == 0;
+    }
+
+    if (type != entry->uuid_list_type && type != entry->uuid_list_type + 1) {
+        return 0;
+    }
+
+    for (off = 0; off + entry->uuid_len <= len; off += entry->uuid_len) {
+        if (memcmp(val + off, entry->uuid, entry->uuid_len) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Evaluates a complete report against all filters.  Only AD structures of a
+ * type some filter is interested in are looked at, and the walk stops as
+ * soon as no filter has unsatisfied criteria left.
+ *
+ * Lock restrictions:
+ *     o Caller locks host.
+ *
+ * @return                      Bitmask of the matching filters.
+ */
+static uint32_t
+ble_gap_adv_mon_match(const struct ble_gap_adv_mon_desc *desc)
+{
+    const struct ble_gap_adv_mon_entry *entry;
+    uint8_t need[BLE_GAP_ADV_MON_MAX];
+    const uint8_t *val;
+    uint32_t pending;
+    uint32_t cand;
+    uint16_t off;
+    uint8_t type;
+    uint8_t len;
+    int i;
+
+    cand = ble_gap_adv_mon_addr_candidates(&desc->addr);
+    pending = 0;
+
+    for (i = 0; i < BLE_GAP_ADV_MON_MAX; i++) {
+        if (!(cand & (1UL << i))) {
+            continue;
+        }
+
+        entry = &ble_gap_adv_mon_entries[i];
+        if ((entry->criteria & BLE_GAP_ADV_MON_F_RSSI) &&
+            (desc->rssi == 127 || desc->rssi < entry->rssi_min)) {
+            cand &= ~(1UL << i);
+            continue;
+        }
+
+        need[i] = entry->criteria & BLE_GAP_ADV_MON_F_FIELDS;
+        if (need[i] != 0) {
+            pending |= 1UL << i;
+        }
+    }
+
+    off = 0;
+    while (pending != 0 && off < desc->length_data) {
+        len = desc->data[off];
+        if (len == 0 || off + 1 + len > desc->length_data) {
+            /* End of significant data, or malformed */
+            break;
+        }
+
+        type = desc->data[off + 1];
+        val = &desc->data[off + 2];
+        off += 1 + len;
+        len--;
+
+        if (!ble_gap_adv_mon_ad_type_isset(type)) {
+            continue;
+        }
+
+        for (i = 0; i < BLE_GAP_ADV_MON_MAX; i++) {
+            if (!(pending & (1UL << i))) {
+                continue;
+            }
+
+            entry = &ble_gap_adv_mon_entries[i];
+            if ((need[i] & BLE_GAP_ADV_MON_F_AD_TYPE) &&
+                type == entry->ad_type) {
+                need[i] &= ~BLE_GAP_ADV_MON_F_AD_TYPE;
+            }
+            if ((need[i] & BLE_GAP_ADV_MON_F_UUID) &&
+                ble_gap_adv_mon_field_uuid(entry, type, val, len)) {
+                need[i] &= ~BLE_GAP_ADV_MON_F_UUID;
+            }
+            if ((need[i] & BLE_GAP_ADV_MON_F_MFG) &&
+                type == BLE_HS_ADV_TYPE_MFG_DATA &&
+                len >= entry->mfg_len &&
+                memcmp(val, entry->mfg, entry->mfg_len) == 0) {
+                need[i] &= ~BLE_GAP_ADV_MON_F_MFG;
+            }
+
+            if (need[i] == 0) {
+                pending &= ~(1UL << i);
+            }
+        }
+    }
+
+    return cand & ~pending;
+}
+
+static void
+ble_gap_adv_mon_deliver(struct ble_gap_adv_mon_desc *desc)
+{
+    struct ble_gap_event event;
+    ble_gap_event_fn *cb;
+    uint32_t matched;
+    void *cb_arg;
+    int i;
+
+    ble_hs_lock();
+
+    ble_gap_adv_mon_stats_cur.evaluated++;
+    matched = ble_gap_adv_mon_match(desc);
+    if (matched != 0) {
+        ble_gap_adv_mon_stats_cur.matched++;
+    }
+
+    ble_hs_unlock();
+
+    for (i = 0; matched != 0; i++) {
+        if (!(matched & (1UL << i))) {
+            continue;
+        }
+        matched &= ~(1UL << i);
+
+        /* The filter may have been removed by a previous callback */
+        ble_hs_lock();
+        if (ble_gap_adv_mon_used & (1UL << i)) {
+            ble_gap_adv_mon_entries[i].hits++;
+            cb = ble_gap_adv_mon_entries[i].cb;
+            cb_arg = ble_gap_adv_mon_entries[i].cb_arg;
+        } else {
+            cb = NULL;
+            cb_arg = NULL;
+        }
+        ble_hs_unlock();
+
+        if (cb != NULL) {
+            memset(&event, 0, sizeof(event));
+            event.type = BLE_GAP_EVENT_ADV_MON;
+            event.adv_mon = *desc;
+            event.adv_mon.filter_id = i;
+            cb(&event, cb_arg);
+        }
+    }
+}
+
+static int
+ble_gap_adv_mon_active(void)
+{
+    if (ble_gap_adv_mon_used == 0) {
+        return 0;
+    }
+
+    ble_gap_adv_mon_stats_cur.rx_reports++;
+
+    return 1;
+}
+
+int
+ble_gap_adv_mon_rx_adv_report(const struct ble_gap_disc_desc *desc)
+{
+    struct ble_gap_adv_mon_desc mon;
+
+    if (!ble_gap_adv_mon_active()) {
+        return BLE_HS_ENOENT;
+    }
+
+    memset(&mon, 0, sizeof(mon));
+    mon.props = BLE_HCI_ADV_LEGACY_MASK;
+    mon.legacy_event_type = desc->event_type;
+    mon.addr = desc->addr;
+    mon.rssi = desc->rssi;
+    mon.tx_power = 127;
+    mon.sid = 0xff;
+    mon.prim_phy = BLE_HCI_LE_PHY_1M;
+    mon.length_data = desc->length_data;
+    mon.data = desc->data;
+
+    ble_gap_adv_mon_deliver(&mon);
+
+    return 0;
+}
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+static struct ble_gap_adv_mon_reasm *
+ble_gap_adv_mon_reasm_find(const ble_addr_t *addr, uint8_t sid)
+{
+    struct ble_gap_adv_mon_reasm *slot;
+    int i;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_GAP_ADV_MON_REASM_SLOTS); i++) {
+        slot = &ble_gap_adv_mon_reasm[i];
+        if (slot->used && slot->desc.sid == sid &&
+            ble_addr_cmp(&slot->desc.addr, addr) == 0) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static struct ble_gap_adv_mon_discard *
+ble_gap_adv_mon_discard_find(const ble_addr_t *addr, uint8_t sid)
+{
+    struct ble_gap_adv_mon_discard *dis;
+    int i;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_GAP_ADV_MON_REASM_SLOTS); i++) {
+        dis = &ble_gap_adv_mon_discard[i];
+        if (dis->used && dis->sid == sid &&
+            ble_addr_cmp(&dis->addr, addr) == 0) {
+            return dis;
+        }
+    }
+
+    return NULL;
+}
+
+/* Records an evicted reassembly; replaces the oldest record if all are used */
+static void
+ble_gap_adv_mon_discard_add(const struct ble_gap_adv_mon_desc *desc)
+{
+    struct ble_gap_adv_mon_discard *dis;
+
+    dis = &ble_gap_adv_mon_discard[ble_gap_adv_mon_discard_next];
+    ble_gap_adv_mon_discard_next = (ble_gap_adv_mon_discard_next + 1) %
+                                   MYNEWT_VAL(BLE_GAP_ADV_MON_REASM_SLOTS);
+
+    dis->addr = desc->addr;
+    dis->sid = desc->sid;
+    dis->used = 1;
+}
+
+static struct ble_gap_adv_mon_reasm *
+ble_gap_adv_mon_reasm_alloc(void)
+{
+    struct ble_gap_adv_mon_reasm *oldest;
+    struct ble_gap_adv_mon_reasm *slot;
+    int i;
+
+    oldest = NULL;
+    for (i = 0; i < MYNEWT_VAL(BLE_GAP_ADV_MON_REASM_SLOTS); i++) {
+        slot = &ble_gap_adv_mon_reasm[i];
+        if (!slot->used) {
+            return slot;
+        }
+        if (oldest == NULL ||
+            (int32_t)(slot->age - oldest->age) < 0) {
+            oldest = slot;
+        }
+    }
+
+    ble_gap_adv_mon_stats_cur.evicted++;
+    ble_gap_adv_mon_discard_add(&oldest->desc);
+
+    return oldest;
+}
+
+static void
+ble_gap_adv_mon_reasm_append(struct ble_gap_adv_mon_reasm *slot,
+                             const struct ble_gap_ext_disc_desc *desc)
+{
+    uint16_t len;
+
+    len = desc->length_data;
+    if (slot->desc.length_data + len > sizeof(slot->buf)) {
+        len = sizeof(slot->buf) - slot->desc.length_data;
+        if (!slot->desc.truncated) {
+            slot->desc.truncated = 1;
+            ble_gap_adv_mon_stats_cur.truncated++;
+        }
+    }
+
+    memcpy(slot->buf + slot->desc.length_data, desc->data, len);
+    slot->desc.length_data += len;
+    slot->age = ble_gap_adv_mon_reasm_age++;
+}
+
+int
+ble_gap_adv_mon_rx_ext_adv_report(const struct ble_gap_ext_disc_desc *desc)
+{
+    struct ble_gap_adv_mon_discard *dis;
+    struct ble_gap_adv_mon_reasm *slot;
+    struct ble_gap_adv_mon_desc mon;
+    uint32_t cand;
+
+    if (!ble_gap_adv_mon_active()) {
+        return BLE_HS_ENOENT;
+    }
+
+    slot = NULL;
+    if (!(desc->props & BLE_HCI_ADV_LEGACY_MASK)) {
+        slot = ble_gap_adv_mon_reasm_find(&desc->addr, desc->sid);
+        if (slot == NULL) {
+            dis = ble_gap_adv_mon_discard_find(&desc->addr, desc->sid);
+            if (dis != NULL) {
+                /* Rest of an evicted report; the next one starts afresh */
+                if (desc->data_status !=
+                    BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+                    dis->used = 0;
+                }
+                return 0;
+            }
+        }
+    }
+
+    if (slot == NULL) {
+        /* Fragments from an address no filter accepts are dropped before
+         * anything gets buffered; the address is the same in all fragments
+         * of a report, unlike RSSI which is only checked at the end.
+         */
+        ble_hs_lock();
+        cand = ble_gap_adv_mon_addr_candidates(&desc->addr);
+        ble_hs_unlock();
+        if (cand == 0) {
+            return 0;
+        }
+    }
+
+    if (slot == NULL &&
+        desc->data_status != BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+        /* Complete in one report; evaluate it in place */
+        memset(&mon, 0, sizeof(mon));
+        mon.props = desc->props;
+        mon.legacy_event_type = desc->legacy_event_type;
+        mon.truncated =
+            desc->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_TRUNCATED;
+        mon.addr = desc->addr;
+        mon.rssi = desc->rssi;
+        mon.tx_power = desc->tx_power;
+        mon.sid = desc->sid;
+        mon.prim_phy = desc->prim_phy;
+        mon.sec_phy = desc->sec_phy;
+        mon.length_data = desc->length_data;
+        mon.data = desc->data;
+
+        ble_gap_adv_mon_deliver(&mon);
+        return 0;
+    }
+
+    if (slot == NULL) {
+        /* First fragment; the report is described by its header */
+        slot = ble_gap_adv_mon_reasm_alloc();
+        memset(&slot->desc, 0, sizeof(slot->desc));
+        slot->desc.props = desc->props;
+        slot->desc.addr = desc->addr;
+        slot->desc.rssi = desc->rssi;
+        slot->desc.tx_power = desc->tx_power;
+        slot->desc.sid = desc->sid;
+        slot->desc.prim_phy = desc->prim_phy;
+        slot->desc.sec_phy = desc->sec_phy;
+        slot->desc.data = slot->buf;
+        slot->used = 1;
+    }
+
+    ble_gap_adv_mon_reasm_append(slot, desc);
+
+    if (desc->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+        return 0;
+    }
+
+    if (desc->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_TRUNCATED) {
+        slot->desc.truncated = 1;
+    }
+
+    /* Free the slot first; its buffer is only reused by the next report */
+    slot->used = 0;
+    ble_gap_adv_mon_deliver(&slot->desc);
+
+    return 0;
+}
+
+void
+ble_gap_adv_mon_flush(void)
+{
+    int i;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_GAP_ADV_MON_REASM_SLOTS); i++) {
+        ble_gap_adv_mon_reasm[i].used = 0;
+        ble_gap_adv_mon_discard[i].used = 0;
+    }
+}
+#endif
+
+void
+ble_gap_adv_mon_init(void)
+{
+    memset(ble_gap_adv_mon_entries, 0, sizeof(ble_gap_adv_mon_entries));
+    ble_gap_adv_mon_used = 0;
+    ble_gap_adv_mon_any_addr = 0;
+    memset(ble_gap_adv_mon_ad_types, 0, sizeof(ble_gap_adv_mon_ad_types));
+    memset(&ble_gap_adv_mon_stats_cur, 0, sizeof(ble_gap_adv_mon_stats_cur));
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    memset(ble_gap_adv_mon_reasm, 0, sizeof(ble_gap_adv_mon_reasm));
+    ble_gap_adv_mon_reasm_age = 0;
+    memset(ble_gap_adv_mon_discard, 0, sizeof(ble_gap_adv_mon_discard));
+    ble_gap_adv_mon_discard_next = 0;
+#endif
+}
+
+#else
+
+int
+ble_gap_adv_mon_add(const struct ble_gap_adv_mon_filter *filter,
+                    ble_gap_event_fn *cb, void *cb_arg,
+                    uint8_t *out_filter_id)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_gap_adv_mon_remove(uint8_t filter_id)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_gap_adv_mon_hits(uint8_t filter_id, uint32_t *out_hits)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_gap_adv_mon_stats(struct ble_gap_adv_mon_stats *out_stats, int reset)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+#endif
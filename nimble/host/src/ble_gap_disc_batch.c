@@ -0,0 +1,562 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "syscfg/syscfg.h"
+#include "ble_hs_priv.h"
+
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS) && NIMBLE_BLE_SCAN
+
+#define BLE_GAP_DISC_BATCH_MAX          MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS)
+#define BLE_GAP_DISC_BATCH_DATA_SIZE    MYNEWT_VAL(BLE_GAP_DISC_BATCH_DATA_SIZE)
+
+#define BLE_GAP_DISC_BATCH_NONE         0xffff
+
+#define BLE_GAP_DISC_BATCH_RSSI_NONE    127
+
+/* Report continues an extended advertising data chain; never merged into */
+#define BLE_GAP_DISC_BATCH_F_CHAINED    0x01
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+#define BLE_GAP_DISC_BATCH_DESC         struct ble_gap_ext_disc_desc
+#else
+#define BLE_GAP_DISC_BATCH_DESC         struct ble_gap_disc_desc
+#endif
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+/* Advertiser whose data chain was still incomplete when a batch was flushed */
+struct ble_gap_disc_batch_chain {
+    ble_addr_t addr;
+    uint8_t props;
+    uint8_t legacy_event_type;
+    uint8_t sid;
+};
+#endif
+
+/* Bookkeeping of a buffered report, parallel to the reports array */
+struct ble_gap_disc_batch_slot {
+    /* Next older report in the same hash bucket */
+    uint16_t next;
+    /* Bytes of the data buffer reserved for the report */
+    uint8_t data_cap;
+    uint8_t flags;
+};
+
+/*
+ * The batch is only filled and delivered by the host task, so it is not
+ * protected by the host lock; ble_gap_disc_batch_set() refuses to touch it
+ * while a discovery procedure is in progress.
+ */
+static struct ble_gap_disc_batch_params ble_gap_disc_batch_params;
+static ble_npl_time_t ble_gap_disc_batch_itvl_ticks;
+static uint8_t ble_gap_disc_batch_enabled;
+static uint8_t ble_gap_disc_batch_delivering;
+
+static uint8_t ble_gap_disc_batch_exp_set;
+static ble_npl_time_t ble_gap_disc_batch_exp_os_ticks;
+
+static uint16_t ble_gap_disc_batch_num;
+static uint16_t ble_gap_disc_batch_data_len;
+
+static struct ble_gap_disc_batch_report
+    ble_gap_disc_batch_reports[BLE_GAP_DISC_BATCH_MAX];
+static struct ble_gap_disc_batch_slot
+    ble_gap_disc_batch_slots[BLE_GAP_DISC_BATCH_MAX];
+
+/* Most recent report in each bucket, keyed by advertiser address and SID */
+static uint16_t ble_gap_disc_batch_buckets[BLE_GAP_DISC_BATCH_MAX];
+
+static uint8_t ble_gap_disc_batch_data[BLE_GAP_DISC_BATCH_DATA_SIZE];
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+/*
+ * Chains split by a flush; their next fragment starts the new batch but is
+ * still marked as chained.
+ */
+static struct ble_gap_disc_batch_chain
+    ble_gap_disc_batch_chains[BLE_GAP_DISC_BATCH_MAX];
+static uint16_t ble_gap_disc_batch_num_chains;
+#endif
+
+/* Empties the batch; chains split by a flush are kept */
+static void
+ble_gap_disc_batch_clear(void)
+{
+    ble_gap_disc_batch_num = 0;
+    ble_gap_disc_batch_data_len = 0;
+    ble_gap_disc_batch_exp_set = 0;
+    memset(ble_gap_disc_batch_buckets, 0xff,
+           sizeof(ble_gap_disc_batch_buckets));
+}
+
+void
+ble_gap_disc_batch_reset(void)
+{
+    ble_gap_disc_batch_clear();
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    ble_gap_disc_batch_num_chains = 0;
+#endif
+}
+
+static uint16_t
+ble_gap_disc_batch_bucket(const BLE_GAP_DISC_BATCH_DESC *desc)
+{
+    uint32_t hash;
+    int i;
+
+    hash = desc->addr.type;
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    hash = hash * 31 + desc->sid;
+#endif
+    for (i = 0; i < BLE_DEV_ADDR_LEN; i++) {
+        hash = hash * 31 + desc->addr.val[i];
+    }
+
+    return hash % BLE_GAP_DISC_BATCH_MAX;
+}
+
+/* Checks if two reports are of the same type and from the same advertiser */
+static int
+ble_gap_disc_batch_same(const BLE_GAP_DISC_BATCH_DESC *a,
+                        const BLE_GAP_DISC_BATCH_DESC *b)
+{
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    if ((a->props != b->props) ||
+        (a->legacy_event_type != b->legacy_event_type) ||
+        (a->sid != b->sid)) {
+        return 0;
+    }
+#else
+    if (a->event_type != b->event_type) {
+        return 0;
+    }
+#endif
+
+    return ble_addr_cmp(&a->addr, &b->addr) == 0;
+}
+
+static uint16_t
+ble_gap_disc_batch_find(const BLE_GAP_DISC_BATCH_DESC *desc, uint16_t bucket)
+{
+    uint16_t idx;
+
+    for (idx = ble_gap_disc_batch_buckets[bucket];
+         idx != BLE_GAP_DISC_BATCH_NONE;
+         idx = ble_gap_disc_batch_slots[idx].next) {
+
+        if (ble_gap_disc_batch_same(&ble_gap_disc_batch_reports[idx].desc,
+                                    desc)) {
+            return idx;
+        }
+    }
+
+    return BLE_GAP_DISC_BATCH_NONE;
+}
+
+static void
+ble_gap_disc_batch_rssi(struct ble_gap_disc_batch_report *rpt, int8_t rssi)
+{
+    if (rssi == BLE_GAP_DISC_BATCH_RSSI_NONE) {
+        return;
+    }
+
+    if ((rpt->rssi_min == BLE_GAP_DISC_BATCH_RSSI_NONE) ||
+        (rssi < rpt->rssi_min)) {
+        rpt->rssi_min = rssi;
+    }
+    if ((rpt->rssi_max == BLE_GAP_DISC_BATCH_RSSI_NONE) ||
+        (rssi > rpt->rssi_max)) {
+        rpt->rssi_max = rssi;
+    }
+}
+
+/* Reserves room for a report's data; NULL if the data buffer is full */
+static uint8_t *
+ble_gap_disc_batch_alloc(uint8_t len)
+{
+    uint8_t *data;
+
+    if (ble_gap_disc_batch_data_len + len > BLE_GAP_DISC_BATCH_DATA_SIZE) {
+        return NULL;
+    }
+
+    data = &ble_gap_disc_batch_data[ble_gap_disc_batch_data_len];
+    ble_gap_disc_batch_data_len += len;
+
+    return data;
+}
+
+/*
+ * Merges a report into an earlier one of the same type from the same
+ * advertiser.  The data is updated in place if it fits where the earlier
+ * data is.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOMEM if there is no room for the
+ *                                  data.
+ */
+static int
+ble_gap_disc_batch_merge(uint16_t idx, const BLE_GAP_DISC_BATCH_DESC *desc)
+{
+    struct ble_gap_disc_batch_report *rpt;
+    struct ble_gap_disc_batch_slot *slot;
+    uint8_t *data;
+
+    rpt = &ble_gap_disc_batch_reports[idx];
+    slot = &ble_gap_disc_batch_slots[idx];
+
+    data = (uint8_t *)rpt->desc.data;
+    if (desc->length_data > slot->data_cap) {
+        data = ble_gap_disc_batch_alloc(desc->length_data);
+        if (data == NULL) {
+            return BLE_HS_ENOMEM;
+        }
+        slot->data_cap = desc->length_data;
+    }
+
+    if (desc->length_data > 0) {
+        memcpy(data, desc->data, desc->length_data);
+    }
+
+    rpt->desc = *desc;
+    rpt->desc.data = data;
+    rpt->count++;
+    ble_gap_disc_batch_rssi(rpt, desc->rssi);
+
+    return 0;
+}
+
+static int
+ble_gap_disc_batch_add(const BLE_GAP_DISC_BATCH_DESC *desc, uint16_t bucket,
+                       uint8_t flags)
+{
+    struct ble_gap_disc_batch_report *rpt;
+    struct ble_gap_disc_batch_slot *slot;
+    uint16_t idx;
+    uint8_t *data;
+
+    if (ble_gap_disc_batch_num >= BLE_GAP_DISC_BATCH_MAX) {
+        return BLE_HS_ENOMEM;
+    }
+
+    data = ble_gap_disc_batch_alloc(desc->length_data);
+    if (data == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    if (desc->length_data > 0) {
+        memcpy(data, desc->data, desc->length_data);
+    }
+
+    idx = ble_gap_disc_batch_num++;
+    rpt = &ble_gap_disc_batch_reports[idx];
+    slot = &ble_gap_disc_batch_slots[idx];
+
+    rpt->desc = *desc;
+    rpt->desc.data = data;
+    rpt->count = 1;
+    rpt->rssi_min = BLE_GAP_DISC_BATCH_RSSI_NONE;
+    rpt->rssi_max = BLE_GAP_DISC_BATCH_RSSI_NONE;
+    ble_gap_disc_batch_rssi(rpt, desc->rssi);
+
+    slot->data_cap = desc->length_data;
+    slot->flags = flags;
+    slot->next = ble_gap_disc_batch_buckets[bucket];
+    ble_gap_disc_batch_buckets[bucket] = idx;
+
+    if ((idx == 0) && (ble_gap_disc_batch_params.flush_itvl_ms != 0)) {
+        ble_gap_disc_batch_exp_os_ticks = ble_npl_time_get() +
+                                          ble_gap_disc_batch_itvl_ticks;
+        ble_gap_disc_batch_exp_set = 1;
+        ble_hs_timer_resched();
+    }
+
+    return 0;
+}
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+/* Checks if a buffered report holds complete data on its own */
+static int
+ble_gap_disc_batch_whole(uint16_t idx)
+{
+    return (ble_gap_disc_batch_reports[idx].desc.data_status ==
+            BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE) &&
+           !(ble_gap_disc_batch_slots[idx].flags &
+             BLE_GAP_DISC_BATCH_F_CHAINED);
+}
+
+static int
+ble_gap_disc_batch_chain_same(const struct ble_gap_disc_batch_chain *chain,
+                              const struct ble_gap_ext_disc_desc *desc)
+{
+    return (chain->props == desc->props) &&
+           (chain->legacy_event_type == desc->legacy_event_type) &&
+           (chain->sid == desc->sid) &&
+           (ble_addr_cmp(&chain->addr, &desc->addr) == 0);
+}
+
+/*
+ * Remembers the chains the buffered reports leave open, so that they stay
+ * chained across the flush.
+ */
+static void
+ble_gap_disc_batch_chains_save(void)
+{
+    struct ble_gap_disc_batch_chain *chain;
+    const struct ble_gap_ext_disc_desc *desc;
+    uint16_t idx;
+
+    /* Chains saved by earlier flushes and not continued yet are kept */
+    for (idx = 0; idx < ble_gap_disc_batch_num; idx++) {
+        desc = &ble_gap_disc_batch_reports[idx].desc;
+
+        /* Only the advertiser's most recent fragment tells */
+        if ((desc->data_status != BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) ||
+            (ble_gap_disc_batch_find(desc, ble_gap_disc_batch_bucket(desc)) !=
+             idx)) {
+            continue;
+        }
+
+        if (ble_gap_disc_batch_num_chains >= BLE_GAP_DISC_BATCH_MAX) {
+            break;
+        }
+
+        chain = &ble_gap_disc_batch_chains[ble_gap_disc_batch_num_chains++];
+        chain->addr = desc->addr;
+        chain->props = desc->props;
+        chain->legacy_event_type = desc->legacy_event_type;
+        chain->sid = desc->sid;
+    }
+}
+
+/* Checks if a report continues a chain left open by a flush */
+static int
+ble_gap_disc_batch_chain_take(const struct ble_gap_ext_disc_desc *desc)
+{
+    uint16_t i;
+
+    for (i = 0; i < ble_gap_disc_batch_num_chains; i++) {
+        if (ble_gap_disc_batch_chain_same(&ble_gap_disc_batch_chains[i],
+                                          desc)) {
+            ble_gap_disc_batch_chains[i] =
+                ble_gap_disc_batch_chains[--ble_gap_disc_batch_num_chains];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+static int
+ble_gap_disc_batch_rx(const BLE_GAP_DISC_BATCH_DESC *desc)
+{
+    uint16_t bucket;
+    uint16_t idx;
+    uint8_t flags;
+    int rc;
+
+    if (!ble_gap_disc_batch_enabled) {
+        return BLE_HS_ENOENT;
+    }
+
+    bucket = ble_gap_disc_batch_bucket(desc);
+    idx = ble_gap_disc_batch_find(desc, bucket);
+    flags = 0;
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    if (ble_gap_disc_batch_chain_take(desc)) {
+        flags = BLE_GAP_DISC_BATCH_F_CHAINED;
+    }
+#endif
+
+    if (idx != BLE_GAP_DISC_BATCH_NONE) {
+#if MYNEWT_VAL(BLE_EXT_ADV)
+        if (ble_gap_disc_batch_reports[idx].desc.data_status ==
+            BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+            flags = BLE_GAP_DISC_BATCH_F_CHAINED;
+        } else if (ble_gap_disc_batch_params.dedup &&
+                   ble_gap_disc_batch_whole(idx) &&
+                   (desc->data_status ==
+                    BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE)) {
+            rc = ble_gap_disc_batch_merge(idx, desc);
+            if (rc == 0) {
+                return 0;
+            }
+        }
+#else
+        if (ble_gap_disc_batch_params.dedup) {
+            rc = ble_gap_disc_batch_merge(idx, desc);
+            if (rc == 0) {
+                return 0;
+            }
+        }
+#endif
+    }
+
+    rc = ble_gap_disc_batch_add(desc, bucket, flags);
+    if (rc != 0) {
+        /* Full; make room by delivering what is buffered so far */
+        ble_gap_disc_batch_flush();
+
+        /* The application may have stopped discovery or batching */
+        if (!ble_gap_disc_active() || !ble_gap_disc_batch_enabled) {
+            return 0;
+        }
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+        /* The flush may have split this report's chain */
+        if (ble_gap_disc_batch_chain_take(desc)) {
+            flags = BLE_GAP_DISC_BATCH_F_CHAINED;
+        }
+#endif
+
+        bucket = ble_gap_disc_batch_bucket(desc);
+        rc = ble_gap_disc_batch_add(desc, bucket, flags);
+        BLE_HS_DBG_ASSERT(rc == 0);
+    }
+
+    if (ble_gap_disc_batch_num >= ble_gap_disc_batch_params.max_reports) {
+        ble_gap_disc_batch_flush();
+    }
+
+    return 0;
+}
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+int
+ble_gap_disc_batch_rx_ext_adv_report(const struct ble_gap_ext_disc_desc *desc)
+{
+    return ble_gap_disc_batch_rx(desc);
+}
+#else
+int
+ble_gap_disc_batch_rx_adv_report(const struct ble_gap_disc_desc *desc)
+{
+    return ble_gap_disc_batch_rx(desc);
+}
+#endif
+
+int
+ble_gap_disc_batch_flush(void)
+{
+    if (ble_gap_disc_batch_delivering) {
+        return 0;
+    }
+
+    if ((ble_gap_disc_batch_num > 0) && ble_gap_disc_active()) {
+        ble_gap_disc_batch_delivering = 1;
+        ble_gap_disc_batch_report(ble_gap_disc_batch_reports,
+                                  ble_gap_disc_batch_num);
+        ble_gap_disc_batch_delivering = 0;
+    }
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    ble_gap_disc_batch_chains_save();
+#endif
+    ble_gap_disc_batch_clear();
+
+    return 0;
+}
+
+/**
+ * Delivers the batch if its flush interval elapsed.
+ *
+ * @return                      The number of ticks until this function should
+ *                                  be called again.
+ */
+int32_t
+ble_gap_disc_batch_timer(void)
+{
+    ble_npl_stime_t ticks;
+
+    if (!ble_gap_disc_batch_exp_set) {
+        return BLE_HS_FOREVER;
+    }
+
+    ticks = ble_gap_disc_batch_exp_os_ticks - ble_npl_time_get();
+    if (ticks > 0) {
+        return ticks;
+    }
+
+    ble_gap_disc_batch_flush();
+
+    return BLE_HS_FOREVER;
+}
+
+int
+ble_gap_disc_batch_set(const struct ble_gap_disc_batch_params *params)
+{
+    int rc;
+
+    ble_hs_lock();
+
+    if (ble_gap_disc_active()) {
+        rc = BLE_HS_EBUSY;
+        goto done;
+    }
+
+    if (params == NULL) {
+        ble_gap_disc_batch_enabled = 0;
+    } else {
+        ble_gap_disc_batch_params = *params;
+        if ((params->max_reports == 0) ||
+            (params->max_reports > BLE_GAP_DISC_BATCH_MAX)) {
+            ble_gap_disc_batch_params.max_reports = BLE_GAP_DISC_BATCH_MAX;
+        }
+        ble_gap_disc_batch_itvl_ticks =
+            ble_npl_time_ms_to_ticks32(params->flush_itvl_ms);
+        ble_gap_disc_batch_enabled = 1;
+    }
+
+    ble_gap_disc_batch_reset();
+    rc = 0;
+
+done:
+    ble_hs_unlock();
+
+    return rc;
+}
+
+void
+ble_gap_disc_batch_init(void)
+{
+    memset(&ble_gap_disc_batch_params, 0, sizeof(ble_gap_disc_batch_params));
+    ble_gap_disc_batch_itvl_ticks = 0;
+    ble_gap_disc_batch_enabled = 0;
+    ble_gap_disc_batch_delivering = 0;
+    ble_gap_disc_batch_reset();
+}
+
+#else
+
+int
+ble_gap_disc_batch_set(const struct ble_gap_disc_batch_params *params)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_gap_disc_batch_flush(void)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+#endif
@@ -94,6 +94,29 @@ void ble_gap_rx_biginfo_adv_rpt(const struct ble_hci_ev_le_subev_biginfo_adv_rep
 void ble_gap_rx_scan_req_rcvd(const struct ble_hci_ev_le_subev_scan_req_rcvd *ev);
 #endif
 void ble_gap_rx_adv_report(struct ble_gap_disc_desc *desc);
+
+#if MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS) && NIMBLE_BLE_SCAN
+void ble_gap_adv_mon_init(void);
+int ble_gap_adv_mon_rx_adv_report(const struct ble_gap_disc_desc *desc);
+#if MYNEWT_VAL(BLE_EXT_ADV)
+int ble_gap_adv_mon_rx_ext_adv_report(const struct ble_gap_ext_disc_desc *desc);
+void ble_gap_adv_mon_flush(void);
+#endif
+#endif
+
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_REPORTS) && NIMBLE_BLE_SCAN
+void ble_gap_disc_batch_init(void);
+void ble_gap_disc_batch_reset(void);
+int32_t ble_gap_disc_batch_timer(void);
+#if MYNEWT_VAL(BLE_EXT_ADV)
+int ble_gap_disc_batch_rx_ext_adv_report(const struct ble_gap_ext_disc_desc *desc);
+#else
+int ble_gap_disc_batch_rx_adv_report(const struct ble_gap_disc_desc *desc);
+#endif
+void ble_gap_disc_batch_report(const struct ble_gap_disc_batch_report *reports,
+                               uint16_t num_reports);
+#endif
+
 void ble_gap_rx_rd_rem_sup_feat_complete(const struct ble_hci_ev_le_subev_rd_rem_used_feat *ev);
 #if MYNEWT_VAL(BLE_CONN_SUBRATING)
 void ble_gap_rx_subrate_change(const struct ble_hci_ev_le_subev_subrate_change *ev);
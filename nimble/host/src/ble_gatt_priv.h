@@ -190,6 +190,7 @@ struct ble_gatt_resources {
 int ble_gatts_rx_indicate_ack(uint16_t conn_handle, uint16_t chr_val_handle);
 int ble_gatts_send_next_indicate(uint16_t conn_handle);
 void ble_gatts_tx_notifications(void);
+void ble_gatts_fanout_resume(void);
 void ble_gatts_bonding_established(uint16_t conn_handle);
 void ble_gatts_bonding_restored(uint16_t conn_handle);
 void ble_gatts_connection_broken(uint16_t conn_handle);
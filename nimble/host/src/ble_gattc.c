@@ -55,6 +55,7 @@
 #include <errno.h>
 #include <string.h>
 #include "os/os_mempool.h"
+#include "os/util.h"
 #include "nimble/ble.h"
 #include "host/ble_gatt.h"
 #include "host/ble_uuid.h"
@@ -105,9 +106,10 @@
 
 /** Represents an in-progress GATT procedure. */
 struct ble_gattc_proc {
-    STAILQ_ENTRY(ble_gattc_proc) next;
+    TAILQ_ENTRY(ble_gattc_proc) next;
 
     uint32_t exp_os_ticks;
+    struct ble_hs_deadline exp_dl;
     uint16_t conn_handle;
     uint16_t cid;
     uint8_t op;
@@ -224,7 +226,7 @@ struct ble_gattc_proc {
     };
 };
 
-STAILQ_HEAD(ble_gattc_proc_list, ble_gattc_proc);
+TAILQ_HEAD(ble_gattc_proc_list, ble_gattc_proc);
 
 /**
  * Error functions - these handle an incoming ATT error response and apply it
@@ -437,6 +439,8 @@ static struct ble_gattc_proc_list ble_gattc_procs;
  */
 static ble_npl_time_t ble_gattc_resume_at;
 
+static ble_hs_deadline_fn ble_gattc_proc_exp;
+
 /* Statistics. */
 STATS_SECT_DECL(ble_gattc_stats) ble_gattc_stats;
 STATS_NAME_START(ble_gattc_stats)
@@ -489,7 +493,7 @@ ble_gattc_dbg_assert_proc_not_inserted(struct ble_gattc_proc *proc)
 
     ble_hs_lock();
 
-    STAILQ_FOREACH(cur, &ble_gattc_procs, next) {
+    TAILQ_FOREACH(cur, &ble_gattc_procs, next) {
         BLE_HS_DBG_ASSERT(cur != proc);
     }
 
@@ -759,7 +763,9 @@ ble_gattc_proc_insert(struct ble_gattc_proc *proc)
     ble_gattc_dbg_assert_proc_not_inserted(proc);
 
     ble_hs_lock();
-    STAILQ_INSERT_TAIL(&ble_gattc_procs, proc, next);
+    TAILQ_INSERT_TAIL(&ble_gattc_procs, proc, next);
+    ble_hs_deadline_arm(&proc->exp_dl, proc->exp_os_ticks,
+                        ble_gattc_proc_exp);
     ble_hs_unlock();
 }
 
@@ -919,33 +925,6 @@ ble_gattc_proc_matches_conn_cid_op(struct ble_gattc_proc *proc, void *arg)
     return 1;
 }
 
-struct ble_gattc_criteria_exp {
-    ble_npl_time_t now;
-    int32_t next_exp_in;
-};
-
-static int
-ble_gattc_proc_matches_expired(struct ble_gattc_proc *proc, void *arg)
-{
-    struct ble_gattc_criteria_exp *criteria;
-    int32_t time_diff;
-
-    criteria = arg;
-
-    time_diff = proc->exp_os_ticks - criteria->now;
-
-    if (time_diff <= 0) {
-        /* Procedure is expired. */
-        return 1;
-    }
-
-    /* Procedure isn't expired; determine if it is the next to expire. */
-    if (time_diff < criteria->next_exp_in) {
-        criteria->next_exp_in = time_diff;
-    }
-    return 0;
-}
-
 struct ble_gattc_criteria_conn_rx_entry {
     uint16_t conn_handle;
     uint16_t cid;
@@ -962,8 +941,8 @@ ble_gattc_proc_matches_conn_rx_entry(struct ble_gattc_proc *proc, void *arg)
     criteria = arg;
 
     if (criteria->conn_handle != BLE_HS_CONN_HANDLE_NONE &&
-        criteria->conn_handle != proc->conn_handle &&
-        criteria->cid != proc->cid) {
+        (criteria->conn_handle != proc->conn_handle ||
+         criteria->cid != proc->cid)) {
 
         return 0;
     }
@@ -980,30 +959,25 @@ ble_gattc_extract(ble_gattc_match_fn *cb, void *arg, int max_procs,
                   struct ble_gattc_proc_list *dst_list)
 {
     struct ble_gattc_proc *proc;
-    struct ble_gattc_proc *prev;
     struct ble_gattc_proc *next;
     int num_extracted;
 
     /* Only the parent task is allowed to remove entries from the list. */
     BLE_HS_DBG_ASSERT(ble_hs_is_parent_task());
 
-    STAILQ_INIT(dst_list);
+    TAILQ_INIT(dst_list);
     num_extracted = 0;
 
     ble_hs_lock();
 
-    prev = NULL;
-    proc = STAILQ_FIRST(&ble_gattc_procs);
+    proc = TAILQ_FIRST(&ble_gattc_procs);
     while (proc != NULL) {
-        next = STAILQ_NEXT(proc, next);
+        next = TAILQ_NEXT(proc, next);
 
         if (cb(proc, arg)) {
-            if (prev == NULL) {
-                STAILQ_REMOVE_HEAD(&ble_gattc_procs, next);
-            } else {
-                STAILQ_REMOVE_AFTER(&ble_gattc_procs, prev, next);
-            }
-            STAILQ_INSERT_TAIL(dst_list, proc, next);
+            TAILQ_REMOVE(&ble_gattc_procs, proc, next);
+            ble_hs_deadline_disarm(&proc->exp_dl);
+            TAILQ_INSERT_TAIL(dst_list, proc, next);
 
             if (max_procs > 0) {
                 num_extracted++;
@@ -1011,8 +985,6 @@ ble_gattc_extract(ble_gattc_match_fn *cb, void *arg, int max_procs,
                     break;
                 }
             }
-        } else {
-            prev = proc;
         }
 
         proc = next;
@@ -1027,7 +999,7 @@ ble_gattc_extract_one(ble_gattc_match_fn *cb, void *arg)
     struct ble_gattc_proc_list dst_list;
 
     ble_gattc_extract(cb, arg, 1, &dst_list);
-    return STAILQ_FIRST(&dst_list);
+    return TAILQ_FIRST(&dst_list);
 }
 
 static void
@@ -1062,7 +1034,7 @@ ble_gattc_extract_first_by_conn_cid_op(uint16_t conn_handle, uint16_t cid, uint8
     struct ble_gattc_proc_list dst_list;
 
     ble_gattc_extract_by_conn_cid_op(conn_handle, cid, op, 1, &dst_list);
-    return STAILQ_FIRST(&dst_list);
+    return TAILQ_FIRST(&dst_list);
 }
 
 static int
@@ -1077,24 +1049,6 @@ ble_gattc_extract_stalled(struct ble_gattc_proc_list *dst_list)
     ble_gattc_extract(ble_gattc_proc_matches_stalled, NULL, 0, dst_list);
 }
 
-/**
- * @return                      The number of ticks until the next expiration
- *                                  occurs.
- */
-static int32_t
-ble_gattc_extract_expired(struct ble_gattc_proc_list *dst_list)
-{
-    struct ble_gattc_criteria_exp criteria;
-
-    criteria.now = ble_npl_time_get();
-    criteria.next_exp_in = BLE_HS_FOREVER;
-
-    STAILQ_INIT(dst_list);
-    ble_gattc_extract(ble_gattc_proc_matches_expired, &criteria, 0, dst_list);
-
-    return criteria.next_exp_in;
-}
-
 static struct ble_gattc_proc *
 ble_gattc_extract_with_rx_entry(uint16_t conn_handle, uint16_t cid,
                                 const void *rx_entries, int num_rx_entries,
@@ -1157,11 +1111,11 @@ ble_gattc_fail_procs(uint16_t conn_handle, uint8_t op, int status)
     /* Notify application of failed procedures and free the corresponding proc
      * entries.
      */
-    while ((proc = STAILQ_FIRST(&temp_list)) != NULL) {
+    while ((proc = TAILQ_FIRST(&temp_list)) != NULL) {
         err_cb = ble_gattc_err_dispatch_get(proc->op);
         err_cb(proc, status, 0);
 
-        STAILQ_REMOVE_HEAD(&temp_list, next);
+        TAILQ_REMOVE(&temp_list, proc, next);
         ble_gattc_proc_free(proc);
     }
 }
@@ -1179,7 +1133,12 @@ ble_gattc_resume_procs(void)
 
     ble_gattc_extract_stalled(&stall_list);
 
-    STAILQ_FOREACH(proc, &stall_list, next) {
+    /* Each proc is taken off the list first; resuming it may put it back
+     * into the main list or free it.
+     */
+    while ((proc = TAILQ_FIRST(&stall_list)) != NULL) {
+        TAILQ_REMOVE(&stall_list, proc, next);
+
         resume_cb = ble_gattc_resume_dispatch_get(proc->op);
         BLE_HS_DBG_ASSERT(resume_cb != NULL);
 
@@ -1225,47 +1184,48 @@ ble_gattc_proc_timeout(struct ble_gattc_proc *proc)
 }
 
 /**
- * Times out expired GATT client procedures.
- *
- * @return                      The number of ticks until this function should
- *                                  be called again.
+ * Called from the host deadline heap when a procedure's unresponsive timer
+ * expires.  Terminates the connection the procedure belongs to.
  */
-int32_t
-ble_gattc_timer(void)
+static void
+ble_gattc_proc_exp(struct ble_hs_deadline *dl)
 {
-    struct ble_gattc_proc_list exp_list;
     struct ble_gattc_proc *proc;
-    int32_t ticks_until_resume;
-    int32_t ticks_until_exp;
 
-    /* Remove timed-out procedures from the main list and insert them into a
-     * temporary list.  This function also calculates the number of ticks until
-     * the next expiration will occur.
-     */
-    ticks_until_exp = ble_gattc_extract_expired(&exp_list);
+    proc = CONTAINER_OF(dl, struct ble_gattc_proc, exp_dl);
 
-    /* Terminate the connection associated with each timed-out procedure. */
-    while ((proc = STAILQ_FIRST(&exp_list)) != NULL) {
-        STATS_INC(ble_gattc_stats, proc_timeout);
+    ble_hs_lock();
+    TAILQ_REMOVE(&ble_gattc_procs, proc, next);
+    ble_hs_unlock();
 
-        ble_gattc_proc_timeout(proc);
+    STATS_INC(ble_gattc_stats, proc_timeout);
 
-        ble_gap_terminate(proc->conn_handle, BLE_ERR_REM_USER_CONN_TERM);
+    ble_gattc_proc_timeout(proc);
 
-        STAILQ_REMOVE_HEAD(&exp_list, next);
-        ble_gattc_proc_free(proc);
-    }
+    ble_gap_terminate(proc->conn_handle, BLE_ERR_REM_USER_CONN_TERM);
+
+    ble_gattc_proc_free(proc);
+}
+
+/**
+ * Resumes stalled GATT client procedures.  Procedure timeouts are handled by
+ * the host deadline heap; see ble_gattc_proc_exp().
+ *
+ * @return                      The number of ticks until this function should
+ *                                  be called again.
+ */
+int32_t
+ble_gattc_timer(void)
+{
+    int32_t ticks_until_resume;
 
-    /* If there are stalled procedures, the GATT client will need to wake up to
-     * resume them.
-     */
     ticks_until_resume = ble_gattc_ticks_until_resume();
     if (ticks_until_resume == 0) {
         ble_gattc_resume_procs();
         ticks_until_resume = ble_gattc_ticks_until_resume();
     }
 
-    return min(ticks_until_exp, ticks_until_resume);
+    return ticks_until_resume;
 }
 
 /**
@@ -5144,7 +5104,7 @@ ble_gattc_connection_broken(uint16_t conn_handle)
 int
 ble_gattc_any_jobs(void)
 {
-    return !STAILQ_EMPTY(&ble_gattc_procs);
+    return !TAILQ_EMPTY(&ble_gattc_procs);
 }
 
 int
@@ -5152,7 +5112,7 @@ ble_gattc_init(void)
 {
     int rc;
 
-    STAILQ_INIT(&ble_gattc_procs);
+    TAILQ_INIT(&ble_gattc_procs);
 
     if (MYNEWT_VAL(BLE_GATT_MAX_PROCS) > 0) {
         rc = os_mempool_init(&ble_gattc_proc_pool,
@@ -65,6 +65,44 @@ struct ble_gatts_clt_cfg {
 static struct ble_gatts_clt_cfg *ble_gatts_clt_cfgs;
 static int ble_gatts_num_cfgable_chrs;
 
+#if MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT)
+struct ble_gatts_fanout {
+    /** When the value was first marked updated; valid if pending is set. */
+    ble_npl_time_t updated_at;
+    uint8_t pending;
+    uint8_t sent;
+
+    struct ble_gatts_fanout_stats stats;
+};
+
+/** Fan-out state, indexed like ble_gatts_clt_cfgs. */
+static struct ble_gatts_fanout *ble_gatts_fanouts;
+
+/** Set when a fan-out stopped early for lack of controller buffers. */
+static uint8_t ble_gatts_fanout_deferred;
+
+/**
+ * User header of a characteristic value shared by several peers.  The value
+ * is freed when the last reference to it is.
+ */
+struct ble_gatts_fanout_payload {
+    uint16_t refcnt;
+};
+
+/**
+ * A reference is an mbuf whose data points into one mbuf of the shared
+ * value; its own data buffer only holds a pointer to the value.
+ */
+#define BLE_GATTS_FANOUT_REF_BLOCK_SZ \
+    (sizeof(struct os_mbuf) + sizeof(struct os_mbuf *))
+
+static os_membuf_t ble_gatts_fanout_ref_mem[
+    OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT_REFS),
+                    BLE_GATTS_FANOUT_REF_BLOCK_SZ)];
+static struct os_mempool_ext ble_gatts_fanout_ref_mempool;
+static struct os_mbuf_pool ble_gatts_fanout_ref_mbuf_pool;
+#endif
+
 STATS_SECT_DECL(ble_gatts_stats) ble_gatts_stats;
 STATS_NAME_START(ble_gatts_stats)
     STATS_NAME(ble_gatts_stats, svcs)
@@ -1166,6 +1204,12 @@ ble_gatts_free_mem(void)
     free(ble_gatts_clt_cfg_mem);
     ble_gatts_clt_cfg_mem = NULL;
 
+#if MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT)
+    free(ble_gatts_fanouts);
+    ble_gatts_fanouts = NULL;
+    ble_gatts_fanout_deferred = 0;
+#endif
+
     free(ble_gatts_svc_entries);
     ble_gatts_svc_entries = NULL;
 }
@@ -1250,6 +1294,15 @@ ble_gatts_start(void)
         goto done;
     }
 
+#if MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT)
+    ble_gatts_fanouts = calloc(ble_gatts_num_cfgable_chrs,
+                               sizeof *ble_gatts_fanouts);
+    if (ble_gatts_fanouts == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto done;
+    }
+#endif
+
     /* Fill the cache. */
     idx = 0;
     ha = NULL;
@@ -1306,19 +1359,12 @@ ble_gatts_conn_init(struct ble_gatts_conn *gatts_conn)
 
 
 /**
- * Schedules a notification or indication for the specified peer-CCCD pair.  If
- * the update should be sent immediately, it is indicated in the return code.
- *
- * @param conn                  The connection to schedule the update for.
- * @param clt_cfg               The client config entry corresponding to the
- *                                  peer and affected characteristic.
- *
- * @return                      The att_op of the update to send immediately,
- *                                  if any.  0 if nothing should get sent.
+ * Determines what command, if any, has to be sent to bring the specified peer
+ * up to date with a characteristic.  Does not modify the CCCD state.
  */
 static uint8_t
-ble_gatts_schedule_update(struct ble_hs_conn *conn,
-                          struct ble_gatts_clt_cfg *clt_cfg)
+ble_gatts_update_op(const struct ble_hs_conn *conn,
+                    const struct ble_gatts_clt_cfg *clt_cfg)
 {
     uint8_t att_op;
 
@@ -1346,6 +1392,28 @@ ble_gatts_schedule_update(struct ble_hs_conn *conn,
         att_op = 0;
     }
 
+    return att_op;
+}
+
+/**
+ * Schedules a notification or indication for the specified peer-CCCD pair.  If
+ * the update should be sent immediately, it is indicated in the return code.
+ *
+ * @param conn                  The connection to schedule the update for.
+ * @param clt_cfg               The client config entry corresponding to the
+ *                                  peer and affected characteristic.
+ *
+ * @return                      The att_op of the update to send immediately,
+ *                                  if any.  0 if nothing should get sent.
+ */
+static uint8_t
+ble_gatts_schedule_update(struct ble_hs_conn *conn,
+                          struct ble_gatts_clt_cfg *clt_cfg)
+{
+    uint8_t att_op;
+
+    att_op = ble_gatts_update_op(conn, clt_cfg);
+
     /* If we will be sending an update, clear the modified flag so that we
      * don't double-send.
      */
@@ -1481,18 +1549,42 @@ ble_gatts_rx_indicate_ack(uint16_t conn_handle, uint16_t chr_val_handle)
     return 0;
 }
 
+struct ble_gatts_chr_updated_arg {
+    uint16_t chr_val_handle;
+    int clt_cfg_idx;
+    int marked;
+};
+
+static int
+ble_gatts_chr_updated_conn(struct ble_hs_conn *conn, void *arg)
+{
+    struct ble_gatts_chr_updated_arg *upd;
+    struct ble_gatts_clt_cfg *clt_cfg;
+
+    upd = arg;
+
+    BLE_HS_DBG_ASSERT_EVAL(conn->bhc_gatt_svr.num_clt_cfgs >
+                           upd->clt_cfg_idx);
+    clt_cfg = conn->bhc_gatt_svr.clt_cfgs + upd->clt_cfg_idx;
+    BLE_HS_DBG_ASSERT_EVAL(clt_cfg->chr_val_handle == upd->chr_val_handle);
+
+    /* Mark the CCCD entry as modified. */
+    clt_cfg->flags |= BLE_GATTS_CLT_CFG_F_MODIFIED;
+    upd->marked = 1;
+
+    return 0;
+}
+
 void
 ble_gatts_chr_updated(uint16_t chr_val_handle)
 {
+    struct ble_gatts_chr_updated_arg arg;
     struct ble_store_value_cccd cccd_value;
     struct ble_store_key_cccd cccd_key;
-    struct ble_gatts_clt_cfg *clt_cfg;
     struct ble_hs_conn *conn;
-    int new_notifications = 0;
     int clt_cfg_idx;
     int persist;
     int rc;
-    int i;
 
     /* Determine if notifications or indications are allowed for this
      * characteristic.  If not, return immediately.
@@ -1505,28 +1597,22 @@ ble_gatts_chr_updated(uint16_t chr_val_handle)
 
     /*** Send notifications and indications to connected devices. */
 
-    ble_hs_lock();
-    for (i = 0; ; i++) {
-        /* XXX: This is inefficient when there are a lot of connections.
-         * Consider using a "foreach" function to walk the connection list.
-         */
-        conn = ble_hs_conn_find_by_idx(i);
-        if (conn == NULL) {
-            break;
-        }
-
-        BLE_HS_DBG_ASSERT_EVAL(conn->bhc_gatt_svr.num_clt_cfgs >
-                               clt_cfg_idx);
-        clt_cfg = conn->bhc_gatt_svr.clt_cfgs + clt_cfg_idx;
-        BLE_HS_DBG_ASSERT_EVAL(clt_cfg->chr_val_handle == chr_val_handle);
+    arg.chr_val_handle = chr_val_handle;
+    arg.clt_cfg_idx = clt_cfg_idx;
+    arg.marked = 0;
 
-        /* Mark the CCCD entry as modified. */
-        clt_cfg->flags |= BLE_GATTS_CLT_CFG_F_MODIFIED;
-        new_notifications = 1;
-    }
+    ble_hs_lock();
+    ble_hs_conn_foreach(ble_gatts_chr_updated_conn, &arg);
+#if MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT)
+    if (arg.marked && !ble_gatts_fanouts[clt_cfg_idx].pending) {
+        ble_gatts_fanouts[clt_cfg_idx].pending = 1;
+        ble_gatts_fanouts[clt_cfg_idx].sent = 0;
+        ble_gatts_fanouts[clt_cfg_idx].updated_at = ble_npl_time_get();
+    }
+#endif
     ble_hs_unlock();
 
-    if (new_notifications) {
+    if (arg.marked) {
         ble_hs_notifications_sched();
     }
 
@@ -1665,6 +1751,320 @@ done:
     return rc;
 }
 
+#if MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT)
+
+/**
+ * Number of controller ACL buffers a notification or indication carrying the
+ * specified payload occupies.
+ */
+static uint16_t
+ble_gatts_fanout_frags(const struct os_mbuf *payload)
+{
+    uint16_t acl_sz;
+    uint16_t len;
+
+    acl_sz = ble_hs_hci_max_acl_payload_sz();
+    if (payload == NULL || acl_sz == 0) {
+        return 1;
+    }
+
+    len = OS_MBUF_PKTLEN(payload) + BLE_L2CAP_HDR_SZ +
+          BLE_ATT_NOTIFY_REQ_BASE_SZ;
+
+    return (len + acl_sz - 1) / acl_sz;
+}
+
+static void
+ble_gatts_fanout_payload_hold(struct os_mbuf *payload)
+{
+    struct ble_gatts_fanout_payload *hdr;
+    uint32_t sr;
+
+    hdr = OS_MBUF_USRHDR(payload);
+
+    sr = ble_npl_hw_enter_critical();
+    hdr->refcnt++;
+    ble_npl_hw_exit_critical(sr);
+}
+
+static void
+ble_gatts_fanout_payload_release(struct os_mbuf *payload)
+{
+    struct ble_gatts_fanout_payload *hdr;
+    uint32_t sr;
+    int last;
+
+    hdr = OS_MBUF_USRHDR(payload);
+
+    sr = ble_npl_hw_enter_critical();
+    BLE_HS_DBG_ASSERT(hdr->refcnt > 0);
+    last = --hdr->refcnt == 0;
+    ble_npl_hw_exit_critical(sr);
+
+    if (last) {
+        os_mbuf_free_chain(payload);
+    }
+}
+
+/**
+ * Free callback of the reference pool.  References are freed wherever the
+ * packet carrying them is, so this may run outside the host task.
+ */
+static os_error_t
+ble_gatts_fanout_ref_put(struct os_mempool_ext *mpe, void *data, void *arg)
+{
+    struct os_mbuf *payload;
+    struct os_mbuf *om;
+
+    om = data;
+    memcpy(&payload, om->om_databuf, sizeof payload);
+    ble_gatts_fanout_payload_release(payload);
+
+    return os_memblock_put_from_cb(&mpe->mpe_mp, data);
+}
+
+/**
+ * Builds a chain of references to the specified shared value.
+ *
+ * The ACL and L2CAP headers only ever get prepended to the ATT header mbuf in
+ * front of the chain, so the shared data is never written to.  That does not
+ * hold once a packet has to be fragmented: the remainder of the chain may then
+ * start with a reference.  Only values that fit in a single ACL buffer may be
+ * shared.
+ *
+ * @return                      The reference chain on success;
+ *                              NULL if the reference pool is exhausted.
+ */
+static struct os_mbuf *
+ble_gatts_fanout_ref(struct os_mbuf *payload)
+{
+    struct os_mbuf *first;
+    struct os_mbuf *last;
+    struct os_mbuf *seg;
+    struct os_mbuf *om;
+
+    first = NULL;
+    last = NULL;
+    for (seg = payload; seg != NULL; seg = SLIST_NEXT(seg, om_next)) {
+        om = os_mbuf_get(&ble_gatts_fanout_ref_mbuf_pool, 0);
+        if (om == NULL) {
+            os_mbuf_free_chain(first);
+            return NULL;
+        }
+
+        ble_gatts_fanout_payload_hold(payload);
+        memcpy(om->om_databuf, &payload, sizeof payload);
+        om->om_data = seg->om_data;
+        om->om_len = seg->om_len;
+
+        if (last == NULL) {
+            first = om;
+        } else {
+            SLIST_NEXT(last, om_next) = om;
+        }
+        last = om;
+    }
+
+    return first;
+}
+
+static void
+ble_gatts_fanout_done(struct ble_gatts_fanout *fanout)
+{
+    uint32_t latency_ms;
+
+    if (!fanout->pending) {
+        return;
+    }
+
+    if (fanout->sent) {
+        latency_ms = ble_npl_time_ticks_to_ms32(ble_npl_time_get() -
+                                                fanout->updated_at);
+        fanout->stats.updates++;
+        fanout->stats.latency_total_ms += latency_ms;
+        if (latency_ms > fanout->stats.latency_max_ms) {
+            fanout->stats.latency_max_ms = latency_ms;
+        }
+    }
+
+    fanout->pending = 0;
+}
+
+/**
+ * Sends notifications or indications for the specified characteristic to all
+ * connected devices.  The bluetooth spec does not allow more than one
+ * concurrent indication for a single peer, so this function will hold off on
+ * sending such indications.
+ *
+ * The characteristic value is read once and shared by all peers; each one
+ * only gets its own ATT header in front of it.  As on the per-peer path, the
+ * access callback sees BLE_HS_CONN_HANDLE_NONE.  Peers are only served while the controller has
+ * free ACL buffers; the rest keep their modified flag and are picked up by
+ * ble_gatts_fanout_resume() once the controller reports completed packets.
+ */
+static void
+ble_gatts_tx_notifications_one_chr(uint16_t chr_val_handle)
+{
+    uint16_t conn_handles[MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+    uint8_t att_ops[MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+    struct ble_gatts_fanout_payload *payload_hdr;
+    struct ble_gatts_fanout *fanout;
+    struct ble_gatts_clt_cfg *clt_cfg;
+    struct ble_hs_conn *conn;
+    struct os_mbuf *payload;
+    struct os_mbuf *txom;
+    uint16_t budget;
+    uint16_t frags;
+    uint32_t copies;
+    int num_targets;
+    int clt_cfg_idx;
+    int deferred;
+    int pending;
+    int rc;
+    int i;
+
+    clt_cfg_idx = ble_gatts_clt_cfg_find_idx(ble_gatts_clt_cfgs,
+                                             chr_val_handle);
+    if (clt_cfg_idx == -1) {
+        return;
+    }
+
+    fanout = ble_gatts_fanouts + clt_cfg_idx;
+
+    /* Only read the value if somebody is waiting for it. */
+    ble_hs_lock();
+    pending = 0;
+    for (i = 0; (conn = ble_hs_conn_find_by_idx(i)) != NULL; i++) {
+        BLE_HS_DBG_ASSERT_EVAL(conn->bhc_gatt_svr.num_clt_cfgs >
+                               clt_cfg_idx);
+        clt_cfg = conn->bhc_gatt_svr.clt_cfgs + clt_cfg_idx;
+        if (ble_gatts_update_op(conn, clt_cfg) != 0) {
+            pending = 1;
+            break;
+        }
+    }
+
+    if (!pending) {
+        ble_gatts_fanout_done(fanout);
+        ble_hs_unlock();
+        return;
+    }
+
+    if (ble_hs_hci_avail_pkts == 0) {
+        fanout->stats.deferrals++;
+        ble_gatts_fanout_deferred = 1;
+        ble_hs_unlock();
+        return;
+    }
+    ble_hs_unlock();
+
+    /* If the value can't be read up front, fall back to reading it for
+     * each peer; the per-peer path reports any error to the application.
+     * While this function runs it holds a reference of its own, so peers
+     * that are done with the value early don't free it.
+     */
+    payload = os_msys_get_pkthdr(0, sizeof(struct ble_gatts_fanout_payload));
+    if (payload != NULL) {
+        payload_hdr = OS_MBUF_USRHDR(payload);
+        payload_hdr->refcnt = 1;
+        rc = ble_att_svr_read_handle(BLE_HS_CONN_HANDLE_NONE, chr_val_handle,
+                                     0, payload, NULL);
+        if (rc != 0) {
+            ble_gatts_fanout_payload_release(payload);
+            payload = NULL;
+        }
+    }
+    frags = ble_gatts_fanout_frags(payload);
+
+    /* Pick the peers that fit in the free controller buffers.  The first one
+     * is always taken so large values can't stall forever.
+     */
+    ble_hs_lock();
+    budget = ble_hs_hci_avail_pkts;
+    num_targets = 0;
+    deferred = 0;
+    for (i = 0; (conn = ble_hs_conn_find_by_idx(i)) != NULL; i++) {
+        clt_cfg = conn->bhc_gatt_svr.clt_cfgs + clt_cfg_idx;
+        if (ble_gatts_update_op(conn, clt_cfg) == 0) {
+            continue;
+        }
+
+        if (budget == 0 || (num_targets > 0 && budget < frags)) {
+            deferred = 1;
+            break;
+        }
+        budget = budget > frags ? budget - frags : 0;
+
+        att_ops[num_targets] = ble_gatts_schedule_update(conn, clt_cfg);
+        conn_handles[num_targets] = conn->bhc_handle;
+        num_targets++;
+    }
+
+    fanout->stats.sends += num_targets;
+    if (num_targets > 0) {
+        fanout->sent = 1;
+    }
+    if (deferred) {
+        fanout->stats.deferrals++;
+        ble_gatts_fanout_deferred = 1;
+    }
+    ble_hs_unlock();
+
+    copies = 0;
+    for (i = 0; i < num_targets; i++) {
+        /* Values that need fragmenting, and peers left over once the
+         * reference pool runs dry, get a copy.
+         */
+        txom = NULL;
+        if (payload != NULL) {
+            if (frags == 1) {
+                txom = ble_gatts_fanout_ref(payload);
+            }
+            if (txom == NULL) {
+                txom = os_mbuf_dup(payload);
+                copies++;
+            }
+        }
+
+        switch (att_ops[i]) {
+        case BLE_ATT_OP_NOTIFY_REQ:
+            ble_gatts_notify_custom(conn_handles[i], chr_val_handle, txom);
+            break;
+
+        case BLE_ATT_OP_INDICATE_REQ:
+            ble_gatts_indicate_custom(conn_handles[i], chr_val_handle, txom);
+            break;
+
+        default:
+            BLE_HS_DBG_ASSERT(0);
+            os_mbuf_free_chain(txom);
+            break;
+        }
+    }
+
+    if (payload != NULL) {
+        ble_gatts_fanout_payload_release(payload);
+    }
+
+    ble_hs_lock();
+    fanout->stats.copies += copies;
+    if (!deferred) {
+        ble_gatts_fanout_done(fanout);
+    }
+    ble_hs_unlock();
+}
+
+void
+ble_gatts_fanout_resume(void)
+{
+    if (ble_gatts_fanout_deferred && ble_hs_hci_avail_pkts > 0) {
+        ble_gatts_fanout_deferred = 0;
+        ble_hs_notifications_sched();
+    }
+}
+
+#else
+
 /**
  * Sends notifications or indications for the specified characteristic to all
  * connected devices.  The bluetooth spec does not allow more than one
@@ -1734,6 +2134,34 @@ ble_gatts_tx_notifications_one_chr(uint16_t chr_val_handle)
     }
 }
 
+#endif
+
+int
+ble_gatts_fanout_stats(uint16_t chr_val_handle,
+                       struct ble_gatts_fanout_stats *out_stats)
+{
+#if !MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT)
+    return BLE_HS_ENOTSUP;
+#else
+    int clt_cfg_idx;
+
+    ble_hs_lock();
+
+    clt_cfg_idx = ble_gatts_clt_cfg_find_idx(ble_gatts_clt_cfgs,
+                                             chr_val_handle);
+    if (clt_cfg_idx == -1 || ble_gatts_fanouts == NULL) {
+        ble_hs_unlock();
+        return BLE_HS_ENOENT;
+    }
+
+    *out_stats = ble_gatts_fanouts[clt_cfg_idx].stats;
+
+    ble_hs_unlock();
+
+    return 0;
+#endif
+}
+
 /**
  * Sends all pending notifications and indications.  The bluetooth spec does
  * not allow more than one concurrent indication for a single peer, so this
@@ -2258,6 +2686,27 @@ ble_gatts_init(void)
     ble_gatts_num_cfgable_chrs = 0;
     ble_gatts_clt_cfgs = NULL;
 
+#if MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT)
+    rc = os_mempool_ext_init(&ble_gatts_fanout_ref_mempool,
+                             MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT_REFS),
+                             BLE_GATTS_FANOUT_REF_BLOCK_SZ,
+                             ble_gatts_fanout_ref_mem,
+                             "ble_gatts_fanout_ref_pool");
+    if (rc != 0) {
+        return BLE_HS_EOS;
+    }
+
+    rc = os_mbuf_pool_init(&ble_gatts_fanout_ref_mbuf_pool,
+                           &ble_gatts_fanout_ref_mempool.mpe_mp,
+                           BLE_GATTS_FANOUT_REF_BLOCK_SZ,
+                           MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT_REFS));
+    if (rc != 0) {
+        return BLE_HS_EOS;
+    }
+
+    ble_gatts_fanout_ref_mempool.mpe_put_cb = ble_gatts_fanout_ref_put;
+#endif
+
     rc = stats_init_and_reg(
         STATS_HDR(ble_gatts_stats), STATS_SIZE_INIT_PARMS(ble_gatts_stats,
         STATS_SIZE_32), STATS_NAME_INIT_PARMS(ble_gatts_stats), "ble_gatts");
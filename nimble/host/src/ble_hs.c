@@ -228,30 +228,213 @@ ble_hs_process_rx_data_queue(void)
     }
 }
 
+/**
+ * Appends a packet that could not be sent right away to the connection's
+ * transmit queue.
+ */
+void
+ble_hs_tx_q_push(struct ble_hs_conn *conn, struct os_mbuf *om)
+{
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    if (STAILQ_EMPTY(&conn->bhc_tx_q)) {
+        conn->bhc_tx_hol_start = ble_npl_time_get();
+    }
+    STAILQ_INSERT_TAIL(&conn->bhc_tx_q, OS_MBUF_PKTHDR(om), omp_next);
+
+    conn->bhc_tx_q_pkts++;
+    if (conn->bhc_tx_q_pkts > conn->bhc_tx_q_pkts_max) {
+        conn->bhc_tx_q_pkts_max = conn->bhc_tx_q_pkts;
+    }
+}
+
+/**
+ * Transmits the packet at the head of the connection's transmit queue.
+ *
+ * @return                      0 if the packet left the queue;
+ *                              BLE_HS_EAGAIN if the controller is at
+ *                                  capacity.  The unsent remainder of the
+ *                                  packet stays at the head of the queue.
+ */
 static int
-ble_hs_wakeup_tx_conn(struct ble_hs_conn *conn)
+ble_hs_tx_q_send_head(struct ble_hs_conn *conn)
 {
     struct os_mbuf_pkthdr *omp;
     struct os_mbuf *om;
+    ble_npl_time_t now;
+    ble_npl_time_t wait;
+    int rc;
+
+    omp = STAILQ_FIRST(&conn->bhc_tx_q);
+    STAILQ_REMOVE_HEAD(&conn->bhc_tx_q, omp_next);
+
+    om = OS_MBUF_PKTHDR_TO_MBUF(omp);
+    rc = ble_hs_hci_acl_tx_now(conn, &om);
+    if (rc == BLE_HS_EAGAIN) {
+        /* Controller is at capacity.  This packet will be the first to
+         * get transmitted next time around.
+         */
+        STAILQ_INSERT_HEAD(&conn->bhc_tx_q, OS_MBUF_PKTHDR(om), omp_next);
+        return BLE_HS_EAGAIN;
+    }
+
+    /* Sent or dropped; either way the next packet is now at the head. */
+    now = ble_npl_time_get();
+    wait = now - conn->bhc_tx_hol_start;
+    if (wait > conn->bhc_tx_hol_max) {
+        conn->bhc_tx_hol_max = wait;
+    }
+    conn->bhc_tx_hol_start = now;
+    conn->bhc_tx_q_pkts--;
+
+    return 0;
+}
+
+#if MYNEWT_VAL(BLE_HS_TX_SCHED_DRR)
+/** Connection whose round-robin turn comes next, or is in progress. */
+static uint16_t ble_hs_tx_sched_handle = BLE_HS_CONN_HANDLE_NONE;
+
+/** Whether the current connection has already been given its quantum. */
+static uint8_t ble_hs_tx_sched_granted;
+
+/**
+ * Returns the number of controller buffers the specified queued packet will
+ * occupy.
+ */
+static int32_t
+ble_hs_tx_sched_cost(const struct os_mbuf_pkthdr *omp)
+{
+    uint16_t mtu;
+
+    mtu = ble_hs_hci_max_acl_payload_sz();
+    return (omp->omp_len + mtu - 1) / mtu;
+}
+
+static struct ble_hs_conn *
+ble_hs_tx_sched_next(struct ble_hs_conn *conn)
+{
+    conn = SLIST_NEXT(conn, bhc_next);
+    if (conn == NULL) {
+        conn = ble_hs_conn_first();
+    }
+
+    return conn;
+}
+
+/**
+ * Sends queued packets from the specified connection for as long as its
+ * deficit covers them.
+ */
+static int
+ble_hs_tx_sched_conn(struct ble_hs_conn *conn)
+{
+    struct os_mbuf_pkthdr *omp;
+    int32_t cost;
     int rc;
 
     while ((omp = STAILQ_FIRST(&conn->bhc_tx_q)) != NULL) {
-        STAILQ_REMOVE_HEAD(&conn->bhc_tx_q, omp_next);
-
-        om = OS_MBUF_PKTHDR_TO_MBUF(omp);
-        rc = ble_hs_hci_acl_tx_now(conn, &om);
-        if (rc == BLE_HS_EAGAIN) {
-            /* Controller is at capacity.  This packet will be the first to
-             * get transmitted next time around.
-             */
-            STAILQ_INSERT_HEAD(&conn->bhc_tx_q, OS_MBUF_PKTHDR(om), omp_next);
+        cost = ble_hs_tx_sched_cost(omp);
+        if (cost > conn->bhc_tx_deficit) {
+            return 0;
+        }
+        if (ble_hs_hci_avail_pkts == 0) {
             return BLE_HS_EAGAIN;
         }
+
+        /* Charge the whole packet up front; a packet that only gets
+         * partially sent is finished first next time without being charged
+         * again.
+         */
+        conn->bhc_tx_deficit -= cost;
+
+        rc = ble_hs_tx_q_send_head(conn);
+        if (rc != 0) {
+            return rc;
+        }
     }
 
+    /* An idle connection must not bank credit for later. */
+    conn->bhc_tx_deficit = 0;
+
     return 0;
 }
 
+/**
+ * Deficit round-robin over all connections with queued data.  Each turn a
+ * connection's deficit grows by its weight, counted in controller buffers,
+ * and it may send as many packets as the deficit pays for.  A turn
+ * interrupted by buffer exhaustion resumes at the same connection.
+ */
+static int
+ble_hs_tx_sched_run(void)
+{
+    struct ble_hs_conn *lap_start;
+    struct ble_hs_conn *conn;
+    int backlog;
+    int rc;
+
+    conn = ble_hs_conn_find(ble_hs_tx_sched_handle);
+    if (conn == NULL) {
+        conn = ble_hs_conn_first();
+        ble_hs_tx_sched_granted = 0;
+    }
+
+    lap_start = conn;
+    backlog = 0;
+
+    while (conn != NULL && ble_hs_hci_avail_pkts > 0) {
+        ble_hs_tx_sched_handle = conn->bhc_handle;
+
+        if (!STAILQ_EMPTY(&conn->bhc_tx_q)) {
+            if (!ble_hs_tx_sched_granted) {
+                conn->bhc_tx_deficit += conn->bhc_tx_weight;
+                ble_hs_tx_sched_granted = 1;
+            }
+
+            rc = ble_hs_tx_sched_conn(conn);
+            if (rc != 0) {
+                return rc;
+            }
+
+            if (!STAILQ_EMPTY(&conn->bhc_tx_q)) {
+                backlog = 1;
+            }
+        }
+
+        conn = ble_hs_tx_sched_next(conn);
+        ble_hs_tx_sched_granted = 0;
+
+        if (conn == lap_start) {
+            if (!backlog) {
+                break;
+            }
+            backlog = 0;
+        }
+    }
+
+    if (conn != NULL) {
+        ble_hs_tx_sched_handle = conn->bhc_handle;
+    }
+
+    return 0;
+}
+#else
+static int
+ble_hs_wakeup_tx_conn(struct ble_hs_conn *conn)
+{
+    int rc;
+
+    while (!STAILQ_EMPTY(&conn->bhc_tx_q)) {
+        rc = ble_hs_tx_q_send_head(conn);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+#endif
+
 /**
  * Schedules the transmission of all queued ACL data packets to the controller.
  */
@@ -272,7 +455,15 @@ ble_hs_wakeup_tx(void)
          conn = SLIST_NEXT(conn, bhc_next)) {
 
         if (conn->bhc_flags & BLE_HS_CONN_F_TX_FRAG) {
+#if MYNEWT_VAL(BLE_HS_TX_SCHED_DRR)
+            /* The packet was paid for when it was started. */
+            rc = 0;
+            if (!STAILQ_EMPTY(&conn->bhc_tx_q)) {
+                rc = ble_hs_tx_q_send_head(conn);
+            }
+#else
             rc = ble_hs_wakeup_tx_conn(conn);
+#endif
             if (rc != 0) {
                 goto done;
             }
@@ -280,6 +471,9 @@ ble_hs_wakeup_tx(void)
         }
     }
 
+#if MYNEWT_VAL(BLE_HS_TX_SCHED_DRR)
+    ble_hs_tx_sched_run();
+#else
     /* For each connection, transmit queued packets until there are no more
      * packets to send or the controller's buffers are exhausted.
      */
@@ -292,9 +486,15 @@ ble_hs_wakeup_tx(void)
             goto done;
         }
     }
+#endif
 
 done:
     ble_hs_unlock();
+
+#if MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT)
+    /* Notifications held back for lack of buffers can go out now. */
+    ble_gatts_fanout_resume();
+#endif
 }
 
 static void
@@ -348,6 +548,10 @@ ble_hs_sync(void)
                        rc);
         }
 
+#if MYNEWT_VAL(BLE_SM_SC) && MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+        ble_sm_sc_key_pool_fill();
+#endif
+
         if (ble_hs_cfg.sync_cb != NULL) {
             ble_hs_cfg.sync_cb();
         }
@@ -395,11 +599,12 @@ ble_hs_timer_exp(struct ble_npl_event *ev)
 
     switch (ble_hs_sync_state) {
     case BLE_HS_SYNC_STATE_GOOD:
-#if NIMBLE_BLE_CONNECT
-        ticks_until_next = ble_gattc_timer();
+        /* GATT client and L2CAP signalling procedure timeouts */
+        ticks_until_next = ble_hs_deadline_run();
         ble_hs_timer_sched(ticks_until_next);
 
-        ticks_until_next = ble_l2cap_sig_timer();
+#if NIMBLE_BLE_CONNECT
+        ticks_until_next = ble_gattc_timer();
         ble_hs_timer_sched(ticks_until_next);
 
         ticks_until_next = ble_sm_timer();
@@ -713,6 +918,10 @@ ble_hs_init(void)
      */
     ble_hs_reset_reason = 0;
     ble_hs_enabled_state = BLE_HS_ENABLED_STATE_OFF;
+#if MYNEWT_VAL(BLE_HS_TX_SCHED_DRR)
+    ble_hs_tx_sched_handle = BLE_HS_CONN_HANDLE_NONE;
+    ble_hs_tx_sched_granted = 0;
+#endif
 
 #if NIMBLE_BLE_CONNECT
     ble_npl_event_init(&ble_hs_ev_tx_notifications, ble_hs_event_tx_notify,
@@ -725,6 +934,7 @@ ble_hs_init(void)
                        NULL);
 
     ble_hs_hci_init();
+    ble_hs_deadline_init();
 
     rc = ble_hs_conn_init();
     SYSINIT_PANIC_ASSERT(rc == 0);
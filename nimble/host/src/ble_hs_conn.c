@@ -27,9 +27,42 @@
 /** At least three channels required per connection (sig, att, sm). */
 #define BLE_HS_CONN_MIN_CHANS       3
 
+/*
+ * Next power of two strictly greater than x, for sizing the lookup tables
+ * below at compile time.
+ */
+#define BLE_HS_CONN_P2_1(x)     ((x) | ((x) >> 1))
+#define BLE_HS_CONN_P2_2(x)     (BLE_HS_CONN_P2_1(x) | (BLE_HS_CONN_P2_1(x) >> 2))
+#define BLE_HS_CONN_P2_4(x)     (BLE_HS_CONN_P2_2(x) | (BLE_HS_CONN_P2_2(x) >> 4))
+#define BLE_HS_CONN_P2_8(x)     (BLE_HS_CONN_P2_4(x) | (BLE_HS_CONN_P2_4(x) >> 8))
+#define BLE_HS_CONN_P2_GT(x)    (BLE_HS_CONN_P2_8(x) + 1)
+
+/**
+ * Open addressed (linear probing) lookup tables.  The handle table holds one
+ * entry per connection, the address table up to two (peer address and peer
+ * RPA), so both stay at most half full.
+ */
+#define BLE_HS_CONN_HANDLE_TBL_SZ \
+    BLE_HS_CONN_P2_GT(2 * MYNEWT_VAL(BLE_MAX_CONNECTIONS))
+#define BLE_HS_CONN_ADDR_TBL_SZ \
+    BLE_HS_CONN_P2_GT(4 * MYNEWT_VAL(BLE_MAX_CONNECTIONS))
+
+struct ble_hs_conn_slot {
+    struct ble_hs_conn *conn;
+    uint16_t hash;
+};
+
 static SLIST_HEAD(, ble_hs_conn) ble_hs_conns;
 static struct os_mempool ble_hs_conn_pool;
 
+/** Connections in insertion order, backs ble_hs_conn_find_by_idx(). */
+static struct ble_hs_conn *ble_hs_conn_arr[MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+static int ble_hs_conn_cnt;
+
+static struct ble_hs_conn_slot
+ble_hs_conn_handle_tbl[BLE_HS_CONN_HANDLE_TBL_SZ];
+static struct ble_hs_conn_slot ble_hs_conn_addr_tbl[BLE_HS_CONN_ADDR_TBL_SZ];
+
 static os_membuf_t ble_hs_conn_elem_mem[
     OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_MAX_CONNECTIONS),
                     sizeof (struct ble_hs_conn))
@@ -194,6 +227,9 @@ ble_hs_conn_alloc(uint16_t conn_handle)
 
     STAILQ_INIT(&conn->bhc_tx_q);
     STAILQ_INIT(&conn->att_tx_q);
+#if MYNEWT_VAL(BLE_HS_TX_SCHED_DRR)
+    conn->bhc_tx_weight = 1;
+#endif
 
     STATS_INC(ble_hs_stats, conn_create);
 
@@ -255,6 +291,12 @@ ble_hs_conn_free(struct ble_hs_conn *conn)
         os_mbuf_free_chain(OS_MBUF_PKTHDR_TO_MBUF(omp));
     }
 
+    /* ATT requests still waiting for the bearer to become free. */
+    while ((omp = STAILQ_FIRST(&conn->att_tx_q)) != NULL) {
+        STAILQ_REMOVE_HEAD(&conn->att_tx_q, omp_next);
+        os_mbuf_free_chain(OS_MBUF_PKTHDR_TO_MBUF(omp));
+    }
+
 #if MYNEWT_VAL(BLE_HS_DEBUG)
     memset(conn, 0xff, sizeof *conn);
 #endif
@@ -264,6 +306,117 @@ ble_hs_conn_free(struct ble_hs_conn *conn)
     STATS_INC(ble_hs_stats, conn_delete);
 }
 
+static uint16_t
+ble_hs_conn_handle_hash(uint16_t conn_handle)
+{
+    return (uint16_t)((conn_handle * 0x9e3779b1u) >> 16);
+}
+
+static uint16_t
+ble_hs_conn_addr_hash(const uint8_t *val)
+{
+    uint32_t hash;
+    int i;
+
+    /* FNV-1a; the address type is deliberately left out so identity and
+     * over-the-air lookups of the same address land in the same chain.
+     */
+    hash = 2166136261u;
+    for (i = 0; i < 6; i++) {
+        hash = (hash ^ val[i]) * 16777619u;
+    }
+
+    return (uint16_t)(hash ^ (hash >> 16));
+}
+
+static void
+ble_hs_conn_tbl_add(struct ble_hs_conn_slot *tbl, int tbl_sz,
+                    struct ble_hs_conn *conn, uint16_t hash)
+{
+    int idx;
+
+    idx = hash & (tbl_sz - 1);
+    while (tbl[idx].conn != NULL) {
+        idx = (idx + 1) & (tbl_sz - 1);
+    }
+
+    tbl[idx].conn = conn;
+    tbl[idx].hash = hash;
+}
+
+static void
+ble_hs_conn_tbl_del(struct ble_hs_conn_slot *tbl, int tbl_sz,
+                    const struct ble_hs_conn *conn, uint16_t hash)
+{
+    int mask;
+    int home;
+    int idx;
+    int nxt;
+
+    mask = tbl_sz - 1;
+
+    idx = hash & mask;
+    while (tbl[idx].conn != conn) {
+        if (tbl[idx].conn == NULL) {
+            BLE_HS_DBG_ASSERT(0);
+            return;
+        }
+        idx = (idx + 1) & mask;
+    }
+
+    /* Backward shift deletion: pull later members of the probe run into
+     * the hole unless that would move them in front of their home slot.
+     */
+    nxt = idx;
+    while (1) {
+        nxt = (nxt + 1) & mask;
+        if (tbl[nxt].conn == NULL) {
+            break;
+        }
+
+        home = tbl[nxt].hash & mask;
+        if (((nxt - home) & mask) >= ((nxt - idx) & mask)) {
+            tbl[idx] = tbl[nxt];
+            idx = nxt;
+        }
+    }
+
+    tbl[idx].conn = NULL;
+}
+
+static bool
+ble_hs_conn_has_rpa_key(const struct ble_hs_conn *conn)
+{
+    return memcmp(conn->bhc_peer_rpa_addr.val, ble_hs_conn_null_addr,
+                  6) != 0 &&
+           memcmp(conn->bhc_peer_rpa_addr.val, conn->bhc_peer_addr.val,
+                  6) != 0;
+}
+
+static void
+ble_hs_conn_addr_index(struct ble_hs_conn *conn)
+{
+    ble_hs_conn_tbl_add(ble_hs_conn_addr_tbl, BLE_HS_CONN_ADDR_TBL_SZ, conn,
+                        ble_hs_conn_addr_hash(conn->bhc_peer_addr.val));
+    if (ble_hs_conn_has_rpa_key(conn)) {
+        ble_hs_conn_tbl_add(ble_hs_conn_addr_tbl, BLE_HS_CONN_ADDR_TBL_SZ,
+                            conn,
+                            ble_hs_conn_addr_hash(conn->bhc_peer_rpa_addr.val));
+    }
+}
+
+static void
+ble_hs_conn_addr_unindex(struct ble_hs_conn *conn)
+{
+    ble_hs_conn_tbl_del(ble_hs_conn_addr_tbl, BLE_HS_CONN_ADDR_TBL_SZ, conn,
+                        ble_hs_conn_addr_hash(conn->bhc_peer_addr.val));
+    if (ble_hs_conn_has_rpa_key(conn)) {
+        ble_hs_conn_tbl_del(ble_hs_conn_addr_tbl, BLE_HS_CONN_ADDR_TBL_SZ,
+                            conn,
+                            ble_hs_conn_addr_hash(conn->bhc_peer_rpa_addr.val));
+    }
+}
+
 void
 ble_hs_conn_insert(struct ble_hs_conn *conn)
 {
@@ -274,7 +427,14 @@ ble_hs_conn_insert(struct ble_hs_conn *conn)
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
     BLE_HS_DBG_ASSERT_EVAL(ble_hs_conn_find(conn->bhc_handle) == NULL);
+    BLE_HS_DBG_ASSERT(ble_hs_conn_cnt < MYNEWT_VAL(BLE_MAX_CONNECTIONS));
+
     SLIST_INSERT_HEAD(&ble_hs_conns, conn, bhc_next);
+    ble_hs_conn_arr[ble_hs_conn_cnt++] = conn;
+
+    ble_hs_conn_tbl_add(ble_hs_conn_handle_tbl, BLE_HS_CONN_HANDLE_TBL_SZ,
+                        conn, ble_hs_conn_handle_hash(conn->bhc_handle));
+    ble_hs_conn_addr_index(conn);
 }
 
 void
@@ -284,9 +444,40 @@ ble_hs_conn_remove(struct ble_hs_conn *conn)
     return;
 #endif
 
+    int i;
+
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
     SLIST_REMOVE(&ble_hs_conns, conn, ble_hs_conn, bhc_next);
+
+    /* Keep insertion order so indices match the list walk order. */
+    for (i = 0; i < ble_hs_conn_cnt; i++) {
+        if (ble_hs_conn_arr[i] == conn) {
+            memmove(ble_hs_conn_arr + i, ble_hs_conn_arr + i + 1,
+                    (ble_hs_conn_cnt - i - 1) * sizeof ble_hs_conn_arr[0]);
+            ble_hs_conn_cnt--;
+            break;
+        }
+    }
+
+    ble_hs_conn_tbl_del(ble_hs_conn_handle_tbl, BLE_HS_CONN_HANDLE_TBL_SZ,
+                        conn, ble_hs_conn_handle_hash(conn->bhc_handle));
+    ble_hs_conn_addr_unindex(conn);
+}
+
+void
+ble_hs_conn_set_peer_addr(struct ble_hs_conn *conn, const ble_addr_t *addr)
+{
+#if !NIMBLE_BLE_CONNECT
+    return;
+#endif
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+    BLE_HS_DBG_ASSERT(ble_hs_conn_find(conn->bhc_handle) == conn);
+
+    ble_hs_conn_addr_unindex(conn);
+    conn->bhc_peer_addr = *addr;
+    ble_hs_conn_addr_index(conn);
 }
 
 struct ble_hs_conn *
@@ -297,13 +488,17 @@ ble_hs_conn_find(uint16_t conn_handle)
 #endif
 
     struct ble_hs_conn *conn;
+    int idx;
 
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
-    SLIST_FOREACH(conn, &ble_hs_conns, bhc_next) {
+    idx = ble_hs_conn_handle_hash(conn_handle) &
+          (BLE_HS_CONN_HANDLE_TBL_SZ - 1);
+    while ((conn = ble_hs_conn_handle_tbl[idx].conn) != NULL) {
         if (conn->bhc_handle == conn_handle) {
             return conn;
         }
+        idx = (idx + 1) & (BLE_HS_CONN_HANDLE_TBL_SZ - 1);
     }
 
     return NULL;
@@ -329,6 +524,7 @@ ble_hs_conn_find_by_addr(const ble_addr_t *addr)
 
     struct ble_hs_conn *conn;
     struct ble_hs_conn_addrs addrs;
+    int idx;
 
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
@@ -336,7 +532,14 @@ ble_hs_conn_find_by_addr(const ble_addr_t *addr)
         return NULL;
     }
 
-    SLIST_FOREACH(conn, &ble_hs_conns, bhc_next) {
+    /* Every candidate is indexed under the value of its peer address and of
+     * its peer RPA, so only the probe run for this value needs checking.
+     */
+    idx = ble_hs_conn_addr_hash(addr->val) & (BLE_HS_CONN_ADDR_TBL_SZ - 1);
+    for (;
+         (conn = ble_hs_conn_addr_tbl[idx].conn) != NULL;
+         idx = (idx + 1) & (BLE_HS_CONN_ADDR_TBL_SZ - 1)) {
+
         if (BLE_ADDR_IS_RPA(addr)) {
             if (ble_addr_cmp(&conn->bhc_peer_rpa_addr, addr) == 0) {
                 return conn;
@@ -366,21 +569,14 @@ ble_hs_conn_find_by_idx(int idx)
     return NULL;
 #endif
 
-    struct ble_hs_conn *conn;
-    int i;
-
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
-    i = 0;
-    SLIST_FOREACH(conn, &ble_hs_conns, bhc_next) {
-        if (i == idx) {
-            return conn;
-        }
-
-        i++;
+    if (idx < 0 || idx >= ble_hs_conn_cnt) {
+        return NULL;
     }
 
-    return NULL;
+    /* Most recently inserted first, same as the list. */
+    return ble_hs_conn_arr[ble_hs_conn_cnt - 1 - idx];
 }
 
 int
@@ -560,5 +756,9 @@ ble_hs_conn_init(void)
 
     SLIST_INIT(&ble_hs_conns);
 
+    ble_hs_conn_cnt = 0;
+    memset(ble_hs_conn_handle_tbl, 0, sizeof ble_hs_conn_handle_tbl);
+    memset(ble_hs_conn_addr_tbl, 0, sizeof ble_hs_conn_addr_tbl);
+
     return 0;
 }
@@ -90,6 +90,21 @@ struct ble_hs_conn {
 
     /** Queue of outgoing packets that could not be sent. */
     STAILQ_HEAD(, os_mbuf_pkthdr) bhc_tx_q;
+    uint16_t bhc_tx_q_pkts;
+    uint16_t bhc_tx_q_pkts_max;
+
+    /** Time the packet at the head of bhc_tx_q became the head. */
+    ble_npl_time_t bhc_tx_hol_start;
+    ble_npl_time_t bhc_tx_hol_max;
+
+#if MYNEWT_VAL(BLE_HS_TX_SCHED_DRR)
+    /**
+     * Controller buffers this connection may still use in the current
+     * round-robin turn; topped up by bhc_tx_weight every turn.
+     */
+    int32_t bhc_tx_deficit;
+    uint8_t bhc_tx_weight;
+#endif
 
     struct ble_att_svr_conn bhc_att_svr;
     struct ble_gatts_conn bhc_gatt_svr;
@@ -119,6 +134,8 @@ struct ble_hs_conn *ble_hs_conn_alloc(uint16_t conn_handle);
 void ble_hs_conn_free(struct ble_hs_conn *conn);
 void ble_hs_conn_insert(struct ble_hs_conn *conn);
 void ble_hs_conn_remove(struct ble_hs_conn *conn);
+void ble_hs_conn_set_peer_addr(struct ble_hs_conn *conn,
+                               const ble_addr_t *addr);
 struct ble_hs_conn *ble_hs_conn_find(uint16_t conn_handle);
 struct ble_hs_conn *ble_hs_conn_find_assert(uint16_t conn_handle);
 struct ble_hs_conn *ble_hs_conn_find_by_addr(const ble_addr_t *addr);
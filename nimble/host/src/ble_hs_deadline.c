@@ -0,0 +1,210 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include "syscfg/syscfg.h"
+#include "ble_hs_priv.h"
+
+/*
+ * Protocol timeouts of every host procedure that can be pending, ordered in
+ * a binary min-heap so the earliest is always at the root.  Arming, disarming
+ * and expiring a deadline cost O(log n); finding the next one costs O(1).
+ */
+#define BLE_HS_DEADLINE_MAX     (MYNEWT_VAL(BLE_GATT_MAX_PROCS) + \
+                                 MYNEWT_VAL(BLE_L2CAP_SIG_MAX_PROCS))
+
+static struct ble_hs_deadline *ble_hs_deadline_heap[BLE_HS_DEADLINE_MAX];
+static uint16_t ble_hs_deadline_cnt;
+
+static int
+ble_hs_deadline_before(const struct ble_hs_deadline *a,
+                       const struct ble_hs_deadline *b)
+{
+    return (ble_npl_stime_t)(a->bhd_expiry - b->bhd_expiry) < 0;
+}
+
+static void
+ble_hs_deadline_place(struct ble_hs_deadline *dl, uint16_t idx)
+{
+    ble_hs_deadline_heap[idx] = dl;
+    dl->bhd_pos = idx + 1;
+}
+
+static void
+ble_hs_deadline_sift_up(uint16_t idx)
+{
+    struct ble_hs_deadline *dl;
+    uint16_t parent;
+
+    dl = ble_hs_deadline_heap[idx];
+    while (idx > 0) {
+        parent = (idx - 1) / 2;
+        if (!ble_hs_deadline_before(dl, ble_hs_deadline_heap[parent])) {
+            break;
+        }
+        ble_hs_deadline_place(ble_hs_deadline_heap[parent], idx);
+        idx = parent;
+    }
+    ble_hs_deadline_place(dl, idx);
+}
+
+static void
+ble_hs_deadline_sift_down(uint16_t idx)
+{
+    struct ble_hs_deadline *dl;
+    uint16_t child;
+
+    dl = ble_hs_deadline_heap[idx];
+    while (1) {
+        child = 2 * idx + 1;
+        if (child >= ble_hs_deadline_cnt) {
+            break;
+        }
+        if (child + 1 < ble_hs_deadline_cnt &&
+            ble_hs_deadline_before(ble_hs_deadline_heap[child + 1],
+                                   ble_hs_deadline_heap[child])) {
+            child++;
+        }
+        if (!ble_hs_deadline_before(ble_hs_deadline_heap[child], dl)) {
+            break;
+        }
+        ble_hs_deadline_place(ble_hs_deadline_heap[child], idx);
+        idx = child;
+    }
+    ble_hs_deadline_place(dl, idx);
+}
+
+/**
+ * Arms a deadline, or moves it if it is already armed.  The caller must hold
+ * the host lock.
+ *
+ * @param dl                    The deadline to arm.
+ * @param expiry                The time at which cb is to be called.
+ * @param cb                    The function to call once expiry has passed.
+ */
+void
+ble_hs_deadline_arm(struct ble_hs_deadline *dl, ble_npl_time_t expiry,
+                    ble_hs_deadline_fn *cb)
+{
+    uint16_t idx;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    dl->bhd_expiry = expiry;
+    dl->bhd_cb = cb;
+
+    if (dl->bhd_pos != 0) {
+        idx = dl->bhd_pos - 1;
+        BLE_HS_DBG_ASSERT(ble_hs_deadline_heap[idx] == dl);
+        ble_hs_deadline_sift_up(idx);
+        ble_hs_deadline_sift_down(dl->bhd_pos - 1);
+        return;
+    }
+
+    /* Every registered object owns at most one deadline, so the heap is
+     * sized never to overflow.
+     */
+    assert(ble_hs_deadline_cnt < BLE_HS_DEADLINE_MAX);
+
+    idx = ble_hs_deadline_cnt++;
+    ble_hs_deadline_place(dl, idx);
+    ble_hs_deadline_sift_up(idx);
+}
+
+/**
+ * Disarms a deadline.  Nothing happens if it is not armed.  The caller must
+ * hold the host lock.
+ */
+void
+ble_hs_deadline_disarm(struct ble_hs_deadline *dl)
+{
+    struct ble_hs_deadline *last;
+    uint16_t idx;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    if (dl->bhd_pos == 0) {
+        return;
+    }
+
+    idx = dl->bhd_pos - 1;
+    BLE_HS_DBG_ASSERT(ble_hs_deadline_heap[idx] == dl);
+    dl->bhd_pos = 0;
+
+    ble_hs_deadline_cnt--;
+    if (idx == ble_hs_deadline_cnt) {
+        return;
+    }
+
+    /* Fill the hole with the last entry and restore heap order around it. */
+    last = ble_hs_deadline_heap[ble_hs_deadline_cnt];
+    ble_hs_deadline_place(last, idx);
+    ble_hs_deadline_sift_up(idx);
+    ble_hs_deadline_sift_down(last->bhd_pos - 1);
+}
+
+int
+ble_hs_deadline_armed(const struct ble_hs_deadline *dl)
+{
+    return dl->bhd_pos != 0;
+}
+
+/**
+ * Calls the callback of every deadline that has passed, earliest first.
+ *
+ * @return                      The number of ticks until the next deadline;
+ *                              BLE_HS_FOREVER if none is armed.
+ */
+int32_t
+ble_hs_deadline_run(void)
+{
+    struct ble_hs_deadline *dl;
+    ble_npl_stime_t diff;
+    ble_npl_time_t now;
+
+    now = ble_npl_time_get();
+
+    while (1) {
+        ble_hs_lock();
+
+        if (ble_hs_deadline_cnt == 0) {
+            ble_hs_unlock();
+            return BLE_HS_FOREVER;
+        }
+
+        dl = ble_hs_deadline_heap[0];
+        diff = dl->bhd_expiry - now;
+        if (diff > 0) {
+            ble_hs_unlock();
+            return diff;
+        }
+
+        ble_hs_deadline_disarm(dl);
+
+        ble_hs_unlock();
+
+        dl->bhd_cb(dl);
+    }
+}
+
+void
+ble_hs_deadline_init(void)
+{
+    ble_hs_deadline_cnt = 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_HS_DEADLINE_PRIV_
+#define H_BLE_HS_DEADLINE_PRIV_
+
+#include <inttypes.h>
+#include "nimble/nimble_npl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ble_hs_deadline;
+
+/**
+ * Called when a deadline passes.  The deadline has already been disarmed and
+ * the host lock is not held.
+ */
+typedef void ble_hs_deadline_fn(struct ble_hs_deadline *dl);
+
+/**
+ * A point in time some host object has to be looked at by, kept in a heap
+ * shared by all host protocols.  Embedded in the object it belongs to; the
+ * callback finds the object with CONTAINER_OF().
+ */
+struct ble_hs_deadline {
+    ble_npl_time_t bhd_expiry;
+    ble_hs_deadline_fn *bhd_cb;
+
+    /** Index in the heap plus one; 0 if not armed. */
+    uint16_t bhd_pos;
+};
+
+void ble_hs_deadline_arm(struct ble_hs_deadline *dl, ble_npl_time_t expiry,
+                         ble_hs_deadline_fn *cb);
+void ble_hs_deadline_disarm(struct ble_hs_deadline *dl);
+int ble_hs_deadline_armed(const struct ble_hs_deadline *dl);
+int32_t ble_hs_deadline_run(void);
+void ble_hs_deadline_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -416,7 +416,7 @@ ble_hs_hci_rx_evt(uint8_t *hci_ev, void *arg)
 /**
  * Calculates the largest ACL payload that the controller can accept.
  */
-static uint16_t
+uint16_t
 ble_hs_hci_max_acl_payload_sz(void)
 {
     /* As per BLE 5.1 Standard, Vol. 2, Part E, section 7.8.2:
@@ -299,6 +299,13 @@ ble_hs_hci_evt_num_completed_pkts(uint8_t event_code, const void *data,
                 ble_hs_hci_add_avail_pkts(num_pkts);
             }
             ble_hs_unlock();
+
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+            if (conn == NULL) {
+                ble_iso_rx_num_completed_pkts(
+                    le16toh(ev->completed[i].handle), num_pkts);
+            }
+#endif
         }
     }
 
@@ -118,6 +118,7 @@ int ble_hs_hci_evt_process(struct ble_hci_ev *ev);
 
 int ble_hs_hci_cmd_send_buf(uint16_t opcode, const void *buf, uint8_t buf_len);
 int ble_hs_hci_set_buf_sz(uint16_t pktlen, uint16_t max_pkts);
+uint16_t ble_hs_hci_max_acl_payload_sz(void);
 void ble_hs_hci_add_avail_pkts(uint16_t delta);
 
 uint16_t ble_hs_hci_util_handle_pb_bc_join(uint16_t handle, uint8_t pb,
@@ -100,6 +100,27 @@ ble_hs_mbuf_att_pkt(void)
                                BLE_ATT_PREP_WRITE_CMD_BASE_SZ);
 }
 
+struct os_mbuf *
+ble_hs_mbuf_iso_pkt(void)
+{
+    return ble_hs_mbuf_gen_pkt(sizeof(struct ble_hci_iso) +
+                               sizeof(uint32_t) +
+                               sizeof(struct ble_hci_iso_data));
+}
+
+/**
+ * Allocates an mbuf suitable for a continuation fragment of an ISO SDU.  The
+ * resulting packet has sufficient leading space for the HCI ISO data header.
+ *
+ * @return                  An empty mbuf on success; null on memory
+ *                              exhaustion.
+ */
+struct os_mbuf *
+ble_hs_mbuf_iso_cont_pkt(void)
+{
+    return ble_hs_mbuf_gen_pkt(sizeof(struct ble_hci_iso));
+}
+
 struct os_mbuf *
 ble_hs_mbuf_from_flat(const void *buf, uint16_t len)
 {
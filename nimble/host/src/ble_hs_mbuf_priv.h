@@ -29,6 +29,7 @@ struct os_mbuf;
 struct os_mbuf *ble_hs_mbuf_bare_pkt(void);
 struct os_mbuf *ble_hs_mbuf_acl_pkt(void);
 struct os_mbuf *ble_hs_mbuf_l2cap_pkt(void);
+struct os_mbuf *ble_hs_mbuf_iso_cont_pkt(void);
 int ble_hs_mbuf_pullup_base(struct os_mbuf **om, int base_len);
 
 #ifdef __cplusplus
@@ -36,12 +36,12 @@ ble_mqueue_get(struct ble_mqueue *mq)
     struct os_mbuf *om;
     os_sr_t sr;
 
-    OS_ENTER_CRITICAL(sr);
+    sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_MQUEUE);
     mp = STAILQ_FIRST(&mq->head);
     if (mp) {
         STAILQ_REMOVE_HEAD(&mq->head, omp_next);
     }
-    OS_EXIT_CRITICAL(sr);
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_MQUEUE, sr);
 
     if (mp) {
         om = OS_MBUF_PKTHDR_TO_MBUF(mp);
@@ -67,9 +67,9 @@ ble_mqueue_put(struct ble_mqueue *mq, struct ble_npl_eventq *evq, struct os_mbuf
 
     mp = OS_MBUF_PKTHDR(om);
 
-    OS_ENTER_CRITICAL(sr);
+    sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_MQUEUE);
     STAILQ_INSERT_TAIL(&mq->head, mp, omp_next);
-    OS_EXIT_CRITICAL(sr);
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_MQUEUE, sr);
 
     /* Only post an event to the queue if its specified */
     if (evq) {
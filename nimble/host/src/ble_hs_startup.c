@@ -22,6 +22,7 @@
 #include "host/ble_hs.h"
 #include "host/ble_hs_hci.h"
 #include "ble_hs_priv.h"
+#include "ble_iso_priv.h"
 
 #if !MYNEWT_VAL(BLE_CONTROLLER)
 static int
@@ -179,6 +180,25 @@ ble_hs_startup_read_buf_sz(void)
 }
 #endif
 
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+static void
+ble_hs_startup_le_read_iso_buf_sz(void)
+{
+    struct ble_hci_le_rd_buf_size_v2_rp rsp;
+    int rc;
+
+    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                      BLE_HCI_OCF_LE_RD_BUF_SIZE_V2), NULL, 0,
+                           &rsp, sizeof(rsp));
+    if (rc != 0) {
+        /* ISO data is sent without flow control */
+        memset(&rsp, 0, sizeof(rsp));
+    }
+
+    ble_iso_tx_set_buf_sz(le16toh(rsp.iso_data_len), rsp.iso_data_packets);
+}
+#endif
+
 static int
 ble_hs_startup_read_bd_addr(void)
 {
@@ -433,6 +453,10 @@ ble_hs_startup_go(void)
     }
 #endif
 
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+    ble_hs_startup_le_read_iso_buf_sz();
+#endif
+
     rc = ble_hs_startup_le_read_sup_f_tx();
     if (rc != 0) {
         return rc;
@@ -21,6 +21,7 @@
 
 #if MYNEWT_VAL(BLE_ISO)
 #include "os/os_mbuf.h"
+#include "os/util.h"
 #include "host/ble_hs_log.h"
 #include "host/ble_hs.h"
 #include "host/ble_iso.h"
@@ -69,11 +70,20 @@ struct ble_iso_big {
 struct ble_iso_conn {
     SLIST_ENTRY(ble_iso_conn) next;
     enum ble_iso_conn_type type;
-    uint8_t handle;
+    uint16_t handle;
 
     struct ble_iso_rx_data_info rx_info;
     struct os_mbuf *rx_buf;
 
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+    /* HCI ISO Data packets waiting for free Controller buffers */
+    STAILQ_HEAD(, os_mbuf_pkthdr) tx_q;
+    uint16_t tx_queued;
+    /* Packets sent to the Controller and not completed yet */
+    uint16_t tx_outstanding;
+    uint16_t tx_seq_num;
+#endif
+
     ble_iso_event_fn *cb;
     void *cb_arg;
 };
@@ -92,6 +102,16 @@ static struct os_mempool ble_iso_bis_pool;
 static os_membuf_t ble_iso_bis_mem[
     OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_ISO_MAX_BISES), sizeof (struct ble_iso_bis))];
 
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+STAILQ_HEAD(ble_iso_tx_pkts, os_mbuf_pkthdr);
+
+/* Maximum ISO_Data_Load length of an HCI ISO Data packet */
+static uint16_t ble_iso_tx_buf_len = MYNEWT_VAL(BLE_TRANSPORT_ISO_SIZE);
+/* Free Controller ISO Data buffers; used only with flow control enabled */
+static uint16_t ble_iso_tx_avail_pkts;
+static uint8_t ble_iso_tx_flow_ctrl;
+#endif
+
 static void
 ble_iso_conn_append(struct ble_iso_conn *conn)
 {
@@ -181,8 +201,13 @@ ble_iso_bis_alloc(struct ble_iso_big *big)
     memset(new_bis, 0, sizeof *new_bis);
     new_bis->conn.type = BLE_ISO_CONN_BIS;
     new_bis->big = big;
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+    STAILQ_INIT(&new_bis->conn.tx_q);
+#endif
 
+    ble_hs_lock();
     ble_iso_conn_append(&new_bis->conn);
+    ble_hs_unlock();
 
     return new_bis;
 }
@@ -201,27 +226,87 @@ ble_iso_big_find_by_handle(uint8_t big_handle)
     return NULL;
 }
 
+static struct ble_iso_conn *
+ble_iso_conn_lookup_handle(uint16_t handle)
+{
+    struct ble_iso_conn *conn;
+
+    SLIST_FOREACH(conn, &ble_iso_conns, next) {
+        if (conn->handle == handle) {
+            return conn;
+        }
+    }
+
+    return NULL;
+}
+
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+static void
+ble_iso_conn_tx_flush(struct ble_iso_conn *conn)
+{
+    struct os_mbuf_pkthdr *omp;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    while ((omp = STAILQ_FIRST(&conn->tx_q)) != NULL) {
+        STAILQ_REMOVE_HEAD(&conn->tx_q, omp_next);
+        os_mbuf_free_chain(OS_MBUF_PKTHDR_TO_MBUF(omp));
+    }
+    conn->tx_queued = 0;
+
+    /* The Controller frees the buffers of a terminated BIS without
+     * reporting them as completed.
+     */
+    if (ble_iso_tx_flow_ctrl) {
+        ble_iso_tx_avail_pkts += conn->tx_outstanding;
+    }
+    conn->tx_outstanding = 0;
+}
+#endif
+
 static int
 ble_iso_big_free(struct ble_iso_big *big)
 {
     struct ble_iso_conn *conn;
+    struct ble_iso_conn *prev;
+    struct ble_iso_conn *next;
 
-    SLIST_FOREACH(conn, &ble_iso_conns, next) {
+    ble_hs_lock();
+
+    prev = NULL;
+    for (conn = SLIST_FIRST(&ble_iso_conns); conn != NULL; conn = next) {
         struct ble_iso_bis *bis;
 
+        next = SLIST_NEXT(conn, next);
+
         if (conn->type != BLE_ISO_CONN_BIS) {
+            prev = conn;
             continue;
         }
 
         bis = CONTAINER_OF(conn, struct ble_iso_bis, conn);
-        if (bis->big == big) {
-            SLIST_REMOVE(&ble_iso_conns, conn, ble_iso_conn, next);
-            os_memblock_put(&ble_iso_bis_pool, bis);
+        if (bis->big != big) {
+            prev = conn;
+            continue;
+        }
+
+        if (prev == NULL) {
+            SLIST_REMOVE_HEAD(&ble_iso_conns, next);
+        } else {
+            SLIST_NEXT(prev, next) = next;
         }
+
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+        ble_iso_conn_tx_flush(conn);
+#endif
+        os_memblock_put(&ble_iso_bis_pool, bis);
     }
 
     SLIST_REMOVE(&ble_iso_bigs, big, ble_iso_big, next);
     os_memblock_put(&ble_iso_big_pool, big);
+
+    ble_hs_unlock();
+
     return 0;
 }
 
@@ -381,127 +466,391 @@ ble_iso_rx_terminate_big_complete(const struct ble_hci_ev_le_subev_terminate_big
     ble_iso_big_free(big);
 }
 
+void
+ble_iso_tx_set_buf_sz(uint16_t pktlen, uint8_t max_pkts)
+{
+    struct ble_iso_conn *conn;
+
+    ble_hs_lock();
+
+    /* Without Controller ISO Data buffer info packets are sent as soon as
+     * they are ready.
+     */
+    if (pktlen <= sizeof(uint32_t) + sizeof(struct ble_hci_iso_data) ||
+        max_pkts == 0) {
+        ble_iso_tx_buf_len = MYNEWT_VAL(BLE_TRANSPORT_ISO_SIZE);
+        ble_iso_tx_avail_pkts = 0;
+        ble_iso_tx_flow_ctrl = 0;
+    } else {
+        ble_iso_tx_buf_len = min(pktlen, MYNEWT_VAL(BLE_TRANSPORT_ISO_SIZE));
+        ble_iso_tx_avail_pkts = max_pkts;
+        ble_iso_tx_flow_ctrl = 1;
+    }
+
+    SLIST_FOREACH(conn, &ble_iso_conns, next) {
+        conn->tx_outstanding = 0;
+    }
+
+    ble_hs_unlock();
+}
+
 static int
-ble_iso_tx_complete(uint16_t conn_handle, const uint8_t *data,
-                    uint16_t data_len)
+ble_iso_tx_pkt_now(struct ble_iso_conn *conn, struct os_mbuf *om)
 {
-    struct os_mbuf *om;
     int rc;
 
-    om = ble_hs_mbuf_bare_pkt();
-    if (!om) {
-        return BLE_HS_ENOMEM;
-    }
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
-    os_mbuf_extend(om, 8);
-    /* Connection_Handle, PB_Flag, TS_Flag */
-    put_le16(&om->om_data[0],
-             BLE_HCI_ISO_HANDLE(conn_handle, BLE_HCI_ISO_PB_COMPLETE, 0));
-    /* Data_Total_Length = Data length + Packet_Sequence_Number placeholder */
-    put_le16(&om->om_data[2], data_len + 4);
-    /* Packet_Sequence_Number placeholder */
-    put_le16(&om->om_data[4], 0);
-    /* ISO_SDU_Length */
-    put_le16(&om->om_data[6], data_len);
+    if (ble_iso_tx_flow_ctrl) {
+        ble_iso_tx_avail_pkts--;
+    }
+    conn->tx_outstanding++;
 
-    rc = os_mbuf_append(om, data, data_len);
-    if (rc) {
-        return rc;
+    rc = ble_transport_to_ll_iso(om);
+    if (rc != 0) {
+        if (ble_iso_tx_flow_ctrl) {
+            ble_iso_tx_avail_pkts++;
+        }
+        conn->tx_outstanding--;
     }
 
-    return ble_transport_to_ll_iso(om);
+    return rc;
 }
 
 static int
-ble_iso_tx_segmented(uint16_t conn_handle, const uint8_t *data,
-                     uint16_t data_len)
+ble_iso_tx_pkt(struct ble_iso_conn *conn, struct os_mbuf *om)
 {
-    struct os_mbuf *om;
-    uint16_t data_left = data_len;
-    uint16_t packet_len;
-    uint16_t offset = 0;
-    uint8_t pb;
-    int rc;
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
-    while (data_left) {
-        packet_len = min(MYNEWT_VAL(BLE_TRANSPORT_ISO_SIZE), data_left);
-        if (data_left == data_len) {
-            pb = BLE_HCI_ISO_PB_FIRST;
-        } else if (packet_len == data_left) {
-            pb = BLE_HCI_ISO_PB_LAST;
-        } else {
-            pb = BLE_HCI_ISO_PB_CONTINUATION;
+    if (ble_iso_tx_flow_ctrl &&
+        (ble_iso_tx_avail_pkts == 0 || !STAILQ_EMPTY(&conn->tx_q))) {
+        STAILQ_INSERT_TAIL(&conn->tx_q, OS_MBUF_PKTHDR(om), omp_next);
+        conn->tx_queued++;
+        return 0;
+    }
+
+    return ble_iso_tx_pkt_now(conn, om);
+}
+
+/**
+ * Sends queued packets while the Controller has free buffers. BISes are
+ * served round-robin, one packet at a time, so that a BIS with a long queue
+ * does not starve the others.
+ */
+static void
+ble_iso_tx_drain(void)
+{
+    struct ble_iso_conn *conn;
+    struct os_mbuf_pkthdr *omp;
+    int queued;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    do {
+        queued = 0;
+
+        SLIST_FOREACH(conn, &ble_iso_conns, next) {
+            if (ble_iso_tx_avail_pkts == 0) {
+                return;
+            }
+
+            omp = STAILQ_FIRST(&conn->tx_q);
+            if (omp == NULL) {
+                continue;
+            }
+
+            STAILQ_REMOVE_HEAD(&conn->tx_q, omp_next);
+            conn->tx_queued--;
+
+            /* On transport error the packet is lost; the SDU is
+             * incomplete anyway.
+             */
+            ble_iso_tx_pkt_now(conn, OS_MBUF_PKTHDR_TO_MBUF(omp));
+
+            if (!STAILQ_EMPTY(&conn->tx_q)) {
+                queued = 1;
+            }
         }
+    } while (queued);
+}
 
-        om = ble_hs_mbuf_bare_pkt();
-        if (!om) {
-            return BLE_HS_ENOMEM;
+void
+ble_iso_rx_num_completed_pkts(uint16_t conn_handle, uint16_t num_pkts)
+{
+    struct ble_iso_event event;
+    struct ble_iso_conn *conn;
+    struct ble_iso_bis *bis;
+    ble_iso_event_fn *cb;
+    void *cb_arg;
+
+    ble_hs_lock();
+
+    conn = ble_iso_conn_lookup_handle(conn_handle);
+    if (conn == NULL) {
+        ble_hs_unlock();
+        return;
+    }
+
+    /* Unlike ACL, where every connection is gone before the buffer size is
+     * read again and an excess count can only be a Controller error that
+     * resets the host, BISes outlive ble_iso_tx_set_buf_sz().  It writes off
+     * their outstanding packets, whose completions may still arrive here.
+     * Only the packets this BIS has outstanding are credited back.
+     */
+    if (conn->tx_outstanding < num_pkts) {
+        BLE_HS_LOG_ERROR("Unexpected num_pkts=%d > outstanding=%d "
+                         "handle=%d\n", num_pkts, conn->tx_outstanding,
+                         conn_handle);
+        num_pkts = conn->tx_outstanding;
+        if (num_pkts == 0) {
+            ble_hs_unlock();
+            return;
         }
+    }
 
-        os_mbuf_extend(om, pb == BLE_HCI_ISO_PB_FIRST ? 8: 4);
+    conn->tx_outstanding -= num_pkts;
 
-        /* Connection_Handle, PB_Flag, TS_Flag */
-        put_le16(&om->om_data[0],
-                 BLE_HCI_ISO_HANDLE(conn_handle, pb, 0));
+    if (ble_iso_tx_flow_ctrl) {
+        ble_iso_tx_avail_pkts += num_pkts;
+        ble_iso_tx_drain();
+    }
 
-        if (pb == BLE_HCI_ISO_PB_FIRST) {
-            /* Data_Total_Length = Data length +
-             * Packet_Sequence_Number placeholder*/
-            put_le16(&om->om_data[2], packet_len + 4);
+    memset(&event, 0, sizeof(event));
+    event.type = BLE_ISO_EVENT_ISO_TX_COMPLETE;
+    event.iso_tx_complete.conn_handle = conn_handle;
+    event.iso_tx_complete.num_pkts = num_pkts;
+    event.iso_tx_complete.pending_pkts = conn->tx_outstanding +
+                                         conn->tx_queued;
+
+    /* BISes of a BIG created locally report to the BIG callback */
+    cb = conn->cb;
+    cb_arg = conn->cb_arg;
+    if (cb == NULL && conn->type == BLE_ISO_CONN_BIS) {
+        bis = CONTAINER_OF(conn, struct ble_iso_bis, conn);
+        cb = bis->big->cb;
+        cb_arg = bis->big->cb_arg;
+    }
 
-            /* Packet_Sequence_Number placeholder */
-            put_le16(&om->om_data[8], 0);
+    ble_hs_unlock();
 
-            /* ISO_SDU_Length */
-            put_le16(&om->om_data[10], packet_len);
+    if (cb != NULL) {
+        cb(&event, cb_arg);
+    }
+}
+
+/**
+ * Detaches the SDU data following the first 'len' bytes of 'om' into a new
+ * packet with leading space for the HCI ISO data header. Only the bytes of
+ * the mbuf crossing the boundary are copied; the remaining mbufs of the
+ * chain are moved to the new packet.
+ */
+static struct os_mbuf *
+ble_iso_tx_frag_split(struct os_mbuf *om, uint16_t len)
+{
+    struct os_mbuf *frag;
+    struct os_mbuf *last;
+    struct os_mbuf *rest;
+    uint16_t off;
+    uint16_t tail;
+    int rc;
+
+    last = NULL;
+    rest = om;
+    off = 0;
+    while (off + rest->om_len <= len) {
+        off += rest->om_len;
+        last = rest;
+        rest = SLIST_NEXT(rest, om_next);
+    }
+
+    frag = ble_hs_mbuf_iso_cont_pkt();
+    if (frag == NULL) {
+        return NULL;
+    }
+
+    if (off < len) {
+        /* Boundary within an mbuf */
+        tail = off + rest->om_len - len;
+        rc = os_mbuf_append(frag, rest->om_data + rest->om_len - tail, tail);
+        if (rc != 0) {
+            os_mbuf_free_chain(frag);
+            return NULL;
+        }
+
+        rest->om_len -= tail;
+        last = rest;
+        rest = SLIST_NEXT(rest, om_next);
+    }
+
+    SLIST_NEXT(last, om_next) = NULL;
+    OS_MBUF_PKTHDR(om)->omp_len = len;
+
+    if (rest != NULL) {
+        os_mbuf_concat(frag, rest);
+    }
+
+    return frag;
+}
+
+/**
+ * Splits an SDU into HCI ISO Data packets, adding the packet headers in the
+ * leading space of the SDU and of the continuation packets.
+ */
+static int
+ble_iso_tx_sdu_frag(uint16_t conn_handle, struct os_mbuf *om,
+                    uint16_t seq_num, const uint32_t *ts, uint16_t buf_len,
+                    struct ble_iso_tx_pkts *pkts)
+{
+    struct ble_hci_iso_data *iso_data;
+    struct ble_hci_iso *hci_iso;
+    struct os_mbuf *frag;
+    uint16_t load_hdr_len;
+    uint16_t sdu_len;
+    uint16_t hdr_len;
+    uint8_t *data;
+    uint8_t pb;
+
+    sdu_len = OS_MBUF_PKTLEN(om);
+    load_hdr_len = sizeof(*iso_data) + (ts != NULL ? sizeof(*ts) : 0);
+
+    /* The first packet carries the ISO data load header */
+    hdr_len = load_hdr_len;
+    pb = BLE_HCI_ISO_PB_FIRST;
+
+    while (om != NULL) {
+        if (OS_MBUF_PKTLEN(om) + hdr_len > buf_len) {
+            frag = ble_iso_tx_frag_split(om, buf_len - hdr_len);
+            if (frag == NULL) {
+                os_mbuf_free_chain(om);
+                return BLE_HS_ENOMEM;
+            }
         } else {
-            put_le16(&om->om_data[2], packet_len);
+            frag = NULL;
+            pb = pb == BLE_HCI_ISO_PB_FIRST ? BLE_HCI_ISO_PB_COMPLETE :
+                                              BLE_HCI_ISO_PB_LAST;
         }
 
-        rc = os_mbuf_append(om, data + offset, packet_len);
-        if (rc) {
-            return rc;
+        om = os_mbuf_prepend_pullup(om, sizeof(*hci_iso) + hdr_len);
+        if (om == NULL) {
+            os_mbuf_free_chain(frag);
+            return BLE_HS_ENOMEM;
+        }
+
+        hci_iso = (void *)om->om_data;
+        put_le16(&hci_iso->handle,
+                 BLE_HCI_ISO_HANDLE(conn_handle, pb,
+                                    hdr_len > sizeof(*iso_data)));
+        put_le16(&hci_iso->length, OS_MBUF_PKTLEN(om) - sizeof(*hci_iso));
+
+        if (hdr_len > 0) {
+            data = om->om_data + sizeof(*hci_iso);
+            if (ts != NULL) {
+                put_le32(data, *ts);
+                data += sizeof(*ts);
+            }
+
+            iso_data = (void *)data;
+            put_le16(&iso_data->packet_seq_num, seq_num);
+            put_le16(&iso_data->sdu_len, sdu_len);
         }
 
-        ble_transport_to_ll_iso(om);
+        STAILQ_INSERT_TAIL(pkts, OS_MBUF_PKTHDR(om), omp_next);
 
-        offset += packet_len;
-        data_left -= packet_len;
+        om = frag;
+        hdr_len = 0;
+        pb = BLE_HCI_ISO_PB_CONTINUATION;
     }
 
     return 0;
 }
 
 int
-ble_iso_tx(uint16_t conn_handle, void *data, uint16_t data_len)
+ble_iso_tx_mbuf(uint16_t conn_handle, struct os_mbuf *om,
+                const struct ble_iso_tx_data_info *info)
 {
+    struct ble_iso_tx_pkts pkts = STAILQ_HEAD_INITIALIZER(pkts);
+    struct os_mbuf_pkthdr *omp;
+    struct ble_iso_conn *conn;
+    const uint32_t *ts;
+    uint16_t seq_num;
+    uint16_t buf_len;
     int rc;
 
-    if (data_len <= MYNEWT_VAL(BLE_TRANSPORT_ISO_SIZE)) {
-        rc = ble_iso_tx_complete(conn_handle, data, data_len);
+    if (OS_MBUF_PKTLEN(om) > BLE_HCI_ISO_SDU_LENGTH_MASK) {
+        os_mbuf_free_chain(om);
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    conn = ble_iso_conn_lookup_handle(conn_handle);
+    if (conn == NULL) {
+        ble_hs_unlock();
+        os_mbuf_free_chain(om);
+        return BLE_HS_ENOTCONN;
+    }
+
+    if (info != NULL) {
+        seq_num = info->seq_num;
+        ts = info->ts_valid ? &info->ts : NULL;
     } else {
-        rc = ble_iso_tx_segmented(conn_handle, data, data_len);
+        seq_num = conn->tx_seq_num;
+        ts = NULL;
+    }
+    conn->tx_seq_num = seq_num + 1;
+    buf_len = ble_iso_tx_buf_len;
+
+    ble_hs_unlock();
+
+    rc = ble_iso_tx_sdu_frag(conn_handle, om, seq_num, ts, buf_len, &pkts);
+
+    ble_hs_lock();
+
+    /* The BIS may have been terminated in the meantime */
+    conn = ble_iso_conn_lookup_handle(conn_handle);
+    if (conn == NULL && rc == 0) {
+        rc = BLE_HS_ENOTCONN;
+    }
+
+    /* Packets of a partially fragmented SDU are dropped */
+    while ((omp = STAILQ_FIRST(&pkts)) != NULL) {
+        STAILQ_REMOVE_HEAD(&pkts, omp_next);
+        om = OS_MBUF_PKTHDR_TO_MBUF(omp);
+
+        if (rc != 0) {
+            os_mbuf_free_chain(om);
+        } else {
+            rc = ble_iso_tx_pkt(conn, om);
+        }
     }
 
+    ble_hs_unlock();
+
     return rc;
 }
-#endif /* BLE_ISO_BROADCAST_SOURCE */
 
-#if MYNEWT_VAL(BLE_ISO_BROADCAST_SINK)
-static struct ble_iso_conn *
-ble_iso_conn_lookup_handle(uint16_t handle)
+int
+ble_iso_tx(uint16_t conn_handle, void *data, uint16_t data_len)
 {
-    struct ble_iso_conn *conn;
+    struct os_mbuf *om;
+    int rc;
 
-    SLIST_FOREACH(conn, &ble_iso_conns, next) {
-        if (conn->handle == handle) {
-            return conn;
-        }
+    om = ble_hs_mbuf_iso_pkt();
+    if (om == NULL) {
+        return BLE_HS_ENOMEM;
     }
 
-    return NULL;
+    rc = os_mbuf_append(om, data, data_len);
+    if (rc != 0) {
+        os_mbuf_free_chain(om);
+        return BLE_HS_ENOMEM;
+    }
+
+    return ble_iso_tx_mbuf(conn_handle, om, NULL);
 }
+#endif /* BLE_ISO_BROADCAST_SOURCE */
 
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SINK)
 int
 ble_iso_big_sync_create(const struct ble_iso_big_sync_create_params *param,
                         uint8_t *big_handle)
@@ -929,6 +1278,7 @@ ble_iso_init(void)
     int rc;
 
     SLIST_INIT(&ble_iso_bigs);
+    SLIST_INIT(&ble_iso_conns);
 
     rc = os_mempool_init(&ble_iso_big_pool,
                          MYNEWT_VAL(BLE_ISO_MAX_BIGS),
@@ -40,6 +40,12 @@ ble_iso_rx_big_sync_lost(const struct ble_hci_ev_le_subev_big_sync_lost *ev);
 int
 ble_iso_rx_data(struct os_mbuf *om, void *arg);
 
+void
+ble_iso_rx_num_completed_pkts(uint16_t conn_handle, uint16_t num_pkts);
+
+void
+ble_iso_tx_set_buf_sz(uint16_t pktlen, uint8_t max_pkts);
+
 #ifdef __cplusplus
 }
 #endif
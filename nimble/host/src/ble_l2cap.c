@@ -174,6 +174,9 @@ ble_l2cap_get_chan_info(struct ble_l2cap_chan *chan, struct ble_l2cap_chan_info
     chan_info->psm = chan->psm;
     chan_info->our_coc_mtu = chan->coc_rx.mtu;
     chan_info->peer_coc_mtu = chan->coc_tx.mtu;
+    chan_info->rx_credit_window = ble_l2cap_coc_rx_window(chan);
+    chan_info->tx_stall_ms = ble_l2cap_coc_stall_ms(&chan->coc_tx);
+    chan_info->rx_stall_ms = ble_l2cap_coc_stall_ms(&chan->coc_rx);
 #endif
 
     return 0;
@@ -468,7 +471,7 @@ ble_l2cap_tx(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan,
 
     case BLE_HS_EAGAIN:
         /* Controller could not accommodate full packet.  Enqueue remainder. */
-        STAILQ_INSERT_TAIL(&conn->bhc_tx_q, OS_MBUF_PKTHDR(txom), omp_next);
+        ble_hs_tx_q_push(conn, txom);
         return 0;
 
     default:
@@ -29,6 +29,14 @@
 
 #define BLE_L2CAP_SDU_SIZE              2
 
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef max
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
 STAILQ_HEAD(ble_l2cap_coc_srv_list, ble_l2cap_coc_srv);
 
 static struct ble_l2cap_coc_srv_list ble_l2cap_coc_srvs;
@@ -170,6 +178,209 @@ ble_l2cap_event_coc_received_data(struct ble_l2cap_chan *chan,
     chan->cb(&event, chan->cb_arg);
 }
 
+static void
+ble_l2cap_coc_stall_begin(struct ble_l2cap_coc_endpoint *ep)
+{
+    if (!(ep->flags & BLE_L2CAP_COC_FLAG_NO_CREDITS)) {
+        ep->flags |= BLE_L2CAP_COC_FLAG_NO_CREDITS;
+        ep->stall_start = ble_npl_time_get();
+    }
+}
+
+static void
+ble_l2cap_coc_stall_end(struct ble_l2cap_coc_endpoint *ep)
+{
+    if (ep->flags & BLE_L2CAP_COC_FLAG_NO_CREDITS) {
+        ep->flags &= ~BLE_L2CAP_COC_FLAG_NO_CREDITS;
+        ep->stall_ms += ble_npl_time_ticks_to_ms32(ble_npl_time_get() -
+                                                   ep->stall_start);
+    }
+}
+
+uint32_t
+ble_l2cap_coc_stall_ms(const struct ble_l2cap_coc_endpoint *ep)
+{
+    uint32_t ms;
+
+    ms = ep->stall_ms;
+    if (ep->flags & BLE_L2CAP_COC_FLAG_NO_CREDITS) {
+        ms += ble_npl_time_ticks_to_ms32(ble_npl_time_get() - ep->stall_start);
+    }
+
+    return ms;
+}
+
+/* Adds `credits` to the RX credits of the channel.  Called with the host
+ * locked.
+ */
+static void
+ble_l2cap_coc_rx_add_credits(struct ble_l2cap_coc_endpoint *rx,
+                             uint16_t credits)
+{
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+    if (rx->credits == 0) {
+        /* Peer is idle until these credits arrive, so its next K-frame
+         * completes a credit round trip.
+         */
+        rx->flags |= BLE_L2CAP_COC_FLAG_RTT_PENDING;
+        rx->credits_tx_time = ble_npl_time_get();
+    }
+#endif
+
+    rx->credits += credits;
+    ble_l2cap_coc_stall_end(rx);
+}
+
+/* Hands `credits` more RX credits to the peer.  Called with the host
+ * unlocked.
+ */
+static void
+ble_l2cap_coc_rx_give_credits(struct ble_l2cap_chan *chan, uint16_t credits)
+{
+    ble_hs_lock();
+    ble_l2cap_coc_rx_add_credits(&chan->coc_rx, credits);
+    ble_hs_unlock();
+
+    ble_l2cap_sig_le_credits(chan->conn_handle, chan->scid, credits);
+}
+
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+static void
+ble_l2cap_coc_rx_sample(struct ble_l2cap_coc_endpoint *rx)
+{
+    ble_npl_time_t now;
+    uint32_t sample;
+
+    now = ble_npl_time_get();
+
+    if (rx->flags & BLE_L2CAP_COC_FLAG_RTT_PENDING) {
+        rx->flags &= ~BLE_L2CAP_COC_FLAG_RTT_PENDING;
+
+        sample = max(now - rx->credits_tx_time, 1);
+        if (rx->srtt == 0) {
+            rx->srtt = sample << 3;
+        } else {
+            rx->srtt += sample - (rx->srtt >> 3);
+        }
+    } else if (rx->last_rx_time != 0) {
+        sample = now - rx->last_rx_time;
+
+        /* A gap longer than the round trip means the peer had nothing to
+         * send, which says nothing about the link.
+         */
+        if (rx->srtt == 0 || (sample << 3) <= rx->srtt) {
+            rx->frame_itvl += sample - (rx->frame_itvl >> 3);
+        }
+    }
+
+    rx->last_rx_time = now;
+}
+
+/* Number of K-frames the queued SDU buffers can still take in. */
+static uint16_t
+ble_l2cap_coc_rx_buf_credits(const struct ble_l2cap_chan *chan)
+{
+    const struct ble_l2cap_coc_endpoint *rx = &chan->coc_rx;
+    struct os_mbuf *sdu;
+    uint32_t credits;
+    int i;
+
+    credits = 0;
+    for (i = 0; i < BLE_L2CAP_SDU_BUFF_CNT; i++) {
+        sdu = rx->sdus[(rx->current_sdu_idx + i) % BLE_L2CAP_SDU_BUFF_CNT];
+        if (!sdu) {
+            break;
+        }
+
+        if (i == 0 && rx->data_offset != 0) {
+            /* In RX case data_offset keeps incoming SDU len */
+            credits += (rx->data_offset - OS_MBUF_PKTLEN(sdu) +
+                        chan->my_coc_mps - 1) / chan->my_coc_mps;
+        } else {
+            credits += chan->initial_credits;
+        }
+    }
+
+    return min(credits, UINT16_MAX);
+}
+
+static uint16_t
+ble_l2cap_coc_rx_window_calc(const struct ble_l2cap_chan *chan)
+{
+    const struct ble_l2cap_coc_endpoint *rx = &chan->coc_rx;
+    uint32_t window;
+    int blocks;
+    int cap;
+
+    if (rx->srtt == 0) {
+        /* Nothing measured yet, stay at one SDU worth of credits. */
+        window = chan->initial_credits;
+    } else {
+        /* Twice the number of K-frames the peer sends per credit round trip,
+         * so credits returned at half window arrive before it runs dry.
+         */
+        window = 2 * (rx->srtt / max(rx->frame_itvl, 1 << 3) + 1);
+    }
+
+    window = min(window, MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_MAX_CREDITS));
+
+    /* K-frames in flight sit in msys until copied into the SDU; leave half of
+     * the free blocks to everybody else.  The default MPS fills one block.
+     */
+    blocks = (chan->my_coc_mps + MYNEWT_VAL(BLE_L2CAP_COC_MPS) - 1) /
+             MYNEWT_VAL(BLE_L2CAP_COC_MPS);
+    cap = os_msys_num_free() / 2 / blocks;
+    if (window > cap) {
+        window = cap;
+    }
+
+    return max(window, 1);
+}
+
+/* Called with the host unlocked. */
+static void
+ble_l2cap_coc_rx_credits_update(struct ble_l2cap_chan *chan)
+{
+    struct ble_l2cap_coc_endpoint *rx = &chan->coc_rx;
+    uint16_t credits;
+    uint16_t target;
+
+    credits = 0;
+
+    ble_hs_lock();
+
+    rx->window = ble_l2cap_coc_rx_window_calc(chan);
+    target = min(rx->window, ble_l2cap_coc_rx_buf_credits(chan));
+
+    /* Return credits in batches: once the peer used up half of the window,
+     * or right away if it has none left.
+     */
+    if (target > rx->credits &&
+        (rx->credits == 0 || rx->credits <= target / 2)) {
+        credits = target - rx->credits;
+        ble_l2cap_coc_rx_add_credits(rx, credits);
+    }
+
+    ble_hs_unlock();
+
+    if (credits > 0) {
+        ble_l2cap_sig_le_credits(chan->conn_handle, chan->scid, credits);
+    }
+}
+#endif
+
+uint16_t
+ble_l2cap_coc_rx_window(const struct ble_l2cap_chan *chan)
+{
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+    if (chan->coc_rx.window != 0) {
+        return chan->coc_rx.window;
+    }
+#endif
+
+    return chan->initial_credits;
+}
+
 static int
 ble_l2cap_coc_rx_fn(struct ble_l2cap_chan *chan)
 {
@@ -188,7 +399,12 @@ ble_l2cap_coc_rx_fn(struct ble_l2cap_chan *chan)
     BLE_HS_DBG_ASSERT(rx != NULL);
 
     rx_sdu = rx->sdus[chan->coc_rx.current_sdu_idx];
-    BLE_HS_DBG_ASSERT(rx_sdu != NULL);
+    if (rx_sdu == NULL) {
+        /* Peer used a credit which was not backed by an SDU buffer */
+        BLE_HS_LOG(ERROR, "No SDU buffer for received LE frame\n");
+        ble_l2cap_disconnect(chan);
+        return BLE_HS_EBADDATA;
+    }
 
     om_total = OS_MBUF_PKTLEN(*om);
 
@@ -263,7 +479,18 @@ ble_l2cap_coc_rx_fn(struct ble_l2cap_chan *chan)
         }
     }
 
+    ble_hs_lock();
+
     rx->credits--;
+    if (rx->credits == 0) {
+        ble_l2cap_coc_stall_begin(rx);
+    }
+
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+    ble_l2cap_coc_rx_sample(rx);
+#endif
+
+    ble_hs_unlock();
 
     if (OS_MBUF_PKTLEN(rx_sdu) == rx->data_offset) {
         struct os_mbuf *sdu_rx = rx_sdu;
@@ -276,15 +503,26 @@ ble_l2cap_coc_rx_fn(struct ble_l2cap_chan *chan)
          * we need to prepare space for this. Therefore we need sdu_rx
          */
         rx_sdu = NULL;
+        rx->sdus[chan->coc_rx.current_sdu_idx] = NULL;
         chan->coc_rx.current_sdu_idx =
             (chan->coc_rx.current_sdu_idx + 1) % BLE_L2CAP_SDU_BUFF_CNT;
         rx->data_offset = 0;
 
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+        /* Keep the peer going into the next queued buffer while the
+         * application handles this SDU.
+         */
+        ble_l2cap_coc_rx_credits_update(chan);
+#endif
+
         ble_l2cap_event_coc_received_data(chan, sdu_rx);
 
         return 0;
     }
 
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+    ble_l2cap_coc_rx_credits_update(chan);
+#else
     /* If we did not received full SDU and credits are 0 it means
      * that remote was sending us not fully filled up LE frames.
      * However, we still have buffer to for next LE Frame so lets give one more
@@ -294,9 +532,9 @@ ble_l2cap_coc_rx_fn(struct ble_l2cap_chan *chan)
         /* Remote did not send full SDU. Lets give him one more credits to do
          * so since we have still buffer to handle it
          */
-        rx->credits = 1;
-        ble_l2cap_sig_le_credits(chan->conn_handle, chan->scid, rx->credits);
+        ble_l2cap_coc_rx_give_credits(chan, 1);
     }
+#endif
 
     BLE_HS_LOG(DEBUG,
                "Received partial sdu_len=%d, credits left=%d, current_sdu_idx=%d\n",
@@ -436,6 +674,57 @@ ble_l2cap_event_coc_unstalled(struct ble_l2cap_chan *chan, int status)
     chan->cb(&event, chan->cb_arg);
 }
 
+/**
+ * Moves the first `len` bytes of a pending SDU to the end of a K-frame.
+ *
+ * The SDU is kept behind an empty packet header mbuf (see
+ * ble_l2cap_coc_send()), so any mbuf which fits entirely into the K-frame is
+ * unlinked from the SDU and chained into the frame without touching its data.
+ * Only the mbuf straddling the frame boundary gets its leading part copied.
+ */
+static int
+ble_l2cap_coc_frame_fill(struct os_mbuf *frame, struct os_mbuf *sdu,
+                         uint16_t len)
+{
+    struct os_mbuf *last;
+    struct os_mbuf *om;
+    int rc;
+
+    last = frame;
+    while (SLIST_NEXT(last, om_next) != NULL) {
+        last = SLIST_NEXT(last, om_next);
+    }
+
+    while (len > 0) {
+        om = SLIST_NEXT(sdu, om_next);
+        BLE_HS_DBG_ASSERT(om != NULL);
+
+        if (om->om_len > len) {
+            /* Frame ends inside this mbuf. */
+            rc = os_mbuf_append(frame, om->om_data, len);
+            if (rc != 0) {
+                return BLE_HS_ENOMEM;
+            }
+
+            om->om_data += len;
+            om->om_len -= len;
+            OS_MBUF_PKTLEN(sdu) -= len;
+            break;
+        }
+
+        SLIST_NEXT(sdu, om_next) = SLIST_NEXT(om, om_next);
+        SLIST_NEXT(om, om_next) = NULL;
+        SLIST_NEXT(last, om_next) = om;
+        last = om;
+
+        OS_MBUF_PKTLEN(sdu) -= om->om_len;
+        OS_MBUF_PKTLEN(frame) += om->om_len;
+        len -= om->om_len;
+    }
+
+    return 0;
+}
+
 /* WARNING: this function is called from different task contexts. We expect the
  * host to be locked (ble_hs_lock()) before entering this function! */
 static int
@@ -443,7 +732,7 @@ ble_l2cap_coc_continue_tx(struct ble_l2cap_chan *chan)
 {
     struct ble_l2cap_coc_endpoint *tx;
     uint16_t len;
-    uint16_t left_to_send;
+    uint32_t left_to_send;
     struct os_mbuf *txom;
     struct ble_hs_conn *conn;
     uint16_t sdu_size_offset;
@@ -462,7 +751,7 @@ ble_l2cap_coc_continue_tx(struct ble_l2cap_chan *chan)
         BLE_HS_LOG(DEBUG, "Available credits %d\n", tx->credits);
 
         /* lets calculate data we are going to send */
-        left_to_send = OS_MBUF_PKTLEN(tx->sdus[0]) - tx->data_offset;
+        left_to_send = OS_MBUF_PKTLEN(tx->sdus[0]);
 
         if (tx->data_offset == 0) {
             sdu_size_offset = BLE_L2CAP_SDU_SIZE;
@@ -472,7 +761,9 @@ ble_l2cap_coc_continue_tx(struct ble_l2cap_chan *chan)
         /* Take into account peer MTU */
         len = min(left_to_send, chan->peer_coc_mps);
 
-        /* Prepare packet */
+        /* Prepare packet.  Only headers go into this mbuf, SDU data is
+         * chained behind it.
+         */
         txom = ble_hs_mbuf_l2cap_pkt();
         if (!txom) {
             BLE_HS_LOG(DEBUG, "Could not prepare l2cap packet len %d", len);
@@ -498,10 +789,8 @@ ble_l2cap_coc_continue_tx(struct ble_l2cap_chan *chan)
          * that for first packet we need to decrease data size by 2 bytes for sdu
          * size
          */
-        rc = os_mbuf_appendfrom(txom, tx->sdus[0], tx->data_offset,
-                                len - sdu_size_offset);
+        rc = ble_l2cap_coc_frame_fill(txom, tx->sdus[0], len - sdu_size_offset);
         if (rc) {
-            rc = BLE_HS_ENOMEM;
             BLE_HS_LOG(DEBUG, "Could not append data rc=%d", rc);
             goto failed;
         }
@@ -519,10 +808,9 @@ ble_l2cap_coc_continue_tx(struct ble_l2cap_chan *chan)
         }
 
         BLE_HS_LOG(DEBUG, "Sent %d bytes, credits=%d, to send %d bytes \n",
-                   len, tx->credits,
-                   OS_MBUF_PKTLEN(tx->sdus[0]) - tx->data_offset);
+                   len, tx->credits, OS_MBUF_PKTLEN(tx->sdus[0]));
 
-        if (tx->data_offset == OS_MBUF_PKTLEN(tx->sdus[0])) {
+        if (OS_MBUF_PKTLEN(tx->sdus[0]) == 0) {
             BLE_HS_LOG(DEBUG, "Complete package sent\n");
             os_mbuf_free_chain(tx->sdus[0]);
             tx->sdus[0] = NULL;
@@ -534,6 +822,7 @@ ble_l2cap_coc_continue_tx(struct ble_l2cap_chan *chan)
     if (tx->sdus[0]) {
         /* Not complete SDU sent, wait for credits */
         tx->flags |= BLE_L2CAP_COC_FLAG_STALLED;
+        ble_l2cap_coc_stall_begin(tx);
         ble_hs_unlock();
         return BLE_HS_ESTALLED;
     }
@@ -593,6 +882,9 @@ ble_l2cap_coc_le_credits_update(uint16_t conn_handle, uint16_t dcid,
     }
 
     chan->coc_tx.credits += credits;
+    if (chan->coc_tx.credits > 0) {
+        ble_l2cap_coc_stall_end(&chan->coc_tx);
+    }
 
     /* leave the host locked on purpose when ble_l2cap_coc_continue_tx() */
     ble_l2cap_coc_continue_tx(chan);
@@ -626,18 +918,22 @@ ble_l2cap_coc_recv_ready(struct ble_l2cap_chan *chan, struct os_mbuf *sdu_rx)
         return BLE_HS_ENOENT;
     }
 
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+    ble_hs_unlock();
+    ble_l2cap_coc_rx_credits_update(c);
+#else
     /* We want to back only that much credits which remote side is missing
      * to be able to send complete SDU.
      */
     if (chan->coc_rx.credits < c->initial_credits) {
         ble_hs_unlock();
-        ble_l2cap_sig_le_credits(chan->conn_handle, chan->scid,
-                                 c->initial_credits - chan->coc_rx.credits);
+        ble_l2cap_coc_rx_give_credits(c, c->initial_credits -
+                                         chan->coc_rx.credits);
         ble_hs_lock();
-        chan->coc_rx.credits = c->initial_credits;
     }
 
     ble_hs_unlock();
+#endif
 
     return 0;
 }
@@ -650,7 +946,7 @@ int
 ble_l2cap_coc_send(struct ble_l2cap_chan *chan, struct os_mbuf *sdu_tx)
 {
     struct ble_l2cap_coc_endpoint *tx;
-
+    struct os_mbuf *sdu;
 
     tx = &chan->coc_tx;
 
@@ -663,8 +959,21 @@ ble_l2cap_coc_send(struct ble_l2cap_chan *chan, struct os_mbuf *sdu_tx)
         ble_hs_unlock();
         return BLE_HS_EBUSY;
     }
-    tx->sdus[0] = sdu_tx;
 
+    /* K-frames are carved off the front of the SDU chain as it is sent.  Keep
+     * the chain behind an empty packet header so the user's mbufs can be
+     * handed over to K-frames as a whole.
+     */
+    sdu = ble_hs_mbuf_bare_pkt();
+    if (!sdu) {
+        ble_hs_unlock();
+        return BLE_HS_ENOMEM;
+    }
+
+    SLIST_NEXT(sdu, om_next) = sdu_tx;
+    OS_MBUF_PKTLEN(sdu) = OS_MBUF_PKTLEN(sdu_tx);
+    tx->data_offset = 0;
+    tx->sdus[0] = sdu;
 
     /* leave the host locked on purpose when ble_l2cap_coc_continue_tx() */
     return ble_l2cap_coc_continue_tx(chan);
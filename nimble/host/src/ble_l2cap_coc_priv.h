@@ -24,6 +24,7 @@
 #include "syscfg/syscfg.h"
 #include "os/queue.h"
 #include "os/os_mbuf.h"
+#include "nimble/nimble_npl.h"
 #include "host/ble_l2cap.h"
 #include "ble_l2cap_sig_priv.h"
 #ifdef __cplusplus
@@ -36,6 +37,8 @@ extern "C" {
 struct ble_l2cap_chan;
 
 #define BLE_L2CAP_COC_FLAG_STALLED              0x01
+#define BLE_L2CAP_COC_FLAG_NO_CREDITS           0x02
+#define BLE_L2CAP_COC_FLAG_RTT_PENDING          0x04
 
 #define BLE_L2CAP_SDU_BUFF_CNT        (MYNEWT_VAL(BLE_L2CAP_COC_SDU_BUFF_COUNT))
 
@@ -49,6 +52,23 @@ struct ble_l2cap_coc_endpoint {
     uint16_t credits;
     uint16_t data_offset;
     uint8_t flags;
+
+    /* Time spent without credits, i.e. TX waiting for the peer or the peer
+     * waiting for RX credits from us.
+     */
+    ble_npl_time_t stall_start;
+    uint32_t stall_ms;
+
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+    /* RX only: credit window and its inputs, smoothed as in RFC 6298 (the
+     * stored values are scaled by 8).
+     */
+    ble_npl_time_t credits_tx_time;
+    ble_npl_time_t last_rx_time;
+    uint32_t srtt;
+    uint32_t frame_itvl;
+    uint16_t window;
+#endif
 };
 
 struct ble_l2cap_coc_srv {
@@ -77,6 +97,8 @@ int ble_l2cap_coc_recv_ready(struct ble_l2cap_chan *chan,
                              struct os_mbuf *sdu_rx);
 int ble_l2cap_coc_send(struct ble_l2cap_chan *chan, struct os_mbuf *sdu_tx);
 void ble_l2cap_coc_set_new_mtu_mps(struct ble_l2cap_chan *chan, uint16_t mtu, uint16_t mps);
+uint32_t ble_l2cap_coc_stall_ms(const struct ble_l2cap_coc_endpoint *ep);
+uint16_t ble_l2cap_coc_rx_window(const struct ble_l2cap_chan *chan);
 #else
 static inline int
 ble_l2cap_coc_init(void) {
@@ -45,6 +45,7 @@
 #include <string.h>
 #include <errno.h>
 #include "nimble/ble.h"
+#include "os/util.h"
 #include "ble_hs_priv.h"
 
 #if NIMBLE_BLE_CONNECT
@@ -69,9 +70,10 @@
 #endif
 
 struct ble_l2cap_sig_proc {
-    STAILQ_ENTRY(ble_l2cap_sig_proc) next;
+    TAILQ_ENTRY(ble_l2cap_sig_proc) next;
 
     ble_npl_time_t exp_os_ticks;
+    struct ble_hs_deadline exp_dl;
     uint16_t conn_handle;
     uint8_t op;
     uint8_t id;
@@ -99,10 +101,12 @@ struct ble_l2cap_sig_proc {
     };
 };
 
-STAILQ_HEAD(ble_l2cap_sig_proc_list, ble_l2cap_sig_proc);
+TAILQ_HEAD(ble_l2cap_sig_proc_list, ble_l2cap_sig_proc);
 
 static struct ble_l2cap_sig_proc_list ble_l2cap_sig_procs;
 
+static ble_hs_deadline_fn ble_l2cap_sig_proc_exp;
+
 typedef int ble_l2cap_sig_rx_fn(uint16_t conn_handle,
                                 struct ble_l2cap_sig_hdr *hdr,
                                 struct os_mbuf **om);
@@ -179,7 +183,7 @@ ble_l2cap_sig_dbg_assert_proc_not_inserted(struct ble_l2cap_sig_proc *proc)
 #if MYNEWT_VAL(BLE_HS_DEBUG)
     struct ble_l2cap_sig_proc *cur;
 
-    STAILQ_FOREACH(cur, &ble_l2cap_sig_procs, next) {
+    TAILQ_FOREACH(cur, &ble_l2cap_sig_procs, next) {
         BLE_HS_DBG_ASSERT(cur != proc);
     }
 #endif
@@ -254,7 +258,9 @@ ble_l2cap_sig_proc_insert(struct ble_l2cap_sig_proc *proc)
     ble_l2cap_sig_dbg_assert_proc_not_inserted(proc);
 
     ble_hs_lock();
-    STAILQ_INSERT_HEAD(&ble_l2cap_sig_procs, proc, next);
+    TAILQ_INSERT_HEAD(&ble_l2cap_sig_procs, proc, next);
+    ble_hs_deadline_arm(&proc->exp_dl, proc->exp_os_ticks,
+                        ble_l2cap_sig_proc_exp);
     ble_hs_unlock();
 }
 
@@ -306,21 +312,15 @@ ble_l2cap_sig_proc_extract(uint16_t conn_handle, uint8_t op,
                            uint8_t identifier)
 {
     struct ble_l2cap_sig_proc *proc;
-    struct ble_l2cap_sig_proc *prev;
 
     ble_hs_lock();
 
-    prev = NULL;
-    STAILQ_FOREACH(proc, &ble_l2cap_sig_procs, next) {
+    TAILQ_FOREACH(proc, &ble_l2cap_sig_procs, next) {
         if (ble_l2cap_sig_proc_matches(proc, conn_handle, op, identifier)) {
-            if (prev == NULL) {
-                STAILQ_REMOVE_HEAD(&ble_l2cap_sig_procs, next);
-            } else {
-                STAILQ_REMOVE_AFTER(&ble_l2cap_sig_procs, prev, next);
-            }
+            TAILQ_REMOVE(&ble_l2cap_sig_procs, proc, next);
+            ble_hs_deadline_disarm(&proc->exp_dl);
             break;
         }
-        prev = proc;
     }
 
     ble_hs_unlock();
@@ -1883,64 +1883,13 @@ ble_l2cap_sig_create_chan(uint16_t conn_handle)
     return chan;
 }
 
-/**
- * @return                      The number of ticks until the next expiration
- *                                  occurs.
- */
-static int32_t
-ble_l2cap_sig_extract_expired(struct ble_l2cap_sig_proc_list *dst_list)
-{
-    struct ble_l2cap_sig_proc *proc;
-    struct ble_l2cap_sig_proc *prev;
-    struct ble_l2cap_sig_proc *next;
-    ble_npl_time_t now;
-    ble_npl_stime_t next_exp_in;
-    ble_npl_stime_t time_diff;
-
-    now = ble_npl_time_get();
-    STAILQ_INIT(dst_list);
-
-    /* Assume each event is either expired or has infinite duration. */
-    next_exp_in = BLE_HS_FOREVER;
-
-    ble_hs_lock();
-
-    next = NULL;
-    proc = STAILQ_FIRST(&ble_l2cap_sig_procs);
-    while (proc != NULL) {
-        prev = next;
-        next = STAILQ_NEXT(proc, next);
-
-        time_diff = proc->exp_os_ticks - now;
-        if (time_diff <= 0) {
-            /* Procedure has expired; move it to the destination list. */
-            if (prev == NULL) {
-                STAILQ_REMOVE_HEAD(&ble_l2cap_sig_procs, next);
-            } else {
-                STAILQ_REMOVE_AFTER(&ble_l2cap_sig_procs, prev, next);
-            }
-            STAILQ_INSERT_TAIL(dst_list, proc, next);
-        } else {
-            if (time_diff < next_exp_in) {
-                next_exp_in = time_diff;
-            }
-        }
-
-        proc = next;
-    }
-
-    ble_hs_unlock();
-
-    return next_exp_in;
-}
-
 void
 ble_l2cap_sig_conn_broken(uint16_t conn_handle, int reason)
 {
     struct ble_l2cap_sig_proc *proc;
 
     /* Report a failure for each timed out procedure. */
-    while ((proc = STAILQ_FIRST(&ble_l2cap_sig_procs)) != NULL) {
+    while ((proc = TAILQ_FIRST(&ble_l2cap_sig_procs)) != NULL) {
         switch(proc->op) {
             case BLE_L2CAP_SIG_PROC_OP_UPDATE:
                 ble_l2cap_sig_update_call_cb(proc, reason);
@@ -1960,53 +1909,47 @@ ble_l2cap_sig_conn_broken(uint16_t conn_handle, int reason)
 #endif
             }
 
-            STAILQ_REMOVE_HEAD(&ble_l2cap_sig_procs, next);
+            ble_hs_lock();
+            TAILQ_REMOVE(&ble_l2cap_sig_procs, proc, next);
+            ble_hs_deadline_disarm(&proc->exp_dl);
+            ble_hs_unlock();
+
             ble_l2cap_sig_proc_free(proc);
     }
 
 }
 
 /**
- * Terminates expired procedures.
- *
- * @return                      The number of ticks until this function should
- *                                  be called again.
+ * Called from the host deadline heap when a procedure's unresponsive timer
+ * expires.  Reports the failure and frees the procedure.
  */
-int32_t
-ble_l2cap_sig_timer(void)
+static void
+ble_l2cap_sig_proc_exp(struct ble_hs_deadline *dl)
 {
-    struct ble_l2cap_sig_proc_list temp_list;
     struct ble_l2cap_sig_proc *proc;
-    int32_t ticks_until_exp;
 
-    /* Remove timed-out procedures from the main list and insert them into a
-     * temporary list.  This function also calculates the number of ticks until
-     * the next expiration will occur.
-     */
-    ticks_until_exp = ble_l2cap_sig_extract_expired(&temp_list);
+    proc = CONTAINER_OF(dl, struct ble_l2cap_sig_proc, exp_dl);
 
-    /* Report a failure for each timed out procedure. */
-    while ((proc = STAILQ_FIRST(&temp_list)) != NULL) {
-        STATS_INC(ble_l2cap_stats, proc_timeout);
-        switch(proc->op) {
-            case BLE_L2CAP_SIG_PROC_OP_UPDATE:
-                ble_l2cap_sig_update_call_cb(proc, BLE_HS_ETIMEOUT);
-                break;
-#if MYNEWT_VAL(BLE_L2CAP_COC_MAX_NUM) != 0
-            case BLE_L2CAP_SIG_PROC_OP_CONNECT:
-                ble_l2cap_sig_coc_connect_cb(proc, BLE_HS_ETIMEOUT);
-            break;
-            case BLE_L2CAP_SIG_PROC_OP_DISCONNECT:
-                ble_l2cap_sig_coc_disconnect_cb(proc, BLE_HS_ETIMEOUT);
+    ble_hs_lock();
+    TAILQ_REMOVE(&ble_l2cap_sig_procs, proc, next);
+    ble_hs_unlock();
+
+    STATS_INC(ble_l2cap_stats, proc_timeout);
+    switch(proc->op) {
+        case BLE_L2CAP_SIG_PROC_OP_UPDATE:
+            ble_l2cap_sig_update_call_cb(proc, BLE_HS_ETIMEOUT);
             break;
+#if MYNEWT_VAL(BLE_L2CAP_COC_MAX_NUM) != 0
+        case BLE_L2CAP_SIG_PROC_OP_CONNECT:
+            ble_l2cap_sig_coc_connect_cb(proc, BLE_HS_ETIMEOUT);
+        break;
+        case BLE_L2CAP_SIG_PROC_OP_DISCONNECT:
+            ble_l2cap_sig_coc_disconnect_cb(proc, BLE_HS_ETIMEOUT);
+        break;
 #endif
-        }
-
-        STAILQ_REMOVE_HEAD(&temp_list, next);
-        ble_l2cap_sig_proc_free(proc);
     }
 
-    return ticks_until_exp;
+    ble_l2cap_sig_proc_free(proc);
 }
 
 int
@@ -2014,7 +1957,7 @@ ble_l2cap_sig_init(void)
 {
     int rc;
 
-    STAILQ_INIT(&ble_l2cap_sig_procs);
+    TAILQ_INIT(&ble_l2cap_sig_procs);
 
     rc = os_mempool_init(&ble_l2cap_sig_proc_pool,
                          MYNEWT_VAL(BLE_L2CAP_SIG_MAX_PROCS),
@@ -541,7 +541,7 @@ ble_sm_persist_keys(struct ble_sm_proc *proc)
         peer_addr.type = proc->peer_keys.addr_type;
         memcpy(peer_addr.val, proc->peer_keys.addr, sizeof peer_addr.val);
 
-        conn->bhc_peer_addr = peer_addr;
+        ble_hs_conn_set_peer_addr(conn, &peer_addr);
 
         /* Update identity address in conn.
          * If peer's rpa address is set then it means that the peer's address
@@ -2855,6 +2855,11 @@ ble_sm_init(void)
         return rc;
     }
 
+    rc = ble_sm_alg_init();
+    if (rc != 0) {
+        return rc;
+    }
+
     ble_sm_sc_init();
 
     return 0;
@@ -2911,6 +2916,45 @@ ble_sm_create_chan(uint16_t conn_handle)
 }
 
 #if MYNEWT_VAL(BLE_SM_CSIS_SIRK)
+/* Expanded key of the SIRK last used for an RSI.  RSIs in advertising
+ * reports are usually checked against the same SIRK over and over.
+ */
+static struct {
+    uint8_t sirk[16];
+    struct ble_sm_alg_key key;
+    uint8_t valid;
+} ble_sm_csis_sirk_key;
+
+static int
+ble_sm_csis_sirk_key_get(const uint8_t *sirk, struct ble_sm_alg_key *out_key)
+{
+    int rc;
+
+    rc = 0;
+
+    ble_hs_lock();
+
+    if (!ble_sm_csis_sirk_key.valid ||
+        memcmp(ble_sm_csis_sirk_key.sirk, sirk, 16) != 0) {
+
+        ble_sm_csis_sirk_key.valid = 0;
+
+        rc = ble_sm_alg_key_init(&ble_sm_csis_sirk_key.key, sirk);
+        if (rc == 0) {
+            memcpy(ble_sm_csis_sirk_key.sirk, sirk, 16);
+            ble_sm_csis_sirk_key.valid = 1;
+        }
+    }
+
+    if (rc == 0) {
+        *out_key = ble_sm_csis_sirk_key.key;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
 int
 ble_sm_csis_decrypt_sirk(const uint8_t *ltk, const uint8_t *enc_sirk, uint8_t *out)
 {
@@ -2928,15 +2972,10 @@ ble_sm_csis_resolve_rsi(const uint8_t *rsi, const uint8_t *sirk,
 {
     struct ble_store_key_sec key_sec;
     struct ble_store_value_sec value_sec;
+    struct ble_sm_alg_key sirk_key;
     uint8_t plaintext_sirk[16] = {0};
-    uint8_t local_hash[3] = {0};
-    uint8_t prand[3] = {0};
-    uint8_t hash[3] = {0};
     int rc;
 
-    memcpy(hash, rsi, 3);
-    memcpy(prand, rsi + 3, 3);
-
     if (ltk_peer_addr) {
         memset(&key_sec, 0, sizeof(key_sec));
         key_sec.peer_addr = *ltk_peer_addr;
@@ -2956,14 +2995,19 @@ ble_sm_csis_resolve_rsi(const uint8_t *rsi, const uint8_t *sirk,
         memcpy(plaintext_sirk, sirk, 16);
     }
 
-    rc = ble_sm_alg_csis_sih(plaintext_sirk, prand, local_hash);
+    rc = ble_sm_csis_sirk_key_get(plaintext_sirk, &sirk_key);
     if (rc != 0) {
         return rc;
     }
 
-    if (memcmp(local_hash, hash, 3)) {
+    /* RSI is hash || prand, checked the same way as an RPA */
+    rc = ble_sm_alg_rpa_resolve(&sirk_key, 1, rsi, NULL);
+    if (rc == BLE_HS_ENOENT) {
         return BLE_HS_EAUTHEN;
     }
+    if (rc != 0) {
+        return rc;
+    }
 
     return 0;
 }
@@ -2984,6 +3028,7 @@ ble_sm_csis_generate_rsi(const uint8_t *sirk, uint8_t *out)
 {
     const uint8_t prand_check_all_set[3] = {0xff, 0xff, 0xef};
     const uint8_t prand_check_all_reset[3] = {0x0, 0x0, 0x40};
+    struct ble_sm_alg_key sirk_key;
     uint8_t prand[3] = {0};
     uint8_t hash[3] = {0};
     int rc;
@@ -3001,7 +3046,12 @@ ble_sm_csis_generate_rsi(const uint8_t *sirk, uint8_t *out)
     } while (memcmp(prand, prand_check_all_set, 3) ||
              memcmp(prand, prand_check_all_reset, 3));
 
-    rc = ble_sm_alg_csis_sih(sirk, prand, hash);
+    rc = ble_sm_csis_sirk_key_get(sirk, &sirk_key);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = ble_sm_alg_ah(&sirk_key, prand, hash);
     if (rc != 0) {
         return rc;
     }
@@ -32,8 +32,14 @@
 #include "tinycrypt/constants.h"
 #include "tinycrypt/utils.h"
 
+#if MYNEWT_VAL(BLE_SM_ALG_AESNI)
+#if !defined(__x86_64__) && !defined(__i386__)
+#error "BLE_SM_ALG_AESNI requires an x86 target"
+#endif
+#include <wmmintrin.h>
+#endif
+
 #if MYNEWT_VAL(BLE_SM_SC)
-#include "tinycrypt/cmac_mode.h"
 #include "tinycrypt/ecc_dh.h"
 #if MYNEWT_VAL(TRNG)
 #include "trng/trng.h"
@@ -54,30 +60,206 @@ ble_sm_alg_xor_128(const uint8_t *p, const uint8_t *q, uint8_t *r)
     }
 }
 
+#if MYNEWT_VAL(BLE_SM_ALG_AESNI)
+
+#define BLE_SM_ALG_AESNI_EXPAND(rk, i, rcon)                                \
+    ble_sm_alg_aesni_expand((rk)[(i) - 1],                                  \
+                            _mm_aeskeygenassist_si128((rk)[(i) - 1], (rcon)))
+
+__attribute__((target("aes,sse2")))
+static __m128i
+ble_sm_alg_aesni_expand(__m128i key, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+
+    return _mm_xor_si128(key, assist);
+}
+
+__attribute__((target("aes,sse2")))
 static int
-ble_sm_alg_encrypt(const uint8_t *key, const uint8_t *plaintext,
-                   uint8_t *enc_data)
+ble_sm_alg_aes_set_key(struct ble_sm_alg_key *key, const uint8_t *k)
 {
-    struct tc_aes_key_sched_struct s;
-    uint8_t tmp[16];
+    __m128i rk[11];
+    int i;
+
+    rk[0] = _mm_loadu_si128((const __m128i *)k);
+    rk[1] = BLE_SM_ALG_AESNI_EXPAND(rk, 1, 0x01);
+    rk[2] = BLE_SM_ALG_AESNI_EXPAND(rk, 2, 0x02);
+    rk[3] = BLE_SM_ALG_AESNI_EXPAND(rk, 3, 0x04);
+    rk[4] = BLE_SM_ALG_AESNI_EXPAND(rk, 4, 0x08);
+    rk[5] = BLE_SM_ALG_AESNI_EXPAND(rk, 5, 0x10);
+    rk[6] = BLE_SM_ALG_AESNI_EXPAND(rk, 6, 0x20);
+    rk[7] = BLE_SM_ALG_AESNI_EXPAND(rk, 7, 0x40);
+    rk[8] = BLE_SM_ALG_AESNI_EXPAND(rk, 8, 0x80);
+    rk[9] = BLE_SM_ALG_AESNI_EXPAND(rk, 9, 0x1b);
+    rk[10] = BLE_SM_ALG_AESNI_EXPAND(rk, 10, 0x36);
+
+    for (i = 0; i < 11; i++) {
+        _mm_storeu_si128((__m128i *)&key->rk[i * 16], rk[i]);
+    }
+
+    return 0;
+}
+
+__attribute__((target("aes,sse2")))
+static int
+ble_sm_alg_aes_block(const struct ble_sm_alg_key *key, const uint8_t *in,
+                     uint8_t *out)
+{
+    __m128i state;
+    int i;
 
-    swap_buf(tmp, key, 16);
+    state = _mm_loadu_si128((const __m128i *)in);
+    state = _mm_xor_si128(state, _mm_loadu_si128((const __m128i *)key->rk));
+    for (i = 1; i < 10; i++) {
+        state = _mm_aesenc_si128(state,
+                                 _mm_loadu_si128((const __m128i *)
+                                                 &key->rk[i * 16]));
+    }
+    state = _mm_aesenclast_si128(state,
+                                 _mm_loadu_si128((const __m128i *)
+                                                 &key->rk[10 * 16]));
+    _mm_storeu_si128((__m128i *)out, state);
+
+    return 0;
+}
 
-    if (tc_aes128_set_encrypt_key(&s, tmp) == TC_CRYPTO_FAIL) {
+#else
+
+static int
+ble_sm_alg_aes_set_key(struct ble_sm_alg_key *key, const uint8_t *k)
+{
+    if (tc_aes128_set_encrypt_key(&key->sched, k) == TC_CRYPTO_FAIL) {
         return BLE_HS_EUNKNOWN;
     }
 
-    swap_buf(tmp, plaintext, 16);
+    return 0;
+}
 
-    if (tc_aes_encrypt(enc_data, tmp, &s) == TC_CRYPTO_FAIL) {
+static int
+ble_sm_alg_aes_block(const struct ble_sm_alg_key *key, const uint8_t *in,
+                     uint8_t *out)
+{
+    if (tc_aes_encrypt(out, in, (TCAesKeySched_t)&key->sched) ==
+        TC_CRYPTO_FAIL) {
         return BLE_HS_EUNKNOWN;
     }
 
+    return 0;
+}
+
+#endif
+
+int
+ble_sm_alg_key_init(struct ble_sm_alg_key *key, const uint8_t *k)
+{
+    uint8_t tmp[16];
+
+    swap_buf(tmp, k, 16);
+
+    return ble_sm_alg_aes_set_key(key, tmp);
+}
+
+int
+ble_sm_alg_e(const struct ble_sm_alg_key *key, const uint8_t *plaintext,
+             uint8_t *enc_data)
+{
+    uint8_t tmp[16];
+    int rc;
+
+    swap_buf(tmp, plaintext, 16);
+
+    rc = ble_sm_alg_aes_block(key, tmp, enc_data);
+    if (rc != 0) {
+        return rc;
+    }
+
     swap_in_place(enc_data, 16);
 
     return 0;
 }
 
+static int
+ble_sm_alg_encrypt(const uint8_t *key, const uint8_t *plaintext,
+                   uint8_t *enc_data)
+{
+    struct ble_sm_alg_key k;
+    int rc;
+
+    rc = ble_sm_alg_key_init(&k, key);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return ble_sm_alg_e(&k, plaintext, enc_data);
+}
+
+int
+ble_sm_alg_ah(const struct ble_sm_alg_key *irk, const uint8_t *r,
+              uint8_t *out)
+{
+    uint8_t r1[16];
+    int rc;
+
+    /* r' = padding || r */
+    memcpy(r1, r, 3);
+    memset(r1 + 3, 0, 13);
+
+    rc = ble_sm_alg_e(irk, r1, r1);
+    if (rc != 0) {
+        return rc;
+    }
+
+    /* ah(k, r) = e(k, r') mod 2^24 */
+    memcpy(out, r1, 3);
+
+    return 0;
+}
+
+/**
+ * Resolves a resolvable private address against a list of IRKs.  The same
+ * check resolves a CSIS RSI when given SIRKs instead of IRKs.
+ *
+ * @param irks                  IRKs set up with ble_sm_alg_key_init().
+ * @param num_irks              Number of entries in irks.
+ * @param rpa                   Address to resolve, little-endian.
+ * @param out_idx               On success, the index of the matching IRK gets
+ *                                  written here.  Pass NULL if you do not
+ *                                  need this information.
+ *
+ * @return                      0 if an IRK matches;
+ *                              BLE_HS_ENOENT if none matches;
+ *                              Other nonzero on error.
+ */
+int
+ble_sm_alg_rpa_resolve(const struct ble_sm_alg_key *irks, int num_irks,
+                       const uint8_t *rpa, int *out_idx)
+{
+    uint8_t hash[3];
+    int rc;
+    int i;
+
+    /* The hash is in the 24 least significant bits, prand above it. */
+    for (i = 0; i < num_irks; i++) {
+        rc = ble_sm_alg_ah(&irks[i], rpa + 3, hash);
+        if (rc != 0) {
+            return rc;
+        }
+
+        if (memcmp(hash, rpa, 3) == 0) {
+            if (out_idx != NULL) {
+                *out_idx = i;
+            }
+            return 0;
+        }
+    }
+
+    return BLE_HS_ENOENT;
+}
+
 int
 ble_sm_alg_s1(const uint8_t *k, const uint8_t *r1, const uint8_t *r2,
               uint8_t *out)
@@ -121,6 +303,7 @@ ble_sm_alg_c1(const uint8_t *k, const uint8_t *r,
               const uint8_t *ia, const uint8_t *ra,
               uint8_t *out_enc_data)
 {
+    struct ble_sm_alg_key key;
     uint8_t p1[16], p2[16];
     int rc;
 
@@ -149,10 +332,16 @@ ble_sm_alg_c1(const uint8_t *k, const uint8_t *r,
 
     /* c1 = e(k, e(k, r XOR p1) XOR p2) */
 
+    rc = ble_sm_alg_key_init(&key, k);
+    if (rc != 0) {
+        rc = BLE_HS_EUNKNOWN;
+        goto done;
+    }
+
     /* Using out_enc_data as temporary output buffer */
     ble_sm_alg_xor_128(r, p1, out_enc_data);
 
-    rc = ble_sm_alg_encrypt(k, out_enc_data, out_enc_data);
+    rc = ble_sm_alg_e(&key, out_enc_data, out_enc_data);
     if (rc != 0) {
         rc = BLE_HS_EUNKNOWN;
         goto done;
@@ -168,7 +357,7 @@ ble_sm_alg_c1(const uint8_t *k, const uint8_t *r,
 
     ble_sm_alg_xor_128(out_enc_data, p2, out_enc_data);
 
-    rc = ble_sm_alg_encrypt(k, out_enc_data, out_enc_data);
+    rc = ble_sm_alg_e(&key, out_enc_data, out_enc_data);
     if (rc != 0) {
         rc = BLE_HS_EUNKNOWN;
         goto done;
@@ -186,6 +375,17 @@ done:
 
 #if MYNEWT_VAL(BLE_SM_SC)
 
+/* f5 SALT, Core Spec 4.2 Vol 3 Part H 2.2.7 */
+static const uint8_t ble_sm_alg_f5_salt_val[16] = {
+    0x6c, 0x88, 0x83, 0x91, 0xaa, 0xf5, 0xa5, 0x38,
+    0x60, 0x37, 0x0b, 0xdb, 0x5a, 0x60, 0x83, 0xbe
+};
+
+/* Keys that never change are expanded only once. */
+static struct ble_sm_alg_key ble_sm_alg_f5_salt;
+static struct ble_sm_alg_key ble_sm_alg_csis_sirkenc_salt;
+static uint8_t ble_sm_alg_const_keys_ready;
+
 static void
 ble_sm_alg_log_buf(const char *name, const uint8_t *buf, int len)
 {
@@ -194,6 +394,95 @@ ble_sm_alg_log_buf(const char *name, const uint8_t *buf, int len)
     BLE_HS_LOG(DEBUG, "\n");
 }
 
+/* Doubling in GF(2^128), used to derive the CMAC subkeys (RFC 4493). */
+static void
+ble_sm_alg_cmac_dbl(const uint8_t *in, uint8_t *out)
+{
+    uint8_t msb;
+    int i;
+
+    msb = in[0] & 0x80;
+    for (i = 0; i < 15; i++) {
+        out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+    }
+    out[15] = in[15] << 1;
+
+    if (msb) {
+        out[15] ^= 0x87;
+    }
+}
+
+/**
+ * Sets up a key for AES-CMAC: expands the key schedule and derives the K1
+ * and K2 subkeys.
+ *
+ * @param key                   Key context to fill in.
+ * @param k                     128-bit key, most significant octet first.
+ */
+static int
+ble_sm_alg_cmac_key_init(struct ble_sm_alg_key *key, const uint8_t *k)
+{
+    uint8_t l[16] = { 0 };
+    int rc;
+
+    rc = ble_sm_alg_aes_set_key(key, k);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = ble_sm_alg_aes_block(key, l, l);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_sm_alg_cmac_dbl(l, key->k1);
+    ble_sm_alg_cmac_dbl(key->k1, key->k2);
+
+    return 0;
+}
+
+/**
+ * Cypher based Message Authentication Code (CMAC) with AES 128 bit
+ *
+ * @param key                   Key set up with ble_sm_alg_cmac_key_init().
+ * @param in                    Message to be authenticated.
+ * @param len                   Length of the message in octets.
+ * @param out                   Output; message authentication code.
+ */
+static int
+ble_sm_alg_cmac(const struct ble_sm_alg_key *key, const uint8_t *in,
+                size_t len, uint8_t *out)
+{
+    uint8_t last[16];
+    uint8_t x[16] = { 0 };
+    int rc;
+
+    while (len > 16) {
+        ble_sm_alg_xor_128(x, in, x);
+
+        rc = ble_sm_alg_aes_block(key, x, x);
+        if (rc != 0) {
+            return rc;
+        }
+
+        in += 16;
+        len -= 16;
+    }
+
+    if (len == 16) {
+        ble_sm_alg_xor_128(in, key->k1, last);
+    } else {
+        memcpy(last, in, len);
+        last[len] = 0x80;
+        memset(last + len + 1, 0, 15 - len);
+        ble_sm_alg_xor_128(last, key->k2, last);
+    }
+
+    ble_sm_alg_xor_128(x, last, x);
+
+    return ble_sm_alg_aes_block(key, x, out);
+}
+
 /**
  * Cypher based Message Authentication Code (CMAC) with AES 128 bit
  *
@@ -206,21 +495,58 @@ static int
 ble_sm_alg_aes_cmac(const uint8_t *key, const uint8_t *in, size_t len,
                     uint8_t *out)
 {
-    struct tc_aes_key_sched_struct sched;
-    struct tc_cmac_struct state;
+    struct ble_sm_alg_key k;
+    int rc;
 
-    if (tc_cmac_setup(&state, key, &sched) == TC_CRYPTO_FAIL) {
+    rc = ble_sm_alg_cmac_key_init(&k, key);
+    if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
 
-    if (tc_cmac_update(&state, in, len) == TC_CRYPTO_FAIL) {
+    rc = ble_sm_alg_cmac(&k, in, len, out);
+    if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
 
-    if (tc_cmac_final(out, &state) == TC_CRYPTO_FAIL) {
-        return BLE_HS_EUNKNOWN;
+    return 0;
+}
+
+/**
+ * Sets up the constant f5 and CSIS salt keys.  Called from ble_sm_alg_init()
+ * and again by each function that uses the keys, which may run before the
+ * host is initialized (e.g. in unit tests); only the first call does work.
+ */
+static int
+ble_sm_alg_const_keys_init(void)
+{
+    uint8_t salt[16];
+    int rc;
+
+    if (ble_sm_alg_const_keys_ready) {
+        return 0;
+    }
+
+    rc = ble_sm_alg_cmac_key_init(&ble_sm_alg_f5_salt,
+                                  ble_sm_alg_f5_salt_val);
+    if (rc != 0) {
+        return rc;
+    }
+
+    /* s1("SIRKenc"), used as the k1 SALT by sef and sdf */
+    rc = ble_sm_alg_csis_s1((const uint8_t *) "SIRKenc", 7, salt);
+    if (rc != 0) {
+        return rc;
     }
 
+    swap_in_place(salt, 16);
+
+    rc = ble_sm_alg_cmac_key_init(&ble_sm_alg_csis_sirkenc_salt, salt);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_sm_alg_const_keys_ready = 1;
+
     return 0;
 }
 
@@ -274,9 +600,7 @@ ble_sm_alg_f5(const uint8_t *w, const uint8_t *n1, const uint8_t *n2,
               uint8_t a1t, const uint8_t *a1, uint8_t a2t, const uint8_t *a2,
               uint8_t *mackey, uint8_t *ltk)
 {
-    static const uint8_t salt[16] = { 0x6c, 0x88, 0x83, 0x91, 0xaa, 0xf5,
-                      0xa5, 0x38, 0x60, 0x37, 0x0b, 0xdb,
-                      0x5a, 0x60, 0x83, 0xbe };
+    struct ble_sm_alg_key t_key;
     uint8_t m[53] = {
         0x00, /* counter */
         0x62, 0x74, 0x6c, 0x65, /* keyID */
@@ -299,13 +623,23 @@ ble_sm_alg_f5(const uint8_t *w, const uint8_t *n1, const uint8_t *n2,
 
     swap_buf(ws, w, 32);
 
-    rc = ble_sm_alg_aes_cmac(salt, ws, 32, t);
+    rc = ble_sm_alg_const_keys_init();
+    if (rc != 0) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    rc = ble_sm_alg_cmac(&ble_sm_alg_f5_salt, ws, 32, t);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
 
     ble_sm_alg_log_buf("t", t, 16);
 
+    rc = ble_sm_alg_cmac_key_init(&t_key, t);
+    if (rc != 0) {
+        return BLE_HS_EUNKNOWN;
+    }
+
     swap_buf(m + 5, n1, 16);
     swap_buf(m + 21, n2, 16);
     m[37] = a1t;
@@ -313,7 +647,7 @@ ble_sm_alg_f5(const uint8_t *w, const uint8_t *n1, const uint8_t *n2,
     m[44] = a2t;
     swap_buf(m + 45, a2, 6);
 
-    rc = ble_sm_alg_aes_cmac(t, m, sizeof(m), mackey);
+    rc = ble_sm_alg_cmac(&t_key, m, sizeof(m), mackey);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
@@ -325,7 +659,7 @@ ble_sm_alg_f5(const uint8_t *w, const uint8_t *n1, const uint8_t *n2,
     /* Counter for ltk is 1. */
     m[0] = 0x01;
 
-    rc = ble_sm_alg_aes_cmac(t, m, sizeof(m), ltk);
+    rc = ble_sm_alg_cmac(&t_key, m, sizeof(m), ltk);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
@@ -418,14 +752,15 @@ ble_sm_alg_g2(const uint8_t *u, const uint8_t *v, const uint8_t *x,
     return 0;
 }
 
-int
-ble_sm_alg_csis_k1(const uint8_t *n, size_t n_len, const uint8_t *salt,
-                   const uint8_t *p, size_t p_len, uint8_t *out)
+static int
+ble_sm_alg_csis_k1_key(const uint8_t *n, size_t n_len,
+                       const struct ble_sm_alg_key *salt,
+                       const uint8_t *p, size_t p_len, uint8_t *out)
 {
-    int rc;
+    struct ble_sm_alg_key t_key;
     uint8_t t[16] = {0};
-    uint8_t salt_be[16] = {0};
     uint8_t n_be[16] = {0};
+    int rc;
 
     /* XXX: Spec does not specify the maximum N and P parameters length.
      * We assume that 16 bytes is enough and return error if passed len value is greater
@@ -434,17 +769,21 @@ ble_sm_alg_csis_k1(const uint8_t *n, size_t n_len, const uint8_t *salt,
         return BLE_HS_EINVAL;
     }
 
-    swap_buf(salt_be, salt, 16);
     swap_buf(n_be, n, n_len);
 
     /* T = AES-CMAC_SALT (N) */
-    rc = ble_sm_alg_aes_cmac(salt_be, n_be, n_len, t);
+    rc = ble_sm_alg_cmac(salt, n_be, n_len, t);
     if (rc != 0) {
         return rc;
     }
 
     /* AES-CMAC_T (P) */
-    rc = ble_sm_alg_aes_cmac(t, p, p_len, out);
+    rc = ble_sm_alg_cmac_key_init(&t_key, t);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = ble_sm_alg_cmac(&t_key, p, p_len, out);
     if (rc != 0) {
         return rc;
     }
@@ -454,6 +793,24 @@ ble_sm_alg_csis_k1(const uint8_t *n, size_t n_len, const uint8_t *salt,
     return 0;
 }
 
+int
+ble_sm_alg_csis_k1(const uint8_t *n, size_t n_len, const uint8_t *salt,
+                   const uint8_t *p, size_t p_len, uint8_t *out)
+{
+    struct ble_sm_alg_key salt_key;
+    uint8_t salt_be[16];
+    int rc;
+
+    swap_buf(salt_be, salt, 16);
+
+    rc = ble_sm_alg_cmac_key_init(&salt_key, salt_be);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return ble_sm_alg_csis_k1_key(n, n_len, &salt_key, p, p_len, out);
+}
+
 int
 ble_sm_alg_csis_s1(const uint8_t *m, size_t m_len, uint8_t *out)
 {
@@ -481,18 +838,17 @@ ble_sm_alg_csis_s1(const uint8_t *m, size_t m_len, uint8_t *out)
 int
 ble_sm_alg_csis_sef(const uint8_t *k, const uint8_t *plaintext_sirk, uint8_t *out)
 {
-    uint8_t salt[16];
     int rc;
     int i;
 
-    /* s1("SIRKenc") */
-    rc = ble_sm_alg_csis_s1((const uint8_t *) "SIRKenc", 7, salt);
+    rc = ble_sm_alg_const_keys_init();
     if (rc != 0) {
         return rc;
     }
 
     /* k1(K, s1("SIRKenc"), "csis") */
-    rc = ble_sm_alg_csis_k1(k, 16, salt, (const uint8_t *) "csis", 4, out);
+    rc = ble_sm_alg_csis_k1_key(k, 16, &ble_sm_alg_csis_sirkenc_salt,
+                                (const uint8_t *) "csis", 4, out);
     if (rc != 0) {
         return rc;
     }
@@ -508,18 +864,17 @@ ble_sm_alg_csis_sef(const uint8_t *k, const uint8_t *plaintext_sirk, uint8_t *ou
 int
 ble_sm_alg_csis_sdf(const uint8_t *k, const uint8_t *enc_sirk, uint8_t *out)
 {
-    uint8_t salt[16];
     int rc;
     int i;
 
-    /* s1("SIRKenc") */
-    rc = ble_sm_alg_csis_s1((const uint8_t *) "SIRKenc", 7, salt);
+    rc = ble_sm_alg_const_keys_init();
     if (rc != 0) {
         return rc;
     }
 
     /* k1(K, s1("SIRKenc"), "csis") */
-    rc = ble_sm_alg_csis_k1(k, 16, salt, (const uint8_t *) "csis", 4, out);
+    rc = ble_sm_alg_csis_k1_key(k, 16, &ble_sm_alg_csis_sirkenc_salt,
+                                (const uint8_t *) "csis", 4, out);
     if (rc != 0) {
         return rc;
     }
@@ -535,20 +890,16 @@ ble_sm_alg_csis_sdf(const uint8_t *k, const uint8_t *enc_sirk, uint8_t *out)
 int
 ble_sm_alg_csis_sih(const uint8_t *k, const uint8_t *r, uint8_t *out)
 {
-    uint8_t r1[16];
+    struct ble_sm_alg_key key;
     int rc;
 
-    memcpy(r1, r, 3);
-    memset(r1 + 3, 0, 13);
-
-    rc = ble_sm_alg_encrypt(k, r1, r1);
+    rc = ble_sm_alg_key_init(&key, k);
     if (rc != 0) {
         return rc;
     }
 
-    memcpy(out, r1, 3);
-
-    return 0;
+    /* sih is the same function as ah, keyed with the SIRK. */
+    return ble_sm_alg_ah(&key, r, out);
 }
 
 int
@@ -564,6 +915,12 @@ ble_sm_alg_gen_dhkey(const uint8_t *peer_pub_key_x, const uint8_t *peer_pub_key_
     swap_buf(&pk[32], peer_pub_key_y, 32);
     swap_buf(priv, our_priv_key, 32);
 
+#if MYNEWT_VAL(BLE_SM_SC_P256)
+    rc = ble_sm_p256_ecdh(pk, priv, dh);
+    if (rc != 0) {
+        return BLE_HS_EUNKNOWN;
+    }
+#else
     if (uECC_valid_public_key(pk, &curve_secp256r1) < 0) {
         return BLE_HS_EUNKNOWN;
     }
@@ -572,6 +929,7 @@ ble_sm_alg_gen_dhkey(const uint8_t *peer_pub_key_x, const uint8_t *peer_pub_key_
     if (rc == TC_CRYPTO_FAIL) {
         return BLE_HS_EUNKNOWN;
     }
+#endif
 
     swap_buf(out_dhkey, dh, 32);
 
@@ -598,6 +956,34 @@ static const uint8_t ble_sm_alg_dbg_pub_key[64] = {
 };
 #endif
 
+#if !MYNEWT_VAL(BLE_SM_SC_DEBUG_KEYS)
+static int
+ble_sm_alg_make_key(uint8_t *pk, uint8_t *priv)
+{
+#if MYNEWT_VAL(BLE_SM_SC_P256)
+    uECC_RNG_Function rng;
+    int tries;
+
+    rng = uECC_get_rng();
+
+    for (tries = 0; tries < uECC_RNG_MAX_TRIES; tries++) {
+        if (rng == NULL || !rng(priv, 32)) {
+            return TC_CRYPTO_FAIL;
+        }
+
+        /* Draws outside [1, n - 1] are rejected and retried. */
+        if (ble_sm_p256_pub_key(priv, pk) == 0) {
+            return TC_CRYPTO_SUCCESS;
+        }
+    }
+
+    return TC_CRYPTO_FAIL;
+#else
+    return uECC_make_key(pk, priv, &curve_secp256r1);
+#endif
+}
+#endif
+
 /**
  * pub: 64 bytes
  * priv: 32 bytes
@@ -613,7 +999,7 @@ ble_sm_alg_gen_key_pair(uint8_t *pub, uint8_t *priv)
     uint8_t pk[64];
 
     do {
-        if (uECC_make_key(pk, priv, &curve_secp256r1) != TC_CRYPTO_SUCCESS) {
+        if (ble_sm_alg_make_key(pk, priv) != TC_CRYPTO_SUCCESS) {
             return BLE_HS_EUNKNOWN;
         }
 
@@ -666,5 +1052,20 @@ ble_sm_alg_ecc_init(void)
 }
 
 #endif
+
+int
+ble_sm_alg_init(void)
+{
+#if MYNEWT_VAL(BLE_SM_SC)
+    int rc;
+
+    rc = ble_sm_alg_const_keys_init();
+    if (rc != 0) {
+        return rc;
+    }
+#endif
+
+    return 0;
+}
 #endif
 #endif
@@ -0,0 +1,935 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * NIST P-256 (secp256r1) key generation and ECDH for LE Secure Connections.
+ *
+ * Field elements are kept in Montgomery form (R = 2^256) as little-endian
+ * arrays of 32-bit limbs, or 64-bit limbs with BLE_SM_SC_P256_64BIT when the
+ * compiler has 128-bit integers (32-bit limbs are used otherwise).  Points
+ * are in Jacobian coordinates.  Both scalar multiplications run in constant
+ * time with respect to the private key: table entries are selected by
+ * scanning the whole table and the point at infinity is handled with masks.
+ *
+ * - Public keys are computed with a fixed-base comb: two precomputed tables
+ *   of 15 affine points each, so k*G costs 32 doublings and 64 mixed
+ *   additions.
+ * - The shared secret is computed with a 4-bit fixed window over a table of
+ *   1P..15P built for the peer key: 256 doublings and 64 additions.
+ */
+
+#include <string.h>
+#include "syscfg/syscfg.h"
+#include "nimble/nimble_opt.h"
+
+#if NIMBLE_BLE_CONNECT && NIMBLE_BLE_SM
+#if MYNEWT_VAL(BLE_SM_SC) && MYNEWT_VAL(BLE_SM_SC_P256)
+
+#include "ble_hs_priv.h"
+
+#if MYNEWT_VAL(BLE_SM_SC_P256_64BIT) && defined(__SIZEOF_INT128__)
+typedef uint64_t ble_sm_p256_limb_t;
+typedef unsigned __int128 ble_sm_p256_dlimb_t;
+#define BLE_SM_P256_LIMBS       4
+/* Two 32-bit halves of a constant, most significant first. */
+#define L(hi, lo)               (((uint64_t)(hi) << 32) | (lo))
+#else
+typedef uint32_t ble_sm_p256_limb_t;
+typedef uint64_t ble_sm_p256_dlimb_t;
+#define BLE_SM_P256_LIMBS       8
+#define L(hi, lo)               (lo), (hi)
+#endif
+
+#define BLE_SM_P256_LIMB_BITS   (sizeof(ble_sm_p256_limb_t) * 8)
+#define BLE_SM_P256_LIMB_BYTES  (sizeof(ble_sm_p256_limb_t))
+
+typedef ble_sm_p256_limb_t ble_sm_p256_fe[BLE_SM_P256_LIMBS];
+
+struct ble_sm_p256_aff {
+    ble_sm_p256_fe x;
+    ble_sm_p256_fe y;
+};
+
+struct ble_sm_p256_jac {
+    ble_sm_p256_fe x;
+    ble_sm_p256_fe y;
+    ble_sm_p256_fe z;
+};
+
+static const ble_sm_p256_fe ble_sm_p256_p = {
+    L(0xffffffff, 0xffffffff), L(0x00000000, 0xffffffff),
+    L(0x00000000, 0x00000000), L(0xffffffff, 0x00000001)
+};
+
+/* R^2 mod p, converts into Montgomery form. */
+static const ble_sm_p256_fe ble_sm_p256_r2 = {
+    L(0x00000000, 0x00000003), L(0xfffffffb, 0xffffffff),
+    L(0xffffffff, 0xfffffffe), L(0x00000004, 0xfffffffd)
+};
+
+/* 1 in Montgomery form (R mod p). */
+static const ble_sm_p256_fe ble_sm_p256_one = {
+    L(0x00000000, 0x00000001), L(0xffffffff, 0x00000000),
+    L(0xffffffff, 0xffffffff), L(0x00000000, 0xfffffffe)
+};
+
+/* Curve coefficient b in Montgomery form. */
+static const ble_sm_p256_fe ble_sm_p256_b = {
+    L(0xd89cdf62, 0x29c4bddf), L(0xacf005cd, 0x78843090),
+    L(0xe5a220ab, 0xf7212ed6), L(0xdc30061d, 0x04874834)
+};
+
+/* Big-endian p and n, for range checks on keys. */
+static const uint8_t ble_sm_p256_p_be[32] = {
+    0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+static const uint8_t ble_sm_p256_n_be[32] = {
+    0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84,
+    0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51,
+};
+
+/*
+ * Comb tables.  Entry i - 1 of ble_sm_p256_comb[0] is
+ *     sum over set bits t of i: 2^(32 * t) * G
+ * and ble_sm_p256_comb[1] is the same scaled by 2^128.  Affine, Montgomery
+ * form.
+ */
+static const struct ble_sm_p256_aff ble_sm_p256_comb[2][15] = {
+    {
+        { {
+            L(0x79e730d4, 0x18a9143c), L(0x75ba95fc, 0x5fedb601),
+            L(0x79fb732b, 0x77622510), L(0x18905f76, 0xa53755c6)
+        }, {
+            L(0xddf25357, 0xce95560a), L(0x8b4ab8e4, 0xba19e45c),
+            L(0xd2e88688, 0xdd21f325), L(0x8571ff18, 0x25885d85)
+        } },
+        { {
+            L(0x20288602, 0x4147519a), L(0xd0981eac, 0x26b372f0),
+            L(0xa9d4a7ca, 0xa785ebc8), L(0xd953c50d, 0xdbdf58e9)
+        }, {
+            L(0x9d6361cc, 0xfd590f8f), L(0x72e9626b, 0x44e6c917),
+            L(0x7fd96110, 0x22eb64cf), L(0x863ebb7e, 0x9eb288f3)
+        } },
+        { {
+            L(0x7856b623, 0x5cdb6485), L(0x808f0ea2, 0x2f0a2f97),
+            L(0x3e68d954, 0x4f7e300b), L(0x00076055, 0xb5ff80a0)
+        }, {
+            L(0x7634eb9b, 0x838d2010), L(0x54014fbb, 0x3243708a),
+            L(0xe0e47d39, 0x842a6606), L(0x83087761, 0x34373ee0)
+        } },
+        { {
+            L(0x4f922fc5, 0x16a0d2bb), L(0x0d5cc16c, 0x1a623499),
+            L(0x9241cf3a, 0x57c62c8b), L(0x2f5e6961, 0xfd1b667f)
+        }, {
+            L(0x5c15c70b, 0xf5a01797), L(0x3d20b44d, 0x60956192),
+            L(0x04911b37, 0x071fdb52), L(0xf648f916, 0x8d6f0f7b)
+        } },
+        { {
+            L(0x9e566847, 0xe137bbbc), L(0xe434469e, 0x8a6a0bec),
+            L(0xb1c42761, 0x79d73463), L(0x5abe0285, 0x133d0015)
+        }, {
+            L(0x92aa837c, 0xc04c7dab), L(0x573d9f4c, 0x43260c07),
+            L(0x0c931562, 0x78e6cc37), L(0x94bb725b, 0x6b6f7383)
+        } },
+        { {
+            L(0xbbf9b48f, 0x720f141c), L(0x6199b3cd, 0x2df5bc74),
+            L(0xdc3f6129, 0x411045c4), L(0xcdd6bbcb, 0x2f7dc4ef)
+        }, {
+            L(0xcca6700b, 0xeaf436fd), L(0x6f647f6d, 0xb99326be),
+            L(0x0c0fa792, 0x014f2522), L(0xa361bebd, 0x4bdae5f6)
+        } },
+        { {
+            L(0x28aa2558, 0x597c13c7), L(0xc38d635f, 0x50b7c3e1),
+            L(0x07039aec, 0xf3c09d1d), L(0xba12ca09, 0xc4b5292c)
+        }, {
+            L(0x9e408fa4, 0x59f91dfd), L(0x3af43b66, 0xceea07fb),
+            L(0x1eceb089, 0x9d780b29), L(0x53ebb99d, 0x701fef4b)
+        } },
+        { {
+            L(0x4fe7ee31, 0xb0e63d34), L(0xf4600572, 0xa9e54fab),
+            L(0xc0493334, 0xd5e7b5a4), L(0x8589fb92, 0x06d54831)
+        }, {
+            L(0xaa70f5cc, 0x6583553a), L(0x0879094a, 0xe25649e5),
+            L(0xcc904507, 0x10044652), L(0xebb0696d, 0x02541c4f)
+        } },
+        { {
+            L(0x4616ca15, 0xac1647c5), L(0xb8127d47, 0xc4cf5799),
+            L(0xdc666aa3, 0x764dfbac), L(0xeb2820cb, 0xd1b27da3)
+        }, {
+            L(0x9406f8d8, 0x6a87e008), L(0xd87dfa9d, 0x922378f3),
+            L(0x56ed2e42, 0x80ccecb2), L(0x1f28289b, 0x55a7da1d)
+        } },
+        { {
+            L(0xabbaa0c0, 0x3b89da99), L(0xa6f2d79e, 0xb8284022),
+            L(0x27847862, 0xb81c05e8), L(0x337a4b59, 0x05e54d63)
+        }, {
+            L(0x3c67500d, 0x21f7794a), L(0x207005b7, 0x7d6d7f61),
+            L(0x0a5a3781, 0x04cfd6e8), L(0x0d65e0d5, 0xf4c2fbd6)
+        } },
+        { {
+            L(0xd9d09bbe, 0xb5275d38), L(0x4268a745, 0x0be0a358),
+            L(0xf0762ff4, 0x973eb265), L(0xc23da242, 0x52f4a232)
+        }, {
+            L(0x5da1b84f, 0x0b94520c), L(0x09666763, 0xb05bd78e),
+            L(0x3a4dcb86, 0x94d29ea1), L(0x19de3b8c, 0xc790cff1)
+        } },
+        { {
+            L(0x183a716c, 0x26c5fe04), L(0x3b28de0b, 0x3bba1bdb),
+            L(0x7432c586, 0xa4cb712c), L(0xe34dcbd4, 0x91fccbfd)
+        }, {
+            L(0xb408d46b, 0xaaa58403), L(0x9a697486, 0x82e97a53),
+            L(0x9e390127, 0x36aaa8af), L(0xe7641f44, 0x7b4e0f7f)
+        } },
+        { {
+            L(0x7d753941, 0xdf64ba59), L(0xd33f10ec, 0x0b0242fc),
+            L(0x4f06dfc6, 0xa1581859), L(0x4a12df57, 0x052a57bf)
+        }, {
+            L(0xbfa6338f, 0x9439dbd0), L(0xd3c24bd4, 0xbde53e1f),
+            L(0xfd5e4ffa, 0x21f1b314), L(0x6af5aa93, 0xbb5bea46)
+        } },
+        { {
+            L(0xda10b699, 0x10c91999), L(0x0a24b440, 0x2a580491),
+            L(0x3e0094b4, 0xb8cc2090), L(0x5fe3475a, 0x66a44013)
+        }, {
+            L(0xb0f8cabd, 0xf93e7b4b), L(0x292b501a, 0x7c23f91a),
+            L(0x42e889ae, 0xcd1e6263), L(0xb544e308, 0xecfea916)
+        } },
+        { {
+            L(0x6478c6e9, 0x16ddfdce), L(0x2c329166, 0xf89179e6),
+            L(0x4e8d6e76, 0x4d4e67e1), L(0xe0b6b2bd, 0xa6b0c20b)
+        }, {
+            L(0x0d312df2, 0xbb7efb57), L(0x1aac0dde, 0x790c4007),
+            L(0xf90336ad, 0x679bc944), L(0x71c023de, 0x25a63774)
+        } },
+    },
+    {
+        { {
+            L(0x62a8c244, 0xbfe20925), L(0x91c19ac3, 0x8fdce867),
+            L(0x5a96a5d5, 0xdd387063), L(0x61d587d4, 0x21d324f6)
+        }, {
+            L(0xe87673a2, 0xa37173ea), L(0x23848008, 0x53778b65),
+            L(0x10f8441e, 0x05bab43e), L(0xfa11fe12, 0x4621efbe)
+        } },
+        { {
+            L(0xd433e50f, 0x6d3549cf), L(0x6f33696f, 0xfacd665e),
+            L(0x695bfdac, 0xce11fcb4), L(0x810ee252, 0xaf7c9860)
+        }, {
+            L(0x65450fe1, 0x7159bb2c), L(0xf7dfbebe, 0x758b357b),
+            L(0x2b057e74, 0xd69fea72), L(0xd485717a, 0x92731745)
+        } },
+        { {
+            L(0xd11d47dc, 0xfc9877ee), L(0xc8b36210, 0x801d0002),
+            L(0xd002c117, 0x54c260b6), L(0x04c17cd8, 0x6962f046)
+        }, {
+            L(0x6d9bd094, 0xb0daddf5), L(0xbea23575, 0x24ce55c0),
+            L(0x663356e6, 0x72da03b5), L(0xf7ba4de9, 0xfed97474)
+        } },
+        { {
+            L(0x56f8410e, 0xf4f8b16a), L(0x97241afe, 0xc47b266a),
+            L(0x0a406b8e, 0x6d9c87c1), L(0x803f3e02, 0xcd42ab1b)
+        }, {
+            L(0x7f0309a8, 0x04dbec69), L(0xa83b85f7, 0x3bbad05f),
+            L(0xc6097273, 0xad8e197f), L(0xc097440e, 0x5067adc1)
+        } },
+        { {
+            L(0x5fe14bfe, 0x80ec21fe), L(0xf6ce116a, 0xc255be82),
+            L(0x98bc5a07, 0x2f4a5d67), L(0xfad27148, 0xdb7e63af)
+        }, {
+            L(0x90c0b6ac, 0x29ab05b3), L(0x37a9a83c, 0x4e251ae6),
+            L(0x0a7dc875, 0xc2aade7d), L(0x77387de3, 0x9f0e1a84)
+        } },
+        { {
+            L(0x84a9521d, 0x927dafc6), L(0x52c1fb69, 0x5c09cd19),
+            L(0x9d9581a0, 0xf9366dde), L(0x9abe210b, 0xa16d7e64)
+        }, {
+            L(0x480af84a, 0x48915220), L(0xfa73176a, 0x4dd816c6),
+            L(0xc7d53987, 0x1681ca5a), L(0x7881c257, 0x87f344b0)
+        } },
+        { {
+            L(0xd75a3e65, 0x05058880), L(0x7da365ef, 0x643943f2),
+            L(0x4147861c, 0xfab24925), L(0xc5c4bdb0, 0xfdb808ff)
+        }, {
+            L(0x73513e34, 0xb272b56b), L(0xc8327e95, 0x11b9043a),
+            L(0xfd8ce37d, 0xf8844969), L(0x2d56db94, 0x46c2b6b5)
+        } },
+        { {
+            L(0xe3417bc0, 0x35d0b34a), L(0x440b386b, 0x8327c0a7),
+            L(0x8fb7262d, 0xac0362d1), L(0x2c41114c, 0xe0cdf943)
+        }, {
+            L(0x2ba5cef1, 0xad95a0b1), L(0xc09b37a8, 0x67d54362),
+            L(0x26d6cdd2, 0x01e486c9), L(0x20477abf, 0x42ff9297)
+        } },
+        { {
+            L(0xf4f80824, 0xa7bf9b7c), L(0x365d2320, 0x3fbe30d0),
+            L(0xbfbe5320, 0x97cf9ce3), L(0xe3604700, 0xb3055526)
+        }, {
+            L(0x4dcb9911, 0x6cc6c2c7), L(0x72683708, 0xba4cbee6),
+            L(0xdcded434, 0x637ad9ec), L(0x6542d677, 0xa3dee15f)
+        } },
+        { {
+            L(0x231c210e, 0x15339848), L(0xe87a28e8, 0x70778c8d),
+            L(0x9d1de661, 0x6956e170), L(0x4ac3c938, 0x2bb09c0b)
+        }, {
+            L(0x19be0551, 0x6998987d), L(0x8b2376c4, 0xae09f4d6),
+            L(0x1de0b765, 0x1a3f933d), L(0x380d94c7, 0xe39705f4)
+        } },
+        { {
+            L(0xeb54ea74, 0xa16bd00a), L(0xd839e9ad, 0xf5c0bcc1),
+            L(0x092bb7f1, 0x1f9bfc06), L(0x318f97b3, 0x1163dc4e)
+        }, {
+            L(0xecc0c5be, 0xc30d7138), L(0x44e8df23, 0xabc30220),
+            L(0x2bb7972f, 0xb0223606), L(0xfa41faa1, 0x9a84ff4d)
+        } },
+        { {
+            L(0x2e80937c, 0xf67d04c3), L(0x1e312be2, 0x89eeb811),
+            L(0x56b5d887, 0x92594d60), L(0x0224da14, 0x187fbd3d)
+        }, {
+            L(0x87abb863, 0x0c5fe36f), L(0x580f3c60, 0x4ef51f5f),
+            L(0x964fb1bf, 0xb3b429ec), L(0x60838ef0, 0x42bfff33)
+        } },
+        { {
+            L(0xf0f58f66, 0x20c26def), L(0x025585ea, 0x582b2d1e),
+            L(0xfbe7d79b, 0x01ce3881), L(0x28ccea01, 0x303f1730)
+        }, {
+            L(0xd1dabcd1, 0x79644ba5), L(0x1fc643e8, 0x06fff0b8),
+            L(0xa60a76fc, 0x66b3e17b), L(0xc18baf48, 0xa1d013bf)
+        } },
+        { {
+            L(0x396ef794, 0xaddb7d07), L(0x0b4fc742, 0x24455500),
+            L(0xfaff8eac, 0xc78aa3ce), L(0x14e9ada5, 0xe8d4d97d)
+        }, {
+            L(0xdaa480a1, 0x2f7079e2), L(0x45baa3cd, 0xe4b0800e),
+            L(0x01765e2d, 0x7838157d), L(0xa0ad4fab, 0x8e9d9ae8)
+        } },
+        { {
+            L(0xc9a1dc0e, 0x0bfc8ff3), L(0x14efd82b, 0xe936f42f),
+            L(0x67016f7c, 0xcca381ef), L(0x1432c1ca, 0xed8aee96)
+        }, {
+            L(0xec684829, 0x70b23c26), L(0xa64fe873, 0x0735b273),
+            L(0xe389f6e5, 0xeaef0f5a), L(0xcaef480b, 0x5ac8d2c6)
+        } },
+    },
+};
+
+#undef L
+
+static void
+ble_sm_p256_fe_copy(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a)
+{
+    memcpy(r, a, sizeof(ble_sm_p256_fe));
+}
+
+/* r = a if mask is all ones; r is unchanged if mask is zero. */
+static void
+ble_sm_p256_fe_cmov(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a,
+                    ble_sm_p256_limb_t mask)
+{
+    int i;
+
+    for (i = 0; i < BLE_SM_P256_LIMBS; i++) {
+        r[i] = (r[i] & ~mask) | (a[i] & mask);
+    }
+}
+
+static int
+ble_sm_p256_fe_equal(const ble_sm_p256_limb_t *a,
+                     const ble_sm_p256_limb_t *b)
+{
+    return memcmp(a, b, sizeof(ble_sm_p256_fe)) == 0;
+}
+
+/* Reduces (carry:r), which is less than 2p, to [0, p). */
+static void
+ble_sm_p256_fe_reduce_once(ble_sm_p256_limb_t *r, ble_sm_p256_limb_t carry)
+{
+    ble_sm_p256_dlimb_t d;
+    ble_sm_p256_limb_t borrow;
+    ble_sm_p256_fe t;
+    int i;
+
+    borrow = 0;
+    for (i = 0; i < BLE_SM_P256_LIMBS; i++) {
+        d = (ble_sm_p256_dlimb_t)r[i] - ble_sm_p256_p[i] - borrow;
+        t[i] = (ble_sm_p256_limb_t)d;
+        borrow = (ble_sm_p256_limb_t)(d >> BLE_SM_P256_LIMB_BITS) & 1;
+    }
+
+    /* Keep r - p unless it borrowed out of a value without carry. */
+    ble_sm_p256_fe_cmov(r, t, -(carry | (borrow ^ 1)));
+}
+
+static void
+ble_sm_p256_fe_add(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a,
+                   const ble_sm_p256_limb_t *b)
+{
+    ble_sm_p256_dlimb_t d;
+    ble_sm_p256_limb_t carry;
+    int i;
+
+    carry = 0;
+    for (i = 0; i < BLE_SM_P256_LIMBS; i++) {
+        d = (ble_sm_p256_dlimb_t)a[i] + b[i] + carry;
+        r[i] = (ble_sm_p256_limb_t)d;
+        carry = (ble_sm_p256_limb_t)(d >> BLE_SM_P256_LIMB_BITS);
+    }
+
+    ble_sm_p256_fe_reduce_once(r, carry);
+}
+
+static void
+ble_sm_p256_fe_sub(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a,
+                   const ble_sm_p256_limb_t *b)
+{
+    ble_sm_p256_dlimb_t d;
+    ble_sm_p256_limb_t borrow;
+    ble_sm_p256_limb_t carry;
+    ble_sm_p256_limb_t mask;
+    int i;
+
+    borrow = 0;
+    for (i = 0; i < BLE_SM_P256_LIMBS; i++) {
+        d = (ble_sm_p256_dlimb_t)a[i] - b[i] - borrow;
+        r[i] = (ble_sm_p256_limb_t)d;
+        borrow = (ble_sm_p256_limb_t)(d >> BLE_SM_P256_LIMB_BITS) & 1;
+    }
+
+    /* Add p back if the subtraction wrapped. */
+    mask = -borrow;
+    carry = 0;
+    for (i = 0; i < BLE_SM_P256_LIMBS; i++) {
+        d = (ble_sm_p256_dlimb_t)r[i] + (ble_sm_p256_p[i] & mask) + carry;
+        r[i] = (ble_sm_p256_limb_t)d;
+        carry = (ble_sm_p256_limb_t)(d >> BLE_SM_P256_LIMB_BITS);
+    }
+}
+
+/*
+ * Montgomery multiplication, r = a * b / R mod p (CIOS).  -p^-1 mod 2^w is 1
+ * for P-256, so the per-limb quotient is simply the low limb.
+ */
+static void
+ble_sm_p256_fe_mul(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a,
+                   const ble_sm_p256_limb_t *b)
+{
+    ble_sm_p256_limb_t t[BLE_SM_P256_LIMBS + 2];
+    ble_sm_p256_dlimb_t d;
+    ble_sm_p256_limb_t c;
+    ble_sm_p256_limb_t m;
+    int i;
+    int j;
+
+    memset(t, 0, sizeof t);
+
+    for (i = 0; i < BLE_SM_P256_LIMBS; i++) {
+        c = 0;
+        for (j = 0; j < BLE_SM_P256_LIMBS; j++) {
+            d = (ble_sm_p256_dlimb_t)a[j] * b[i] + t[j] + c;
+            t[j] = (ble_sm_p256_limb_t)d;
+            c = (ble_sm_p256_limb_t)(d >> BLE_SM_P256_LIMB_BITS);
+        }
+        d = (ble_sm_p256_dlimb_t)t[BLE_SM_P256_LIMBS] + c;
+        t[BLE_SM_P256_LIMBS] = (ble_sm_p256_limb_t)d;
+        t[BLE_SM_P256_LIMBS + 1] = (ble_sm_p256_limb_t)
+                                   (d >> BLE_SM_P256_LIMB_BITS);
+
+        m = t[0];
+        d = (ble_sm_p256_dlimb_t)m * ble_sm_p256_p[0] + t[0];
+        c = (ble_sm_p256_limb_t)(d >> BLE_SM_P256_LIMB_BITS);
+        for (j = 1; j < BLE_SM_P256_LIMBS; j++) {
+            d = (ble_sm_p256_dlimb_t)m * ble_sm_p256_p[j] + t[j] + c;
+            t[j - 1] = (ble_sm_p256_limb_t)d;
+            c = (ble_sm_p256_limb_t)(d >> BLE_SM_P256_LIMB_BITS);
+        }
+        d = (ble_sm_p256_dlimb_t)t[BLE_SM_P256_LIMBS] + c;
+        t[BLE_SM_P256_LIMBS - 1] = (ble_sm_p256_limb_t)d;
+        t[BLE_SM_P256_LIMBS] = t[BLE_SM_P256_LIMBS + 1] +
+                               (ble_sm_p256_limb_t)
+                               (d >> BLE_SM_P256_LIMB_BITS);
+    }
+
+    memcpy(r, t, sizeof(ble_sm_p256_fe));
+    ble_sm_p256_fe_reduce_once(r, t[BLE_SM_P256_LIMBS]);
+}
+
+static void
+ble_sm_p256_fe_sqr(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a)
+{
+    ble_sm_p256_fe_mul(r, a, a);
+}
+
+static void
+ble_sm_p256_fe_sqr_n(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a,
+                     int n)
+{
+    ble_sm_p256_fe_sqr(r, a);
+    while (--n > 0) {
+        ble_sm_p256_fe_sqr(r, r);
+    }
+}
+
+/* r = a^(p - 2) = a^-1; fixed addition chain, 255 squarings. */
+static void
+ble_sm_p256_fe_inv(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a)
+{
+    ble_sm_p256_fe x2, x3, x6, x12, x15, x30, x32, t;
+
+    ble_sm_p256_fe_sqr(t, a);
+    ble_sm_p256_fe_mul(x2, t, a);
+    ble_sm_p256_fe_sqr(t, x2);
+    ble_sm_p256_fe_mul(x3, t, a);
+    ble_sm_p256_fe_sqr_n(t, x3, 3);
+    ble_sm_p256_fe_mul(x6, t, x3);
+    ble_sm_p256_fe_sqr_n(t, x6, 6);
+    ble_sm_p256_fe_mul(x12, t, x6);
+    ble_sm_p256_fe_sqr_n(t, x12, 3);
+    ble_sm_p256_fe_mul(x15, t, x3);
+    ble_sm_p256_fe_sqr_n(t, x15, 15);
+    ble_sm_p256_fe_mul(x30, t, x15);
+    ble_sm_p256_fe_sqr_n(t, x30, 2);
+    ble_sm_p256_fe_mul(x32, t, x2);
+
+    /* p - 2 from the top: 32 ones, 31 zeros, 1, 96 zeros, 94 ones, 0, 1 */
+    ble_sm_p256_fe_sqr_n(t, x32, 32);
+    ble_sm_p256_fe_mul(t, t, a);
+    ble_sm_p256_fe_sqr_n(t, t, 128);
+    ble_sm_p256_fe_mul(t, t, x32);
+    ble_sm_p256_fe_sqr_n(t, t, 32);
+    ble_sm_p256_fe_mul(t, t, x32);
+    ble_sm_p256_fe_sqr_n(t, t, 30);
+    ble_sm_p256_fe_mul(t, t, x30);
+    ble_sm_p256_fe_sqr_n(t, t, 2);
+    ble_sm_p256_fe_mul(r, t, a);
+}
+
+static void
+ble_sm_p256_fe_from_bytes(ble_sm_p256_limb_t *r, const uint8_t *be)
+{
+    int i;
+
+    memset(r, 0, sizeof(ble_sm_p256_fe));
+    for (i = 0; i < 32; i++) {
+        r[i / BLE_SM_P256_LIMB_BYTES] |= (ble_sm_p256_limb_t)be[31 - i] <<
+                                         (8 * (i % BLE_SM_P256_LIMB_BYTES));
+    }
+}
+
+static void
+ble_sm_p256_fe_to_bytes(uint8_t *be, const ble_sm_p256_limb_t *a)
+{
+    int i;
+
+    for (i = 0; i < 32; i++) {
+        be[31 - i] = a[i / BLE_SM_P256_LIMB_BYTES] >>
+                     (8 * (i % BLE_SM_P256_LIMB_BYTES));
+    }
+}
+
+static void
+ble_sm_p256_fe_to_mont(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a)
+{
+    ble_sm_p256_fe_mul(r, a, ble_sm_p256_r2);
+}
+
+static void
+ble_sm_p256_fe_from_mont(ble_sm_p256_limb_t *r, const ble_sm_p256_limb_t *a)
+{
+    static const ble_sm_p256_fe one = { 1 };
+
+    ble_sm_p256_fe_mul(r, a, one);
+}
+
+/* Mask of all ones if a == b, zero otherwise. */
+static ble_sm_p256_limb_t
+ble_sm_p256_eq_mask(uint32_t a, uint32_t b)
+{
+    return -(ble_sm_p256_limb_t)(((a ^ b) - 1) >> 31);
+}
+
+/* dbl-2001-b; a = -3.  Doubling infinity (z = 0) gives infinity. */
+static void
+ble_sm_p256_jac_dbl(struct ble_sm_p256_jac *r, const struct ble_sm_p256_jac *p)
+{
+    ble_sm_p256_fe delta, gamma, beta, alpha, t1, t2;
+
+    ble_sm_p256_fe_sqr(delta, p->z);
+    ble_sm_p256_fe_sqr(gamma, p->y);
+    ble_sm_p256_fe_mul(beta, p->x, gamma);
+
+    /* alpha = 3 * (x - delta) * (x + delta) */
+    ble_sm_p256_fe_sub(t1, p->x, delta);
+    ble_sm_p256_fe_add(t2, p->x, delta);
+    ble_sm_p256_fe_mul(alpha, t1, t2);
+    ble_sm_p256_fe_add(t1, alpha, alpha);
+    ble_sm_p256_fe_add(alpha, t1, alpha);
+
+    /* z3 = (y + z)^2 - gamma - delta */
+    ble_sm_p256_fe_add(t1, p->y, p->z);
+    ble_sm_p256_fe_sqr(t1, t1);
+    ble_sm_p256_fe_sub(t1, t1, gamma);
+    ble_sm_p256_fe_sub(r->z, t1, delta);
+
+    /* x3 = alpha^2 - 8 * beta */
+    ble_sm_p256_fe_add(beta, beta, beta);
+    ble_sm_p256_fe_add(beta, beta, beta);
+    ble_sm_p256_fe_add(t2, beta, beta);
+    ble_sm_p256_fe_sqr(t1, alpha);
+    ble_sm_p256_fe_sub(r->x, t1, t2);
+
+    /* y3 = alpha * (4 * beta - x3) - 8 * gamma^2 */
+    ble_sm_p256_fe_sub(t1, beta, r->x);
+    ble_sm_p256_fe_mul(t1, alpha, t1);
+    ble_sm_p256_fe_sqr(t2, gamma);
+    ble_sm_p256_fe_add(t2, t2, t2);
+    ble_sm_p256_fe_add(t2, t2, t2);
+    ble_sm_p256_fe_add(t2, t2, t2);
+    ble_sm_p256_fe_sub(r->y, t1, t2);
+}
+
+/*
+ * madd-2007-bl, r = p + q with q affine.  r may be p.  The caller handles p
+ * or q at infinity and never adds a point to itself.
+ */
+static void
+ble_sm_p256_jac_add_aff(struct ble_sm_p256_jac *r,
+                        const struct ble_sm_p256_jac *p,
+                        const struct ble_sm_p256_aff *q)
+{
+    ble_sm_p256_fe z1z1, u2, s2, h, hh, i, j, rr, v, t;
+
+    ble_sm_p256_fe_sqr(z1z1, p->z);
+    ble_sm_p256_fe_mul(u2, q->x, z1z1);
+    ble_sm_p256_fe_mul(s2, q->y, p->z);
+    ble_sm_p256_fe_mul(s2, s2, z1z1);
+
+    ble_sm_p256_fe_sub(h, u2, p->x);
+    ble_sm_p256_fe_sqr(hh, h);
+    ble_sm_p256_fe_add(i, hh, hh);
+    ble_sm_p256_fe_add(i, i, i);
+    ble_sm_p256_fe_mul(j, h, i);
+    ble_sm_p256_fe_sub(rr, s2, p->y);
+    ble_sm_p256_fe_add(rr, rr, rr);
+    ble_sm_p256_fe_mul(v, p->x, i);
+
+    /* z3 = (z1 + h)^2 - z1z1 - hh */
+    ble_sm_p256_fe_add(t, p->z, h);
+    ble_sm_p256_fe_sqr(t, t);
+    ble_sm_p256_fe_sub(t, t, z1z1);
+    ble_sm_p256_fe_sub(r->z, t, hh);
+
+    /* x3 = rr^2 - j - 2 * v */
+    ble_sm_p256_fe_sqr(t, rr);
+    ble_sm_p256_fe_sub(t, t, j);
+    ble_sm_p256_fe_sub(t, t, v);
+    ble_sm_p256_fe_sub(r->x, t, v);
+
+    /* y3 = rr * (v - x3) - 2 * y1 * j */
+    ble_sm_p256_fe_sub(t, v, r->x);
+    ble_sm_p256_fe_mul(t, rr, t);
+    ble_sm_p256_fe_mul(j, p->y, j);
+    ble_sm_p256_fe_add(j, j, j);
+    ble_sm_p256_fe_sub(r->y, t, j);
+}
+
+/*
+ * add-2007-bl, r = p + q.  r may be p.  The caller handles p or q at
+ * infinity and never adds a point to itself.
+ */
+static void
+ble_sm_p256_jac_add(struct ble_sm_p256_jac *r,
+                    const struct ble_sm_p256_jac *p,
+                    const struct ble_sm_p256_jac *q)
+{
+    ble_sm_p256_fe z1z1, z2z2, u1, u2, s1, s2, h, i, j, rr, v, t;
+
+    ble_sm_p256_fe_sqr(z1z1, p->z);
+    ble_sm_p256_fe_sqr(z2z2, q->z);
+    ble_sm_p256_fe_mul(u1, p->x, z2z2);
+    ble_sm_p256_fe_mul(u2, q->x, z1z1);
+    ble_sm_p256_fe_mul(s1, p->y, q->z);
+    ble_sm_p256_fe_mul(s1, s1, z2z2);
+    ble_sm_p256_fe_mul(s2, q->y, p->z);
+    ble_sm_p256_fe_mul(s2, s2, z1z1);
+
+    ble_sm_p256_fe_sub(h, u2, u1);
+    ble_sm_p256_fe_add(i, h, h);
+    ble_sm_p256_fe_sqr(i, i);
+    ble_sm_p256_fe_mul(j, h, i);
+    ble_sm_p256_fe_sub(rr, s2, s1);
+    ble_sm_p256_fe_add(rr, rr, rr);
+    ble_sm_p256_fe_mul(v, u1, i);
+
+    /* z3 = ((z1 + z2)^2 - z1z1 - z2z2) * h */
+    ble_sm_p256_fe_add(t, p->z, q->z);
+    ble_sm_p256_fe_sqr(t, t);
+    ble_sm_p256_fe_sub(t, t, z1z1);
+    ble_sm_p256_fe_sub(t, t, z2z2);
+    ble_sm_p256_fe_mul(r->z, t, h);
+
+    /* x3 = rr^2 - j - 2 * v */
+    ble_sm_p256_fe_sqr(t, rr);
+    ble_sm_p256_fe_sub(t, t, j);
+    ble_sm_p256_fe_sub(t, t, v);
+    ble_sm_p256_fe_sub(r->x, t, v);
+
+    /* y3 = rr * (v - x3) - 2 * s1 * j */
+    ble_sm_p256_fe_sub(t, v, r->x);
+    ble_sm_p256_fe_mul(t, rr, t);
+    ble_sm_p256_fe_mul(s1, s1, j);
+    ble_sm_p256_fe_add(s1, s1, s1);
+    ble_sm_p256_fe_sub(r->y, t, s1);
+}
+
+static void
+ble_sm_p256_jac_cmov(struct ble_sm_p256_jac *r,
+                     const struct ble_sm_p256_jac *a,
+                     ble_sm_p256_limb_t mask)
+{
+    ble_sm_p256_fe_cmov(r->x, a->x, mask);
+    ble_sm_p256_fe_cmov(r->y, a->y, mask);
+    ble_sm_p256_fe_cmov(r->z, a->z, mask);
+}
+
+/* Converts to big-endian affine x || y. */
+static void
+ble_sm_p256_jac_to_bytes(uint8_t *out, const struct ble_sm_p256_jac *p)
+{
+    ble_sm_p256_fe zinv, zinv2, t;
+
+    ble_sm_p256_fe_inv(zinv, p->z);
+    ble_sm_p256_fe_sqr(zinv2, zinv);
+
+    ble_sm_p256_fe_mul(t, p->x, zinv2);
+    ble_sm_p256_fe_from_mont(t, t);
+    ble_sm_p256_fe_to_bytes(out, t);
+
+    ble_sm_p256_fe_mul(zinv2, zinv2, zinv);
+    ble_sm_p256_fe_mul(t, p->y, zinv2);
+    ble_sm_p256_fe_from_mont(t, t);
+    ble_sm_p256_fe_to_bytes(out + 32, t);
+}
+
+static int
+ble_sm_p256_scalar_bit(const uint8_t *k, int bit)
+{
+    return (k[31 - bit / 8] >> (bit % 8)) & 1;
+}
+
+/* Checks 0 < k < n. */
+static int
+ble_sm_p256_scalar_valid(const uint8_t *k)
+{
+    uint8_t acc;
+    int i;
+
+    acc = 0;
+    for (i = 0; i < 32; i++) {
+        acc |= k[i];
+    }
+
+    return acc != 0 && memcmp(k, ble_sm_p256_n_be, 32) < 0;
+}
+
+/* r = k * G */
+static void
+ble_sm_p256_mul_base(struct ble_sm_p256_jac *r, const uint8_t *k)
+{
+    struct ble_sm_p256_aff q;
+    struct ble_sm_p256_jac sum;
+    struct ble_sm_p256_jac acc;
+    ble_sm_p256_limb_t inf;
+    ble_sm_p256_limb_t nz;
+    uint32_t digit;
+    int comb;
+    int col;
+    int i;
+    int t;
+
+    memset(&acc, 0, sizeof acc);
+    inf = -(ble_sm_p256_limb_t)1;
+
+    for (col = 31; col >= 0; col--) {
+        if (col != 31) {
+            ble_sm_p256_jac_dbl(&acc, &acc);
+        }
+
+        for (comb = 0; comb < 2; comb++) {
+            digit = 0;
+            for (t = 0; t < 4; t++) {
+                digit |= ble_sm_p256_scalar_bit(k, comb * 128 + t * 32 + col)
+                         << t;
+            }
+
+            memset(&q, 0, sizeof q);
+            for (i = 0; i < 15; i++) {
+                ble_sm_p256_fe_cmov(q.x, ble_sm_p256_comb[comb][i].x,
+                                    ble_sm_p256_eq_mask(i + 1, digit));
+                ble_sm_p256_fe_cmov(q.y, ble_sm_p256_comb[comb][i].y,
+                                    ble_sm_p256_eq_mask(i + 1, digit));
+            }
+
+            ble_sm_p256_jac_add_aff(&sum, &acc, &q);
+
+            /* Adding to infinity gives q itself. */
+            ble_sm_p256_fe_cmov(sum.x, q.x, inf);
+            ble_sm_p256_fe_cmov(sum.y, q.y, inf);
+            ble_sm_p256_fe_cmov(sum.z, ble_sm_p256_one, inf);
+
+            /* A zero digit adds nothing. */
+            nz = ~ble_sm_p256_eq_mask(0, digit);
+            ble_sm_p256_jac_cmov(&acc, &sum, nz);
+            inf &= ~nz;
+        }
+    }
+
+    *r = acc;
+}
+
+/* r = k * p */
+static void
+ble_sm_p256_mul(struct ble_sm_p256_jac *r, const struct ble_sm_p256_aff *p,
+                const uint8_t *k)
+{
+    struct ble_sm_p256_jac table[15];
+    struct ble_sm_p256_jac sum;
+    struct ble_sm_p256_jac acc;
+    struct ble_sm_p256_jac q;
+    ble_sm_p256_limb_t inf;
+    ble_sm_p256_limb_t nz;
+    uint32_t digit;
+    int win;
+    int i;
+
+    /* table[i] = (i + 1) * p */
+    ble_sm_p256_fe_copy(table[0].x, p->x);
+    ble_sm_p256_fe_copy(table[0].y, p->y);
+    ble_sm_p256_fe_copy(table[0].z, ble_sm_p256_one);
+    ble_sm_p256_jac_dbl(&table[1], &table[0]);
+    for (i = 2; i < 15; i++) {
+        ble_sm_p256_jac_add_aff(&table[i], &table[i - 1], p);
+    }
+
+    memset(&acc, 0, sizeof acc);
+    inf = -(ble_sm_p256_limb_t)1;
+
+    for (win = 63; win >= 0; win--) {
+        if (win != 63) {
+            for (i = 0; i < 4; i++) {
+                ble_sm_p256_jac_dbl(&acc, &acc);
+            }
+        }
+
+        digit = (k[31 - win / 2] >> ((win % 2) * 4)) & 0x0f;
+
+        memset(&q, 0, sizeof q);
+        for (i = 0; i < 15; i++) {
+            ble_sm_p256_jac_cmov(&q, &table[i],
+                                 ble_sm_p256_eq_mask(i + 1, digit));
+        }
+
+        ble_sm_p256_jac_add(&sum, &acc, &q);
+        ble_sm_p256_jac_cmov(&sum, &q, inf);
+
+        nz = ~ble_sm_p256_eq_mask(0, digit);
+        ble_sm_p256_jac_cmov(&acc, &sum, nz);
+        inf &= ~nz;
+    }
+
+    *r = acc;
+}
+
+/* Decodes a big-endian x || y public key and checks it is on the curve. */
+static int
+ble_sm_p256_aff_from_bytes(struct ble_sm_p256_aff *r, const uint8_t *pub)
+{
+    ble_sm_p256_fe lhs, rhs, t;
+
+    if (memcmp(pub, ble_sm_p256_p_be, 32) >= 0 ||
+        memcmp(pub + 32, ble_sm_p256_p_be, 32) >= 0) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_sm_p256_fe_from_bytes(t, pub);
+    ble_sm_p256_fe_to_mont(r->x, t);
+    ble_sm_p256_fe_from_bytes(t, pub + 32);
+    ble_sm_p256_fe_to_mont(r->y, t);
+
+    /* y^2 == x^3 - 3x + b */
+    ble_sm_p256_fe_sqr(lhs, r->y);
+
+    ble_sm_p256_fe_sqr(rhs, r->x);
+    ble_sm_p256_fe_mul(rhs, rhs, r->x);
+    ble_sm_p256_fe_add(t, r->x, r->x);
+    ble_sm_p256_fe_add(t, t, r->x);
+    ble_sm_p256_fe_sub(rhs, rhs, t);
+    ble_sm_p256_fe_add(rhs, rhs, ble_sm_p256_b);
+
+    if (!ble_sm_p256_fe_equal(lhs, rhs)) {
+        return BLE_HS_EINVAL;
+    }
+
+    return 0;
+}
+
+int
+ble_sm_p256_pub_key(const uint8_t *priv, uint8_t *pub)
+{
+    struct ble_sm_p256_jac r;
+
+    if (!ble_sm_p256_scalar_valid(priv)) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_sm_p256_mul_base(&r, priv);
+    ble_sm_p256_jac_to_bytes(pub, &r);
+
+    return 0;
+}
+
+int
+ble_sm_p256_ecdh(const uint8_t *pub, const uint8_t *priv, uint8_t *dhkey)
+{
+    struct ble_sm_p256_aff p;
+    struct ble_sm_p256_jac r;
+    uint8_t xy[64];
+    int rc;
+
+    if (!ble_sm_p256_scalar_valid(priv)) {
+        return BLE_HS_EINVAL;
+    }
+
+    rc = ble_sm_p256_aff_from_bytes(&p, pub);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_sm_p256_mul(&r, &p, priv);
+    ble_sm_p256_jac_to_bytes(xy, &r);
+    memcpy(dhkey, xy, 32);
+
+    return 0;
+}
+
+#endif
+#endif
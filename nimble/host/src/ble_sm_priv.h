@@ -24,6 +24,9 @@
 #include "syscfg/syscfg.h"
 #include "os/queue.h"
 #include "nimble/nimble_opt.h"
+#if !MYNEWT_VAL(BLE_SM_ALG_AESNI)
+#include "tinycrypt/aes.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -216,6 +219,7 @@ struct ble_sm_dhkey_check {
 #define BLE_SM_PROC_F_AUTHENTICATED         0x08
 #define BLE_SM_PROC_F_SC                    0x10
 #define BLE_SM_PROC_F_BONDING               0x20
+#define BLE_SM_PROC_F_OWN_KEYS              0x40
 
 #define BLE_SM_KE_F_ENC_INFO                0x01
 #define BLE_SM_KE_F_MASTER_ID               0x02
@@ -271,6 +275,11 @@ struct ble_sm_proc {
     uint8_t dhkey[32];
     const struct ble_sm_sc_oob_data *oob_data_local;
     const struct ble_sm_sc_oob_data *oob_data_remote;
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+    /* Per-pairing key pair; valid if BLE_SM_PROC_F_OWN_KEYS is set. */
+    uint8_t pub_key_our[64];
+    uint8_t priv_key_our[32];
+#endif
 #endif
 };
 
@@ -296,6 +305,32 @@ void ble_sm_dbg_set_sc_keys(uint8_t *pubkey, uint8_t *privkey);
 
 int ble_sm_num_procs(void);
 
+/**
+ * AES-128 key with its expanded key schedule.  Keys used for more than one
+ * block (IRKs, SIRKs, LTKs) are set up once with ble_sm_alg_key_init() and
+ * then passed to ble_sm_alg_e() / ble_sm_alg_ah() as often as needed.
+ */
+struct ble_sm_alg_key {
+#if MYNEWT_VAL(BLE_SM_ALG_AESNI)
+    uint8_t rk[11 * 16];
+#else
+    struct tc_aes_key_sched_struct sched;
+#endif
+#if MYNEWT_VAL(BLE_SM_SC)
+    /* AES-CMAC subkeys; only set for CMAC keys. */
+    uint8_t k1[16];
+    uint8_t k2[16];
+#endif
+};
+
+int ble_sm_alg_init(void);
+int ble_sm_alg_key_init(struct ble_sm_alg_key *key, const uint8_t *k);
+int ble_sm_alg_e(const struct ble_sm_alg_key *key, const uint8_t *plaintext,
+                 uint8_t *enc_data);
+int ble_sm_alg_ah(const struct ble_sm_alg_key *irk, const uint8_t *r,
+                  uint8_t *out);
+int ble_sm_alg_rpa_resolve(const struct ble_sm_alg_key *irks, int num_irks,
+                           const uint8_t *rpa, int *out_idx);
 int ble_sm_alg_s1(const uint8_t *k, const uint8_t *r1, const uint8_t *r2,
                   uint8_t *out);
 int ble_sm_alg_c1(const uint8_t *k, const uint8_t *r,
@@ -328,6 +363,11 @@ int ble_sm_alg_gen_dhkey(const uint8_t *peer_pub_key_x,
 int ble_sm_alg_gen_key_pair(uint8_t *pub, uint8_t *priv);
 void ble_sm_alg_ecc_init(void);
 
+#if MYNEWT_VAL(BLE_SM_SC_P256)
+int ble_sm_p256_pub_key(const uint8_t *priv, uint8_t *pub);
+int ble_sm_p256_ecdh(const uint8_t *pub, const uint8_t *priv, uint8_t *dhkey);
+#endif
+
 int ble_sm_csis_generate_rsi(const uint8_t *sirk, uint8_t *out);
 int ble_sm_csis_encrypt_sirk(const uint8_t *ltk, const uint8_t *plaintext_sirk,
                              uint8_t *out);
@@ -373,6 +413,10 @@ bool ble_sm_sc_oob_data_check(struct ble_sm_proc *proc,
                               bool oob_data_remote_present);
 void ble_sm_sc_oob_confirm(struct ble_sm_proc *proc, struct ble_sm_result *res);
 void ble_sm_sc_init(void);
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+void ble_sm_sc_key_pool_fill(void);
+int ble_sm_sc_key_pool_num(void);
+#endif
 #else
 #define ble_sm_sc_io_action(proc, action) (BLE_HS_ENOTSUP)
 #define ble_sm_sc_confirm_exec(proc, res)
@@ -39,6 +39,24 @@ static uint8_t ble_sm_sc_priv_key[32];
  */
 static uint8_t ble_sm_sc_keys_generated;
 
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+#define BLE_SM_SC_KEY_POOL_SIZE     MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+
+struct ble_sm_sc_key_pair {
+    uint8_t pub[64];
+    uint8_t priv[32];
+};
+
+/**
+ * Key pairs generated ahead of time so that every pairing (other than OOB,
+ * whose data commits to the static key pair) gets a fresh key pair without
+ * waiting for key generation.  Refilled one pair per host event.
+ */
+static struct ble_sm_sc_key_pair ble_sm_sc_key_pool[BLE_SM_SC_KEY_POOL_SIZE];
+static uint8_t ble_sm_sc_key_pool_cnt;
+static struct ble_npl_event ble_sm_sc_key_pool_ev;
+#endif
+
 /**
  * Create some shortened names for the passkey actions so that the table is
  * easier to read.
@@ -196,6 +214,172 @@ ble_sm_sc_ensure_keys_generated(void)
     return 0;
 }
 
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+static void
+ble_sm_sc_key_pool_fill_event(struct ble_npl_event *ev)
+{
+    struct ble_sm_sc_key_pair pair;
+    int full;
+    int rc;
+
+    rc = ble_sm_alg_gen_key_pair(pair.pub, pair.priv);
+    if (rc != 0) {
+        /* Retried when the next pair is taken out of the pool. */
+        return;
+    }
+
+    ble_hs_lock();
+    if (!ble_sm_sc_keys_generated) {
+        /* The static key pair comes first; pairings fall back to it when
+         * the pool runs dry.
+         */
+        memcpy(ble_sm_sc_pub_key, pair.pub, sizeof pair.pub);
+        memcpy(ble_sm_sc_priv_key, pair.priv, sizeof pair.priv);
+        ble_sm_sc_keys_generated = 1;
+        full = 0;
+    } else {
+        full = ble_sm_sc_key_pool_cnt >= BLE_SM_SC_KEY_POOL_SIZE;
+        if (!full) {
+            ble_sm_sc_key_pool[ble_sm_sc_key_pool_cnt++] = pair;
+            full = ble_sm_sc_key_pool_cnt >= BLE_SM_SC_KEY_POOL_SIZE;
+        }
+    }
+    ble_hs_unlock();
+
+    memset(&pair, 0, sizeof pair);
+
+    if (!full) {
+        ble_sm_sc_key_pool_fill();
+    }
+}
+
+void
+ble_sm_sc_key_pool_fill(void)
+{
+    if (!ble_npl_event_is_queued(&ble_sm_sc_key_pool_ev)) {
+        ble_npl_eventq_put(ble_hs_evq_get(), &ble_sm_sc_key_pool_ev);
+    }
+}
+
+/**
+ * Gives the procedure its own key pair from the pool.  If the pool has run
+ * dry the static key pair is used instead, so that no key pair is generated
+ * with the host locked.  Must be called with the host lock held.
+ */
+static int
+ble_sm_sc_key_pool_take(struct ble_sm_proc *proc)
+{
+    struct ble_sm_sc_key_pair *pair;
+    int use_pool;
+    int rc;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    if (proc->flags & BLE_SM_PROC_F_OWN_KEYS) {
+        return 0;
+    }
+
+    use_pool = ble_sm_sc_key_pool_cnt > 0;
+
+#if MYNEWT_VAL(BLE_HS_DEBUG)
+    if (ble_sm_dbg_sc_keys_set) {
+        /* Debug keys replace the static key pair, as without the pool. */
+        ble_sm_sc_keys_generated = 0;
+        use_pool = 0;
+    }
+#endif
+
+    if (use_pool) {
+        pair = &ble_sm_sc_key_pool[--ble_sm_sc_key_pool_cnt];
+        memcpy(proc->pub_key_our, pair->pub, sizeof pair->pub);
+        memcpy(proc->priv_key_our, pair->priv, sizeof pair->priv);
+        memset(pair, 0, sizeof *pair);
+    } else {
+        rc = ble_sm_sc_ensure_keys_generated();
+        if (rc != 0) {
+            return rc;
+        }
+
+        memcpy(proc->pub_key_our, ble_sm_sc_pub_key, sizeof ble_sm_sc_pub_key);
+        memcpy(proc->priv_key_our, ble_sm_sc_priv_key,
+               sizeof ble_sm_sc_priv_key);
+    }
+
+    proc->flags |= BLE_SM_PROC_F_OWN_KEYS;
+    ble_sm_sc_key_pool_fill();
+
+    return 0;
+}
+
+int
+ble_sm_sc_key_pool_num(void)
+{
+    int num;
+
+    ble_hs_lock();
+    num = ble_sm_sc_key_pool_cnt;
+    ble_hs_unlock();
+
+    return num;
+}
+#endif
+
+/**
+ * Generates the static key pair, if not done yet, so that
+ * ble_sm_sc_proc_keys() does not have to do it with the host lock held.
+ * Pending debug keys are left for ble_sm_sc_proc_keys() to pick up.
+ */
+static int
+ble_sm_sc_keys_prepare(void)
+{
+#if MYNEWT_VAL(BLE_HS_DEBUG)
+    if (ble_sm_dbg_sc_keys_set) {
+        return 0;
+    }
+#endif
+
+    return ble_sm_sc_ensure_keys_generated();
+}
+
+/**
+ * Makes sure our key pair for this pairing is available.
+ */
+static int
+ble_sm_sc_proc_keys(struct ble_sm_proc *proc)
+{
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+    if (proc->pair_alg != BLE_SM_PAIR_ALG_OOB) {
+        return ble_sm_sc_key_pool_take(proc);
+    }
+#endif
+
+    return ble_sm_sc_ensure_keys_generated();
+}
+
+static const uint8_t *
+ble_sm_sc_our_pub_key(const struct ble_sm_proc *proc)
+{
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+    if (proc->flags & BLE_SM_PROC_F_OWN_KEYS) {
+        return proc->pub_key_our;
+    }
+#endif
+
+    return ble_sm_sc_pub_key;
+}
+
+static const uint8_t *
+ble_sm_sc_our_priv_key(const struct ble_sm_proc *proc)
+{
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+    if (proc->flags & BLE_SM_PROC_F_OWN_KEYS) {
+        return proc->priv_key_our;
+    }
+#endif
+
+    return ble_sm_sc_priv_key;
+}
+
 /* Initiator does not send a confirm when pairing algorithm is any of:
  *     o just works
  *     o numeric comparison
@@ -321,7 +505,7 @@ ble_sm_sc_confirm_exec(struct ble_sm_proc *proc, struct ble_sm_result *res)
         return;
     }
 
-    rc = ble_sm_alg_f4(ble_sm_sc_pub_key, proc->pub_key_peer.x,
+    rc = ble_sm_alg_f4(ble_sm_sc_our_pub_key(proc), proc->pub_key_peer.x,
                        ble_sm_our_pair_rand(proc), proc->ri, cmd->value);
     if (rc != 0) {
         os_mbuf_free_chain(txom);
@@ -347,15 +531,15 @@ ble_sm_sc_confirm_exec(struct ble_sm_proc *proc, struct ble_sm_result *res)
 static void
 ble_sm_sc_gen_numcmp(struct ble_sm_proc *proc, struct ble_sm_result *res)
 {
-    uint8_t *pka;
-    uint8_t *pkb;
+    const uint8_t *pka;
+    const uint8_t *pkb;
 
     if (proc->flags & BLE_SM_PROC_F_INITIATOR) {
-        pka = ble_sm_sc_pub_key;
+        pka = ble_sm_sc_our_pub_key(proc);
         pkb = proc->pub_key_peer.x;
     } else {
         pka = proc->pub_key_peer.x;
-        pkb = ble_sm_sc_pub_key;
+        pkb = ble_sm_sc_our_pub_key(proc);
     }
     res->app_status = ble_sm_alg_g2(pka, pkb, proc->randm, proc->rands,
                                     &res->passkey_params.numcmp);
@@ -456,7 +640,7 @@ ble_sm_sc_random_rx(struct ble_sm_proc *proc, struct ble_sm_result *res)
         ble_hs_log_flat_buf(proc->tk, 16);
         BLE_HS_LOG(DEBUG, "\n");
 
-        rc = ble_sm_alg_f4(proc->pub_key_peer.x, ble_sm_sc_pub_key,
+        rc = ble_sm_alg_f4(proc->pub_key_peer.x, ble_sm_sc_our_pub_key(proc),
                            ble_sm_peer_pair_rand(proc), proc->ri,
                            confirm_val);
         if (rc != 0) {
@@ -540,7 +724,7 @@ ble_sm_sc_public_key_exec(struct ble_sm_proc *proc, struct ble_sm_result *res,
     uint8_t ioact;
     int rc;
 
-    res->app_status = ble_sm_sc_ensure_keys_generated();
+    res->app_status = ble_sm_sc_proc_keys(proc);
     if (res->app_status != 0) {
         res->enc_cb = 1;
         res->sm_err = BLE_SM_ERR_UNSPECIFIED;
@@ -555,8 +739,8 @@ ble_sm_sc_public_key_exec(struct ble_sm_proc *proc, struct ble_sm_result *res,
         return;
     }
 
-    memcpy(cmd->x, ble_sm_sc_pub_key + 0, 32);
-    memcpy(cmd->y, ble_sm_sc_pub_key + 32, 32);
+    memcpy(cmd->x, ble_sm_sc_our_pub_key(proc) + 0, 32);
+    memcpy(cmd->y, ble_sm_sc_our_pub_key(proc) + 32, 32);
 
     res->app_status = ble_sm_tx(proc->conn_handle, txom);
     if (res->app_status != 0) {
@@ -604,7 +788,7 @@ ble_sm_sc_public_key_rx(uint16_t conn_handle, struct os_mbuf **om,
         return;
     }
 
-    res->app_status = ble_sm_sc_ensure_keys_generated();
+    res->app_status = ble_sm_sc_keys_prepare();
     if (res->app_status != 0) {
         res->enc_cb = 1;
         res->sm_err = BLE_SM_ERR_UNSPECIFIED;
@@ -612,13 +796,6 @@ ble_sm_sc_public_key_rx(uint16_t conn_handle, struct os_mbuf **om,
     }
 
     cmd = (struct ble_sm_public_key *)(*om)->om_data;
-    /* Check if the peer public key is same as our generated public key.
-     * Return fail if the public keys match. */
-    if (memcmp(cmd, ble_sm_sc_pub_key, 64) == 0) {
-        res->enc_cb = 1;
-        res->sm_err = BLE_SM_ERR_AUTHREQ;
-        return;
-    }
 
     ble_hs_lock();
     proc = ble_sm_proc_find(conn_handle, BLE_SM_PROC_STATE_PUBLIC_KEY, -1,
@@ -626,11 +803,19 @@ ble_sm_sc_public_key_rx(uint16_t conn_handle, struct os_mbuf **om,
     if (proc == NULL) {
         res->app_status = BLE_HS_ENOENT;
         res->sm_err = BLE_SM_ERR_UNSPECIFIED;
+    } else if ((res->app_status = ble_sm_sc_proc_keys(proc)) != 0) {
+        res->enc_cb = 1;
+        res->sm_err = BLE_SM_ERR_UNSPECIFIED;
+    } else if (memcmp(cmd, ble_sm_sc_our_pub_key(proc), 64) == 0) {
+        /* Check if the peer public key is same as our generated public key.
+         * Return fail if the public keys match. */
+        res->enc_cb = 1;
+        res->sm_err = BLE_SM_ERR_AUTHREQ;
     } else {
         memcpy(&proc->pub_key_peer, cmd, sizeof(*cmd));
         rc = ble_sm_alg_gen_dhkey(proc->pub_key_peer.x,
                                   proc->pub_key_peer.y,
-                                  ble_sm_sc_priv_key,
+                                  ble_sm_sc_our_priv_key(proc),
                                   proc->dhkey);
         if (rc != 0) {
             res->app_status = BLE_HS_SM_US_ERR(BLE_SM_ERR_DHKEY);
@@ -912,6 +1097,13 @@ ble_sm_sc_init(void)
 {
     ble_sm_alg_ecc_init();
     ble_sm_sc_keys_generated = 0;
+
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+    memset(ble_sm_sc_key_pool, 0, sizeof ble_sm_sc_key_pool);
+    ble_sm_sc_key_pool_cnt = 0;
+    ble_npl_event_init(&ble_sm_sc_key_pool_ev, ble_sm_sc_key_pool_fill_event,
+                       NULL);
+#endif
 }
 
 #endif  /* MYNEWT_VAL(BLE_SM_SC) */
@@ -20,6 +20,8 @@
 #ifndef H_BLE_STORE_CONFIG_
 #define H_BLE_STORE_CONFIG_
 
+#include <inttypes.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,6 +33,24 @@ int ble_store_config_read(int obj_type, const union ble_store_key *key,
                           union ble_store_value *value);
 int ble_store_config_write(int obj_type, const union ble_store_value *val);
 int ble_store_config_delete(int obj_type, const union ble_store_key *key);
+int ble_store_config_flush(void);
+
+struct ble_store_config_persist_stats {
+    /** Number of settings written or deleted. */
+    uint32_t saves;
+
+    /** Setting names and values written, in bytes. */
+    uint32_t bytes;
+
+    /** Changes absorbed by a write that was already pending. */
+    uint32_t coalesced;
+
+    /** Number of times pending changes were written out. */
+    uint32_t flushes;
+};
+
+void ble_store_config_persist_stats(
+    struct ble_store_config_persist_stats *stats);
 
 #ifdef __cplusplus
 }
@@ -47,6 +47,8 @@ struct ble_store_value_cccd
 
 int ble_store_config_num_cccds;
 
+struct ble_store_config_persist_stats ble_store_config_stats;
+
 /*****************************************************************************
  * $sec                                                                      *
  *****************************************************************************/
@@ -162,7 +164,8 @@ ble_store_config_write_our_sec(const struct ble_store_value_sec *value_sec)
 
     ble_store_config_our_secs[idx] = *value_sec;
 
-    rc = ble_store_config_persist_our_secs();
+    rc = ble_store_config_persist(BLE_STORE_OBJ_TYPE_OUR_SEC,
+                                  &value_sec->peer_addr, 0);
     if (rc != 0) {
         return rc;
     }
@@ -199,7 +202,7 @@ ble_store_config_delete_obj(void *values, int value_size, int idx,
 static int
 ble_store_config_delete_sec(const struct ble_store_key_sec *key_sec,
                             struct ble_store_value_sec *value_secs,
-                            int *num_value_secs)
+                            int *num_value_secs, ble_addr_t *out_peer_addr)
 {
     int idx;
     int rc;
@@ -209,6 +212,8 @@ ble_store_config_delete_sec(const struct ble_store_key_sec *key_sec,
         return BLE_HS_ENOENT;
     }
 
+    *out_peer_addr = value_secs[idx].peer_addr;
+
     rc = ble_store_config_delete_obj(value_secs, sizeof *value_secs, idx,
                                   num_value_secs);
     if (rc != 0) {
@@ -223,15 +228,17 @@ static int
 ble_store_config_delete_our_sec(const struct ble_store_key_sec *key_sec)
 {
 #if MYNEWT_VAL(BLE_STORE_MAX_BONDS)
+    ble_addr_t peer_addr;
     int rc;
 
     rc = ble_store_config_delete_sec(key_sec, ble_store_config_our_secs,
-                                     &ble_store_config_num_our_secs);
+                                     &ble_store_config_num_our_secs,
+                                     &peer_addr);
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_store_config_persist_our_secs();
+    rc = ble_store_config_persist(BLE_STORE_OBJ_TYPE_OUR_SEC, &peer_addr, 0);
     if (rc != 0) {
         return rc;
     }
@@ -246,15 +253,17 @@ static int
 ble_store_config_delete_peer_sec(const struct ble_store_key_sec *key_sec)
 {
 #if MYNEWT_VAL(BLE_STORE_MAX_BONDS)
+    ble_addr_t peer_addr;
     int rc;
 
     rc = ble_store_config_delete_sec(key_sec, ble_store_config_peer_secs,
-                                  &ble_store_config_num_peer_secs);
+                                  &ble_store_config_num_peer_secs,
+                                  &peer_addr);
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_store_config_persist_peer_secs();
+    rc = ble_store_config_persist(BLE_STORE_OBJ_TYPE_PEER_SEC, &peer_addr, 0);
     if (rc != 0) {
         return rc;
     }
@@ -312,7 +321,8 @@ ble_store_config_write_peer_sec(const struct ble_store_value_sec *value_sec)
 
     ble_store_config_peer_secs[idx] = *value_sec;
 
-    rc = ble_store_config_persist_peer_secs();
+    rc = ble_store_config_persist(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                  &value_sec->peer_addr, 0);
     if (rc != 0) {
         return rc;
     }
@@ -365,6 +375,7 @@ static int
 ble_store_config_delete_cccd(const struct ble_store_key_cccd *key_cccd)
 {
 #if MYNEWT_VAL(BLE_STORE_MAX_CCCDS)
+    struct ble_store_value_cccd deleted;
     int idx;
     int rc;
 
@@ -373,6 +384,7 @@ ble_store_config_delete_cccd(const struct ble_store_key_cccd *key_cccd)
         return BLE_HS_ENOENT;
     }
 
+    deleted = ble_store_config_cccds[idx];
     rc = ble_store_config_delete_obj(ble_store_config_cccds,
                                      sizeof *ble_store_config_cccds,
                                      idx,
@@ -381,7 +393,8 @@ ble_store_config_delete_cccd(const struct ble_store_key_cccd *key_cccd)
         return rc;
     }
 
-    rc = ble_store_config_persist_cccds();
+    rc = ble_store_config_persist(BLE_STORE_OBJ_TYPE_CCCD,
+                                  &deleted.peer_addr, deleted.chr_val_handle);
     if (rc != 0) {
         return rc;
     }
@@ -433,7 +446,9 @@ ble_store_config_write_cccd(const struct ble_store_value_cccd *value_cccd)
 
     ble_store_config_cccds[idx] = *value_cccd;
 
-    rc = ble_store_config_persist_cccds();
+    rc = ble_store_config_persist(BLE_STORE_OBJ_TYPE_CCCD,
+                                  &value_cccd->peer_addr,
+                                  value_cccd->chr_val_handle);
     if (rc != 0) {
         return rc;
     }
@@ -543,6 +558,29 @@ ble_store_config_delete(int obj_type, const union ble_store_key *key)
     }
 }
 
+/**
+ * Writes out any store changes still held back by the deferred flush window
+ * (BLE_STORE_CONFIG_FLUSH_MS).  Call before a planned reset or power down.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ESTORE_FAIL if a setting could not be
+ *                              saved.
+ */
+int
+ble_store_config_flush(void)
+{
+    return ble_store_config_persist_flush();
+}
+
+/**
+ * Reports how much has been written to persistent storage since boot.
+ */
+void
+ble_store_config_persist_stats(struct ble_store_config_persist_stats *stats)
+{
+    *stats = ble_store_config_stats;
+}
+
 void
 ble_store_config_init(void)
 {
@@ -557,6 +595,7 @@ ble_store_config_init(void)
     ble_store_config_num_our_secs = 0;
     ble_store_config_num_peer_secs = 0;
     ble_store_config_num_cccds = 0;
+    memset(&ble_store_config_stats, 0, sizeof ble_store_config_stats);
 
     ble_store_config_conf_init();
 }
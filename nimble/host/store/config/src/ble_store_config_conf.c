@@ -22,6 +22,8 @@
 #if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST)
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "sysinit/sysinit.h"
@@ -34,6 +36,8 @@
 static int
 ble_store_config_conf_set(int argc, char **argv, char *val);
 static int
+ble_store_config_conf_commit(void);
+static int
 ble_store_config_conf_export(void (*func)(char *name, char *val),
                              enum conf_export_tgt tgt);
 
@@ -41,10 +45,65 @@ static struct conf_handler ble_store_config_conf_handler = {
     .ch_name = "ble_hs",
     .ch_get = NULL,
     .ch_set = ble_store_config_conf_set,
-    .ch_commit = NULL,
+    .ch_commit = ble_store_config_conf_commit,
     .ch_export = ble_store_config_conf_export
 };
 
+#define BLE_STORE_CONFIG_OBJ_BIT(obj_type)  (1 << (obj_type))
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+
+/*
+ * Every bond and every CCCD is its own setting, named after its key:
+ *
+ *     ble_hs/os/<addr>            our security material
+ *     ble_hs/ps/<addr>            peer security material
+ *     ble_hs/cd/<addr><handle>    CCCD
+ *
+ * <addr> is the address type followed by the address, <handle> the
+ * characteristic value handle, all in hex.  A change rewrites or deletes
+ * only the affected setting.
+ *
+ * Changes are recorded by key in a pending table, so repeated updates of
+ * the same record collapse into a single write of its latest state.
+ *
+ * Settings in the old whole-array format are kept aside while loading and
+ * merged in at commit time.  A record always wins over an entry with the
+ * same key from an old array, whatever order the settings are loaded in.
+ */
+
+#define BLE_STORE_CONFIG_REC_NAME_SZ    32
+
+struct ble_store_config_pending {
+    uint8_t obj_type;
+    uint16_t chr_val_handle;
+    ble_addr_t peer_addr;
+};
+
+static struct ble_store_config_pending
+    ble_store_config_pending[MYNEWT_VAL(BLE_STORE_CONFIG_PENDING_MAX)];
+static int ble_store_config_num_pending;
+
+/** An old whole-array setting found at load time. */
+struct ble_store_config_legacy {
+    void *objs;
+    int num_objs;
+};
+
+/** Indexed by BLE_STORE_OBJ_TYPE_[...] - 1. */
+static struct ble_store_config_legacy ble_store_config_legacy[3];
+
+#else
+
+/** Object types whose whole array has to be rewritten. */
+static uint8_t ble_store_config_dirty;
+
+#endif
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_FLUSH_MS) > 0
+static struct ble_npl_callout ble_store_config_flush_timer;
+#endif
+
 #define BLE_STORE_CONFIG_SEC_ENCODE_SZ      \
     BASE64_ENCODE_SIZE(sizeof (struct ble_store_value_sec))
 
@@ -86,38 +145,350 @@ ble_store_config_deserialize_arr(const char *enc,
     return 0;
 }
 
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+static int
+ble_store_config_find_sec_rec(const struct ble_store_value_sec *secs,
+                              int num_secs, const ble_addr_t *peer_addr)
+{
+    int i;
+
+    for (i = 0; i < num_secs; i++) {
+        if (ble_addr_cmp(&secs[i].peer_addr, peer_addr) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int
+ble_store_config_find_cccd_rec(const ble_addr_t *peer_addr,
+                               uint16_t chr_val_handle)
+{
+    int i;
+
+    for (i = 0; i < ble_store_config_num_cccds; i++) {
+        if (ble_store_config_cccds[i].chr_val_handle == chr_val_handle &&
+            ble_addr_cmp(&ble_store_config_cccds[i].peer_addr,
+                         peer_addr) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Parses the key part of a record setting name, see
+ * ble_store_config_rec_name().
+ */
+static int
+ble_store_config_parse_rec_key(const char *key, int has_handle,
+                               ble_addr_t *peer_addr,
+                               uint16_t *chr_val_handle)
+{
+    uint8_t *v;
+    int len;
+    int n;
+
+    v = peer_addr->val;
+    *chr_val_handle = 0;
+    len = has_handle ? 18 : 14;
+    if (strlen(key) != len) {
+        return OS_EINVAL;
+    }
+
+    n = sscanf(key, "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx%4hx",
+               &peer_addr->type, &v[5], &v[4], &v[3], &v[2], &v[1], &v[0],
+               chr_val_handle);
+    if (n != (has_handle ? 8 : 7)) {
+        return OS_EINVAL;
+    }
+
+    return 0;
+}
+
+static void
+ble_store_config_remove_rec(void *recs, int rec_sz, int idx, int *num_recs)
+{
+    uint8_t *dst;
+
+    (*num_recs)--;
+    if (idx < *num_recs) {
+        dst = (uint8_t *)recs + idx * rec_sz;
+        memmove(dst, dst + rec_sz, (*num_recs - idx) * rec_sz);
+    }
+}
+
+/**
+ * Loads a single record setting.  An empty value means the record was
+ * deleted after an earlier setting for it was stored.
+ */
+static int
+ble_store_config_conf_set_rec(const char *type, const char *key, char *val)
+{
+    /* Decoded data is never longer than its encoding; base64_decode()
+     * writes whole 3-byte groups, so it may need all of it.
+     */
+    union {
+        struct ble_store_value_sec sec;
+        struct ble_store_value_cccd cccd;
+        uint8_t raw[BLE_STORE_CONFIG_SEC_ENCODE_SZ];
+    } rec;
+    struct ble_store_value_sec *secs;
+    uint16_t chr_val_handle;
+    ble_addr_t peer_addr;
+    int *num_secs;
+    int max_secs;
+    int idx;
+    int len;
+    int rc;
+
+    if (strcmp(type, "os") == 0) {
+        secs = ble_store_config_our_secs;
+        num_secs = &ble_store_config_num_our_secs;
+    } else if (strcmp(type, "ps") == 0) {
+        secs = ble_store_config_peer_secs;
+        num_secs = &ble_store_config_num_peer_secs;
+    } else if (strcmp(type, "cd") == 0) {
+        secs = NULL;
+        num_secs = NULL;
+    } else {
+        return OS_ENOENT;
+    }
+
+    if (val[0] == '\0') {
+        rc = ble_store_config_parse_rec_key(key, secs == NULL, &peer_addr,
+                                            &chr_val_handle);
+        if (rc != 0) {
+            return rc;
+        }
+
+        if (secs != NULL) {
+            idx = ble_store_config_find_sec_rec(secs, *num_secs, &peer_addr);
+            if (idx != -1) {
+                ble_store_config_remove_rec(secs, sizeof *secs, idx,
+                                            num_secs);
+            }
+        } else {
+            idx = ble_store_config_find_cccd_rec(&peer_addr, chr_val_handle);
+            if (idx != -1) {
+                ble_store_config_remove_rec(ble_store_config_cccds,
+                                            sizeof *ble_store_config_cccds,
+                                            idx, &ble_store_config_num_cccds);
+            }
+        }
+
+        return 0;
+    }
+
+    if (strlen(val) > sizeof rec.raw) {
+        return OS_EINVAL;
+    }
+
+    len = base64_decode(val, rec.raw);
+
+    if (secs != NULL) {
+        if (len != sizeof rec.sec) {
+            return OS_EINVAL;
+        }
+
+        max_secs = MYNEWT_VAL(BLE_STORE_MAX_BONDS);
+        idx = ble_store_config_find_sec_rec(secs, *num_secs,
+                                            &rec.sec.peer_addr);
+        if (idx == -1) {
+            if (*num_secs >= max_secs) {
+                return OS_ENOMEM;
+            }
+            idx = (*num_secs)++;
+        }
+        secs[idx] = rec.sec;
+    } else {
+        if (len != sizeof rec.cccd) {
+            return OS_EINVAL;
+        }
+
+        idx = ble_store_config_find_cccd_rec(&rec.cccd.peer_addr,
+                                             rec.cccd.chr_val_handle);
+        if (idx == -1) {
+            if (ble_store_config_num_cccds >= MYNEWT_VAL(BLE_STORE_MAX_CCCDS)) {
+                return OS_ENOMEM;
+            }
+            idx = ble_store_config_num_cccds++;
+        }
+        ble_store_config_cccds[idx] = rec.cccd;
+    }
+
+    return 0;
+}
+
+/**
+ * Keeps an old whole-array setting aside until commit, so it can't
+ * overwrite records that were loaded before it.
+ */
+static int
+ble_store_config_conf_set_legacy(const char *name, char *val)
+{
+    struct ble_store_config_legacy *legacy;
+    int max_objs;
+    int obj_sz;
+    int rc;
+
+    if (strcmp(name, "our_sec") == 0) {
+        legacy = &ble_store_config_legacy[BLE_STORE_OBJ_TYPE_OUR_SEC - 1];
+        obj_sz = sizeof (struct ble_store_value_sec);
+        max_objs = MYNEWT_VAL(BLE_STORE_MAX_BONDS);
+    } else if (strcmp(name, "peer_sec") == 0) {
+        legacy = &ble_store_config_legacy[BLE_STORE_OBJ_TYPE_PEER_SEC - 1];
+        obj_sz = sizeof (struct ble_store_value_sec);
+        max_objs = MYNEWT_VAL(BLE_STORE_MAX_BONDS);
+    } else if (strcmp(name, "cccd") == 0) {
+        legacy = &ble_store_config_legacy[BLE_STORE_OBJ_TYPE_CCCD - 1];
+        obj_sz = sizeof (struct ble_store_value_cccd);
+        max_objs = MYNEWT_VAL(BLE_STORE_MAX_CCCDS);
+    } else {
+        return OS_ENOENT;
+    }
+
+    /* Already converted and deleted */
+    if (val[0] == '\0') {
+        free(legacy->objs);
+        legacy->objs = NULL;
+        legacy->num_objs = 0;
+        return 0;
+    }
+
+    if (strlen(val) > BASE64_ENCODE_SIZE(obj_sz * max_objs)) {
+        return OS_EINVAL;
+    }
+
+    if (legacy->objs == NULL) {
+        /* Room for the padding base64_decode() may write past the end */
+        legacy->objs = malloc(obj_sz * max_objs + 3);
+        if (legacy->objs == NULL) {
+            return OS_ENOMEM;
+        }
+    }
+
+    rc = ble_store_config_deserialize_arr(val, legacy->objs, obj_sz,
+                                          &legacy->num_objs);
+    if (rc != 0) {
+        legacy->num_objs = 0;
+    }
+
+    return rc;
+}
+#endif
+
 static int
 ble_store_config_conf_set(int argc, char **argv, char *val)
 {
     int rc;
 
+    /* A deleted setting clears what earlier settings loaded. */
+    if (val == NULL) {
+        val = "";
+    }
+
     if (argc == 1) {
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+        rc = ble_store_config_conf_set_legacy(argv[0], val);
+#else
         if (strcmp(argv[0], "our_sec") == 0) {
             rc = ble_store_config_deserialize_arr(
                     val,
                     ble_store_config_our_secs,
                     sizeof *ble_store_config_our_secs,
                     &ble_store_config_num_our_secs);
-            return rc;
         } else if (strcmp(argv[0], "peer_sec") == 0) {
             rc = ble_store_config_deserialize_arr(
                     val,
                     ble_store_config_peer_secs,
                     sizeof *ble_store_config_peer_secs,
                     &ble_store_config_num_peer_secs);
-            return rc;
         } else if (strcmp(argv[0], "cccd") == 0) {
             rc = ble_store_config_deserialize_arr(
                     val,
                     ble_store_config_cccds,
                     sizeof *ble_store_config_cccds,
                     &ble_store_config_num_cccds);
-            return rc;
+        } else {
+            return OS_ENOENT;
         }
+#endif
+
+        return rc;
+    }
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+    if (argc == 2) {
+        return ble_store_config_conf_set_rec(argv[0], argv[1], val);
     }
+#endif
+
     return OS_ENOENT;
 }
 
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+static void
+ble_store_config_rec_name(char *buf, const char *type,
+                          const ble_addr_t *peer_addr,
+                          uint16_t chr_val_handle)
+{
+    const uint8_t *v;
+
+    v = peer_addr->val;
+    if (strcmp(type, "cd") == 0) {
+        snprintf(buf, BLE_STORE_CONFIG_REC_NAME_SZ,
+                 "ble_hs/%s/%02x%02x%02x%02x%02x%02x%02x%04x", type,
+                 peer_addr->type, v[5], v[4], v[3], v[2], v[1], v[0],
+                 chr_val_handle);
+    } else {
+        snprintf(buf, BLE_STORE_CONFIG_REC_NAME_SZ,
+                 "ble_hs/%s/%02x%02x%02x%02x%02x%02x%02x", type,
+                 peer_addr->type, v[5], v[4], v[3], v[2], v[1], v[0]);
+    }
+}
+
+static int
+ble_store_config_conf_export(void (*func)(char *name, char *val),
+                             enum conf_export_tgt tgt)
+{
+    char name[BLE_STORE_CONFIG_REC_NAME_SZ];
+    union {
+        char sec[BLE_STORE_CONFIG_SEC_ENCODE_SZ + 1];
+        char cccd[BLE_STORE_CONFIG_CCCD_ENCODE_SZ + 1];
+    } buf;
+    int i;
+
+    for (i = 0; i < ble_store_config_num_our_secs; i++) {
+        ble_store_config_rec_name(name, "os",
+                                  &ble_store_config_our_secs[i].peer_addr, 0);
+        base64_encode(ble_store_config_our_secs + i,
+                      sizeof *ble_store_config_our_secs, buf.sec, 1);
+        func(name, buf.sec);
+    }
+
+    for (i = 0; i < ble_store_config_num_peer_secs; i++) {
+        ble_store_config_rec_name(name, "ps",
+                                  &ble_store_config_peer_secs[i].peer_addr, 0);
+        base64_encode(ble_store_config_peer_secs + i,
+                      sizeof *ble_store_config_peer_secs, buf.sec, 1);
+        func(name, buf.sec);
+    }
+
+    for (i = 0; i < ble_store_config_num_cccds; i++) {
+        ble_store_config_rec_name(name, "cd",
+                                  &ble_store_config_cccds[i].peer_addr,
+                                  ble_store_config_cccds[i].chr_val_handle);
+        base64_encode(ble_store_config_cccds + i,
+                      sizeof *ble_store_config_cccds, buf.cccd, 1);
+        func(name, buf.cccd);
+    }
+
+    return 0;
+}
+#else
 static int
 ble_store_config_conf_export(void (*func)(char *name, char *val),
                              enum conf_export_tgt tgt)
@@ -150,6 +521,26 @@ ble_store_config_conf_export(void (*func)(char *name, char *val),
 
     return 0;
 }
+#endif
+
+static int
+ble_store_config_save(const char *name, const char *val)
+{
+    int rc;
+
+    rc = conf_save_one(name, (char *)val);
+    if (rc != 0) {
+        return BLE_HS_ESTORE_FAIL;
+    }
+
+    ble_store_config_stats.saves++;
+    ble_store_config_stats.bytes += strlen(name);
+    if (val != NULL) {
+        ble_store_config_stats.bytes += strlen(val);
+    }
+
+    return 0;
+}
 
 static int
 ble_store_config_persist_sec_set(const char *setting_name,
@@ -161,9 +552,9 @@ ble_store_config_persist_sec_set(const char *setting_name,
 
     ble_store_config_serialize_arr(secs, sizeof *secs, num_secs,
                                    buf, sizeof buf);
-    rc = conf_save_one(setting_name, buf);
+    rc = ble_store_config_save(setting_name, buf);
     if (rc != 0) {
-        return BLE_HS_ESTORE_FAIL;
+        return rc;
     }
 
     return 0;
@@ -210,19 +601,324 @@ ble_store_config_persist_cccds(void)
                                    ble_store_config_num_cccds,
                                    buf,
                                    sizeof buf);
-    rc = conf_save_one("ble_hs/cccd", buf);
+    rc = ble_store_config_save("ble_hs/cccd", buf);
     if (rc != 0) {
-        return BLE_HS_ESTORE_FAIL;
+        return rc;
     }
 
     return 0;
 }
 
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+/** Writes the current state of one record, or deletes it if it is gone. */
+static int
+ble_store_config_persist_rec(const struct ble_store_config_pending *pend)
+{
+    char name[BLE_STORE_CONFIG_REC_NAME_SZ];
+    union {
+        char sec[BLE_STORE_CONFIG_SEC_ENCODE_SZ + 1];
+        char cccd[BLE_STORE_CONFIG_CCCD_ENCODE_SZ + 1];
+    } buf;
+    const void *rec;
+    int rec_sz;
+    int idx;
+
+    switch (pend->obj_type) {
+    case BLE_STORE_OBJ_TYPE_OUR_SEC:
+        ble_store_config_rec_name(name, "os", &pend->peer_addr, 0);
+        idx = ble_store_config_find_sec_rec(ble_store_config_our_secs,
+                                            ble_store_config_num_our_secs,
+                                            &pend->peer_addr);
+        rec = ble_store_config_our_secs + idx;
+        rec_sz = sizeof *ble_store_config_our_secs;
+        break;
+
+    case BLE_STORE_OBJ_TYPE_PEER_SEC:
+        ble_store_config_rec_name(name, "ps", &pend->peer_addr, 0);
+        idx = ble_store_config_find_sec_rec(ble_store_config_peer_secs,
+                                            ble_store_config_num_peer_secs,
+                                            &pend->peer_addr);
+        rec = ble_store_config_peer_secs + idx;
+        rec_sz = sizeof *ble_store_config_peer_secs;
+        break;
+
+    case BLE_STORE_OBJ_TYPE_CCCD:
+        ble_store_config_rec_name(name, "cd", &pend->peer_addr,
+                                  pend->chr_val_handle);
+        idx = ble_store_config_find_cccd_rec(&pend->peer_addr,
+                                             pend->chr_val_handle);
+        rec = ble_store_config_cccds + idx;
+        rec_sz = sizeof *ble_store_config_cccds;
+        break;
+
+    default:
+        return BLE_HS_EINVAL;
+    }
+
+    if (idx == -1) {
+        return ble_store_config_save(name, NULL);
+    }
+
+    base64_encode(rec, rec_sz, buf.sec, 1);
+    return ble_store_config_save(name, buf.sec);
+}
+
+static int
+ble_store_config_pending_add(int obj_type, const ble_addr_t *peer_addr,
+                             uint16_t chr_val_handle)
+{
+    struct ble_store_config_pending *pend;
+    int i;
+
+    for (i = 0; i < ble_store_config_num_pending; i++) {
+        pend = ble_store_config_pending + i;
+        if (pend->obj_type == obj_type &&
+            pend->chr_val_handle == chr_val_handle &&
+            ble_addr_cmp(&pend->peer_addr, peer_addr) == 0) {
+
+            ble_store_config_stats.coalesced++;
+            return 0;
+        }
+    }
+
+    if (ble_store_config_num_pending >=
+        MYNEWT_VAL(BLE_STORE_CONFIG_PENDING_MAX)) {
+
+        return BLE_HS_ENOMEM;
+    }
+
+    pend = ble_store_config_pending + ble_store_config_num_pending++;
+    pend->obj_type = obj_type;
+    pend->chr_val_handle = chr_val_handle;
+    pend->peer_addr = *peer_addr;
+
+    return 0;
+}
+#endif
+
+int
+ble_store_config_persist_flush(void)
+{
+    int rc;
+    int rc2;
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_FLUSH_MS) > 0
+    ble_npl_callout_stop(&ble_store_config_flush_timer);
+#endif
+
+    rc = 0;
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+    int i;
+
+    for (i = 0; i < ble_store_config_num_pending; i++) {
+        rc2 = ble_store_config_persist_rec(ble_store_config_pending + i);
+        if (rc == 0) {
+            rc = rc2;
+        }
+    }
+    ble_store_config_num_pending = 0;
+#else
+    if (ble_store_config_dirty &
+        BLE_STORE_CONFIG_OBJ_BIT(BLE_STORE_OBJ_TYPE_OUR_SEC)) {
+
+        rc2 = ble_store_config_persist_our_secs();
+        if (rc == 0) {
+            rc = rc2;
+        }
+    }
+    if (ble_store_config_dirty &
+        BLE_STORE_CONFIG_OBJ_BIT(BLE_STORE_OBJ_TYPE_PEER_SEC)) {
+
+        rc2 = ble_store_config_persist_peer_secs();
+        if (rc == 0) {
+            rc = rc2;
+        }
+    }
+    if (ble_store_config_dirty &
+        BLE_STORE_CONFIG_OBJ_BIT(BLE_STORE_OBJ_TYPE_CCCD)) {
+
+        rc2 = ble_store_config_persist_cccds();
+        if (rc == 0) {
+            rc = rc2;
+        }
+    }
+    ble_store_config_dirty = 0;
+#endif
+
+    ble_store_config_stats.flushes++;
+
+    return rc;
+}
+
+int
+ble_store_config_persist(int obj_type, const ble_addr_t *peer_addr,
+                         uint16_t chr_val_handle)
+{
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+    int rc;
+
+    if (ble_store_config_num_pending >=
+        MYNEWT_VAL(BLE_STORE_CONFIG_PENDING_MAX)) {
+
+        rc = ble_store_config_persist_flush();
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    rc = ble_store_config_pending_add(obj_type, peer_addr, chr_val_handle);
+    if (rc != 0) {
+        return rc;
+    }
+#else
+    if (ble_store_config_dirty & BLE_STORE_CONFIG_OBJ_BIT(obj_type)) {
+        ble_store_config_stats.coalesced++;
+    }
+    ble_store_config_dirty |= BLE_STORE_CONFIG_OBJ_BIT(obj_type);
+#endif
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_FLUSH_MS) > 0
+    /* Losing a CCCD change costs at most a missed notification; security
+     * material is never left waiting.
+     */
+    if (obj_type == BLE_STORE_OBJ_TYPE_CCCD) {
+        if (!ble_npl_callout_is_active(&ble_store_config_flush_timer)) {
+            ble_npl_callout_reset(&ble_store_config_flush_timer,
+                ble_npl_time_ms_to_ticks32(
+                    MYNEWT_VAL(BLE_STORE_CONFIG_FLUSH_MS)));
+        }
+        return 0;
+    }
+#endif
+
+    return ble_store_config_persist_flush();
+}
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_FLUSH_MS) > 0
+static void
+ble_store_config_flush_timer_exp(struct ble_npl_event *ev)
+{
+    ble_store_config_persist_flush();
+}
+#endif
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+/**
+ * Adds the entries of an old whole-array setting that no record provides
+ * and queues them to be written as records.
+ */
+static void
+ble_store_config_merge_legacy_secs(int obj_type,
+                                   struct ble_store_value_sec *secs,
+                                   int *num_secs)
+{
+    struct ble_store_config_legacy *legacy;
+    const struct ble_store_value_sec *sec;
+    int i;
+
+    legacy = &ble_store_config_legacy[obj_type - 1];
+
+    for (i = 0; i < legacy->num_objs; i++) {
+        sec = (const struct ble_store_value_sec *)legacy->objs + i;
+        if (ble_store_config_find_sec_rec(secs, *num_secs,
+                                          &sec->peer_addr) != -1 ||
+            *num_secs >= MYNEWT_VAL(BLE_STORE_MAX_BONDS)) {
+            continue;
+        }
+
+        secs[(*num_secs)++] = *sec;
+        ble_store_config_persist(obj_type, &sec->peer_addr, 0);
+    }
+}
+
+static void
+ble_store_config_merge_legacy_cccds(void)
+{
+    struct ble_store_config_legacy *legacy;
+    const struct ble_store_value_cccd *cccd;
+    int i;
+
+    legacy = &ble_store_config_legacy[BLE_STORE_OBJ_TYPE_CCCD - 1];
+
+    for (i = 0; i < legacy->num_objs; i++) {
+        cccd = (const struct ble_store_value_cccd *)legacy->objs + i;
+        if (ble_store_config_find_cccd_rec(&cccd->peer_addr,
+                                           cccd->chr_val_handle) != -1 ||
+            ble_store_config_num_cccds >= MYNEWT_VAL(BLE_STORE_MAX_CCCDS)) {
+            continue;
+        }
+
+        ble_store_config_cccds[ble_store_config_num_cccds++] = *cccd;
+        ble_store_config_persist(BLE_STORE_OBJ_TYPE_CCCD, &cccd->peer_addr,
+                                 cccd->chr_val_handle);
+    }
+}
+#endif
+
+/**
+ * Called once all settings are loaded.  Settings written by the whole-array
+ * format are converted to records and then removed.
+ */
+static int
+ble_store_config_conf_commit(void)
+{
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+    int i;
+
+    if (ble_store_config_legacy[0].objs == NULL &&
+        ble_store_config_legacy[1].objs == NULL &&
+        ble_store_config_legacy[2].objs == NULL) {
+        return 0;
+    }
+
+    ble_store_config_merge_legacy_secs(BLE_STORE_OBJ_TYPE_OUR_SEC,
+                                       ble_store_config_our_secs,
+                                       &ble_store_config_num_our_secs);
+    ble_store_config_merge_legacy_secs(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                       ble_store_config_peer_secs,
+                                       &ble_store_config_num_peer_secs);
+    ble_store_config_merge_legacy_cccds();
+    ble_store_config_persist_flush();
+
+    ble_store_config_save("ble_hs/our_sec", NULL);
+    ble_store_config_save("ble_hs/peer_sec", NULL);
+    ble_store_config_save("ble_hs/cccd", NULL);
+
+    for (i = 0; i < 3; i++) {
+        free(ble_store_config_legacy[i].objs);
+        ble_store_config_legacy[i].objs = NULL;
+        ble_store_config_legacy[i].num_objs = 0;
+    }
+#endif
+
+    return 0;
+}
+
 void
 ble_store_config_conf_init(void)
 {
     int rc;
 
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+    int i;
+
+    ble_store_config_num_pending = 0;
+    for (i = 0; i < 3; i++) {
+        free(ble_store_config_legacy[i].objs);
+        ble_store_config_legacy[i].objs = NULL;
+        ble_store_config_legacy[i].num_objs = 0;
+    }
+#else
+    ble_store_config_dirty = 0;
+#endif
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_FLUSH_MS) > 0
+    ble_npl_callout_init(&ble_store_config_flush_timer,
+                         (struct ble_npl_eventq *)os_eventq_dflt_get(),
+                         ble_store_config_flush_timer_exp, NULL);
+#endif
+
     rc = conf_register(&ble_store_config_conf_handler);
     SYSINIT_PANIC_ASSERT_MSG(rc == 0,
                              "Failed to register ble_store_config conf");
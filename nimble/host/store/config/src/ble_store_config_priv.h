@@ -36,11 +36,16 @@ extern struct ble_store_value_cccd
     ble_store_config_cccds[MYNEWT_VAL(BLE_STORE_MAX_CCCDS)];
 extern int ble_store_config_num_cccds;
 
+extern struct ble_store_config_persist_stats ble_store_config_stats;
+
 #if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST)
 
 int ble_store_config_persist_our_secs(void);
 int ble_store_config_persist_peer_secs(void);
 int ble_store_config_persist_cccds(void);
+int ble_store_config_persist(int obj_type, const ble_addr_t *peer_addr,
+                             uint16_t chr_val_handle);
+int ble_store_config_persist_flush(void);
 void ble_store_config_conf_init(void);
 
 #else
@@ -48,8 +53,16 @@ void ble_store_config_conf_init(void);
 static inline int ble_store_config_persist_our_secs(void)   { return 0; }
 static inline int ble_store_config_persist_peer_secs(void)  { return 0; }
 static inline int ble_store_config_persist_cccds(void)      { return 0; }
+static inline int ble_store_config_persist_flush(void)      { return 0; }
 static inline void ble_store_config_conf_init(void)         { }
 
+static inline int
+ble_store_config_persist(int obj_type, const ble_addr_t *peer_addr,
+                         uint16_t chr_val_handle)
+{
+    return 0;
+}
+
 #endif /* MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST) */
 
 #ifdef __cplusplus
@@ -2119,6 +2119,183 @@ TEST_CASE_SELF(ble_att_svr_test_unsupported_req)
     ble_att_svr_test_assert_mbufs_freed();
 }
 
+#define BLE_ATT_SVR_TEST_INDEX_CHRS     100
+/* One service per 10 characteristics, each characteristic has a declaration,
+ * a value and a descriptor.
+ */
+#define BLE_ATT_SVR_TEST_INDEX_GRP_ATTRS    (1 + 10 * 3)
+
+static int
+ble_att_svr_test_misc_count_uuid(const ble_uuid_t *uuid, uint16_t end_handle)
+{
+    struct ble_att_svr_entry *entry;
+    uint16_t prev_handle;
+    int count;
+
+    count = 0;
+    prev_handle = 0;
+    entry = NULL;
+    while ((entry = ble_att_svr_find_by_uuid(entry, uuid,
+                                             end_handle)) != NULL) {
+        TEST_ASSERT(ble_uuid_cmp(entry->ha_uuid, uuid) == 0);
+        TEST_ASSERT(entry->ha_handle_id > prev_handle);
+        prev_handle = entry->ha_handle_id;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * Checks handle and type lookups against a 300+ attribute database, with and
+ * without a hidden service.
+ */
+TEST_CASE_SELF(ble_att_svr_test_index)
+{
+    static const ble_uuid16_t svc_uuid = BLE_UUID16_INIT(0x2800);
+    static const ble_uuid16_t chr_uuid = BLE_UUID16_INIT(0x2803);
+    static const ble_uuid16_t dsc_uuid = BLE_UUID16_INIT(0x2902);
+    static ble_uuid16_t val_uuids[BLE_ATT_SVR_TEST_INDEX_CHRS];
+    struct ble_att_svr_entry *entry;
+    uint8_t value[] = { 1, 2, 3, 4 };
+    uint16_t val_handles[BLE_ATT_SVR_TEST_INDEX_CHRS];
+    uint16_t saved_max_attrs;
+    uint16_t hidden_start;
+    uint16_t hidden_end;
+    uint16_t conn_handle;
+    uint16_t handle;
+    int num_attrs;
+    int rc;
+    int i;
+
+    conn_handle = ble_att_svr_test_misc_init(0);
+
+    /* Rebuild the attribute table with room for the test database. */
+    ble_att_svr_reset();
+    saved_max_attrs = ble_hs_max_attrs;
+    num_attrs = BLE_ATT_SVR_TEST_INDEX_CHRS * 3 +
+                BLE_ATT_SVR_TEST_INDEX_CHRS / 10;
+    ble_hs_max_attrs = num_attrs;
+    rc = ble_att_svr_start();
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_att_svr_test_attr_r_1 = value;
+    ble_att_svr_test_attr_r_1_len = sizeof value;
+
+    for (i = 0; i < BLE_ATT_SVR_TEST_INDEX_CHRS; i++) {
+        if (i % 10 == 0) {
+            rc = ble_att_svr_register(&svc_uuid.u, BLE_ATT_F_READ, 0, NULL,
+                                      ble_att_svr_test_misc_attr_fn_r_1, NULL);
+            TEST_ASSERT_FATAL(rc == 0);
+        }
+
+        rc = ble_att_svr_register(&chr_uuid.u, BLE_ATT_F_READ, 0, NULL,
+                                  ble_att_svr_test_misc_attr_fn_r_1, NULL);
+        TEST_ASSERT_FATAL(rc == 0);
+
+        val_uuids[i] = (ble_uuid16_t) BLE_UUID16_INIT(0x3000 + i);
+        rc = ble_att_svr_register(&val_uuids[i].u, BLE_ATT_F_READ, 0,
+                                  &val_handles[i],
+                                  ble_att_svr_test_misc_attr_fn_r_1, NULL);
+        TEST_ASSERT_FATAL(rc == 0);
+
+        rc = ble_att_svr_register(&dsc_uuid.u, BLE_ATT_F_READ, 0, NULL,
+                                  ble_att_svr_test_misc_attr_fn_r_1, NULL);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    TEST_ASSERT_FATAL(ble_att_svr_prev_handle() == num_attrs);
+
+    /*** Every handle maps to its own entry. */
+    TEST_ASSERT(ble_att_svr_find_by_handle(0) == NULL);
+    for (handle = 1; handle <= num_attrs; handle++) {
+        entry = ble_att_svr_find_by_handle(handle);
+        TEST_ASSERT_FATAL(entry != NULL);
+        TEST_ASSERT(entry->ha_handle_id == handle);
+    }
+    TEST_ASSERT(ble_att_svr_find_by_handle(num_attrs + 1) == NULL);
+    TEST_ASSERT(ble_att_svr_find_by_handle(0xffff) == NULL);
+
+    /*** Type lookups only return attributes of that type, in handle order. */
+    TEST_ASSERT(ble_att_svr_test_misc_count_uuid(&svc_uuid.u, 0xffff) ==
+                BLE_ATT_SVR_TEST_INDEX_CHRS / 10);
+    TEST_ASSERT(ble_att_svr_test_misc_count_uuid(&chr_uuid.u, 0xffff) ==
+                BLE_ATT_SVR_TEST_INDEX_CHRS);
+    TEST_ASSERT(ble_att_svr_test_misc_count_uuid(&dsc_uuid.u, 0xffff) ==
+                BLE_ATT_SVR_TEST_INDEX_CHRS);
+    TEST_ASSERT(ble_att_svr_test_misc_count_uuid(&dsc_uuid.u,
+                                                 val_handles[9]) == 9);
+    for (i = 0; i < BLE_ATT_SVR_TEST_INDEX_CHRS; i++) {
+        entry = ble_att_svr_find_by_uuid(NULL, &val_uuids[i].u, 0xffff);
+        TEST_ASSERT_FATAL(entry != NULL);
+        TEST_ASSERT(entry->ha_handle_id == val_handles[i]);
+        TEST_ASSERT(ble_att_svr_find_by_uuid(entry, &val_uuids[i].u,
+                                             0xffff) == NULL);
+    }
+
+    /* Starting past the only attribute of a type finds nothing. */
+    entry = ble_att_svr_find_by_handle(val_handles[0] + 1);
+    TEST_ASSERT(ble_att_svr_find_by_uuid(entry, &val_uuids[0].u,
+                                         0xffff) == NULL);
+
+    /*** Hidden services are dropped from both lookups. */
+    hidden_start = BLE_ATT_SVR_TEST_INDEX_GRP_ATTRS + 1;
+    hidden_end = 2 * BLE_ATT_SVR_TEST_INDEX_GRP_ATTRS;
+    ble_att_svr_hide_range(hidden_start, hidden_end);
+
+    for (handle = 1; handle <= num_attrs; handle++) {
+        entry = ble_att_svr_find_by_handle(handle);
+        if (handle >= hidden_start && handle <= hidden_end) {
+            TEST_ASSERT(entry == NULL);
+        } else {
+            TEST_ASSERT_FATAL(entry != NULL);
+            TEST_ASSERT(entry->ha_handle_id == handle);
+        }
+    }
+    TEST_ASSERT(ble_att_svr_test_misc_count_uuid(&dsc_uuid.u, 0xffff) ==
+                BLE_ATT_SVR_TEST_INDEX_CHRS - 10);
+    TEST_ASSERT(ble_att_svr_find_by_uuid(NULL, &val_uuids[10].u,
+                                         0xffff) == NULL);
+
+    rc = ble_hs_test_util_rx_att_read_req(conn_handle, val_handles[10]);
+    TEST_ASSERT(rc != 0);
+    ble_hs_test_util_verify_tx_err_rsp(BLE_ATT_OP_READ_REQ, val_handles[10],
+                                       BLE_ATT_ERR_INVALID_HANDLE);
+
+    ble_att_svr_restore_range(hidden_start, hidden_end);
+
+    TEST_ASSERT(ble_att_svr_test_misc_count_uuid(&dsc_uuid.u, 0xffff) ==
+                BLE_ATT_SVR_TEST_INDEX_CHRS);
+    entry = ble_att_svr_find_by_uuid(NULL, &val_uuids[10].u, 0xffff);
+    TEST_ASSERT_FATAL(entry != NULL);
+    TEST_ASSERT(entry->ha_handle_id == val_handles[10]);
+
+    /*** Requests are served from the index. */
+    rc = ble_hs_test_util_rx_att_read_req(
+        conn_handle, val_handles[BLE_ATT_SVR_TEST_INDEX_CHRS - 1]);
+    TEST_ASSERT(rc == 0);
+    ble_hs_test_util_verify_tx_read_rsp(value, sizeof value);
+
+    rc = ble_hs_test_util_rx_att_read_type_req(
+        conn_handle, 1, 0xffff,
+        &val_uuids[BLE_ATT_SVR_TEST_INDEX_CHRS - 1].u);
+    TEST_ASSERT(rc == 0);
+    ble_att_svr_test_misc_verify_tx_read_type_rsp(
+        ((struct ble_att_svr_test_type_entry[]) { {
+            .handle = val_handles[BLE_ATT_SVR_TEST_INDEX_CHRS - 1],
+            .value = value,
+            .value_len = sizeof value,
+        }, {
+            .handle = 0,
+        } }));
+
+    ble_att_svr_reset();
+    ble_hs_max_attrs = saved_max_attrs;
+    rc = ble_att_svr_start();
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
 TEST_SUITE(ble_att_svr_suite)
 {
     ble_att_svr_test_mtu();
@@ -2136,4 +2313,5 @@ TEST_SUITE(ble_att_svr_suite)
     ble_att_svr_test_indicate();
     ble_att_svr_test_oom();
     ble_att_svr_test_unsupported_req();
+    ble_att_svr_test_index();
 }
@@ -847,6 +847,958 @@ TEST_SUITE(ble_gap_test_suite_disc)
     ble_gap_test_case_disc_busy();
 }
 
+/*****************************************************************************
+ * $advertisement monitor                                                    *
+ *****************************************************************************/
+
+#define BLE_GAP_TEST_ADV_MON_MAX_EVENTS     8
+#define BLE_GAP_TEST_ADV_MON_MAX_DATA       MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE)
+
+static struct ble_gap_adv_mon_desc
+    ble_gap_test_adv_mon_descs[BLE_GAP_TEST_ADV_MON_MAX_EVENTS];
+static uint8_t ble_gap_test_adv_mon_data[BLE_GAP_TEST_ADV_MON_MAX_EVENTS]
+                                        [BLE_GAP_TEST_ADV_MON_MAX_DATA];
+static int ble_gap_test_adv_mon_num_events;
+
+static int
+ble_gap_test_util_adv_mon_cb(struct ble_gap_event *event, void *arg)
+{
+    int idx;
+
+    TEST_ASSERT_FATAL(event->type == BLE_GAP_EVENT_ADV_MON);
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events <
+                      BLE_GAP_TEST_ADV_MON_MAX_EVENTS);
+    TEST_ASSERT_FATAL(event->adv_mon.length_data <=
+                      BLE_GAP_TEST_ADV_MON_MAX_DATA);
+
+    idx = ble_gap_test_adv_mon_num_events++;
+    ble_gap_test_adv_mon_descs[idx] = event->adv_mon;
+    memcpy(ble_gap_test_adv_mon_data[idx], event->adv_mon.data,
+           event->adv_mon.length_data);
+    ble_gap_test_adv_mon_descs[idx].data = ble_gap_test_adv_mon_data[idx];
+
+    return 0;
+}
+
+static void
+ble_gap_test_util_adv_mon_rx(const ble_addr_t *addr, int8_t rssi,
+                             const uint8_t *data, uint8_t len)
+{
+    struct ble_gap_disc_desc desc = {
+        .event_type = BLE_HCI_ADV_RPT_EVTYPE_NONCONN_IND,
+        .addr = *addr,
+        .length_data = len,
+        .rssi = rssi,
+        .data = data,
+    };
+
+    ble_gap_test_adv_mon_num_events = 0;
+    ble_gap_test_util_reset_cb_info();
+    ble_gap_rx_adv_report(&desc);
+}
+
+static void
+ble_gap_test_util_adv_mon_start(void)
+{
+    struct ble_gap_disc_params disc_params = {
+        .passive = 1,
+    };
+    int rc;
+
+    ble_gap_test_util_init();
+
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_cb, NULL,
+                               -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+TEST_CASE_SELF(ble_gap_test_case_adv_mon_bad_args)
+{
+    struct ble_gap_adv_mon_filter filter;
+    uint32_t hits;
+    uint8_t id;
+    int rc;
+    int i;
+
+    ble_gap_test_util_init();
+
+    memset(&filter, 0, sizeof(filter));
+
+    /*** No callback. */
+    rc = ble_gap_adv_mon_add(&filter, NULL, NULL, &id);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /*** Unknown criteria. */
+    filter.criteria = 0x80;
+    rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                             &id);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /*** Manufacturer data prefix too long. */
+    filter.criteria = BLE_GAP_ADV_MON_F_MFG;
+    filter.mfg_prefix_len = BLE_GAP_ADV_MON_MFG_PREFIX_MAX + 1;
+    rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                             &id);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /*** Table full. */
+    memset(&filter, 0, sizeof(filter));
+    for (i = 0; i < MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS); i++) {
+        rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                                 &id);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(id == i);
+    }
+    rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                             &id);
+    TEST_ASSERT(rc == BLE_HS_ENOMEM);
+
+    /*** Unknown filter. */
+    rc = ble_gap_adv_mon_remove(MYNEWT_VAL(BLE_GAP_ADV_MON_FILTERS));
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+    rc = ble_gap_adv_mon_remove(0);
+    TEST_ASSERT(rc == 0);
+    rc = ble_gap_adv_mon_remove(0);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+    rc = ble_gap_adv_mon_hits(0, &hits);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+}
+
+TEST_CASE_SELF(ble_gap_test_case_adv_mon_match)
+{
+    static const ble_addr_t addr1 = { BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    static const ble_addr_t addr2 = { BLE_ADDR_RANDOM, { 6, 5, 4, 3, 2, 0xc1 } };
+    static const uint8_t mfg_data[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, BLE_HS_ADV_F_BREDR_UNSUP,
+        0x06, BLE_HS_ADV_TYPE_MFG_DATA, 0x59, 0x00, 0xaa, 0xbb, 0xcc,
+    };
+    static const uint8_t uuid_data[] = {
+        0x05, BLE_HS_ADV_TYPE_COMP_UUIDS16, 0x0d, 0x18, 0x0f, 0x18,
+        0x04, BLE_HS_ADV_TYPE_SVC_DATA_UUID16, 0x1a, 0x18, 0x01,
+    };
+    struct ble_gap_adv_mon_filter filter;
+    struct ble_gap_adv_mon_stats stats;
+    uint8_t mfg_id;
+    uint8_t uuid_id;
+    uint8_t svc_data_id;
+    uint8_t addr_id;
+    uint32_t hits;
+    int rc;
+
+    ble_gap_test_util_adv_mon_start();
+
+    /*** Manufacturer ID and data prefix. */
+    memset(&filter, 0, sizeof(filter));
+    filter.criteria = BLE_GAP_ADV_MON_F_MFG | BLE_GAP_ADV_MON_F_RSSI;
+    filter.company_id = 0x0059;
+    filter.mfg_prefix[0] = 0xaa;
+    filter.mfg_prefix[1] = 0xbb;
+    filter.mfg_prefix_len = 2;
+    filter.rssi_min = -70;
+    rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                             &mfg_id);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Service UUID, listed. */
+    memset(&filter, 0, sizeof(filter));
+    filter.criteria = BLE_GAP_ADV_MON_F_UUID;
+    filter.uuid.u16.u.type = BLE_UUID_TYPE_16;
+    filter.uuid.u16.value = 0x180f;
+    rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                             &uuid_id);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Service UUID, with service data. */
+    filter.uuid.u16.value = 0x181a;
+    rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                             &svc_data_id);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Address and AD type. */
+    memset(&filter, 0, sizeof(filter));
+    filter.criteria = BLE_GAP_ADV_MON_F_ADDR | BLE_GAP_ADV_MON_F_AD_TYPE;
+    filter.addr = addr2;
+    filter.ad_type = BLE_HS_ADV_TYPE_FLAGS;
+    rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                             &addr_id);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* Manufacturer data matches; not reported as a discovery event. */
+    ble_gap_test_util_adv_mon_rx(&addr1, -50, mfg_data, sizeof(mfg_data));
+    TEST_ASSERT(ble_gap_test_disc_event_type == -1);
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 1);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].filter_id == mfg_id);
+    TEST_ASSERT(ble_addr_cmp(&ble_gap_test_adv_mon_descs[0].addr,
+                             &addr1) == 0);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].props ==
+                BLE_HCI_ADV_LEGACY_MASK);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].legacy_event_type ==
+                BLE_HCI_ADV_RPT_EVTYPE_NONCONN_IND);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].rssi == -50);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].length_data ==
+                sizeof(mfg_data));
+    TEST_ASSERT(memcmp(ble_gap_test_adv_mon_data[0], mfg_data,
+                       sizeof(mfg_data)) == 0);
+
+    /* Too weak for the RSSI threshold. */
+    ble_gap_test_util_adv_mon_rx(&addr1, -80, mfg_data, sizeof(mfg_data));
+    TEST_ASSERT(ble_gap_test_adv_mon_num_events == 0);
+
+    /* Same data from the monitored address matches two filters. */
+    ble_gap_test_util_adv_mon_rx(&addr2, -50, mfg_data, sizeof(mfg_data));
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 2);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].filter_id == mfg_id);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[1].filter_id == addr_id);
+
+    /* Both UUID filters match; the address filter lacks the flags. */
+    ble_gap_test_util_adv_mon_rx(&addr2, -50, uuid_data, sizeof(uuid_data));
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 2);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].filter_id == uuid_id);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[1].filter_id == svc_data_id);
+
+    /* Service data alone only matches its own UUID filter. */
+    ble_gap_test_util_adv_mon_rx(&addr1, -50, uuid_data + 6,
+                                 sizeof(uuid_data) - 6);
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 1);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].filter_id == svc_data_id);
+
+    /* Malformed data stops the walk. */
+    ble_gap_test_util_adv_mon_rx(&addr1, -50, mfg_data, sizeof(mfg_data) - 1);
+    TEST_ASSERT(ble_gap_test_adv_mon_num_events == 0);
+
+    rc = ble_gap_adv_mon_hits(mfg_id, &hits);
+    TEST_ASSERT(rc == 0 && hits == 2);
+    rc = ble_gap_adv_mon_hits(uuid_id, &hits);
+    TEST_ASSERT(rc == 0 && hits == 1);
+    rc = ble_gap_adv_mon_hits(svc_data_id, &hits);
+    TEST_ASSERT(rc == 0 && hits == 2);
+    rc = ble_gap_adv_mon_hits(addr_id, &hits);
+    TEST_ASSERT(rc == 0 && hits == 1);
+
+    rc = ble_gap_adv_mon_stats(&stats, 1);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(stats.rx_reports == 6);
+    TEST_ASSERT(stats.evaluated == 6);
+    TEST_ASSERT(stats.matched == 4);
+    rc = ble_gap_adv_mon_stats(&stats, 0);
+    TEST_ASSERT(rc == 0 && stats.rx_reports == 0);
+
+    /* With all filters removed, reports are discovery events again. */
+    TEST_ASSERT(ble_gap_adv_mon_remove(mfg_id) == 0);
+    TEST_ASSERT(ble_gap_adv_mon_remove(uuid_id) == 0);
+    TEST_ASSERT(ble_gap_adv_mon_remove(svc_data_id) == 0);
+    TEST_ASSERT(ble_gap_adv_mon_remove(addr_id) == 0);
+
+    ble_gap_test_util_adv_mon_rx(&addr1, -50, mfg_data, sizeof(mfg_data));
+    TEST_ASSERT(ble_gap_test_adv_mon_num_events == 0);
+    TEST_ASSERT(ble_gap_test_disc_event_type == BLE_GAP_EVENT_DISC);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_SUITE(ble_gap_test_suite_adv_mon)
+{
+    ble_gap_test_case_adv_mon_bad_args();
+    ble_gap_test_case_adv_mon_match();
+}
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+static void
+ble_gap_test_util_adv_mon_ext_rx(const ble_addr_t *addr, uint8_t sid,
+                                 uint8_t data_status, const uint8_t *data,
+                                 uint8_t len)
+{
+    struct ble_gap_ext_disc_desc desc = {
+        .props = 0,
+        .data_status = data_status,
+        .addr = *addr,
+        .rssi = -50,
+        .tx_power = 127,
+        .sid = sid,
+        .prim_phy = BLE_HCI_LE_PHY_1M,
+        .sec_phy = BLE_HCI_LE_PHY_2M,
+        .length_data = len,
+        .data = data,
+    };
+
+    ble_gap_test_adv_mon_num_events = 0;
+    ble_gap_test_util_reset_cb_info();
+    ble_gap_rx_ext_adv_report(&desc);
+}
+
+TEST_CASE_SELF(ble_gap_test_case_adv_mon_ext_reasm)
+{
+    static const ble_addr_t addr1 = { BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    static const ble_addr_t addr2 = { BLE_ADDR_RANDOM, { 6, 5, 4, 3, 2, 0xc1 } };
+    /* Split in two fragments; the filter only matches the second one */
+    static const uint8_t frag1[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, BLE_HS_ADV_F_BREDR_UNSUP,
+        0x11, BLE_HS_ADV_TYPE_COMP_NAME,
+        'n', 'i', 'm', 'b', 'l', 'e', '-', 'e',
+        'x', 't', '-', 'r', 'e', 'a', 's', 'm',
+    };
+    static const uint8_t frag2[] = {
+        0x06, BLE_HS_ADV_TYPE_MFG_DATA, 0x59, 0x00, 0xaa, 0xbb, 0xcc,
+    };
+    struct ble_gap_adv_mon_filter filter;
+    struct ble_gap_adv_mon_stats stats;
+    const struct ble_gap_adv_mon_desc *desc;
+    uint8_t flags_id;
+    uint8_t mfg_id;
+    int rc;
+
+    ble_gap_test_util_adv_mon_start();
+
+    memset(&filter, 0, sizeof(filter));
+    filter.criteria = BLE_GAP_ADV_MON_F_MFG;
+    filter.company_id = 0x0059;
+    filter.mfg_prefix[0] = 0xaa;
+    filter.mfg_prefix_len = 1;
+    rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                             &mfg_id);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Fragments are reassembled; other advertisers are interleaved. */
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    TEST_ASSERT(ble_gap_test_adv_mon_num_events == 0);
+
+    ble_gap_test_util_adv_mon_ext_rx(&addr2, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 1);
+    TEST_ASSERT(ble_addr_cmp(&ble_gap_test_adv_mon_descs[0].addr,
+                             &addr2) == 0);
+
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 1);
+    desc = &ble_gap_test_adv_mon_descs[0];
+    TEST_ASSERT(desc->filter_id == mfg_id);
+    TEST_ASSERT(ble_addr_cmp(&desc->addr, &addr1) == 0);
+    TEST_ASSERT(desc->sid == 1);
+    TEST_ASSERT(desc->rssi == -50);
+    TEST_ASSERT(desc->sec_phy == BLE_HCI_LE_PHY_2M);
+    TEST_ASSERT(!desc->truncated);
+    TEST_ASSERT_FATAL(desc->length_data == sizeof(frag1) + sizeof(frag2));
+    TEST_ASSERT(memcmp(desc->data, frag1, sizeof(frag1)) == 0);
+    TEST_ASSERT(memcmp(desc->data + sizeof(frag1), frag2,
+                       sizeof(frag2)) == 0);
+
+    /*** A third advertiser evicts the oldest reassembly. */
+    TEST_ASSERT(MYNEWT_VAL(BLE_GAP_ADV_MON_REASM_SLOTS) == 2);
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 2,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr2, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    TEST_ASSERT(ble_gap_test_adv_mon_num_events == 0);
+
+    rc = ble_gap_adv_mon_stats(&stats, 0);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(stats.evicted == 1);
+
+    /* The rest of the evicted report is not taken for a report of its own */
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT(ble_gap_test_adv_mon_num_events == 0);
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT(ble_gap_test_adv_mon_num_events == 0);
+
+    /* The others complete as usual */
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 2,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 1);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].sid == 2);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].length_data ==
+                sizeof(frag1) + sizeof(frag2));
+
+    ble_gap_test_util_adv_mon_ext_rx(&addr2, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 1);
+    TEST_ASSERT(ble_addr_cmp(&ble_gap_test_adv_mon_descs[0].addr,
+                             &addr2) == 0);
+
+    /* The next report from the evicted advertiser is reassembled again */
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 1);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].sid == 1);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].length_data ==
+                sizeof(frag1) + sizeof(frag2));
+
+    /*** Data beyond BLE_EXT_ADV_MAX_SIZE is cut off. */
+    TEST_ASSERT_FATAL(3 * sizeof(frag1) + sizeof(frag2) >
+                      MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE));
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT(ble_gap_test_adv_mon_num_events == 0);
+
+    /* Evaluated all the same; a filter on the first AD structure matches */
+    memset(&filter, 0, sizeof(filter));
+    filter.criteria = BLE_GAP_ADV_MON_F_AD_TYPE;
+    filter.ad_type = BLE_HS_ADV_TYPE_FLAGS;
+    rc = ble_gap_adv_mon_add(&filter, ble_gap_test_util_adv_mon_cb, NULL,
+                             &flags_id);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr1, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 1);
+    desc = &ble_gap_test_adv_mon_descs[0];
+    TEST_ASSERT(desc->filter_id == flags_id);
+    TEST_ASSERT(desc->truncated);
+    TEST_ASSERT(desc->length_data == MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE));
+    TEST_ASSERT(memcmp(desc->data, frag1, sizeof(frag1)) == 0);
+
+    /* Truncated by the controller */
+    ble_gap_test_util_adv_mon_ext_rx(&addr2, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                     frag1, sizeof(frag1));
+    ble_gap_test_util_adv_mon_ext_rx(&addr2, 1,
+                                     BLE_GAP_EXT_ADV_DATA_STATUS_TRUNCATED,
+                                     frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_adv_mon_num_events == 2);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].truncated);
+    TEST_ASSERT(ble_gap_test_adv_mon_descs[0].length_data ==
+                sizeof(frag1) + sizeof(frag2));
+
+    rc = ble_gap_adv_mon_stats(&stats, 1);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(stats.evicted == 1);
+    TEST_ASSERT(stats.truncated == 2);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_SUITE(ble_gap_test_suite_adv_mon_ext)
+{
+    ble_gap_test_case_adv_mon_ext_reasm();
+}
+#endif
+
+/*****************************************************************************
+ * $batched discovery                                                        *
+ *****************************************************************************/
+
+#define BLE_GAP_TEST_DISC_BATCH_MAX_REPORTS     4
+
+static struct ble_gap_disc_batch_report
+    ble_gap_test_disc_batch_reports[BLE_GAP_TEST_DISC_BATCH_MAX_REPORTS];
+static int ble_gap_test_disc_batch_num_events;
+static int ble_gap_test_disc_batch_num_reports;
+
+static int
+ble_gap_test_util_disc_batch_cb(struct ble_gap_event *event, void *arg)
+{
+    int i;
+
+    TEST_ASSERT_FATAL(event->type == BLE_GAP_EVENT_DISC_BATCH);
+    TEST_ASSERT_FATAL(event->disc_batch.num_reports <=
+                      BLE_GAP_TEST_DISC_BATCH_MAX_REPORTS);
+
+    ble_gap_test_disc_batch_num_events++;
+    ble_gap_test_disc_batch_num_reports = event->disc_batch.num_reports;
+    for (i = 0; i < event->disc_batch.num_reports; i++) {
+        ble_gap_test_disc_batch_reports[i] = event->disc_batch.reports[i];
+    }
+
+    return 0;
+}
+
+#if !MYNEWT_VAL(BLE_EXT_ADV)
+static void
+ble_gap_test_util_disc_batch_rx(const ble_addr_t *addr, uint8_t event_type,
+                                int8_t rssi, const uint8_t *data, uint8_t len)
+{
+    struct ble_gap_disc_desc desc = {
+        .event_type = event_type,
+        .addr = *addr,
+        .length_data = len,
+        .rssi = rssi,
+        .data = data,
+    };
+
+    ble_gap_rx_adv_report(&desc);
+}
+
+TEST_CASE_SELF(ble_gap_test_case_disc_batch)
+{
+    static const ble_addr_t addr1 = { BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    static const ble_addr_t addr2 = { BLE_ADDR_RANDOM, { 6, 5, 4, 3, 2, 0xc1 } };
+    static const uint8_t adv_data1[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, BLE_HS_ADV_F_BREDR_UNSUP,
+    };
+    static const uint8_t adv_data2[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, BLE_HS_ADV_F_BREDR_UNSUP,
+        0x04, BLE_HS_ADV_TYPE_MFG_DATA, 0x59, 0x00, 0x01,
+    };
+    struct ble_gap_disc_batch_params batch_params = {
+        .max_reports = 3,
+        .dedup = 1,
+    };
+    struct ble_gap_disc_params disc_params = {
+        .passive = 1,
+    };
+    const struct ble_gap_disc_batch_report *rpt;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    rc = ble_gap_disc_batch_set(&batch_params);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_batch_cb,
+                               NULL, -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Parameters can't change during discovery. */
+    rc = ble_gap_disc_batch_set(NULL);
+    TEST_ASSERT(rc == BLE_HS_EBUSY);
+
+    /*** Repeated reports are merged; the latest data is kept. */
+    ble_gap_test_disc_batch_num_events = 0;
+    ble_gap_test_util_disc_batch_rx(&addr1, BLE_HCI_ADV_RPT_EVTYPE_ADV_IND,
+                                    -60, adv_data1, sizeof(adv_data1));
+    ble_gap_test_util_disc_batch_rx(&addr2, BLE_HCI_ADV_RPT_EVTYPE_ADV_IND,
+                                    -70, adv_data1, sizeof(adv_data1));
+    ble_gap_test_util_disc_batch_rx(&addr1, BLE_HCI_ADV_RPT_EVTYPE_ADV_IND,
+                                    -40, adv_data2, sizeof(adv_data2));
+    ble_gap_test_util_disc_batch_rx(&addr1, BLE_HCI_ADV_RPT_EVTYPE_ADV_IND,
+                                    -50, adv_data1, sizeof(adv_data1));
+    TEST_ASSERT(ble_gap_test_disc_batch_num_events == 0);
+
+    /*** A scan response is a different report; the batch is full. */
+    ble_gap_test_util_disc_batch_rx(&addr1, BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP,
+                                    -55, adv_data2, sizeof(adv_data2));
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 1);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_reports == 3);
+
+    rpt = &ble_gap_test_disc_batch_reports[0];
+    TEST_ASSERT(ble_addr_cmp(&rpt->desc.addr, &addr1) == 0);
+    TEST_ASSERT(rpt->count == 3);
+    TEST_ASSERT(rpt->rssi_min == -60);
+    TEST_ASSERT(rpt->rssi_max == -40);
+    TEST_ASSERT(rpt->desc.rssi == -50);
+    TEST_ASSERT(rpt->desc.length_data == sizeof(adv_data1));
+
+    rpt = &ble_gap_test_disc_batch_reports[1];
+    TEST_ASSERT(ble_addr_cmp(&rpt->desc.addr, &addr2) == 0);
+    TEST_ASSERT(rpt->count == 1);
+    TEST_ASSERT(rpt->rssi_min == -70);
+    TEST_ASSERT(rpt->rssi_max == -70);
+
+    rpt = &ble_gap_test_disc_batch_reports[2];
+    TEST_ASSERT(rpt->desc.event_type == BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP);
+    TEST_ASSERT(rpt->count == 1);
+    TEST_ASSERT(rpt->desc.length_data == sizeof(adv_data2));
+
+    /*** Explicit flush. */
+    ble_gap_test_util_disc_batch_rx(&addr2, BLE_HCI_ADV_RPT_EVTYPE_ADV_IND,
+                                    -65, adv_data2, sizeof(adv_data2));
+    TEST_ASSERT(ble_gap_test_disc_batch_num_events == 1);
+
+    rc = ble_gap_disc_batch_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 2);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_reports == 1);
+    rpt = &ble_gap_test_disc_batch_reports[0];
+    TEST_ASSERT(ble_addr_cmp(&rpt->desc.addr, &addr2) == 0);
+    TEST_ASSERT(memcmp(rpt->desc.data, adv_data2, sizeof(adv_data2)) == 0);
+
+    /*** Nothing buffered; no event. */
+    rc = ble_gap_disc_batch_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_gap_test_disc_batch_num_events == 2);
+
+    rc = ble_hs_test_util_disc_cancel(0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_gap_disc_batch_set(NULL);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_CASE_SELF(ble_gap_test_case_disc_batch_timer)
+{
+    static const ble_addr_t addr1 = { BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    static const uint8_t adv_data[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, BLE_HS_ADV_F_BREDR_UNSUP,
+    };
+    struct ble_gap_disc_batch_params batch_params = {
+        .flush_itvl_ms = 100,
+        .dedup = 0,
+    };
+    struct ble_gap_disc_params disc_params = {
+        .passive = 1,
+    };
+    const struct ble_gap_disc_batch_report *rpt;
+    uint32_t itvl_ticks;
+    int32_t ticks;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    rc = ble_gap_disc_batch_set(&batch_params);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_batch_cb,
+                               NULL, -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = os_time_ms_to_ticks(batch_params.flush_itvl_ms, &itvl_ticks);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Nothing buffered; no flush pending. */
+    ble_gap_test_disc_batch_num_events = 0;
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == BLE_HS_FOREVER);
+
+    /*** Without deduplication, repeated reports are kept apart. */
+    ble_gap_test_util_disc_batch_rx(&addr1, BLE_HCI_ADV_RPT_EVTYPE_ADV_IND,
+                                    -60, adv_data, sizeof(adv_data));
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == itvl_ticks);
+
+    os_time_advance(itvl_ticks / 2);
+    ble_gap_test_util_disc_batch_rx(&addr1, BLE_HCI_ADV_RPT_EVTYPE_ADV_IND,
+                                    -40, adv_data, sizeof(adv_data));
+
+    /*** The interval runs from the first buffered report. */
+    os_time_advance(itvl_ticks - itvl_ticks / 2 - 1);
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == 1);
+    TEST_ASSERT(ble_gap_test_disc_batch_num_events == 0);
+
+    os_time_advance(1);
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == BLE_HS_FOREVER);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 1);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_reports == 2);
+
+    rpt = &ble_gap_test_disc_batch_reports[0];
+    TEST_ASSERT(rpt->count == 1);
+    TEST_ASSERT(rpt->rssi_min == -60);
+    TEST_ASSERT(rpt->rssi_max == -60);
+
+    rpt = &ble_gap_test_disc_batch_reports[1];
+    TEST_ASSERT(rpt->count == 1);
+    TEST_ASSERT(rpt->rssi_min == -40);
+    TEST_ASSERT(rpt->rssi_max == -40);
+
+    /*** The next report starts a new interval. */
+    os_time_advance(itvl_ticks);
+    ble_gap_test_util_disc_batch_rx(&addr1, BLE_HCI_ADV_RPT_EVTYPE_ADV_IND,
+                                    -50, adv_data, sizeof(adv_data));
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == itvl_ticks);
+    TEST_ASSERT(ble_gap_test_disc_batch_num_events == 1);
+
+    os_time_advance(itvl_ticks);
+    ble_gap_timer();
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 2);
+    TEST_ASSERT(ble_gap_test_disc_batch_num_reports == 1);
+
+    rc = ble_hs_test_util_disc_cancel(0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_gap_disc_batch_set(NULL);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_SUITE(ble_gap_test_suite_disc_batch)
+{
+    ble_gap_test_case_disc_batch();
+    ble_gap_test_case_disc_batch_timer();
+}
+#else
+static void
+ble_gap_test_util_disc_batch_ext_rx(const ble_addr_t *addr, uint8_t sid,
+                                    uint8_t data_status, int8_t rssi,
+                                    const uint8_t *data, uint8_t len)
+{
+    struct ble_gap_ext_disc_desc desc = {
+        .props = 0,
+        .data_status = data_status,
+        .addr = *addr,
+        .rssi = rssi,
+        .tx_power = 127,
+        .sid = sid,
+        .prim_phy = BLE_HCI_LE_PHY_1M,
+        .sec_phy = BLE_HCI_LE_PHY_2M,
+        .length_data = len,
+        .data = data,
+    };
+
+    ble_gap_rx_ext_adv_report(&desc);
+}
+
+TEST_CASE_SELF(ble_gap_test_case_disc_batch_ext)
+{
+    static const ble_addr_t addr1 = { BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    static const ble_addr_t addr2 = { BLE_ADDR_RANDOM, { 6, 5, 4, 3, 2, 0xc1 } };
+    static const uint8_t frag1[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, BLE_HS_ADV_F_BREDR_UNSUP,
+        0x05, BLE_HS_ADV_TYPE_COMP_NAME, 'b', 'a', 't', 'c',
+    };
+    static const uint8_t frag2[] = {
+        0x04, BLE_HS_ADV_TYPE_MFG_DATA, 0x59, 0x00, 0x01,
+    };
+    struct ble_gap_disc_batch_params batch_params = {
+        .max_reports = 4,
+        .dedup = 1,
+    };
+    struct ble_gap_disc_params disc_params = {
+        .passive = 1,
+    };
+    const struct ble_gap_disc_batch_report *rpt;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    rc = ble_gap_disc_batch_set(&batch_params);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_batch_cb,
+                               NULL, -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_gap_test_disc_batch_num_events = 0;
+
+    /*** Fragments of a chain are buffered as received. */
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                        -60, frag1, sizeof(frag1));
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -60, frag2, sizeof(frag2));
+
+    /*** A complete report is not merged into the end of a chain... */
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -50, frag2, sizeof(frag2));
+
+    /*** ...but into an earlier complete one. */
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -40, frag2, sizeof(frag2));
+    TEST_ASSERT(ble_gap_test_disc_batch_num_events == 0);
+
+    /*** Another SID is another report; the batch is full. */
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 2,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -70, frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 1);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_reports == 4);
+
+    rpt = &ble_gap_test_disc_batch_reports[0];
+    TEST_ASSERT(rpt->desc.data_status ==
+                BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE);
+    TEST_ASSERT(rpt->desc.sid == 1);
+    TEST_ASSERT(rpt->count == 1);
+    TEST_ASSERT(rpt->desc.length_data == sizeof(frag1));
+
+    rpt = &ble_gap_test_disc_batch_reports[1];
+    TEST_ASSERT(rpt->desc.data_status ==
+                BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE);
+    TEST_ASSERT(rpt->count == 1);
+    TEST_ASSERT(rpt->desc.length_data == sizeof(frag2));
+
+    rpt = &ble_gap_test_disc_batch_reports[2];
+    TEST_ASSERT(rpt->count == 2);
+    TEST_ASSERT(rpt->rssi_min == -50);
+    TEST_ASSERT(rpt->rssi_max == -40);
+
+    rpt = &ble_gap_test_disc_batch_reports[3];
+    TEST_ASSERT(rpt->desc.sid == 2);
+    TEST_ASSERT(rpt->count == 1);
+
+    /*** Reports from another advertiser are kept apart. */
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -60, frag2, sizeof(frag2));
+    ble_gap_test_util_disc_batch_ext_rx(&addr2, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -60, frag2, sizeof(frag2));
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -60, frag2, sizeof(frag2));
+
+    rc = ble_gap_disc_batch_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 2);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_reports == 2);
+    TEST_ASSERT(ble_addr_cmp(&ble_gap_test_disc_batch_reports[0].desc.addr,
+                             &addr1) == 0);
+    TEST_ASSERT(ble_gap_test_disc_batch_reports[0].count == 2);
+    TEST_ASSERT(ble_addr_cmp(&ble_gap_test_disc_batch_reports[1].desc.addr,
+                             &addr2) == 0);
+    TEST_ASSERT(ble_gap_test_disc_batch_reports[1].count == 1);
+
+    rc = ble_hs_test_util_disc_cancel(0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_gap_disc_batch_set(NULL);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_CASE_SELF(ble_gap_test_case_disc_batch_ext_split)
+{
+    static const ble_addr_t addr1 = { BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    static const uint8_t frag1[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, BLE_HS_ADV_F_BREDR_UNSUP,
+        0x05, BLE_HS_ADV_TYPE_COMP_NAME, 'b', 'a', 't', 'c',
+    };
+    static const uint8_t frag2[] = {
+        0x04, BLE_HS_ADV_TYPE_MFG_DATA, 0x59, 0x00, 0x01,
+    };
+    struct ble_gap_disc_batch_params batch_params = {
+        .max_reports = 2,
+        .dedup = 1,
+    };
+    struct ble_gap_disc_params disc_params = {
+        .passive = 1,
+    };
+    const struct ble_gap_disc_batch_report *rpt;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    rc = ble_gap_disc_batch_set(&batch_params);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_batch_cb,
+                               NULL, -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_gap_test_disc_batch_num_events = 0;
+
+    /*** The first fragment of a chain fills the batch. */
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -70, frag2, sizeof(frag2));
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                        -60, frag1, sizeof(frag1));
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 1);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_reports == 2);
+
+    /*** The tail starts the next batch; a duplicate is not merged into it. */
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -50, frag2, sizeof(frag2));
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -40, frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 2);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_reports == 2);
+
+    rpt = &ble_gap_test_disc_batch_reports[0];
+    TEST_ASSERT(rpt->count == 1);
+    TEST_ASSERT(rpt->desc.rssi == -50);
+
+    rpt = &ble_gap_test_disc_batch_reports[1];
+    TEST_ASSERT(rpt->count == 1);
+    TEST_ASSERT(rpt->desc.rssi == -40);
+
+    /*** Same with an explicit flush, and an empty one, inside the chain. */
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+                                        -60, frag1, sizeof(frag1));
+    rc = ble_gap_disc_batch_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 3);
+    TEST_ASSERT(ble_gap_test_disc_batch_num_reports == 1);
+
+    rc = ble_gap_disc_batch_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_gap_test_disc_batch_num_events == 3);
+
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -50, frag2, sizeof(frag2));
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -40, frag2, sizeof(frag2));
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 4);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_reports == 2);
+    TEST_ASSERT(ble_gap_test_disc_batch_reports[0].desc.rssi == -50);
+    TEST_ASSERT(ble_gap_test_disc_batch_reports[1].desc.rssi == -40);
+
+    /*** Once the chain is closed, duplicates are merged again. */
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -30, frag2, sizeof(frag2));
+    ble_gap_test_util_disc_batch_ext_rx(&addr1, 1,
+                                        BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+                                        -20, frag2, sizeof(frag2));
+    rc = ble_gap_disc_batch_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_events == 5);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num_reports == 1);
+    TEST_ASSERT(ble_gap_test_disc_batch_reports[0].count == 2);
+
+    rc = ble_hs_test_util_disc_cancel(0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_gap_disc_batch_set(NULL);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_SUITE(ble_gap_test_suite_disc_batch_ext)
+{
+    ble_gap_test_case_disc_batch_ext();
+    ble_gap_test_case_disc_batch_ext_split();
+}
+#endif
+
 /*****************************************************************************
  * $direct connect                                                           *
  *****************************************************************************/
@@ -2108,7 +3060,7 @@ ble_gap_test_util_update_l2cap_tmo(struct ble_gap_upd_params *params,
      */
     os_time_advance(29 * OS_TICKS_PER_SEC);
     ble_gap_timer();
-    ble_l2cap_sig_timer();
+    ble_hs_deadline_run();
     TEST_ASSERT(ble_gap_test_event.type == 0xff);
 
     /* Advance 30th second; ensure timeout reported. */
@@ -2123,7 +3075,7 @@ ble_gap_test_util_update_l2cap_tmo(struct ble_gap_upd_params *params,
          ble_hs_test_util_hci_ack_set_disconnect(0);
 
          ble_gap_timer();
-         ble_l2cap_sig_timer();
+         ble_hs_deadline_run();
 
          /* Verify terminate was sent. */
          ble_gap_test_util_verify_tx_disconnect();
@@ -2135,7 +3087,7 @@ ble_gap_test_util_update_l2cap_tmo(struct ble_gap_upd_params *params,
                            peer_addr, 6) == 0);
     } else {
         ble_gap_timer();
-        ble_l2cap_sig_timer();
+        ble_hs_deadline_run();
 
         TEST_ASSERT(ble_gap_test_event.type == 0xff);
     }
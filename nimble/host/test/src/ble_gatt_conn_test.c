@@ -596,16 +596,16 @@ ble_gatt_conn_test_util_timeout(uint16_t conn_handle,
 {
     int32_t ticks_from_now;
 
-    ticks_from_now = ble_gattc_timer();
+    ticks_from_now = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_from_now == 30 * OS_TICKS_PER_SEC);
 
     os_time_advance(29 * OS_TICKS_PER_SEC);
-    ticks_from_now = ble_gattc_timer();
+    ticks_from_now = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_from_now == 1 * OS_TICKS_PER_SEC);
 
     ble_hs_test_util_hci_ack_set_disconnect(0);
     os_time_advance(1 * OS_TICKS_PER_SEC);
-    ticks_from_now = ble_gattc_timer();
+    ticks_from_now = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_from_now == BLE_HS_FOREVER);
 
     /* Ensure connection was terminated due to proecedure timeout. */
@@ -645,7 +645,7 @@ TEST_CASE_SELF(ble_gatt_conn_test_timeout)
 
     ble_gatt_conn_test_util_init();
 
-    ticks_from_now = ble_gattc_timer();
+    ticks_from_now = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_from_now == BLE_HS_FOREVER);
 
     /*** Register an attribute to allow indicatations to be sent. */
@@ -775,8 +775,87 @@ TEST_CASE_SELF(ble_gatt_conn_test_timeout)
     ble_hs_test_util_assert_mbufs_freed(NULL);
 }
 
+static int ble_gatt_conn_test_num_timeouts;
+
+static int
+ble_gatt_conn_test_count_tmo_cb(uint16_t conn_handle,
+                                const struct ble_gatt_error *error,
+                                struct ble_gatt_attr *attr, void *arg)
+{
+    TEST_ASSERT_FATAL(error != NULL);
+    TEST_ASSERT(error->status == BLE_HS_ETIMEOUT);
+
+    ble_gatt_conn_test_num_timeouts++;
+
+    return 0;
+}
+
+/**
+ * Fills the procedure pool with GATT procedures started one tick apart and
+ * verifies that the host timer expires them one by one, in order.
+ */
+TEST_CASE_SELF(ble_gatt_conn_test_timer_many_procs)
+{
+    static const uint8_t peer_addr[6] = { 1, 2, 3, 4, 5, 6 };
+
+    int32_t ticks_from_now;
+    int num_procs;
+    int rc;
+    int i;
+
+    num_procs = MYNEWT_VAL(BLE_GATT_MAX_PROCS);
+
+    ble_gatt_conn_test_util_init();
+    ble_gatt_conn_test_num_timeouts = 0;
+
+    ble_hs_test_util_create_conn(1, peer_addr, NULL, NULL);
+
+    for (i = 0; i < num_procs; i++) {
+        rc = ble_gattc_read(1, BLE_GATT_BREAK_TEST_READ_ATTR_HANDLE,
+                            ble_gatt_conn_test_count_tmo_cb, NULL);
+        TEST_ASSERT_FATAL(rc == 0);
+
+        ticks_from_now = ble_hs_test_util_gattc_timer();
+        TEST_ASSERT(ticks_from_now == 30 * OS_TICKS_PER_SEC - i);
+
+        os_time_advance(1);
+    }
+
+    /* The pool is exhausted. */
+    rc = ble_gattc_read(1, BLE_GATT_BREAK_TEST_READ_ATTR_HANDLE,
+                        ble_gatt_conn_test_count_tmo_cb, NULL);
+    TEST_ASSERT(rc == BLE_HS_ENOMEM);
+
+    /* Wake up before anything expires. */
+    ticks_from_now = ble_hs_test_util_gattc_timer();
+    TEST_ASSERT(ticks_from_now == 30 * OS_TICKS_PER_SEC - num_procs);
+    TEST_ASSERT(ble_gatt_conn_test_num_timeouts == 0);
+
+    /* Each tick expires the next procedure. */
+    ble_hs_test_util_hci_ack_set_disconnect(0);
+    os_time_advance(ticks_from_now);
+    for (i = 1; i < num_procs; i++) {
+        ticks_from_now = ble_hs_test_util_gattc_timer();
+        TEST_ASSERT(ticks_from_now == 1);
+        TEST_ASSERT(ble_gatt_conn_test_num_timeouts == i);
+
+        os_time_advance(1);
+    }
+
+    ticks_from_now = ble_hs_test_util_gattc_timer();
+    TEST_ASSERT(ticks_from_now == BLE_HS_FOREVER);
+    TEST_ASSERT(ble_gatt_conn_test_num_timeouts == num_procs);
+
+    ble_hs_test_util_hci_rx_disconn_complete_event(
+        1, 0, BLE_ERR_REM_USER_CONN_TERM);
+    ble_hs_test_util_prev_tx_queue_clear();
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
 TEST_SUITE(ble_gatt_conn_suite)
 {
     ble_gatt_conn_test_disconnect();
     ble_gatt_conn_test_timeout();
+    ble_gatt_conn_test_timer_many_procs();
 }
@@ -437,14 +437,14 @@ TEST_CASE_SELF(ble_gatt_disc_s_test_oom_all)
     TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue_pullup() == NULL);
 
     /* Verify that we will resume the stalled GATT procedure in one second. */
-    ticks_until = ble_gattc_timer();
+    ticks_until = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_until == os_time_ms_to_ticks32(MYNEWT_VAL(BLE_GATT_RESUME_RATE)));
 
     /* Verify the procedure proceeds after mbufs become available. */
     rc = os_mbuf_free_chain(oms);
     TEST_ASSERT_FATAL(rc == 0);
     os_time_advance(ticks_until);
-    ble_gattc_timer();
+    ble_hs_test_util_gattc_timer();
 
     /* Exhaust the msys pool.  Leave one mbuf for the forthcoming response. */
     oms = ble_hs_test_util_mbuf_alloc_all_but(1);
@@ -457,13 +457,13 @@ TEST_CASE_SELF(ble_gatt_disc_s_test_oom_all)
     TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue_pullup() == NULL);
 
     /* Verify that we will resume the stalled GATT procedure in one second. */
-    ticks_until = ble_gattc_timer();
+    ticks_until = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_until == os_time_ms_to_ticks32(MYNEWT_VAL(BLE_GATT_RESUME_RATE)));
 
     rc = os_mbuf_free_chain(oms);
     TEST_ASSERT_FATAL(rc == 0);
     os_time_advance(ticks_until);
-    ble_gattc_timer();
+    ble_hs_test_util_gattc_timer();
 
     ble_hs_test_util_rx_att_err_rsp(1, BLE_L2CAP_CID_ATT,
                                     BLE_ATT_OP_READ_GROUP_TYPE_REQ,
@@ -516,14 +516,14 @@ TEST_CASE_SELF(ble_gatt_disc_s_test_oom_uuid)
     TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue_pullup() == NULL);
 
     /* Verify that we will resume the stalled GATT procedure in one second. */
-    ticks_until = ble_gattc_timer();
+    ticks_until = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_until == os_time_ms_to_ticks32(MYNEWT_VAL(BLE_GATT_RESUME_RATE)));
 
     /* Verify the procedure proceeds after mbufs become available. */
     rc = os_mbuf_free_chain(oms);
     TEST_ASSERT_FATAL(rc == 0);
     os_time_advance(ticks_until);
-    ble_gattc_timer();
+    ble_hs_test_util_gattc_timer();
 
     /* Exhaust the msys pool.  Leave one mbuf for the forthcoming response. */
     oms = ble_hs_test_util_mbuf_alloc_all_but(1);
@@ -536,14 +536,14 @@ TEST_CASE_SELF(ble_gatt_disc_s_test_oom_uuid)
     TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue_pullup() == NULL);
 
     /* Verify that we will resume the stalled GATT procedure in one second. */
-    ticks_until = ble_gattc_timer();
+    ticks_until = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_until == os_time_ms_to_ticks32(MYNEWT_VAL(BLE_GATT_RESUME_RATE)));
 
     /* Verify that procedure completes when mbufs are available. */
     rc = os_mbuf_free_chain(oms);
     TEST_ASSERT_FATAL(rc == 0);
     os_time_advance(ticks_until);
-    ble_gattc_timer();
+    ble_hs_test_util_gattc_timer();
 
     ble_hs_test_util_rx_att_err_rsp(1, BLE_L2CAP_CID_ATT,
                                     BLE_ATT_OP_READ_GROUP_TYPE_REQ,
@@ -599,7 +599,7 @@ TEST_CASE_SELF(ble_gatt_disc_s_test_oom_timeout)
         /* Verify that we will resume the stalled GATT procedure in one
          * second.
          */
-        ticks_until = ble_gattc_timer();
+        ticks_until = ble_hs_test_util_gattc_timer();
         TEST_ASSERT(ticks_until == os_time_ms_to_ticks32(MYNEWT_VAL(BLE_GATT_RESUME_RATE)));
 
         os_time_advance(ticks_until);
@@ -609,9 +609,9 @@ TEST_CASE_SELF(ble_gatt_disc_s_test_oom_timeout)
      * in the process of being terminated.  XXX: Check this.
      */
     ble_hs_test_util_hci_ack_set_disconnect(0);
-    ble_gattc_timer();
+    ble_hs_test_util_gattc_timer();
 
-    ticks_until = ble_gattc_timer();
+    ticks_until = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_until == BLE_HS_FOREVER);
     TEST_ASSERT(!ble_gattc_any_jobs());
 
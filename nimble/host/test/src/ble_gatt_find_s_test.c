@@ -389,14 +389,14 @@ TEST_CASE_SELF(ble_gatt_find_s_test_oom)
     TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue_pullup() == NULL);
 
     /* Verify that we will resume the stalled GATT procedure in one second. */
-    ticks_until = ble_gattc_timer();
+    ticks_until = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_until == os_time_ms_to_ticks32(MYNEWT_VAL(BLE_GATT_RESUME_RATE)));
 
     /* Verify the procedure succeeds after mbufs become available. */
     rc = os_mbuf_free_chain(oms);
     TEST_ASSERT_FATAL(rc == 0);
     os_time_advance(ticks_until);
-    ble_gattc_timer();
+    ble_hs_test_util_gattc_timer();
 
     /* We can't cause a memory exhaustion error on the follow up request.  The
      * GATT client frees the read response immediately before sending the
@@ -413,7 +413,7 @@ TEST_CASE_SELF(ble_gatt_find_s_test_oom)
     rc = os_mbuf_free_chain(oms);
     TEST_ASSERT_FATAL(rc == 0);
     os_time_advance(ticks_until);
-    ble_gattc_timer();
+    ble_hs_test_util_gattc_timer();
 
     ble_gatt_find_s_test_misc_rx_read(1, BLE_L2CAP_CID_ATT, incs[1].uuid);
 
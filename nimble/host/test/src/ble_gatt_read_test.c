@@ -820,6 +820,59 @@ TEST_CASE_SELF(ble_gatt_read_test_concurrent)
     ble_hs_test_util_assert_mbufs_freed(NULL);
 }
 
+TEST_CASE_SELF(ble_gatt_read_test_concurrent_conns)
+{
+    int rc;
+
+    ble_gatt_read_test_misc_init();
+    ble_hs_test_util_create_conn(1, ((uint8_t[]){2,3,4,5,6,7,8,9}),
+                                 NULL, NULL);
+    ble_hs_test_util_create_conn(2, ((uint8_t[]){3,4,5,6,7,8,9,10}),
+                                 NULL, NULL);
+
+    /***
+     * Perform a read on each of two connections.  Assert that each response
+     * is matched up with the GATT procedure of the connection it was received
+     * on, even if it is not the oldest procedure.
+     */
+
+    struct ble_hs_test_util_flat_attr attrs[2] = {
+        {
+            .handle = 1,
+            .offset = 0,
+            .value_len = 3,
+            .value = { 1, 2, 3 },
+        },
+        {
+            .handle = 2,
+            .offset = 0,
+            .value_len = 4,
+            .value = { 2, 3, 4, 5 },
+        },
+    };
+
+    rc = ble_gattc_read(1, attrs[0].handle, ble_gatt_read_test_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_gattc_read(2, attrs[1].handle, ble_gatt_read_test_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_gatt_read_test_misc_rx_rsp_good(2, BLE_L2CAP_CID_ATT, attrs + 1);
+    TEST_ASSERT_FATAL(ble_gatt_read_test_num_attrs == 1);
+    TEST_ASSERT(ble_gatt_read_test_attrs[0].conn_handle == 2);
+    TEST_ASSERT(ble_gatt_read_test_attrs[0].handle == attrs[1].handle);
+
+    ble_gatt_read_test_misc_rx_rsp_good(1, BLE_L2CAP_CID_ATT, attrs + 0);
+    TEST_ASSERT_FATAL(ble_gatt_read_test_num_attrs == 2);
+    TEST_ASSERT(ble_gatt_read_test_attrs[1].conn_handle == 1);
+    TEST_ASSERT(ble_gatt_read_test_attrs[1].handle == attrs[0].handle);
+    TEST_ASSERT(memcmp(ble_gatt_read_test_attrs[1].value, attrs[0].value,
+                       attrs[0].value_len) == 0);
+
+    TEST_ASSERT(!ble_gattc_any_jobs());
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
 TEST_CASE_SELF(ble_gatt_read_test_long_oom)
 {
     static const struct ble_hs_test_util_flat_attr attr = {
@@ -866,14 +919,14 @@ TEST_CASE_SELF(ble_gatt_read_test_long_oom)
     TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue_pullup() == NULL);
 
     /* Verify that we will resume the stalled GATT procedure in one second. */
-    ticks_until = ble_gattc_timer();
+    ticks_until = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_until == os_time_ms_to_ticks32(MYNEWT_VAL(BLE_GATT_RESUME_RATE)));
 
     /* Verify the procedure proceeds after mbufs become available. */
     rc = os_mbuf_free_chain(oms);
     TEST_ASSERT_FATAL(rc == 0);
     os_time_advance(ticks_until);
-    ble_gattc_timer();
+    ble_hs_test_util_gattc_timer();
 
     /* Exhaust the msys pool.  Leave one mbuf for the forthcoming response. */
     oms = ble_hs_test_util_mbuf_alloc_all_but(1);
@@ -889,14 +942,14 @@ TEST_CASE_SELF(ble_gatt_read_test_long_oom)
     TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue_pullup() == NULL);
 
     /* Verify that we will resume the stalled GATT procedure in one second. */
-    ticks_until = ble_gattc_timer();
+    ticks_until = ble_hs_test_util_gattc_timer();
     TEST_ASSERT(ticks_until == os_time_ms_to_ticks32(MYNEWT_VAL(BLE_GATT_RESUME_RATE)));
 
     /* Verify that procedure completes when mbufs are available. */
     rc = os_mbuf_free_chain(oms);
     TEST_ASSERT_FATAL(rc == 0);
     os_time_advance(ticks_until);
-    ble_gattc_timer();
+    ble_hs_test_util_gattc_timer();
 
     chunk_sz = attr.value_len - off;
     ble_gatt_read_test_misc_rx_rsp_good_raw(2, BLE_L2CAP_CID_ATT, BLE_ATT_OP_READ_RSP,
@@ -921,5 +974,6 @@ TEST_SUITE(ble_gatt_read_test_suite)
     ble_gatt_read_test_long();
     ble_gatt_read_test_mult();
     ble_gatt_read_test_concurrent();
+    ble_gatt_read_test_concurrent_conns();
     ble_gatt_read_test_long_oom();
 }
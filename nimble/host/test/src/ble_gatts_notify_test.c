@@ -73,6 +73,8 @@ ble_gatts_notify_test_events[BLE_GATTS_NOTIFY_TEST_MAX_EVENTS];
 
 static int ble_gatts_notify_test_num_events;
 
+static int ble_gatts_notify_test_num_reads;
+
 typedef int ble_store_write_fn(int obj_type, const union ble_store_value *val);
 
 typedef int ble_store_delete_fn(int obj_type, const union ble_store_key *key);
@@ -389,6 +391,8 @@ ble_gatts_notify_test_misc_access(uint16_t conn_handle,
     TEST_ASSERT_FATAL(ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR);
     TEST_ASSERT(conn_handle == 0xffff);
 
+    ble_gatts_notify_test_num_reads++;
+
     if (attr_handle == ble_gatts_notify_test_chr_1_def_handle + 1) {
         TEST_ASSERT(ctxt->chr ==
                     &ble_gatts_notify_test_svcs[0].characteristics[0]);
@@ -1071,6 +1075,107 @@ TEST_CASE_SELF(ble_gatts_notify_test_disallowed)
     ble_hs_test_util_assert_mbufs_freed(NULL);
 }
 
+TEST_CASE_SELF(ble_gatts_notify_test_fanout)
+{
+#if MYNEWT_VAL(BLE_GATTS_NOTIFY_FANOUT)
+    struct ble_gatts_fanout_stats stats;
+    uint16_t chr_val_handle;
+    uint16_t avail_pkts;
+    uint16_t conn_handle;
+    int rc;
+
+    ble_gatts_notify_test_misc_init(&conn_handle, 0,
+                                    BLE_GATTS_CLT_CFG_F_NOTIFY, 0);
+    chr_val_handle = ble_gatts_notify_test_chr_1_def_handle + 1;
+
+    /* Subscribe a second peer to the same characteristic. */
+    ble_hs_test_util_create_conn(3, ((uint8_t[]){3,4,5,6,7,8}),
+                                 ble_gatts_notify_test_util_gap_event, NULL);
+    ble_gatts_notify_test_misc_enable_notify(
+        3, ble_gatts_notify_test_chr_1_def_handle, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    ble_gatts_notify_test_util_verify_sub_event(
+        3, chr_val_handle, BLE_GAP_SUBSCRIBE_REASON_WRITE, 0, 1, 0, 0);
+
+    /* The value is read once and sent to both peers, newest first. */
+    ble_gatts_notify_test_num_reads = 0;
+    ble_gatts_notify_test_chr_1_len = 1;
+    ble_gatts_notify_test_chr_1_val[0] = 0x5a;
+    ble_gatts_chr_updated(chr_val_handle);
+
+    TEST_ASSERT(ble_gatts_notify_test_num_reads == 1);
+    ble_gatts_notify_test_misc_verify_tx_n(3, chr_val_handle,
+                                           ble_gatts_notify_test_chr_1_val,
+                                           ble_gatts_notify_test_chr_1_len);
+    ble_gatts_notify_test_misc_verify_tx_n(2, chr_val_handle,
+                                           ble_gatts_notify_test_chr_1_val,
+                                           ble_gatts_notify_test_chr_1_len);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+
+    rc = ble_gatts_fanout_stats(chr_val_handle, &stats);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.updates == 1);
+    TEST_ASSERT(stats.sends == 2);
+    TEST_ASSERT(stats.deferrals == 0);
+    TEST_ASSERT(stats.copies == 0);
+
+    /* No controller buffers: nothing gets read or sent. */
+    ble_hs_lock();
+    avail_pkts = ble_hs_hci_avail_pkts;
+    ble_hs_hci_avail_pkts = 0;
+    ble_hs_unlock();
+
+    ble_gatts_notify_test_num_reads = 0;
+    ble_gatts_notify_test_chr_1_val[0] = 0xa5;
+    ble_gatts_chr_updated(chr_val_handle);
+
+    TEST_ASSERT(ble_gatts_notify_test_num_reads == 0);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+
+    rc = ble_gatts_fanout_stats(chr_val_handle, &stats);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.updates == 1);
+    TEST_ASSERT(stats.deferrals == 1);
+
+    /* Buffers coming back resume the fan-out. */
+    ble_hs_lock();
+    ble_hs_hci_add_avail_pkts(avail_pkts);
+    ble_hs_unlock();
+    ble_hs_wakeup_tx();
+
+    TEST_ASSERT(ble_gatts_notify_test_num_reads == 1);
+    ble_gatts_notify_test_misc_verify_tx_n(3, chr_val_handle,
+                                           ble_gatts_notify_test_chr_1_val,
+                                           ble_gatts_notify_test_chr_1_len);
+    ble_gatts_notify_test_misc_verify_tx_n(2, chr_val_handle,
+                                           ble_gatts_notify_test_chr_1_val,
+                                           ble_gatts_notify_test_chr_1_len);
+
+    rc = ble_gatts_fanout_stats(chr_val_handle, &stats);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.updates == 2);
+    TEST_ASSERT(stats.sends == 4);
+    TEST_ASSERT(stats.copies == 0);
+
+    /* A value that needs more than one ACL buffer is copied for each peer. */
+    ble_gatts_notify_test_chr_1_len = ble_hs_hci_max_acl_payload_sz() + 1;
+    ble_gatts_chr_updated(chr_val_handle);
+    ble_hs_test_util_prev_tx_queue_clear();
+
+    rc = ble_gatts_fanout_stats(chr_val_handle, &stats);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.sends == 6);
+    TEST_ASSERT(stats.copies == 2);
+
+    /* Characteristic 2 has no CCCD subscribers but still has counters. */
+    rc = ble_gatts_fanout_stats(ble_gatts_notify_test_chr_2_def_handle + 1,
+                                &stats);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(stats.sends == 0);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+#endif
+}
+
 TEST_SUITE(ble_gatts_notify_suite)
 {
     ble_gatts_notify_test_n();
@@ -1083,6 +1188,8 @@ TEST_SUITE(ble_gatts_notify_suite)
 
     ble_gatts_notify_test_disallowed();
 
+    ble_gatts_notify_test_fanout();
+
     /* XXX: Test corner cases:
      *     o Bonding after CCCD configuration.
      *     o Disconnect prior to rx of indicate ack.
@@ -216,9 +216,118 @@ TEST_CASE_SELF(ble_hs_conn_test_undirect_connectable_success)
     ble_hs_test_util_assert_mbufs_freed(NULL);
 }
 
+static uint16_t
+ble_hs_conn_test_handle(int i)
+{
+    /* Spread handles so several of them share low order bits. */
+    return 0x0100 * i + 1;
+}
+
+static void
+ble_hs_conn_test_addr(int i, ble_addr_t *addr)
+{
+    addr->type = BLE_ADDR_PUBLIC;
+    memset(addr->val, 0, sizeof addr->val);
+    addr->val[0] = i;
+    addr->val[5] = 0xc0;
+}
+
+static void
+ble_hs_conn_test_util_verify_lookup(const int *connected, int num_conns)
+{
+    struct ble_hs_conn *conn;
+    ble_addr_t addr;
+    int idx;
+    int i;
+
+    ble_hs_lock();
+
+    idx = num_conns - 1;
+    for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i++) {
+        ble_hs_conn_test_addr(i, &addr);
+
+        conn = ble_hs_conn_find(ble_hs_conn_test_handle(i));
+        if (!connected[i]) {
+            TEST_ASSERT(conn == NULL);
+            TEST_ASSERT(ble_hs_conn_find_by_addr(&addr) == NULL);
+            continue;
+        }
+
+        TEST_ASSERT_FATAL(conn != NULL);
+        TEST_ASSERT(conn->bhc_handle == ble_hs_conn_test_handle(i));
+        TEST_ASSERT(ble_hs_conn_find_by_addr(&addr) == conn);
+
+        /* Indices run from the most recently inserted connection. */
+        TEST_ASSERT(idx >= 0);
+        TEST_ASSERT(ble_hs_conn_find_by_idx(idx) == conn);
+        idx--;
+    }
+
+    TEST_ASSERT(idx == -1);
+    TEST_ASSERT(ble_hs_conn_find_by_idx(num_conns) == NULL);
+    TEST_ASSERT(ble_hs_conn_find(0x0eff) == NULL);
+
+    ble_hs_unlock();
+}
+
+TEST_CASE_SELF(ble_hs_conn_test_lookup)
+{
+    int connected[MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+    int num_conns;
+    ble_addr_t addr;
+    int i;
+
+    ble_hs_test_util_init();
+
+    memset(connected, 0, sizeof connected);
+    num_conns = 0;
+
+    /* Fill every connection slot. */
+    for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i++) {
+        ble_hs_conn_test_addr(i, &addr);
+        ble_hs_test_util_create_conn(ble_hs_conn_test_handle(i), addr.val,
+                                     NULL, NULL);
+        connected[i] = 1;
+        num_conns++;
+
+        ble_hs_conn_test_util_verify_lookup(connected, num_conns);
+    }
+
+    /* Drop every other connection; remaining ones must still be found. */
+    for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i += 2) {
+        ble_hs_test_util_conn_disconnect(ble_hs_conn_test_handle(i));
+        connected[i] = 0;
+        num_conns--;
+
+        ble_hs_conn_test_util_verify_lookup(connected, num_conns);
+    }
+
+    /* Reconnect them; freed table slots are reused. */
+    for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i += 2) {
+        ble_hs_conn_test_addr(i, &addr);
+        ble_hs_test_util_create_conn(ble_hs_conn_test_handle(i), addr.val,
+                                     NULL, NULL);
+        connected[i] = 1;
+        num_conns++;
+    }
+
+    /* Insertion order is no longer by index, check membership only. */
+    ble_hs_lock();
+    for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i++) {
+        ble_hs_conn_test_addr(i, &addr);
+        TEST_ASSERT(ble_hs_conn_find(ble_hs_conn_test_handle(i)) ==
+                    ble_hs_conn_find_by_addr(&addr));
+        TEST_ASSERT(ble_hs_conn_find_by_idx(i) != NULL);
+    }
+    ble_hs_unlock();
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
 TEST_SUITE(ble_hs_conn_suite)
 {
     ble_hs_conn_test_direct_connect_success();
     ble_hs_conn_test_direct_connectable_success();
     ble_hs_conn_test_undirect_connectable_success();
+    ble_hs_conn_test_lookup();
 }
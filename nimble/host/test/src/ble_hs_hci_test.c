@@ -333,10 +333,155 @@ TEST_CASE_SELF(ble_hs_hci_acl_two_conn)
     ble_hs_test_util_assert_mbufs_freed(NULL);
 }
 
+static int
+ble_hs_hci_test_queued(uint16_t conn_handle)
+{
+    struct ble_gap_conn_tx_stats stats;
+    int rc;
+
+    rc = ble_gap_conn_tx_stats(conn_handle, &stats, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    return stats.queued_pkts;
+}
+
+/**
+ * Releases one controller buffer held by whichever connection sent last and
+ * returns the handle of the connection that got to use it.
+ */
+static uint16_t
+ble_hs_hci_test_release_one(uint16_t conn_handle)
+{
+    struct ble_hs_test_util_hci_num_completed_pkts_entry ncpe[2];
+    int q1;
+    int q2;
+
+    q1 = ble_hs_hci_test_queued(1);
+    q2 = ble_hs_hci_test_queued(2);
+
+    memset(ncpe, 0, sizeof(ncpe));
+    ncpe[0].handle_id = conn_handle;
+    ncpe[0].num_pkts = 1;
+    ble_hs_test_util_hci_rx_num_completed_pkts_event(ncpe);
+    TEST_ASSERT_FATAL(ble_hs_hci_avail_pkts == 0);
+
+    if (ble_hs_hci_test_queued(1) == q1 - 1) {
+        TEST_ASSERT_FATAL(ble_hs_hci_test_queued(2) == q2);
+        return 1;
+    }
+
+    TEST_ASSERT_FATAL(ble_hs_hci_test_queued(1) == q1);
+    TEST_ASSERT_FATAL(ble_hs_hci_test_queued(2) == q2 - 1);
+    return 2;
+}
+
+TEST_CASE_SELF(ble_hs_hci_acl_fair_share)
+{
+    struct ble_gap_conn_tx_stats stats;
+    uint8_t peer_addr1[6] = { 1, 2, 3, 4, 5, 6 };
+    uint8_t peer_addr2[6] = { 2, 3, 4, 5, 6, 7 };
+    uint8_t data[10];
+    uint16_t last;
+    int sent1;
+    int rc;
+    int i;
+
+    memset(data, 0, sizeof data);
+
+    ble_hs_test_util_init();
+
+    /* The controller has room for one 20-byte payload. */
+    rc = ble_hs_hci_set_buf_sz(20, 1);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_create_conn(1, peer_addr1, NULL, NULL);
+    ble_hs_test_util_create_conn(2, peer_addr2, NULL, NULL);
+
+    /* Occupy the controller, then back up six single-fragment packets on
+     * connection 1 followed by two on connection 2.
+     */
+    rc = ble_hs_test_util_gatt_write_no_rsp_flat(1, 100, data, sizeof data);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT_FATAL(ble_hs_hci_avail_pkts == 0);
+
+    for (i = 0; i < 6; i++) {
+        rc = ble_hs_test_util_gatt_write_no_rsp_flat(1, 100, data,
+                                                     sizeof data);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    for (i = 0; i < 2; i++) {
+        rc = ble_hs_test_util_gatt_write_no_rsp_flat(2, 100, data,
+                                                     sizeof data);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    TEST_ASSERT_FATAL(ble_hs_hci_test_queued(1) == 6);
+    TEST_ASSERT_FATAL(ble_hs_hci_test_queued(2) == 2);
+
+    /* Connection 2 is not stuck behind connection 1's backlog; the two
+     * connections alternate.
+     */
+    last = 1;
+    for (i = 0; i < 4; i++) {
+        last = ble_hs_hci_test_release_one(last);
+        if (i % 2 == 1) {
+            TEST_ASSERT(ble_hs_hci_test_queued(1) == 6 - (i + 1) / 2);
+            TEST_ASSERT(ble_hs_hci_test_queued(2) == 2 - (i + 1) / 2);
+        }
+    }
+
+    /* With twice the weight, connection 2 gets two buffers for every one
+     * connection 1 gets.
+     */
+    rc = ble_gap_set_tx_weight(2, 0);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    rc = ble_gap_set_tx_weight(3, 2);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+    rc = ble_gap_set_tx_weight(2, 2);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    for (i = 0; i < 4; i++) {
+        rc = ble_hs_test_util_gatt_write_no_rsp_flat(2, 100, data,
+                                                     sizeof data);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    sent1 = 0;
+    for (i = 0; i < 3; i++) {
+        last = ble_hs_hci_test_release_one(last);
+        if (last == 1) {
+            sent1++;
+        }
+    }
+    TEST_ASSERT(sent1 == 1);
+    TEST_ASSERT(ble_hs_hci_test_queued(1) == 3);
+    TEST_ASSERT(ble_hs_hci_test_queued(2) == 2);
+
+    /* Queue depth high-water mark. */
+    rc = ble_gap_conn_tx_stats(1, &stats, 1);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.queued_pkts == 3);
+    TEST_ASSERT(stats.queued_pkts_max == 6);
+
+    rc = ble_gap_conn_tx_stats(1, &stats, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.queued_pkts_max == 3);
+
+    ble_hs_test_util_prev_tx_queue_clear();
+
+    /* Queued packets are freed with their connections. */
+    ble_hs_test_util_hci_rx_disconn_complete_event(1, 0,
+                                                   BLE_ERR_CONN_TERM_LOCAL);
+    ble_hs_test_util_hci_rx_disconn_complete_event(2, 0,
+                                                   BLE_ERR_CONN_TERM_LOCAL);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
 TEST_SUITE(ble_hs_hci_suite)
 {
     ble_hs_hci_test_event_bad();
     ble_hs_hci_test_rssi();
     ble_hs_hci_acl_one_conn();
     ble_hs_hci_acl_two_conn();
+    ble_hs_hci_acl_fair_share();
 }
@@ -30,6 +30,18 @@
 int
 main(int argc, char **argv)
 {
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+    /* The broadcast source requires extended and periodic advertising; run
+     * only the suites covering ISO transmission.
+     */
+    ble_iso_test_suite_tx();
+#elif MYNEWT_VAL(BLE_EXT_ADV)
+    /* The other suites drive discovery and advertising with legacy HCI
+     * commands; only those covering extended advertising are run here.
+     */
+    ble_gap_test_suite_adv_mon_ext();
+    ble_gap_test_suite_disc_batch_ext();
+#else
     /* XXX: This test must come before the others; it causes privacy to be
      * enabled.  Subsequent tests depend on this.  This is wrong - each test
      * should enable privacy as needed, but the test util functions are so low
@@ -44,6 +56,8 @@ main(int argc, char **argv)
     ble_att_clt_suite();
     ble_att_svr_suite();
     ble_gap_test_suite_adv();
+    ble_gap_test_suite_adv_mon();
+    ble_gap_test_suite_disc_batch();
     ble_gap_test_suite_conn_cancel();
     ble_gap_test_suite_conn_find();
     ble_gap_test_suite_conn_gen();
@@ -76,6 +90,7 @@ main(int argc, char **argv)
     ble_sm_sc_test_suite();
     ble_store_suite();
     ble_uuid_test_suite();
+#endif
 
     return tu_any_failed;
 }
@@ -25,6 +25,10 @@
 TEST_SUITE_DECL(ble_att_clt_suite);
 TEST_SUITE_DECL(ble_att_svr_suite);
 TEST_SUITE_DECL(ble_gap_test_suite_adv);
+TEST_SUITE_DECL(ble_gap_test_suite_adv_mon);
+TEST_SUITE_DECL(ble_gap_test_suite_adv_mon_ext);
+TEST_SUITE_DECL(ble_gap_test_suite_disc_batch);
+TEST_SUITE_DECL(ble_gap_test_suite_disc_batch_ext);
 TEST_SUITE_DECL(ble_gap_test_suite_conn_cancel);
 TEST_SUITE_DECL(ble_gap_test_suite_conn_find);
 TEST_SUITE_DECL(ble_gap_test_suite_conn_gen);
@@ -51,6 +55,7 @@ TEST_SUITE_DECL(ble_hs_conn_suite);
 TEST_SUITE_DECL(ble_hs_hci_suite);
 TEST_SUITE_DECL(ble_hs_id_test_suite_auto);
 TEST_SUITE_DECL(ble_hs_pvcy_test_suite_irk);
+TEST_SUITE_DECL(ble_iso_test_suite_tx);
 TEST_SUITE_DECL(ble_l2cap_test_suite);
 TEST_SUITE_DECL(ble_os_test_suite);
 TEST_SUITE_DECL(ble_sm_gen_test_suite);
@@ -35,6 +35,10 @@ uint8_t g_dev_addr[BLE_DEV_ADDR_LEN];
 static STAILQ_HEAD(, os_mbuf_pkthdr) ble_hs_test_util_prev_tx_queue;
 struct os_mbuf *ble_hs_test_util_prev_tx_cur;
 
+#if MYNEWT_VAL(BLE_ISO)
+static STAILQ_HEAD(, os_mbuf_pkthdr) ble_hs_test_util_iso_tx_queue;
+#endif
+
 int ble_sm_test_store_obj_type;
 union ble_store_key ble_sm_test_store_key;
 union ble_store_value ble_sm_test_store_value;
@@ -393,7 +397,7 @@ ble_hs_test_util_disc_cancel(uint8_t ack_status)
 
     ble_hs_test_util_hci_ack_set(
         ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE,
-                                    BLE_HCI_OCF_LE_SET_SCAN_ENABLE),
+                                    BLE_HS_TEST_UTIL_OCF_SCAN_ENABLE),
         ack_status);
 
     rc = ble_gap_disc_cancel();
@@ -1829,6 +1833,24 @@ ble_hs_test_util_mbuf_count(const struct ble_hs_test_util_mbuf_params *params)
     return count;
 }
 
+/**
+ * Does the GATT client's part of a host timer expiry: times out expired
+ * procedures and resumes stalled ones.
+ *
+ * @return                      The number of ticks until the next wakeup.
+ */
+int32_t
+ble_hs_test_util_gattc_timer(void)
+{
+    int32_t ticks_until_exp;
+    int32_t ticks_until_resume;
+
+    ticks_until_exp = ble_hs_deadline_run();
+    ticks_until_resume = ble_gattc_timer();
+
+    return min(ticks_until_exp, ticks_until_resume);
+}
+
 void
 ble_hs_test_util_assert_mbufs_freed(
     const struct ble_hs_test_util_mbuf_params *params)
@@ -1864,6 +1886,61 @@ ble_transport_to_ll_cmd_impl(void *buf)
     return 0;
 }
 
+#if MYNEWT_VAL(BLE_ISO)
+int
+ble_transport_to_ll_iso_impl(struct os_mbuf *om)
+{
+    STAILQ_INSERT_TAIL(&ble_hs_test_util_iso_tx_queue, OS_MBUF_PKTHDR(om),
+                       omp_next);
+    return 0;
+}
+
+/**
+ * Removes the oldest HCI ISO Data packet sent by the host.  The caller frees
+ * it.
+ *
+ * @return                      The packet, including its HCI ISO data
+ *                                  header; NULL if none was sent.
+ */
+struct os_mbuf *
+ble_hs_test_util_iso_tx_dequeue(void)
+{
+    struct os_mbuf_pkthdr *omp;
+
+    omp = STAILQ_FIRST(&ble_hs_test_util_iso_tx_queue);
+    if (omp == NULL) {
+        return NULL;
+    }
+    STAILQ_REMOVE_HEAD(&ble_hs_test_util_iso_tx_queue, omp_next);
+
+    return OS_MBUF_PKTHDR_TO_MBUF(omp);
+}
+
+int
+ble_hs_test_util_iso_tx_queue_sz(void)
+{
+    struct os_mbuf_pkthdr *omp;
+    int cnt;
+
+    cnt = 0;
+    STAILQ_FOREACH(omp, &ble_hs_test_util_iso_tx_queue, omp_next) {
+        cnt++;
+    }
+
+    return cnt;
+}
+
+void
+ble_hs_test_util_iso_tx_queue_clear(void)
+{
+    struct os_mbuf *om;
+
+    while ((om = ble_hs_test_util_iso_tx_dequeue()) != NULL) {
+        os_mbuf_free_chain(om);
+    }
+}
+#endif
+
 int
 ble_hs_test_util_num_cccds(void)
 {
@@ -1999,6 +2076,9 @@ ble_hs_test_util_init_no_sysinit_no_start(void)
 {
     STAILQ_INIT(&ble_hs_test_util_prev_tx_queue);
     ble_hs_test_util_prev_tx_cur = NULL;
+#if MYNEWT_VAL(BLE_ISO)
+    STAILQ_INIT(&ble_hs_test_util_iso_tx_queue);
+#endif
 
     ble_hs_hci_set_phony_ack_cb(NULL);
 
@@ -99,6 +99,9 @@ struct os_mbuf *ble_hs_test_util_prev_tx_dequeue(void);
 struct os_mbuf *ble_hs_test_util_prev_tx_dequeue_pullup(void);
 int ble_hs_test_util_prev_tx_queue_sz(void);
 void ble_hs_test_util_prev_tx_queue_clear(void);
+struct os_mbuf *ble_hs_test_util_iso_tx_dequeue(void);
+int ble_hs_test_util_iso_tx_queue_sz(void);
+void ble_hs_test_util_iso_tx_queue_clear(void);
 
 void ble_hs_test_util_create_rpa_conn(uint16_t handle, uint8_t own_addr_type,
                                       const uint8_t *our_rpa,
@@ -286,6 +289,7 @@ int ble_hs_test_util_gatt_write_long_flat(uint16_t conn_handle,
                                           uint16_t attr_handle,
                                           const void *data, uint16_t data_len,
                                           ble_gatt_attr_fn *cb, void *cb_arg);
+int32_t ble_hs_test_util_gattc_timer(void);
 struct os_mbuf *ble_hs_test_util_mbuf_alloc_all_but(int count);
 int ble_hs_test_util_mbuf_count(
     const struct ble_hs_test_util_mbuf_params *params);
@@ -290,6 +290,17 @@ static const struct ble_hs_test_util_hci_ack hci_startup_seq[] = {
         .evt_params = { 0x14, 0x00, 200 },
         .evt_params_len = 3,
     },
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_BUF_SIZE_V2),
+        /* Few small ISO buffers to test fragmentation and flow control. */
+        .evt_params = { 0x14, 0x00, 200,
+                        BLE_HS_TEST_UTIL_ISO_BUF_LEN, 0x00,
+                        BLE_HS_TEST_UTIL_ISO_BUF_CNT },
+        .evt_params_len = 6,
+    },
+#endif
     {
         .opcode = ble_hs_hci_util_opcode_join(
             BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT),
@@ -381,11 +392,11 @@ ble_hs_test_util_hci_ack_set_disc(uint8_t own_addr_type,
                 ble_hs_test_util_hci_misc_exp_status(0, fail_idx, fail_status),
             },
             {
-                BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_SCAN_PARAMS),
+                BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HS_TEST_UTIL_OCF_SCAN_PARAMS),
                 ble_hs_test_util_hci_misc_exp_status(1, fail_idx, fail_status),
             },
             {
-                BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_SCAN_ENABLE),
+                BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HS_TEST_UTIL_OCF_SCAN_ENABLE),
                 ble_hs_test_util_hci_misc_exp_status(2, fail_idx, fail_status),
             },
 
@@ -394,11 +405,11 @@ ble_hs_test_util_hci_ack_set_disc(uint8_t own_addr_type,
     } else {
         ble_hs_test_util_hci_ack_set_seq(((struct ble_hs_test_util_hci_ack[]) {
             {
-                BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_SCAN_PARAMS),
+                BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HS_TEST_UTIL_OCF_SCAN_PARAMS),
                 ble_hs_test_util_hci_misc_exp_status(0, fail_idx, fail_status),
             },
             {
-                BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_SCAN_ENABLE),
+                BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HS_TEST_UTIL_OCF_SCAN_ENABLE),
                 ble_hs_test_util_hci_misc_exp_status(1, fail_idx, fail_status),
             },
 
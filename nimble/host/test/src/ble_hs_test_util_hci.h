@@ -27,7 +27,21 @@ extern "C" {
 /* leave this as macro so it may be used for static const initialization */
 #define ble_hs_hci_util_opcode_join(ogf, ocf) (((ogf) << 10) | (ocf))
 
+/* Commands the host uses to configure and enable scanning */
+#if MYNEWT_VAL(BLE_EXT_ADV)
+#define BLE_HS_TEST_UTIL_OCF_SCAN_PARAMS    BLE_HCI_OCF_LE_SET_EXT_SCAN_PARAM
+#define BLE_HS_TEST_UTIL_OCF_SCAN_ENABLE    BLE_HCI_OCF_LE_SET_EXT_SCAN_ENABLE
+#else
+#define BLE_HS_TEST_UTIL_OCF_SCAN_PARAMS    BLE_HCI_OCF_LE_SET_SCAN_PARAMS
+#define BLE_HS_TEST_UTIL_OCF_SCAN_ENABLE    BLE_HCI_OCF_LE_SET_SCAN_ENABLE
+#endif
+
 #define BLE_HS_TEST_UTIL_PHONY_ACK_MAX  64
+
+/* Controller ISO data buffers reported at startup */
+#define BLE_HS_TEST_UTIL_ISO_BUF_LEN    20
+#define BLE_HS_TEST_UTIL_ISO_BUF_CNT    2
+
 struct ble_hs_test_util_hci_ack {
     uint16_t opcode;
     uint8_t status;
@@ -0,0 +1,370 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "testutil/testutil.h"
+#include "nimble/hci_common.h"
+#include "host/ble_iso.h"
+#include "ble_hs_test.h"
+#include "ble_hs_test_util.h"
+#include "../src/ble_iso_priv.h"
+
+#if MYNEWT_VAL(BLE_ISO_BROADCAST_SOURCE)
+
+#define BLE_ISO_TEST_MAX_EVENTS     8
+
+static struct ble_iso_event ble_iso_test_events[BLE_ISO_TEST_MAX_EVENTS];
+static int ble_iso_test_num_events;
+
+static int
+ble_iso_test_util_cb(struct ble_iso_event *event, void *arg)
+{
+    /* Only transmit completions are of interest */
+    if (event->type != BLE_ISO_EVENT_ISO_TX_COMPLETE) {
+        return 0;
+    }
+
+    TEST_ASSERT_FATAL(ble_iso_test_num_events < BLE_ISO_TEST_MAX_EVENTS);
+    ble_iso_test_events[ble_iso_test_num_events++] = *event;
+
+    return 0;
+}
+
+static uint8_t
+ble_iso_test_util_create_big(const uint16_t *conn_handles, uint8_t num_bis)
+{
+    struct ble_iso_create_big_params create_params = {
+        .adv_handle = 0,
+        .bis_cnt = num_bis,
+        .cb = ble_iso_test_util_cb,
+    };
+    struct ble_iso_big_params big_params = {
+        .sdu_interval = 10000,
+        .max_sdu = 100,
+        .max_transport_latency = 10,
+        .rtn = 0,
+        .phy = BLE_HCI_LE_PHY_2M,
+    };
+    uint8_t buf[sizeof(struct ble_hci_ev_le_subev_create_big_complete) +
+                MYNEWT_VAL(BLE_ISO_MAX_BISES) * sizeof(uint16_t)];
+    struct ble_hci_ev_le_subev_create_big_complete *ev;
+    uint8_t big_handle;
+    int rc;
+    int i;
+
+    ble_hs_test_util_hci_ack_set(
+        ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_CREATE_BIG),
+        0);
+    rc = ble_iso_create_big(&create_params, &big_params, &big_handle);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    memset(buf, 0, sizeof(buf));
+    ev = (void *)buf;
+    ev->subev_code = BLE_HCI_LE_SUBEV_CREATE_BIG_COMPLETE;
+    ev->big_handle = big_handle;
+    ev->max_pdu = 100;
+    ev->num_bis = num_bis;
+    for (i = 0; i < num_bis; i++) {
+        put_le16(&ev->conn_handle[i], conn_handles[i]);
+    }
+    ble_iso_rx_create_big_complete(ev);
+
+    return big_handle;
+}
+
+static void
+ble_iso_test_util_terminate_big(uint8_t big_handle)
+{
+    struct ble_hci_ev_le_subev_terminate_big_complete ev = {
+        .subev_code = BLE_HCI_LE_SUBEV_TERMINATE_BIG_COMPLETE,
+        .big_handle = big_handle,
+        .reason = BLE_ERR_CONN_TERM_LOCAL,
+    };
+    int rc;
+
+    ble_hs_test_util_hci_ack_set(
+        ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE,
+                                    BLE_HCI_OCF_LE_TERMINATE_BIG),
+        0);
+    rc = ble_iso_terminate_big(big_handle);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_iso_rx_terminate_big_complete(&ev);
+}
+
+static void
+ble_iso_test_util_num_completed(uint16_t conn_handle, uint16_t num_pkts)
+{
+    ble_iso_test_num_events = 0;
+    ble_hs_test_util_hci_rx_num_completed_pkts_event(
+        (struct ble_hs_test_util_hci_num_completed_pkts_entry[]) {
+            { conn_handle, num_pkts },
+            { 0 }
+        });
+}
+
+/**
+ * Verifies the next HCI ISO Data packet sent by the host.
+ *
+ * @param ts                    Expected timestamp of a first packet; NULL if
+ *                                  it carries none.
+ * @param seq_num               Expected sequence number of a first packet.
+ * @param sdu_len               Expected SDU length of a first packet.
+ * @param data                  Expected SDU data in the packet.
+ */
+static void
+ble_iso_test_util_verify_tx(uint16_t conn_handle, uint8_t pb,
+                            const uint32_t *ts, uint16_t seq_num,
+                            uint16_t sdu_len, const uint8_t *data,
+                            uint16_t data_len)
+{
+    uint8_t buf[BLE_HS_TEST_UTIL_ISO_BUF_LEN + sizeof(struct ble_hci_iso)];
+    struct os_mbuf *om;
+    uint16_t handle;
+    uint16_t off;
+    int rc;
+
+    om = ble_hs_test_util_iso_tx_dequeue();
+    TEST_ASSERT_FATAL(om != NULL);
+    TEST_ASSERT_FATAL(OS_MBUF_PKTLEN(om) <= sizeof(buf));
+
+    rc = os_mbuf_copydata(om, 0, OS_MBUF_PKTLEN(om), buf);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    handle = get_le16(buf);
+    TEST_ASSERT(BLE_HCI_ISO_CONN_HANDLE(handle) == conn_handle);
+    TEST_ASSERT(BLE_HCI_ISO_PB_FLAG(handle) == pb);
+    TEST_ASSERT(BLE_HCI_ISO_TS_FLAG(handle) == (ts != NULL));
+    TEST_ASSERT(BLE_HCI_ISO_LENGTH(get_le16(buf + 2)) ==
+                OS_MBUF_PKTLEN(om) - sizeof(struct ble_hci_iso));
+    off = sizeof(struct ble_hci_iso);
+
+    if (pb == BLE_HCI_ISO_PB_FIRST || pb == BLE_HCI_ISO_PB_COMPLETE) {
+        if (ts != NULL) {
+            TEST_ASSERT(get_le32(buf + off) == *ts);
+            off += sizeof(*ts);
+        }
+
+        TEST_ASSERT(get_le16(buf + off) == seq_num);
+        TEST_ASSERT(BLE_HCI_ISO_SDU_LENGTH(get_le16(buf + off + 2)) ==
+                    sdu_len);
+        off += sizeof(struct ble_hci_iso_data);
+    }
+
+    TEST_ASSERT_FATAL(OS_MBUF_PKTLEN(om) == off + data_len);
+    TEST_ASSERT(memcmp(buf + off, data, data_len) == 0);
+
+    os_mbuf_free_chain(om);
+}
+
+/* Builds an SDU of three mbufs of the given lengths */
+static struct os_mbuf *
+ble_iso_test_util_sdu(const uint8_t *data, uint16_t len1, uint16_t len2,
+                      uint16_t len3)
+{
+    const uint16_t lens[] = { len2, len3 };
+    struct os_mbuf *frag;
+    struct os_mbuf *om;
+    int rc;
+    int i;
+
+    om = ble_hs_mbuf_iso_pkt();
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = os_mbuf_append(om, data, len1);
+    TEST_ASSERT_FATAL(rc == 0);
+    data += len1;
+
+    for (i = 0; i < 2; i++) {
+        frag = os_msys_get(0, 0);
+        TEST_ASSERT_FATAL(frag != NULL);
+        memcpy(frag->om_data, data, lens[i]);
+        frag->om_len = lens[i];
+        os_mbuf_concat(om, frag);
+        data += lens[i];
+    }
+
+    TEST_ASSERT_FATAL(OS_MBUF_PKTLEN(om) == len1 + len2 + len3);
+
+    return om;
+}
+
+TEST_CASE_SELF(ble_iso_test_case_tx_frag)
+{
+    static const uint16_t conn_handle = 0x0020;
+    struct ble_iso_tx_data_info info = {
+        .ts = 0x11223344,
+        .seq_num = 7,
+        .ts_valid = 1,
+    };
+    uint8_t data[50];
+    struct os_mbuf *om;
+    uint8_t big_handle;
+    int rc;
+    int i;
+
+    ble_hs_test_util_init();
+
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+
+    big_handle = ble_iso_test_util_create_big(&conn_handle, 1);
+
+    /*** Unknown BIS; the SDU is freed. */
+    om = ble_iso_test_util_sdu(data, 10, 10, 10);
+    rc = ble_iso_tx_mbuf(conn_handle + 1, om, &info);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    /*** Timestamped SDU of three packets: the first packet boundary falls
+     *   between mbufs, the second one within an mbuf.
+     */
+    om = ble_iso_test_util_sdu(data, 12, 25, 13);
+    rc = ble_iso_tx_mbuf(conn_handle, om, &info);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* Only as many packets as the Controller has buffers for are sent */
+    TEST_ASSERT_FATAL(ble_hs_test_util_iso_tx_queue_sz() ==
+                      BLE_HS_TEST_UTIL_ISO_BUF_CNT);
+    ble_iso_test_util_verify_tx(conn_handle, BLE_HCI_ISO_PB_FIRST, &info.ts,
+                                7, sizeof(data), data, 12);
+    ble_iso_test_util_verify_tx(conn_handle, BLE_HCI_ISO_PB_CONTINUATION,
+                                NULL, 0, 0, data + 12, 20);
+
+    /*** Completion sends the queued packet and is reported. */
+    ble_iso_test_util_num_completed(conn_handle, 1);
+    TEST_ASSERT_FATAL(ble_iso_test_num_events == 1);
+    TEST_ASSERT(ble_iso_test_events[0].iso_tx_complete.conn_handle ==
+                conn_handle);
+    TEST_ASSERT(ble_iso_test_events[0].iso_tx_complete.num_pkts == 1);
+    TEST_ASSERT(ble_iso_test_events[0].iso_tx_complete.pending_pkts == 2);
+
+    ble_iso_test_util_verify_tx(conn_handle, BLE_HCI_ISO_PB_LAST, NULL, 0, 0,
+                                data + 32, 18);
+    TEST_ASSERT(ble_hs_test_util_iso_tx_queue_sz() == 0);
+
+    /*** Short SDU without timestamp; the sequence number follows. */
+    ble_iso_test_util_num_completed(conn_handle, 2);
+    TEST_ASSERT_FATAL(ble_iso_test_num_events == 1);
+    TEST_ASSERT(ble_iso_test_events[0].iso_tx_complete.pending_pkts == 0);
+
+    rc = ble_iso_tx(conn_handle, data, 16);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_iso_test_util_verify_tx(conn_handle, BLE_HCI_ISO_PB_COMPLETE, NULL,
+                                8, 16, data, 16);
+
+    /*** Too long for an SDU. */
+    om = ble_hs_mbuf_iso_pkt();
+    TEST_ASSERT_FATAL(om != NULL);
+    OS_MBUF_PKTHDR(om)->omp_len = BLE_HCI_ISO_SDU_LENGTH_MASK + 1;
+    rc = ble_iso_tx_mbuf(conn_handle, om, NULL);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    ble_iso_test_util_num_completed(conn_handle, 1);
+    ble_iso_test_util_terminate_big(big_handle);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_CASE_SELF(ble_iso_test_case_tx_flow_ctrl)
+{
+    static const uint16_t conn_handles[] = { 0x0020, 0x0021 };
+    uint8_t data[BLE_HS_TEST_UTIL_ISO_BUF_LEN];
+    uint8_t big_handle;
+    int rc;
+    int i;
+
+    ble_hs_test_util_init();
+
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+
+    big_handle = ble_iso_test_util_create_big(conn_handles, 2);
+
+    /*** Packets of both BISes wait for free buffers. */
+    for (i = 0; i < 3; i++) {
+        rc = ble_iso_tx(conn_handles[0], data, 16);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    for (i = 0; i < 2; i++) {
+        rc = ble_iso_tx(conn_handles[1], data + 1, 16);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    TEST_ASSERT_FATAL(ble_hs_test_util_iso_tx_queue_sz() == 2);
+    ble_iso_test_util_verify_tx(conn_handles[0], BLE_HCI_ISO_PB_COMPLETE,
+                                NULL, 0, 16, data, 16);
+    ble_iso_test_util_verify_tx(conn_handles[0], BLE_HCI_ISO_PB_COMPLETE,
+                                NULL, 1, 16, data, 16);
+
+    /*** Freed buffers are shared round-robin. */
+    ble_iso_test_util_num_completed(conn_handles[0], 2);
+    TEST_ASSERT_FATAL(ble_iso_test_num_events == 1);
+    TEST_ASSERT(ble_iso_test_events[0].iso_tx_complete.num_pkts == 2);
+    TEST_ASSERT(ble_iso_test_events[0].iso_tx_complete.pending_pkts == 1);
+
+    TEST_ASSERT_FATAL(ble_hs_test_util_iso_tx_queue_sz() == 2);
+    ble_iso_test_util_verify_tx(conn_handles[0], BLE_HCI_ISO_PB_COMPLETE,
+                                NULL, 2, 16, data, 16);
+    ble_iso_test_util_verify_tx(conn_handles[1], BLE_HCI_ISO_PB_COMPLETE,
+                                NULL, 0, 16, data + 1, 16);
+
+    /*** More completions than outstanding packets are clamped. */
+    ble_iso_test_util_num_completed(conn_handles[0], 5);
+    TEST_ASSERT_FATAL(ble_iso_test_num_events == 1);
+    TEST_ASSERT(ble_iso_test_events[0].iso_tx_complete.num_pkts == 1);
+    TEST_ASSERT(ble_iso_test_events[0].iso_tx_complete.pending_pkts == 0);
+
+    /* Only the buffer actually freed is used */
+    TEST_ASSERT_FATAL(ble_hs_test_util_iso_tx_queue_sz() == 1);
+    ble_iso_test_util_verify_tx(conn_handles[1], BLE_HCI_ISO_PB_COMPLETE,
+                                NULL, 1, 16, data + 1, 16);
+
+    rc = ble_iso_tx(conn_handles[0], data, 16);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_hs_test_util_iso_tx_queue_sz() == 0);
+
+    /* Nothing outstanding; not reported */
+    ble_iso_test_util_num_completed(conn_handles[0], 1);
+    TEST_ASSERT(ble_iso_test_num_events == 0);
+
+    /*** Terminating the BIG frees queued packets and their buffers. */
+    ble_iso_test_util_terminate_big(big_handle);
+
+    big_handle = ble_iso_test_util_create_big(conn_handles, 1);
+    rc = ble_iso_tx(conn_handles[0], data, 16);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_iso_tx(conn_handles[0], data, 16);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_hs_test_util_iso_tx_queue_sz() ==
+                BLE_HS_TEST_UTIL_ISO_BUF_CNT);
+    ble_hs_test_util_iso_tx_queue_clear();
+
+    ble_iso_test_util_terminate_big(big_handle);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_SUITE(ble_iso_test_suite_tx)
+{
+    ble_iso_test_case_tx_frag();
+    ble_iso_test_case_tx_flow_ctrl();
+}
+
+#endif
@@ -32,6 +32,13 @@
 /* We use same pool for incoming and outgoing sdu */
 #define BLE_L2CAP_TEST_COC_BUF_COUNT         (6 * MYNEWT_VAL(BLE_L2CAP_COC_MAX_NUM))
 
+/* Peer MPS used by the connect helpers */
+#define BLE_L2CAP_TEST_COC_PEER_MPS          (MYNEWT_VAL(BLE_L2CAP_COC_MPS) + 16)
+#define BLE_L2CAP_TEST_COC_SEG_COUNT         (4)
+#define BLE_L2CAP_TEST_COC_SEG_BLOCK_SZ      (BLE_L2CAP_TEST_COC_PEER_MPS + \
+                                              sizeof(struct os_mbuf) + \
+                                              sizeof(struct os_mbuf_pkthdr))
+
 static uint16_t ble_l2cap_test_update_conn_handle;
 static int ble_l2cap_test_update_status;
 static void *ble_l2cap_test_update_arg;
@@ -1103,7 +1110,7 @@ ble_l2cap_test_coc_send_data(struct test_data *t)
     assert(sdu_copy != NULL);
     put_le16(sdu_copy->om_data, ev->data_len);
 
-    ble_hs_test_util_verify_tx_l2cap(sdu);
+    ble_hs_test_util_verify_tx_l2cap(sdu_copy);
 
     rc = os_mbuf_free_chain(sdu_copy);
     TEST_ASSERT_FATAL(rc == 0);
@@ -1478,6 +1485,202 @@ TEST_CASE_SELF(ble_l2cap_test_case_coc_send_data_failed_too_big_sdu)
     ble_hs_test_util_assert_mbufs_freed(NULL);
 }
 
+/**
+ * Sends an SDU made of mbufs holding exactly one K-frame of data each and
+ * verifies that every mbuf is transmitted as is: no data is copied and
+ * only the K-frame headers are allocated.
+ */
+TEST_CASE_SELF(ble_l2cap_test_case_coc_send_data_zero_copy)
+{
+    static os_membuf_t seg_mem[OS_MEMPOOL_SIZE(
+        BLE_L2CAP_TEST_COC_SEG_COUNT, BLE_L2CAP_TEST_COC_SEG_BLOCK_SZ)];
+    static uint8_t data[BLE_L2CAP_TEST_COC_SEG_COUNT *
+                        BLE_L2CAP_TEST_COC_PEER_MPS - sizeof(uint16_t)];
+    static struct os_mempool seg_mempool;
+    static struct os_mbuf_pool seg_mbuf_pool;
+    struct os_mbuf *segs[BLE_L2CAP_TEST_COC_SEG_COUNT];
+    struct ble_l2cap_sig_le_credits credits;
+    struct test_data t;
+    struct os_mbuf *sdu;
+    struct os_mbuf *om;
+    uint16_t sdu_len;
+    uint16_t mps;
+    uint32_t off;
+    int msys_free;
+    int len;
+    int rc;
+    int i;
+
+    for (i = 0; i < sizeof data; i++) {
+        data[i] = i;
+    }
+
+    ble_l2cap_test_set_chan_test_conf(BLE_L2CAP_TEST_PSM, 4096, &t);
+    t.expected_num_of_ev = 2;
+
+    t.event[0].type = BLE_L2CAP_TEST_EVENT_COC_CONNECT;
+    t.event[1].type = BLE_L2CAP_TEST_EVENT_COC_DISCONNECT;
+
+    ble_l2cap_test_coc_connect(&t);
+
+    mps = t.chan[0]->peer_coc_mps;
+    TEST_ASSERT_FATAL(mps == BLE_L2CAP_TEST_COC_PEER_MPS);
+
+    /* Send each K-frame in a single ACL packet */
+    rc = ble_hs_hci_set_buf_sz(mps + BLE_L2CAP_HDR_SZ, 0xffff);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = os_mempool_init(&seg_mempool, BLE_L2CAP_TEST_COC_SEG_COUNT,
+                         BLE_L2CAP_TEST_COC_SEG_BLOCK_SZ, seg_mem,
+                         "test_coc_seg_pool");
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = os_mbuf_pool_init(&seg_mbuf_pool, &seg_mempool,
+                           BLE_L2CAP_TEST_COC_SEG_BLOCK_SZ,
+                           BLE_L2CAP_TEST_COC_SEG_COUNT);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* The first K-frame also carries the SDU length. */
+    sdu = os_mbuf_get_pkthdr(&seg_mbuf_pool, 0);
+    TEST_ASSERT_FATAL(sdu != NULL);
+    rc = os_mbuf_append(sdu, data, mps - sizeof sdu_len);
+    TEST_ASSERT_FATAL(rc == 0);
+    segs[0] = sdu;
+    off = mps - sizeof sdu_len;
+
+    for (i = 1; i < BLE_L2CAP_TEST_COC_SEG_COUNT; i++) {
+        om = os_mbuf_get(&seg_mbuf_pool, 0);
+        TEST_ASSERT_FATAL(om != NULL);
+
+        len = min(mps, sizeof data - off);
+        TEST_ASSERT_FATAL(OS_MBUF_TRAILINGSPACE(om) >= len);
+        memcpy(om->om_data, data + off, len);
+        om->om_len = len;
+        off += len;
+
+        os_mbuf_concat(sdu, om);
+        segs[i] = om;
+    }
+
+    credits.scid = htole16(t.chan[0]->dcid);
+    credits.credits = htole16(BLE_L2CAP_TEST_COC_SEG_COUNT);
+    rc = ble_hs_test_util_inject_rx_l2cap_sig(
+        2, BLE_L2CAP_SIG_OP_FLOW_CTRL_CREDIT, 1, &credits, sizeof credits);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    msys_free = os_msys_num_free();
+
+    rc = ble_l2cap_send(t.chan[0], sdu);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* One header mbuf per K-frame, SDU mbufs are neither copied nor freed */
+    TEST_ASSERT(os_msys_num_free() ==
+                msys_free - BLE_L2CAP_TEST_COC_SEG_COUNT);
+    TEST_ASSERT(seg_mempool.mp_num_free == 0);
+
+    off = 0;
+    for (i = 0; i < BLE_L2CAP_TEST_COC_SEG_COUNT; i++) {
+        om = ble_hs_test_util_prev_tx_dequeue();
+        TEST_ASSERT_FATAL(om != NULL);
+
+        if (i == 0) {
+            rc = os_mbuf_copydata(om, 0, sizeof sdu_len, &sdu_len);
+            TEST_ASSERT_FATAL(rc == 0);
+            TEST_ASSERT(le16toh(sdu_len) == sizeof data);
+            os_mbuf_adj(om, sizeof sdu_len);
+        }
+
+        /* The K-frame header is followed by the SDU mbuf itself. */
+        TEST_ASSERT(OS_MBUF_PKTLEN(om) == segs[i]->om_len);
+        TEST_ASSERT(SLIST_NEXT(om, om_next) == segs[i]);
+        TEST_ASSERT(SLIST_NEXT(segs[i], om_next) == NULL);
+        TEST_ASSERT(memcmp(segs[i]->om_data, data + off,
+                           segs[i]->om_len) == 0);
+        off += segs[i]->om_len;
+    }
+    TEST_ASSERT(off == sizeof data);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+
+    ble_l2cap_test_coc_disc(&t);
+
+    TEST_ASSERT(t.expected_num_of_ev == t.event_cnt);
+
+    TEST_ASSERT(seg_mempool.mp_num_free == BLE_L2CAP_TEST_COC_SEG_COUNT);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_CASE_SELF(ble_l2cap_test_case_coc_send_data_stall_time)
+{
+    static uint8_t frame[MYNEWT_VAL(BLE_L2CAP_COC_MPS) + 16];
+    struct ble_l2cap_sig_le_credits credits;
+    struct ble_l2cap_chan_info info;
+    struct test_data t;
+    struct os_mbuf *sdu;
+    uint32_t stall_ms;
+    int32_t ticks;
+    int rc;
+    int i;
+
+    ble_l2cap_test_set_chan_test_conf(BLE_L2CAP_TEST_PSM, 4096, &t);
+    t.expected_num_of_ev = 3;
+
+    t.event[0].type = BLE_L2CAP_TEST_EVENT_COC_CONNECT;
+    t.event[1].type = BLE_L2CAP_EVENT_COC_TX_UNSTALLED;
+    t.event[2].type = BLE_L2CAP_TEST_EVENT_COC_DISCONNECT;
+
+    ble_l2cap_test_coc_connect(&t);
+    TEST_ASSERT_FATAL(t.chan[0]->peer_coc_mps == sizeof frame);
+
+    /* Send each K-frame in a single ACL packet */
+    rc = ble_hs_hci_set_buf_sz(sizeof frame + BLE_L2CAP_HDR_SZ, 0xffff);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* Peer granted 10 credits; the SDU length field makes this SDU need
+     * one K-frame more than that.
+     */
+    sdu = os_msys_get_pkthdr(0, 0);
+    TEST_ASSERT_FATAL(sdu != NULL);
+    for (i = 0; i < 10; i++) {
+        rc = os_mbuf_append(sdu, frame, sizeof frame);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    rc = ble_l2cap_send(t.chan[0], sdu);
+    TEST_ASSERT(rc == BLE_HS_ESTALLED);
+
+    ticks = ble_npl_time_ms_to_ticks32(500);
+    os_time_advance(ticks);
+    stall_ms = ble_npl_time_ticks_to_ms32(ticks);
+
+    rc = ble_l2cap_get_chan_info(t.chan[0], &info);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(info.tx_stall_ms == stall_ms);
+
+    credits.scid = htole16(t.chan[0]->dcid);
+    credits.credits = htole16(1);
+    rc = ble_hs_test_util_inject_rx_l2cap_sig(
+        2, BLE_L2CAP_SIG_OP_FLOW_CTRL_CREDIT, 1, &credits, sizeof credits);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(t.event[1].handled);
+    t.event_iter++;
+
+    /* No longer stalled, the counter must not move. */
+    os_time_advance(ticks);
+    rc = ble_l2cap_get_chan_info(t.chan[0], &info);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(info.tx_stall_ms == stall_ms);
+
+    while (ble_hs_test_util_prev_tx_dequeue() != NULL) {
+    }
+
+    ble_l2cap_test_coc_disc(&t);
+
+    TEST_ASSERT(t.expected_num_of_ev == t.event_cnt);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
 TEST_CASE_SELF(ble_l2cap_test_case_coc_recv_data_succeed)
 {
     struct test_data t = {};
@@ -1504,6 +1707,185 @@ TEST_CASE_SELF(ble_l2cap_test_case_coc_recv_data_succeed)
     ble_hs_test_util_assert_mbufs_freed(NULL);
 }
 
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+/* Peer sends one K-frame carrying a single byte of an SDU of sdu_len bytes;
+ * the first K-frame of the SDU also carries the SDU length.
+ */
+static void
+ble_l2cap_test_util_rx_kframe(struct test_data *t, int first, uint16_t sdu_len)
+{
+    struct os_mbuf *om;
+    uint8_t buf[3];
+    int rc;
+
+    om = os_mbuf_get_pkthdr(&sdu_os_mbuf_pool, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+
+    put_le16(buf, sdu_len);
+    buf[2] = 0xaa;
+
+    if (first) {
+        rc = os_mbuf_append(om, buf, sizeof(buf));
+    } else {
+        rc = os_mbuf_append(om, buf + 2, 1);
+    }
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_inject_rx_l2cap(2, t->chan[0]->scid, om);
+}
+
+static void
+ble_l2cap_test_util_verify_tx_credits(struct test_data *t, uint16_t credits)
+{
+    struct ble_l2cap_sig_le_credits req;
+
+    req.scid = htole16(t->chan[0]->scid);
+    req.credits = htole16(credits);
+
+    ble_hs_test_util_verify_tx_l2cap_sig(BLE_L2CAP_SIG_OP_FLOW_CTRL_CREDIT,
+                                         &req, sizeof(req));
+}
+
+static uint16_t
+ble_l2cap_test_util_rx_window(struct test_data *t)
+{
+    struct ble_l2cap_chan_info info;
+    int rc;
+
+    rc = ble_l2cap_get_chan_info(t->chan[0], &info);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    return info.rx_credit_window;
+}
+
+TEST_CASE_SELF(ble_l2cap_test_case_coc_recv_credits_batch)
+{
+    struct test_data t;
+    uint16_t window;
+    int i;
+
+    ble_l2cap_test_util_init();
+
+    /* SDU spans several K-frames, so the SDU buffer backs a full window */
+    ble_l2cap_test_set_chan_test_conf(BLE_L2CAP_TEST_PSM,
+                                      4 * MYNEWT_VAL(BLE_L2CAP_COC_MPS), &t);
+    t.expected_num_of_ev = 2;
+
+    t.event[0].type = BLE_L2CAP_EVENT_COC_CONNECTED;
+    t.event[1].type = BLE_L2CAP_EVENT_COC_DISCONNECTED;
+
+    ble_l2cap_test_coc_connect(&t);
+    TEST_ASSERT_FATAL(t.chan[0]->initial_credits == 4);
+
+    /* Nothing measured yet */
+    window = ble_l2cap_test_util_rx_window(&t);
+    TEST_ASSERT(window == t.chan[0]->initial_credits);
+
+    os_time_advance(1);
+
+    /* Credits go back once the peer used up half of the window, and only
+     * as many as it takes to fill the window again.
+     */
+    for (i = 0; i < 8; i++) {
+        ble_l2cap_test_util_rx_kframe(&t, i == 0, t.mtu);
+        os_time_advance(1);
+
+        if (i % 2 == 1) {
+            ble_l2cap_test_util_verify_tx_credits(&t, window / 2);
+        }
+        TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+    }
+
+    /* Peer never ran out of credits, so no round trip was measured */
+    TEST_ASSERT(ble_l2cap_test_util_rx_window(&t) == window);
+
+    ble_l2cap_test_coc_disc(&t);
+
+    TEST_ASSERT(t.expected_num_of_ev == t.event_cnt);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_CASE_SELF(ble_l2cap_test_case_coc_recv_credits_window)
+{
+    struct os_mbuf *held[MYNEWT_VAL(MSYS_1_BLOCK_COUNT)];
+    struct test_data t;
+    uint16_t window;
+    int num_held;
+    int num_free;
+    int i;
+
+    ble_l2cap_test_util_init();
+
+    ble_l2cap_test_set_chan_test_conf(BLE_L2CAP_TEST_PSM,
+                                      4 * MYNEWT_VAL(BLE_L2CAP_COC_MPS), &t);
+    t.expected_num_of_ev = 2;
+
+    t.event[0].type = BLE_L2CAP_EVENT_COC_CONNECTED;
+    t.event[1].type = BLE_L2CAP_EVENT_COC_DISCONNECTED;
+
+    ble_l2cap_test_coc_connect(&t);
+    TEST_ASSERT_FATAL(t.chan[0]->initial_credits == 4);
+
+    os_time_advance(1);
+
+    /* A short SDU needs a single K-frame worth of buffer, so the peer runs
+     * out of the 4 credits it got on connect and waits for one more.
+     */
+    for (i = 0; i < 4; i++) {
+        ble_l2cap_test_util_rx_kframe(&t, i == 0, 16);
+        os_time_advance(1);
+    }
+    ble_l2cap_test_util_verify_tx_credits(&t, 1);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+    TEST_ASSERT(ble_l2cap_test_util_rx_window(&t) ==
+                t.chan[0]->initial_credits);
+
+    /* Credit arrives 10 ticks later.  K-frames came in 1 tick apart, so the
+     * window is twice the 10 K-frames sent per round trip, plus slack.
+     */
+    os_time_advance(9);
+    ble_l2cap_test_util_rx_kframe(&t, 0, 16);
+    ble_l2cap_test_util_verify_tx_credits(&t, 1);
+    TEST_ASSERT(ble_l2cap_test_util_rx_window(&t) == 2 * (10 + 1));
+
+    /* Long round trip, window is capped */
+    os_time_advance(100);
+    ble_l2cap_test_util_rx_kframe(&t, 0, 16);
+    ble_l2cap_test_util_verify_tx_credits(&t, 1);
+    TEST_ASSERT(ble_l2cap_test_util_rx_window(&t) ==
+                MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_MAX_CREDITS));
+
+    /* K-frames wait in msys; the window leaves half of it free */
+    num_held = 0;
+    while (os_msys_num_free() > 8) {
+        held[num_held] = os_msys_get(0, 0);
+        TEST_ASSERT_FATAL(held[num_held] != NULL);
+        num_held++;
+    }
+    num_free = os_msys_num_free();
+
+    os_time_advance(1);
+    ble_l2cap_test_util_rx_kframe(&t, 0, 16);
+    ble_l2cap_test_util_verify_tx_credits(&t, 1);
+    window = ble_l2cap_test_util_rx_window(&t);
+    TEST_ASSERT(window >= 1);
+    TEST_ASSERT(window <= num_free / 2);
+
+    for (i = 0; i < num_held; i++) {
+        os_mbuf_free_chain(held[i]);
+    }
+
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+
+    ble_l2cap_test_coc_disc(&t);
+
+    TEST_ASSERT(t.expected_num_of_ev == t.event_cnt);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+#endif
+
 TEST_CASE_SELF(ble_l2cap_test_case_sig_coc_conn_multi)
 {
     struct test_data t;
@@ -1559,6 +1941,12 @@ TEST_SUITE(ble_l2cap_test_suite)
     ble_l2cap_test_case_invalid_cid_in_disconnect_req();
     ble_l2cap_test_case_coc_send_data_succeed();
     ble_l2cap_test_case_coc_send_data_failed_too_big_sdu();
+    ble_l2cap_test_case_coc_send_data_zero_copy();
+    ble_l2cap_test_case_coc_send_data_stall_time();
     ble_l2cap_test_case_coc_recv_data_succeed();
+#if MYNEWT_VAL(BLE_L2CAP_COC_ADAPTIVE_CREDITS)
+    ble_l2cap_test_case_coc_recv_credits_batch();
+    ble_l2cap_test_case_coc_recv_credits_window();
+#endif
     ble_l2cap_test_case_sig_coc_conn_multi();
 }
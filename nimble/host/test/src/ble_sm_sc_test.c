@@ -24,6 +24,7 @@
 #include "nimble/hci_common.h"
 #include "nimble/nimble_opt.h"
 #include "host/ble_sm.h"
+#include "tinycrypt/ecc.h"
 #include "ble_hs_test.h"
 #include "ble_hs_test_util.h"
 #include "ble_sm_test_util.h"
@@ -5510,6 +5511,116 @@ TEST_CASE_SELF(ble_sm_sc_us_pk_iio2_rio0_b1_iat2_rat2_ik7_rk3)
     ble_hs_test_util_assert_mbufs_freed(NULL);
 }
 
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+/* Unit tests run without a random number generator; key pairs for the pool
+ * are generated from a fixed sequence.
+ */
+static int
+ble_sm_sc_test_util_rng(uint8_t *dst, unsigned int size)
+{
+    static uint32_t state = 0x2545f491;
+
+    while (size--) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        *dst++ = state;
+    }
+
+    return 1;
+}
+
+static void
+ble_sm_sc_test_util_run_evq(void)
+{
+    struct ble_npl_event *ev;
+
+    while ((ev = ble_npl_eventq_get(ble_hs_evq_get(), 0)) != NULL) {
+        ble_npl_event_run(ev);
+    }
+}
+
+static void
+ble_sm_sc_test_util_pool_pair(struct ble_sm_public_key *out_key)
+{
+    struct ble_hci_ev_disconn_cmp disconn_evt;
+
+    ble_hs_test_util_create_conn(2, ((uint8_t[6]){1,2,3,5,6,7}),
+                                 ble_sm_test_util_conn_cb, NULL);
+
+    ble_sm_test_util_us_sc_public_key(out_key);
+    TEST_ASSERT(ble_sm_num_procs() == 1);
+
+    disconn_evt.conn_handle = htole16(2);
+    disconn_evt.status = 0;
+    disconn_evt.reason = BLE_ERR_REM_USER_CONN_TERM;
+    ble_gap_rx_disconn_complete(&disconn_evt);
+    TEST_ASSERT(ble_sm_num_procs() == 0);
+}
+
+TEST_CASE_SELF(ble_sm_sc_test_case_key_pool)
+{
+    struct ble_sm_public_key keys[MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)];
+    struct ble_sm_public_key static_key;
+    struct ble_sm_public_key key;
+    int i;
+    int j;
+
+    ble_sm_test_util_init();
+    uECC_set_rng(ble_sm_sc_test_util_rng);
+
+    /* The host has already been started; drop the start events queued by
+     * sysinit and leave only the pool being filled.
+     */
+    while (ble_npl_eventq_get(ble_hs_evq_get(), 0) != NULL) {
+    }
+    ble_sm_sc_key_pool_fill();
+
+    /* The static key pair and a full pool are generated in the background. */
+    ble_sm_sc_test_util_run_evq();
+    TEST_ASSERT(ble_sm_sc_key_pool_num() ==
+                MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE));
+
+    /* Each pairing takes a fresh key pair out of the pool. */
+    for (i = 0; i < MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE); i++) {
+        ble_sm_sc_test_util_pool_pair(&keys[i]);
+        TEST_ASSERT(ble_sm_sc_key_pool_num() ==
+                    MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE) - i - 1);
+
+        for (j = 0; j < i; j++) {
+            TEST_ASSERT(memcmp(&keys[i], &keys[j], sizeof keys[i]) != 0);
+        }
+    }
+
+    /* A dry pool falls back to the static key pair; nothing is generated
+     * while the host is locked.
+     */
+    ble_sm_sc_test_util_pool_pair(&static_key);
+    TEST_ASSERT(ble_sm_sc_key_pool_num() == 0);
+    for (i = 0; i < MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE); i++) {
+        TEST_ASSERT(memcmp(&static_key, &keys[i], sizeof keys[i]) != 0);
+    }
+
+    ble_sm_sc_test_util_pool_pair(&key);
+    TEST_ASSERT(ble_sm_sc_key_pool_num() == 0);
+    TEST_ASSERT(memcmp(&key, &static_key, sizeof key) == 0);
+
+    /* The pool is refilled outside of the pairing procedure. */
+    ble_sm_sc_test_util_run_evq();
+    TEST_ASSERT(ble_sm_sc_key_pool_num() ==
+                MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE));
+
+    ble_sm_sc_test_util_pool_pair(&key);
+    TEST_ASSERT(ble_sm_sc_key_pool_num() ==
+                MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE) - 1);
+    TEST_ASSERT(memcmp(&key, &static_key, sizeof key) != 0);
+
+    uECC_set_rng(NULL);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+#endif
+
 TEST_SUITE(ble_sm_sc_test_suite)
 {
     /*** No privacy. */
@@ -5526,6 +5637,10 @@ TEST_SUITE(ble_sm_sc_test_suite)
     ble_sm_sc_us_pk_iio0_rio4_b1_iat0_rat0_ik7_rk5();
     ble_sm_sc_us_nc_iio1_rio4_b1_iat0_rat0_ik7_rk5();
 
+#if MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)
+    ble_sm_sc_test_case_key_pool();
+#endif
+
     /*** Privacy (id = public). */
     // FIXME: needs to be fixed due to fix for address type used
 #if 0
@@ -24,6 +24,8 @@
 #include "nimble/hci_common.h"
 #include "nimble/nimble_opt.h"
 #include "host/ble_sm.h"
+#include "tinycrypt/constants.h"
+#include "tinycrypt/ecc_dh.h"
 #include "ble_hs_test.h"
 #include "ble_hs_test_util.h"
 #include "ble_sm_test_util.h"
@@ -235,6 +237,199 @@ TEST_CASE_SELF(ble_sm_test_case_csis_enc_dec_sirk)
     TEST_ASSERT(memcmp(dec_sirk, plaintext_sirk, 16) == 0);
 }
 
+TEST_CASE_SELF(ble_sm_test_case_rpa_resolve)
+{
+    /* Core Spec 5.3 Vol 3 Part H D.7 ah sample data, little-endian. */
+    uint8_t irk[16] = { 0x9b, 0x7d, 0x39, 0x0a, 0xa6, 0x10, 0x10, 0x34,
+                        0x05, 0xad, 0xc8, 0x57, 0xa3, 0x34, 0x02, 0xec };
+    uint8_t rpa[6] = { 0xaa, 0xfb, 0x0d, 0x94, 0x81, 0x70 };
+    const uint8_t prand[3] = { 0x94, 0x81, 0x70 };
+    const uint8_t exp_hash[3] = { 0xaa, 0xfb, 0x0d };
+    struct ble_sm_alg_key irks[8];
+    uint8_t hash[3];
+    int idx;
+    int rc;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        irk[15] = i == 5 ? 0xec : i;
+        rc = ble_sm_alg_key_init(&irks[i], irk);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    rc = ble_sm_alg_ah(&irks[5], prand, hash);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(hash, exp_hash, 3) == 0);
+
+    idx = -1;
+    rc = ble_sm_alg_rpa_resolve(irks, 8, rpa, &idx);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(idx == 5);
+
+    rc = ble_sm_alg_rpa_resolve(irks, 5, rpa, NULL);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    rpa[0] ^= 0x01;
+    rc = ble_sm_alg_rpa_resolve(irks, 8, rpa, NULL);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+TEST_CASE_SELF(ble_sm_test_case_csis_resolve_rsi)
+{
+    uint8_t sirk[16] = { 0xcd, 0xcc, 0x72, 0xdd, 0x86, 0x8c, 0xcd, 0xce,
+                         0x22, 0xfd, 0xa1, 0x21, 0x09, 0x7d, 0x7d, 0x45 };
+    uint8_t other_sirk[16];
+    uint8_t ltk[16] = { 0xd9, 0xce, 0xe5, 0x3c, 0x22, 0xc6, 0x1e, 0x06,
+                        0x6f, 0x69, 0x48, 0xd4, 0x9b, 0x1b, 0x6e, 0x67 };
+    /* hash || prand, from the sih sample data */
+    uint8_t rsi[6] = { 0xda, 0x48, 0x19, 0x63, 0xf5, 0x69 };
+    struct ble_store_value_sec value_sec;
+    uint8_t enc_sirk[16];
+    int rc;
+
+    ble_hs_test_util_init();
+
+    /*** Plaintext SIRK. */
+    rc = ble_sm_csis_resolve_rsi(rsi, sirk, NULL);
+    TEST_ASSERT(rc == 0);
+
+    memcpy(other_sirk, sirk, 16);
+    other_sirk[15] ^= 0x01;
+    rc = ble_sm_csis_resolve_rsi(rsi, other_sirk, NULL);
+    TEST_ASSERT(rc == BLE_HS_EAUTHEN);
+
+    /* Going back to the first SIRK must not reuse the other one's key. */
+    rc = ble_sm_csis_resolve_rsi(rsi, sirk, NULL);
+    TEST_ASSERT(rc == 0);
+
+    rsi[0] ^= 0x01;
+    rc = ble_sm_csis_resolve_rsi(rsi, sirk, NULL);
+    TEST_ASSERT(rc == BLE_HS_EAUTHEN);
+    rsi[0] ^= 0x01;
+
+    /*** Encrypted SIRK, decrypted with the LTK of the bonded peer. */
+    rc = ble_sm_csis_encrypt_sirk(ltk, sirk, enc_sirk);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    memset(&value_sec, 0, sizeof value_sec);
+    value_sec.peer_addr = (ble_addr_t){ BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    rc = ble_sm_csis_resolve_rsi(rsi, enc_sirk, &value_sec.peer_addr);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    memcpy(value_sec.ltk, ltk, 16);
+    value_sec.ltk_present = 1;
+    rc = ble_store_write_peer_sec(&value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_sm_csis_resolve_rsi(rsi, enc_sirk, &value_sec.peer_addr);
+    TEST_ASSERT(rc == 0);
+
+    rc = ble_sm_csis_resolve_rsi(rsi, sirk, &value_sec.peer_addr);
+    TEST_ASSERT(rc == BLE_HS_EAUTHEN);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+#if MYNEWT_VAL(BLE_SM_SC_P256)
+#define BLE_SM_TEST_P256_KEYS       16
+
+TEST_CASE_SELF(ble_sm_test_case_p256)
+{
+    static const uint8_t gx[32] = {
+        0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47,
+        0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4, 0x40, 0xf2,
+        0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0,
+        0xf4, 0xa1, 0x39, 0x45, 0xd8, 0x98, 0xc2, 0x96,
+    };
+    static const uint8_t gy[32] = {
+        0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b,
+        0x8e, 0xe7, 0xeb, 0x4a, 0x7c, 0x0f, 0x9e, 0x16,
+        0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce,
+        0xcb, 0xb6, 0x40, 0x68, 0x37, 0xbf, 0x51, 0xf5,
+    };
+    static const uint8_t neg_gy[32] = {
+        0xb0, 0x1c, 0xbd, 0x1c, 0x01, 0xe5, 0x80, 0x65,
+        0x71, 0x18, 0x14, 0xb5, 0x83, 0xf0, 0x61, 0xe9,
+        0xd4, 0x31, 0xcc, 0xa9, 0x94, 0xce, 0xa1, 0x31,
+        0x34, 0x49, 0xbf, 0x97, 0xc8, 0x40, 0xae, 0x0a,
+    };
+    uint8_t priv[BLE_SM_TEST_P256_KEYS][32];
+    uint8_t pub[BLE_SM_TEST_P256_KEYS][64];
+    uint8_t ref[64];
+    uint8_t dh1[32];
+    uint8_t dh2[32];
+    int rc;
+    int i;
+    int j;
+
+    /* Private keys are big-endian, as for uECC. */
+    for (i = 0; i < BLE_SM_TEST_P256_KEYS; i++) {
+        for (j = 0; j < 32; j++) {
+            priv[i][j] = (i * 73 + j * 151 + 7) & 0xff;
+        }
+    }
+    /* Smallest and largest valid private keys (1 and n - 1). */
+    memset(priv[0], 0, 32);
+    priv[0][31] = 1;
+    memcpy(priv[1], (uint8_t[32]) {
+        0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84,
+        0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x50,
+    }, 32);
+
+    for (i = 0; i < BLE_SM_TEST_P256_KEYS; i++) {
+        rc = ble_sm_p256_pub_key(priv[i], pub[i]);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    /* uECC cannot compute 1 * G and (n - 1) * G; these are G and -G. */
+    TEST_ASSERT(memcmp(pub[0], gx, 32) == 0);
+    TEST_ASSERT(memcmp(pub[0] + 32, gy, 32) == 0);
+    TEST_ASSERT(memcmp(pub[1], gx, 32) == 0);
+    TEST_ASSERT(memcmp(pub[1] + 32, neg_gy, 32) == 0);
+
+    for (i = 2; i < BLE_SM_TEST_P256_KEYS; i++) {
+        rc = uECC_compute_public_key(priv[i], ref, uECC_secp256r1());
+        TEST_ASSERT_FATAL(rc == 1);
+        TEST_ASSERT(memcmp(pub[i], ref, 64) == 0);
+    }
+
+    for (i = 0; i < BLE_SM_TEST_P256_KEYS; i++) {
+        j = (i + 1) % BLE_SM_TEST_P256_KEYS;
+        rc = ble_sm_p256_ecdh(pub[j], priv[i], dh1);
+        TEST_ASSERT_FATAL(rc == 0);
+        rc = ble_sm_p256_ecdh(pub[i], priv[j], dh2);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(memcmp(dh1, dh2, 32) == 0);
+
+        if (i >= 2 && j >= 2) {
+            rc = uECC_shared_secret(pub[j], priv[i], dh2, uECC_secp256r1());
+            TEST_ASSERT_FATAL(rc == TC_CRYPTO_SUCCESS);
+            TEST_ASSERT(memcmp(dh1, dh2, 32) == 0);
+        }
+    }
+
+    /* Out of range private keys. */
+    memset(priv[2], 0, 32);
+    rc = ble_sm_p256_pub_key(priv[2], ref);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    memset(priv[2], 0xff, 32);
+    rc = ble_sm_p256_pub_key(priv[2], ref);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /* Point not on the curve. */
+    memcpy(ref, pub[3], 64);
+    ref[63] ^= 0x01;
+    rc = ble_sm_p256_ecdh(ref, priv[4], dh1);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+#endif
+
 TEST_CASE_SELF(ble_sm_test_case_conn_broken)
 {
     struct ble_hci_ev_disconn_cmp disconn_evt;
@@ -501,6 +696,11 @@ TEST_SUITE(ble_sm_gen_test_suite)
     ble_sm_test_case_csis_s1_sirkenc();
     ble_sm_test_case_csis_k1_csis();
     ble_sm_test_case_csis_enc_dec_sirk();
+    ble_sm_test_case_rpa_resolve();
+    ble_sm_test_case_csis_resolve_rsi();
+#if MYNEWT_VAL(BLE_SM_SC_P256)
+    ble_sm_test_case_p256();
+#endif
 
     ble_sm_test_case_peer_fail_inval();
     ble_sm_test_case_peer_lgcy_fail_confirm();
@@ -2701,6 +2701,48 @@ ble_sm_test_util_us_sc_bad(struct ble_sm_test_params *params)
     ble_sm_test_util_us_sc_bad_once(params);
 }
 
+/**
+ * Starts Just Works Secure Connections pairing as master on connection 2 and
+ * returns the public key we sent.  Pairing is left waiting for the peer's
+ * public key.
+ */
+void
+ble_sm_test_util_us_sc_public_key(struct ble_sm_public_key *out_cmd)
+{
+    struct ble_sm_pair_cmd rsp = {
+        .io_cap = BLE_HS_IO_NO_INPUT_OUTPUT,
+        .oob_data_flag = 0,
+        .authreq = BLE_SM_PAIR_AUTHREQ_SC,
+        .max_enc_key_size = 16,
+        .init_key_dist = 0,
+        .resp_key_dist = 0,
+    };
+    struct os_mbuf *om;
+    int rc;
+
+    ble_hs_cfg.sm_io_cap = BLE_HS_IO_NO_INPUT_OUTPUT;
+    ble_hs_cfg.sm_oob_data_flag = 0;
+    ble_hs_cfg.sm_bonding = 0;
+    ble_hs_cfg.sm_mitm = 0;
+    ble_hs_cfg.sm_sc = 1;
+    ble_hs_cfg.sm_our_key_dist = 0;
+    ble_hs_cfg.sm_their_key_dist = 0;
+
+    ble_sm_dbg_set_next_pair_rand(((uint8_t[16]){0}));
+
+    rc = ble_gap_security_initiate(2);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_sm_test_util_verify_tx_hdr(BLE_SM_OP_PAIR_REQ,
+                                   sizeof(struct ble_sm_pair_cmd));
+
+    ble_sm_test_util_rx_pair_rsp(2, &rsp, 0);
+
+    om = ble_sm_test_util_verify_tx_hdr(BLE_SM_OP_PAIR_PUBLIC_KEY,
+                                        sizeof(struct ble_sm_public_key));
+    ble_sm_public_key_parse(om->om_data, om->om_len, out_cmd);
+}
+
 static void
 ble_sm_test_util_peer_sc_good_once_no_init(struct ble_sm_test_params *params,
                                            struct ble_hs_conn *conn,
@@ -120,6 +120,7 @@ void ble_sm_test_util_peer_bonding_bad(uint16_t ediv, uint64_t rand_num);
 void ble_sm_test_util_peer_sc_good(struct ble_sm_test_params *params);
 void ble_sm_test_util_us_sc_good(struct ble_sm_test_params *params);
 void ble_sm_test_util_us_sc_bad(struct ble_sm_test_params *params);
+void ble_sm_test_util_us_sc_public_key(struct ble_sm_public_key *out_cmd);
 void ble_sm_test_util_us_fail_inval(struct ble_sm_test_params *params);
 
 #ifdef __cplusplus
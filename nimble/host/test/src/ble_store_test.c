@@ -17,9 +17,16 @@
  * under the License.
  */
 
+#include <inttypes.h>
+#include <stdio.h>
+#include "os/os.h"
+#include "os/os_cputime.h"
 #include "testutil/testutil.h"
 #include "ble_hs_test.h"
 #include "ble_hs_test_util.h"
+#include "config/config.h"
+#include "base64/base64.h"
+#include "store/config/ble_store_config.h"
 
 static struct ble_store_status_event ble_store_test_status_event;
 
@@ -425,6 +432,341 @@ TEST_CASE_SELF(ble_store_test_clear)
     ble_hs_test_util_assert_mbufs_freed(NULL);
 }
 
+/**
+ * Verifies what a single CCCD update costs in persistent storage as the
+ * number of bonds grows.  Each bonded peer subscribes to the same set of
+ * characteristics; one subscription is then toggled repeatedly.  Bytes
+ * written and time spent per ble_store_write_cccd() call, including the
+ * final flush, are printed for each bond count.
+ */
+TEST_CASE_SELF(ble_store_test_persist_cost)
+{
+    struct ble_store_config_persist_stats before;
+    struct ble_store_config_persist_stats after;
+    struct ble_store_value_cccd cccd;
+    struct ble_store_value_sec sec;
+    uint32_t first_bytes;
+    uint32_t max_ticks;
+    uint32_t ticks;
+    uint32_t total;
+    uint32_t start;
+    uint32_t bytes;
+    uint32_t writes;
+    int cccds_per_peer;
+    int num_bonds;
+    int rc;
+    int i;
+    int j;
+
+    cccds_per_peer = MYNEWT_VAL(BLE_STORE_MAX_CCCDS) /
+                     MYNEWT_VAL(BLE_STORE_MAX_BONDS);
+    writes = 32;
+    first_bytes = 0;
+
+    for (num_bonds = 1;
+         num_bonds <= MYNEWT_VAL(BLE_STORE_MAX_BONDS);
+         num_bonds++) {
+
+        ble_hs_test_util_init();
+
+        memset(&sec, 0, sizeof sec);
+        memset(&cccd, 0, sizeof cccd);
+        sec.ltk_present = 1;
+
+        for (i = 0; i < num_bonds; i++) {
+            sec.peer_addr = (ble_addr_t){ BLE_ADDR_PUBLIC,
+                                          { i + 1, 2, 3, 4, 5, 6 } };
+            rc = ble_store_write_peer_sec(&sec);
+            TEST_ASSERT_FATAL(rc == 0);
+
+            cccd.peer_addr = sec.peer_addr;
+            for (j = 0; j < cccds_per_peer; j++) {
+                cccd.chr_val_handle = 3 + 2 * j;
+                cccd.flags = BLE_GATTS_CLT_CFG_F_NOTIFY;
+                rc = ble_store_write_cccd(&cccd);
+                TEST_ASSERT_FATAL(rc == 0);
+            }
+        }
+
+        ble_store_config_flush();
+        ble_store_config_persist_stats(&before);
+
+        cccd.peer_addr = sec.peer_addr;
+        cccd.chr_val_handle = 3;
+        max_ticks = 0;
+        total = 0;
+        for (i = 0; i < writes; i++) {
+            cccd.flags = (i & 1) ? BLE_GATTS_CLT_CFG_F_NOTIFY :
+                                   BLE_GATTS_CLT_CFG_F_INDICATE;
+            start = os_cputime_get32();
+            rc = ble_store_write_cccd(&cccd);
+            ticks = os_cputime_get32() - start;
+            TEST_ASSERT_FATAL(rc == 0);
+
+            total += ticks;
+            if (ticks > max_ticks) {
+                max_ticks = ticks;
+            }
+        }
+
+        /* Deferred writes are paid for here. */
+        start = os_cputime_get32();
+        ble_store_config_flush();
+        total += os_cputime_get32() - start;
+        ble_store_config_persist_stats(&after);
+
+        /* Every update must reach storage, unless it was deferred. */
+        TEST_ASSERT(after.saves - before.saves +
+                    after.coalesced - before.coalesced >= writes);
+        TEST_ASSERT(after.saves - before.saves <= writes);
+
+        bytes = after.bytes - before.bytes;
+        if (num_bonds == 1) {
+            first_bytes = bytes;
+        }
+
+        printf("persist cost: %d bonds, %" PRIu32 " bytes/write, "
+               "%" PRIu32 " us/write, %" PRIu32 " us max\n",
+               num_bonds, bytes / writes,
+               os_cputime_ticks_to_usecs(total) / writes,
+               os_cputime_ticks_to_usecs(max_ticks));
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+        /* Only the changed record is rewritten, whatever else is stored. */
+        TEST_ASSERT(bytes == first_bytes);
+#else
+        /* The whole CCCD array is rewritten. */
+        TEST_ASSERT(bytes >= first_bytes);
+#endif
+    }
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+static void
+ble_store_test_util_load_legacy(const struct ble_store_value_sec *secs,
+                                int num_secs)
+{
+    char val[BASE64_ENCODE_SIZE(sizeof *secs * 2) + 1];
+    char name[] = "ble_hs/peer_sec";
+    int rc;
+
+    base64_encode(secs, sizeof *secs * num_secs, val, 1);
+    rc = conf_set_value(name, val);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+/**
+ * Ensures a deleted setting clears what an earlier setting of the same name
+ * loaded, as happens when storage is replayed at boot.
+ */
+TEST_CASE_SELF(ble_store_test_load_deleted)
+{
+    struct ble_store_value_sec sec;
+    char name[] = "ble_hs/peer_sec";
+    char empty[] = "";
+    int rc;
+
+    ble_hs_test_util_init();
+
+    memset(&sec, 0, sizeof sec);
+    sec.peer_addr = (ble_addr_t){ BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    sec.ltk_present = 1;
+
+    ble_store_test_util_load_legacy(&sec, 1);
+    rc = conf_set_value(name, empty);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = conf_commit(NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_store_test_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC) == 0);
+
+    ble_store_test_util_load_legacy(&sec, 1);
+    rc = conf_set_value(name, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = conf_commit(NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_store_test_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC) == 0);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+static void
+ble_store_test_util_rec_name(char *name, int name_sz, const char *type,
+                             const ble_addr_t *peer_addr,
+                             uint16_t chr_val_handle)
+{
+    const uint8_t *v;
+
+    v = peer_addr->val;
+    if (strcmp(type, "cd") == 0) {
+        snprintf(name, name_sz,
+                 "ble_hs/%s/%02x%02x%02x%02x%02x%02x%02x%04x", type,
+                 peer_addr->type, v[5], v[4], v[3], v[2], v[1], v[0],
+                 chr_val_handle);
+    } else {
+        snprintf(name, name_sz, "ble_hs/%s/%02x%02x%02x%02x%02x%02x%02x",
+                 type, peer_addr->type, v[5], v[4], v[3], v[2], v[1], v[0]);
+    }
+}
+
+static void
+ble_store_test_util_load_rec(const struct ble_store_value_sec *sec)
+{
+    char val[BASE64_ENCODE_SIZE(sizeof *sec) + 1];
+    char name[32];
+    int rc;
+
+    ble_store_test_util_rec_name(name, sizeof name, "ps", &sec->peer_addr, 0);
+
+    base64_encode(sec, sizeof *sec, val, 1);
+    rc = conf_set_value(name, val);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+static void
+ble_store_test_util_load_cccd_rec(const struct ble_store_value_cccd *cccd)
+{
+    char val[BASE64_ENCODE_SIZE(sizeof *cccd) + 1];
+    char name[32];
+    int rc;
+
+    ble_store_test_util_rec_name(name, sizeof name, "cd", &cccd->peer_addr,
+                                 cccd->chr_val_handle);
+
+    base64_encode(cccd, sizeof *cccd, val, 1);
+    rc = conf_set_value(name, val);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+/**
+ * Ensures a record deleted after it was stored does not come back when the
+ * settings are loaded again.
+ */
+TEST_CASE_SELF(ble_store_test_rec_load_deleted)
+{
+    struct ble_store_value_cccd cccd;
+    struct ble_store_value_sec sec;
+    struct ble_store_key_sec key;
+    char name[32];
+    char empty[] = "";
+    int rc;
+
+    ble_hs_test_util_init();
+
+    memset(&sec, 0, sizeof sec);
+    sec.peer_addr = (ble_addr_t){ BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    sec.ltk_present = 1;
+
+    memset(&cccd, 0, sizeof cccd);
+    cccd.peer_addr = sec.peer_addr;
+    cccd.chr_val_handle = 3;
+    cccd.flags = BLE_GATTS_CLT_CFG_F_NOTIFY;
+
+    /* Stored, then deleted. */
+    ble_store_test_util_load_rec(&sec);
+    ble_store_test_util_load_cccd_rec(&cccd);
+    TEST_ASSERT(ble_store_test_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC) == 1);
+    TEST_ASSERT(ble_store_test_util_count(BLE_STORE_OBJ_TYPE_CCCD) == 1);
+
+    ble_store_test_util_rec_name(name, sizeof name, "ps", &sec.peer_addr, 0);
+    rc = conf_set_value(name, empty);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_store_test_util_rec_name(name, sizeof name, "cd", &cccd.peer_addr,
+                                 cccd.chr_val_handle);
+    rc = conf_set_value(name, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = conf_commit(NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_store_test_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC) == 0);
+    TEST_ASSERT(ble_store_test_util_count(BLE_STORE_OBJ_TYPE_CCCD) == 0);
+
+    /* Only the named record is removed. */
+    memset(&key, 0, sizeof key);
+    key.peer_addr = sec.peer_addr;
+    ble_store_test_util_load_rec(&sec);
+    sec.peer_addr.val[0] = 7;
+    ble_store_test_util_load_rec(&sec);
+    ble_store_test_util_rec_name(name, sizeof name, "ps", &sec.peer_addr, 0);
+    rc = conf_set_value(name, empty);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_store_test_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC) == 1);
+
+    rc = ble_store_read_peer_sec(&key, &sec);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+
+/**
+ * Ensures a record is never replaced by an entry with the same key from an
+ * old whole-array setting, whichever of the two is loaded first.
+ */
+TEST_CASE_SELF(ble_store_test_legacy_precedence)
+{
+    struct ble_store_value_sec legacy[2];
+    struct ble_store_value_sec value;
+    struct ble_store_value_sec rec;
+    struct ble_store_key_sec key;
+    int rec_first;
+    int rc;
+
+    memset(&rec, 0, sizeof rec);
+    rec.peer_addr = (ble_addr_t){ BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    rec.ltk_present = 1;
+    memset(rec.ltk, 0x11, sizeof rec.ltk);
+
+    memset(legacy, 0, sizeof legacy);
+    legacy[0] = rec;
+    memset(legacy[0].ltk, 0x22, sizeof legacy[0].ltk);
+    legacy[1] = legacy[0];
+    legacy[1].peer_addr.val[0] = 7;
+
+    for (rec_first = 0; rec_first <= 1; rec_first++) {
+        ble_hs_test_util_init();
+
+        if (rec_first) {
+            ble_store_test_util_load_rec(&rec);
+            ble_store_test_util_load_legacy(legacy, 2);
+        } else {
+            ble_store_test_util_load_legacy(legacy, 2);
+            ble_store_test_util_load_rec(&rec);
+        }
+
+        /* Nothing from the old setting is visible before commit. */
+        TEST_ASSERT(
+            ble_store_test_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC) == 1);
+
+        rc = conf_commit(NULL);
+        TEST_ASSERT_FATAL(rc == 0);
+
+        TEST_ASSERT(
+            ble_store_test_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC) == 2);
+
+        memset(&key, 0, sizeof key);
+        key.peer_addr = rec.peer_addr;
+        rc = ble_store_read_peer_sec(&key, &value);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(memcmp(value.ltk, rec.ltk, sizeof rec.ltk) == 0);
+
+        key.peer_addr = legacy[1].peer_addr;
+        rc = ble_store_read_peer_sec(&key, &value);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(memcmp(value.ltk, legacy[1].ltk,
+                           sizeof legacy[1].ltk) == 0);
+
+        /* The old setting is merged only once. */
+        rc = conf_commit(NULL);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(
+            ble_store_test_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC) == 2);
+    }
+
+    ble_hs_test_util_assert_mbufs_freed(NULL);
+}
+#endif
+
 TEST_SUITE(ble_store_suite)
 {
     ble_store_test_peers();
@@ -432,4 +774,10 @@ TEST_SUITE(ble_store_suite)
     ble_store_test_count();
     ble_store_test_overflow();
     ble_store_test_clear();
+    ble_store_test_persist_cost();
+    ble_store_test_load_deleted();
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PER_RECORD)
+    ble_store_test_legacy_precedence();
+    ble_store_test_rec_load_deleted();
+#endif
 }
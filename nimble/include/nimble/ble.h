@@ -120,6 +120,10 @@ struct ble_mbuf_hdr_txinfo
 
 struct ble_mbuf_hdr_txiso {
     uint16_t packet_seq_num;
+    /* Number of HCI ISO Data packets the SDU was received in */
+    uint8_t num_pkts;
+    /* SDU timestamp (us) */
+    uint32_t timestamp;
 };
 
 struct ble_mbuf_hdr
@@ -1214,6 +1214,20 @@ struct ble_hci_vs_set_local_irk_cp {
     uint8_t irk[16];
 } __attribute__((packed));
 
+/* Read link layer scheduler statistics. Times are in microseconds. */
+#define BLE_HCI_OCF_VS_RD_SCHED_STATS                  (MYNEWT_VAL(BLE_HCI_VS_OCF_OFFSET) + (0x000B))
+struct ble_hci_vs_rd_sched_stats_cp {
+    uint8_t reset;
+} __attribute__((packed));
+struct ble_hci_vs_rd_sched_stats_rp {
+    uint64_t window;
+    uint64_t busy;
+    uint32_t inserted;
+    uint32_t insert_failed;
+    uint32_t collisions;
+    uint32_t preempted;
+} __attribute__((packed));
+
 /* Command Specific Definitions */
 /* --- Set controller to host flow control (OGF 0x03, OCF 0x0031) --- */
 #define BLE_HCI_CTLR_TO_HOST_FC_OFF         (0)
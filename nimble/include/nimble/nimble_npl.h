@@ -49,6 +49,27 @@ enum ble_npl_error {
 
 typedef enum ble_npl_error ble_npl_error_t;
 
+/*
+ * Critical section lock domains, listed in lock order: while inside one
+ * domain, only domains listed after it may be entered.
+ *
+ * By default every domain maps to ble_npl_hw_enter_critical() (i.e.
+ * interrupts disabled on MCUs).  Ports that define BLE_NPL_HAS_CRIT_DOMAINS
+ * implement ble_npl_hw_enter_critical_domain() themselves and may give each
+ * domain its own lock.
+ */
+enum ble_npl_crit_domain {
+    /* HCI transport RX handoff */
+    BLE_NPL_CRIT_TRANSPORT = 0,
+    /* Anything using plain ble_npl_hw_enter_critical() */
+    BLE_NPL_CRIT_GLOBAL,
+    /* mbuf packet queues */
+    BLE_NPL_CRIT_MQUEUE,
+    /* Memory pool free lists */
+    BLE_NPL_CRIT_MEMPOOL,
+    BLE_NPL_CRIT_DOMAIN_CNT
+};
+
 /* Include OS-specific definitions */
 #include "nimble/nimble_npl_os.h"
 
@@ -167,6 +188,32 @@ void ble_npl_hw_exit_critical(uint32_t ctx);
 
 bool ble_npl_hw_is_in_critical(void);
 
+#ifdef BLE_NPL_HAS_CRIT_DOMAINS
+
+uint32_t ble_npl_hw_enter_critical_domain(uint8_t domain);
+
+void ble_npl_hw_exit_critical_domain(uint8_t domain, uint32_t ctx);
+
+#else
+
+static inline uint32_t
+ble_npl_hw_enter_critical_domain(uint8_t domain)
+{
+    (void)domain;
+
+    return ble_npl_hw_enter_critical();
+}
+
+static inline void
+ble_npl_hw_exit_critical_domain(uint8_t domain, uint32_t ctx)
+{
+    (void)domain;
+
+    ble_npl_hw_exit_critical(ctx);
+}
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -44,6 +44,10 @@
 #include <sys/uio.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <time.h>
+#ifndef MYNEWT
+#include <poll.h>
+#endif
 
 #if MYNEWT_VAL(BLE_SOCK_USE_TCP)
 #include <sys/errno.h>
@@ -114,6 +118,12 @@ STATS_SECT_START(hci_sock_stats)
     STATS_SECT_ENTRY(oevt)
     STATS_SECT_ENTRY(obytes)
     STATS_SECT_ENTRY(oerr)
+    STATS_SECT_ENTRY(cmd_rtt_cnt)
+    STATS_SECT_ENTRY(cmd_rtt_us)
+    STATS_SECT_ENTRY(cmd_rtt_lt1ms)
+    STATS_SECT_ENTRY(cmd_rtt_lt10ms)
+    STATS_SECT_ENTRY(cmd_rtt_lt100ms)
+    STATS_SECT_ENTRY(cmd_rtt_slow)
 STATS_SECT_END
 
 STATS_SECT_DECL(hci_sock_stats) hci_sock_stats;
@@ -133,6 +143,12 @@ STATS_NAME_START(hci_sock_stats)
     STATS_NAME(hci_sock_stats, oevt)
     STATS_NAME(hci_sock_stats, obytes)
     STATS_NAME(hci_sock_stats, oerr)
+    STATS_NAME(hci_sock_stats, cmd_rtt_cnt)
+    STATS_NAME(hci_sock_stats, cmd_rtt_us)
+    STATS_NAME(hci_sock_stats, cmd_rtt_lt1ms)
+    STATS_NAME(hci_sock_stats, cmd_rtt_lt10ms)
+    STATS_NAME(hci_sock_stats, cmd_rtt_lt100ms)
+    STATS_NAME(hci_sock_stats, cmd_rtt_slow)
 STATS_NAME_END(hci_sock_stats)
 
 /***
@@ -158,13 +174,42 @@ STATS_NAME_END(hci_sock_stats)
 
 struct os_task ble_sock_task;
 
+/*
+ * The simulator runs all tasks on a single host thread, so the socket
+ * task must never block in the kernel.  The socket is drained from a
+ * callout every BLE_HCI_SOCK_RX_POLL_MS instead.
+ */
+#define BLE_HCI_SOCK_RX_POLL_MS     10
+
 #endif
 
+/*
+ * Reading stops while the host or controller cannot take more data; it is
+ * retried after this many milliseconds.
+ */
+#define BLE_HCI_SOCK_RX_RETRY_MS    10
+
+/*
+ * Outgoing data packets made of more mbufs than this are copied into a
+ * single buffer before being sent.
+ */
+#define BLE_HCI_SOCK_TX_IOV_MAX     16
+
 static struct ble_hci_sock_state {
     int sock;
+#ifdef MYNEWT
     struct ble_npl_eventq evq;
-    struct ble_npl_event ev;
     struct ble_npl_callout timer;
+#else
+    /* Written to wake the RX task when the socket has been replaced */
+    int wake_fd[2];
+#endif
+
+#if MYNEWT_VAL(BLE_HOST)
+    /* Last command sent, for command round trip statistics */
+    uint16_t cmd_opcode;
+    uint64_t cmd_sent_us;
+#endif
 
     uint16_t rx_off;
     uint8_t rx_data[512];
@@ -183,33 +228,61 @@ static int
 ble_hci_sock_acl_tx(struct os_mbuf *om)
 {
     struct msghdr msg;
-    struct iovec iov[8];
-    int i;
+    struct iovec iov[BLE_HCI_SOCK_TX_IOV_MAX + 1];
     struct os_mbuf *m;
+    uint8_t *flat;
     uint8_t ch;
+    int len;
+    int i;
 
     memset(&msg, 0, sizeof(msg));
     memset(iov, 0, sizeof(iov));
 
     msg.msg_iov = iov;
 
+    len = OS_MBUF_PKTLEN(om) + 1;
+    flat = NULL;
+
     ch = BLE_HCI_UART_H4_ACL;
     iov[0].iov_len = 1;
     iov[0].iov_base = &ch;
     i = 1;
     for (m = om; m; m = SLIST_NEXT(m, om_next)) {
+        if (m->om_len == 0) {
+            continue;
+        }
+        if (i > BLE_HCI_SOCK_TX_IOV_MAX) {
+            break;
+        }
         iov[i].iov_base = m->om_data;
         iov[i].iov_len = m->om_len;
         i++;
     }
+
+    /* Each write to the socket has to carry exactly one packet, so a chain
+     * too long to describe with the iovec array is sent from a copy.
+     */
+    if (m) {
+        flat = malloc(len - 1);
+        if (!flat) {
+            os_mbuf_free_chain(om);
+            STATS_INC(hci_sock_stats, oerr);
+            return BLE_ERR_MEM_CAPACITY;
+        }
+        os_mbuf_copydata(om, 0, len - 1, flat);
+        iov[1].iov_base = flat;
+        iov[1].iov_len = len - 1;
+        i = 2;
+    }
     msg.msg_iovlen = i;
 
     STATS_INC(hci_sock_stats, omsg);
     STATS_INC(hci_sock_stats, oacl);
-    STATS_INCN(hci_sock_stats, obytes, OS_MBUF_PKTLEN(om) + 1);
+    STATS_INCN(hci_sock_stats, obytes, len);
     i = sendmsg(ble_hci_sock_state.sock, &msg, 0);
+    free(flat);
     os_mbuf_free_chain(om);
-    if (i != OS_MBUF_PKTLEN(om) + 1) {
+    if (i != len) {
         if (i < 0) {
             dprintf(1, "sendmsg() failed : %d\n", errno);
         } else {
@@ -262,7 +335,7 @@ ble_hci_sock_acl_tx(struct os_mbuf *om)
     free(buf);
 
     os_mbuf_free_chain(om);
-    if (i != OS_MBUF_PKTLEN(om) + 1) {
+    if (i != (int)len) {
         if (i < 0) {
             dprintf(1, "sendto() failed : %d\n", errno);
         } else {
@@ -275,6 +348,83 @@ ble_hci_sock_acl_tx(struct os_mbuf *om)
 }
 #endif
 
+#if MYNEWT_VAL(BLE_HOST)
+static uint64_t
+ble_hci_sock_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+ble_hci_sock_cmd_sent(const uint8_t *cmd)
+{
+    int sr;
+
+    /* Recorded before the command is written out, so the response cannot
+     * arrive first.
+     */
+    sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_TRANSPORT);
+    ble_hci_sock_state.cmd_opcode = cmd[0] | (cmd[1] << 8);
+    ble_hci_sock_state.cmd_sent_us = ble_hci_sock_now_us();
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_TRANSPORT, sr);
+}
+
+/**
+ * Updates command round trip statistics if the event is the Command
+ * Complete or Command Status for the last command sent.
+ */
+static void
+ble_hci_sock_cmd_done(const uint8_t *evt)
+{
+    uint16_t opcode;
+    uint64_t sent_us;
+    uint32_t rtt_us;
+    int sr;
+
+    if (evt[0] == BLE_HCI_EVCODE_COMMAND_COMPLETE && evt[1] >= 3) {
+        opcode = evt[3] | (evt[4] << 8);
+    } else if (evt[0] == BLE_HCI_EVCODE_COMMAND_STATUS && evt[1] >= 4) {
+        opcode = evt[4] | (evt[5] << 8);
+    } else {
+        return;
+    }
+
+    sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_TRANSPORT);
+    sent_us = ble_hci_sock_state.cmd_sent_us;
+    if (opcode != ble_hci_sock_state.cmd_opcode || sent_us == 0) {
+        sent_us = 0;
+    }
+    ble_hci_sock_state.cmd_sent_us = 0;
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_TRANSPORT, sr);
+
+    if (sent_us == 0) {
+        return;
+    }
+
+    rtt_us = ble_hci_sock_now_us() - sent_us;
+
+    STATS_INC(hci_sock_stats, cmd_rtt_cnt);
+    STATS_INCN(hci_sock_stats, cmd_rtt_us, rtt_us);
+    if (rtt_us < 1000) {
+        STATS_INC(hci_sock_stats, cmd_rtt_lt1ms);
+    } else if (rtt_us < 10000) {
+        STATS_INC(hci_sock_stats, cmd_rtt_lt10ms);
+    } else if (rtt_us < 100000) {
+        STATS_INC(hci_sock_stats, cmd_rtt_lt100ms);
+    } else {
+        STATS_INC(hci_sock_stats, cmd_rtt_slow);
+    }
+}
+#else
+static inline void
+ble_hci_sock_cmd_sent(const uint8_t *cmd)
+{
+}
+#endif
+
 #if MYNEWT_VAL(BLE_SOCK_USE_LINUX_BLUE)
 static int
 ble_hci_sock_cmdevt_tx(uint8_t *hci_ev, uint8_t h4_type)
@@ -298,6 +448,7 @@ ble_hci_sock_cmdevt_tx(uint8_t *hci_ev, uint8_t h4_type)
     if (h4_type == BLE_HCI_UART_H4_CMD) {
         len = sizeof(struct ble_hci_cmd) + hci_ev[2];
         STATS_INC(hci_sock_stats, ocmd);
+        ble_hci_sock_cmd_sent(hci_ev);
     } else if (h4_type == BLE_HCI_UART_H4_EVT) {
         len = sizeof(struct ble_hci_ev) + hci_ev[1];
         STATS_INC(hci_sock_stats, oevt);
@@ -343,6 +494,7 @@ ble_hci_sock_cmdevt_tx(uint8_t *hci_ev, uint8_t h4_type)
     if (h4_type == BLE_HCI_UART_H4_CMD) {
         len = sizeof(struct ble_hci_cmd) + hci_ev[2];
         STATS_INC(hci_sock_stats, ocmd);
+        ble_hci_sock_cmd_sent(hci_ev);
     } else if (h4_type == BLE_HCI_UART_H4_EVT) {
         len = sizeof(struct ble_hci_ev) + hci_ev[1];
         STATS_INC(hci_sock_stats, oevt);
@@ -377,8 +529,16 @@ ble_hci_sock_cmdevt_tx(uint8_t *hci_ev, uint8_t h4_type)
 }
 #endif
 
+/**
+ * Passes every complete H4 packet in the receive buffer on to the host or
+ * controller.
+ *
+ * @return                      0 if the buffer holds no complete packet;
+ *                              -1 if a packet could not be delivered and
+ *                              has to be retried later.
+ */
 static int
-ble_hci_sock_rx_msg(void)
+ble_hci_sock_rx_frames(void)
 {
     struct ble_hci_sock_state *bhss;
     int len;
@@ -388,30 +548,17 @@ ble_hci_sock_rx_msg(void)
     int rc;
 
     bhss = &ble_hci_sock_state;
-    if (bhss->sock < 0) {
-        return -1;
-    }
-    len = read(bhss->sock, bhss->rx_data + bhss->rx_off,
-               sizeof(bhss->rx_data) - bhss->rx_off);
-    if (len < 0) {
-        return -2;
-    }
-    if (len == 0) {
-        return -1;
-    }
-    bhss->rx_off += len;
-    STATS_INCN(hci_sock_stats, ibytes, len);
 
     while (bhss->rx_off > 0) {
         switch (bhss->rx_data[0]) {
 #if MYNEWT_VAL(BLE_CONTROLLER)
         case BLE_HCI_UART_H4_CMD:
             if (bhss->rx_off < sizeof(struct ble_hci_cmd)) {
-                return -1;
+                return 0;
             }
             len = 1 + sizeof(struct ble_hci_cmd) + bhss->rx_data[3];
             if (bhss->rx_off < len) {
-                return -1;
+                return 0;
             }
             STATS_INC(hci_sock_stats, imsg);
             STATS_INC(hci_sock_stats, icmd);
@@ -421,9 +568,9 @@ ble_hci_sock_rx_msg(void)
                 break;
             }
             memcpy(data, &bhss->rx_data[1], len - 1);
-            OS_ENTER_CRITICAL(sr);
+            sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_TRANSPORT);
             rc = ble_transport_to_ll_cmd(data);
-            OS_EXIT_CRITICAL(sr);
+            ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_TRANSPORT, sr);
             if (rc) {
                 ble_transport_free(data);
                 STATS_INC(hci_sock_stats, ierr);
@@ -434,38 +581,39 @@ ble_hci_sock_rx_msg(void)
 #if MYNEWT_VAL(BLE_HOST)
         case BLE_HCI_UART_H4_EVT:
             if (bhss->rx_off < sizeof(struct ble_hci_ev)) {
-                return -1;
+                return 0;
             }
             len = 1 + sizeof(struct ble_hci_ev) + bhss->rx_data[2];
             if (bhss->rx_off < len) {
-                return -1;
+                return 0;
             }
             STATS_INC(hci_sock_stats, imsg);
             STATS_INC(hci_sock_stats, ievt);
+            ble_hci_sock_cmd_done(&bhss->rx_data[1]);
             data = ble_transport_alloc_evt(0);
             if (!data) {
                 STATS_INC(hci_sock_stats, ierr);
                 break;
             }
             memcpy(data, &bhss->rx_data[1], len - 1);
-            OS_ENTER_CRITICAL(sr);
+            sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_TRANSPORT);
             rc = ble_transport_to_hs_evt(data);
-            OS_EXIT_CRITICAL(sr);
+            ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_TRANSPORT, sr);
             if (rc) {
                 ble_transport_free(data);
                 STATS_INC(hci_sock_stats, ierr);
-                return 0;
+                return -1;
             }
             break;
 #endif
         case BLE_HCI_UART_H4_ACL:
             if (bhss->rx_off < BLE_HCI_DATA_HDR_SZ) {
-                return -1;
+                return 0;
             }
             len = 1 + BLE_HCI_DATA_HDR_SZ + (bhss->rx_data[4] << 8) +
               bhss->rx_data[3];
             if (bhss->rx_off < len) {
-                return -1;
+                return 0;
             }
             STATS_INC(hci_sock_stats, imsg);
             STATS_INC(hci_sock_stats, iacl);
@@ -483,22 +631,22 @@ ble_hci_sock_rx_msg(void)
                 os_mbuf_free_chain(m);
                 break;
             }
-            OS_ENTER_CRITICAL(sr);
+            sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_TRANSPORT);
 #if MYNEWT_VAL(BLE_CONTROLLER)
             ble_transport_to_ll_acl(m);
 #else
             ble_transport_to_hs_acl(m);
 #endif
-            OS_EXIT_CRITICAL(sr);
+            ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_TRANSPORT, sr);
             break;
         case BLE_HCI_UART_H4_ISO:
             if (bhss->rx_off < BLE_HCI_DATA_HDR_SZ) {
-                return -1;
+                return 0;
             }
             len = 1 + BLE_HCI_DATA_HDR_SZ + (bhss->rx_data[4] << 8) +
                   bhss->rx_data[3];
             if (bhss->rx_off < len) {
-                return -1;
+                return 0;
             }
             STATS_INC(hci_sock_stats, imsg);
             STATS_INC(hci_sock_stats, iiso);
@@ -516,13 +664,13 @@ ble_hci_sock_rx_msg(void)
                 os_mbuf_free_chain(m);
                 break;
             }
-            OS_ENTER_CRITICAL(sr);
+            sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_TRANSPORT);
 #if MYNEWT_VAL(BLE_CONTROLLER)
             ble_transport_to_ll_iso(m);
 #else
             ble_transport_to_hs_iso(m);
 #endif
-            OS_EXIT_CRITICAL(sr);
+            ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_TRANSPORT, sr);
             break;
         default:
             STATS_INC(hci_sock_stats, ierr);
@@ -535,19 +683,82 @@ ble_hci_sock_rx_msg(void)
     return 0;
 }
 
+/**
+ * Reads and delivers everything the socket has to offer right now.
+ *
+ * @return                      0 if the socket has been drained;
+ *                              1 if delivery is blocked and has to be
+ *                              retried later;
+ *                              -1 if the socket is closed or failed.
+ */
+static int
+ble_hci_sock_rx_drain(void)
+{
+    struct ble_hci_sock_state *bhss;
+    int len;
+
+    bhss = &ble_hci_sock_state;
+
+    while (1) {
+        if (ble_hci_sock_rx_frames()) {
+            return 1;
+        }
+
+        if (bhss->sock < 0) {
+            return -1;
+        }
+
+        len = recv(bhss->sock, bhss->rx_data + bhss->rx_off,
+                   sizeof(bhss->rx_data) - bhss->rx_off, MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return 0;
+            }
+            return -1;
+        }
+        if (len == 0) {
+            return -1;
+        }
+        bhss->rx_off += len;
+        STATS_INCN(hci_sock_stats, ibytes, len);
+    }
+}
+
+#ifdef MYNEWT
 static void
 ble_hci_sock_rx_ev(struct ble_npl_event *ev)
 {
-    int rc;
     ble_npl_time_t timeout;
+    int rc;
 
-    rc = ble_hci_sock_rx_msg();
-    if (rc == 0) {
-        ble_npl_eventq_put(&ble_hci_sock_state.evq, &ble_hci_sock_state.ev);
+    rc = ble_hci_sock_rx_drain();
+    if (rc == 1) {
+        ble_npl_time_ms_to_ticks(BLE_HCI_SOCK_RX_RETRY_MS, &timeout);
     } else {
-        rc = ble_npl_time_ms_to_ticks(10, &timeout);
-        ble_npl_callout_reset(&ble_hci_sock_state.timer, timeout);
+        ble_npl_time_ms_to_ticks(BLE_HCI_SOCK_RX_POLL_MS, &timeout);
     }
+    ble_npl_callout_reset(&ble_hci_sock_state.timer, timeout);
+}
+#endif
+
+/**
+ * Starts receiving from a newly configured socket.
+ */
+static void
+ble_hci_sock_rx_start(void)
+{
+#ifdef MYNEWT
+    ble_npl_time_t timeout;
+
+    ble_npl_time_ms_to_ticks(BLE_HCI_SOCK_RX_POLL_MS, &timeout);
+    ble_npl_callout_reset(&ble_hci_sock_state.timer, timeout);
+#else
+    uint8_t b = 0;
+
+    if (write(ble_hci_sock_state.wake_fd[1], &b, 1) < 0) {
+        dprintf(1, "failed to wake HCI socket task: %d\n", errno);
+    }
+#endif
 }
 
 #if MYNEWT_VAL(BLE_SOCK_USE_TCP)
@@ -556,7 +767,6 @@ ble_hci_sock_config(void)
 {
     struct ble_hci_sock_state *bhss = &ble_hci_sock_state;
     struct sockaddr_in sin;
-    ble_npl_time_t timeout;
     int s;
     int rc;
 
@@ -594,11 +804,7 @@ ble_hci_sock_config(void)
         }
         bhss->sock = s;
     }
-    rc = ble_npl_time_ms_to_ticks(10, &timeout);
-    if (rc) {
-        goto err;
-    }
-    ble_npl_callout_reset(&ble_hci_sock_state.timer, timeout);
+    ble_hci_sock_rx_start();
 
     return 0;
 err:
@@ -616,7 +822,6 @@ ble_hci_sock_config(void)
     struct sockaddr_hci shci;
     int s;
     int rc;
-    ble_npl_time_t timeout;
 
     memset(&shci, 0, sizeof(shci));
     shci.hci_family = AF_BLUETOOTH;
@@ -653,12 +858,7 @@ ble_hci_sock_config(void)
         goto err;
     }
     ble_hci_sock_state.sock = s;
-
-    rc = ble_npl_time_ms_to_ticks(10, &timeout);
-    if (rc) {
-        goto err;
-    }
-    ble_npl_callout_reset(&ble_hci_sock_state.timer, timeout);
+    ble_hci_sock_rx_start();
 
     return 0;
 err:
@@ -674,7 +874,6 @@ ble_hci_sock_config(void)
     struct sockaddr_hci shci;
     int s;
     int rc;
-    ble_npl_time_t timeout;
 
     memset(&shci, 0, sizeof(shci));
     shci.hci_family = AF_BLUETOOTH;
@@ -699,12 +898,7 @@ ble_hci_sock_config(void)
     }
 
     ble_hci_sock_state.sock = s;
-
-    rc = ble_npl_time_ms_to_ticks(10, &timeout);
-    if (rc) {
-        goto err;
-    }
-    ble_npl_callout_reset(&ble_hci_sock_state.timer, timeout);
+    ble_hci_sock_rx_start();
 
     return 0;
 err:
@@ -785,7 +979,9 @@ ble_hci_trans_reset(void)
 {
     int rc;
 
+#ifdef MYNEWT
     ble_npl_callout_stop(&ble_hci_sock_state.timer);
+#endif
 
     /* Reopen the UART. */
     rc = ble_hci_sock_config();
@@ -797,6 +993,7 @@ ble_hci_trans_reset(void)
     return 0;
 }
 
+#ifdef MYNEWT
 void
 ble_hci_sock_ack_handler(void *arg)
 {
@@ -807,14 +1004,86 @@ ble_hci_sock_ack_handler(void *arg)
         ble_npl_event_run(ev);
     }
 }
+#else
+/**
+ * Socket RX task.  Sleeps in poll() until the socket has data, then
+ * delivers every complete packet received before sleeping again.
+ *
+ * While delivery is blocked the socket is not watched, as it stays
+ * readable; delivery is retried every BLE_HCI_SOCK_RX_RETRY_MS instead.
+ */
+void
+ble_hci_sock_ack_handler(void *arg)
+{
+    struct ble_hci_sock_state *bhss;
+    struct pollfd pfd[2];
+    uint8_t buf[8];
+    int blocked;
+    int sock_ok;
+    int rc;
+
+    bhss = &ble_hci_sock_state;
+    blocked = 0;
+    sock_ok = 1;
+
+    while (1) {
+        /* poll() ignores negative descriptors */
+        pfd[0].fd = (sock_ok && !blocked) ? bhss->sock : -1;
+        pfd[0].events = POLLIN;
+        pfd[0].revents = 0;
+        pfd[1].fd = bhss->wake_fd[0];
+        pfd[1].events = POLLIN;
+        pfd[1].revents = 0;
+
+        rc = poll(pfd, 2, blocked ? BLE_HCI_SOCK_RX_RETRY_MS : -1);
+        if (rc < 0) {
+            if (errno != EINTR) {
+                dprintf(1, "poll() failed: %d\n", errno);
+                ble_npl_time_delay(ble_npl_time_ms_to_ticks32(
+                    BLE_HCI_SOCK_RX_RETRY_MS));
+            }
+            continue;
+        }
+
+        if (pfd[1].revents & POLLIN) {
+            /* Socket was reconfigured */
+            while (read(bhss->wake_fd[0], buf, sizeof(buf)) > 0) {
+            }
+            sock_ok = 1;
+        }
+
+        if (!sock_ok) {
+            continue;
+        }
+
+        /* Also retries delivery that was blocked, on timeout */
+        rc = ble_hci_sock_rx_drain();
+        blocked = rc == 1;
+
+        /* Stop watching a closed socket until it is reconfigured */
+        if (rc < 0) {
+            sock_ok = 0;
+        }
+    }
+}
+#endif
 
 static void
 ble_hci_sock_init_task(void)
 {
+#ifdef MYNEWT
     ble_npl_eventq_init(&ble_hci_sock_state.evq);
     ble_npl_callout_stop(&ble_hci_sock_state.timer);
     ble_npl_callout_init(&ble_hci_sock_state.timer, &ble_hci_sock_state.evq,
                     ble_hci_sock_rx_ev, NULL);
+#else
+    int rc;
+
+    rc = pipe(ble_hci_sock_state.wake_fd);
+    assert(rc == 0);
+    rc = fcntl(ble_hci_sock_state.wake_fd[0], F_SETFL, O_NONBLOCK);
+    assert(rc == 0);
+#endif
 
 #ifdef MYNEWT
     {
@@ -860,7 +1129,6 @@ ble_hci_sock_init(void)
     ble_hci_sock_state.sock = -1;
 
     ble_hci_sock_init_task();
-    ble_npl_event_init(&ble_hci_sock_state.ev, ble_hci_sock_rx_ev, NULL);
 
     rc = ble_hci_sock_config();
     SYSINIT_PANIC_ASSERT_MSG(rc == 0, "Failure configuring socket HCI");
@@ -0,0 +1,201 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Advertising traffic replayed by the adv_mon benchmark: the mix of beacon,
+ * phone, accessory and extended advertising reports a scanner sees in a busy
+ * environment. Only a few of them are of interest to the monitor filters the
+ * benchmark registers; each report lists the filters it is expected to match.
+ */
+
+#include <stdint.h>
+#include "os/util.h"
+#include "nimble/hci_common.h"
+#include "host/ble_hs_adv.h"
+#include "bench.h"
+
+#define F4(b)       b, b, b, b
+#define F16(b)      F4(b), F4(b), F4(b), F4(b)
+#define F64(b)      F16(b), F16(b), F16(b), F16(b)
+
+#define ADV_REC_ADDR(t, a0, a5) { (t), { (a0), 0x11, 0x22, 0x33, 0x44, (a5) } }
+
+#define ADV_REC_PUB(a0)         ADV_REC_ADDR(BLE_ADDR_PUBLIC, a0, 0x00)
+#define ADV_REC_RND(a0)         ADV_REC_ADDR(BLE_ADDR_RANDOM, a0, 0xc0)
+
+/* Legacy PDU types, as extended report properties */
+#define ADV_REC_ADV_IND         BLE_HCI_LEGACY_ADV_EVTYPE_ADV_IND
+#define ADV_REC_NONCONN_IND     BLE_HCI_LEGACY_ADV_EVTYPE_ADV_NONCON_IND
+#define ADV_REC_SCAN_RSP        BLE_HCI_LEGACY_ADV_EVTYPE_SCAN_RSP_ADV_IND
+
+#define ADV_REC(addr_, props_, sid_, rssi_, data_, match_)          \
+    {                                                               \
+        .adv = {                                                    \
+            .addr = addr_,                                          \
+            .props = (props_),                                      \
+            .sid = (sid_),                                          \
+            .rssi = (rssi_),                                        \
+            .len = sizeof(data_),                                   \
+            .data = (data_),                                        \
+        },                                                          \
+        .match = (match_),                                          \
+    }
+
+#define M(f)        (1 << BENCH_MON_ ## f)
+
+static const uint8_t adv_rec_ibeacon[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0x1a, BLE_HS_ADV_TYPE_MFG_DATA, 0x4c, 0x00, 0x02, 0x15,
+    0xe2, 0xc5, 0x6d, 0xb5, 0xdf, 0xfb, 0x48, 0xd2,
+    0xb0, 0x60, 0xd0, 0xf5, 0xa7, 0x10, 0x96, 0xe0,
+    0x00, 0x01, 0x00, 0x2a, 0xc5,
+};
+
+static const uint8_t adv_rec_apple_nearby[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x1a,
+    0x0a, BLE_HS_ADV_TYPE_MFG_DATA, 0x4c, 0x00, 0x10, 0x05, 0x0b, 0x1c,
+    0x6e, 0x4b, 0x1a,
+};
+
+static const uint8_t adv_rec_apple_findmy[] = {
+    0x1e, BLE_HS_ADV_TYPE_MFG_DATA, 0x4c, 0x00, 0x12, 0x19, 0x10,
+    F16(0x3c), F4(0xa5), 0x71, 0x9e, 0x01, 0x00,
+};
+
+static const uint8_t adv_rec_eddystone_uid[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0x03, BLE_HS_ADV_TYPE_COMP_UUIDS16, 0xaa, 0xfe,
+    0x17, BLE_HS_ADV_TYPE_SVC_DATA_UUID16, 0xaa, 0xfe, 0x00, 0xe7,
+    0x8b, 0x0c, 0xe1, 0x9c, 0x4d, 0x2a, 0x13, 0x5e, 0x9f, 0x0b,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x07,
+    0x00, 0x00,
+};
+
+static const uint8_t adv_rec_eddystone_url[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0x03, BLE_HS_ADV_TYPE_COMP_UUIDS16, 0xaa, 0xfe,
+    0x0d, BLE_HS_ADV_TYPE_SVC_DATA_UUID16, 0xaa, 0xfe, 0x10, 0xeb, 0x03,
+    'm', 'y', 'n', 'e', 'w', 't', 0x07,
+};
+
+static const uint8_t adv_rec_swift_pair[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0x06, BLE_HS_ADV_TYPE_MFG_DATA, 0x06, 0x00, 0x03, 0x00, 0x80,
+    0x06, BLE_HS_ADV_TYPE_COMP_NAME, 'M', 'o', 'u', 's', 'e',
+};
+
+static const uint8_t adv_rec_hrm[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0x05, BLE_HS_ADV_TYPE_COMP_UUIDS16, 0x0d, 0x18, 0x0f, 0x18,
+    0x09, BLE_HS_ADV_TYPE_COMP_NAME, 'H', 'R', 'M', '-', '2', '0', '4', '1',
+};
+
+static const uint8_t adv_rec_hrm_scan_rsp[] = {
+    0x09, BLE_HS_ADV_TYPE_COMP_NAME, 'H', 'R', 'M', '-', '2', '0', '4', '1',
+    0x03, BLE_HS_ADV_TYPE_APPEARANCE, 0x41, 0x03,
+};
+
+static const uint8_t adv_rec_tile[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0x03, BLE_HS_ADV_TYPE_COMP_UUIDS16, 0xed, 0xfe,
+    0x0b, BLE_HS_ADV_TYPE_SVC_DATA_UUID16, 0xed, 0xfe, 0x02, 0x00,
+    0x5d, 0x1a, 0x9e, 0x63, 0x0c, 0x21,
+};
+
+static const uint8_t adv_rec_fast_pair[] = {
+    0x03, BLE_HS_ADV_TYPE_COMP_UUIDS16, 0x2c, 0xfe,
+    0x06, BLE_HS_ADV_TYPE_SVC_DATA_UUID16, 0x2c, 0xfe, 0x00, 0xb7, 0x27,
+    0x02, BLE_HS_ADV_TYPE_TX_PWR_LVL, 0xf4,
+};
+
+/* Fits in a single extended report */
+static const uint8_t adv_rec_ext_short[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0x11, BLE_HS_ADV_TYPE_COMP_UUIDS128,
+    0x9e, 0xca, 0xdc, 0x24, 0x0e, 0xe5, 0xa9, 0xe0,
+    0x93, 0xf3, 0xa3, 0xb5, 0x01, 0x00, 0x40, 0x6e,
+    0x29, BLE_HS_ADV_TYPE_MFG_DATA, 0xff, 0xff, F16(0x00), F16(0x01), F4(0x02),
+    0x03, 0x03,
+};
+
+/* Sensor samples; the manufacturer data is in the second fragment */
+static const uint8_t adv_rec_ext_sensor[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0xf3, BLE_HS_ADV_TYPE_SVC_DATA_UUID16, 0x1a, 0x18,
+    F64(0x41), F64(0x42), F64(0x43), F16(0x44), F16(0x45), F16(0x46),
+    0x07, BLE_HS_ADV_TYPE_MFG_DATA, 0x59, 0x00, 0x01, 0x02, 0x03, 0x04,
+};
+
+/* Broadcast audio; the Broadcast Audio Announcement is in the last fragment */
+static const uint8_t adv_rec_ext_audio[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0x0e, BLE_HS_ADV_TYPE_BROADCAST_NAME,
+    'G', 'a', 't', 'e', ' ', '1', '2', ' ', 'A', 'u', 'd', 'i', 'o',
+    0xfe, BLE_HS_ADV_TYPE_MFG_DATA, 0x75, 0x00,
+    F64(0x10), F64(0x11), F64(0x12), F16(0x13), F16(0x14), F16(0x15),
+    F4(0x16), F4(0x17), 0x18, 0x18, 0x18,
+    0xc8, BLE_HS_ADV_TYPE_MFG_DATA, 0x75, 0x00,
+    F64(0x20), F64(0x21), F64(0x22), F4(0x23), 0x24,
+    0x06, BLE_HS_ADV_TYPE_SVC_DATA_UUID16, 0x52, 0x18, 0x3d, 0x7a, 0x0c,
+};
+
+/* Nobody is interested in this one */
+static const uint8_t adv_rec_ext_noise[] = {
+    0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+    0xc0, BLE_HS_ADV_TYPE_MFG_DATA, 0xe5, 0x02,
+    F64(0x30), F64(0x31), F16(0x32), F16(0x33), F16(0x34), F4(0x35),
+    F4(0x36), F4(0x37), 0x38,
+    0x50, BLE_HS_ADV_TYPE_MFG_DATA, 0xe5, 0x02,
+    F64(0x50), F4(0x51), F4(0x52), F4(0x53), 0x54,
+};
+
+const struct bench_adv_rec bench_adv_recs[] = {
+    ADV_REC(ADV_REC_RND(0x01), ADV_REC_NONCONN_IND, 0xff, -62,
+            adv_rec_ibeacon, M(IBEACON)),
+    ADV_REC(ADV_REC_RND(0x02), ADV_REC_ADV_IND, 0xff, -48,
+            adv_rec_apple_nearby, 0),
+    ADV_REC(ADV_REC_RND(0x03), ADV_REC_NONCONN_IND, 0xff, -81,
+            adv_rec_apple_findmy, 0),
+    ADV_REC(ADV_REC_RND(0x04), 0, 0x02, -57,
+            adv_rec_ext_sensor, M(SENSOR)),
+    ADV_REC(ADV_REC_PUB(0x05), ADV_REC_NONCONN_IND, 0xff, -75,
+            adv_rec_eddystone_uid, M(EDDYSTONE)),
+    ADV_REC(ADV_REC_RND(0x06), ADV_REC_ADV_IND, 0xff, -55,
+            adv_rec_swift_pair, 0),
+    ADV_REC(ADV_REC_PUB(0x07), ADV_REC_ADV_IND, 0xff, -67,
+            adv_rec_hrm, M(HRM) | M(DEVICE)),
+    ADV_REC(ADV_REC_PUB(0x07), ADV_REC_SCAN_RSP, 0xff, -66,
+            adv_rec_hrm_scan_rsp, M(DEVICE)),
+    ADV_REC(ADV_REC_RND(0x08), 0, 0x05, -90,
+            adv_rec_ext_noise, 0),
+    ADV_REC(ADV_REC_PUB(0x09), ADV_REC_ADV_IND, 0xff, -85,
+            adv_rec_hrm, 0),
+    ADV_REC(ADV_REC_RND(0x0a), ADV_REC_NONCONN_IND, 0xff, -80,
+            adv_rec_tile, 0),
+    ADV_REC(ADV_REC_RND(0x0b), 0, 0x01, -60,
+            adv_rec_ext_audio, M(AUDIO)),
+    ADV_REC(ADV_REC_RND(0x0c), ADV_REC_ADV_IND, 0xff, -58,
+            adv_rec_fast_pair, 0),
+    ADV_REC(ADV_REC_PUB(0x0d), ADV_REC_NONCONN_IND, 0xff, -71,
+            adv_rec_eddystone_url, M(EDDYSTONE)),
+    ADV_REC(ADV_REC_RND(0x0e), 0, 0x00, -64,
+            adv_rec_ext_short, 0),
+};
+
+const int bench_adv_rec_count = ARRAY_SIZE(bench_adv_recs);
@@ -0,0 +1,1469 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Host throughput and latency benchmarks.
+ *
+ * Every benchmark keeps one operation outstanding per slot (a connection, or
+ * a place in the advertising report pipeline) and issues the next operation
+ * as soon as the previous one completes, until the requested number of
+ * operations is done. All host API calls happen in the host task; the main
+ * thread only kicks runs off and collects the results.
+ *
+ * Results are written to stdout, one JSON object per line.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "os/util.h"
+#include "nimble/nimble_npl.h"
+#include "nimble/nimble_port.h"
+#include "host/ble_hs.h"
+#include "host/ble_l2cap.h"
+#include "services/gap/ble_svc_gap.h"
+#include "ble_sm_priv.h"
+#include "bench.h"
+
+#define BENCH_MAX_CONNS         MYNEWT_VAL(BLE_MAX_CONNECTIONS)
+#define BENCH_TIMEOUT_MS        (60000)
+
+#define BENCH_NOTIFY_LEN        (20)
+#define BENCH_COC_PSM           (0x0080)
+#define BENCH_COC_SDU_LEN       (1024)
+/* Largest SDU, spans 266 K-frames of VCTRL_COC_MPS bytes */
+#define BENCH_COC_SDU_LEN_MAX   (0xffff)
+#define BENCH_ADV_DEPTH         (8)
+
+/* Manufacturer specific data carrying the report's slot and timestamp */
+#define BENCH_ADV_DATA_LEN      (3 + 4 + 1 + 8)
+
+enum bench_state {
+    BENCH_STATE_IDLE,
+    BENCH_STATE_CONNECT,
+    BENCH_STATE_PREPARE,
+    BENCH_STATE_RUN,
+};
+
+struct bench_slot {
+    uint16_t conn_handle;
+    uint64_t op_start;
+    struct ble_npl_event ev;
+
+    struct ble_l2cap_chan *coc;
+
+    /* GATT discovery progress */
+    struct ble_gatt_svc svcs[VCTRL_SVC_COUNT];
+    int svc_count;
+    int svc_idx;
+    int chr_count;
+};
+
+struct bench_def {
+    const char *name;
+    /* Slots are connections; runs are scaled over connection counts */
+    int uses_conns;
+    /* Optional; must call bench_prepared() once the slot is ready */
+    int (*prepare)(struct bench_slot *slot);
+    int (*start)(void);
+    void (*stop)(void);
+    int (*issue)(struct bench_slot *slot);
+};
+
+struct bench_run {
+    const struct bench_def *def;
+    enum bench_state state;
+    int conns;
+    int slots;
+    int pending;
+    int failed;
+
+    uint32_t ops;
+    uint32_t ops_issued;
+    uint32_t ops_done;
+    uint32_t errors;
+    uint64_t bytes;
+    uint64_t start_ns;
+    uint64_t end_ns;
+
+    uint32_t *lat_ns;
+    uint32_t lat_count;
+};
+
+static struct bench_slot bench_conns[BENCH_MAX_CONNS];
+static int bench_num_conns;
+
+static struct bench_slot bench_adv_slots[BENCH_ADV_DEPTH];
+
+static struct bench_run bench_run;
+
+static struct ble_npl_sem bench_sem;
+static struct ble_npl_event bench_start_ev;
+
+static uint16_t bench_notify_val_handle;
+static uint8_t bench_payload[BENCH_COC_SDU_LEN_MAX];
+static uint16_t bench_coc_sdu_len = BENCH_COC_SDU_LEN;
+
+static void bench_step(void);
+static void bench_sm_enc_change(struct bench_slot *slot, int status);
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static struct bench_slot *
+bench_conn_find(uint16_t conn_handle)
+{
+    int i;
+
+    for (i = 0; i < bench_num_conns; i++) {
+        if (bench_conns[i].conn_handle == conn_handle) {
+            return &bench_conns[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void
+bench_finish(void)
+{
+    if (bench_run.state == BENCH_STATE_RUN && bench_run.def->stop) {
+        bench_run.def->stop();
+    }
+
+    bench_run.state = BENCH_STATE_IDLE;
+    ble_npl_sem_release(&bench_sem);
+}
+
+static void
+bench_fail(const char *what, int rc)
+{
+    fprintf(stderr, "%s: %s failed; rc=%d\n", bench_run.def->name, what, rc);
+
+    bench_run.failed = 1;
+    bench_finish();
+}
+
+static void
+bench_issue(struct bench_slot *slot)
+{
+    int rc;
+
+    if ((bench_run.state != BENCH_STATE_RUN) ||
+        (bench_run.ops_issued >= bench_run.ops)) {
+        return;
+    }
+
+    bench_run.ops_issued++;
+    slot->op_start = bench_now_ns();
+
+    rc = bench_run.def->issue(slot);
+    if (rc != 0) {
+        bench_run.errors++;
+        bench_run.ops_done++;
+        if (bench_run.ops_done == bench_run.ops) {
+            bench_run.end_ns = bench_now_ns();
+            bench_finish();
+        } else {
+            ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &slot->ev);
+        }
+    }
+}
+
+static void
+bench_issue_ev(struct ble_npl_event *ev)
+{
+    bench_issue(ble_npl_event_get_arg(ev));
+}
+
+/**
+ * Completes the slot's outstanding operation. The next operation is issued
+ * from a separate event so completions reported from within the issuing call
+ * do not recurse.
+ */
+static void
+bench_op_done(struct bench_slot *slot, int status, uint32_t bytes,
+              uint64_t op_start)
+{
+    uint64_t now;
+
+    if (bench_run.state != BENCH_STATE_RUN) {
+        return;
+    }
+
+    now = bench_now_ns();
+
+    if (status == 0) {
+        bench_run.lat_ns[bench_run.lat_count++] = now - op_start;
+        bench_run.bytes += bytes;
+    } else {
+        bench_run.errors++;
+    }
+
+    bench_run.ops_done++;
+    if (bench_run.ops_done == bench_run.ops) {
+        bench_run.end_ns = now;
+        bench_finish();
+        return;
+    }
+
+    ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &slot->ev);
+}
+
+static void
+bench_prepared(void)
+{
+    if ((bench_run.state == BENCH_STATE_PREPARE) &&
+        (--bench_run.pending == 0)) {
+        bench_step();
+    }
+}
+
+/*** Connection management */
+
+static int
+bench_mtu_cb(uint16_t conn_handle, const struct ble_gatt_error *error,
+             uint16_t mtu, void *arg)
+{
+    if (error->status != 0) {
+        bench_fail("MTU exchange", error->status);
+        return 0;
+    }
+
+    bench_num_conns++;
+    bench_step();
+
+    return 0;
+}
+
+static int
+bench_gap_event(struct ble_gap_event *event, void *arg)
+{
+    struct bench_slot *slot = arg;
+    int rc;
+
+    switch (event->type) {
+    case BLE_GAP_EVENT_CONNECT:
+        if (event->connect.status != 0) {
+            bench_fail("connect", event->connect.status);
+            break;
+        }
+
+        slot->conn_handle = event->connect.conn_handle;
+        slot->coc = NULL;
+
+        rc = ble_gattc_exchange_mtu(slot->conn_handle, bench_mtu_cb, slot);
+        if (rc != 0) {
+            bench_fail("MTU exchange", rc);
+        }
+        break;
+
+    case BLE_GAP_EVENT_DISCONNECT:
+        slot->coc = NULL;
+        bench_num_conns--;
+
+        if (bench_run.state == BENCH_STATE_CONNECT) {
+            bench_step();
+        } else if (bench_run.state != BENCH_STATE_IDLE) {
+            bench_fail("connection", event->disconnect.reason);
+        }
+        break;
+
+    case BLE_GAP_EVENT_ENC_CHANGE:
+        bench_sm_enc_change(slot, event->enc_change.status);
+        break;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+static void
+bench_step(void)
+{
+    ble_addr_t addr;
+    int rc;
+    int i;
+
+    switch (bench_run.state) {
+    case BENCH_STATE_CONNECT:
+        if (bench_num_conns < bench_run.conns) {
+            vctrl_peer_addr(bench_num_conns, &addr);
+            rc = ble_gap_connect(BLE_OWN_ADDR_PUBLIC, &addr, 1000, NULL,
+                                 bench_gap_event,
+                                 &bench_conns[bench_num_conns]);
+            if (rc != 0) {
+                bench_fail("connect", rc);
+            }
+            return;
+        }
+
+        if (bench_num_conns > bench_run.conns) {
+            rc = ble_gap_terminate(bench_conns[bench_num_conns - 1].conn_handle,
+                                   BLE_ERR_REM_USER_CONN_TERM);
+            if (rc != 0) {
+                bench_fail("terminate", rc);
+            }
+            return;
+        }
+
+        /* Hold the count until all slots were handed to prepare() */
+        bench_run.state = BENCH_STATE_PREPARE;
+        bench_run.pending = 1;
+
+        if (bench_run.def->prepare) {
+            for (i = 0; i < bench_num_conns; i++) {
+                bench_run.pending++;
+                rc = bench_run.def->prepare(&bench_conns[i]);
+                if (rc != 0) {
+                    bench_fail("prepare", rc);
+                    return;
+                }
+            }
+        }
+
+        bench_prepared();
+        break;
+
+    case BENCH_STATE_PREPARE:
+        bench_run.state = BENCH_STATE_RUN;
+        bench_run.start_ns = bench_now_ns();
+
+        if (bench_run.def->start) {
+            rc = bench_run.def->start();
+            if (rc != 0) {
+                bench_fail("start", rc);
+                return;
+            }
+        }
+
+        for (i = 0; i < bench_run.slots; i++) {
+            if (bench_run.def->uses_conns) {
+                bench_issue(&bench_conns[i]);
+            } else {
+                bench_issue(&bench_adv_slots[i]);
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void
+bench_start_ev_fn(struct ble_npl_event *ev)
+{
+    bench_run.state = BENCH_STATE_CONNECT;
+    bench_step();
+}
+
+/*** ATT */
+
+static int
+bench_att_read_cb(uint16_t conn_handle, const struct ble_gatt_error *error,
+                  struct ble_gatt_attr *attr, void *arg)
+{
+    struct bench_slot *slot = arg;
+
+    bench_op_done(slot, error->status,
+                  error->status == 0 ? OS_MBUF_PKTLEN(attr->om) : 0,
+                  slot->op_start);
+
+    return 0;
+}
+
+static int
+bench_att_read_issue(struct bench_slot *slot)
+{
+    return ble_gattc_read(slot->conn_handle, VCTRL_ATT_VAL_HANDLE,
+                          bench_att_read_cb, slot);
+}
+
+static int
+bench_att_write_cb(uint16_t conn_handle, const struct ble_gatt_error *error,
+                   struct ble_gatt_attr *attr, void *arg)
+{
+    struct bench_slot *slot = arg;
+
+    bench_op_done(slot, error->status,
+                  error->status == 0 ? VCTRL_ATT_VAL_LEN : 0,
+                  slot->op_start);
+
+    return 0;
+}
+
+static int
+bench_att_write_issue(struct bench_slot *slot)
+{
+    return ble_gattc_write_flat(slot->conn_handle, VCTRL_ATT_VAL_HANDLE,
+                                bench_payload, VCTRL_ATT_VAL_LEN,
+                                bench_att_write_cb, slot);
+}
+
+static int
+bench_att_notify_issue(struct bench_slot *slot)
+{
+    struct os_mbuf *om;
+
+    om = ble_hs_mbuf_from_flat(bench_payload, BENCH_NOTIFY_LEN);
+    if (om == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    return ble_gatts_notify_custom(slot->conn_handle, bench_notify_val_handle,
+                                   om);
+}
+
+void
+bench_peer_notify_rx(uint16_t conn_handle, uint16_t attr_handle,
+                     uint16_t len)
+{
+    struct bench_slot *slot;
+
+    slot = bench_conn_find(conn_handle);
+    if (slot != NULL) {
+        bench_op_done(slot, attr_handle == bench_notify_val_handle ? 0 :
+                            BLE_HS_EBADDATA, len, slot->op_start);
+    }
+}
+
+/*** GATT discovery */
+
+static void
+bench_disc_done(struct bench_slot *slot, int status)
+{
+    if ((status == 0) &&
+        (slot->chr_count != VCTRL_SVC_COUNT * VCTRL_CHR_PER_SVC)) {
+        status = BLE_HS_EBADDATA;
+    }
+    bench_op_done(slot, status, 0, slot->op_start);
+}
+
+static int
+bench_disc_chr_cb(uint16_t conn_handle, const struct ble_gatt_error *error,
+                  const struct ble_gatt_chr *chr, void *arg)
+{
+    struct bench_slot *slot = arg;
+    struct ble_gatt_svc *svc;
+    int rc;
+
+    switch (error->status) {
+    case 0:
+        slot->chr_count++;
+        break;
+
+    case BLE_HS_EDONE:
+        if (++slot->svc_idx == slot->svc_count) {
+            bench_disc_done(slot, 0);
+            break;
+        }
+
+        svc = &slot->svcs[slot->svc_idx];
+        rc = ble_gattc_disc_all_chrs(conn_handle, svc->start_handle,
+                                     svc->end_handle, bench_disc_chr_cb, slot);
+        if (rc != 0) {
+            bench_disc_done(slot, rc);
+        }
+        break;
+
+    default:
+        bench_disc_done(slot, error->status);
+        break;
+    }
+
+    return 0;
+}
+
+static int
+bench_disc_svc_cb(uint16_t conn_handle, const struct ble_gatt_error *error,
+                  const struct ble_gatt_svc *service, void *arg)
+{
+    struct bench_slot *slot = arg;
+    int rc;
+
+    switch (error->status) {
+    case 0:
+        if (slot->svc_count < VCTRL_SVC_COUNT) {
+            slot->svcs[slot->svc_count] = *service;
+        }
+        slot->svc_count++;
+        break;
+
+    case BLE_HS_EDONE:
+        if (slot->svc_count != VCTRL_SVC_COUNT) {
+            bench_disc_done(slot, BLE_HS_EBADDATA);
+            break;
+        }
+
+        slot->svc_idx = 0;
+        rc = ble_gattc_disc_all_chrs(conn_handle, slot->svcs[0].start_handle,
+                                     slot->svcs[0].end_handle,
+                                     bench_disc_chr_cb, slot);
+        if (rc != 0) {
+            bench_disc_done(slot, rc);
+        }
+        break;
+
+    default:
+        bench_disc_done(slot, error->status);
+        break;
+    }
+
+    return 0;
+}
+
+static int
+bench_disc_issue(struct bench_slot *slot)
+{
+    slot->svc_count = 0;
+    slot->svc_idx = 0;
+    slot->chr_count = 0;
+
+    return ble_gattc_disc_all_svcs(slot->conn_handle, bench_disc_svc_cb, slot);
+}
+
+/*** L2CAP CoC */
+
+static int
+bench_coc_event(struct ble_l2cap_event *event, void *arg)
+{
+    struct bench_slot *slot = arg;
+
+    switch (event->type) {
+    case BLE_L2CAP_EVENT_COC_CONNECTED:
+        if (event->connect.status != 0) {
+            bench_fail("CoC connect", event->connect.status);
+            break;
+        }
+
+        slot->coc = event->connect.chan;
+        bench_prepared();
+        break;
+
+    case BLE_L2CAP_EVENT_COC_DISCONNECTED:
+        slot->coc = NULL;
+        break;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+static int
+bench_coc_prepare(struct bench_slot *slot)
+{
+    struct os_mbuf *sdu_rx;
+
+    /* Channels are kept for as long as their connection */
+    if (slot->coc != NULL) {
+        bench_prepared();
+        return 0;
+    }
+
+    sdu_rx = os_msys_get_pkthdr(0, 0);
+    if (sdu_rx == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    return ble_l2cap_connect(slot->conn_handle, BENCH_COC_PSM,
+                             BENCH_COC_SDU_LEN, sdu_rx, bench_coc_event, slot);
+}
+
+static int
+bench_coc_issue(struct bench_slot *slot)
+{
+    struct os_mbuf *om;
+    int rc;
+
+    om = os_msys_get_pkthdr(bench_coc_sdu_len, 0);
+    if (om == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    rc = os_mbuf_append(om, bench_payload, bench_coc_sdu_len);
+    if (rc != 0) {
+        os_mbuf_free_chain(om);
+        return BLE_HS_ENOMEM;
+    }
+
+    /* A stalled channel still took the SDU; the rest goes out as the peer
+     * returns credits.
+     */
+    rc = ble_l2cap_send(slot->coc, om);
+    if (rc == BLE_HS_ESTALLED) {
+        rc = 0;
+    }
+
+    return rc;
+}
+
+void
+bench_peer_coc_sdu_rx(uint16_t conn_handle, uint16_t len)
+{
+    struct bench_slot *slot;
+
+    slot = bench_conn_find(conn_handle);
+    if (slot != NULL) {
+        bench_op_done(slot, len == bench_coc_sdu_len ? 0 : BLE_HS_EBADDATA,
+                      len, slot->op_start);
+    }
+}
+
+static int
+bench_coc_max_start(void)
+{
+    bench_coc_sdu_len = BENCH_COC_SDU_LEN_MAX;
+    return 0;
+}
+
+static void
+bench_coc_max_stop(void)
+{
+    bench_coc_sdu_len = BENCH_COC_SDU_LEN;
+}
+
+/*** SM */
+
+static int
+bench_sm_issue(struct bench_slot *slot)
+{
+    return ble_gap_security_initiate(slot->conn_handle);
+}
+
+static void
+bench_sm_enc_change(struct bench_slot *slot, int status)
+{
+    if (bench_run.def && (bench_run.def->issue == bench_sm_issue)) {
+        bench_op_done(slot, status, 0, slot->op_start);
+    }
+}
+
+/*** SM crypto */
+
+/*
+ * The sm_alg_* benchmarks call the security manager's crypto functions
+ * directly; one operation is one call.  Inputs are fixed, only their cost
+ * matters.
+ */
+#define BENCH_ALG_IRKS          (16)
+
+static struct ble_sm_alg_key bench_alg_key;
+static struct ble_sm_alg_key bench_alg_irks[BENCH_ALG_IRKS];
+
+static int
+bench_alg_start(void)
+{
+    uint8_t key[16];
+    int rc;
+    int i;
+
+    memcpy(key, bench_payload, sizeof(key));
+
+    rc = ble_sm_alg_key_init(&bench_alg_key, key);
+    if (rc != 0) {
+        return rc;
+    }
+
+    for (i = 0; i < BENCH_ALG_IRKS; i++) {
+        key[0] = i;
+        rc = ble_sm_alg_key_init(&bench_alg_irks[i], key);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+static int
+bench_alg_done(struct bench_slot *slot, int rc)
+{
+    if (rc == 0) {
+        bench_op_done(slot, 0, 0, slot->op_start);
+    }
+
+    return rc;
+}
+
+/* AES-128 with the key schedule set up once */
+static int
+bench_alg_e_issue(struct bench_slot *slot)
+{
+    uint8_t out[16];
+
+    return bench_alg_done(slot, ble_sm_alg_e(&bench_alg_key, bench_payload,
+                                             out));
+}
+
+/* AES-128 with the key schedule set up for every block */
+static int
+bench_alg_e_key_issue(struct bench_slot *slot)
+{
+    struct ble_sm_alg_key key;
+    uint8_t out[16];
+    int rc;
+
+    rc = ble_sm_alg_key_init(&key, bench_payload);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return bench_alg_done(slot, ble_sm_alg_e(&key, bench_payload, out));
+}
+
+/* An address none of the IRKs resolves, so every IRK is tried */
+static int
+bench_alg_resolve_issue(struct bench_slot *slot)
+{
+    uint8_t rpa[6] = { 0 };
+    int rc;
+
+    rpa[5] = 0x40;
+
+    rc = ble_sm_alg_rpa_resolve(bench_alg_irks, BENCH_ALG_IRKS, rpa, NULL);
+    if (rc != BLE_HS_ENOENT) {
+        return rc == 0 ? BLE_HS_EUNKNOWN : rc;
+    }
+
+    return bench_alg_done(slot, 0);
+}
+
+static int
+bench_alg_f4_issue(struct bench_slot *slot)
+{
+    uint8_t out[16];
+
+    return bench_alg_done(slot, ble_sm_alg_f4(bench_payload,
+                                              bench_payload + 32,
+                                              bench_payload + 64, 0, out));
+}
+
+static int
+bench_alg_f5_issue(struct bench_slot *slot)
+{
+    uint8_t mackey[16];
+    uint8_t ltk[16];
+    uint8_t addr[6] = { 0 };
+
+    return bench_alg_done(slot, ble_sm_alg_f5(bench_payload,
+                                              bench_payload + 32,
+                                              bench_payload + 48, 0, addr,
+                                              0, addr, mackey, ltk));
+}
+
+static int
+bench_alg_f6_issue(struct bench_slot *slot)
+{
+    uint8_t out[16];
+    uint8_t addr[6] = { 0 };
+
+    return bench_alg_done(slot, ble_sm_alg_f6(bench_payload,
+                                              bench_payload + 16,
+                                              bench_payload + 32,
+                                              bench_payload + 48,
+                                              bench_payload + 64, 0, addr,
+                                              0, addr, out));
+}
+
+static int
+bench_alg_g2_issue(struct bench_slot *slot)
+{
+    uint32_t passkey;
+
+    return bench_alg_done(slot, ble_sm_alg_g2(bench_payload,
+                                              bench_payload + 32,
+                                              bench_payload + 64,
+                                              bench_payload + 80, &passkey));
+}
+
+static int
+bench_alg_keygen_issue(struct bench_slot *slot)
+{
+    uint8_t pub[64];
+    uint8_t priv[32];
+
+    return bench_alg_done(slot, ble_sm_alg_gen_key_pair(pub, priv));
+}
+
+/* Peer key pair for sm_alg_dhkey; generated once */
+static uint8_t bench_alg_peer_pub[64];
+static uint8_t bench_alg_priv[32];
+
+static int
+bench_alg_dhkey_start(void)
+{
+    uint8_t pub[64];
+    uint8_t priv[32];
+    int rc;
+
+    rc = ble_sm_alg_gen_key_pair(bench_alg_peer_pub, priv);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return ble_sm_alg_gen_key_pair(pub, bench_alg_priv);
+}
+
+static int
+bench_alg_dhkey_issue(struct bench_slot *slot)
+{
+    uint8_t dhkey[32];
+
+    return bench_alg_done(slot, ble_sm_alg_gen_dhkey(bench_alg_peer_pub,
+                                                     bench_alg_peer_pub + 32,
+                                                     bench_alg_priv, dhkey));
+}
+
+/*** Advertising reports */
+
+/*
+ * Fills in a report carrying its slot and timestamp: flags, then
+ * manufacturer data with company ID 0xffff, the slot and the timestamp.
+ */
+static void
+bench_adv_fill(struct bench_slot *slot, uint8_t *data)
+{
+    data[0] = 2;
+    data[1] = BLE_HS_ADV_TYPE_FLAGS;
+    data[2] = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+    data[3] = BENCH_ADV_DATA_LEN - 4;
+    data[4] = BLE_HS_ADV_TYPE_MFG_DATA;
+    put_le16(&data[5], 0xffff);
+    data[7] = slot - bench_adv_slots;
+    put_le64(&data[8], slot->op_start);
+}
+
+/* Completes the operation the report was filled in for, if it is one */
+static void
+bench_adv_rx(const uint8_t *data, uint16_t len, uint32_t bytes)
+{
+    if ((len != BENCH_ADV_DATA_LEN) || (data[7] >= BENCH_ADV_DEPTH)) {
+        return;
+    }
+
+    bench_op_done(&bench_adv_slots[data[7]], 0, bytes, get_le64(&data[8]));
+}
+
+static int
+bench_disc_event(struct ble_gap_event *event, void *arg)
+{
+    if (event->type == BLE_GAP_EVENT_EXT_DISC) {
+        bench_adv_rx(event->ext_disc.data, event->ext_disc.length_data,
+                     event->ext_disc.length_data);
+    }
+
+    return 0;
+}
+
+static int
+bench_disc_start(ble_gap_event_fn *cb)
+{
+    struct ble_gap_disc_params params;
+
+    memset(&params, 0, sizeof(params));
+    params.passive = 1;
+
+    return ble_gap_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER, &params, cb,
+                        NULL);
+}
+
+static int
+bench_adv_start(void)
+{
+    return bench_disc_start(bench_disc_event);
+}
+
+static void
+bench_adv_stop(void)
+{
+    ble_gap_disc_cancel();
+}
+
+static int
+bench_adv_issue(struct bench_slot *slot)
+{
+    uint8_t data[BENCH_ADV_DATA_LEN];
+    struct vctrl_adv adv;
+
+    bench_adv_fill(slot, data);
+
+    memset(&adv, 0, sizeof(adv));
+    adv.addr.type = BLE_ADDR_RANDOM;
+    put_le32(adv.addr.val, bench_run.ops_issued);
+    adv.addr.val[5] = 0xc0;
+    adv.props = BLE_HCI_LEGACY_ADV_EVTYPE_ADV_IND;
+    adv.sid = 0xff;
+    adv.rssi = -50;
+    adv.len = sizeof(data);
+    adv.data = data;
+
+    return vctrl_adv_report(&adv);
+}
+
+/*** Batched advertising reports */
+
+static int
+bench_batch_event(struct ble_gap_event *event, void *arg)
+{
+    const struct ble_gap_disc_batch_report *rpt;
+    int i;
+
+    if (event->type != BLE_GAP_EVENT_DISC_BATCH) {
+        return 0;
+    }
+
+    for (i = 0; i < event->disc_batch.num_reports; i++) {
+        rpt = &event->disc_batch.reports[i];
+        bench_adv_rx(rpt->desc.data, rpt->desc.length_data,
+                     rpt->desc.length_data);
+    }
+
+    return 0;
+}
+
+static int
+bench_batch_start(void)
+{
+    struct ble_gap_disc_batch_params params;
+    int rc;
+
+    /* A batch per round of outstanding reports; the interval only matters
+     * if a report gets lost.
+     */
+    memset(&params, 0, sizeof(params));
+    params.max_reports = BENCH_ADV_DEPTH;
+    params.flush_itvl_ms = 100;
+
+    rc = ble_gap_disc_batch_set(&params);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return bench_disc_start(bench_batch_event);
+}
+
+static void
+bench_batch_stop(void)
+{
+    ble_gap_disc_cancel();
+    ble_gap_disc_batch_set(NULL);
+}
+
+/*** Advertisement monitor */
+
+/*
+ * Each operation replays the whole recording followed by a marker report;
+ * the operation completes when the marker reaches its filter. The marker
+ * comes last, so by then the monitor has seen the complete recording.
+ */
+static const ble_addr_t bench_mon_marker_addr = {
+    BLE_ADDR_RANDOM, { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }
+};
+
+/* Heart rate monitor in the recording */
+static const ble_addr_t bench_mon_device_addr = {
+    BLE_ADDR_PUBLIC, { 0x07, 0x11, 0x22, 0x33, 0x44, 0x00 }
+};
+
+static uint8_t bench_mon_ids[BENCH_MON_COUNT];
+static uint32_t bench_mon_pass_len;
+
+static int
+bench_mon_event(struct ble_gap_event *event, void *arg)
+{
+    if ((event->type == BLE_GAP_EVENT_ADV_MON) &&
+        (event->adv_mon.filter_id == bench_mon_ids[BENCH_MON_MARKER])) {
+        bench_adv_rx(event->adv_mon.data, event->adv_mon.length_data,
+                     bench_mon_pass_len);
+    }
+
+    return 0;
+}
+
+static void
+bench_mon_filter(enum bench_mon mon, struct ble_gap_adv_mon_filter *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+
+    switch (mon) {
+    case BENCH_MON_IBEACON:
+        filter->criteria = BLE_GAP_ADV_MON_F_MFG;
+        filter->company_id = 0x004c;
+        filter->mfg_prefix[0] = 0x02;
+        filter->mfg_prefix[1] = 0x15;
+        filter->mfg_prefix_len = 2;
+        break;
+
+    case BENCH_MON_EDDYSTONE:
+        filter->criteria = BLE_GAP_ADV_MON_F_UUID;
+        filter->uuid.u16 = (ble_uuid16_t)BLE_UUID16_INIT(0xfeaa);
+        break;
+
+    case BENCH_MON_HRM:
+        filter->criteria = BLE_GAP_ADV_MON_F_UUID | BLE_GAP_ADV_MON_F_RSSI;
+        filter->uuid.u16 = (ble_uuid16_t)BLE_UUID16_INIT(0x180d);
+        filter->rssi_min = -70;
+        break;
+
+    case BENCH_MON_SENSOR:
+        filter->criteria = BLE_GAP_ADV_MON_F_MFG;
+        filter->company_id = 0x0059;
+        break;
+
+    case BENCH_MON_AUDIO:
+        filter->criteria = BLE_GAP_ADV_MON_F_UUID;
+        filter->uuid.u16 = (ble_uuid16_t)BLE_UUID16_INIT(0x1852);
+        break;
+
+    case BENCH_MON_DEVICE:
+        filter->criteria = BLE_GAP_ADV_MON_F_ADDR | BLE_GAP_ADV_MON_F_AD_TYPE;
+        filter->addr = bench_mon_device_addr;
+        filter->ad_type = BLE_HS_ADV_TYPE_COMP_NAME;
+        break;
+
+    case BENCH_MON_MARKER:
+        filter->criteria = BLE_GAP_ADV_MON_F_ADDR;
+        filter->addr = bench_mon_marker_addr;
+        break;
+
+    default:
+        assert(0);
+        break;
+    }
+}
+
+static int
+bench_mon_start(void)
+{
+    struct ble_gap_adv_mon_filter filter;
+    struct ble_gap_adv_mon_stats stats;
+    int rc;
+    int i;
+
+    bench_mon_pass_len = BENCH_ADV_DATA_LEN;
+    for (i = 0; i < bench_adv_rec_count; i++) {
+        bench_mon_pass_len += bench_adv_recs[i].adv.len;
+    }
+
+    for (i = 0; i < BENCH_MON_COUNT; i++) {
+        bench_mon_filter(i, &filter);
+        rc = ble_gap_adv_mon_add(&filter, bench_mon_event, NULL,
+                                 &bench_mon_ids[i]);
+        if (rc != 0) {
+            while (i--) {
+                ble_gap_adv_mon_remove(bench_mon_ids[i]);
+            }
+            return rc;
+        }
+    }
+
+    ble_gap_adv_mon_stats(&stats, 1);
+
+    return bench_disc_start(bench_mon_event);
+}
+
+static void
+bench_mon_stop(void)
+{
+    uint32_t expected;
+    uint32_t hits;
+    int rc;
+    int i;
+    int j;
+
+    ble_gap_disc_cancel();
+
+    for (i = 0; i < BENCH_MON_COUNT; i++) {
+        /* Replays cut short by an error leave the counts undefined */
+        if (bench_run.errors == 0) {
+            expected = (i == BENCH_MON_MARKER);
+            for (j = 0; j < bench_adv_rec_count; j++) {
+                expected += !!(bench_adv_recs[j].match & (1 << i));
+            }
+            expected *= bench_run.ops_done;
+
+            hits = 0;
+            rc = ble_gap_adv_mon_hits(bench_mon_ids[i], &hits);
+            if ((rc != 0) || (hits != expected)) {
+                fprintf(stderr, "%s: filter %d matched %u reports, "
+                        "expected %u; rc=%d\n", bench_run.def->name, i,
+                        hits, expected, rc);
+                bench_run.errors++;
+            }
+        }
+
+        ble_gap_adv_mon_remove(bench_mon_ids[i]);
+    }
+}
+
+static int
+bench_mon_issue(struct bench_slot *slot)
+{
+    uint8_t data[BENCH_ADV_DATA_LEN];
+    struct vctrl_adv adv;
+    int rc;
+    int i;
+
+    for (i = 0; i < bench_adv_rec_count; i++) {
+        rc = vctrl_adv_report(&bench_adv_recs[i].adv);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    bench_adv_fill(slot, data);
+
+    memset(&adv, 0, sizeof(adv));
+    adv.addr = bench_mon_marker_addr;
+    adv.props = BLE_HCI_LEGACY_ADV_EVTYPE_ADV_NONCON_IND;
+    adv.sid = 0xff;
+    adv.rssi = -50;
+    adv.len = sizeof(data);
+    adv.data = data;
+
+    return vctrl_adv_report(&adv);
+}
+static const struct bench_def bench_defs[] = {
+    {
+        .name = "att_read",
+        .uses_conns = 1,
+        .issue = bench_att_read_issue,
+    },
+    {
+        .name = "att_write",
+        .uses_conns = 1,
+        .issue = bench_att_write_issue,
+    },
+    {
+        .name = "att_notify",
+        .uses_conns = 1,
+        .issue = bench_att_notify_issue,
+    },
+    {
+        .name = "gatt_disc",
+        .uses_conns = 1,
+        .issue = bench_disc_issue,
+    },
+    {
+        .name = "l2cap_coc",
+        .uses_conns = 1,
+        .prepare = bench_coc_prepare,
+        .issue = bench_coc_issue,
+    },
+    {
+        .name = "l2cap_coc_64k",
+        .uses_conns = 1,
+        .prepare = bench_coc_prepare,
+        .start = bench_coc_max_start,
+        .stop = bench_coc_max_stop,
+        .issue = bench_coc_issue,
+    },
+    {
+        .name = "sm_pair",
+        .uses_conns = 1,
+        .issue = bench_sm_issue,
+    },
+    {
+        .name = "adv_report",
+        .uses_conns = 0,
+        .start = bench_adv_start,
+        .stop = bench_adv_stop,
+        .issue = bench_adv_issue,
+    },
+    {
+        .name = "adv_batch",
+        .uses_conns = 0,
+        .start = bench_batch_start,
+        .stop = bench_batch_stop,
+        .issue = bench_adv_issue,
+    },
+    {
+        .name = "adv_mon",
+        .uses_conns = 0,
+        .start = bench_mon_start,
+        .stop = bench_mon_stop,
+        .issue = bench_mon_issue,
+    },
+    {
+        .name = "sm_alg_e",
+        .uses_conns = 0,
+        .start = bench_alg_start,
+        .issue = bench_alg_e_issue,
+    },
+    {
+        .name = "sm_alg_e_key",
+        .uses_conns = 0,
+        .issue = bench_alg_e_key_issue,
+    },
+    {
+        .name = "sm_alg_resolve",
+        .uses_conns = 0,
+        .start = bench_alg_start,
+        .issue = bench_alg_resolve_issue,
+    },
+    {
+        .name = "sm_alg_f4",
+        .uses_conns = 0,
+        .issue = bench_alg_f4_issue,
+    },
+    {
+        .name = "sm_alg_f5",
+        .uses_conns = 0,
+        .issue = bench_alg_f5_issue,
+    },
+    {
+        .name = "sm_alg_f6",
+        .uses_conns = 0,
+        .issue = bench_alg_f6_issue,
+    },
+    {
+        .name = "sm_alg_g2",
+        .uses_conns = 0,
+        .issue = bench_alg_g2_issue,
+    },
+    {
+        .name = "sm_alg_keygen",
+        .uses_conns = 0,
+        .issue = bench_alg_keygen_issue,
+    },
+    {
+        .name = "sm_alg_dhkey",
+        .uses_conns = 0,
+        .start = bench_alg_dhkey_start,
+        .issue = bench_alg_dhkey_issue,
+    },
+};
+
+/*** Runner (main thread) */
+
+static int
+bench_lat_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double
+bench_lat_pct_us(int pct)
+{
+    if (bench_run.lat_count == 0) {
+        return 0;
+    }
+
+    return bench_run.lat_ns[(bench_run.lat_count - 1) * pct / 100] / 1000.0;
+}
+
+static void
+bench_report(void)
+{
+    double elapsed_s;
+
+    qsort(bench_run.lat_ns, bench_run.lat_count, sizeof(bench_run.lat_ns[0]),
+          bench_lat_cmp);
+
+    elapsed_s = (bench_run.end_ns - bench_run.start_ns) / 1e9;
+    if (elapsed_s <= 0) {
+        elapsed_s = 1e-9;
+    }
+
+    printf("{\"bench\":\"%s\",\"conns\":%d,\"ops\":%u,\"errors\":%u,"
+           "\"elapsed_us\":%.0f,\"ops_per_sec\":%.1f,\"bytes_per_sec\":%.1f,"
+           "\"p50_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f}\n",
+           bench_run.def->name, bench_run.conns, bench_run.ops,
+           bench_run.errors, elapsed_s * 1e6, bench_run.ops / elapsed_s,
+           bench_run.bytes / elapsed_s, bench_lat_pct_us(50),
+           bench_lat_pct_us(99), bench_lat_pct_us(100));
+    fflush(stdout);
+}
+
+static int
+bench_run_one(const struct bench_def *def, int conns, int ops)
+{
+    int rc;
+
+    memset(&bench_run, 0, sizeof(bench_run));
+    bench_run.def = def;
+    bench_run.conns = conns;
+    bench_run.slots = def->uses_conns ? conns : BENCH_ADV_DEPTH;
+    bench_run.ops = bench_run.slots * ops;
+    bench_run.lat_ns = calloc(bench_run.ops, sizeof(bench_run.lat_ns[0]));
+    if (bench_run.lat_ns == NULL) {
+        return -1;
+    }
+
+    ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &bench_start_ev);
+
+    rc = ble_npl_sem_pend(&bench_sem,
+                          ble_npl_time_ms_to_ticks32(BENCH_TIMEOUT_MS));
+    if (rc != 0) {
+        /* The host task is still busy with the run, nothing is safe to
+         * touch; give up on the whole suite.
+         */
+        fprintf(stderr, "%s: timed out with %d connections (%u/%u ops)\n",
+                def->name, conns, bench_run.ops_done, bench_run.ops);
+        exit(1);
+    }
+
+    if (!bench_run.failed) {
+        bench_report();
+    }
+
+    free(bench_run.lat_ns);
+    bench_run.lat_ns = NULL;
+
+    return (bench_run.failed || bench_run.errors) ? -1 : 0;
+}
+
+int
+bench_run_all(const struct bench_opts *opts)
+{
+    const struct bench_def *def;
+    int failed;
+    int conns;
+    int i;
+
+    /* Wait for the host to sync with the controller */
+    ble_npl_sem_pend(&bench_sem, BLE_NPL_TIME_FOREVER);
+
+    failed = 0;
+
+    for (i = 0; i < ARRAY_SIZE(bench_defs); i++) {
+        def = &bench_defs[i];
+
+        if (opts->filter &&
+            strncmp(def->name, opts->filter, strlen(opts->filter))) {
+            continue;
+        }
+
+        if (!def->uses_conns) {
+            failed |= bench_run_one(def, 0, opts->ops);
+            continue;
+        }
+
+        /* 1, 2, 4, ... and max_conns itself */
+        for (conns = 1; conns < opts->max_conns; conns *= 2) {
+            failed |= bench_run_one(def, conns, opts->ops);
+        }
+        failed |= bench_run_one(def, opts->max_conns, opts->ops);
+    }
+
+    return failed ? 1 : 0;
+}
+
+/*** Host setup */
+
+static int
+bench_chr_access(uint16_t conn_handle, uint16_t attr_handle,
+                 struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    return os_mbuf_append(ctxt->om, bench_payload, BENCH_NOTIFY_LEN) ?
+           BLE_ATT_ERR_INSUFFICIENT_RES : 0;
+}
+
+static const struct ble_gatt_svc_def bench_svcs[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = BLE_UUID16_DECLARE(0xc000),
+        .characteristics = (struct ble_gatt_chr_def[]) { {
+            .uuid = BLE_UUID16_DECLARE(0xc001),
+            .access_cb = bench_chr_access,
+            .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+            .val_handle = &bench_notify_val_handle,
+        }, {
+            0,
+        } },
+    },
+    {
+        0,
+    },
+};
+
+static void
+bench_on_sync(void)
+{
+    ble_npl_sem_release(&bench_sem);
+}
+
+static void
+bench_on_reset(int reason)
+{
+    fprintf(stderr, "host reset; reason=%d\n", reason);
+    exit(1);
+}
+
+void
+bench_init(void)
+{
+    int rc;
+    int i;
+
+    for (i = 0; i < sizeof(bench_payload); i++) {
+        bench_payload[i] = i;
+    }
+
+    for (i = 0; i < BENCH_MAX_CONNS; i++) {
+        ble_npl_event_init(&bench_conns[i].ev, bench_issue_ev,
+                           &bench_conns[i]);
+    }
+    for (i = 0; i < BENCH_ADV_DEPTH; i++) {
+        ble_npl_event_init(&bench_adv_slots[i].ev, bench_issue_ev,
+                           &bench_adv_slots[i]);
+    }
+
+    ble_npl_event_init(&bench_start_ev, bench_start_ev_fn, NULL);
+    ble_npl_sem_init(&bench_sem, 0);
+
+    rc = ble_gatts_count_cfg(bench_svcs);
+    assert(rc == 0);
+
+    rc = ble_gatts_add_svcs(bench_svcs);
+    assert(rc == 0);
+
+    ble_hs_cfg.sync_cb = bench_on_sync;
+    ble_hs_cfg.reset_cb = bench_on_reset;
+}
+
+void
+nimble_host_task(void *param)
+{
+    ble_svc_gap_device_name_set("nimble-bench");
+
+    nimble_port_run();
+}
@@ -0,0 +1,107 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BENCH_
+#define H_BENCH_
+
+#include <stdint.h>
+#include "nimble/ble.h"
+
+/*
+ * The virtual controller (vctrl.c) answers HCI commands in-process and plays
+ * the remote peer of every connection. The peer exposes a fixed GATT
+ * database of VCTRL_SVC_COUNT primary services, each holding
+ * VCTRL_CHR_PER_SVC characteristics, and accepts L2CAP CoC connections on
+ * any PSM.
+ */
+#define VCTRL_SVC_COUNT             (8)
+#define VCTRL_CHR_PER_SVC           (4)
+
+/* Value handle of the first characteristic of the first service */
+#define VCTRL_ATT_VAL_HANDLE        (3)
+#define VCTRL_ATT_VAL_LEN           (20)
+
+#define VCTRL_ATT_MTU               (247)
+#define VCTRL_COC_MTU               (0xffff)
+#define VCTRL_COC_MPS               (247)
+
+/** Returns the address of the idx-th connectable peer. */
+void vctrl_peer_addr(int idx, ble_addr_t *addr);
+
+/** An advertising report, as received over the air. */
+struct vctrl_adv {
+    ble_addr_t addr;
+    /* BLE_HCI_ADV_*_MASK bits; BLE_HCI_ADV_LEGACY_MASK for legacy PDUs */
+    uint16_t props;
+    /* 0xff if not present */
+    uint8_t sid;
+    int8_t rssi;
+    uint16_t len;
+    const uint8_t *data;
+};
+
+/**
+ * Injects an advertising report, fragmented into extended advertising report
+ * events as needed. Reports are only delivered while the host scans.
+ *
+ * @return int 0 on success; nonzero if no event buffer was available.
+ */
+int vctrl_adv_report(const struct vctrl_adv *adv);
+
+/* Advertisement monitor filters registered by the adv_mon benchmark */
+enum bench_mon {
+    BENCH_MON_IBEACON,
+    BENCH_MON_EDDYSTONE,
+    BENCH_MON_HRM,
+    BENCH_MON_SENSOR,
+    BENCH_MON_AUDIO,
+    BENCH_MON_DEVICE,
+    BENCH_MON_MARKER,
+    BENCH_MON_COUNT,
+};
+
+/** A recorded advertising report and the filters it is expected to match. */
+struct bench_adv_rec {
+    struct vctrl_adv adv;
+    /* (1 << BENCH_MON_*) bits */
+    uint8_t match;
+};
+
+/* Recorded advertising traffic; see adv_rec.c */
+extern const struct bench_adv_rec bench_adv_recs[];
+extern const int bench_adv_rec_count;
+
+/* Called by the virtual peer, in the host task context */
+void bench_peer_notify_rx(uint16_t conn_handle, uint16_t attr_handle,
+                          uint16_t len);
+void bench_peer_coc_sdu_rx(uint16_t conn_handle, uint16_t len);
+
+struct bench_opts {
+    /* Operations per connection in each run */
+    int ops;
+    /* Largest connection count runs are scaled up to */
+    int max_conns;
+    /* Run only benchmarks whose name starts with this; NULL runs all */
+    const char *filter;
+};
+
+void bench_init(void);
+int bench_run_all(const struct bench_opts *opts);
+
+#endif /* H_BENCH_ */
@@ -0,0 +1,103 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+#include "nimble/nimble_npl.h"
+#include "nimble/nimble_port.h"
+
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+#include "bench.h"
+
+static struct ble_npl_task s_task_host;
+
+void nimble_host_task(void *param);
+
+#define TASK_DEFAULT_PRIORITY       1
+#define TASK_DEFAULT_STACK          NULL
+#define TASK_DEFAULT_STACK_SIZE     400
+
+void *ble_host_task(void *param)
+{
+    nimble_host_task(param);
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n ops] [-c max_conns] [-b bench]\n"
+            "  -n ops        operations per connection (default 1000)\n"
+            "  -c max_conns  scale runs up to this many connections "
+            "(default %d)\n"
+            "  -b bench      only run benchmarks whose name starts with "
+            "bench\n", prog, MYNEWT_VAL(BLE_MAX_CONNECTIONS));
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_opts opts = {
+        .ops = 1000,
+        .max_conns = MYNEWT_VAL(BLE_MAX_CONNECTIONS),
+        .filter = NULL,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:c:b:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            opts.ops = atoi(optarg);
+            break;
+        case 'c':
+            opts.max_conns = atoi(optarg);
+            break;
+        case 'b':
+            opts.filter = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if ((opts.ops <= 0) || (opts.max_conns <= 0) ||
+        (opts.max_conns > MYNEWT_VAL(BLE_MAX_CONNECTIONS))) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    nimble_port_init();
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+
+    bench_init();
+
+    /* Create task which handles default event queue for host stack. */
+    ble_npl_task_init(&s_task_host, "ble_host", ble_host_task,
+                      NULL, TASK_DEFAULT_PRIORITY, BLE_NPL_TIME_FOREVER,
+                      TASK_DEFAULT_STACK, TASK_DEFAULT_STACK_SIZE);
+
+    return bench_run_all(&opts);
+}
@@ -0,0 +1,1026 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Virtual controller for the host benchmarks.
+ *
+ * Replaces the HCI transport with an in-process controller which answers
+ * commands synchronously, in the context of the host task issuing them, and
+ * which also plays the remote peer of every connection: a GATT server with a
+ * fixed database, an L2CAP CoC sink and a legacy Just Works SM responder.
+ * Nothing is timed on the virtual side, so everything the benchmarks measure
+ * is host processing (and the HCI buffer handling around it).
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "os/os_mbuf.h"
+#include "nimble/ble.h"
+#include "nimble/hci_common.h"
+#include "nimble/transport.h"
+#include "ble_hs_priv.h"
+#include "bench.h"
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef max
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define VCTRL_MAX_CONNS         MYNEWT_VAL(BLE_MAX_CONNECTIONS)
+
+#define VCTRL_ACL_BUF_LEN       (251)
+#define VCTRL_ACL_BUF_NUM       (16)
+
+/* Largest L2CAP PDU the peer reassembles: a full K-frame */
+#define VCTRL_RX_BUF_LEN        (BLE_L2CAP_HDR_SZ + VCTRL_COC_MPS + 2)
+
+/* Most advertising data an extended advertising report event carries */
+#define VCTRL_ADV_FRAG_LEN      (229)
+
+#define VCTRL_COC_CID           (0x0040)
+#define VCTRL_COC_CREDITS       (16)
+
+/* Handles per service: service declaration plus declaration and value per
+ * characteristic.
+ */
+#define VCTRL_SVC_HANDLES       (1 + 2 * VCTRL_CHR_PER_SVC)
+#define VCTRL_LAST_HANDLE       (VCTRL_SVC_COUNT * VCTRL_SVC_HANDLES)
+
+#define VCTRL_SVC_UUID_BASE     (0xa000)
+#define VCTRL_CHR_UUID_BASE     (0xb000)
+
+struct vctrl_conn {
+    uint8_t used;
+    uint8_t encrypted;
+    ble_addr_t peer_addr;
+    uint16_t att_mtu;
+    uint8_t sig_id;
+
+    /* L2CAP PDU reassembly */
+    uint16_t rx_len;
+    uint8_t rx_buf[VCTRL_RX_BUF_LEN];
+
+    /* SM responder state */
+    uint8_t preq[7];
+    uint8_t pres[7];
+    uint8_t srand[16];
+
+    /* CoC channel; host side CID is 0 if not connected */
+    uint16_t coc_scid;
+    uint8_t coc_in_sdu;
+    uint16_t coc_sdu_len;
+    uint16_t coc_sdu_rx;
+    uint16_t coc_credits_used;
+};
+
+static struct vctrl_conn vctrl_conns[VCTRL_MAX_CONNS];
+
+static const uint8_t vctrl_bd_addr[6] = { 0x01, 0x00, 0x00, 0x0b, 0xc0, 0xde };
+
+void
+vctrl_peer_addr(int idx, ble_addr_t *addr)
+{
+    addr->type = BLE_ADDR_PUBLIC;
+    addr->val[0] = idx;
+    addr->val[1] = 0x00;
+    addr->val[2] = 0x00;
+    addr->val[3] = 0x0b;
+    addr->val[4] = 0xee;
+    addr->val[5] = 0xfe;
+}
+
+static struct vctrl_conn *
+vctrl_conn_find(uint16_t conn_handle)
+{
+    if ((conn_handle < VCTRL_MAX_CONNS) && vctrl_conns[conn_handle].used) {
+        return &vctrl_conns[conn_handle];
+    }
+
+    return NULL;
+}
+
+static uint16_t
+vctrl_conn_handle(const struct vctrl_conn *conn)
+{
+    return conn - vctrl_conns;
+}
+
+static struct ble_hci_ev *
+vctrl_evt_get(uint8_t opcode, uint8_t len)
+{
+    struct ble_hci_ev *ev;
+
+    ev = ble_transport_alloc_evt(0);
+    if (ev == NULL) {
+        fprintf(stderr, "vctrl: out of event buffers\n");
+        return NULL;
+    }
+
+    ev->opcode = opcode;
+    ev->length = len;
+
+    return ev;
+}
+
+static void
+vctrl_cmd_complete(uint16_t opcode, uint8_t status, const void *rp,
+                   uint8_t rp_len)
+{
+    struct ble_hci_ev_command_complete *cc;
+    struct ble_hci_ev *ev;
+
+    ev = vctrl_evt_get(BLE_HCI_EVCODE_COMMAND_COMPLETE, sizeof(*cc) + rp_len);
+    if (ev == NULL) {
+        return;
+    }
+
+    cc = (void *)ev->data;
+    cc->num_packets = 1;
+    cc->opcode = htole16(opcode);
+    cc->status = status;
+    if (rp_len > 0) {
+        memcpy(cc->return_params, rp, rp_len);
+    }
+
+    ble_transport_to_hs_evt(ev);
+}
+
+static void
+vctrl_cmd_status(uint16_t opcode, uint8_t status)
+{
+    struct ble_hci_ev_command_status *cs;
+    struct ble_hci_ev *ev;
+
+    ev = vctrl_evt_get(BLE_HCI_EVCODE_COMMAND_STATUS, sizeof(*cs));
+    if (ev == NULL) {
+        return;
+    }
+
+    cs = (void *)ev->data;
+    cs->status = status;
+    cs->num_packets = 1;
+    cs->opcode = htole16(opcode);
+
+    ble_transport_to_hs_evt(ev);
+}
+
+static void
+vctrl_num_comp_pkts(uint16_t conn_handle)
+{
+    struct ble_hci_ev_num_comp_pkts *ncp;
+    struct ble_hci_ev *ev;
+
+    ev = vctrl_evt_get(BLE_HCI_EVCODE_NUM_COMP_PKTS,
+                       sizeof(*ncp) + sizeof(ncp->completed[0]));
+    if (ev == NULL) {
+        return;
+    }
+
+    ncp = (void *)ev->data;
+    ncp->count = 1;
+    ncp->completed[0].handle = htole16(conn_handle);
+    ncp->completed[0].packets = htole16(1);
+
+    ble_transport_to_hs_evt(ev);
+}
+
+static void
+vctrl_le_create_conn(uint16_t opcode, uint8_t peer_addr_type,
+                     const uint8_t *peer_addr, uint16_t itvl,
+                     uint16_t latency, uint16_t tmo)
+{
+    struct ble_hci_ev_le_subev_conn_complete *cc;
+    struct vctrl_conn *conn;
+    struct ble_hci_ev *ev;
+    int i;
+
+    conn = NULL;
+    for (i = 0; i < VCTRL_MAX_CONNS; i++) {
+        if (!vctrl_conns[i].used) {
+            conn = &vctrl_conns[i];
+            break;
+        }
+    }
+
+    if (conn == NULL) {
+        vctrl_cmd_status(opcode, BLE_ERR_CONN_LIMIT);
+        return;
+    }
+
+    vctrl_cmd_status(opcode, 0);
+
+    memset(conn, 0, sizeof(*conn));
+    conn->used = 1;
+    conn->att_mtu = BLE_ATT_MTU_DFLT;
+    conn->peer_addr.type = peer_addr_type;
+    memcpy(conn->peer_addr.val, peer_addr, 6);
+
+    ev = vctrl_evt_get(BLE_HCI_EVCODE_LE_META, sizeof(*cc));
+    if (ev == NULL) {
+        return;
+    }
+
+    cc = (void *)ev->data;
+    cc->subev_code = BLE_HCI_LE_SUBEV_CONN_COMPLETE;
+    cc->status = 0;
+    cc->conn_handle = htole16(vctrl_conn_handle(conn));
+    cc->role = BLE_HCI_LE_CONN_COMPLETE_ROLE_MASTER;
+    cc->peer_addr_type = peer_addr_type;
+    memcpy(cc->peer_addr, peer_addr, 6);
+    cc->conn_itvl = itvl;
+    cc->conn_latency = latency;
+    cc->supervision_timeout = tmo;
+    cc->mca = 0;
+
+    ble_transport_to_hs_evt(ev);
+}
+
+static void
+vctrl_disconnect(const struct ble_hci_lc_disconnect_cp *cp)
+{
+    struct ble_hci_ev_disconn_cmp *dc;
+    struct vctrl_conn *conn;
+    struct ble_hci_ev *ev;
+    uint16_t opcode;
+
+    opcode = BLE_HCI_OP(BLE_HCI_OGF_LINK_CTRL, BLE_HCI_OCF_DISCONNECT_CMD);
+
+    conn = vctrl_conn_find(le16toh(cp->conn_handle));
+    if (conn == NULL) {
+        vctrl_cmd_status(opcode, BLE_ERR_UNK_CONN_ID);
+        return;
+    }
+
+    vctrl_cmd_status(opcode, 0);
+    conn->used = 0;
+
+    ev = vctrl_evt_get(BLE_HCI_EVCODE_DISCONN_CMP, sizeof(*dc));
+    if (ev == NULL) {
+        return;
+    }
+
+    dc = (void *)ev->data;
+    dc->status = 0;
+    dc->conn_handle = cp->conn_handle;
+    dc->reason = BLE_ERR_CONN_TERM_LOCAL;
+
+    ble_transport_to_hs_evt(ev);
+}
+
+static void
+vctrl_start_encrypt(const struct ble_hci_le_start_encrypt_cp *cp)
+{
+    struct ble_hci_ev_enc_key_refresh *kr;
+    struct ble_hci_ev_enrypt_chg *ec;
+    struct vctrl_conn *conn;
+    struct ble_hci_ev *ev;
+    uint16_t opcode;
+
+    opcode = BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_START_ENCRYPT);
+
+    conn = vctrl_conn_find(le16toh(cp->conn_handle));
+    if (conn == NULL) {
+        vctrl_cmd_status(opcode, BLE_ERR_UNK_CONN_ID);
+        return;
+    }
+
+    vctrl_cmd_status(opcode, 0);
+
+    if (conn->encrypted) {
+        ev = vctrl_evt_get(BLE_HCI_EVCODE_ENC_KEY_REFRESH, sizeof(*kr));
+        if (ev == NULL) {
+            return;
+        }
+
+        kr = (void *)ev->data;
+        kr->status = 0;
+        kr->conn_handle = cp->conn_handle;
+    } else {
+        ev = vctrl_evt_get(BLE_HCI_EVCODE_ENCRYPT_CHG, sizeof(*ec));
+        if (ev == NULL) {
+            return;
+        }
+
+        ec = (void *)ev->data;
+        ec->status = 0;
+        ec->connection_handle = cp->conn_handle;
+        ec->enabled = 1;
+        conn->encrypted = 1;
+    }
+
+    ble_transport_to_hs_evt(ev);
+}
+
+static void
+vctrl_rd_rem_feat(const struct ble_hci_le_rd_rem_feat_cp *cp)
+{
+    struct ble_hci_ev_le_subev_rd_rem_used_feat *rf;
+    struct ble_hci_ev *ev;
+    uint16_t opcode;
+
+    opcode = BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_REM_FEAT);
+
+    if (vctrl_conn_find(le16toh(cp->conn_handle)) == NULL) {
+        vctrl_cmd_status(opcode, BLE_ERR_UNK_CONN_ID);
+        return;
+    }
+
+    vctrl_cmd_status(opcode, 0);
+
+    ev = vctrl_evt_get(BLE_HCI_EVCODE_LE_META, sizeof(*rf));
+    if (ev == NULL) {
+        return;
+    }
+
+    rf = (void *)ev->data;
+    rf->subev_code = BLE_HCI_LE_SUBEV_RD_REM_USED_FEAT;
+    rf->status = 0;
+    rf->conn_handle = cp->conn_handle;
+    memset(rf->features, 0, sizeof(rf->features));
+
+    ble_transport_to_hs_evt(ev);
+}
+
+static void
+vctrl_conn_update(const struct ble_hci_le_conn_update_cp *cp)
+{
+    struct ble_hci_ev_le_subev_conn_upd_complete *cu;
+    struct ble_hci_ev *ev;
+    uint16_t opcode;
+
+    opcode = BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_CONN_UPDATE);
+
+    if (vctrl_conn_find(le16toh(cp->conn_handle)) == NULL) {
+        vctrl_cmd_status(opcode, BLE_ERR_UNK_CONN_ID);
+        return;
+    }
+
+    vctrl_cmd_status(opcode, 0);
+
+    ev = vctrl_evt_get(BLE_HCI_EVCODE_LE_META, sizeof(*cu));
+    if (ev == NULL) {
+        return;
+    }
+
+    cu = (void *)ev->data;
+    cu->subev_code = BLE_HCI_LE_SUBEV_CONN_UPD_COMPLETE;
+    cu->status = 0;
+    cu->conn_handle = cp->conn_handle;
+    cu->conn_itvl = cp->conn_itvl_max;
+    cu->conn_latency = cp->conn_latency;
+    cu->supervision_timeout = cp->supervision_timeout;
+
+    ble_transport_to_hs_evt(ev);
+}
+
+int
+ble_transport_to_ll_cmd_impl(void *buf)
+{
+    union {
+        struct ble_hci_ip_rd_local_ver_rp local_ver;
+        struct ble_hci_ip_rd_loc_supp_cmd_rp supp_cmd;
+        struct ble_hci_ip_rd_loc_supp_feat_rp supp_feat;
+        struct ble_hci_ip_rd_buf_size_rp buf_size;
+        struct ble_hci_ip_rd_bd_addr_rp bd_addr;
+        struct ble_hci_le_rd_buf_size_rp le_buf_size;
+        struct ble_hci_le_rd_loc_supp_feat_rp le_supp_feat;
+        struct ble_hci_le_rand_rp rand;
+    } rp;
+    const struct ble_hci_le_ext_create_conn_cp *cp_ext_conn;
+    const struct ble_hci_le_create_conn_cp *cp_conn;
+    struct ble_hci_cmd *cmd;
+    uint8_t cp[UINT8_MAX];
+    uint16_t opcode;
+    uint8_t rp_len;
+
+    cmd = buf;
+    opcode = le16toh(cmd->opcode);
+    memset(cp, 0, sizeof(cp));
+    memcpy(cp, cmd->data, cmd->length);
+    ble_transport_free(buf);
+
+    cp_conn = (void *)cp;
+    cp_ext_conn = (void *)cp;
+
+    memset(&rp, 0, sizeof(rp));
+    rp_len = 0;
+
+    switch (opcode) {
+    case BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOCAL_VER):
+        rp.local_ver.hci_ver = BLE_HCI_VER_BCS_5_0;
+        rp.local_ver.lmp_ver = BLE_LMP_VER_BCS_5_0;
+        rp.local_ver.manufacturer = htole16(0xffff);
+        rp_len = sizeof(rp.local_ver);
+        break;
+    case BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOC_SUPP_CMD):
+        rp_len = sizeof(rp.supp_cmd);
+        break;
+    case BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOC_SUPP_FEAT):
+        /* LE supported (Controller) and Simultaneous LE and BR/EDR */
+        rp.supp_feat.features = htole64(0x0000006000000000);
+        rp_len = sizeof(rp.supp_feat);
+        break;
+    case BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_BUF_SIZE):
+        rp.buf_size.acl_data_len = htole16(VCTRL_ACL_BUF_LEN);
+        rp.buf_size.acl_num = htole16(VCTRL_ACL_BUF_NUM);
+        rp_len = sizeof(rp.buf_size);
+        break;
+    case BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_BD_ADDR):
+        memcpy(rp.bd_addr.addr, vctrl_bd_addr, 6);
+        rp_len = sizeof(rp.bd_addr);
+        break;
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_BUF_SIZE):
+        rp.le_buf_size.data_len = htole16(VCTRL_ACL_BUF_LEN);
+        rp.le_buf_size.data_packets = VCTRL_ACL_BUF_NUM;
+        rp_len = sizeof(rp.le_buf_size);
+        break;
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT):
+        rp_len = sizeof(rp.le_supp_feat);
+        break;
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RAND):
+        rp.rand.random_number = ((uint64_t)random() << 32) | random();
+        rp_len = sizeof(rp.rand);
+        break;
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_CREATE_CONN):
+        vctrl_le_create_conn(opcode, cp_conn->peer_addr_type,
+                             cp_conn->peer_addr, cp_conn->min_conn_itvl,
+                             cp_conn->conn_latency, cp_conn->tmo);
+        return 0;
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_EXT_CREATE_CONN):
+        /* Parameters of the first PHY initiated on */
+        vctrl_le_create_conn(opcode, cp_ext_conn->peer_addr_type,
+                             cp_ext_conn->peer_addr,
+                             cp_ext_conn->conn_params[0].conn_min_itvl,
+                             cp_ext_conn->conn_params[0].conn_latency,
+                             cp_ext_conn->conn_params[0].supervision_timeout);
+        return 0;
+    case BLE_HCI_OP(BLE_HCI_OGF_LINK_CTRL, BLE_HCI_OCF_DISCONNECT_CMD):
+        vctrl_disconnect((void *)cp);
+        return 0;
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_START_ENCRYPT):
+        vctrl_start_encrypt((void *)cp);
+        return 0;
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_REM_FEAT):
+        vctrl_rd_rem_feat((void *)cp);
+        return 0;
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_CONN_UPDATE):
+        vctrl_conn_update((void *)cp);
+        return 0;
+    default:
+        /* Everything else only configures the controller; accept it */
+        break;
+    }
+
+    vctrl_cmd_complete(opcode, 0, &rp, rp_len);
+
+    return 0;
+}
+
+static void
+vctrl_l2cap_tx(struct vctrl_conn *conn, uint16_t cid, const void *data,
+               uint16_t len)
+{
+    struct hci_data_hdr hci_hdr;
+    struct os_mbuf *om;
+    uint8_t l2cap_hdr[BLE_L2CAP_HDR_SZ];
+
+    om = ble_transport_alloc_acl_from_ll();
+    if (om == NULL) {
+        fprintf(stderr, "vctrl: out of ACL buffers\n");
+        return;
+    }
+
+    hci_hdr.hdh_handle_pb_bc =
+        htole16(vctrl_conn_handle(conn) | (BLE_HCI_PB_FIRST_FLUSH << 12));
+    hci_hdr.hdh_len = htole16(BLE_L2CAP_HDR_SZ + len);
+    put_le16(&l2cap_hdr[0], len);
+    put_le16(&l2cap_hdr[2], cid);
+
+    if ((os_mbuf_append(om, &hci_hdr, sizeof(hci_hdr)) != 0) ||
+        (os_mbuf_append(om, l2cap_hdr, sizeof(l2cap_hdr)) != 0) ||
+        (os_mbuf_append(om, data, len) != 0)) {
+        fprintf(stderr, "vctrl: ACL buffer too small\n");
+        os_mbuf_free_chain(om);
+        return;
+    }
+
+    ble_transport_to_hs_acl(om);
+}
+
+static void
+vctrl_att_err(struct vctrl_conn *conn, uint8_t req_op, uint16_t handle,
+              uint8_t err)
+{
+    uint8_t rsp[5];
+
+    rsp[0] = BLE_ATT_OP_ERROR_RSP;
+    rsp[1] = req_op;
+    put_le16(&rsp[2], handle);
+    rsp[4] = err;
+
+    vctrl_l2cap_tx(conn, BLE_L2CAP_CID_ATT, rsp, sizeof(rsp));
+}
+
+static int
+vctrl_att_is_val_handle(uint16_t handle)
+{
+    uint16_t off;
+
+    if ((handle == 0) || (handle > VCTRL_LAST_HANDLE)) {
+        return 0;
+    }
+
+    off = (handle - 1) % VCTRL_SVC_HANDLES;
+
+    return (off != 0) && !(off & 1);
+}
+
+static void
+vctrl_att_read_group_type(struct vctrl_conn *conn, const uint8_t *req,
+                          uint16_t len)
+{
+    uint8_t rsp[VCTRL_ATT_MTU];
+    uint16_t start;
+    uint16_t end;
+    uint16_t handle;
+    uint16_t off;
+    int i;
+
+    if (len != 7) {
+        vctrl_att_err(conn, req[0], 0, BLE_ATT_ERR_UNSUPPORTED_GROUP);
+        return;
+    }
+
+    start = get_le16(&req[1]);
+    end = get_le16(&req[3]);
+    if (get_le16(&req[5]) != BLE_ATT_UUID_PRIMARY_SERVICE) {
+        vctrl_att_err(conn, req[0], start, BLE_ATT_ERR_UNSUPPORTED_GROUP);
+        return;
+    }
+
+    rsp[0] = BLE_ATT_OP_READ_GROUP_TYPE_RSP;
+    rsp[1] = 6;
+    off = 2;
+
+    for (i = 0; i < VCTRL_SVC_COUNT; i++) {
+        handle = 1 + i * VCTRL_SVC_HANDLES;
+        if ((handle < start) || (handle > end)) {
+            continue;
+        }
+        if (off + 6 > conn->att_mtu) {
+            break;
+        }
+
+        put_le16(&rsp[off], handle);
+        put_le16(&rsp[off + 2], handle + VCTRL_SVC_HANDLES - 1);
+        put_le16(&rsp[off + 4], VCTRL_SVC_UUID_BASE + i);
+        off += 6;
+    }
+
+    if (off == 2) {
+        vctrl_att_err(conn, req[0], start, BLE_ATT_ERR_ATTR_NOT_FOUND);
+        return;
+    }
+
+    vctrl_l2cap_tx(conn, BLE_L2CAP_CID_ATT, rsp, off);
+}
+
+static void
+vctrl_att_read_type(struct vctrl_conn *conn, const uint8_t *req,
+                    uint16_t len)
+{
+    uint8_t rsp[VCTRL_ATT_MTU];
+    uint16_t start;
+    uint16_t end;
+    uint16_t handle;
+    uint16_t off;
+
+    if ((len != 7) || (get_le16(&req[5]) != BLE_ATT_UUID_CHARACTERISTIC)) {
+        vctrl_att_err(conn, req[0], 0, BLE_ATT_ERR_ATTR_NOT_FOUND);
+        return;
+    }
+
+    start = max(get_le16(&req[1]), 1);
+    end = min(get_le16(&req[3]), VCTRL_LAST_HANDLE);
+
+    rsp[0] = BLE_ATT_OP_READ_TYPE_RSP;
+    rsp[1] = 7;
+    off = 2;
+
+    for (handle = start; handle <= end; handle++) {
+        /* Characteristic declarations sit at odd offsets in a service */
+        if (!(((handle - 1) % VCTRL_SVC_HANDLES) & 1)) {
+            continue;
+        }
+        if (off + 7 > conn->att_mtu) {
+            break;
+        }
+
+        put_le16(&rsp[off], handle);
+        rsp[off + 2] = BLE_GATT_CHR_PROP_READ | BLE_GATT_CHR_PROP_WRITE;
+        put_le16(&rsp[off + 3], handle + 1);
+        put_le16(&rsp[off + 5], VCTRL_CHR_UUID_BASE +
+                                ((handle - 1) % VCTRL_SVC_HANDLES) / 2);
+        off += 7;
+    }
+
+    if (off == 2) {
+        vctrl_att_err(conn, req[0], start, BLE_ATT_ERR_ATTR_NOT_FOUND);
+        return;
+    }
+
+    vctrl_l2cap_tx(conn, BLE_L2CAP_CID_ATT, rsp, off);
+}
+
+static void
+vctrl_att_rx(struct vctrl_conn *conn, const uint8_t *pdu, uint16_t len)
+{
+    uint8_t rsp[1 + VCTRL_ATT_VAL_LEN];
+    uint16_t handle;
+
+    if (len == 0) {
+        return;
+    }
+
+    handle = (len >= 3) ? get_le16(&pdu[1]) : 0;
+
+    switch (pdu[0]) {
+    case BLE_ATT_OP_MTU_REQ:
+        conn->att_mtu = max(min(handle, VCTRL_ATT_MTU), BLE_ATT_MTU_DFLT);
+        rsp[0] = BLE_ATT_OP_MTU_RSP;
+        put_le16(&rsp[1], VCTRL_ATT_MTU);
+        vctrl_l2cap_tx(conn, BLE_L2CAP_CID_ATT, rsp, 3);
+        break;
+    case BLE_ATT_OP_READ_GROUP_TYPE_REQ:
+        vctrl_att_read_group_type(conn, pdu, len);
+        break;
+    case BLE_ATT_OP_READ_TYPE_REQ:
+        vctrl_att_read_type(conn, pdu, len);
+        break;
+    case BLE_ATT_OP_READ_REQ:
+        if (!vctrl_att_is_val_handle(handle)) {
+            vctrl_att_err(conn, pdu[0], handle, BLE_ATT_ERR_INVALID_HANDLE);
+            break;
+        }
+        rsp[0] = BLE_ATT_OP_READ_RSP;
+        memset(&rsp[1], handle, VCTRL_ATT_VAL_LEN);
+        vctrl_l2cap_tx(conn, BLE_L2CAP_CID_ATT, rsp,
+                       min(sizeof(rsp), conn->att_mtu));
+        break;
+    case BLE_ATT_OP_WRITE_REQ:
+        if (!vctrl_att_is_val_handle(handle)) {
+            vctrl_att_err(conn, pdu[0], handle, BLE_ATT_ERR_INVALID_HANDLE);
+            break;
+        }
+        rsp[0] = BLE_ATT_OP_WRITE_RSP;
+        vctrl_l2cap_tx(conn, BLE_L2CAP_CID_ATT, rsp, 1);
+        break;
+    case BLE_ATT_OP_INDICATE_REQ:
+        rsp[0] = BLE_ATT_OP_INDICATE_RSP;
+        vctrl_l2cap_tx(conn, BLE_L2CAP_CID_ATT, rsp, 1);
+        break;
+    case BLE_ATT_OP_NOTIFY_REQ:
+        if (len >= 3) {
+            bench_peer_notify_rx(vctrl_conn_handle(conn), handle, len - 3);
+        }
+        break;
+    case BLE_ATT_OP_WRITE_CMD:
+    case BLE_ATT_OP_INDICATE_RSP:
+        break;
+    default:
+        vctrl_att_err(conn, pdu[0], 0, BLE_ATT_ERR_REQ_NOT_SUPPORTED);
+        break;
+    }
+}
+
+static void
+vctrl_sig_tx(struct vctrl_conn *conn, uint8_t op, uint8_t id,
+             const void *data, uint16_t len)
+{
+    uint8_t pdu[BLE_L2CAP_SIG_HDR_SZ + 16];
+
+    assert(len <= sizeof(pdu) - BLE_L2CAP_SIG_HDR_SZ);
+
+    pdu[0] = op;
+    pdu[1] = id;
+    put_le16(&pdu[2], len);
+    memcpy(&pdu[BLE_L2CAP_SIG_HDR_SZ], data, len);
+
+    vctrl_l2cap_tx(conn, BLE_L2CAP_CID_SIG, pdu, BLE_L2CAP_SIG_HDR_SZ + len);
+}
+
+static void
+vctrl_sig_rx(struct vctrl_conn *conn, const uint8_t *pdu, uint16_t len)
+{
+    const uint8_t *data;
+    uint8_t rsp[10];
+    uint16_t result;
+
+    if (len < BLE_L2CAP_SIG_HDR_SZ) {
+        return;
+    }
+
+    data = &pdu[BLE_L2CAP_SIG_HDR_SZ];
+    len -= BLE_L2CAP_SIG_HDR_SZ;
+
+    switch (pdu[0]) {
+    case BLE_L2CAP_SIG_OP_LE_CREDIT_CONNECT_REQ:
+        if (len < 10) {
+            break;
+        }
+
+        if (conn->coc_scid == 0) {
+            conn->coc_scid = get_le16(&data[2]);
+            conn->coc_in_sdu = 0;
+            conn->coc_credits_used = 0;
+            result = BLE_L2CAP_COC_ERR_CONNECTION_SUCCESS;
+        } else {
+            result = BLE_L2CAP_COC_ERR_NO_RESOURCES;
+        }
+
+        put_le16(&rsp[0], result ? 0 : VCTRL_COC_CID);
+        put_le16(&rsp[2], VCTRL_COC_MTU);
+        put_le16(&rsp[4], VCTRL_COC_MPS);
+        put_le16(&rsp[6], result ? 0 : VCTRL_COC_CREDITS);
+        put_le16(&rsp[8], result);
+        vctrl_sig_tx(conn, BLE_L2CAP_SIG_OP_LE_CREDIT_CONNECT_RSP, pdu[1],
+                     rsp, 10);
+        break;
+    case BLE_L2CAP_SIG_OP_DISCONN_REQ:
+        if (len < 4) {
+            break;
+        }
+
+        if (get_le16(&data[0]) == VCTRL_COC_CID) {
+            conn->coc_scid = 0;
+        }
+        vctrl_sig_tx(conn, BLE_L2CAP_SIG_OP_DISCONN_RSP, pdu[1], data, 4);
+        break;
+    case BLE_L2CAP_SIG_OP_FLOW_CTRL_CREDIT:
+    case BLE_L2CAP_SIG_OP_REJECT:
+    case BLE_L2CAP_SIG_OP_UPDATE_RSP:
+    case BLE_L2CAP_SIG_OP_DISCONN_RSP:
+        break;
+    default:
+        /* Command not understood */
+        put_le16(&rsp[0], 0);
+        vctrl_sig_tx(conn, BLE_L2CAP_SIG_OP_REJECT, pdu[1], rsp, 2);
+        break;
+    }
+}
+
+static void
+vctrl_coc_rx(struct vctrl_conn *conn, const uint8_t *pdu, uint16_t len)
+{
+    uint8_t ind[4];
+
+    if (!conn->coc_in_sdu) {
+        if (len < 2) {
+            return;
+        }
+
+        conn->coc_in_sdu = 1;
+        conn->coc_sdu_len = get_le16(pdu);
+        conn->coc_sdu_rx = len - 2;
+    } else {
+        conn->coc_sdu_rx += len;
+    }
+
+    /* Return credits in batches, as a real peer would */
+    if (++conn->coc_credits_used >= VCTRL_COC_CREDITS / 2) {
+        if (++conn->sig_id == 0) {
+            conn->sig_id = 1;
+        }
+
+        put_le16(&ind[0], VCTRL_COC_CID);
+        put_le16(&ind[2], conn->coc_credits_used);
+        vctrl_sig_tx(conn, BLE_L2CAP_SIG_OP_FLOW_CTRL_CREDIT, conn->sig_id,
+                     ind, sizeof(ind));
+        conn->coc_credits_used = 0;
+    }
+
+    if (conn->coc_sdu_rx >= conn->coc_sdu_len) {
+        conn->coc_in_sdu = 0;
+        bench_peer_coc_sdu_rx(vctrl_conn_handle(conn), conn->coc_sdu_len);
+    }
+}
+
+static void
+vctrl_sm_rx(struct vctrl_conn *conn, const uint8_t *pdu, uint16_t len)
+{
+    uint8_t rsp[17];
+    uint8_t tk[16];
+    int i;
+
+    if (len == 0) {
+        return;
+    }
+
+    switch (pdu[0]) {
+    case BLE_SM_OP_PAIR_REQ:
+        if (len != sizeof(conn->preq)) {
+            break;
+        }
+
+        /* Legacy Just Works, no key distribution */
+        memcpy(conn->preq, pdu, sizeof(conn->preq));
+        conn->pres[0] = BLE_SM_OP_PAIR_RSP;
+        conn->pres[1] = BLE_SM_IO_CAP_NO_IO;
+        conn->pres[2] = 0;
+        conn->pres[3] = 0;
+        conn->pres[4] = 16;
+        conn->pres[5] = 0;
+        conn->pres[6] = 0;
+        vctrl_l2cap_tx(conn, BLE_L2CAP_CID_SM, conn->pres,
+                       sizeof(conn->pres));
+        break;
+    case BLE_SM_OP_PAIR_CONFIRM:
+        for (i = 0; i < sizeof(conn->srand); i++) {
+            conn->srand[i] = random();
+        }
+
+        memset(tk, 0, sizeof(tk));
+        rsp[0] = BLE_SM_OP_PAIR_CONFIRM;
+        ble_sm_alg_c1(tk, conn->srand, conn->preq, conn->pres,
+                      BLE_ADDR_PUBLIC, conn->peer_addr.type, vctrl_bd_addr,
+                      conn->peer_addr.val, &rsp[1]);
+        vctrl_l2cap_tx(conn, BLE_L2CAP_CID_SM, rsp, 17);
+        break;
+    case BLE_SM_OP_PAIR_RANDOM:
+        rsp[0] = BLE_SM_OP_PAIR_RANDOM;
+        memcpy(&rsp[1], conn->srand, sizeof(conn->srand));
+        vctrl_l2cap_tx(conn, BLE_L2CAP_CID_SM, rsp, 17);
+        break;
+    case BLE_SM_OP_PAIR_FAIL:
+        break;
+    default:
+        rsp[0] = BLE_SM_OP_PAIR_FAIL;
+        rsp[1] = BLE_SM_ERR_CMD_NOT_SUPP;
+        vctrl_l2cap_tx(conn, BLE_L2CAP_CID_SM, rsp, 2);
+        break;
+    }
+}
+
+static void
+vctrl_l2cap_rx(struct vctrl_conn *conn)
+{
+    const uint8_t *pdu;
+    uint16_t len;
+    uint16_t cid;
+
+    len = get_le16(&conn->rx_buf[0]);
+    cid = get_le16(&conn->rx_buf[2]);
+    pdu = &conn->rx_buf[BLE_L2CAP_HDR_SZ];
+
+    switch (cid) {
+    case BLE_L2CAP_CID_ATT:
+        vctrl_att_rx(conn, pdu, len);
+        break;
+    case BLE_L2CAP_CID_SIG:
+        vctrl_sig_rx(conn, pdu, len);
+        break;
+    case BLE_L2CAP_CID_SM:
+        vctrl_sm_rx(conn, pdu, len);
+        break;
+    case VCTRL_COC_CID:
+        if (conn->coc_scid != 0) {
+            vctrl_coc_rx(conn, pdu, len);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+int
+ble_transport_to_ll_acl_impl(struct os_mbuf *om)
+{
+    struct hci_data_hdr hdr;
+    struct vctrl_conn *conn;
+    uint16_t handle_pb_bc;
+    uint16_t conn_handle;
+    uint16_t len;
+
+    if (os_mbuf_copydata(om, 0, sizeof(hdr), &hdr) != 0) {
+        os_mbuf_free_chain(om);
+        return 0;
+    }
+
+    handle_pb_bc = le16toh(hdr.hdh_handle_pb_bc);
+    conn_handle = BLE_HCI_DATA_HANDLE(handle_pb_bc);
+    len = le16toh(hdr.hdh_len);
+
+    conn = vctrl_conn_find(conn_handle);
+    if (conn != NULL) {
+        if (BLE_HCI_DATA_PB(handle_pb_bc) != BLE_HCI_PB_MIDDLE) {
+            conn->rx_len = 0;
+        }
+
+        if (conn->rx_len + len <= sizeof(conn->rx_buf)) {
+            os_mbuf_copydata(om, sizeof(hdr), len,
+                             &conn->rx_buf[conn->rx_len]);
+            conn->rx_len += len;
+        } else {
+            fprintf(stderr, "vctrl: L2CAP PDU too long\n");
+            conn->rx_len = 0;
+        }
+    }
+
+    os_mbuf_free_chain(om);
+    vctrl_num_comp_pkts(conn_handle);
+
+    if ((conn != NULL) && (conn->rx_len >= BLE_L2CAP_HDR_SZ) &&
+        (conn->rx_len >= BLE_L2CAP_HDR_SZ + get_le16(conn->rx_buf))) {
+        conn->rx_len = 0;
+        vctrl_l2cap_rx(conn);
+    }
+
+    return 0;
+}
+
+int
+vctrl_adv_report(const struct vctrl_adv *adv)
+{
+    struct ble_hci_ev_le_subev_ext_adv_rpt *ev_rpt;
+    struct ext_adv_report *rpt;
+    struct ble_hci_ev *ev;
+    uint16_t status;
+    uint16_t off;
+    uint8_t len;
+
+    /* Extended reports are what a controller sends while extended scanning,
+     * also for legacy PDUs; long data is fragmented over several events.
+     */
+    off = 0;
+    do {
+        len = min(adv->len - off, VCTRL_ADV_FRAG_LEN);
+        if (adv->props & BLE_HCI_ADV_LEGACY_MASK) {
+            status = 0;
+        } else if (off + len < adv->len) {
+            status = BLE_HCI_ADV_DATA_STATUS_INCOMPLETE;
+        } else {
+            status = BLE_HCI_ADV_DATA_STATUS_COMPLETE;
+        }
+
+        /* Reports go to the discardable pool, as the controller's do */
+        ev = ble_transport_alloc_evt(1);
+        if (ev == NULL) {
+            return BLE_HS_ENOMEM;
+        }
+
+        ev->opcode = BLE_HCI_EVCODE_LE_META;
+        ev->length = sizeof(*ev_rpt) + sizeof(*rpt) + len;
+
+        ev_rpt = (void *)ev->data;
+        ev_rpt->subev_code = BLE_HCI_LE_SUBEV_EXT_ADV_RPT;
+        ev_rpt->num_reports = 1;
+
+        rpt = ev_rpt->reports;
+        memset(rpt, 0, sizeof(*rpt));
+        rpt->evt_type = htole16(adv->props | status);
+        rpt->addr_type = adv->addr.type;
+        memcpy(rpt->addr, adv->addr.val, 6);
+        rpt->pri_phy = BLE_HCI_LE_PHY_1M;
+        if (!(adv->props & BLE_HCI_ADV_LEGACY_MASK)) {
+            rpt->sec_phy = BLE_HCI_LE_PHY_2M;
+        }
+        rpt->sid = adv->sid;
+        rpt->tx_power = 127;
+        rpt->rssi = adv->rssi;
+        rpt->data_len = len;
+        memcpy(rpt->data, adv->data + off, len);
+
+        ble_transport_to_hs_evt(ev);
+
+        off += len;
+    } while (off < adv->len);
+
+    return 0;
+}
+
+void
+ble_transport_ll_init(void)
+{
+    memset(vctrl_conns, 0, sizeof(vctrl_conns));
+}
@@ -620,6 +620,22 @@
 #define MYNEWT_VAL_BLE_EATT_MTU (128)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_GAP_ADV_MON_FILTERS
+#define MYNEWT_VAL_BLE_GAP_ADV_MON_FILTERS (0)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_GAP_ADV_MON_REASM_SLOTS
+#define MYNEWT_VAL_BLE_GAP_ADV_MON_REASM_SLOTS (2)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_GAP_DISC_BATCH_DATA_SIZE
+#define MYNEWT_VAL_BLE_GAP_DISC_BATCH_DATA_SIZE (1024)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_GAP_DISC_BATCH_REPORTS
+#define MYNEWT_VAL_BLE_GAP_DISC_BATCH_REPORTS (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_GAP_MAX_PENDING_CONN_PARAM_UPDATE
 #define MYNEWT_VAL_BLE_GAP_MAX_PENDING_CONN_PARAM_UPDATE (1)
 #endif
@@ -716,6 +732,14 @@
 #define MYNEWT_VAL_BLE_GATT_WRITE_RELIABLE (MYNEWT_VAL_BLE_ROLE_CENTRAL)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_GATTS_NOTIFY_FANOUT
+#define MYNEWT_VAL_BLE_GATTS_NOTIFY_FANOUT (0)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_GATTS_NOTIFY_FANOUT_REFS
+#define MYNEWT_VAL_BLE_GATTS_NOTIFY_FANOUT_REFS (2*MYNEWT_VAL_BLE_MAX_CONNECTIONS)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_HOST
 #define MYNEWT_VAL_BLE_HOST (1)
 #endif
@@ -744,6 +768,10 @@
 #define MYNEWT_VAL_BLE_HS_FLOW_CTRL_TX_ON_DISCONNECT (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_HS_TX_SCHED_DRR
+#define MYNEWT_VAL_BLE_HS_TX_SCHED_DRR (1)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_HS_GAP_UNHANDLED_HCI_EVENT
 #define MYNEWT_VAL_BLE_HS_GAP_UNHANDLED_HCI_EVENT (0)
 #endif
@@ -788,6 +816,14 @@
 #define MYNEWT_VAL_BLE_L2CAP_COC_SDU_BUFF_COUNT (1)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_L2CAP_COC_ADAPTIVE_CREDITS
+#define MYNEWT_VAL_BLE_L2CAP_COC_ADAPTIVE_CREDITS (0)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_L2CAP_COC_ADAPTIVE_MAX_CREDITS
+#define MYNEWT_VAL_BLE_L2CAP_COC_ADAPTIVE_MAX_CREDITS (32)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_L2CAP_ENHANCED_COC
 #define MYNEWT_VAL_BLE_L2CAP_ENHANCED_COC (0)
 #endif
@@ -825,6 +861,10 @@
 #define MYNEWT_VAL_BLE_RPA_TIMEOUT (300)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_SM_ALG_AESNI
+#define MYNEWT_VAL_BLE_SM_ALG_AESNI (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_SM_BONDING
 #define MYNEWT_VAL_BLE_SM_BONDING (0)
 #endif
@@ -874,10 +914,22 @@
 #define MYNEWT_VAL_BLE_SM_SC_DEBUG_KEYS (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_SM_SC_KEY_POOL_SIZE
+#define MYNEWT_VAL_BLE_SM_SC_KEY_POOL_SIZE (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_SM_SC_ONLY
 #define MYNEWT_VAL_BLE_SM_SC_ONLY (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_SM_SC_P256
+#define MYNEWT_VAL_BLE_SM_SC_P256 (0)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_SM_SC_P256_64BIT
+#define MYNEWT_VAL_BLE_SM_SC_P256_64BIT (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_SM_THEIR_KEY_DIST
 #define MYNEWT_VAL_BLE_SM_THEIR_KEY_DIST (0)
 #endif
@@ -0,0 +1,256 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mesh/mesh.h"
+#include "net.h"
+#include "rpl.h"
+
+/* Messages replayed by the benchmarks are among the last few received, so
+ * they are still in any cache that does not lose entries early.
+ */
+#define BENCH_REPLAY_EVERY      4
+#define BENCH_REPLAY_DEPTH      3
+
+struct bench_result {
+    const char *name;
+    uint32_t ops;
+    uint32_t errors;
+    uint64_t elapsed_us;
+};
+
+static uint32_t bench_rand_state = 0x2545f491;
+
+static uint32_t
+bench_rand(void)
+{
+    /* xorshift32, same traffic on every run */
+    bench_rand_state ^= bench_rand_state << 13;
+    bench_rand_state ^= bench_rand_state >> 17;
+    bench_rand_state ^= bench_rand_state << 5;
+
+    return bench_rand_state;
+}
+
+static uint64_t
+bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+bench_print(const struct bench_result *res, int sources)
+{
+    printf("{\"bench\":\"%s\",\"sources\":%d,\"ops\":%u,\"errors\":%u,"
+           "\"elapsed_us\":%llu,\"ops_per_sec\":%llu}\n",
+           res->name, sources, res->ops, res->errors,
+           (unsigned long long)res->elapsed_us,
+           (unsigned long long)(res->elapsed_us ?
+                                res->ops * 1000000ULL / res->elapsed_us : 0));
+}
+
+/*
+ * Messages for the local node from all sources, in random order, go through
+ * the Replay Protection List. Every few messages one of the previous ones is
+ * received again and shall be rejected.
+ */
+static int
+bench_rpl(int ops, int sources, struct bench_result *res)
+{
+    struct bt_mesh_net_rx rx;
+    uint32_t *seq;
+    uint16_t src;
+    bool replay;
+    uint64_t start;
+    int i;
+
+    seq = calloc(sources, sizeof(*seq));
+    if (seq == NULL) {
+        return -1;
+    }
+
+    memset(res, 0, sizeof(*res));
+    res->name = "mesh_rpl";
+
+    memset(&rx, 0, sizeof(rx));
+    rx.net_if = BT_MESH_NET_IF_ADV;
+    rx.local_match = 1;
+
+    bt_mesh_rpl_clear();
+
+    start = bench_now_us();
+
+    for (i = 0; i < ops; i++) {
+        src = bench_rand() % sources;
+        replay = seq[src] > 0 && (i % BENCH_REPLAY_EVERY) == 0;
+        if (!replay) {
+            seq[src]++;
+        }
+
+        /* Unicast addresses of the sources are 0x0001 onwards */
+        rx.ctx.addr = src + 1;
+        rx.seq = seq[src];
+
+        if (bt_mesh_rpl_check(&rx, NULL) != replay) {
+            res->errors++;
+        }
+    }
+
+    res->elapsed_us = bench_now_us() - start;
+    res->ops = ops;
+
+    bt_mesh_rpl_clear();
+    free(seq);
+
+    return 0;
+}
+
+/*
+ * Relayed traffic from all sources goes through the network message cache.
+ * Every few messages one of the last ones is received again, e.g. from
+ * another relay, and shall be found in the cache.
+ */
+static int
+bench_msg_cache(int ops, int sources, struct bench_result *res)
+{
+    struct {
+        uint16_t src;
+        uint32_t seq;
+    } last[BENCH_REPLAY_DEPTH];
+    uint32_t *seq;
+    uint16_t src;
+    uint64_t start;
+    int n;
+    int i;
+
+    seq = calloc(sources, sizeof(*seq));
+    if (seq == NULL) {
+        return -1;
+    }
+
+    memset(res, 0, sizeof(*res));
+    res->name = "mesh_msg_cache";
+
+    memset(last, 0, sizeof(last));
+    n = 0;
+
+    start = bench_now_us();
+
+    for (i = 0; i < ops; i++) {
+        if (n >= BENCH_REPLAY_DEPTH && (i % BENCH_REPLAY_EVERY) == 0) {
+            if (!bt_mesh_msg_cache_match(last[n % BENCH_REPLAY_DEPTH].src,
+                                         last[n % BENCH_REPLAY_DEPTH].seq)) {
+                res->errors++;
+            }
+            continue;
+        }
+
+        src = bench_rand() % sources;
+        seq[src]++;
+
+        if (bt_mesh_msg_cache_match(src + 1, seq[src])) {
+            res->errors++;
+            continue;
+        }
+
+        bt_mesh_msg_cache_add(src + 1, seq[src]);
+
+        last[n % BENCH_REPLAY_DEPTH].src = src + 1;
+        last[n % BENCH_REPLAY_DEPTH].seq = seq[src];
+        n++;
+    }
+
+    res->elapsed_us = bench_now_us() - start;
+    res->ops = ops;
+
+    free(seq);
+
+    return 0;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n ops] [-s sources]\n"
+            "  -n ops      messages per benchmark (default 1000000)\n"
+            "  -s sources  number of source addresses (default 4000, "
+            "at most %d)\n", prog, MYNEWT_VAL(BLE_MESH_CRPL));
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct bench_result res;
+    uint32_t errors;
+    int sources;
+    int ops;
+    int opt;
+
+    ops = 1000000;
+    sources = 4000;
+
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            ops = atoi(optarg);
+            break;
+        case 's':
+            sources = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    /* Each source needs its own RPL entry */
+    if ((ops <= 0) || (sources <= 0) ||
+        (sources > MYNEWT_VAL(BLE_MESH_CRPL))) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    errors = 0;
+
+    if (bench_rpl(ops, sources, &res) != 0) {
+        return 1;
+    }
+    bench_print(&res, sources);
+    errors += res.errors;
+
+    if (bench_msg_cache(ops, sources, &res) != 0) {
+        return 1;
+    }
+    bench_print(&res, sources);
+    errors += res.errors;
+
+    return errors ? 1 : 0;
+}
@@ -36,6 +36,17 @@
 extern "C" {
 #endif
 
+/*
+ * On hosted Linux builds mempools use a lock-free free list fronted by small
+ * per-thread magazines instead of OS_ENTER_CRITICAL, which maps to a single
+ * process-wide mutex there.  Define OS_MEMPOOL_NO_LOCKFREE to disable.
+ */
+#if defined(__linux__) && !defined(OS_MEMPOOL_NO_LOCKFREE)
+#define OS_MEMPOOL_LOCKFREE     1
+#else
+#define OS_MEMPOOL_LOCKFREE     0
+#endif
+
 /**
  * A memory block structure. This simply contains a pointer to the free list
  * chain and is only used when the block is on the free list. When the block
@@ -66,9 +77,15 @@ struct os_mempool {
     /** Bitmap of OS_MEMPOOL_F_[...] values. */
     uint8_t mp_flags;
     /** Address of memory buffer used by pool */
-    uint32_t mp_membuf_addr;
+    uintptr_t mp_membuf_addr;
     STAILQ_ENTRY(os_mempool) mp_list;
     SLIST_HEAD(,os_memblock);
+#if OS_MEMPOOL_LOCKFREE
+    /** Free list head: ABA tag (upper 32 bits), block index + 1 (lower) */
+    uint64_t mp_lf_head;
+    /** Bumped by os_mempool_clear() to invalidate per-thread magazines */
+    uint32_t mp_lf_gen;
+#endif
     /** Name for memory block */
     char *name;
 };
@@ -274,6 +291,12 @@ os_error_t os_memblock_put_from_cb(struct os_mempool *mp, void *block_addr);
  */
 os_error_t os_memblock_put(struct os_mempool *mp, void *block_addr);
 
+/**
+ * Initializes the list of memory pools. Called once at startup, before
+ * any pool is initialized.
+ */
+void os_mempool_module_init(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -80,12 +80,12 @@ os_mqueue_get(struct os_mqueue *mq)
     struct os_mbuf *m;
     os_sr_t sr;
 
-    OS_ENTER_CRITICAL(sr);
+    sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_MQUEUE);
     mp = STAILQ_FIRST(&mq->mq_head);
     if (mp) {
         STAILQ_REMOVE_HEAD(&mq->mq_head, omp_next);
     }
-    OS_EXIT_CRITICAL(sr);
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_MQUEUE, sr);
 
     if (mp) {
         m = OS_MBUF_PKTHDR_TO_MBUF(mp);
@@ -111,9 +111,9 @@ os_mqueue_put(struct os_mqueue *mq, struct ble_npl_eventq *evq, struct os_mbuf *
 
     mp = OS_MBUF_PKTHDR(m);
 
-    OS_ENTER_CRITICAL(sr);
+    sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_MQUEUE);
     STAILQ_INSERT_TAIL(&mq->mq_head, mp, omp_next);
-    OS_EXIT_CRITICAL(sr);
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_MQUEUE, sr);
 
     /* Only post an event to the queue if its specified */
     if (evq) {
@@ -116,6 +116,364 @@ os_mempool_guard_check(const struct os_mempool *mp, void *start)
 #define os_mempool_guard_check(mp, start)
 #endif
 
+#if OS_MEMPOOL_LOCKFREE
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * Free blocks are kept on a Treiber stack whose head packs the block index
+ * with an ABA tag so it can be swapped with a single 64-bit CAS.  In front
+ * of it each thread caches up to OS_MEMPOOL_MAG_SIZE freed blocks per pool
+ * in a direct-mapped magazine, so a thread that frees and allocates in a
+ * loop never touches the shared head.
+ *
+ * Blocks held in a magazine still count in mp_num_free.  A thread that
+ * finds the shared list empty steals from the other threads' magazines,
+ * so a block counted as free can always be allocated.
+ * Each magazine has a lock that only a stealer ever contends on.  Only
+ * pools of at least OS_MEMPOOL_MAG_MIN_BLOCKS blocks use magazines, each
+ * capped at 1/16 of the pool.
+ */
+#define OS_MEMPOOL_MAG_SIZE         (16)
+#define OS_MEMPOOL_MAG_SLOTS        (8)
+#define OS_MEMPOOL_MAG_MIN_BLOCKS   (64)
+
+struct os_mempool_mag {
+    struct os_mempool *mp;
+    uint32_t gen;
+    uint16_t cnt;
+    uint16_t cap;
+    uint8_t lock;
+    struct os_memblock *blocks[OS_MEMPOOL_MAG_SIZE];
+};
+
+/* Magazines of one thread, linked in os_mempool_mag_threads to be stolen
+ * from.
+ */
+struct os_mempool_mag_set {
+    struct os_mempool_mag mags[OS_MEMPOOL_MAG_SLOTS];
+    struct os_mempool_mag_set *next;
+    bool linked;
+};
+
+static __thread struct os_mempool_mag_set os_mempool_mag_set;
+static struct os_mempool_mag_set *os_mempool_mag_threads;
+static pthread_mutex_t os_mempool_mag_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t os_mempool_mag_key;
+static pthread_once_t os_mempool_mag_once = PTHREAD_ONCE_INIT;
+static uint32_t os_mempool_lf_gen_next;
+
+static uint32_t
+os_mempool_lf_idx(const struct os_mempool *mp, const struct os_memblock *block)
+{
+    if (block == NULL) {
+        return 0;
+    }
+
+    return ((uintptr_t)block - mp->mp_membuf_addr) /
+           OS_MEMPOOL_TRUE_BLOCK_SIZE(mp) + 1;
+}
+
+static struct os_memblock *
+os_mempool_lf_block(const struct os_mempool *mp, uint32_t idx)
+{
+    if (idx == 0) {
+        return NULL;
+    }
+
+    return (struct os_memblock *)(mp->mp_membuf_addr +
+                                  (idx - 1) * OS_MEMPOOL_TRUE_BLOCK_SIZE(mp));
+}
+
+static struct os_memblock *
+os_mempool_lf_first(const struct os_mempool *mp)
+{
+    return os_mempool_lf_block(mp, (uint32_t)__atomic_load_n(&mp->mp_lf_head,
+                                                             __ATOMIC_ACQUIRE));
+}
+
+static struct os_memblock *
+os_mempool_lf_pop(struct os_mempool *mp)
+{
+    struct os_memblock *block;
+    struct os_memblock *next;
+    uint64_t head;
+    uint64_t new_head;
+
+    head = __atomic_load_n(&mp->mp_lf_head, __ATOMIC_ACQUIRE);
+    do {
+        block = os_mempool_lf_block(mp, (uint32_t)head);
+        if (block == NULL) {
+            return NULL;
+        }
+
+        /* May be stale if another thread raced us; the tag catches that */
+        next = __atomic_load_n(&SLIST_NEXT(block, mb_next), __ATOMIC_RELAXED);
+        new_head = (((head >> 32) + 1) << 32) | os_mempool_lf_idx(mp, next);
+    } while (!__atomic_compare_exchange_n(&mp->mp_lf_head, &head, new_head,
+                                          true, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE));
+
+    return block;
+}
+
+static void
+os_mempool_lf_push(struct os_mempool *mp, struct os_memblock *block)
+{
+    uint64_t head;
+    uint64_t new_head;
+
+    head = __atomic_load_n(&mp->mp_lf_head, __ATOMIC_RELAXED);
+    do {
+        __atomic_store_n(&SLIST_NEXT(block, mb_next),
+                         os_mempool_lf_block(mp, (uint32_t)head),
+                         __ATOMIC_RELAXED);
+        new_head = (((head >> 32) + 1) << 32) | os_mempool_lf_idx(mp, block);
+    } while (!__atomic_compare_exchange_n(&mp->mp_lf_head, &head, new_head,
+                                          true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
+
+/* Publishes the SLIST built by init/clear as the lock-free free list */
+static void
+os_mempool_lf_reset(struct os_mempool *mp)
+{
+    mp->mp_lf_gen = __atomic_add_fetch(&os_mempool_lf_gen_next, 1,
+                                       __ATOMIC_RELAXED);
+    __atomic_store_n(&mp->mp_lf_head, os_mempool_lf_idx(mp, SLIST_FIRST(mp)),
+                     __ATOMIC_RELEASE);
+}
+
+static void
+os_mempool_mag_lock(struct os_mempool_mag *mag)
+{
+    while (__atomic_exchange_n(&mag->lock, 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+}
+
+static void
+os_mempool_mag_unlock(struct os_mempool_mag *mag)
+{
+    __atomic_store_n(&mag->lock, 0, __ATOMIC_RELEASE);
+}
+
+/* Magazine lock held */
+static void
+os_mempool_mag_flush(struct os_mempool_mag *mag)
+{
+    /* Blocks of a pool that was cleared or re-initialized are already back
+     * on its free list.
+     */
+    if (mag->mp && mag->mp->mp_lf_gen == mag->gen) {
+        while (mag->cnt) {
+            os_mempool_lf_push(mag->mp, mag->blocks[--mag->cnt]);
+        }
+    }
+
+    mag->mp = NULL;
+    mag->cnt = 0;
+}
+
+static void
+os_mempool_mag_thread_exit(void *arg)
+{
+    struct os_mempool_mag_set *set = arg;
+    struct os_mempool_mag_set **prev;
+    int i;
+
+    pthread_mutex_lock(&os_mempool_mag_threads_lock);
+    for (prev = &os_mempool_mag_threads; *prev; prev = &(*prev)->next) {
+        if (*prev == set) {
+            *prev = set->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&os_mempool_mag_threads_lock);
+
+    for (i = 0; i < OS_MEMPOOL_MAG_SLOTS; i++) {
+        os_mempool_mag_lock(&set->mags[i]);
+        os_mempool_mag_flush(&set->mags[i]);
+        os_mempool_mag_unlock(&set->mags[i]);
+    }
+}
+
+static void
+os_mempool_mag_key_init(void)
+{
+    pthread_key_create(&os_mempool_mag_key, os_mempool_mag_thread_exit);
+}
+
+static int
+os_mempool_mag_slot(const struct os_mempool *mp)
+{
+    return ((uintptr_t)mp / sizeof(*mp)) % OS_MEMPOOL_MAG_SLOTS;
+}
+
+/* Returns the locked magazine of this thread for the pool, if it uses one */
+static struct os_mempool_mag *
+os_mempool_mag_get(struct os_mempool *mp)
+{
+    struct os_mempool_mag_set *set = &os_mempool_mag_set;
+    struct os_mempool_mag *mag;
+
+    if (mp->mp_num_blocks < OS_MEMPOOL_MAG_MIN_BLOCKS) {
+        return NULL;
+    }
+
+    if (!set->linked) {
+        /* First use in this thread, make the magazines visible to stealers
+         * and flush them on exit.
+         */
+        pthread_once(&os_mempool_mag_once, os_mempool_mag_key_init);
+        pthread_setspecific(os_mempool_mag_key, set);
+
+        pthread_mutex_lock(&os_mempool_mag_threads_lock);
+        set->next = os_mempool_mag_threads;
+        os_mempool_mag_threads = set;
+        pthread_mutex_unlock(&os_mempool_mag_threads_lock);
+        set->linked = true;
+    }
+
+    mag = &set->mags[os_mempool_mag_slot(mp)];
+    os_mempool_mag_lock(mag);
+
+    if (mag->mp == mp && mag->gen == mp->mp_lf_gen) {
+        return mag;
+    }
+
+    os_mempool_mag_flush(mag);
+
+    mag->mp = mp;
+    mag->gen = mp->mp_lf_gen;
+    mag->cap = mp->mp_num_blocks / 16;
+    if (mag->cap > OS_MEMPOOL_MAG_SIZE) {
+        mag->cap = OS_MEMPOOL_MAG_SIZE;
+    }
+
+    return mag;
+}
+
+/* Takes a block of the pool cached in another thread's magazine */
+static struct os_memblock *
+os_mempool_mag_steal(struct os_mempool *mp)
+{
+    struct os_mempool_mag_set *set;
+    struct os_mempool_mag *mag;
+    struct os_memblock *block;
+
+    block = NULL;
+
+    pthread_mutex_lock(&os_mempool_mag_threads_lock);
+    for (set = os_mempool_mag_threads; set && !block; set = set->next) {
+        mag = &set->mags[os_mempool_mag_slot(mp)];
+
+        os_mempool_mag_lock(mag);
+        if (mag->mp == mp && mag->gen == mp->mp_lf_gen && mag->cnt) {
+            block = mag->blocks[--mag->cnt];
+        }
+        os_mempool_mag_unlock(mag);
+    }
+    pthread_mutex_unlock(&os_mempool_mag_threads_lock);
+
+    return block;
+}
+
+/*
+ * Takes one block off mp_num_free before looking for it.  The count only
+ * goes up once a freed block can be found, so a successful reservation
+ * guarantees a block and the count never drops below zero.
+ */
+static bool
+os_mempool_lf_reserve(struct os_mempool *mp)
+{
+    uint16_t num_free;
+    uint16_t min_free;
+
+    num_free = __atomic_load_n(&mp->mp_num_free, __ATOMIC_RELAXED);
+    do {
+        if (num_free == 0) {
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(&mp->mp_num_free, &num_free,
+                                          num_free - 1, true,
+                                          __ATOMIC_ACQUIRE,
+                                          __ATOMIC_RELAXED));
+    num_free--;
+
+    min_free = __atomic_load_n(&mp->mp_min_free, __ATOMIC_RELAXED);
+    while (num_free < min_free &&
+           !__atomic_compare_exchange_n(&mp->mp_min_free, &min_free, num_free,
+                                        true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+    }
+
+    return true;
+}
+
+static struct os_memblock *
+os_mempool_lf_get(struct os_mempool *mp)
+{
+    struct os_mempool_mag *mag;
+    struct os_memblock *block;
+
+    if (!os_mempool_lf_reserve(mp)) {
+        return NULL;
+    }
+
+    block = NULL;
+
+    mag = os_mempool_mag_get(mp);
+    if (mag) {
+        if (mag->cnt) {
+            block = mag->blocks[--mag->cnt];
+        }
+        os_mempool_mag_unlock(mag);
+    }
+
+    /* The reserved block may be on its way from another thread's magazine
+     * to the shared list, so keep looking until it shows up.
+     */
+    while (block == NULL) {
+        block = os_mempool_lf_pop(mp);
+        if ((block == NULL) && mag) {
+            block = os_mempool_mag_steal(mp);
+        }
+        if (block == NULL) {
+            sched_yield();
+        }
+    }
+
+    return block;
+}
+
+static void
+os_mempool_lf_put(struct os_mempool *mp, struct os_memblock *block)
+{
+    struct os_mempool_mag *mag;
+
+    mag = os_mempool_mag_get(mp);
+    if (mag && mag->cnt < mag->cap) {
+        mag->blocks[mag->cnt++] = block;
+    } else {
+        os_mempool_lf_push(mp, block);
+    }
+
+    if (mag) {
+        os_mempool_mag_unlock(mag);
+    }
+
+    /* Only count the block once it can be found, see
+     * os_mempool_lf_reserve().
+     */
+    __atomic_add_fetch(&mp->mp_num_free, 1, __ATOMIC_RELEASE);
+}
+
+#define os_mempool_free_first(mp)   os_mempool_lf_first(mp)
+#else
+#define os_mempool_free_first(mp)   SLIST_FIRST(mp)
+#endif
+
 static os_error_t
 os_mempool_init_internal(struct os_mempool *mp, uint16_t blocks,
                          uint32_t block_size, void *membuf, char *name,
@@ -150,7 +508,7 @@ os_mempool_init_internal(struct os_mempool *mp, uint16_t blocks,
     mp->mp_min_free = blocks;
     mp->mp_flags = flags;
     mp->mp_num_blocks = blocks;
-    mp->mp_membuf_addr = (uint32_t)(uintptr_t)membuf;
+    mp->mp_membuf_addr = (uintptr_t)membuf;
     mp->name = name;
     SLIST_FIRST(mp) = membuf;
 
@@ -174,6 +532,11 @@ os_mempool_init_internal(struct os_mempool *mp, uint16_t blocks,
         SLIST_NEXT(block_ptr, mb_next) = NULL;
     }
 
+#if OS_MEMPOOL_LOCKFREE
+    mp->mp_lf_head = 0;
+    os_mempool_lf_reset(mp);
+#endif
+
     STAILQ_INSERT_TAIL(&g_os_mempool_list, mp, mp_list);
 
     return OS_OK;
@@ -280,6 +643,10 @@ os_mempool_clear(struct os_mempool *mp)
     /* Last one in the list should be NULL */
     SLIST_NEXT(block_ptr, mb_next) = NULL;
 
+#if OS_MEMPOOL_LOCKFREE
+    os_mempool_lf_reset(mp);
+#endif
+
     return OS_OK;
 }
 
@@ -289,7 +656,8 @@ os_mempool_is_sane(const struct os_mempool *mp)
     struct os_memblock *block;
 
     /* Verify that each block in the free list belongs to the mempool. */
-    SLIST_FOREACH(block, mp, mb_next) {
+    for (block = os_mempool_free_first(mp); block != NULL;
+         block = SLIST_NEXT(block, mb_next)) {
         if (!os_memblock_from(mp, block)) {
             return false;
         }
@@ -304,23 +672,20 @@ int
 os_memblock_from(const struct os_mempool *mp, const void *block_addr)
 {
     uint32_t true_block_size;
-    uintptr_t baddr32;
-    uint32_t end;
-
-    static_assert(sizeof block_addr == sizeof baddr32,
-                  "Pointer to void must be 32-bits.");
+    uintptr_t baddr;
+    uintptr_t end;
 
-    baddr32 = (uint32_t)(uintptr_t)block_addr;
+    baddr = (uintptr_t)block_addr;
     true_block_size = OS_MEMPOOL_TRUE_BLOCK_SIZE(mp);
     end = mp->mp_membuf_addr + (mp->mp_num_blocks * true_block_size);
 
     /* Check that the block is in the memory buffer range. */
-    if ((baddr32 < mp->mp_membuf_addr) || (baddr32 >= end)) {
+    if ((baddr < mp->mp_membuf_addr) || (baddr >= end)) {
         return 0;
     }
 
     /* All freed blocks should be on true block size boundaries! */
-    if (((baddr32 - mp->mp_membuf_addr) % true_block_size) != 0) {
+    if (((baddr - mp->mp_membuf_addr) % true_block_size) != 0) {
         return 0;
     }
 
@@ -330,7 +695,9 @@ os_memblock_from(const struct os_mempool *mp, const void *block_addr)
 void *
 os_memblock_get(struct os_mempool *mp)
 {
+#if !OS_MEMPOOL_LOCKFREE
     os_sr_t sr;
+#endif
     struct os_memblock *block;
 
     os_trace_api_u32(OS_TRACE_ID_MEMBLOCK_GET, (uint32_t)(uintptr_t)mp);
@@ -338,7 +705,10 @@ os_memblock_get(struct os_mempool *mp)
     /* Check to make sure they passed in a memory pool (or something) */
     block = NULL;
     if (mp) {
-        OS_ENTER_CRITICAL(sr);
+#if OS_MEMPOOL_LOCKFREE
+        block = os_mempool_lf_get(mp);
+#else
+        sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_MEMPOOL);
         /* Check for any free */
         if (mp->mp_num_free) {
             /* Get a free block */
@@ -353,7 +723,8 @@ os_memblock_get(struct os_mempool *mp)
                 mp->mp_min_free = mp->mp_num_free;
             }
         }
-        OS_EXIT_CRITICAL(sr);
+        ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_MEMPOOL, sr);
+#endif
 
         if (block) {
             os_mempool_poison_check(mp, block);
@@ -369,7 +740,9 @@ os_memblock_get(struct os_mempool *mp)
 os_error_t
 os_memblock_put_from_cb(struct os_mempool *mp, void *block_addr)
 {
+#if !OS_MEMPOOL_LOCKFREE
     os_sr_t sr;
+#endif
     struct os_memblock *block;
 
     os_trace_api_u32x2(OS_TRACE_ID_MEMBLOCK_PUT_FROM_CB, (uint32_t)(uintptr_t)mp,
@@ -379,7 +752,10 @@ os_memblock_put_from_cb(struct os_mempool *mp, void *block_addr)
     os_mempool_poison(mp, block_addr);
 
     block = (struct os_memblock *)block_addr;
-    OS_ENTER_CRITICAL(sr);
+#if OS_MEMPOOL_LOCKFREE
+    os_mempool_lf_put(mp, block);
+#else
+    sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_MEMPOOL);
 
     /* Chain current free list pointer to this block; make this block head */
     SLIST_NEXT(block, mb_next) = SLIST_FIRST(mp);
@@ -389,7 +765,8 @@ os_memblock_put_from_cb(struct os_mempool *mp, void *block_addr)
     /* Increment number free */
     mp->mp_num_free++;
 
-    OS_EXIT_CRITICAL(sr);
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_MEMPOOL, sr);
+#endif
 
     os_trace_api_ret_u32(OS_TRACE_ID_MEMBLOCK_PUT_FROM_CB, (uint32_t)OS_OK);
 
@@ -421,7 +798,8 @@ os_memblock_put(struct os_mempool *mp, void *block_addr)
     /*
      * Check for duplicate free.
      */
-    SLIST_FOREACH(block, mp, mb_next) {
+    for (block = os_mempool_free_first(mp); block != NULL;
+         block = SLIST_NEXT(block, mb_next)) {
         assert(block != (struct os_memblock *)block_addr);
     }
 #endif
@@ -35,6 +35,41 @@ extern "C" {
 
 #define BLE_NPL_TIME_FOREVER    INT32_MAX
 
+/* Each critical section domain is a separate lock, see os_atomic.c */
+#define BLE_NPL_HAS_CRIT_DOMAINS    (1)
+
+struct ble_npl_crit_stats {
+    /* Outermost entries into the domain */
+    uint64_t acquired;
+    /* Entries that had to wait for another thread */
+    uint64_t contended;
+    /* Total time spent waiting, in nanoseconds */
+    uint64_t wait_ns;
+};
+
+/**
+ * Reads contention counters of a critical section domain.
+ *
+ * @param domain                BLE_NPL_CRIT_[...]
+ * @param stats                 Filled with a snapshot of the counters
+ */
+void ble_npl_hw_crit_stats_get(uint8_t domain,
+                               struct ble_npl_crit_stats *stats);
+
+/**
+ * Prints contention counters of all critical section domains to stdout.
+ */
+void ble_npl_hw_crit_stats_dump(void);
+
+/**
+ * Checks if a callout is pending in the timer wheel.
+ *
+ * @param c                     Callout to check
+ *
+ * @return                      1 if the callout is pending, 0 otherwise
+ */
+int ble_npl_callout_queued(struct ble_npl_callout *c);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,13 +22,25 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include "syscfg/syscfg.h"
 
-/* Example on how to use macro to generate module logging functions */
+#define BLE_NPL_LOG_LEVEL_DEBUG     (0)
+#define BLE_NPL_LOG_LEVEL_INFO      (1)
+#define BLE_NPL_LOG_LEVEL_WARN      (2)
+#define BLE_NPL_LOG_LEVEL_ERROR     (3)
+#define BLE_NPL_LOG_LEVEL_CRITICAL  (4)
+
+/* Example on how to use macro to generate module logging functions. Messages
+ * below LOG_LEVEL are compiled out.
+ */
 #define BLE_NPL_LOG_IMPL(lvl) \
         static inline void _BLE_NPL_LOG_CAT(BLE_NPL_LOG_MODULE, \
                 _BLE_NPL_LOG_CAT(_, lvl))(const char *fmt, ...)\
         {                               \
             va_list args;               \
+            if (BLE_NPL_LOG_LEVEL_ ## lvl < MYNEWT_VAL(LOG_LEVEL)) { \
+                return;                 \
+            }                           \
             va_start(args, fmt);        \
             vprintf(fmt, args);          \
             va_end(args);               \
@@ -40,6 +40,8 @@ struct ble_npl_event {
     uint8_t                 ev_queued;
     ble_npl_event_fn       *ev_cb;
     void                   *ev_arg;
+    struct ble_npl_event   *ev_next;
+    void                   *ev_q;
 };
 
 struct ble_npl_eventq {
@@ -50,8 +52,11 @@ struct ble_npl_callout {
     struct ble_npl_event    c_ev;
     struct ble_npl_eventq  *c_evq;
     uint32_t                c_ticks;
-    timer_t                 c_timer;
+    struct ble_npl_callout *c_next;
+    struct ble_npl_callout **c_pprev;
+    uint8_t                 c_lvl;
     bool                    c_active;
+    bool                    c_inited;
 };
 
 struct ble_npl_mutex {
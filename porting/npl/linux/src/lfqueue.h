@@ -0,0 +1,371 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Intrusive event queue: lock-free multi-producer put, futex based
+ * blocking get.
+ *
+ * Events are linked through ble_npl_event.ev_next so put/get never
+ * allocate.  The producer side is Vyukov's intrusive MPSC queue (one
+ * atomic exchange per put).  Consumers are serialized by a mutex that is
+ * uncontended in the usual one-task-per-queue setup.
+ *
+ * ev_queued carries two flags:
+ *  - LFQ_EV_QUEUED: event is logically pending (what the NPL API reports)
+ *  - LFQ_EV_LINKED: event is physically linked in the list
+ *
+ * ev_q points to the queue the event is linked in.  remove() unlinks the
+ * event under the consumer lock, so a removed event is free to be put on
+ * any queue or re-initialized right away.  All flag transitions are CAS on
+ * ev_queued, so put/remove/get can race freely.
+ */
+
+#ifndef __lfqueue_h__
+#define __lfqueue_h__
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "nimble/nimble_npl.h"
+
+#define LFQ_EV_QUEUED   (0x01)
+#define LFQ_EV_LINKED   (0x02)
+
+class lfqueue
+{
+    struct ble_npl_event   *m_head;     /* last pushed, written by producers */
+    struct ble_npl_event   *m_tail;     /* next to pop, owned by consumer */
+    struct ble_npl_event    m_stub;
+    pthread_mutex_t         m_cons_lock;
+    uint32_t                m_seq;      /* futex word, bumped on every put */
+    uint32_t                m_waiters;
+
+    static long futex(uint32_t *uaddr, int op, uint32_t val,
+                      const struct timespec *ts)
+    {
+        return syscall(SYS_futex, uaddr, op, val, ts, NULL, 0);
+    }
+
+    void push(struct ble_npl_event *ev)
+    {
+        struct ble_npl_event *prev;
+
+        __atomic_store_n(&ev->ev_next, NULL, __ATOMIC_RELAXED);
+        prev = __atomic_exchange_n(&m_head, ev, __ATOMIC_ACQ_REL);
+        __atomic_store_n(&prev->ev_next, ev, __ATOMIC_RELEASE);
+    }
+
+    /*
+     * Unlinks one node. Returns NULL if the list is empty or a producer is
+     * between its exchange and link steps (see busy()).
+     */
+    struct ble_npl_event *pop()
+    {
+        struct ble_npl_event *tail = m_tail;
+        struct ble_npl_event *next;
+
+        next = __atomic_load_n(&tail->ev_next, __ATOMIC_ACQUIRE);
+
+        if (tail == &m_stub) {
+            if (next == NULL) {
+                return NULL;
+            }
+            __atomic_store_n(&m_tail, next, __ATOMIC_RELAXED);
+            tail = next;
+            next = __atomic_load_n(&next->ev_next, __ATOMIC_ACQUIRE);
+        }
+
+        if (next) {
+            __atomic_store_n(&m_tail, next, __ATOMIC_RELAXED);
+            return tail;
+        }
+
+        if (tail != __atomic_load_n(&m_head, __ATOMIC_ACQUIRE)) {
+            return NULL;
+        }
+
+        push(&m_stub);
+
+        next = __atomic_load_n(&tail->ev_next, __ATOMIC_ACQUIRE);
+        if (next) {
+            __atomic_store_n(&m_tail, next, __ATOMIC_RELAXED);
+            return tail;
+        }
+
+        return NULL;
+    }
+
+    bool busy()
+    {
+        return __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) !=
+               __atomic_load_n(&m_tail, __ATOMIC_RELAXED);
+    }
+
+    /* Pops until a logically queued event is found. Consumer lock held. */
+    struct ble_npl_event *take()
+    {
+        struct ble_npl_event *ev;
+        uint8_t old;
+
+        for (;;) {
+            ev = pop();
+            if (ev == NULL) {
+                if (!busy()) {
+                    return NULL;
+                }
+                /* Producer preempted mid-push, give it a chance to finish */
+                sched_yield();
+                continue;
+            }
+
+            __atomic_store_n(&ev->ev_q, NULL, __ATOMIC_RELAXED);
+            old = __atomic_exchange_n(&ev->ev_queued, 0, __ATOMIC_ACQ_REL);
+            if (old & LFQ_EV_QUEUED) {
+                return ev;
+            }
+            /* Not reachable as remove() unlinks, but never hand out a
+             * removed event.
+             */
+        }
+    }
+
+    /*
+     * Unlinks ev from anywhere in the list. Consumer lock held, so only
+     * producers run concurrently and they only write the ev_next of the
+     * last node. A node that is not last can be skipped over; if ev is
+     * last the stub is pushed behind it first. Returns false if ev is not
+     * in this list.
+     */
+    bool unlink(struct ble_npl_event *ev)
+    {
+        struct ble_npl_event *stub_prev;
+        struct ble_npl_event *prev;
+        struct ble_npl_event *node;
+        struct ble_npl_event *next;
+        bool stub_linked;
+
+        for (;;) {
+            stub_linked = false;
+            stub_prev = NULL;
+            prev = NULL;
+            node = m_tail;
+
+            while (node != ev) {
+                next = __atomic_load_n(&node->ev_next, __ATOMIC_ACQUIRE);
+                if (next == NULL) {
+                    break;
+                }
+                if (node == &m_stub) {
+                    stub_linked = true;
+                    stub_prev = prev;
+                }
+                prev = node;
+                node = next;
+            }
+
+            if (node != ev) {
+                if (node == __atomic_load_n(&m_head, __ATOMIC_ACQUIRE)) {
+                    return false;
+                }
+                /* Producer preempted mid-push, maybe of ev itself */
+                sched_yield();
+                continue;
+            }
+
+            next = __atomic_load_n(&ev->ev_next, __ATOMIC_ACQUIRE);
+            if (next) {
+                break;
+            }
+
+            if (ev != __atomic_load_n(&m_head, __ATOMIC_ACQUIRE)) {
+                /* Someone is linking a node behind ev */
+                sched_yield();
+                continue;
+            }
+
+            if (stub_linked) {
+                /* Stub is ahead of ev; take it out so it can be pushed
+                 * behind ev.
+                 */
+                next = __atomic_load_n(&m_stub.ev_next, __ATOMIC_ACQUIRE);
+                if (stub_prev) {
+                    __atomic_store_n(&stub_prev->ev_next, next,
+                                     __ATOMIC_RELEASE);
+                } else {
+                    __atomic_store_n(&m_tail, next, __ATOMIC_RELAXED);
+                }
+            }
+
+            push(&m_stub);
+        }
+
+        if (prev) {
+            __atomic_store_n(&prev->ev_next, next, __ATOMIC_RELEASE);
+        } else {
+            __atomic_store_n(&m_tail, next, __ATOMIC_RELAXED);
+        }
+
+        return true;
+    }
+
+public:
+    lfqueue()
+    {
+        m_stub.ev_next = NULL;
+        m_stub.ev_queued = LFQ_EV_LINKED;
+        m_stub.ev_q = NULL;
+        m_head = &m_stub;
+        m_tail = &m_stub;
+        m_seq = 0;
+        m_waiters = 0;
+        pthread_mutex_init(&m_cons_lock, NULL);
+    }
+
+    ~lfqueue() {
+        pthread_mutex_destroy(&m_cons_lock);
+    }
+
+    void put(struct ble_npl_event *ev)
+    {
+        uint8_t old;
+        uint8_t val;
+
+        old = __atomic_load_n(&ev->ev_queued, __ATOMIC_RELAXED);
+        do {
+            if (old & LFQ_EV_QUEUED) {
+                return;
+            }
+            val = old | LFQ_EV_QUEUED | LFQ_EV_LINKED;
+        } while (!__atomic_compare_exchange_n(&ev->ev_queued, &old, val, true,
+                                              __ATOMIC_ACQ_REL,
+                                              __ATOMIC_RELAXED));
+
+        if (!(old & LFQ_EV_LINKED)) {
+            __atomic_store_n(&ev->ev_q, this, __ATOMIC_RELAXED);
+            push(ev);
+        }
+
+        __atomic_fetch_add(&m_seq, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&m_waiters, __ATOMIC_SEQ_CST)) {
+            futex(&m_seq, FUTEX_WAKE_PRIVATE, 1, NULL);
+        }
+    }
+
+    struct ble_npl_event *get(ble_npl_time_t tmo)
+    {
+        struct ble_npl_event *ev;
+        struct timespec deadline;
+        struct timespec now;
+        struct timespec ts;
+        uint32_t seq;
+
+        if (tmo != BLE_NPL_TIME_FOREVER) {
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += tmo / 1000;
+            deadline.tv_nsec += (tmo % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+        }
+
+        pthread_mutex_lock(&m_cons_lock);
+
+        ev = take();
+        if (ev || tmo == 0) {
+            pthread_mutex_unlock(&m_cons_lock);
+            return ev;
+        }
+
+        __atomic_fetch_add(&m_waiters, 1, __ATOMIC_SEQ_CST);
+
+        for (;;) {
+            seq = __atomic_load_n(&m_seq, __ATOMIC_SEQ_CST);
+
+            ev = take();
+            if (ev) {
+                break;
+            }
+
+            if (tmo == BLE_NPL_TIME_FOREVER) {
+                futex(&m_seq, FUTEX_WAIT_PRIVATE, seq, NULL);
+                continue;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            ts.tv_sec = deadline.tv_sec - now.tv_sec;
+            ts.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+            if (ts.tv_nsec < 0) {
+                ts.tv_sec--;
+                ts.tv_nsec += 1000000000;
+            }
+            if (ts.tv_sec < 0) {
+                break;
+            }
+
+            futex(&m_seq, FUTEX_WAIT_PRIVATE, seq, &ts);
+        }
+
+        __atomic_fetch_sub(&m_waiters, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&m_cons_lock);
+
+        return ev;
+    }
+
+    void remove(struct ble_npl_event *ev)
+    {
+        uint8_t old;
+
+        pthread_mutex_lock(&m_cons_lock);
+
+        /* Not linked here, or a put() on another queue is in progress */
+        if (__atomic_load_n(&ev->ev_q, __ATOMIC_RELAXED) != this) {
+            pthread_mutex_unlock(&m_cons_lock);
+            return;
+        }
+
+        __atomic_fetch_and(&ev->ev_queued, (uint8_t)~LFQ_EV_QUEUED,
+                           __ATOMIC_ACQ_REL);
+        unlink(ev);
+        __atomic_store_n(&ev->ev_q, NULL, __ATOMIC_RELAXED);
+        old = __atomic_exchange_n(&ev->ev_queued, 0, __ATOMIC_ACQ_REL);
+
+        pthread_mutex_unlock(&m_cons_lock);
+
+        /* A put() that raced with us only set LFQ_EV_QUEUED, redo it */
+        if (old & LFQ_EV_QUEUED) {
+            put(ev);
+        }
+    }
+
+    bool empty()
+    {
+        return (__atomic_load_n(&m_head, __ATOMIC_ACQUIRE) == &m_stub) &&
+               (__atomic_load_n(&m_tail, __ATOMIC_RELAXED) == &m_stub);
+    }
+};
+
+#endif
@@ -17,27 +17,154 @@
  * under the License.
  */
 
+#include <assert.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <time.h>
 #define __USE_GNU
 #include <pthread.h>
 
 #include "nimble/nimble_npl.h"
 
-static struct ble_npl_mutex s_mutex;
-static uint8_t s_mutex_inited = 0;
+/*
+ * Every critical section domain is its own recursive mutex.  Domains must be
+ * entered in enum ble_npl_crit_domain order; nesting against that order is
+ * caught by the assert in ble_npl_hw_enter_critical_domain() instead of
+ * deadlocking under load.
+ *
+ * The LL scheduler has no domain of its own: it shares state with radio and
+ * timer code that uses plain ble_npl_hw_enter_critical() and calls back
+ * into it, so it stays in the global domain.  The other domains protect
+ * lists that are only touched inside their own short sections, which call
+ * nothing that enters another domain.
+ */
 
-uint32_t ble_npl_hw_enter_critical(void)
+struct crit_domain {
+    pthread_mutex_t lock;
+    struct ble_npl_crit_stats stats;
+};
+
+static struct crit_domain crit_domains[BLE_NPL_CRIT_DOMAIN_CNT] = {
+    [0 ... BLE_NPL_CRIT_DOMAIN_CNT - 1] = {
+        .lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP,
+    },
+};
+
+static const char * const crit_domain_names[BLE_NPL_CRIT_DOMAIN_CNT] = {
+    [BLE_NPL_CRIT_TRANSPORT] = "transport",
+    [BLE_NPL_CRIT_GLOBAL] = "global",
+    [BLE_NPL_CRIT_MQUEUE] = "mqueue",
+    [BLE_NPL_CRIT_MEMPOOL] = "mempool",
+};
+
+/* Nesting depth of each domain in the calling thread */
+static __thread uint16_t crit_depth[BLE_NPL_CRIT_DOMAIN_CNT];
+
+static uint64_t
+crit_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+uint32_t
+ble_npl_hw_enter_critical_domain(uint8_t domain)
 {
-    if( !s_mutex_inited ) {
-        ble_npl_mutex_init(&s_mutex);
-        s_mutex_inited = 1;
+    struct crit_domain *cd;
+    uint64_t start;
+    int i;
+
+    assert(domain < BLE_NPL_CRIT_DOMAIN_CNT);
+
+    if (crit_depth[domain]) {
+        crit_depth[domain]++;
+        return 0;
+    }
+
+    crit_depth[domain]++;
+
+    for (i = domain + 1; i < BLE_NPL_CRIT_DOMAIN_CNT; i++) {
+        assert(crit_depth[i] == 0);
+    }
+
+    cd = &crit_domains[domain];
+
+    if (pthread_mutex_trylock(&cd->lock)) {
+        start = crit_now_ns();
+        pthread_mutex_lock(&cd->lock);
+        cd->stats.contended++;
+        cd->stats.wait_ns += crit_now_ns() - start;
     }
 
-    pthread_mutex_lock(&s_mutex.lock);
+    cd->stats.acquired++;
+
     return 0;
 }
 
+void
+ble_npl_hw_exit_critical_domain(uint8_t domain, uint32_t ctx)
+{
+    assert(domain < BLE_NPL_CRIT_DOMAIN_CNT);
+    assert(crit_depth[domain]);
+
+    if (--crit_depth[domain] == 0) {
+        pthread_mutex_unlock(&crit_domains[domain].lock);
+    }
+}
+
+uint32_t ble_npl_hw_enter_critical(void)
+{
+    return ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_GLOBAL);
+}
+
 void ble_npl_hw_exit_critical(uint32_t ctx)
 {
-    pthread_mutex_unlock(&s_mutex.lock);
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_GLOBAL, ctx);
+}
+
+bool ble_npl_hw_is_in_critical(void)
+{
+    int i;
+
+    for (i = 0; i < BLE_NPL_CRIT_DOMAIN_CNT; i++) {
+        if (crit_depth[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+ble_npl_hw_crit_stats_get(uint8_t domain, struct ble_npl_crit_stats *stats)
+{
+    struct crit_domain *cd;
+
+    assert(domain < BLE_NPL_CRIT_DOMAIN_CNT);
+
+    cd = &crit_domains[domain];
+
+    pthread_mutex_lock(&cd->lock);
+    *stats = cd->stats;
+    pthread_mutex_unlock(&cd->lock);
+}
+
+void
+ble_npl_hw_crit_stats_dump(void)
+{
+    struct ble_npl_crit_stats stats;
+    int i;
+
+    printf("%-10s %14s %14s %14s\n", "domain", "acquired", "contended",
+           "wait_us");
+
+    for (i = 0; i < BLE_NPL_CRIT_DOMAIN_CNT; i++) {
+        ble_npl_hw_crit_stats_get(i, &stats);
+        printf("%-10s %14llu %14llu %14llu\n", crit_domain_names[i],
+               (unsigned long long)stats.acquired,
+               (unsigned long long)stats.contended,
+               (unsigned long long)(stats.wait_ns / 1000));
+    }
 }
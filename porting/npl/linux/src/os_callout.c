@@ -18,68 +18,337 @@
  */
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 
 #include <time.h>
-#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 
 #include "nimble/nimble_npl.h"
 
+/*
+ * All callouts live in one hierarchical timing wheel serviced by a single
+ * thread sleeping on a CLOCK_MONOTONIC timerfd.  Wheel resolution is one
+ * tick (1 ms).  Each level has 64 slots; level N slots span 64^N ticks, so
+ * four levels cover ~4.6 hours and anything further out is parked in the
+ * last level and re-sorted when it cascades down.
+ *
+ * Reset and stop only relink the callout in a slot list.  The timerfd is
+ * reprogrammed only when a reset moves the earliest deadline forward.
+ */
+
+#define CO_LVL_BITS     (6)
+#define CO_LVL_SIZE     (1 << CO_LVL_BITS)
+#define CO_LVL_MASK     (CO_LVL_SIZE - 1)
+#define CO_LVL_CNT      (4)
+#define CO_MAX_DELTA    ((1 << (CO_LVL_BITS * CO_LVL_CNT)) - 1)
+
+#define CO_TIME_LT(a, b)    ((int32_t)((a) - (b)) < 0)
+
+struct co_wheel {
+    pthread_mutex_t lock;
+    pthread_t thread;
+    int tfd;
+
+    /* Next tick to be processed */
+    ble_npl_time_t clk;
+
+    /* Tick the timerfd is currently programmed for */
+    ble_npl_time_t armed_tick;
+    bool armed;
+
+    struct ble_npl_callout *slots[CO_LVL_CNT][CO_LVL_SIZE];
+    uint32_t lvl_cnt[CO_LVL_CNT];
+
+    /* Expired, waiting to be dispatched by the wheel thread */
+    struct ble_npl_callout *expired;
+};
+
+static struct co_wheel co_wheel;
+static pthread_once_t co_wheel_once = PTHREAD_ONCE_INIT;
+
+static void
+co_link(struct ble_npl_callout **head, struct ble_npl_callout *c)
+{
+    c->c_next = *head;
+    if (c->c_next) {
+        c->c_next->c_pprev = &c->c_next;
+    }
+    *head = c;
+    c->c_pprev = head;
+}
+
+static void
+co_unlink(struct ble_npl_callout *c)
+{
+    *c->c_pprev = c->c_next;
+    if (c->c_next) {
+        c->c_next->c_pprev = c->c_pprev;
+    }
+    c->c_next = NULL;
+    c->c_pprev = NULL;
+}
+
 static void
-ble_npl_callout_timer_cb(union sigval sv)
+co_wheel_remove(struct ble_npl_callout *c)
 {
-    struct ble_npl_callout *c = (struct ble_npl_callout *)sv.sival_ptr;
-    assert(c);
+    if (!c->c_pprev) {
+        return;
+    }
 
-    if (c->c_evq) {
-        ble_npl_eventq_put(c->c_evq, &c->c_ev);
-    } else {
-        c->c_ev.ev_cb(&c->c_ev);
+    if (c->c_lvl < CO_LVL_CNT) {
+        co_wheel.lvl_cnt[c->c_lvl]--;
     }
+    co_unlink(c);
 }
 
-void ble_npl_callout_init(struct ble_npl_callout *c, 
+static void
+co_wheel_insert(struct ble_npl_callout *c)
+{
+    ble_npl_time_t expires = c->c_ticks;
+    int32_t delta = (int32_t)(expires - co_wheel.clk);
+    uint8_t lvl;
+
+    if (delta < 0) {
+        /* Already due, fire on the next tick processed */
+        expires = co_wheel.clk;
+        delta = 0;
+    } else if (delta > CO_MAX_DELTA) {
+        expires = co_wheel.clk + CO_MAX_DELTA;
+        delta = CO_MAX_DELTA;
+    }
+
+    for (lvl = 0; lvl < CO_LVL_CNT - 1; lvl++) {
+        if (delta < (1 << (CO_LVL_BITS * (lvl + 1)))) {
+            break;
+        }
+    }
+
+    c->c_lvl = lvl;
+    co_wheel.lvl_cnt[lvl]++;
+    co_link(&co_wheel.slots[lvl][(expires >> (CO_LVL_BITS * lvl)) &
+                                 CO_LVL_MASK], c);
+}
+
+/* Re-sorts one slot of a higher level into the levels below it */
+static void
+co_wheel_cascade(uint8_t lvl, uint32_t idx)
+{
+    struct ble_npl_callout *list = co_wheel.slots[lvl][idx];
+    struct ble_npl_callout *c;
+
+    co_wheel.slots[lvl][idx] = NULL;
+
+    while ((c = list) != NULL) {
+        list = c->c_next;
+        co_wheel.lvl_cnt[lvl]--;
+        c->c_pprev = NULL;
+        co_wheel_insert(c);
+    }
+}
+
+/*
+ * Tick at which the wheel next has to run: either the first non-empty level
+ * 0 slot or the next boundary at which the lowest non-empty level cascades.
+ * Returns false if the wheel is empty.
+ */
+static bool
+co_wheel_next(ble_npl_time_t *tick)
+{
+    ble_npl_time_t t;
+    uint32_t span;
+    bool found = false;
+    uint8_t lvl;
+    int i;
+
+    if (co_wheel.lvl_cnt[0]) {
+        t = co_wheel.clk;
+        for (i = 0; i < CO_LVL_SIZE; i++, t++) {
+            if (co_wheel.slots[0][t & CO_LVL_MASK]) {
+                *tick = t;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    /* Anything in a higher level may become due right after it cascades */
+    for (lvl = 1; lvl < CO_LVL_CNT; lvl++) {
+        if (co_wheel.lvl_cnt[lvl]) {
+            span = 1 << (CO_LVL_BITS * lvl);
+            t = (co_wheel.clk + span - 1) & ~(span - 1);
+            if (!found || CO_TIME_LT(t, *tick)) {
+                *tick = t;
+            }
+            return true;
+        }
+    }
+
+    return found;
+}
+
+/* Moves everything due up to and including 'now' to the expired list */
+static void
+co_wheel_advance(ble_npl_time_t now)
+{
+    struct ble_npl_callout *c;
+    ble_npl_time_t next;
+    uint32_t idx;
+    uint8_t lvl;
+
+    while (!CO_TIME_LT(now, co_wheel.clk)) {
+        idx = co_wheel.clk & CO_LVL_MASK;
+
+        for (lvl = 1; idx == 0 && lvl < CO_LVL_CNT; lvl++) {
+            idx = (co_wheel.clk >> (CO_LVL_BITS * lvl)) & CO_LVL_MASK;
+            co_wheel_cascade(lvl, idx);
+        }
+
+        idx = co_wheel.clk & CO_LVL_MASK;
+        while ((c = co_wheel.slots[0][idx]) != NULL) {
+            co_wheel_remove(c);
+            c->c_lvl = CO_LVL_CNT;
+            co_link(&co_wheel.expired, c);
+        }
+
+        co_wheel.clk++;
+
+        /* Skip over ticks at which nothing can happen */
+        if (!co_wheel_next(&next)) {
+            co_wheel.clk = now + 1;
+        } else if (CO_TIME_LT(co_wheel.clk, next)) {
+            co_wheel.clk = CO_TIME_LT(now, next) ? now + 1 : next;
+        }
+    }
+}
+
+static void
+co_wheel_arm(ble_npl_time_t tick, ble_npl_time_t now)
+{
+    struct itimerspec its;
+    int32_t delta = (int32_t)(tick - now);
+
+    if (delta < 1) {
+        delta = 1;
+    }
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = delta / 1000;
+    its.it_value.tv_nsec = (delta % 1000) * 1000000;
+
+    co_wheel.armed_tick = tick;
+    co_wheel.armed = true;
+    timerfd_settime(co_wheel.tfd, 0, &its, NULL);
+}
+
+static void *
+co_wheel_thread(void *arg)
+{
+    struct ble_npl_callout *c;
+    ble_npl_time_t next;
+    ble_npl_time_t now;
+    uint64_t exp;
+
+    while (1) {
+        if (read(co_wheel.tfd, &exp, sizeof(exp)) < 0) {
+            continue;
+        }
+
+        pthread_mutex_lock(&co_wheel.lock);
+
+        co_wheel.armed = false;
+        now = ble_npl_time_get();
+        co_wheel_advance(now);
+
+        if (co_wheel_next(&next)) {
+            co_wheel_arm(next, now);
+        }
+
+        /* Callbacks may reset or stop any callout, so drop the lock */
+        while ((c = co_wheel.expired) != NULL) {
+            co_unlink(c);
+            c->c_active = false;
+
+            pthread_mutex_unlock(&co_wheel.lock);
+
+            if (c->c_evq) {
+                ble_npl_eventq_put(c->c_evq, &c->c_ev);
+            } else {
+                c->c_ev.ev_cb(&c->c_ev);
+            }
+
+            pthread_mutex_lock(&co_wheel.lock);
+        }
+
+        pthread_mutex_unlock(&co_wheel.lock);
+    }
+
+    return NULL;
+}
+
+static void
+co_wheel_init(void)
+{
+    int rc;
+
+    pthread_mutex_init(&co_wheel.lock, NULL);
+    co_wheel.clk = ble_npl_time_get();
+
+    co_wheel.tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    assert(co_wheel.tfd >= 0);
+
+    rc = pthread_create(&co_wheel.thread, NULL, co_wheel_thread, NULL);
+    assert(rc == 0);
+    (void)rc;
+}
+
+void ble_npl_callout_init(struct ble_npl_callout *c,
                           struct ble_npl_eventq *evq,
-                          ble_npl_event_fn *ev_cb, 
+                          ble_npl_event_fn *ev_cb,
                           void *ev_arg)
 {
-    struct sigevent         event;
+    pthread_once(&co_wheel_once, co_wheel_init);
+
+    /* Re-initializing a pending callout must not corrupt the wheel.  This
+     * trusts c_inited, so callouts must be zeroed before first use.
+     */
+    if (c->c_inited) {
+        pthread_mutex_lock(&co_wheel.lock);
+        co_wheel_remove(c);
+        pthread_mutex_unlock(&co_wheel.lock);
+    }
 
-    /* Initialize the callout. */
-    memset(c, 0, sizeof(*c));
-    c->c_ev.ev_cb = ev_cb;
-    c->c_ev.ev_arg = ev_arg;
+    /* Initialize the callout; this also takes an expired event off its
+     * queue.
+     */
+    memset(&c->c_evq, 0, sizeof(*c) - offsetof(struct ble_npl_callout, c_evq));
+    ble_npl_event_init(&c->c_ev, ev_cb, ev_arg);
     c->c_evq = evq;
     c->c_active = false;
-
-    event.sigev_notify = SIGEV_THREAD;
-    event.sigev_value.sival_ptr = c;     // put callout obj in signal args
-    event.sigev_notify_function = ble_npl_callout_timer_cb;
-    event.sigev_notify_attributes = NULL;
-
-    timer_create(CLOCK_REALTIME, &event, &c->c_timer);
+    c->c_lvl = CO_LVL_CNT;
+    c->c_inited = true;
 }
 
 bool ble_npl_callout_is_active(struct ble_npl_callout *c)
 {
-    // TODO: seek native posix method to determine whether timer_t is active.
-    // TODO: fix bug where one-shot timer is still active after fired.
     return c->c_active;
 }
 
 int ble_npl_callout_inited(struct ble_npl_callout *c)
 {
-    return (c->c_timer != NULL);
+    return c->c_inited;
 }
 
 ble_npl_error_t ble_npl_callout_reset(struct ble_npl_callout *c,
 				      ble_npl_time_t ticks)
 {
-    struct itimerspec       its;
+    ble_npl_time_t now;
 
-    if (ticks < 0) {
+    if ((ble_npl_stime_t)ticks < 0) {
         return BLE_NPL_EINVAL;
     }
 
@@ -87,26 +356,34 @@ ble_npl_error_t ble_npl_callout_reset(struct ble_npl_callout *c,
         ticks = 1;
     }
 
-    c->c_ticks = ble_npl_time_get() + ticks;
+    pthread_mutex_lock(&co_wheel.lock);
+
+    now = ble_npl_time_get();
+    c->c_ticks = now + ticks;
+
+    co_wheel_remove(c);
 
-    its.it_interval.tv_sec = 0;
-    its.it_interval.tv_nsec = 0;                     // one shot
-    its.it_value.tv_sec = (ticks / 1000);
-    its.it_value.tv_nsec = (ticks % 1000) * 1000000; // expiration
-    its.it_value.tv_nsec %= 1000000000;
+    /* Nothing pending, catch the wheel up without walking idle ticks */
+    if (!co_wheel.lvl_cnt[0] && !co_wheel.lvl_cnt[1] &&
+        !co_wheel.lvl_cnt[2] && !co_wheel.lvl_cnt[3]) {
+        co_wheel.clk = now;
+    }
+
+    co_wheel_insert(c);
     c->c_active = true;
-    timer_settime(c->c_timer, 0, &its, NULL);
+
+    if (!co_wheel.armed || CO_TIME_LT(c->c_ticks, co_wheel.armed_tick)) {
+        co_wheel_arm(c->c_ticks, now);
+    }
+
+    pthread_mutex_unlock(&co_wheel.lock);
 
     return BLE_NPL_OK;
 }
 
 int ble_npl_callout_queued(struct ble_npl_callout *c)
 {
-    struct itimerspec its;
-    timer_gettime(c->c_timer, &its);
-
-    return ((its.it_value.tv_sec > 0) ||
-            (its.it_value.tv_nsec > 0));
+    return c->c_active;
 }
 
 void ble_npl_callout_stop(struct ble_npl_callout *c)
@@ -115,13 +392,11 @@ void ble_npl_callout_stop(struct ble_npl_callout *c)
         return;
     }
 
-    struct itimerspec its;
-    its.it_interval.tv_sec = 0;
-    its.it_interval.tv_nsec = 0;
-    its.it_value.tv_sec = 0;
-    its.it_value.tv_nsec = 0;
-    timer_settime(c->c_timer, 0, &its, NULL);
+    pthread_mutex_lock(&co_wheel.lock);
+    co_wheel_remove(c);
+    c->c_lvl = CO_LVL_CNT;
     c->c_active = false;
+    pthread_mutex_unlock(&co_wheel.lock);
 }
 
 ble_npl_time_t
@@ -140,19 +415,9 @@ uint32_t
 ble_npl_callout_remaining_ticks(struct ble_npl_callout *co,
                                 ble_npl_time_t now)
 {
-    ble_npl_time_t rt;
-    uint32_t exp;
-
-    struct itimerspec its;
-    timer_gettime(co->c_timer, &its);
-
-    exp = its.it_value.tv_sec * 1000;
-
-    if (exp > now) {
-        rt = exp - now;
-    } else {
-        rt = 0;
+    if (!co->c_active || !CO_TIME_LT(now, co->c_ticks)) {
+        return 0;
     }
 
-    return rt;
+    return co->c_ticks - now;
 }
@@ -22,11 +22,25 @@
 #include <string.h>
 
 #include "nimble/nimble_npl.h"
+
+/*
+ * By default event queues use the intrusive lock-free queue from lfqueue.h.
+ * Define BLE_NPL_LINUX_EVQ_WQUEUE to fall back to the std::list based
+ * wqueue.
+ */
+#ifdef BLE_NPL_LINUX_EVQ_WQUEUE
 #include "wqueue.h"
+#else
+#include "lfqueue.h"
+#endif
 
 extern "C" {
 
+#ifdef BLE_NPL_LINUX_EVQ_WQUEUE
 typedef wqueue<ble_npl_event *> wqueue_t;
+#else
+typedef lfqueue wqueue_t;
+#endif
 
 static struct ble_npl_eventq dflt_evq;
 
@@ -51,11 +65,11 @@ ble_npl_eventq_is_empty(struct ble_npl_eventq *evq)
 {
     wqueue_t *q = static_cast<wqueue_t *>(evq->q);
 
-    if (q->size()) {
-        return 1;
-    } else {
-        return 0;
-    }
+#ifdef BLE_NPL_LINUX_EVQ_WQUEUE
+    return q->size() == 0;
+#else
+    return q->empty();
+#endif
 }
 
 int
@@ -69,11 +83,13 @@ ble_npl_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
 {
     wqueue_t *q = static_cast<wqueue_t *>(evq->q);
 
+#ifdef BLE_NPL_LINUX_EVQ_WQUEUE
     if (ev->ev_queued) {
         return;
     }
 
     ev->ev_queued = 1;
+#endif
     q->put(ev);
 }
 
@@ -85,9 +101,11 @@ struct ble_npl_event *ble_npl_eventq_get(struct ble_npl_eventq *evq,
 
     ev = q->get(tmo);
 
+#ifdef BLE_NPL_LINUX_EVQ_WQUEUE
     if (ev) {
         ev->ev_queued = 0;
     }
+#endif
 
     return ev;
 }
@@ -110,6 +128,11 @@ void
 ble_npl_event_init(struct ble_npl_event *ev, ble_npl_event_fn *fn,
                    void *arg)
 {
+    /* The memory may be fresh from a pool, where the free list link sits on
+     * top of ev_queued, so none of the queue link state can be trusted.  As
+     * on other ports, an event has to be removed from its queue before it is
+     * initialized again.
+     */
     memset(ev, 0, sizeof(*ev));
     ev->ev_cb = fn;
     ev->ev_arg = arg;
@@ -118,7 +141,11 @@ ble_npl_event_init(struct ble_npl_event *ev, ble_npl_event_fn *fn,
 bool
 ble_npl_event_is_queued(struct ble_npl_event *ev)
 {
+#ifdef BLE_NPL_LINUX_EVQ_WQUEUE
     return ev->ev_queued;
+#else
+    return __atomic_load_n(&ev->ev_queued, __ATOMIC_ACQUIRE) & LFQ_EV_QUEUED;
+#endif
 }
 
 void *
@@ -146,11 +173,13 @@ ble_npl_eventq_remove(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
 {
     wqueue_t *q = static_cast<wqueue_t *>(evq->q);
 
+#ifdef BLE_NPL_LINUX_EVQ_WQUEUE
     if (!ev->ev_queued) {
         return;
     }
 
     ev->ev_queued = 0;
+#endif
     q->remove(ev);
 }
 
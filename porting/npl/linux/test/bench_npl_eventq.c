@@ -0,0 +1,195 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+  Microbenchmark for the ble_npl_eventq api:
+
+  - single thread put/get cost per operation
+  - put-to-get latency and throughput with several producer tasks feeding
+    one consumer (the host / HCI / LL task pattern)
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include "test_util.h"
+#include "nimble/nimble_npl.h"
+
+#define BENCH_SINGLE_EVENTS     (100000)
+#define BENCH_PRODUCERS         (4)
+#define BENCH_EVENTS_PER_PROD   (100000)
+#define BENCH_TOTAL_EVENTS      (BENCH_PRODUCERS * BENCH_EVENTS_PER_PROD)
+
+static struct ble_npl_task    s_task_runner;
+static struct ble_npl_task    s_task_prod[BENCH_PRODUCERS];
+
+static struct ble_npl_eventq  s_eventq;
+static struct ble_npl_event   s_single_ev[BENCH_SINGLE_EVENTS];
+static struct ble_npl_event   s_prod_ev[BENCH_PRODUCERS][BENCH_EVENTS_PER_PROD];
+static uint64_t               s_put_ts[BENCH_PRODUCERS][BENCH_EVENTS_PER_PROD];
+static uint64_t               s_lat[BENCH_TOTAL_EVENTS];
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int
+bench_cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void
+bench_ev_cb(struct ble_npl_event *ev)
+{
+}
+
+static void
+bench_single(void)
+{
+    struct ble_npl_event *ev;
+    uint64_t start;
+    uint64_t put_ns;
+    uint64_t get_ns;
+    int i;
+
+    for (i = 0; i < BENCH_SINGLE_EVENTS; i++) {
+        ble_npl_event_init(&s_single_ev[i], bench_ev_cb, NULL);
+    }
+
+    start = bench_now_ns();
+    for (i = 0; i < BENCH_SINGLE_EVENTS; i++) {
+        ble_npl_eventq_put(&s_eventq, &s_single_ev[i]);
+    }
+    put_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (i = 0; i < BENCH_SINGLE_EVENTS; i++) {
+        ev = ble_npl_eventq_get(&s_eventq, 0);
+        VerifyOrQuit(ev == &s_single_ev[i], "eventq: out of order event");
+    }
+    get_ns = bench_now_ns() - start;
+
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == NULL,
+                 "eventq: queue not drained");
+
+    printf("single thread: put %.1f ns/op, get %.1f ns/op\n",
+           (double)put_ns / BENCH_SINGLE_EVENTS,
+           (double)get_ns / BENCH_SINGLE_EVENTS);
+}
+
+static void *
+bench_producer(void *arg)
+{
+    uintptr_t p = (uintptr_t)arg;
+    int i;
+
+    for (i = 0; i < BENCH_EVENTS_PER_PROD; i++) {
+        s_put_ts[p][i] = bench_now_ns();
+        ble_npl_eventq_put(&s_eventq, &s_prod_ev[p][i]);
+    }
+
+    return NULL;
+}
+
+static void
+bench_mpsc(void)
+{
+    struct ble_npl_event *ev;
+    uintptr_t idx;
+    uint64_t start;
+    uint64_t total_ns;
+    uint64_t now;
+    int p;
+    int i;
+
+    for (p = 0; p < BENCH_PRODUCERS; p++) {
+        for (i = 0; i < BENCH_EVENTS_PER_PROD; i++) {
+            idx = (uintptr_t)p * BENCH_EVENTS_PER_PROD + i;
+            ble_npl_event_init(&s_prod_ev[p][i], bench_ev_cb, (void *)idx);
+        }
+    }
+
+    start = bench_now_ns();
+
+    for (p = 0; p < BENCH_PRODUCERS; p++) {
+        SuccessOrQuit(ble_npl_task_init(&s_task_prod[p], "bench_producer",
+                                        bench_producer, (void *)(uintptr_t)p,
+                                        1, 0, NULL, 0),
+                      "task: error initializing");
+    }
+
+    for (i = 0; i < BENCH_TOTAL_EVENTS; i++) {
+        ev = ble_npl_eventq_get(&s_eventq, BLE_NPL_TIME_FOREVER);
+        now = bench_now_ns();
+        VerifyOrQuit(ev != NULL, "eventq: no event");
+
+        idx = (uintptr_t)ble_npl_event_get_arg(ev);
+        s_lat[i] = now - s_put_ts[idx / BENCH_EVENTS_PER_PROD]
+                                 [idx % BENCH_EVENTS_PER_PROD];
+    }
+
+    total_ns = bench_now_ns() - start;
+
+    for (p = 0; p < BENCH_PRODUCERS; p++) {
+        pthread_join(s_task_prod[p].handle, NULL);
+    }
+
+    qsort(s_lat, BENCH_TOTAL_EVENTS, sizeof(s_lat[0]), bench_cmp_u64);
+
+    printf("%d producers: %.0f events/s, latency p50 %llu ns, "
+           "p99 %llu ns, max %llu ns\n", BENCH_PRODUCERS,
+           (double)BENCH_TOTAL_EVENTS * 1e9 / total_ns,
+           (unsigned long long)s_lat[BENCH_TOTAL_EVENTS / 2],
+           (unsigned long long)s_lat[BENCH_TOTAL_EVENTS * 99 / 100],
+           (unsigned long long)s_lat[BENCH_TOTAL_EVENTS - 1]);
+}
+
+void *
+task_bench_runner(void *args)
+{
+    ble_npl_eventq_init(&s_eventq);
+
+    bench_single();
+    bench_mpsc();
+
+    exit(PASS);
+
+    return NULL;
+}
+
+int
+main(void)
+{
+    SuccessOrQuit(ble_npl_task_init(&s_task_runner,
+                                    "task_bench_runner",
+                                    task_bench_runner,
+                                    NULL, 1, 0, NULL, 0),
+                  "task: error initializing");
+
+    while (1) {}
+}
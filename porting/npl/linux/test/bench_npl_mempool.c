@@ -0,0 +1,214 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+  Multithreaded alloc/free benchmark for os_mempool:
+
+  - a large pool (per-thread magazines + lock-free free list)
+  - a small, msys-sized pool (lock-free free list only)
+
+  Each thread repeatedly allocates a burst of blocks, touches them and
+  frees them again.
+
+  Before that, checks that blocks cached in another thread's magazine can
+  still be allocated.
+*/
+
+#include <stdint.h>
+#include <time.h>
+#include "test_util.h"
+#include "os/os.h"
+#include "nimble/nimble_npl.h"
+
+#define BENCH_MAX_THREADS       (8)
+#define BENCH_ITERATIONS        (200000)
+#define BENCH_BURST             (4)
+
+#define BENCH_BIG_BLOCKS        (1024)
+#define BENCH_SMALL_BLOCKS      (12)
+#define BENCH_BLOCK_SIZE        (64)
+
+static struct os_mempool s_pool_big;
+static struct os_mempool s_pool_small;
+
+static os_membuf_t s_pool_big_mem[OS_MEMPOOL_SIZE(BENCH_BIG_BLOCKS,
+                                                  BENCH_BLOCK_SIZE)];
+static os_membuf_t s_pool_small_mem[OS_MEMPOOL_SIZE(BENCH_SMALL_BLOCKS,
+                                                    BENCH_BLOCK_SIZE)];
+
+static struct ble_npl_task s_task[BENCH_MAX_THREADS];
+static struct os_mempool *s_bench_pool;
+static uint32_t s_bench_failed;
+
+static struct ble_npl_sem s_cached_sem;
+static struct ble_npl_sem s_done_sem;
+static void *s_blocks[BENCH_BIG_BLOCKS];
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void *
+bench_worker(void *arg)
+{
+    void *blocks[BENCH_BURST];
+    int i;
+    int j;
+
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        for (j = 0; j < BENCH_BURST; j++) {
+            blocks[j] = os_memblock_get(s_bench_pool);
+            if (blocks[j] == NULL) {
+                __atomic_add_fetch(&s_bench_failed, 1, __ATOMIC_RELAXED);
+            } else {
+                *(volatile uint32_t *)blocks[j] = i;
+            }
+        }
+
+        for (j = 0; j < BENCH_BURST; j++) {
+            if (blocks[j] != NULL) {
+                os_memblock_put(s_bench_pool, blocks[j]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Leaves a few freed blocks in this thread's magazine and stays alive */
+static void *
+bench_cache_worker(void *arg)
+{
+    void *blocks[BENCH_BURST];
+    int i;
+
+    for (i = 0; i < BENCH_BURST; i++) {
+        blocks[i] = os_memblock_get(&s_pool_big);
+        VerifyOrQuit(blocks[i] != NULL, "mempool: alloc failed");
+    }
+
+    for (i = 0; i < BENCH_BURST; i++) {
+        os_memblock_put(&s_pool_big, blocks[i]);
+    }
+
+    ble_npl_sem_release(&s_cached_sem);
+    ble_npl_sem_pend(&s_done_sem, BLE_NPL_TIME_FOREVER);
+
+    return NULL;
+}
+
+static void
+test_cached_blocks(void)
+{
+    int i;
+
+    ble_npl_sem_init(&s_cached_sem, 0);
+    ble_npl_sem_init(&s_done_sem, 0);
+
+    SuccessOrQuit(ble_npl_task_init(&s_task[0], "bench_cache_worker",
+                                    bench_cache_worker, NULL, 1, 0, NULL, 0),
+                  "task: error initializing");
+    ble_npl_sem_pend(&s_cached_sem, BLE_NPL_TIME_FOREVER);
+
+    /* Every block counted as free is available to this thread too */
+    for (i = 0; i < BENCH_BIG_BLOCKS; i++) {
+        s_blocks[i] = os_memblock_get(&s_pool_big);
+        VerifyOrQuit(s_blocks[i] != NULL, "mempool: cached block stranded");
+    }
+    VerifyOrQuit(s_pool_big.mp_num_free == 0, "mempool: wrong free count");
+    VerifyOrQuit(os_memblock_get(&s_pool_big) == NULL,
+                 "mempool: alloc from empty pool");
+
+    for (i = 0; i < BENCH_BIG_BLOCKS; i++) {
+        os_memblock_put(&s_pool_big, s_blocks[i]);
+    }
+
+    ble_npl_sem_release(&s_done_sem);
+    pthread_join(s_task[0].handle, NULL);
+
+    VerifyOrQuit(s_pool_big.mp_num_free == s_pool_big.mp_num_blocks,
+                 "mempool: blocks leaked");
+}
+
+static void
+bench_run(const char *name, struct os_mempool *mp, int threads)
+{
+    uint64_t start;
+    uint64_t total_ns;
+    uint64_t ops;
+    int i;
+
+    s_bench_pool = mp;
+    s_bench_failed = 0;
+
+    start = bench_now_ns();
+
+    for (i = 0; i < threads; i++) {
+        SuccessOrQuit(ble_npl_task_init(&s_task[i], "bench_worker",
+                                        bench_worker, NULL, 1, 0, NULL, 0),
+                      "task: error initializing");
+    }
+
+    for (i = 0; i < threads; i++) {
+        pthread_join(s_task[i].handle, NULL);
+    }
+
+    total_ns = bench_now_ns() - start;
+    ops = (uint64_t)threads * BENCH_ITERATIONS * BENCH_BURST * 2;
+
+    VerifyOrQuit(mp->mp_num_free == mp->mp_num_blocks,
+                 "mempool: blocks leaked");
+    VerifyOrQuit(os_mempool_is_sane(mp), "mempool: corrupted");
+
+    printf("%s pool, %d threads: %.1f Mops/s, %.1f ns/op, "
+           "%u failed allocs\n", name, threads, ops * 1e3 / total_ns,
+           (double)total_ns * threads / ops, s_bench_failed);
+}
+
+int
+main(void)
+{
+    int threads;
+
+    os_mempool_module_init();
+
+    SuccessOrQuit(os_mempool_init(&s_pool_big, BENCH_BIG_BLOCKS,
+                                  BENCH_BLOCK_SIZE, s_pool_big_mem, "big"),
+                  "mempool: init failed");
+    SuccessOrQuit(os_mempool_init(&s_pool_small, BENCH_SMALL_BLOCKS,
+                                  BENCH_BLOCK_SIZE, s_pool_small_mem, "small"),
+                  "mempool: init failed");
+
+    test_cached_blocks();
+
+    for (threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+        bench_run("big", &s_pool_big, threads);
+    }
+
+    for (threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+        bench_run("small", &s_pool_small, threads);
+    }
+
+    return PASS;
+}
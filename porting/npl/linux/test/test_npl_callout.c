@@ -36,6 +36,7 @@
 static bool                   s_tests_running = true;
 static struct ble_npl_task    s_task;
 static struct ble_npl_callout s_callout;
+static struct ble_npl_callout s_callout_stopped;
 static int                    s_callout_args = TEST_ARGS_VALUE;
 
 static struct ble_npl_eventq  s_eventq;
@@ -49,9 +50,17 @@ void on_callout(struct ble_npl_event *ev)
     VerifyOrQuit(*(int*)ev->ev_arg == TEST_ARGS_VALUE,
 		 "callout: args corrupted");
 
+    VerifyOrQuit(!ble_npl_callout_is_active(&s_callout),
+		 "callout: still active after fired");
+
     s_tests_running = false;
 }
 
+void on_callout_stopped(struct ble_npl_event *ev)
+{
+    VerifyOrQuit(0, "callout: stopped callout fired");
+}
+
 /**
  * ble_npl_callout_init(struct ble_npl_callout *c, struct ble_npl_eventq *evq,
  *                 ble_npl_event_fn *ev_cb, void *ev_arg)
@@ -67,18 +76,69 @@ int test_init(void)
 
 int test_queued(void)
 {
-  //VerifyOrQuit(ble_npl_callout_queued(&s_callout),
-  //	 "callout: not queued when expected");
+    VerifyOrQuit(!ble_npl_callout_queued(&s_callout),
+		 "callout: queued when not expected");
     return PASS;
 }
 
 int test_reset(void)
 {
-    return ble_npl_callout_reset(&s_callout, TEST_INTERVAL);
+    uint32_t rt;
+
+    SuccessOrQuit(ble_npl_callout_reset(&s_callout, TEST_INTERVAL),
+		  "callout: reset failed");
+
+    VerifyOrQuit(ble_npl_callout_queued(&s_callout),
+		 "callout: not queued when expected");
+
+    rt = ble_npl_callout_remaining_ticks(&s_callout, ble_npl_time_get());
+    VerifyOrQuit(rt > 0 && rt <= TEST_INTERVAL,
+		 "callout: wrong remaining ticks");
+
+    return PASS;
 }
 
 int test_stop(void)
 {
+    ble_npl_callout_init(&s_callout_stopped,
+		    &s_eventq,
+		    on_callout_stopped,
+		    NULL);
+
+    SuccessOrQuit(ble_npl_callout_reset(&s_callout_stopped, TEST_INTERVAL / 2),
+		  "callout: reset failed");
+    ble_npl_callout_stop(&s_callout_stopped);
+
+    VerifyOrQuit(!ble_npl_callout_is_active(&s_callout_stopped),
+		 "callout: active after stop");
+    VerifyOrQuit(ble_npl_callout_remaining_ticks(&s_callout_stopped,
+						 ble_npl_time_get()) == 0,
+		 "callout: remaining ticks after stop");
+
+    return PASS;
+}
+
+int test_reinit(void)
+{
+    ble_npl_callout_init(&s_callout_stopped,
+		    &s_eventq,
+		    on_callout_stopped,
+		    NULL);
+
+    SuccessOrQuit(ble_npl_callout_reset(&s_callout_stopped, TEST_INTERVAL / 2),
+		  "callout: reset failed");
+
+    /* Re-initializing a pending callout takes it out of the wheel */
+    ble_npl_callout_init(&s_callout_stopped,
+		    &s_eventq,
+		    on_callout_stopped,
+		    NULL);
+
+    VerifyOrQuit(!ble_npl_callout_queued(&s_callout_stopped),
+		 "callout: queued after init");
+    VerifyOrQuit(ble_npl_callout_queued(&s_callout),
+		 "callout: other callout lost by init");
+
     return PASS;
 }
 
@@ -92,6 +152,8 @@ void *test_task_run(void *args)
     SuccessOrQuit(test_init(),   "callout_init failed");
     SuccessOrQuit(test_queued(), "callout_queued failed");
     SuccessOrQuit(test_reset(),  "callout_reset failed");
+    SuccessOrQuit(test_stop(),   "callout_stop failed");
+    SuccessOrQuit(test_reinit(), "callout_reinit failed");
 
     while (s_tests_running)
     {
@@ -0,0 +1,118 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+  Unit tests for the critical section domains:
+
+  uint32_t ble_npl_hw_enter_critical_domain(uint8_t domain);
+  void ble_npl_hw_exit_critical_domain(uint8_t domain, uint32_t ctx);
+  uint32_t ble_npl_hw_enter_critical(void);
+  void ble_npl_hw_exit_critical(uint32_t ctx);
+  bool ble_npl_hw_is_in_critical(void);
+*/
+
+#include <pthread.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "nimble/nimble_npl.h"
+
+static struct ble_npl_task s_task;
+static struct ble_npl_sem  s_sem;
+static volatile bool       s_in_global;
+
+int test_nesting(void)
+{
+    struct ble_npl_crit_stats stats;
+    uint32_t sr_leaf;
+    uint32_t sr;
+
+    VerifyOrQuit(!ble_npl_hw_is_in_critical(), "crit: in critical");
+
+    /* Global sections nest */
+    sr = ble_npl_hw_enter_critical();
+    sr_leaf = ble_npl_hw_enter_critical();
+    ble_npl_hw_exit_critical(sr_leaf);
+    VerifyOrQuit(ble_npl_hw_is_in_critical(), "crit: not in critical");
+    ble_npl_hw_exit_critical(sr);
+
+    VerifyOrQuit(!ble_npl_hw_is_in_critical(), "crit: still in critical");
+
+    /* Leaf domains may be entered from the global one */
+    sr = ble_npl_hw_enter_critical();
+    sr_leaf = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_MQUEUE);
+    VerifyOrQuit(ble_npl_hw_is_in_critical(), "crit: not in critical");
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_MQUEUE, sr_leaf);
+    ble_npl_hw_exit_critical(sr);
+
+    ble_npl_hw_crit_stats_get(BLE_NPL_CRIT_MQUEUE, &stats);
+    VerifyOrQuit(stats.acquired == 1, "crit: wrong mqueue acquire count");
+
+    return PASS;
+}
+
+void *task_global(void *arg)
+{
+    uint32_t sr;
+
+    sr = ble_npl_hw_enter_critical();
+    s_in_global = true;
+    ble_npl_sem_release(&s_sem);
+
+    usleep(50000);
+
+    s_in_global = false;
+    ble_npl_hw_exit_critical(sr);
+
+    return NULL;
+}
+
+int test_leaf_ignores_global(void)
+{
+    uint32_t sr;
+    bool in_global;
+
+    ble_npl_sem_init(&s_sem, 0);
+
+    SuccessOrQuit(ble_npl_task_init(&s_task, "task_global", task_global,
+                                    NULL, 1, 0, NULL, 0),
+                  "task: error initializing");
+    ble_npl_sem_pend(&s_sem, BLE_NPL_TIME_FOREVER);
+
+    /* Leaf domains do not wait for another thread's global section */
+    sr = ble_npl_hw_enter_critical_domain(BLE_NPL_CRIT_MQUEUE);
+    in_global = s_in_global;
+    ble_npl_hw_exit_critical_domain(BLE_NPL_CRIT_MQUEUE, sr);
+
+    VerifyOrQuit(in_global, "crit: mqueue waited for global");
+
+    pthread_join(s_task.handle, NULL);
+
+    return PASS;
+}
+
+int main(void)
+{
+    SuccessOrQuit(test_nesting(), "crit_nesting failed");
+    SuccessOrQuit(test_leaf_ignores_global(),
+                  "crit_leaf_ignores_global failed");
+
+    printf("All tests passed\n");
+
+    return PASS;
+}
@@ -32,6 +32,7 @@
 
 #include <assert.h>
 #include <pthread.h>
+#include <string.h>
 #include "test_util.h"
 #include "nimble/nimble_npl.h"
 
@@ -43,7 +44,9 @@ static struct ble_npl_task    s_task_runner;
 static struct ble_npl_task    s_task_dispatcher;
 
 static struct ble_npl_eventq  s_eventq;
+static struct ble_npl_eventq  s_eventq2;
 static struct ble_npl_event   s_event;
+static struct ble_npl_event   s_event2;
 static int                    s_event_args = TEST_ARGS_VALUE;
 
 
@@ -102,6 +105,94 @@ int test_get(void)
     return PASS;
 }
 
+int test_get_timeout(void)
+{
+    struct ble_npl_event *ev = ble_npl_eventq_get(&s_eventq, 10);
+
+    VerifyOrQuit(ev == NULL, "eventq: event from empty queue");
+
+    return PASS;
+}
+
+int test_remove(void)
+{
+    ble_npl_eventq_put(&s_eventq, &s_event);
+    VerifyOrQuit(ble_npl_event_is_queued(&s_event), "eventq: not queued");
+
+    ble_npl_eventq_remove(&s_eventq, &s_event);
+    VerifyOrQuit(!ble_npl_event_is_queued(&s_event), "eventq: still queued");
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == NULL,
+                 "eventq: removed event returned");
+
+    return PASS;
+}
+
+int test_remove_put_other(void)
+{
+    ble_npl_eventq_init(&s_eventq2);
+    ble_npl_event_init(&s_event2, on_event, &s_event_args);
+
+    /* Removed from the middle of the queue */
+    ble_npl_eventq_put(&s_eventq, &s_event);
+    ble_npl_eventq_put(&s_eventq, &s_event2);
+    ble_npl_eventq_remove(&s_eventq, &s_event);
+    ble_npl_eventq_put(&s_eventq2, &s_event);
+
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == &s_event2,
+                 "eventq: wrong event on first queue");
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == NULL,
+                 "eventq: moved event returned by first queue");
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq2, 0) == &s_event,
+                 "eventq: moved event not returned by second queue");
+    VerifyOrQuit(ble_npl_eventq_is_empty(&s_eventq2),
+                 "eventq: second queue not empty");
+
+    /* Removed as the last event of the queue */
+    ble_npl_eventq_put(&s_eventq, &s_event2);
+    ble_npl_eventq_put(&s_eventq, &s_event);
+    ble_npl_eventq_remove(&s_eventq, &s_event);
+    ble_npl_eventq_put(&s_eventq2, &s_event);
+    ble_npl_eventq_remove(&s_eventq, &s_event2);
+
+    VerifyOrQuit(ble_npl_eventq_is_empty(&s_eventq),
+                 "eventq: queue with removed events not empty");
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == NULL,
+                 "eventq: removed event returned");
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq2, 0) == &s_event,
+                 "eventq: moved event not returned by second queue");
+
+    return PASS;
+}
+
+int test_remove_init_put(void)
+{
+    ble_npl_eventq_put(&s_eventq, &s_event);
+    ble_npl_eventq_remove(&s_eventq, &s_event);
+    ble_npl_event_init(&s_event, on_event, &s_event_args);
+    ble_npl_eventq_put(&s_eventq, &s_event);
+
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == &s_event,
+                 "eventq: re-initialized event not returned");
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == NULL,
+                 "eventq: event returned twice");
+
+    /* Initialized on top of stale memory, e.g. a free memory pool block */
+    ble_npl_eventq_put(&s_eventq, &s_event2);
+    memset(&s_event, 0xa5, sizeof(s_event));
+    ble_npl_event_init(&s_event, on_event, &s_event_args);
+    VerifyOrQuit(!ble_npl_event_is_queued(&s_event),
+                 "eventq: initialized event already queued");
+    ble_npl_eventq_put(&s_eventq, &s_event);
+
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == &s_event2,
+                 "eventq: wrong event returned");
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == &s_event,
+                 "eventq: re-initialized event not returned");
+    VerifyOrQuit(ble_npl_eventq_get(&s_eventq, 0) == NULL,
+                 "eventq: event returned twice");
+
+    return PASS;
+}
 
 void *task_test_runner(void *args)
 {
@@ -110,6 +201,10 @@ void *task_test_runner(void *args)
     SuccessOrQuit(test_init(), "eventq_init failed");
     SuccessOrQuit(test_put(),  "eventq_put failed");
     SuccessOrQuit(test_get(),  "eventq_get failed");
+    SuccessOrQuit(test_get_timeout(), "eventq_get timeout failed");
+    SuccessOrQuit(test_remove(), "eventq_remove failed");
+    SuccessOrQuit(test_remove_put_other(), "eventq_remove_put_other failed");
+    SuccessOrQuit(test_remove_init_put(), "eventq_remove_init_put failed");
     SuccessOrQuit(test_put(),  "eventq_put failed");
     SuccessOrQuit(test_run(),  "eventq_run failed");
 
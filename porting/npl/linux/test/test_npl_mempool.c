@@ -17,95 +17,184 @@
  * under the License.
  */
 
+/**
+  Unit tests for os_mempool, including the lock-free Linux variant:
+
+  - a small pool (lock-free free list only)
+  - a large pool (per-thread magazines in front of the free list)
+
+  The concurrent test checks that the free count never leaves
+  [0, mp_num_blocks] while threads allocate and free in a loop.
+*/
+
+#include <stdint.h>
 #include "test_util.h"
+#include "os/os.h"
 #include "nimble/nimble_npl.h"
 
-#define    TEST_MEMPOOL_BLOCKS       4
-#define    TEST_MEMPOOL_BLOCK_SIZE   128
+#define TEST_MEMPOOL_BLOCKS         (4)
+#define TEST_MEMPOOL_BIG_BLOCKS     (256)
+#define TEST_MEMPOOL_BLOCK_SIZE     (128)
+
+#define TEST_THREADS                (4)
+#define TEST_ITERATIONS             (1000000)
 
-static struct ble_npl_mempool s_mempool;
+static struct os_mempool s_mempool;
+static struct os_mempool s_mempool_big;
 
 static os_membuf_t s_mempool_mem[OS_MEMPOOL_SIZE(TEST_MEMPOOL_BLOCKS,
-						 TEST_MEMPOOL_BLOCK_SIZE)];
+                                                 TEST_MEMPOOL_BLOCK_SIZE)];
+static os_membuf_t s_mempool_big_mem[OS_MEMPOOL_SIZE(TEST_MEMPOOL_BIG_BLOCKS,
+                                                     TEST_MEMPOOL_BLOCK_SIZE)];
 
 static void *s_memblock[TEST_MEMPOOL_BLOCKS];
 
+static struct ble_npl_task s_task[TEST_THREADS];
+static struct os_mempool *s_test_pool;
+static uint32_t s_bad_count;
+
 /**
  * Unit test for initializing a mempool.
  *
- * ble_npl_error_t ble_npl_mempool_init(struct ble_npl_mempool *mp, int blocks,
- *                            int block_size, void *membuf, char *name);
- *
+ * os_error_t os_mempool_init(struct os_mempool *mp, uint16_t blocks,
+ *                            uint32_t block_size, void *membuf, char *name);
  */
 int test_init(void)
 {
     int err;
-    err = ble_npl_mempool_init(NULL,
-			  TEST_MEMPOOL_BLOCKS,
-			  TEST_MEMPOOL_BLOCK_SIZE,
-			  NULL,
-			  "Null mempool");
-    VerifyOrQuit(err, "ble_npl_mempool_init accepted NULL parameters.");
-
-    err = ble_npl_mempool_init(&s_mempool,
-			  TEST_MEMPOOL_BLOCKS,
-			  TEST_MEMPOOL_BLOCK_SIZE,
-			  s_mempool_mem,
-			  "s_mempool");
-    return err;
+
+    err = os_mempool_init(NULL, TEST_MEMPOOL_BLOCKS, TEST_MEMPOOL_BLOCK_SIZE,
+                          NULL, "Null mempool");
+    VerifyOrQuit(err, "os_mempool_init accepted NULL parameters.");
+
+    err = os_mempool_init(&s_mempool, TEST_MEMPOOL_BLOCKS,
+                          TEST_MEMPOOL_BLOCK_SIZE, s_mempool_mem,
+                          "s_mempool");
+    if (err) {
+        return err;
+    }
+
+    return os_mempool_init(&s_mempool_big, TEST_MEMPOOL_BIG_BLOCKS,
+                           TEST_MEMPOOL_BLOCK_SIZE, s_mempool_big_mem,
+                           "s_mempool_big");
 }
 
 /**
  * Test integrity check of a mempool.
  *
- * bool ble_npl_mempool_is_sane(const struct ble_npl_mempool *mp);
+ * bool os_mempool_is_sane(const struct os_mempool *mp);
  */
 int test_is_sane(void)
 {
-    return (ble_npl_mempool_is_sane(&s_mempool)) ? PASS : FAIL;
+    if (!os_mempool_is_sane(&s_mempool) || !os_mempool_is_sane(&s_mempool_big)) {
+        return FAIL;
+    }
+
+    return PASS;
 }
 
 /**
  * Test getting a memory block from the pool, putting it back,
  * and checking if it is still valid.
  *
- * void *ble_npl_memblock_get(struct ble_npl_mempool *mp);
+ * void *os_memblock_get(struct os_mempool *mp);
  *
- * ble_npl_error_t ble_npl_memblock_put(struct ble_npl_mempool *mp, void *block_addr);
+ * os_error_t os_memblock_put(struct os_mempool *mp, void *block_addr);
  *
- * int ble_npl_memblock_from(const struct ble_npl_mempool *mp, const void *block_addr);
+ * int os_memblock_from(const struct os_mempool *mp, const void *block_addr);
  */
 int test_stress(void)
 {
     int loops = 3;
-    while(loops--)
-    {
-        for (int i = 0; i < 4; i++)
-	{
-	    s_memblock[i] = ble_npl_memblock_get(&s_mempool);
-	    VerifyOrQuit(ble_npl_memblock_from(&s_mempool, s_memblock[i]),
-			 "ble_npl_memblock_get return invalid block.");
-	}
-
-
-        for (int i = 0; i < 4; i++)
-	{
- 	    SuccessOrQuit(ble_npl_memblock_put(&s_mempool, s_memblock[i]),
-			"ble_npl_memblock_put refused to take valid block.");
-	    //VerifyOrQuit(!ble_npl_memblock_from(&s_mempool, s_memblock[i]),
-	    //		 "Block still valid after ble_npl_memblock_put.");
-	}
+    int i;
+
+    while (loops--) {
+        for (i = 0; i < TEST_MEMPOOL_BLOCKS; i++) {
+            s_memblock[i] = os_memblock_get(&s_mempool);
+            VerifyOrQuit(os_memblock_from(&s_mempool, s_memblock[i]),
+                         "os_memblock_get return invalid block.");
+        }
+
+        VerifyOrQuit(os_memblock_get(&s_mempool) == NULL,
+                     "os_memblock_get returned a block from an empty pool.");
+        VerifyOrQuit(s_mempool.mp_num_free == 0, "Wrong free count.");
+
+        for (i = 0; i < TEST_MEMPOOL_BLOCKS; i++) {
+            SuccessOrQuit(os_memblock_put(&s_mempool, s_memblock[i]),
+                          "os_memblock_put refused to take valid block.");
+        }
+
+        VerifyOrQuit(s_mempool.mp_num_free == TEST_MEMPOOL_BLOCKS,
+                     "Wrong free count.");
+    }
+
+    return PASS;
+}
+
+static void *
+test_worker(void *arg)
+{
+    void *block;
+    uint16_t num_free;
+    int i;
+
+    for (i = 0; i < TEST_ITERATIONS; i++) {
+        block = os_memblock_get(s_test_pool);
+
+        num_free = __atomic_load_n(&s_test_pool->mp_num_free,
+                                   __ATOMIC_RELAXED);
+        if (num_free > s_test_pool->mp_num_blocks) {
+            __atomic_add_fetch(&s_bad_count, 1, __ATOMIC_RELAXED);
+        }
+
+        if (block != NULL) {
+            os_memblock_put(s_test_pool, block);
+        }
+    }
+
+    return NULL;
+}
 
+/**
+ * Threads allocating and freeing the same pool never see the free count
+ * wrap and leave every block free when done.
+ */
+int test_concurrent(struct os_mempool *mp)
+{
+    int i;
+
+    s_test_pool = mp;
+    s_bad_count = 0;
+
+    for (i = 0; i < TEST_THREADS; i++) {
+        SuccessOrQuit(ble_npl_task_init(&s_task[i], "test_worker",
+                                        test_worker, NULL, 1, 0, NULL, 0),
+                      "task: error initializing");
     }
+
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_join(s_task[i].handle, NULL);
+    }
+
+    VerifyOrQuit(s_bad_count == 0, "Free count out of range.");
+    VerifyOrQuit(mp->mp_num_free == mp->mp_num_blocks, "Blocks leaked.");
+    VerifyOrQuit(mp->mp_min_free <= mp->mp_num_blocks, "Wrong minimum.");
+
     return PASS;
 }
 
 int main(void)
 {
-    SuccessOrQuit(test_init(),    "Failed: ble_npl_mempool_init");
-    SuccessOrQuit(test_is_sane(), "Failed: ble_npl_mempool_is_sane");
-    SuccessOrQuit(test_stress(),  "Failed: ble_npl_mempool stree test");
-    SuccessOrQuit(test_is_sane(), "Failed: ble_npl_mempool_is_sane");
+    os_mempool_module_init();
+
+    SuccessOrQuit(test_init(),    "Failed: os_mempool_init");
+    SuccessOrQuit(test_is_sane(), "Failed: os_mempool_is_sane");
+    SuccessOrQuit(test_stress(),  "Failed: os_mempool stress test");
+    SuccessOrQuit(test_concurrent(&s_mempool),
+                  "Failed: os_mempool concurrent test");
+    SuccessOrQuit(test_concurrent(&s_mempool_big),
+                  "Failed: os_mempool concurrent test, magazines");
+    SuccessOrQuit(test_is_sane(), "Failed: os_mempool_is_sane");
     printf("All tests passed\n");
     return PASS;
 }
@@ -1255,6 +1255,10 @@
 #define MYNEWT_VAL_BLE_LL_NUM_SCAN_DUP_ADVS (8)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_LL_SCAN_DUP_AGING_MS
+#define MYNEWT_VAL_BLE_LL_SCAN_DUP_AGING_MS (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_LL_NUM_SCAN_RSP_ADVS
 #define MYNEWT_VAL_BLE_LL_NUM_SCAN_RSP_ADVS (8)
 #endif
@@ -1292,6 +1296,14 @@
 #define MYNEWT_VAL_BLE_LL_RESOLV_LIST_SIZE (4)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_LL_RESOLV_RPA_CACHE_SIZE
+#define MYNEWT_VAL_BLE_LL_RESOLV_RPA_CACHE_SIZE (8)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_LL_RESOLV_SW_AES
+#define MYNEWT_VAL_BLE_LL_RESOLV_SW_AES (0)
+#endif
+
 /* Overridden by @apache-mynewt-core/hw/bsp/nordic_pca10056 (defined by @apache-mynewt-nimble/nimble/controller) */
 #ifndef MYNEWT_VAL_BLE_LL_RFMGMT_ENABLE_TIME
 #define MYNEWT_VAL_BLE_LL_RFMGMT_ENABLE_TIME (1500)
@@ -1339,6 +1351,10 @@
 #define MYNEWT_VAL_BLE_LL_SCHED_AUX_MAFS_DELAY (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_LL_SCHED_INDEX
+#define MYNEWT_VAL_BLE_LL_SCHED_INDEX (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_LL_SCHED_SCAN_AUX_PDU_LEN
 #define MYNEWT_VAL_BLE_LL_SCHED_SCAN_AUX_PDU_LEN (41)
 #endif
@@ -1347,6 +1363,10 @@
 #define MYNEWT_VAL_BLE_LL_SCHED_SCAN_SYNC_PDU_LEN (32)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_LL_SCHED_STATS
+#define MYNEWT_VAL_BLE_LL_SCHED_STATS (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_LL_STACK_SIZE
 #define MYNEWT_VAL_BLE_LL_STACK_SIZE (120)
 #endif
@@ -1535,6 +1555,22 @@
 #define MYNEWT_VAL_BLE_EATT_MTU (128)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_GAP_ADV_MON_FILTERS
+#define MYNEWT_VAL_BLE_GAP_ADV_MON_FILTERS (0)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_GAP_ADV_MON_REASM_SLOTS
+#define MYNEWT_VAL_BLE_GAP_ADV_MON_REASM_SLOTS (2)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_GAP_DISC_BATCH_DATA_SIZE
+#define MYNEWT_VAL_BLE_GAP_DISC_BATCH_DATA_SIZE (1024)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_GAP_DISC_BATCH_REPORTS
+#define MYNEWT_VAL_BLE_GAP_DISC_BATCH_REPORTS (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_GAP_MAX_PENDING_CONN_PARAM_UPDATE
 #define MYNEWT_VAL_BLE_GAP_MAX_PENDING_CONN_PARAM_UPDATE (1)
 #endif
@@ -1631,6 +1667,14 @@
 #define MYNEWT_VAL_BLE_GATT_WRITE_RELIABLE (MYNEWT_VAL_BLE_ROLE_CENTRAL)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_GATTS_NOTIFY_FANOUT
+#define MYNEWT_VAL_BLE_GATTS_NOTIFY_FANOUT (0)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_GATTS_NOTIFY_FANOUT_REFS
+#define MYNEWT_VAL_BLE_GATTS_NOTIFY_FANOUT_REFS (2*MYNEWT_VAL_BLE_MAX_CONNECTIONS)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_HOST
 #define MYNEWT_VAL_BLE_HOST (1)
 #endif
@@ -1659,6 +1703,10 @@
 #define MYNEWT_VAL_BLE_HS_FLOW_CTRL_TX_ON_DISCONNECT (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_HS_TX_SCHED_DRR
+#define MYNEWT_VAL_BLE_HS_TX_SCHED_DRR (1)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_HS_GAP_UNHANDLED_HCI_EVENT
 #define MYNEWT_VAL_BLE_HS_GAP_UNHANDLED_HCI_EVENT (0)
 #endif
@@ -1703,6 +1751,14 @@
 #define MYNEWT_VAL_BLE_L2CAP_COC_SDU_BUFF_COUNT (1)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_L2CAP_COC_ADAPTIVE_CREDITS
+#define MYNEWT_VAL_BLE_L2CAP_COC_ADAPTIVE_CREDITS (0)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_L2CAP_COC_ADAPTIVE_MAX_CREDITS
+#define MYNEWT_VAL_BLE_L2CAP_COC_ADAPTIVE_MAX_CREDITS (32)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_L2CAP_ENHANCED_COC
 #define MYNEWT_VAL_BLE_L2CAP_ENHANCED_COC (0)
 #endif
@@ -1739,6 +1795,10 @@
 #define MYNEWT_VAL_BLE_RPA_TIMEOUT (300)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_SM_ALG_AESNI
+#define MYNEWT_VAL_BLE_SM_ALG_AESNI (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_SM_BONDING
 #define MYNEWT_VAL_BLE_SM_BONDING (0)
 #endif
@@ -1789,10 +1849,22 @@
 #define MYNEWT_VAL_BLE_SM_SC_DEBUG_KEYS (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_SM_SC_KEY_POOL_SIZE
+#define MYNEWT_VAL_BLE_SM_SC_KEY_POOL_SIZE (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_SM_SC_ONLY
 #define MYNEWT_VAL_BLE_SM_SC_ONLY (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_SM_SC_P256
+#define MYNEWT_VAL_BLE_SM_SC_P256 (0)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_SM_SC_P256_64BIT
+#define MYNEWT_VAL_BLE_SM_SC_P256_64BIT (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_SM_THEIR_KEY_DIST
 #define MYNEWT_VAL_BLE_SM_THEIR_KEY_DIST (0)
 #endif